@@ -156,7 +156,7 @@ DiskRead(ULONG FileId, VOID* Buffer, ULONG N, ULONG* Count)
 {
     DISKCONTEXT* Context = FsGetDeviceSpecific(FileId);
     UCHAR* Ptr = (UCHAR*)Buffer;
-    ULONG Length, TotalSectors, MaxSectors, ReadSectors;
+    ULONG Length, TotalSectors, MaxSectors, ReadSectors, FullSectors;
     ULONGLONG SectorOffset;
     BOOLEAN ret;
 
@@ -172,6 +172,26 @@ DiskRead(ULONG FileId, VOID* Buffer, ULONG N, ULONG* Count)
 
     ret = TRUE;
 
+    /*
+     * Small reads, the bulk of what the file systems do, go through the block
+     * cache which reads ahead with transfers as large as DiskReadBuffer.
+     * Only whole sectors can be copied to the caller's buffer that way.
+     * Removable drives are left alone, the cache is flushed for them anyway.
+     */
+    FullSectors = N / Context->SectorSize;
+    if (FullSectors != 0 && TotalSectors < MaxSectors &&
+        Context->DriveNumber >= 0x80 &&
+        CacheInitializeDrive(Context->DriveNumber) &&
+        CacheManagerDrive.BytesPerSector == Context->SectorSize &&
+        CacheReadDiskSectors(Context->DriveNumber, SectorOffset, FullSectors, Ptr))
+    {
+        Length = FullSectors * Context->SectorSize;
+        Ptr += Length;
+        N -= Length;
+        SectorOffset += FullSectors;
+        TotalSectors -= FullSectors;
+    }
+
     while (TotalSectors)
     {
         ReadSectors = TotalSectors;
@@ -185,6 +205,9 @@ DiskRead(ULONG FileId, VOID* Buffer, ULONG N, ULONG* Count)
         if (!ret)
             break;
 
+        CacheStatistics.UncachedReads++;
+        CacheStatistics.UncachedSectors += ReadSectors;
+
         Length = ReadSectors * Context->SectorSize;
         if (Length > N)
             Length = N;
@@ -23,18 +23,24 @@
 #define TAG_CACHE_DATA 'DcaC'
 #define TAG_CACHE_BLOCK 'BcaC'
 
+// Number of hash buckets for the block lookup, must be a power of two
+#define CACHE_HASH_BUCKETS  256
+#define CACHE_HASH(BlockNumber)     ((BlockNumber) & (CACHE_HASH_BUCKETS - 1))
+
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 // This structure describes a cached block element. The disk is divided up into
 // cache blocks. For disks which LBA is not supported each block is the size of
 // one track. This will force the cache manager to make track sized reads, and
 // therefore maximizes throughput. For disks which support LBA the block size
-// is 64k because they have no cylinder, head, or sector boundaries.
+// is 4k because they have no cylinder, head, or sector boundaries. A miss reads
+// as many blocks as fit in DiskReadBuffer when the access looks sequential.
 //
 ///////////////////////////////////////////////////////////////////////////////////////
 typedef struct
 {
     LIST_ENTRY    ListEntry;                    // Doubly linked list synchronization member
+    LIST_ENTRY    HashListEntry;                // Entry in the drive's hash bucket for BlockNumber
 
     ULONG            BlockNumber;                // Track index for CHS, 64k block index for LBA
     BOOLEAN        LockedInCache;                // Indicates that this block is locked in cache memory
@@ -57,10 +63,31 @@ typedef struct
     ULONG            BytesPerSector;
 
     ULONG            BlockSize;            // Block size (in sectors)
-    LIST_ENTRY        CacheBlockHead;            // Contains CACHE_BLOCK structures
+    ULONG            BlockCount;            // Number of blocks on the drive, 0 if unknown
+    ULONG            MaxTransferBlocks;        // Blocks that fit in DiskReadBuffer
+    ULONG            NextBlock;            // Block following the last one accessed
+    LIST_ENTRY        CacheBlockHead;            // Contains CACHE_BLOCK structures, most recently used first
+    LIST_ENTRY        CacheHashTable[CACHE_HASH_BUCKETS];    // Same blocks, hashed by block number
 
 } CACHE_DRIVE, *PCACHE_DRIVE;
 
+///////////////////////////////////////////////////////////////////////////////////////
+//
+// Disk I/O statistics, dumped by CacheDumpStatistics() in debug builds
+//
+///////////////////////////////////////////////////////////////////////////////////////
+typedef struct
+{
+    ULONG            BlockHits;            // Blocks found in the cache
+    ULONG            BlockMisses;            // Blocks that had to be read from the disk
+    ULONG            ReadAheadBlocks;        // Blocks read before they were asked for
+    ULONG            CachedReads;            // Disk transfers issued by the cache
+    ULONGLONG        CachedSectors;            // Sectors transferred by those
+    ULONG            UncachedReads;            // Disk transfers which bypassed the cache
+    ULONGLONG        UncachedSectors;        // Sectors transferred by those
+
+} CACHE_STATISTICS, *PCACHE_STATISTICS;
+
 
 ///////////////////////////////////////////////////////////////////////////////////////
 //
@@ -72,15 +99,16 @@ extern    BOOLEAN            CacheManagerInitialized;
 extern    ULONG                CacheBlockCount;
 extern    SIZE_T                CacheSizeLimit;
 extern    SIZE_T                CacheSizeCurrent;
+extern    CACHE_STATISTICS    CacheStatistics;
 
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 // Internal functions
 //
 ///////////////////////////////////////////////////////////////////////////////////////
-PCACHE_BLOCK    CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber);                // Returns a pointer to a CACHE_BLOCK structure given a block number
-PCACHE_BLOCK    CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber);                    // Searches the block list for a particular block
-PCACHE_BLOCK    CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber);                // Adds a block to the cache's block list
+PCACHE_BLOCK    CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount);    // Returns a pointer to a CACHE_BLOCK structure given a block number, BlockCount blocks from there are about to be used
+PCACHE_BLOCK    CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber);                    // Searches the block hash table for a particular block
+PCACHE_BLOCK    CacheInternalAddBlocksToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount);    // Reads up to BlockCount blocks with one transfer and adds them to the cache, returns the first one
 BOOLEAN            CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive);                                    // Removes a block from the cache's block list & frees the memory
 VOID            CacheInternalCheckCacheSizeLimits(PCACHE_DRIVE CacheDrive);                            // Checks the cache size limits to see if we can add a new block, if not calls CacheInternalFreeBlock()
 VOID            CacheInternalDumpBlockList(PCACHE_DRIVE CacheDrive);                                // Dumps the list of cached blocks to the debug output port
@@ -92,3 +120,4 @@ VOID    CacheInvalidateCacheData(VOID);
 BOOLEAN    CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG SectorCount, PVOID Buffer);
 BOOLEAN    CacheForceDiskSectorsIntoCache(UCHAR DiskNumber, ULONGLONG StartSector, ULONG SectorCount);
 BOOLEAN    CacheReleaseMemory(ULONG MinimumAmountToRelease);
+VOID    CacheDumpStatistics(VOID);
@@ -0,0 +1,40 @@
+/*
+ * PROJECT:     FreeLoader
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Transparent decompression of gzip-compressed files
+ */
+
+#pragma once
+
+#define GZIP_HEADER_SIZE 10
+
+typedef struct _GZIP_FILE *PGZIP_FILE;
+
+PGZIP_FILE
+GzipOpen(
+    _In_ ULONG FileId,
+    _In_ const DEVVTBL* FuncTable,
+    _Out_writes_bytes_to_(GZIP_HEADER_SIZE, *HeaderLength) PUCHAR Header,
+    _Out_ PULONG HeaderLength);
+
+VOID
+GzipClose(
+    _In_ PGZIP_FILE GzipFile);
+
+ARC_STATUS
+GzipGetFileInformation(
+    _In_ PGZIP_FILE GzipFile,
+    _Out_ FILEINFORMATION* Information);
+
+ARC_STATUS
+GzipRead(
+    _In_ PGZIP_FILE GzipFile,
+    _Out_ VOID* Buffer,
+    _In_ ULONG N,
+    _Out_ ULONG* Count);
+
+ARC_STATUS
+GzipSeek(
+    _In_ PGZIP_FILE GzipFile,
+    _In_ LARGE_INTEGER* Position,
+    _In_ SEEKMODE SeekMode);
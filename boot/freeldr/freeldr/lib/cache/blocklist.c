@@ -25,11 +25,11 @@ DBG_DEFAULT_CHANNEL(CACHE);
 // Returns a pointer to a CACHE_BLOCK structure
 // Adds the block to the cache manager block list
 // in cache memory if it isn't already there
-PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount)
 {
     PCACHE_BLOCK    CacheBlock = NULL;
 
-    TRACE("CacheInternalGetBlockPointer() BlockNumber = %d\n", BlockNumber);
+    TRACE("CacheInternalGetBlockPointer() BlockNumber = %d BlockCount = %d\n", BlockNumber, BlockCount);
 
     CacheBlock = CacheInternalFindBlock(CacheDrive, BlockNumber);
 
@@ -37,12 +37,28 @@ PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNu
     {
         TRACE("Cache hit! BlockNumber: %d CacheBlock->BlockNumber: %d\n", BlockNumber, CacheBlock->BlockNumber);
 
-        return CacheBlock;
+        CacheBlock->AccessCount++;
+        CacheStatistics.BlockHits++;
     }
+    else
+    {
+        TRACE("Cache miss! BlockNumber: %d\n", BlockNumber);
 
-    TRACE("Cache miss! BlockNumber: %d\n", BlockNumber);
+        // Sequential access, so fill the whole disk read
+        // buffer with the blocks that come next
+        if (BlockNumber == CacheDrive->NextBlock && BlockCount < CacheDrive->MaxTransferBlocks)
+        {
+            BlockCount = CacheDrive->MaxTransferBlocks;
+        }
 
-    CacheBlock = CacheInternalAddBlockToCache(CacheDrive, BlockNumber);
+        CacheBlock = CacheInternalAddBlocksToCache(CacheDrive, BlockNumber, BlockCount);
+        if (CacheBlock == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    CacheDrive->NextBlock = BlockNumber + 1;
 
     // Optimize the block list so it has a LRU structure
     CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
@@ -52,91 +68,127 @@ PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNu
 
 PCACHE_BLOCK CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
 {
-    PCACHE_BLOCK    CacheBlock = NULL;
+    PLIST_ENTRY        HashHead;
+    PLIST_ENTRY        Entry;
+    PCACHE_BLOCK    CacheBlock;
 
     TRACE("CacheInternalFindBlock() BlockNumber = %d\n", BlockNumber);
 
     //
-    // Make sure the block list has entries before I start searching it.
+    // Only the blocks hashing to the same bucket need to be looked at
     //
-    if (!IsListEmpty(&CacheDrive->CacheBlockHead))
+    HashHead = &CacheDrive->CacheHashTable[CACHE_HASH(BlockNumber)];
+
+    for (Entry = HashHead->Flink; Entry != HashHead; Entry = Entry->Flink)
     {
-        //
-        // Search the list and find the BIOS drive number
-        //
-        CacheBlock = CONTAINING_RECORD(CacheDrive->CacheBlockHead.Flink, CACHE_BLOCK, ListEntry);
+        CacheBlock = CONTAINING_RECORD(Entry, CACHE_BLOCK, HashListEntry);
 
-        while (&CacheBlock->ListEntry != &CacheDrive->CacheBlockHead)
+        if (CacheBlock->BlockNumber == BlockNumber)
         {
-            //
-            // We found the block, so return it
-            //
-            if (CacheBlock->BlockNumber == BlockNumber)
-            {
-                //
-                // Increment the blocks access count
-                //
-                CacheBlock->AccessCount++;
-
-                return CacheBlock;
-            }
-
-            CacheBlock = CONTAINING_RECORD(CacheBlock->ListEntry.Flink, CACHE_BLOCK, ListEntry);
+            return CacheBlock;
         }
     }
 
     return NULL;
 }
 
-PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+PCACHE_BLOCK CacheInternalAddBlocksToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount)
 {
-    PCACHE_BLOCK    CacheBlock = NULL;
+    PCACHE_BLOCK    CacheBlock;
+    PCACHE_BLOCK    FirstCacheBlock = NULL;
+    ULONG            BlockBytes = CacheDrive->BlockSize * CacheDrive->BytesPerSector;
+    ULONG            Idx;
 
-    TRACE("CacheInternalAddBlockToCache() BlockNumber = %d\n", BlockNumber);
+    TRACE("CacheInternalAddBlocksToCache() BlockNumber = %d BlockCount = %d\n", BlockNumber, BlockCount);
 
-    // Check the size of the cache so we don't exceed our limits
-    CacheInternalCheckCacheSizeLimits(CacheDrive);
+    // One transfer through the disk read buffer at most
+    BlockCount = min(BlockCount, CacheDrive->MaxTransferBlocks);
+    BlockCount = max(BlockCount, 1);
 
-    // We will need to add the block to the
-    // drive's list of cached blocks. So allocate
-    // the block memory.
-    CacheBlock = FrLdrTempAlloc(sizeof(CACHE_BLOCK), TAG_CACHE_BLOCK);
-    if (CacheBlock == NULL)
+    // Don't read ahead past the end of the drive
+    if (CacheDrive->BlockCount != 0 && BlockNumber < CacheDrive->BlockCount)
     {
-        return NULL;
+        BlockCount = min(BlockCount, CacheDrive->BlockCount - BlockNumber);
     }
 
-    // Now initialize the structure and
-    // allocate room for the block data
-    RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
-    CacheBlock->BlockNumber = BlockNumber;
-    CacheBlock->BlockData = FrLdrTempAlloc(CacheDrive->BlockSize * CacheDrive->BytesPerSector,
-                                           TAG_CACHE_DATA);
-    if (CacheBlock->BlockData ==NULL)
+    // Stop at the first block which is already cached
+    for (Idx = 1; Idx < BlockCount; Idx++)
     {
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
-        return NULL;
+        if (CacheInternalFindBlock(CacheDrive, BlockNumber + Idx) != NULL)
+        {
+            break;
+        }
     }
+    BlockCount = Idx;
 
-    // Now try to read in the block
-    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, (BlockNumber * CacheDrive->BlockSize), CacheDrive->BlockSize, DiskReadBuffer))
+    // Now try to read in the blocks with a single transfer
+    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber,
+                                    (ULONGLONG)BlockNumber * CacheDrive->BlockSize,
+                                    BlockCount * CacheDrive->BlockSize,
+                                    DiskReadBuffer))
     {
-        FrLdrTempFree(CacheBlock->BlockData, TAG_CACHE_DATA);
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
-        return NULL;
+        // The read ahead may be what failed, retry with the requested block only
+        if (BlockCount == 1 ||
+            !MachDiskReadLogicalSectors(CacheDrive->DriveNumber,
+                                        (ULONGLONG)BlockNumber * CacheDrive->BlockSize,
+                                        CacheDrive->BlockSize,
+                                        DiskReadBuffer))
+        {
+            return NULL;
+        }
+
+        BlockCount = 1;
     }
-    RtlCopyMemory(CacheBlock->BlockData, DiskReadBuffer, CacheDrive->BlockSize * CacheDrive->BytesPerSector);
 
-    // Add it to our list of blocks managed by the cache
-    InsertTailList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+    CacheStatistics.CachedReads++;
+    CacheStatistics.CachedSectors += BlockCount * CacheDrive->BlockSize;
+    CacheStatistics.BlockMisses++;
+    CacheStatistics.ReadAheadBlocks += BlockCount - 1;
 
-    // Update the cache data
-    CacheBlockCount++;
-    CacheSizeCurrent = CacheBlockCount * (CacheDrive->BlockSize * CacheDrive->BytesPerSector);
+    // Go backwards so that the requested block ends up at the
+    // head of the list, the read ahead ones right behind it
+    for (Idx = BlockCount; Idx-- > 0; )
+    {
+        // Check the size of the cache so we don't exceed our limits
+        CacheInternalCheckCacheSizeLimits(CacheDrive);
+
+        // We will need to add the block to the
+        // drive's list of cached blocks. So allocate
+        // the block memory.
+        CacheBlock = FrLdrTempAlloc(sizeof(CACHE_BLOCK), TAG_CACHE_BLOCK);
+        if (CacheBlock == NULL)
+        {
+            continue;
+        }
 
-    CacheInternalDumpBlockList(CacheDrive);
+        // Now initialize the structure and
+        // allocate room for the block data
+        RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
+        CacheBlock->BlockNumber = BlockNumber + Idx;
+        CacheBlock->BlockData = FrLdrTempAlloc(BlockBytes, TAG_CACHE_DATA);
+        if (CacheBlock->BlockData == NULL)
+        {
+            FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
+            continue;
+        }
 
-    return CacheBlock;
+        RtlCopyMemory(CacheBlock->BlockData, (PVOID)((ULONG_PTR)DiskReadBuffer + Idx * BlockBytes), BlockBytes);
+
+        // Add it to our list of blocks managed by the cache
+        InsertHeadList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+        InsertHeadList(&CacheDrive->CacheHashTable[CACHE_HASH(CacheBlock->BlockNumber)], &CacheBlock->HashListEntry);
+
+        // Update the cache data
+        CacheBlockCount++;
+        CacheSizeCurrent = CacheBlockCount * BlockBytes;
+
+        if (Idx == 0)
+        {
+            FirstCacheBlock = CacheBlock;
+        }
+    }
+
+    return FirstCacheBlock;
 }
 
 BOOLEAN CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive)
@@ -156,12 +208,13 @@ BOOLEAN CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive)
 
     // No blocks left in cache that can be freed
     // so just return
-    if (IsListEmpty(&CacheDrive->CacheBlockHead))
+    if (&CacheBlockToFree->ListEntry == &CacheDrive->CacheBlockHead)
     {
         return FALSE;
     }
 
     RemoveEntryList(&CacheBlockToFree->ListEntry);
+    RemoveEntryList(&CacheBlockToFree->HashListEntry);
 
     // Free the block memory and the block structure
     FrLdrTempFree(CacheBlockToFree->BlockData, TAG_CACHE_DATA);
@@ -187,7 +240,6 @@ VOID CacheInternalCheckCacheSizeLimits(PCACHE_DRIVE CacheDrive)
     if (NewCacheSize > CacheSizeLimit)
     {
         CacheInternalFreeBlock(CacheDrive);
-        CacheInternalDumpBlockList(CacheDrive);
     }
 }
 
@@ -33,11 +33,14 @@ BOOLEAN            CacheManagerDataInvalid = FALSE;
 ULONG            CacheBlockCount = 0;
 SIZE_T            CacheSizeLimit = 0;
 SIZE_T            CacheSizeCurrent = 0;
+CACHE_STATISTICS    CacheStatistics;
 
 BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
 {
     PCACHE_BLOCK    NextCacheBlock;
     GEOMETRY    DriveGeometry;
+    ULONGLONG    DriveSectorCount;
+    ULONG        Idx;
 
     // If we already have a cache for this drive then
     // by all means lets keep it, unless it is a removable
@@ -80,6 +83,10 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     // Initialize the structure
     RtlZeroMemory(&CacheManagerDrive, sizeof(CACHE_DRIVE));
     InitializeListHead(&CacheManagerDrive.CacheBlockHead);
+    for (Idx = 0; Idx < CACHE_HASH_BUCKETS; Idx++)
+    {
+        InitializeListHead(&CacheManagerDrive.CacheHashTable[Idx]);
+    }
     CacheManagerDrive.DriveNumber = DriveNumber;
     if (!MachDiskGetDriveGeometry(DriveNumber, &DriveGeometry))
     {
@@ -87,8 +94,22 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     }
     CacheManagerDrive.BytesPerSector = DriveGeometry.BytesPerSector;
 
-    // Get the number of sectors in each cache block
+    // Get the number of sectors in each cache block,
+    // a block is read through DiskReadBuffer so it must fit in there
     CacheManagerDrive.BlockSize = MachDiskGetCacheableBlockCount(DriveNumber);
+    CacheManagerDrive.BlockSize = min(CacheManagerDrive.BlockSize,
+                                      (ULONG)(DiskReadBufferSize / CacheManagerDrive.BytesPerSector));
+    CacheManagerDrive.BlockSize = max(CacheManagerDrive.BlockSize, 1);
+
+    // Misses read as many blocks as the disk read buffer holds
+    CacheManagerDrive.MaxTransferBlocks = (ULONG)(DiskReadBufferSize /
+        (CacheManagerDrive.BlockSize * CacheManagerDrive.BytesPerSector));
+    CacheManagerDrive.MaxTransferBlocks = max(CacheManagerDrive.MaxTransferBlocks, 1);
+
+    // The drive size, if known, limits the read ahead
+    DriveSectorCount = (ULONGLONG)DriveGeometry.Cylinders * DriveGeometry.Heads * DriveGeometry.Sectors;
+    CacheManagerDrive.BlockCount = (ULONG)min(DriveSectorCount / CacheManagerDrive.BlockSize, MAXULONG);
+    CacheManagerDrive.NextBlock = MAXULONG;
 
     CacheBlockCount = 0;
     CacheSizeCurrent = 0;
@@ -100,6 +121,7 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     TRACE("Initializing BIOS drive 0x%x.\n", DriveNumber);
     TRACE("BytesPerSector: %d.\n", CacheManagerDrive.BytesPerSector);
     TRACE("BlockSize: %d.\n", CacheManagerDrive.BlockSize);
+    TRACE("MaxTransferBlocks: %d.\n", CacheManagerDrive.MaxTransferBlocks);
     TRACE("CacheSizeLimit: %d.\n", CacheSizeLimit);
 
     return TRUE;
@@ -148,7 +170,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, StartBlock);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, StartBlock, BlockCount);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -181,7 +203,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx, BlockCount);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -214,7 +236,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, EndBlock);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, EndBlock, 1);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -274,7 +296,7 @@ BOOLEAN CacheForceDiskSectorsIntoCache(UCHAR DiskNumber, ULONGLONG StartSector,
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx, StartBlock + BlockCount - Idx);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -319,3 +341,14 @@ BOOLEAN CacheReleaseMemory(ULONG MinimumAmountToRelease)
     // Return status
     return (AmountReleased >= MinimumAmountToRelease);
 }
+
+VOID CacheDumpStatistics(VOID)
+{
+#if DBG
+    DbgPrint("Disk cache: %lu block hits, %lu block misses, %lu blocks read ahead\n",
+             CacheStatistics.BlockHits, CacheStatistics.BlockMisses, CacheStatistics.ReadAheadBlocks);
+    DbgPrint("Disk reads: %lu cached transfers (%I64u sectors), %lu uncached transfers (%I64u sectors)\n",
+             CacheStatistics.CachedReads, CacheStatistics.CachedSectors,
+             CacheStatistics.UncachedReads, CacheStatistics.UncachedSectors);
+#endif
+}
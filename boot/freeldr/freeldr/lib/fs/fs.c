@@ -37,6 +37,13 @@ typedef struct tagFILEDATA
     const DEVVTBL* FuncTable;
     const DEVVTBL* FileFuncTable;
     VOID* Specific;
+    PGZIP_FILE GzipFile;
+    /* Read-only files are checked for compression on their first access */
+    BOOLEAN GzipProbe;
+    /* Bytes read by that check, handed out before reading on */
+    ULONG PeekLength;
+    ULONG PeekPosition;
+    UCHAR Peek[GZIP_HEADER_SIZE];
 } FILEDATA;
 
 typedef struct tagDEVICE
@@ -51,8 +58,20 @@ typedef struct tagDEVICE
 static FILEDATA FileData[MAX_FDS];
 static LIST_ENTRY DeviceListHead;
 
+/* Number of bytes read from the device that the caller hasn't seen yet */
+#define PENDING_PEEK(File) ((File)->PeekLength - (File)->PeekPosition)
+
 /* ARC FUNCTIONS **************************************************************/
 
+static VOID ArcProbeGzip(ULONG FileId)
+{
+    FILEDATA* File = &FileData[FileId];
+
+    File->GzipProbe = FALSE;
+    File->GzipFile = GzipOpen(FileId, File->FuncTable, File->Peek, &File->PeekLength);
+    File->PeekPosition = 0;
+}
+
 ARC_STATUS ArcOpen(CHAR* Path, OPENMODE OpenMode, ULONG* FileId)
 {
     ARC_STATUS Status;
@@ -212,6 +231,13 @@ ARC_STATUS ArcOpen(CHAR* Path, OPENMODE OpenMode, ULONG* FileId)
         FileData[i].FuncTable = NULL;
         *FileId = MAX_FDS;
     }
+    else if (OpenMode == OpenReadOnly)
+    {
+        /* Compressed files are inflated transparently while being read.
+         * Don't look yet, many files are opened and never read. */
+        FileData[i].GzipProbe = TRUE;
+        FileData[i].PeekLength = FileData[i].PeekPosition = 0;
+    }
     return Status;
 }
 
@@ -222,6 +248,14 @@ ARC_STATUS ArcClose(ULONG FileId)
     if (FileId >= MAX_FDS || !FileData[FileId].FuncTable)
         return EBADF;
 
+    if (FileData[FileId].GzipFile)
+    {
+        GzipClose(FileData[FileId].GzipFile);
+        FileData[FileId].GzipFile = NULL;
+    }
+    FileData[FileId].GzipProbe = FALSE;
+    FileData[FileId].PeekLength = FileData[FileId].PeekPosition = 0;
+
     Status = FileData[FileId].FuncTable->Close(FileId);
 
     if (Status == ESUCCESS)
@@ -235,23 +269,70 @@ ARC_STATUS ArcClose(ULONG FileId)
 
 ARC_STATUS ArcRead(ULONG FileId, VOID* Buffer, ULONG N, ULONG* Count)
 {
+    FILEDATA* File;
+    ARC_STATUS Status;
+    ULONG Length;
+
     if (FileId >= MAX_FDS || !FileData[FileId].FuncTable)
         return EBADF;
-    return FileData[FileId].FuncTable->Read(FileId, Buffer, N, Count);
+    File = &FileData[FileId];
+    if (File->GzipProbe)
+        ArcProbeGzip(FileId);
+    if (File->GzipFile)
+        return GzipRead(File->GzipFile, Buffer, N, Count);
+
+    Length = min(N, PENDING_PEEK(File));
+    if (Length == 0)
+        return File->FuncTable->Read(FileId, Buffer, N, Count);
+
+    RtlCopyMemory(Buffer, File->Peek + File->PeekPosition, Length);
+    File->PeekPosition += Length;
+
+    Status = ESUCCESS;
+    *Count = 0;
+    if (Length < N)
+        Status = File->FuncTable->Read(FileId, (PUCHAR)Buffer + Length, N - Length, Count);
+    *Count += Length;
+    return Status;
 }
 
 ARC_STATUS ArcSeek(ULONG FileId, LARGE_INTEGER* Position, SEEKMODE SeekMode)
 {
+    FILEDATA* File;
+    LARGE_INTEGER NewPosition = *Position;
+
     if (FileId >= MAX_FDS || !FileData[FileId].FuncTable)
         return EBADF;
-    return FileData[FileId].FuncTable->Seek(FileId, Position, SeekMode);
+    File = &FileData[FileId];
+    if (File->GzipProbe)
+        ArcProbeGzip(FileId);
+    if (File->GzipFile)
+        return GzipSeek(File->GzipFile, Position, SeekMode);
+
+    /* The device is ahead of the caller by what is left to peek */
+    if (SeekMode == SeekRelative)
+        NewPosition.QuadPart -= PENDING_PEEK(File);
+    File->PeekLength = File->PeekPosition = 0;
+    return File->FuncTable->Seek(FileId, &NewPosition, SeekMode);
 }
 
 ARC_STATUS ArcGetFileInformation(ULONG FileId, FILEINFORMATION* Information)
 {
+    FILEDATA* File;
+    ARC_STATUS Status;
+
     if (FileId >= MAX_FDS || !FileData[FileId].FuncTable)
         return EBADF;
-    return FileData[FileId].FuncTable->GetFileInformation(FileId, Information);
+    File = &FileData[FileId];
+    if (File->GzipProbe)
+        ArcProbeGzip(FileId);
+    if (File->GzipFile)
+        return GzipGetFileInformation(File->GzipFile, Information);
+
+    Status = File->FuncTable->GetFileInformation(FileId, Information);
+    if (Status == ESUCCESS)
+        Information->CurrentAddress.QuadPart -= PENDING_PEEK(File);
+    return Status;
 }
 
 /* FUNCTIONS ******************************************************************/
@@ -0,0 +1,337 @@
+/*
+ * PROJECT:     FreeLoader
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Transparent decompression of gzip-compressed files
+ */
+
+/*
+ * Files opened read-only whose contents start with a gzip header are
+ * inflated on the fly while they are read, so that the RAM disk image and
+ * the boot modules can be stored compressed on slow media. The uncompressed
+ * size is taken from the gzip trailer and is what the callers see as the
+ * file size. Forward seeks are done by inflating into a scratch buffer,
+ * backward seeks restart the stream from the beginning of the file.
+ *
+ * The header is only checked on the first access to the file. When it
+ * isn't a gzip header, the bytes read for the check are handed back to the
+ * caller, so uncompressed files never seek. This matters on PXE, where a
+ * backward seek restarts the TFTP transfer.
+ */
+
+#include <freeldr.h>
+
+#define Z_SOLO
+#include <zlib.h>
+
+#include <debug.h>
+DBG_DEFAULT_CHANNEL(FILESYSTEM);
+
+#define TAG_GZIP_FILE 'FzGz'
+#define TAG_GZIP_ZLIB 'ZzGz'
+
+/* Header + empty deflate block (2 bytes) + CRC32 and ISIZE (8 bytes) */
+#define GZIP_TRAILER_SIZE       8
+#define GZIP_MIN_FILE_SIZE      (GZIP_HEADER_SIZE + 2 + GZIP_TRAILER_SIZE)
+
+#define GZIP_INPUT_BUFFER_SIZE  0x10000
+#define GZIP_SKIP_BUFFER_SIZE   0x1000
+
+typedef struct _GZIP_FILE
+{
+    ULONG FileId;
+    const DEVVTBL* FuncTable;
+    ULONG CompressedSize;
+    ULONG CompressedOffset;
+    ULONG Size;
+    ULONG Position;
+    BOOLEAN StreamEnd;
+    z_stream Stream;
+    UCHAR InputBuffer[GZIP_INPUT_BUFFER_SIZE];
+    UCHAR SkipBuffer[GZIP_SKIP_BUFFER_SIZE];
+} GZIP_FILE;
+
+/* FUNCTIONS ******************************************************************/
+
+static voidpf
+GzipAlloc(voidpf opaque, uInt items, uInt size)
+{
+    return FrLdrTempAlloc(items * size, TAG_GZIP_ZLIB);
+}
+
+static void
+GzipFree(voidpf opaque, voidpf address)
+{
+    FrLdrTempFree(address, TAG_GZIP_ZLIB);
+}
+
+static ARC_STATUS
+GzipSeekCompressed(
+    _In_ PGZIP_FILE GzipFile,
+    _In_ ULONG Offset)
+{
+    LARGE_INTEGER Position;
+
+    Position.QuadPart = Offset;
+    return GzipFile->FuncTable->Seek(GzipFile->FileId, &Position, SeekAbsolute);
+}
+
+static ARC_STATUS
+GzipRewind(
+    _In_ PGZIP_FILE GzipFile)
+{
+    ARC_STATUS Status;
+
+    Status = GzipSeekCompressed(GzipFile, 0);
+    if (Status != ESUCCESS)
+        return Status;
+
+    inflateReset(&GzipFile->Stream);
+    GzipFile->Stream.avail_in = 0;
+    GzipFile->CompressedOffset = 0;
+    GzipFile->Position = 0;
+    GzipFile->StreamEnd = FALSE;
+
+    return ESUCCESS;
+}
+
+static ARC_STATUS
+GzipFillInput(
+    _In_ PGZIP_FILE GzipFile)
+{
+    ARC_STATUS Status;
+    ULONG Length, Count;
+
+    Length = min(GzipFile->CompressedSize - GzipFile->CompressedOffset,
+                 GZIP_INPUT_BUFFER_SIZE);
+    if (Length == 0)
+    {
+        ERR("Compressed file %lu is truncated\n", GzipFile->FileId);
+        return EIO;
+    }
+
+    Status = GzipFile->FuncTable->Read(GzipFile->FileId,
+                                       GzipFile->InputBuffer,
+                                       Length,
+                                       &Count);
+    if (Status != ESUCCESS)
+        return Status;
+    if (Count == 0)
+        return EIO;
+
+    GzipFile->CompressedOffset += Count;
+    GzipFile->Stream.next_in = GzipFile->InputBuffer;
+    GzipFile->Stream.avail_in = Count;
+
+    return ESUCCESS;
+}
+
+PGZIP_FILE
+GzipOpen(
+    _In_ ULONG FileId,
+    _In_ const DEVVTBL* FuncTable,
+    _Out_writes_bytes_to_(GZIP_HEADER_SIZE, *HeaderLength) PUCHAR Header,
+    _Out_ PULONG HeaderLength)
+{
+    PGZIP_FILE GzipFile;
+    FILEINFORMATION Information;
+    LARGE_INTEGER Position;
+    UCHAR Trailer[4];
+    ULONG Count;
+    ULONG CompressedSize;
+
+    *HeaderLength = 0;
+
+    if (FuncTable->GetFileInformation(FileId, &Information) != ESUCCESS)
+        return NULL;
+
+    /* Directories and tiny files are never compressed */
+    if (Information.EndingAddress.HighPart != 0 ||
+        Information.EndingAddress.LowPart < GZIP_MIN_FILE_SIZE)
+    {
+        return NULL;
+    }
+    CompressedSize = Information.EndingAddress.LowPart;
+
+    if (FuncTable->Read(FileId, Header, GZIP_HEADER_SIZE, &Count) != ESUCCESS)
+        return NULL;
+
+    /* Check for the gzip magic with the deflate method, otherwise the
+     * caller returns what was read before reading on */
+    if (Count != GZIP_HEADER_SIZE ||
+        Header[0] != 0x1F || Header[1] != 0x8B || Header[2] != Z_DEFLATED)
+    {
+        *HeaderLength = Count;
+        return NULL;
+    }
+
+    /* The uncompressed size modulo 4GB ends the file */
+    Position.QuadPart = CompressedSize - sizeof(Trailer);
+    if (FuncTable->Seek(FileId, &Position, SeekAbsolute) != ESUCCESS ||
+        FuncTable->Read(FileId, Trailer, sizeof(Trailer), &Count) != ESUCCESS ||
+        Count != sizeof(Trailer))
+    {
+        ERR("Cannot read the gzip trailer of file %lu\n", FileId);
+        Count = 0;
+    }
+
+    /* Compressed files are the only ones paying for a seek back to the start */
+    Position.QuadPart = 0;
+    if (FuncTable->Seek(FileId, &Position, SeekAbsolute) != ESUCCESS ||
+        Count != sizeof(Trailer))
+    {
+        return NULL;
+    }
+
+    GzipFile = FrLdrTempAlloc(sizeof(GZIP_FILE), TAG_GZIP_FILE);
+    if (!GzipFile)
+    {
+        ERR("Not enough memory to decompress file %lu\n", FileId);
+        return NULL;
+    }
+    RtlZeroMemory(GzipFile, FIELD_OFFSET(GZIP_FILE, InputBuffer));
+
+    GzipFile->FileId = FileId;
+    GzipFile->FuncTable = FuncTable;
+    GzipFile->CompressedSize = CompressedSize;
+    GzipFile->Size = Trailer[0] | (Trailer[1] << 8) | (Trailer[2] << 16) | ((ULONG)Trailer[3] << 24);
+    GzipFile->Stream.zalloc = GzipAlloc;
+    GzipFile->Stream.zfree = GzipFree;
+
+    /* Let zlib parse the gzip header and check the CRC32 */
+    if (inflateInit2(&GzipFile->Stream, 16 + MAX_WBITS) != Z_OK)
+    {
+        ERR("inflateInit2() failed for file %lu\n", FileId);
+        FrLdrTempFree(GzipFile, TAG_GZIP_FILE);
+        return NULL;
+    }
+
+    TRACE("File %lu is gzip-compressed, %lu bytes inflate to %lu\n",
+          FileId, CompressedSize, GzipFile->Size);
+
+    return GzipFile;
+}
+
+VOID
+GzipClose(
+    _In_ PGZIP_FILE GzipFile)
+{
+    inflateEnd(&GzipFile->Stream);
+    FrLdrTempFree(GzipFile, TAG_GZIP_FILE);
+}
+
+ARC_STATUS
+GzipGetFileInformation(
+    _In_ PGZIP_FILE GzipFile,
+    _Out_ FILEINFORMATION* Information)
+{
+    ARC_STATUS Status;
+
+    Status = GzipFile->FuncTable->GetFileInformation(GzipFile->FileId, Information);
+    if (Status != ESUCCESS)
+        return Status;
+
+    Information->EndingAddress.QuadPart = GzipFile->Size;
+    Information->CurrentAddress.QuadPart = GzipFile->Position;
+
+    return ESUCCESS;
+}
+
+ARC_STATUS
+GzipRead(
+    _In_ PGZIP_FILE GzipFile,
+    _Out_ VOID* Buffer,
+    _In_ ULONG N,
+    _Out_ ULONG* Count)
+{
+    ARC_STATUS Status;
+    BOOLEAN LastRead;
+    int Result;
+
+    *Count = 0;
+
+    N = min(N, GzipFile->Size - GzipFile->Position);
+    if (N == 0)
+        return ESUCCESS;
+
+    /* The last read also consumes the trailer, so that the CRC32 gets checked */
+    LastRead = (GzipFile->Position + N == GzipFile->Size);
+
+    GzipFile->Stream.next_out = Buffer;
+    GzipFile->Stream.avail_out = N;
+
+    while (!GzipFile->StreamEnd &&
+           (GzipFile->Stream.avail_out != 0 || LastRead))
+    {
+        if (GzipFile->Stream.avail_in == 0)
+        {
+            Status = GzipFillInput(GzipFile);
+            if (Status != ESUCCESS)
+                return Status;
+        }
+
+        Result = inflate(&GzipFile->Stream, Z_NO_FLUSH);
+        if (Result == Z_STREAM_END)
+        {
+            GzipFile->StreamEnd = TRUE;
+        }
+        else if (Result != Z_OK)
+        {
+            ERR("inflate() failed for file %lu: %d\n", GzipFile->FileId, Result);
+            return EIO;
+        }
+    }
+
+    *Count = N - GzipFile->Stream.avail_out;
+    GzipFile->Position += *Count;
+
+    /* The stream ended before the size recorded in the trailer */
+    if (*Count != N)
+        return EIO;
+
+    return ESUCCESS;
+}
+
+ARC_STATUS
+GzipSeek(
+    _In_ PGZIP_FILE GzipFile,
+    _In_ LARGE_INTEGER* Position,
+    _In_ SEEKMODE SeekMode)
+{
+    ARC_STATUS Status;
+    LARGE_INTEGER NewPosition = *Position;
+    ULONG Count;
+
+    switch (SeekMode)
+    {
+        case SeekAbsolute:
+            break;
+        case SeekRelative:
+            NewPosition.QuadPart += GzipFile->Position;
+            break;
+        default:
+            ASSERT(FALSE);
+            return EINVAL;
+    }
+
+    if (NewPosition.QuadPart < 0 || NewPosition.QuadPart > GzipFile->Size)
+        return EINVAL;
+
+    if (NewPosition.LowPart < GzipFile->Position)
+    {
+        Status = GzipRewind(GzipFile);
+        if (Status != ESUCCESS)
+            return Status;
+    }
+
+    while (GzipFile->Position < NewPosition.LowPart)
+    {
+        Status = GzipRead(GzipFile,
+                          GzipFile->SkipBuffer,
+                          min(NewPosition.LowPart - GzipFile->Position, GZIP_SKIP_BUFFER_SIZE),
+                          &Count);
+        if (Status != ESUCCESS)
+            return Status;
+    }
+
+    return ESUCCESS;
+}
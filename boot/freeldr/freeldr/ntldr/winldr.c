@@ -953,6 +953,9 @@ LoadAndBootWindowsCommon(
     Success = WinLdrLoadBootDrivers(LoaderBlock, BootPath);
     TRACE("Boot drivers loading %s\n", Success ? "successful" : "failed");
 
+    /* Everything is loaded, show how the disk reads went */
+    CacheDumpStatistics();
+
     /* Cleanup ini file */
     IniCleanup();
 
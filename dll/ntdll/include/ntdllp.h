@@ -8,8 +8,7 @@
 
 #pragma once
 
-#define LDR_HASH_TABLE_ENTRIES 32
-#define LDR_GET_HASH_ENTRY(x) (RtlUpcaseUnicodeChar((x)) & (LDR_HASH_TABLE_ENTRIES - 1))
+#define LDR_HASH_TABLE_ENTRIES 64
 
 /* LdrpUpdateLoadCount2 flags */
 #define LDRP_UPDATE_REFCOUNT   0x01
@@ -96,6 +95,8 @@ NTSTATUS NTAPI
 LdrpWalkImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                          IN PLDR_DATA_TABLE_ENTRY LdrEntry);
 
+VOID NTAPI
+LdrpFreeExportNameHash(IN PVOID DllBase);
 
 /* ldrutils.c */
 NTSTATUS NTAPI
@@ -108,6 +109,9 @@ LdrpGetProcedureAddress(IN PVOID BaseAddress,
 PLDR_DATA_TABLE_ENTRY NTAPI
 LdrpAllocateDataTableEntry(IN PVOID BaseAddress);
 
+ULONG NTAPI
+LdrpHashUnicodeString(IN PCUNICODE_STRING Name);
+
 VOID NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry);
 
@@ -15,9 +15,35 @@
 
 /* GLOBALS *******************************************************************/
 
+/* Images with fewer exported names than this are searched without an index */
+#define LDRP_EXPORT_HASH_MIN_NAMES 64
+#define LDRP_EXPORT_HASH_MAX_NAMES 0x100000
+#define LDRP_EXPORT_HASH_BUCKETS 16
+
+typedef struct _LDRP_EXPORT_NAME_SLOT
+{
+    ULONG Hash;
+    ULONG Index;    /* Index into the name table plus one, 0 if the slot is free */
+} LDRP_EXPORT_NAME_SLOT, *PLDRP_EXPORT_NAME_SLOT;
+
+/* Open addressing hash of the exported names of one image */
+typedef struct _LDRP_EXPORT_NAME_HASH
+{
+    struct _LDRP_EXPORT_NAME_HASH *Next;
+    PVOID DllBase;
+    PULONG NameTable;
+    ULONG NumberOfNames;
+    ULONG Mask;
+    LDRP_EXPORT_NAME_SLOT Slots[ANYSIZE_ARRAY];
+} LDRP_EXPORT_NAME_HASH, *PLDRP_EXPORT_NAME_HASH;
+
 PLDR_MANIFEST_PROBER_ROUTINE LdrpManifestProberRoutine;
 ULONG LdrpNormalSnap;
 
+/* Protected by the loader lock */
+PLDRP_EXPORT_NAME_HASH LdrpExportNameHashes[LDRP_EXPORT_HASH_BUCKETS];
+PLDRP_EXPORT_NAME_HASH LdrpLastExportNameHash;
+
 /* FUNCTIONS *****************************************************************/
 
 
@@ -39,6 +65,9 @@ LdrpSnapIAT(IN PLDR_DATA_TABLE_ENTRY ExportLdrEntry,
     SIZE_T ImportSize;
     DPRINT("LdrpSnapIAT(%wZ %wZ %p %u)\n", &ExportLdrEntry->BaseDllName, &ImportLdrEntry->BaseDllName, IatEntry, EntriesValid);
 
+    /* Bound entries without forwarders are complete, leave the IAT alone */
+    if ((EntriesValid) && (IatEntry->ForwarderChain == (ULONG)-1)) return STATUS_SUCCESS;
+
     /* Get export directory */
     ExportDirectory = RtlImageDirectoryEntryToData(ExportLdrEntry->DllBase,
                                                    TRUE,
@@ -398,8 +427,7 @@ LdrpHandleOneNewFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                         ForwarderName);
             }
 
-            /* Remember it's valid */
-            Stale = FALSE;
+            /* A valid forwarder doesn't make a stale binding valid again */
         }
 
         /* Move to the next one */
@@ -519,7 +547,7 @@ LdrpHandleOneOldFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
 {
     LPSTR ImportName;
     NTSTATUS Status;
-    BOOLEAN AlreadyLoaded = FALSE;
+    BOOLEAN AlreadyLoaded = FALSE, EntriesValid;
     PLDR_DATA_TABLE_ENTRY DllLdrEntry;
     PIMAGE_THUNK_DATA FirstThunk;
     PPEB Peb = NtCurrentPeb();
@@ -562,16 +590,7 @@ LdrpHandleOneOldFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
         return Status;
     }
 
-    /* Show debug message */
-    if (ShowSnaps)
-    {
-        DPRINT1("LDR: Snapping imports for %wZ from %s\n",
-                &LdrEntry->BaseDllName,
-                ImportName);
-    }
-
     /* Check if it wasn't already loaded */
-    ++LdrpNormalSnap;
     if (!AlreadyLoaded)
     {
         /* Add the DLL to our list */
@@ -579,8 +598,28 @@ LdrpHandleOneOldFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                        &DllLdrEntry->InInitializationOrderLinks);
     }
 
+    /*
+     * Old style binding: the IAT already holds the addresses of the image
+     * with this time stamp, loaded at its preferred base. Only forwarders
+     * need snapping then, and those need the original thunks.
+     */
+    EntriesValid = ((*ImportEntry)->TimeDateStamp != 0) &&
+                   ((*ImportEntry)->TimeDateStamp == DllLdrEntry->TimeDateStamp) &&
+                   ((*ImportEntry)->OriginalFirstThunk != 0) &&
+                   !(DllLdrEntry->Flags & LDRP_IMAGE_NOT_AT_BASE);
+
+    /* Show debug message */
+    if (ShowSnaps)
+    {
+        DPRINT1("LDR: %s imports for %wZ from %s\n",
+                EntriesValid ? "Keeping bound" : "Snapping",
+                &LdrEntry->BaseDllName,
+                ImportName);
+    }
+
     /* Now snap the IAT Entry */
-    Status = LdrpSnapIAT(DllLdrEntry, LdrEntry, *ImportEntry, FALSE);
+    if (!EntriesValid) ++LdrpNormalSnap;
+    Status = LdrpSnapIAT(DllLdrEntry, LdrEntry, *ImportEntry, EntriesValid);
     if (!NT_SUCCESS(Status))
     {
         /* Fail */
@@ -623,6 +662,110 @@ LdrpHandleOldFormatImportDescriptors(IN LPWSTR DllPath OPTIONAL,
     return STATUS_SUCCESS;
 }
 
+static
+ULONG
+LdrpHashExportName(IN PCSTR Name)
+{
+    ULONG Hash = 0;
+
+    while (*Name) Hash = Hash * 65599 + (UCHAR)*Name++;
+    return Hash ^ (Hash >> 16);
+}
+
+static
+PLDRP_EXPORT_NAME_HASH *
+LdrpExportNameHashBucket(IN PVOID DllBase)
+{
+    return &LdrpExportNameHashes[((ULONG_PTR)DllBase >> 16) &
+                                 (LDRP_EXPORT_HASH_BUCKETS - 1)];
+}
+
+VOID
+NTAPI
+LdrpFreeExportNameHash(IN PVOID DllBase)
+{
+    PLDRP_EXPORT_NAME_HASH *Link, ExportHash;
+
+    /* Find the index of this image and unlink it */
+    for (Link = LdrpExportNameHashBucket(DllBase); *Link; Link = &(*Link)->Next)
+    {
+        ExportHash = *Link;
+        if (ExportHash->DllBase != DllBase) continue;
+
+        *Link = ExportHash->Next;
+        if (LdrpLastExportNameHash == ExportHash) LdrpLastExportNameHash = NULL;
+        RtlFreeHeap(LdrpHeap, 0, ExportHash);
+        return;
+    }
+}
+
+static
+PLDRP_EXPORT_NAME_HASH
+LdrpGetExportNameHash(IN PVOID ExportBase,
+                      IN ULONG NumberOfNames,
+                      IN PULONG NameTable)
+{
+    PLDRP_EXPORT_NAME_HASH *Bucket, ExportHash;
+    ULONG Size, i, Slot;
+
+    /* Consecutive lookups almost always go to the same image */
+    ExportHash = LdrpLastExportNameHash;
+    if ((ExportHash) && (ExportHash->DllBase == ExportBase)) goto Found;
+
+    Bucket = LdrpExportNameHashBucket(ExportBase);
+    for (ExportHash = *Bucket; ExportHash; ExportHash = ExportHash->Next)
+    {
+        if (ExportHash->DllBase == ExportBase) goto Found;
+    }
+
+    /* Small export tables are cheap enough to search directly */
+    if ((NumberOfNames < LDRP_EXPORT_HASH_MIN_NAMES) ||
+        (NumberOfNames > LDRP_EXPORT_HASH_MAX_NAMES))
+    {
+        return NULL;
+    }
+
+    /* Keep the table at most half full */
+    Size = LDRP_EXPORT_HASH_MIN_NAMES * 2;
+    while (Size < NumberOfNames * 2) Size <<= 1;
+
+    ExportHash = RtlAllocateHeap(LdrpHeap,
+                                 HEAP_ZERO_MEMORY,
+                                 FIELD_OFFSET(LDRP_EXPORT_NAME_HASH, Slots[Size]));
+    if (!ExportHash) return NULL;
+
+    ExportHash->DllBase = ExportBase;
+    ExportHash->NameTable = NameTable;
+    ExportHash->NumberOfNames = NumberOfNames;
+    ExportHash->Mask = Size - 1;
+
+    /* Index every name; the first of duplicate names wins */
+    for (i = 0; i < NumberOfNames; i++)
+    {
+        ULONG Hash = LdrpHashExportName((PCSTR)((ULONG_PTR)ExportBase + NameTable[i]));
+
+        Slot = Hash & ExportHash->Mask;
+        while (ExportHash->Slots[Slot].Index) Slot = (Slot + 1) & ExportHash->Mask;
+
+        ExportHash->Slots[Slot].Hash = Hash;
+        ExportHash->Slots[Slot].Index = i + 1;
+    }
+
+    ExportHash->Next = *Bucket;
+    *Bucket = ExportHash;
+
+Found:
+    /* The index is only good for the export table it was built from */
+    if ((ExportHash->NameTable != NameTable) ||
+        (ExportHash->NumberOfNames != NumberOfNames))
+    {
+        return NULL;
+    }
+
+    LdrpLastExportNameHash = ExportHash;
+    return ExportHash;
+}
+
 USHORT
 NTAPI
 LdrpNameToOrdinal(IN LPSTR ImportName,
@@ -631,8 +774,32 @@ LdrpNameToOrdinal(IN LPSTR ImportName,
                   IN PULONG NameTable,
                   IN PUSHORT OrdinalTable)
 {
+    PLDRP_EXPORT_NAME_HASH ExportHash;
+    ULONG Hash, Slot;
     LONG Start, End, Next, CmpResult;
 
+    /* Use the export name index of the image, built on first use */
+    ExportHash = LdrpGetExportNameHash(ExportBase, NumberOfNames, NameTable);
+    if (ExportHash)
+    {
+        Hash = LdrpHashExportName(ImportName);
+        for (Slot = Hash & ExportHash->Mask;
+             ExportHash->Slots[Slot].Index;
+             Slot = (Slot + 1) & ExportHash->Mask)
+        {
+            if (ExportHash->Slots[Slot].Hash != Hash) continue;
+
+            Next = ExportHash->Slots[Slot].Index - 1;
+            if (!strcmp(ImportName, (PCHAR)((ULONG_PTR)ExportBase + NameTable[Next])))
+            {
+                return OrdinalTable[Next];
+            }
+        }
+
+        /* Every name is indexed, so this one isn't exported */
+        return -1;
+    }
+
     /* Use classical binary search to find the ordinal */
     Start = Next = 0;
     End = NumberOfNames - 1;
@@ -1574,6 +1574,28 @@ LdrpAllocateDataTableEntry(IN PVOID BaseAddress)
     return LdrEntry;
 }
 
+ULONG
+NTAPI
+LdrpHashUnicodeString(IN PCUNICODE_STRING Name)
+{
+    ULONG Hash = 0;
+    USHORT i;
+
+    /*
+     * Hash the whole base name, not just its first letter. Upcase the same
+     * way RtlEqualUnicodeString does, so that names it considers equal
+     * always end up in the same bucket.
+     */
+    for (i = 0; i < Name->Length / sizeof(WCHAR); i++)
+    {
+        Hash = Hash * 65599 + RtlUpcaseUnicodeChar(Name->Buffer[i]);
+    }
+
+    /* Fold the high bits in, the low ones alone mix poorly */
+    Hash ^= Hash >> 16;
+    return Hash & (LDR_HASH_TABLE_ENTRIES - 1);
+}
+
 VOID
 NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
@@ -1582,7 +1604,7 @@ LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
     ULONG i;
 
     /* Insert into hash table */
-    i = LDR_GET_HASH_ENTRY(LdrEntry->BaseDllName.Buffer[0]);
+    i = LdrpHashUnicodeString(&LdrEntry->BaseDllName);
     InsertTailList(&LdrpHashTable[i], &LdrEntry->HashLinks);
 
     /* Insert into other lists */
@@ -1609,6 +1631,9 @@ LdrpFinalizeAndDeallocateDataTableEntry(IN PLDR_DATA_TABLE_ENTRY Entry)
     /* Release the full dll name string */
     if (Entry->FullDllName.Buffer) LdrpFreeUnicodeString(&Entry->FullDllName);
 
+    /* Drop the export name index built for this image, if any */
+    LdrpFreeExportNameHash(Entry->DllBase);
+
     /* Finally free the entry's memory */
     RtlFreeHeap(LdrpHeap, 0, Entry);
 }
@@ -2009,7 +2034,7 @@ lookinhash:
         /* FIXME: if we get redirected dll it means that we also get a full path so we need to find its filename for the hash lookup */
 
         /* Get hash index */
-        HashIndex = LDR_GET_HASH_ENTRY(DllName->Buffer[0]);
+        HashIndex = LdrpHashUnicodeString(DllName);
 
         /* Traverse that list */
         ListHead = &LdrpHashTable[HashIndex];
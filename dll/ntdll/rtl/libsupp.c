@@ -125,7 +125,8 @@ NTSTATUS
 NTAPI
 RtlInitializeHeapLock(IN OUT PHEAP_LOCK *Lock)
 {
-    return RtlInitializeCriticalSection(&(*Lock)->CriticalSection);
+    /* Heap locks are held briefly, spin before waiting like Windows does */
+    return RtlInitializeCriticalSectionAndSpinCount(&(*Lock)->CriticalSection, 4000);
 }
 
 NTSTATUS
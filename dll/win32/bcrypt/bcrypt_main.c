@@ -31,7 +31,13 @@
 #include <wine/unicode.h>
 #include <wine/library.h>
 
-#ifdef SONAME_LIBMBEDTLS
+#include <aesmodes.h>
+
+#ifdef __REACTOS__
+#include <md5.h>
+#include <sha1.h>
+#include <sha2.h>
+#elif defined(SONAME_LIBMBEDTLS)
 #include <mbedtls/md.h>
 #include <mbedtls/md5.h>
 #include <mbedtls/sha1.h>
@@ -254,6 +260,7 @@ NTSTATUS WINAPI BCryptEnumAlgorithms(ULONG dwAlgOperations, ULONG *pAlgCount,
 
 #define MAGIC_ALG  (('A' << 24) | ('L' << 16) | ('G' << 8) | '0')
 #define MAGIC_HASH (('H' << 24) | ('A' << 16) | ('S' << 8) | 'H')
+#define MAGIC_KEY  (('K' << 24) | ('E' << 16) | ('Y' << 8) | '0')
 struct object
 {
     ULONG magic;
@@ -261,6 +268,7 @@ struct object
 
 enum alg_id
 {
+    ALG_ID_AES,
     ALG_ID_MD5,
     ALG_ID_RNG,
     ALG_ID_SHA1,
@@ -273,6 +281,7 @@ static const struct {
     ULONG hash_length;
     const WCHAR *alg_name;
 } alg_props[] = {
+    /* ALG_ID_AES    */ {  0, BCRYPT_AES_ALGORITHM },
     /* ALG_ID_MD5    */ { 16, BCRYPT_MD5_ALGORITHM },
     /* ALG_ID_RNG    */ {  0, BCRYPT_RNG_ALGORITHM },
     /* ALG_ID_SHA1   */ { 20, BCRYPT_SHA1_ALGORITHM },
@@ -281,10 +290,18 @@ static const struct {
     /* ALG_ID_SHA512 */ { 64, BCRYPT_SHA512_ALGORITHM }
 };
 
+enum mode_id
+{
+    MODE_ID_ECB,
+    MODE_ID_CBC,
+    MODE_ID_GCM
+};
+
 struct algorithm
 {
     struct object hdr;
     enum alg_id   id;
+    enum mode_id  mode;
     BOOL hmac;
 };
 
@@ -345,7 +362,8 @@ NTSTATUS WINAPI BCryptOpenAlgorithmProvider( BCRYPT_ALG_HANDLE *handle, LPCWSTR
         return STATUS_NOT_IMPLEMENTED;
     }
 
-    if (!strcmpW( id, BCRYPT_SHA1_ALGORITHM )) alg_id = ALG_ID_SHA1;
+    if (!strcmpW( id, BCRYPT_AES_ALGORITHM )) alg_id = ALG_ID_AES;
+    else if (!strcmpW( id, BCRYPT_SHA1_ALGORITHM )) alg_id = ALG_ID_SHA1;
     else if (!strcmpW( id, BCRYPT_MD5_ALGORITHM )) alg_id = ALG_ID_MD5;
     else if (!strcmpW( id, BCRYPT_RNG_ALGORITHM )) alg_id = ALG_ID_RNG;
     else if (!strcmpW( id, BCRYPT_SHA256_ALGORITHM )) alg_id = ALG_ID_SHA256;
@@ -365,6 +383,7 @@ NTSTATUS WINAPI BCryptOpenAlgorithmProvider( BCRYPT_ALG_HANDLE *handle, LPCWSTR
     if (!(alg = HeapAlloc( GetProcessHeap(), 0, sizeof(*alg) ))) return STATUS_NO_MEMORY;
     alg->hdr.magic = MAGIC_ALG;
     alg->id        = alg_id;
+    alg->mode      = MODE_ID_CBC;
     alg->hmac      = flags & BCRYPT_ALG_HANDLE_HMAC_FLAG;
 
     *handle = alg;
@@ -657,6 +676,161 @@ static NTSTATUS hmac_finish( struct hash *hash, UCHAR *output, ULONG size )
     pgnutls_hmac_deinit( hash->u.hmac_handle, output );
     return STATUS_SUCCESS;
 }
+#elif defined(__REACTOS__)
+union hash_state
+{
+    MD5_CTX    md5;
+    SHA_CTX    sha1;
+    SHA256_CTX sha256;
+    SHA512_CTX sha512;
+};
+
+struct hash
+{
+    struct object    hdr;
+    enum alg_id      alg_id;
+    BOOL hmac;
+    union hash_state inner;
+    union hash_state outer;
+};
+
+#define HMAC_PAD_LENGTH_MAX 128
+
+static ULONG hash_block_length( enum alg_id id )
+{
+    return (id == ALG_ID_SHA384 || id == ALG_ID_SHA512) ? 128 : 64;
+}
+
+static void hash_state_init( union hash_state *state, enum alg_id id )
+{
+    switch (id)
+    {
+    case ALG_ID_MD5:    MD5Init( &state->md5 ); break;
+    case ALG_ID_SHA1:   A_SHAInit( &state->sha1 ); break;
+    case ALG_ID_SHA256: SHA256Init( &state->sha256 ); break;
+    case ALG_ID_SHA384: SHA384Init( &state->sha512 ); break;
+    case ALG_ID_SHA512: SHA512Init( &state->sha512 ); break;
+    default: break;
+    }
+}
+
+static void hash_state_update( union hash_state *state, enum alg_id id, const UCHAR *input, ULONG size )
+{
+    switch (id)
+    {
+    case ALG_ID_MD5:    MD5Update( &state->md5, input, size ); break;
+    case ALG_ID_SHA1:   A_SHAUpdate( &state->sha1, input, size ); break;
+    case ALG_ID_SHA256: SHA256Update( &state->sha256, input, size ); break;
+    case ALG_ID_SHA384:
+    case ALG_ID_SHA512: SHA512Update( &state->sha512, input, size ); break;
+    default: break;
+    }
+}
+
+static void hash_state_finish( union hash_state *state, enum alg_id id, UCHAR *output )
+{
+    ULONG sha1[5];
+
+    switch (id)
+    {
+    case ALG_ID_MD5:
+        MD5Final( &state->md5 );
+        memcpy( output, state->md5.digest, sizeof(state->md5.digest) );
+        break;
+
+    case ALG_ID_SHA1:
+        A_SHAFinal( &state->sha1, sha1 );
+        memcpy( output, sha1, sizeof(sha1) );
+        break;
+
+    case ALG_ID_SHA256: SHA256Final( &state->sha256, output ); break;
+    case ALG_ID_SHA384: SHA384Final( &state->sha512, output ); break;
+    case ALG_ID_SHA512: SHA512Final( &state->sha512, output ); break;
+    default: break;
+    }
+}
+
+static NTSTATUS hash_init( struct hash *hash )
+{
+    switch (hash->alg_id)
+    {
+    case ALG_ID_MD5:
+    case ALG_ID_SHA1:
+    case ALG_ID_SHA256:
+    case ALG_ID_SHA384:
+    case ALG_ID_SHA512:
+        break;
+
+    default:
+        ERR( "unhandled id %u\n", hash->alg_id );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+
+    hash_state_init( &hash->inner, hash->alg_id );
+    return STATUS_SUCCESS;
+}
+
+/* RFC 2104: H((K ^ opad) || H((K ^ ipad) || text)) */
+static NTSTATUS hmac_init( struct hash *hash, UCHAR *key, ULONG key_size )
+{
+    UCHAR pad[HMAC_PAD_LENGTH_MAX], digest[64];
+    ULONG block_length, i;
+    NTSTATUS status;
+
+    if ((status = hash_init( hash ))) return status;
+
+    block_length = hash_block_length( hash->alg_id );
+    if (key_size > block_length)
+    {
+        hash_state_update( &hash->inner, hash->alg_id, key, key_size );
+        hash_state_finish( &hash->inner, hash->alg_id, digest );
+        key = digest;
+        key_size = alg_props[hash->alg_id].hash_length;
+    }
+
+    memset( pad, 0, block_length );
+    if (key_size) memcpy( pad, key, key_size );
+
+    for (i = 0; i < block_length; i++) pad[i] ^= 0x36;
+    hash_state_init( &hash->inner, hash->alg_id );
+    hash_state_update( &hash->inner, hash->alg_id, pad, block_length );
+
+    for (i = 0; i < block_length; i++) pad[i] ^= 0x36 ^ 0x5c;
+    hash_state_init( &hash->outer, hash->alg_id );
+    hash_state_update( &hash->outer, hash->alg_id, pad, block_length );
+
+    SecureZeroMemory( pad, sizeof(pad) );
+    SecureZeroMemory( digest, sizeof(digest) );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hash_update( struct hash *hash, UCHAR *input, ULONG size )
+{
+    hash_state_update( &hash->inner, hash->alg_id, input, size );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hmac_update( struct hash *hash, UCHAR *input, ULONG size )
+{
+    hash_state_update( &hash->inner, hash->alg_id, input, size );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hash_finish( struct hash *hash, UCHAR *output, ULONG size )
+{
+    hash_state_finish( &hash->inner, hash->alg_id, output );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hmac_finish( struct hash *hash, UCHAR *output, ULONG size )
+{
+    UCHAR digest[64];
+
+    hash_state_finish( &hash->inner, hash->alg_id, digest );
+    hash_state_update( &hash->outer, hash->alg_id, digest, alg_props[hash->alg_id].hash_length );
+    hash_state_finish( &hash->outer, hash->alg_id, output );
+    return STATUS_SUCCESS;
+}
 #elif defined(SONAME_LIBMBEDTLS)
 struct hash
 {
@@ -856,6 +1030,9 @@ static NTSTATUS hmac_finish( struct hash *hash, UCHAR *output, ULONG size )
 #define OBJECT_LENGTH_SHA256    286
 #define OBJECT_LENGTH_SHA384    382
 #define OBJECT_LENGTH_SHA512    382
+#define OBJECT_LENGTH_AES       654
+
+#define BLOCK_LENGTH_AES        16
 
 static NTSTATUS generic_alg_property( enum alg_id id, const WCHAR *prop, UCHAR *buf, ULONG size, ULONG *ret_size )
 {
@@ -882,7 +1059,66 @@ static NTSTATUS generic_alg_property( enum alg_id id, const WCHAR *prop, UCHAR *
     return STATUS_NOT_IMPLEMENTED;
 }
 
-static NTSTATUS get_alg_property( enum alg_id id, const WCHAR *prop, UCHAR *buf, ULONG size, ULONG *ret_size )
+static NTSTATUS get_aes_property( enum mode_id mode, const WCHAR *prop, UCHAR *buf, ULONG size, ULONG *ret_size )
+{
+    if (!strcmpW( prop, BCRYPT_CHAINING_MODE ))
+    {
+        const WCHAR *name;
+
+        switch (mode)
+        {
+        case MODE_ID_ECB: name = BCRYPT_CHAIN_MODE_ECB; break;
+        case MODE_ID_CBC: name = BCRYPT_CHAIN_MODE_CBC; break;
+        case MODE_ID_GCM: name = BCRYPT_CHAIN_MODE_GCM; break;
+        default: return STATUS_NOT_IMPLEMENTED;
+        }
+
+        *ret_size = (strlenW(name) + 1) * sizeof(WCHAR);
+        if (size < *ret_size)
+            return STATUS_BUFFER_TOO_SMALL;
+        if (buf)
+            memcpy( buf, name, *ret_size );
+        return STATUS_SUCCESS;
+    }
+
+    if (!strcmpW( prop, BCRYPT_KEY_LENGTHS ))
+    {
+        BCRYPT_KEY_LENGTHS_STRUCT *key_lengths = (void *)buf;
+
+        *ret_size = sizeof(*key_lengths);
+        if (key_lengths && size < *ret_size)
+            return STATUS_BUFFER_TOO_SMALL;
+        if (key_lengths)
+        {
+            key_lengths->dwMinLength = 128;
+            key_lengths->dwMaxLength = 256;
+            key_lengths->dwIncrement = 64;
+        }
+        return STATUS_SUCCESS;
+    }
+
+    if (!strcmpW( prop, BCRYPT_AUTH_TAG_LENGTH ))
+    {
+        BCRYPT_AUTH_TAG_LENGTHS_STRUCT *tag_lengths = (void *)buf;
+
+        if (mode != MODE_ID_GCM)
+            return STATUS_NOT_SUPPORTED;
+        *ret_size = sizeof(*tag_lengths);
+        if (tag_lengths && size < *ret_size)
+            return STATUS_BUFFER_TOO_SMALL;
+        if (tag_lengths)
+        {
+            tag_lengths->dwMinLength = 12;
+            tag_lengths->dwMaxLength = 16;
+            tag_lengths->dwIncrement = 1;
+        }
+        return STATUS_SUCCESS;
+    }
+
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS get_alg_property( enum alg_id id, enum mode_id mode, const WCHAR *prop, UCHAR *buf, ULONG size, ULONG *ret_size )
 {
     NTSTATUS status;
     ULONG value;
@@ -893,6 +1129,22 @@ static NTSTATUS get_alg_property( enum alg_id id, const WCHAR *prop, UCHAR *buf,
 
     switch (id)
     {
+    case ALG_ID_AES:
+        if (!strcmpW( prop, BCRYPT_OBJECT_LENGTH ))
+        {
+            value = OBJECT_LENGTH_AES;
+            break;
+        }
+        if (!strcmpW( prop, BCRYPT_BLOCK_LENGTH ))
+        {
+            value = BLOCK_LENGTH_AES;
+            break;
+        }
+        status = get_aes_property( mode, prop, buf, size, ret_size );
+        if (status == STATUS_NOT_IMPLEMENTED)
+            FIXME( "unsupported aes algorithm property %s\n", debugstr_w(prop) );
+        return status;
+
     case ALG_ID_MD5:
         if (!strcmpW( prop, BCRYPT_OBJECT_LENGTH ))
         {
@@ -969,6 +1221,35 @@ static NTSTATUS get_hash_property( enum alg_id id, const WCHAR *prop, UCHAR *buf
     return status;
 }
 
+struct key
+{
+    struct object hdr;
+    enum alg_id   alg_id;
+    enum mode_id  mode;
+    ULONG         block_size;
+    AES_CONTEXT   aes;
+};
+
+static NTSTATUS get_key_property( const struct key *key, const WCHAR *prop, UCHAR *buf, ULONG size, ULONG *ret_size )
+{
+    NTSTATUS status;
+
+    if (!strcmpW( prop, BCRYPT_BLOCK_LENGTH ))
+    {
+        *ret_size = sizeof(ULONG);
+        if (size < sizeof(ULONG))
+            return STATUS_BUFFER_TOO_SMALL;
+        if (buf)
+            *(ULONG *)buf = key->block_size;
+        return STATUS_SUCCESS;
+    }
+
+    status = get_aes_property( key->mode, prop, buf, size, ret_size );
+    if (status == STATUS_NOT_IMPLEMENTED)
+        FIXME( "unsupported key property %s\n", debugstr_w(prop) );
+    return status;
+}
+
 NTSTATUS WINAPI BCryptGetProperty( BCRYPT_HANDLE handle, LPCWSTR prop, UCHAR *buffer, ULONG count, ULONG *res, ULONG flags )
 {
     struct object *object = handle;
@@ -983,13 +1264,18 @@ NTSTATUS WINAPI BCryptGetProperty( BCRYPT_HANDLE handle, LPCWSTR prop, UCHAR *bu
     case MAGIC_ALG:
     {
         const struct algorithm *alg = (const struct algorithm *)object;
-        return get_alg_property( alg->id, prop, buffer, count, res );
+        return get_alg_property( alg->id, alg->mode, prop, buffer, count, res );
     }
     case MAGIC_HASH:
     {
         const struct hash *hash = (const struct hash *)object;
         return get_hash_property( hash->alg_id, prop, buffer, count, res );
     }
+    case MAGIC_KEY:
+    {
+        const struct key *key = (const struct key *)object;
+        return get_key_property( key, prop, buffer, count, res );
+    }
     default:
         WARN( "unknown magic %08x\n", object->magic );
         return STATUS_INVALID_HANDLE;
@@ -1119,6 +1405,275 @@ NTSTATUS WINAPI BCryptHash( BCRYPT_ALG_HANDLE algorithm, UCHAR *secret, ULONG se
     return BCryptDestroyHash( handle );
 }
 
+static NTSTATUS set_aes_property( enum mode_id *mode, const WCHAR *prop, UCHAR *value, ULONG size )
+{
+    if (!strcmpW( prop, BCRYPT_CHAINING_MODE ))
+    {
+        if (!strcmpW( (WCHAR *)value, BCRYPT_CHAIN_MODE_ECB )) *mode = MODE_ID_ECB;
+        else if (!strcmpW( (WCHAR *)value, BCRYPT_CHAIN_MODE_CBC )) *mode = MODE_ID_CBC;
+        else if (!strcmpW( (WCHAR *)value, BCRYPT_CHAIN_MODE_GCM )) *mode = MODE_ID_GCM;
+        else
+        {
+            FIXME( "unsupported mode %s\n", debugstr_w((WCHAR *)value) );
+            return STATUS_NOT_IMPLEMENTED;
+        }
+        return STATUS_SUCCESS;
+    }
+
+    FIXME( "unsupported aes property %s\n", debugstr_w(prop) );
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+NTSTATUS WINAPI BCryptSetProperty( BCRYPT_HANDLE handle, LPCWSTR prop, UCHAR *value, ULONG size, ULONG flags )
+{
+    struct object *object = handle;
+
+    TRACE( "%p, %s, %p, %u, %08x\n", handle, debugstr_w(prop), value, size, flags );
+
+    if (!object) return STATUS_INVALID_HANDLE;
+    if (!prop || !value) return STATUS_INVALID_PARAMETER;
+
+    switch (object->magic)
+    {
+    case MAGIC_ALG:
+    {
+        struct algorithm *alg = (struct algorithm *)object;
+        if (alg->id == ALG_ID_AES)
+            return set_aes_property( &alg->mode, prop, value, size );
+        FIXME( "unsupported algorithm property %s\n", debugstr_w(prop) );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    case MAGIC_KEY:
+    {
+        struct key *key = (struct key *)object;
+        return set_aes_property( &key->mode, prop, value, size );
+    }
+    default:
+        WARN( "unknown magic %08x\n", object->magic );
+        return STATUS_INVALID_HANDLE;
+    }
+}
+
+NTSTATUS WINAPI BCryptGenerateSymmetricKey( BCRYPT_ALG_HANDLE algorithm, BCRYPT_KEY_HANDLE *handle,
+                                            UCHAR *object, ULONG object_len, UCHAR *secret, ULONG secret_len,
+                                            ULONG flags )
+{
+    struct algorithm *alg = algorithm;
+    struct key *key;
+
+    TRACE( "%p, %p, %p, %u, %p, %u, %08x\n", algorithm, handle, object, object_len, secret, secret_len, flags );
+
+    if (!alg || alg->hdr.magic != MAGIC_ALG) return STATUS_INVALID_HANDLE;
+    if (alg->id != ALG_ID_AES)
+    {
+        FIXME( "algorithm %u not supported\n", alg->id );
+        return STATUS_NOT_SUPPORTED;
+    }
+    if (!handle || !secret) return STATUS_INVALID_PARAMETER;
+    if (object) FIXME( "ignoring object buffer\n" );
+
+    if (!(key = HeapAlloc( GetProcessHeap(), 0, sizeof(*key) ))) return STATUS_NO_MEMORY;
+    if (!AesSetKey( &key->aes, secret, secret_len ))
+    {
+        HeapFree( GetProcessHeap(), 0, key );
+        return STATUS_INVALID_PARAMETER;
+    }
+    key->hdr.magic  = MAGIC_KEY;
+    key->alg_id     = alg->id;
+    key->mode       = alg->mode;
+    key->block_size = BLOCK_LENGTH_AES;
+
+    *handle = key;
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WINAPI BCryptDestroyKey( BCRYPT_KEY_HANDLE handle )
+{
+    struct key *key = handle;
+
+    TRACE( "%p\n", handle );
+
+    if (!key || key->hdr.magic != MAGIC_KEY) return STATUS_INVALID_HANDLE;
+    SecureZeroMemory( key, sizeof(*key) );
+    HeapFree( GetProcessHeap(), 0, key );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS check_auth_info( const BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO *auth_info, ULONG flags )
+{
+    if (!auth_info || !auth_info->pbNonce || auth_info->cbNonce != 12) return STATUS_INVALID_PARAMETER;
+    if (!auth_info->pbTag || auth_info->cbTag < 12 || auth_info->cbTag > 16) return STATUS_INVALID_PARAMETER;
+    if (auth_info->cbAuthData && !auth_info->pbAuthData) return STATUS_INVALID_PARAMETER;
+    if (auth_info->dwFlags & BCRYPT_AUTH_MODE_CHAIN_CALLS_FLAG)
+    {
+        FIXME( "call chaining not implemented\n" );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    if (flags & BCRYPT_BLOCK_PADDING) return STATUS_INVALID_PARAMETER;
+    return STATUS_SUCCESS;
+}
+
+/* CBC continues from the caller's IV and updates it, like native does */
+static NTSTATUS check_iv( const struct key *key, UCHAR **iv, ULONG iv_len, UCHAR *zero_iv )
+{
+    if (key->mode == MODE_ID_ECB) return *iv ? STATUS_INVALID_PARAMETER : STATUS_SUCCESS;
+    if (!*iv)
+    {
+        memset( zero_iv, 0, key->block_size );
+        *iv = zero_iv;
+    }
+    else if (iv_len != key->block_size) return STATUS_INVALID_PARAMETER;
+    return STATUS_SUCCESS;
+}
+
+static void encrypt_blocks( struct key *key, UCHAR *iv, const UCHAR *input, UCHAR *output, ULONG blocks )
+{
+    if (key->mode == MODE_ID_ECB)
+        AesEncryptEcb( &key->aes, input, output, blocks );
+    else
+        AesEncryptCbc( &key->aes, iv, input, output, blocks );
+}
+
+static void decrypt_blocks( struct key *key, UCHAR *iv, const UCHAR *input, UCHAR *output, ULONG blocks )
+{
+    if (key->mode == MODE_ID_ECB)
+        AesDecryptEcb( &key->aes, input, output, blocks );
+    else
+        AesDecryptCbc( &key->aes, iv, input, output, blocks );
+}
+
+NTSTATUS WINAPI BCryptEncrypt( BCRYPT_KEY_HANDLE handle, UCHAR *input, ULONG input_len, void *padding, UCHAR *iv,
+                               ULONG iv_len, UCHAR *output, ULONG output_len, ULONG *ret_len, ULONG flags )
+{
+    struct key *key = handle;
+    UCHAR zero_iv[BLOCK_LENGTH_AES], block[BLOCK_LENGTH_AES];
+    ULONG bytes, pad;
+    NTSTATUS status;
+
+    TRACE( "%p, %p, %u, %p, %p, %u, %p, %u, %p, %08x\n", handle, input, input_len, padding, iv, iv_len, output,
+           output_len, ret_len, flags );
+
+    if (!key || key->hdr.magic != MAGIC_KEY) return STATUS_INVALID_HANDLE;
+    if (!ret_len) return STATUS_INVALID_PARAMETER;
+    if (flags & ~BCRYPT_BLOCK_PADDING)
+    {
+        FIXME( "flags %08x not implemented\n", flags );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+
+    if (key->mode == MODE_ID_GCM)
+    {
+        BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO *auth_info = padding;
+
+        if ((status = check_auth_info( auth_info, flags ))) return status;
+        *ret_len = input_len;
+        if (!output) return STATUS_SUCCESS;
+        if (output_len < input_len) return STATUS_BUFFER_TOO_SMALL;
+
+        AesEncryptGcm( &key->aes, auth_info->pbNonce, auth_info->cbNonce,
+                       auth_info->pbAuthData, auth_info->cbAuthData,
+                       input, output, input_len, auth_info->pbTag, auth_info->cbTag );
+        return STATUS_SUCCESS;
+    }
+
+    *ret_len = input_len;
+    if (flags & BCRYPT_BLOCK_PADDING)
+        *ret_len = (input_len + key->block_size) & ~(key->block_size - 1);
+    else if (input_len & (key->block_size - 1))
+        return STATUS_INVALID_BUFFER_SIZE;
+
+    if (!output) return STATUS_SUCCESS;
+    if (output_len < *ret_len) return STATUS_BUFFER_TOO_SMALL;
+    if ((status = check_iv( key, &iv, iv_len, zero_iv ))) return status;
+
+    bytes = input_len & ~(key->block_size - 1);
+    if (bytes) encrypt_blocks( key, iv, input, output, bytes / key->block_size );
+
+    if (flags & BCRYPT_BLOCK_PADDING)
+    {
+        pad = key->block_size - (input_len - bytes);
+        memcpy( block, input + bytes, input_len - bytes );
+        memset( block + input_len - bytes, pad, pad );
+        encrypt_blocks( key, iv, block, output + bytes, 1 );
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS WINAPI BCryptDecrypt( BCRYPT_KEY_HANDLE handle, UCHAR *input, ULONG input_len, void *padding, UCHAR *iv,
+                               ULONG iv_len, UCHAR *output, ULONG output_len, ULONG *ret_len, ULONG flags )
+{
+    struct key *key = handle;
+    UCHAR zero_iv[BLOCK_LENGTH_AES], block[BLOCK_LENGTH_AES], last[BLOCK_LENGTH_AES];
+    ULONG bytes, pad, i;
+    NTSTATUS status;
+
+    TRACE( "%p, %p, %u, %p, %p, %u, %p, %u, %p, %08x\n", handle, input, input_len, padding, iv, iv_len, output,
+           output_len, ret_len, flags );
+
+    if (!key || key->hdr.magic != MAGIC_KEY) return STATUS_INVALID_HANDLE;
+    if (!ret_len) return STATUS_INVALID_PARAMETER;
+    if (flags & ~BCRYPT_BLOCK_PADDING)
+    {
+        FIXME( "flags %08x not implemented\n", flags );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+
+    if (key->mode == MODE_ID_GCM)
+    {
+        BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO *auth_info = padding;
+
+        if ((status = check_auth_info( auth_info, flags ))) return status;
+        *ret_len = input_len;
+        if (!output) return STATUS_SUCCESS;
+        if (output_len < input_len) return STATUS_BUFFER_TOO_SMALL;
+
+        if (!AesDecryptGcm( &key->aes, auth_info->pbNonce, auth_info->cbNonce,
+                            auth_info->pbAuthData, auth_info->cbAuthData,
+                            input, output, input_len, auth_info->pbTag, auth_info->cbTag ))
+            return STATUS_AUTH_TAG_MISMATCH;
+        return STATUS_SUCCESS;
+    }
+
+    *ret_len = input_len;
+    if (input_len & (key->block_size - 1)) return STATUS_INVALID_BUFFER_SIZE;
+    if (!output) return STATUS_SUCCESS;
+    if ((status = check_iv( key, &iv, iv_len, zero_iv ))) return status;
+
+    if (!(flags & BCRYPT_BLOCK_PADDING))
+    {
+        if (output_len < input_len) return STATUS_BUFFER_TOO_SMALL;
+        if (input_len) decrypt_blocks( key, iv, input, output, input_len / key->block_size );
+        return STATUS_SUCCESS;
+    }
+
+    if (!input_len) return STATUS_INVALID_BUFFER_SIZE;
+
+    /* Check the padding in the last block before anything is written */
+    bytes = input_len - key->block_size;
+    memcpy( last, input + bytes, key->block_size );
+    AesDecryptEcb( &key->aes, last, block, 1 );
+    if (key->mode == MODE_ID_CBC)
+    {
+        const UCHAR *chain = bytes ? input + bytes - key->block_size : iv;
+        for (i = 0; i < key->block_size; i++) block[i] ^= chain[i];
+    }
+
+    pad = block[key->block_size - 1];
+    if (!pad || pad > key->block_size) return STATUS_UNSUCCESSFUL;
+    for (i = key->block_size - pad; i < key->block_size; i++)
+        if (block[i] != pad) return STATUS_UNSUCCESSFUL;
+
+    *ret_len = input_len - pad;
+    if (output_len < *ret_len) return STATUS_BUFFER_TOO_SMALL;
+
+    if (bytes) decrypt_blocks( key, iv, input, output, bytes / key->block_size );
+    memcpy( output + bytes, block, key->block_size - pad );
+    if (key->mode == MODE_ID_CBC) memcpy( iv, last, key->block_size );
+
+    return STATUS_SUCCESS;
+}
+
 BOOL WINAPI DllMain( HINSTANCE hinst, DWORD reason, LPVOID reserved )
 {
     switch (reason)
@@ -76,12 +76,60 @@ static int use_raw_address(const char* name)
 }
 
 
+/* Expands the delta encoded entries of a compact .rossym section */
+static ROSSYM_ENTRY* rsym_decode_compact(const ROSSYM_COMPACT_HEADER* Header, ULONG* Count)
+{
+    const ROSSYM_COMPACT_BLOCK* Blocks;
+    const UCHAR *Data, *Start, *End;
+    ROSSYM_ENTRY *Entries, Current;
+    ULONG Block, n = 0;
+
+    if (!Header->SymbolsCount)
+        return NULL;
+    Entries = HeapAlloc(GetProcessHeap(), 0, Header->SymbolsCount * sizeof(ROSSYM_ENTRY));
+    if (!Entries)
+        return NULL;
+
+    Blocks = (const ROSSYM_COMPACT_BLOCK*)((const char*)Header + Header->BlocksOffset);
+    Data = (const UCHAR*)Header + Header->DataOffset;
+    for (Block = 0; Block < Header->BlocksCount; Block++)
+    {
+        ULONG BlockEnd = Block + 1 < Header->BlocksCount ? Blocks[Block + 1].DataOffset : Header->DataLength;
+
+        if (Blocks[Block].DataOffset > BlockEnd || BlockEnd > Header->DataLength)
+            break;
+        Start = Data + Blocks[Block].DataOffset;
+        End = Data + BlockEnd;
+        memset(&Current, 0, sizeof(Current));
+        Current.Address = Blocks[Block].Address;
+        while (Start < End && n < Header->SymbolsCount &&
+               RosSymReadCompactEntry(&Start, End, &Current))
+        {
+            Entries[n++] = Current;
+        }
+        if (Start != End)
+            break;
+    }
+
+    if (Block != Header->BlocksCount || n != Header->SymbolsCount)
+    {
+        HeapFree(GetProcessHeap(), 0, Entries);
+        return NULL;
+    }
+
+    *Count = n;
+    return Entries;
+}
+
 BOOL rsym_parse(struct module* module, unsigned long load_offset,
                  const void* rsym_ptr, int rsymlen)
 {
     const ROSSYM_HEADER* RosSymHeader;
+    const ROSSYM_COMPACT_HEADER* CompactHeader;
     const ROSSYM_ENTRY* First, *Last, *Entry;
+    ROSSYM_ENTRY* Decoded = NULL;
     const CHAR* Strings;
+    ULONG Count;
 
     struct pool pool;
     struct sparse_array file_table, func_table;
@@ -89,19 +137,35 @@ BOOL rsym_parse(struct module* module, unsigned long load_offset,
 
 
     RosSymHeader = rsym_ptr;
+    CompactHeader = rsym_ptr;
 
-    if (RosSymHeader->SymbolsOffset < sizeof(ROSSYM_HEADER)
-        || RosSymHeader->StringsOffset < RosSymHeader->SymbolsOffset + RosSymHeader->SymbolsLength
-        || rsymlen < RosSymHeader->StringsOffset + RosSymHeader->StringsLength
-        || 0 != (RosSymHeader->SymbolsLength % sizeof(ROSSYM_ENTRY)))
+    if (rsymlen >= (int)sizeof(ROSSYM_COMPACT_HEADER) && CompactHeader->Magic == ROSSYM_COMPACT_MAGIC)
     {
-        WARN("Invalid ROSSYM_HEADER\n");
-        return FALSE;
+        if (!RosSymIsValidCompactHeader(CompactHeader, rsymlen) ||
+            !(Decoded = rsym_decode_compact(CompactHeader, &Count)))
+        {
+            WARN("Invalid ROSSYM_COMPACT_HEADER\n");
+            return FALSE;
+        }
+        First = Decoded;
+        Last = First + Count;
+        Strings = (const CHAR*)rsym_ptr + CompactHeader->StringsOffset;
     }
+    else
+    {
+        if (RosSymHeader->SymbolsOffset < sizeof(ROSSYM_HEADER)
+            || RosSymHeader->StringsOffset < RosSymHeader->SymbolsOffset + RosSymHeader->SymbolsLength
+            || rsymlen < RosSymHeader->StringsOffset + RosSymHeader->StringsLength
+            || 0 != (RosSymHeader->SymbolsLength % sizeof(ROSSYM_ENTRY)))
+        {
+            WARN("Invalid ROSSYM_HEADER\n");
+            return FALSE;
+        }
 
-    First = (const ROSSYM_ENTRY *)((const char*)rsym_ptr + RosSymHeader->SymbolsOffset);
-    Last = First + RosSymHeader->SymbolsLength / sizeof(ROSSYM_ENTRY);
-    Strings = (const CHAR*)rsym_ptr + RosSymHeader->StringsOffset;
+        First = (const ROSSYM_ENTRY *)((const char*)rsym_ptr + RosSymHeader->SymbolsOffset);
+        Last = First + RosSymHeader->SymbolsLength / sizeof(ROSSYM_ENTRY);
+        Strings = (const CHAR*)rsym_ptr + RosSymHeader->StringsOffset;
+    }
 
     pool_init(&pool, 65536);
     sparse_array_init(&file_table, sizeof(rsym_file_entry_t), 64);
@@ -176,6 +240,7 @@ BOOL rsym_parse(struct module* module, unsigned long load_offset,
     module->module.Publics = TRUE;
 
     pool_destroy(&pool);
+    HeapFree(GetProcessHeap(), 0, Decoded);
 
     return TRUE;
 }
@@ -340,31 +340,32 @@ ReadFileScatter(HANDLE hFile,
                 LPDWORD lpReserved,
                 LPOVERLAPPED lpOverlapped)
 {
-    PIO_STATUS_BLOCK pIOStatus;
     LARGE_INTEGER Offset;
+    PVOID ApcContext;
     NTSTATUS Status;
 
     DPRINT("(%p %p %u %p)\n", hFile, aSegmentArray, nNumberOfBytesToRead, lpOverlapped);
 
-    Offset.LowPart  = lpOverlapped->Offset;
-    Offset.HighPart = lpOverlapped->OffsetHigh;
-    pIOStatus = (PIO_STATUS_BLOCK) lpOverlapped;
-    pIOStatus->Status = STATUS_PENDING;
-    pIOStatus->Information = 0;
+    Offset.u.LowPart = lpOverlapped->Offset;
+    Offset.u.HighPart = lpOverlapped->OffsetHigh;
+    lpOverlapped->Internal = STATUS_PENDING;
+    lpOverlapped->InternalHigh = 0;
+    ApcContext = (((ULONG_PTR)lpOverlapped->hEvent & 0x1) ? NULL : lpOverlapped);
 
     Status = NtReadFileScatter(hFile,
+                               lpOverlapped->hEvent,
                                NULL,
-                               NULL,
-                               NULL,
-                               pIOStatus,
+                               ApcContext,
+                               (PIO_STATUS_BLOCK)lpOverlapped,
                                aSegmentArray,
                                nNumberOfBytesToRead,
                                &Offset,
                                NULL);
 
-    if (!NT_SUCCESS(Status))
+    /* return FALSE in case of failure and pending operations! */
+    if (!NT_SUCCESS(Status) || Status == STATUS_PENDING)
     {
-        SetLastError(RtlNtStatusToDosError(Status));
+        BaseSetLastNTError(Status);
         return FALSE;
     }
 
@@ -382,31 +383,32 @@ WriteFileGather(HANDLE hFile,
                 LPDWORD lpReserved,
                 LPOVERLAPPED lpOverlapped)
 {
-    PIO_STATUS_BLOCK IOStatus;
     LARGE_INTEGER Offset;
+    PVOID ApcContext;
     NTSTATUS Status;
 
     DPRINT("%p %p %u %p\n", hFile, aSegmentArray, nNumberOfBytesToWrite, lpOverlapped);
 
-    Offset.LowPart = lpOverlapped->Offset;
-    Offset.HighPart = lpOverlapped->OffsetHigh;
-    IOStatus = (PIO_STATUS_BLOCK) lpOverlapped;
-    IOStatus->Status = STATUS_PENDING;
-    IOStatus->Information = 0;
+    Offset.u.LowPart = lpOverlapped->Offset;
+    Offset.u.HighPart = lpOverlapped->OffsetHigh;
+    lpOverlapped->Internal = STATUS_PENDING;
+    lpOverlapped->InternalHigh = 0;
+    ApcContext = (((ULONG_PTR)lpOverlapped->hEvent & 0x1) ? NULL : lpOverlapped);
 
     Status = NtWriteFileGather(hFile,
+                               lpOverlapped->hEvent,
                                NULL,
-                               NULL,
-                               NULL,
-                               IOStatus,
+                               ApcContext,
+                               (PIO_STATUS_BLOCK)lpOverlapped,
                                aSegmentArray,
                                nNumberOfBytesToWrite,
                                &Offset,
                                NULL);
 
-    if (!NT_SUCCESS(Status))
+    /* return FALSE in case of failure and pending operations! */
+    if (!NT_SUCCESS(Status) || Status == STATUS_PENDING)
     {
-        SetLastError(RtlNtStatusToDosError(Status));
+        BaseSetLastNTError(Status);
         return FALSE;
     }
 
@@ -76,6 +76,7 @@ Abstract:
 
 #define TAG_CCB                 'ccdC'      //  Ccb
 #define TAG_CDROM_TOC           'ctdC'      //  TOC
+#define TAG_DIR_INDEX           'xddC'      //  Directory name index
 #define TAG_DIRENT_NAME         'nddC'      //  CdName in dirent
 #define TAG_ENUM_EXPRESSION     'eedC'      //  Search expression for enumeration
 #define TAG_FCB_DATA            'dfdC'      //  Data Fcb
@@ -448,6 +449,37 @@ CdFindFile (
     _Out_ PCD_NAME *MatchingName
     );
 
+VOID
+CdDeleteDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _Inout_ PFCB Fcb
+    );
+
+PCD_DIR_INDEX
+CdAllocateDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _Inout_ PFCB Fcb,
+    _In_ ULONG MaxEntries,
+    _In_ ULONG RefusedFlag
+    );
+
+VOID
+CdFreeDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PVCB Vcb,
+    _Inout_ PCD_DIR_INDEX *DirIndex
+    );
+
+ULONG
+CdHashDirIndexName (
+    _In_ PUNICODE_STRING Name
+    );
+
+VOID
+CdSortDirIndex (
+    _Inout_ PCD_DIR_INDEX DirIndex
+    );
+
 BOOLEAN
 CdFindDirectory (
     _In_ PIRP_CONTEXT IrpContext,
@@ -563,6 +595,23 @@ CdCleanupFileContext (
                                  &(FC)->InitialDirent->DirContext,  \
                                  &(FC)->InitialDirent->Dirent )
 
+//
+//  BOOLEAN
+//  CdShouldBuildIndex (
+//      _In_ PFCB Fcb,
+//      _In_ ULONG NoIndexFlag,
+//      _In_ ULONG RefusedFlag
+//      );
+//
+//  An index is built unless the Fcb can never have one, or the last attempt
+//  was refused and no other index on the volume has been freed since.
+//
+
+#define CdShouldBuildIndex(F,NF,RF)                                     \
+    (!FlagOn( (F)->FcbState, (NF) ) &&                                  \
+     (!FlagOn( (F)->FcbState, (RF) ) ||                                 \
+      ((F)->IndexRefusedFrees != (F)->Vcb->DirIndexFrees)))
+
 
 //
 //  The following routines are used to manipulate the fscontext fields
@@ -692,6 +692,20 @@ typedef struct _VCB {
     KEVENT SectorCacheEvent;
     ERESOURCE SectorCacheResource;
 
+    //
+    //  Bytes of pool currently charged to directory name indexes on this
+    //  volume.  This is bounded by CD_DIR_INDEX_MAX_BYTES.
+    //
+
+    LONG DirIndexBytes;
+
+    //
+    //  Number of name indexes freed on this volume.  An Fcb whose index was
+    //  refused for lack of budget or pool tries again once this changes.
+    //
+
+    LONG DirIndexFrees;
+
 #ifdef CDFS_TELEMETRY_DATA
 
     //
@@ -856,6 +870,29 @@ typedef struct _FCB_INDEX {
     PRTL_SPLAY_LINKS ExactCaseRoot;
     PRTL_SPLAY_LINKS IgnoreCaseRoot;
 
+    //
+    //  Name index for large directories.  This is built on the first file
+    //  lookup in the directory and is NULL until then, or for directories
+    //  which are too small to bother with.
+    //
+
+    struct _CD_DIR_INDEX *DirIndex;
+
+    //
+    //  Name index for the child directories of this directory in the path
+    //  table.  This is built on the first path table lookup for directories
+    //  with many subdirectories.
+    //
+
+    struct _CD_DIR_INDEX *PathIndex;
+
+    //
+    //  Value of DirIndexFrees in the Vcb when an index for this Fcb was last
+    //  refused for lack of budget or pool.
+    //
+
+    LONG IndexRefusedFrees;
+
 } FCB_INDEX;
 typedef FCB_INDEX *PFCB_INDEX;
 
@@ -1050,6 +1087,10 @@ typedef FCB *PFCB;
 #define FCB_STATE_MODE2FORM2_FILE               (0x00000004)
 #define FCB_STATE_MODE2_FILE                    (0x00000008)
 #define FCB_STATE_DA_FILE                       (0x00000010)
+#define FCB_STATE_NO_DIR_INDEX                  (0x00000020)
+#define FCB_STATE_NO_PATH_INDEX                 (0x00000040)
+#define FCB_STATE_DIR_INDEX_REFUSED             (0x00000080)
+#define FCB_STATE_PATH_INDEX_REFUSED            (0x00000100)
 
 //
 //  These file types are read as raw 2352 byte sectors
@@ -1059,6 +1100,64 @@ typedef FCB *PFCB;
                                                   FCB_STATE_MODE2_FILE      | \
                                                   FCB_STATE_DA_FILE )
 
+//
+//  The directory name index.  Each file in the directory has an entry with
+//  the hash of its upcased name (without version) and the offset of its
+//  initial dirent.  The entries are sorted by hash and then by offset so
+//  that like-named files are visited in directory order.
+//
+//  The same structure indexes the child directories of a directory in the
+//  path table.  The offset is then the path table offset of the child and
+//  the ordinal is its directory number.
+//
+
+typedef struct _CD_DIR_INDEX_ENTRY {
+
+    ULONG NameHash;
+    ULONG Offset;
+    ULONG Ordinal;
+
+} CD_DIR_INDEX_ENTRY;
+typedef CD_DIR_INDEX_ENTRY *PCD_DIR_INDEX_ENTRY;
+
+typedef struct _CD_DIR_INDEX {
+
+    //
+    //  Bytes charged against the Vcb for this index.
+    //
+
+    ULONG AllocationSize;
+
+    ULONG EntryCount;
+
+    CD_DIR_INDEX_ENTRY Entries[1];
+
+} CD_DIR_INDEX;
+typedef CD_DIR_INDEX *PCD_DIR_INDEX;
+
+//
+//  Only directories larger than this are indexed, and no volume will charge
+//  more than the maximum to its directory indexes.
+//
+
+#define CD_DIR_INDEX_MIN_SIZE                   (4 * SECTOR_SIZE)
+#define CD_DIR_INDEX_MAX_BYTES                  (0x100000)
+
+//
+//  Only directories with at least this many subdirectories get a path table
+//  index.
+//
+
+#define CD_PATH_INDEX_MIN_ENTRIES               (64)
+
+//
+//  The directory is pulled into the cache in windows of this size while
+//  building an index, so each window is a single multi-sector read.  This
+//  must divide VACB_MAPPING_GRANULARITY.
+//
+
+#define CD_DIR_INDEX_READ_WINDOW                (0x10000)
+
 #define SIZEOF_FCB_DATA     \
     (FIELD_OFFSET( FCB, FcbType ) + sizeof( FCB_DATA ))
 
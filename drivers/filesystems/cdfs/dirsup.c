@@ -105,17 +105,47 @@ CdCheckForXAExtent (
     _Inout_ PDIRENT Dirent
     );
 
+VOID
+CdBuildDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB Fcb
+    );
+
+_Success_(return != FALSE) BOOLEAN
+CdFindFileInDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB Fcb,
+    _In_ PCD_NAME Name,
+    _In_ BOOLEAN IgnoreCase,
+    _Inout_ PFILE_ENUM_CONTEXT FileContext,
+    _Out_ PCD_NAME *MatchingName
+    );
+
+VOID
+CdPrefetchDirectory (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB Fcb
+    );
+
 #ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, CdAllocateDirIndex)
+#pragma alloc_text(PAGE, CdBuildDirIndex)
 #pragma alloc_text(PAGE, CdCheckForXAExtent)
 #pragma alloc_text(PAGE, CdCheckRawDirentBounds)
 #pragma alloc_text(PAGE, CdCleanupFileContext)
+#pragma alloc_text(PAGE, CdDeleteDirIndex)
+#pragma alloc_text(PAGE, CdFindFileInDirIndex)
 #pragma alloc_text(PAGE, CdFindFile)
 #pragma alloc_text(PAGE, CdFindDirectory)
 #pragma alloc_text(PAGE, CdFindFileByShortName)
+#pragma alloc_text(PAGE, CdFreeDirIndex)
+#pragma alloc_text(PAGE, CdHashDirIndexName)
 #pragma alloc_text(PAGE, CdLookupDirent)
 #pragma alloc_text(PAGE, CdLookupLastFileDirent)
 #pragma alloc_text(PAGE, CdLookupNextDirent)
 #pragma alloc_text(PAGE, CdLookupNextInitialFileDirent)
+#pragma alloc_text(PAGE, CdPrefetchDirectory)
+#pragma alloc_text(PAGE, CdSortDirIndex)
 #pragma alloc_text(PAGE, CdUpdateDirentFromRawDirent)
 #pragma alloc_text(PAGE, CdUpdateDirentName)
 #endif
@@ -881,6 +911,33 @@ Return Value:
 
     ShortNameDirentOffset = CdShortNameDirentOffset( IrpContext, &Name->FileName );
 
+    //
+    //  If this can't be a generated short name then use the name index for
+    //  this directory, building it if this is the first lookup here.  Short
+    //  names depend on the dirent offset so they always take the scan below.
+    //
+
+    if (ShortNameDirentOffset == MAXULONG) {
+
+        if ((Fcb->DirIndex == NULL) &&
+            CdShouldBuildIndex( Fcb,
+                                FCB_STATE_NO_DIR_INDEX,
+                                FCB_STATE_DIR_INDEX_REFUSED )) {
+
+            CdBuildDirIndex( IrpContext, Fcb );
+        }
+
+        if (Fcb->DirIndex != NULL) {
+
+            return CdFindFileInDirIndex( IrpContext,
+                                         Fcb,
+                                         Name,
+                                         IgnoreCase,
+                                         FileContext,
+                                         MatchingName );
+        }
+    }
+
     //
     //  Position ourselves at the first entry.
     //
@@ -993,6 +1050,150 @@ Return Value:
 }
 
 
+VOID
+CdDeleteDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _Inout_ PFCB Fcb
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to free the name indexes for a directory and return
+    their pool charge to the Vcb.
+
+Arguments:
+
+    Fcb - Fcb for the directory.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PAGED_CODE();
+
+    CdFreeDirIndex( IrpContext, Fcb->Vcb, &Fcb->DirIndex );
+    CdFreeDirIndex( IrpContext, Fcb->Vcb, &Fcb->PathIndex );
+
+    return;
+}
+
+
+PCD_DIR_INDEX
+CdAllocateDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _Inout_ PFCB Fcb,
+    _In_ ULONG MaxEntries,
+    _In_ ULONG RefusedFlag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to allocate an empty name index and charge it
+    against the Vcb.  If the volume is over budget or we are short of pool
+    we mark the Fcb with RefusedFlag.  We won't try again for this Fcb until
+    some other index on the volume has been freed.
+
+Arguments:
+
+    Fcb - Fcb for the directory being indexed.
+
+    MaxEntries - Number of entries to allocate.  The caller has checked that
+        this many entries fit in CD_DIR_INDEX_MAX_BYTES.
+
+    RefusedFlag - Fcb state flag to set if the index is refused.
+
+Return Value:
+
+    PCD_DIR_INDEX - The new index, NULL if it was refused.
+
+--*/
+
+{
+    PCD_DIR_INDEX DirIndex = NULL;
+    ULONG AllocationSize;
+
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER( IrpContext );
+
+    AllocationSize = FIELD_OFFSET( CD_DIR_INDEX, Entries ) +
+                     MaxEntries * sizeof( CD_DIR_INDEX_ENTRY );
+
+    if ((InterlockedExchangeAdd( &Fcb->Vcb->DirIndexBytes, AllocationSize ) +
+         AllocationSize) <= CD_DIR_INDEX_MAX_BYTES) {
+
+        DirIndex = ExAllocatePoolWithTag( CdPagedPool, AllocationSize, TAG_DIR_INDEX );
+    }
+
+    if (DirIndex == NULL) {
+
+        InterlockedExchangeAdd( &Fcb->Vcb->DirIndexBytes, -(LONG) AllocationSize );
+
+        Fcb->IndexRefusedFrees = Fcb->Vcb->DirIndexFrees;
+        SetFlag( Fcb->FcbState, RefusedFlag );
+
+        return NULL;
+    }
+
+    ClearFlag( Fcb->FcbState, RefusedFlag );
+
+    DirIndex->AllocationSize = AllocationSize;
+    DirIndex->EntryCount = 0;
+
+    return DirIndex;
+}
+
+
+VOID
+CdFreeDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PVCB Vcb,
+    _Inout_ PCD_DIR_INDEX *DirIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to free a name index and return its pool charge
+    to the Vcb.  Fcbs which were refused an index may try again after this.
+
+Arguments:
+
+    Vcb - Vcb the index was charged against.
+
+    DirIndex - Address of the index pointer.  This is NULL on return.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER( IrpContext );
+
+    if (*DirIndex != NULL) {
+
+        InterlockedExchangeAdd( &Vcb->DirIndexBytes, -(LONG) (*DirIndex)->AllocationSize );
+        InterlockedIncrement( &Vcb->DirIndexFrees );
+
+        CdFreePool( DirIndex );
+    }
+
+    return;
+}
+
+
 BOOLEAN
 CdFindDirectory (
     _In_ PIRP_CONTEXT IrpContext,
@@ -1867,4 +2068,463 @@ Return Value:
 }
 
 
+//
+//  Local support routine
+//
+
+VOID
+CdBuildDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB Fcb
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to build the name index for a directory.  We make
+    one pass over the directory to count the files and a second one to record
+    the name hash and offset of the initial dirent of every file.  The index
+    is charged against the Vcb and we quietly give up if the directory is
+    small or the volume is already over budget.  A directory which is too
+    small or has too many files is never indexed, one refused for budget may
+    be retried later.
+
+Arguments:
+
+    Fcb - Fcb for the directory.  This is acquired exclusively and has a
+        stream file.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    FILE_ENUM_CONTEXT FileContext;
+    PDIRENT Dirent;
+    PCD_DIR_INDEX_ENTRY Entry;
+
+    PCD_DIR_INDEX DirIndex = NULL;
+    ULONG Count = 0;
+
+    PAGED_CODE();
+
+    //
+    //  Small directories are cheap enough to scan.  The size of the directory
+    //  never changes so there is no point in trying again.
+    //
+
+    if (Fcb->FileSize.QuadPart < CD_DIR_INDEX_MIN_SIZE) {
+
+        SetFlag( Fcb->FcbState, FCB_STATE_NO_DIR_INDEX );
+        return;
+    }
+
+    CdInitializeFileContext( IrpContext, &FileContext );
+
+    //
+    //  Use a try-finally to facilitate cleanup.
+    //
+
+    _SEH2_TRY {
+
+        //
+        //  Pull the whole directory into the cache with large reads before
+        //  walking it sector by sector.
+        //
+
+        CdPrefetchDirectory( IrpContext, Fcb );
+
+        //
+        //  Count the files, as CdFindFile only looks for files.  The self and
+        //  parent entries are directories so they are never counted.
+        //
+
+        CdLookupInitialFileDirent( IrpContext, Fcb, &FileContext, Fcb->StreamOffset );
+
+        do {
+
+            if (!FlagOn( FileContext.InitialDirent->Dirent.DirentFlags,
+                         CD_ATTRIBUTE_ASSOC | CD_ATTRIBUTE_DIRECTORY )) {
+
+                Count += 1;
+            }
+
+        } while (CdLookupNextInitialFileDirent( IrpContext, Fcb, &FileContext ));
+
+        //
+        //  The directory never changes so one out of range is never indexed.
+        //
+
+        if ((Count == 0) ||
+            (Count > (CD_DIR_INDEX_MAX_BYTES / sizeof( CD_DIR_INDEX_ENTRY )))) {
+
+            SetFlag( Fcb->FcbState, FCB_STATE_NO_DIR_INDEX );
+            try_return( NOTHING );
+        }
+
+        DirIndex = CdAllocateDirIndex( IrpContext, Fcb, Count, FCB_STATE_DIR_INDEX_REFUSED );
+
+        if (DirIndex == NULL) {
+
+            try_return( NOTHING );
+        }
+
+        //
+        //  Now walk the directory again and record the names.
+        //
+
+        CdCleanupFileContext( IrpContext, &FileContext );
+        CdInitializeFileContext( IrpContext, &FileContext );
+
+        CdLookupInitialFileDirent( IrpContext, Fcb, &FileContext, Fcb->StreamOffset );
+
+        do {
+
+            Dirent = &FileContext.InitialDirent->Dirent;
+
+            if (!FlagOn( Dirent->DirentFlags, CD_ATTRIBUTE_ASSOC | CD_ATTRIBUTE_DIRECTORY )) {
+
+                CdUpdateDirentName( IrpContext, Dirent, FALSE );
+
+                if (!FlagOn( Dirent->Flags, DIRENT_FLAG_CONSTANT_ENTRY ) &&
+                    (DirIndex->EntryCount < Count)) {
+
+                    Entry = &DirIndex->Entries[ DirIndex->EntryCount ];
+                    DirIndex->EntryCount += 1;
+
+                    Entry->NameHash = CdHashDirIndexName( &Dirent->CdFileName.FileName );
+                    Entry->Offset = Dirent->DirentOffset;
+                    Entry->Ordinal = 0;
+                }
+            }
+
+        } while (CdLookupNextInitialFileDirent( IrpContext, Fcb, &FileContext ));
+
+        CdSortDirIndex( DirIndex );
+
+        Fcb->DirIndex = DirIndex;
+
+    try_exit:  NOTHING;
+    } _SEH2_FINALLY {
+
+        CdCleanupFileContext( IrpContext, &FileContext );
+
+        if (Fcb->DirIndex != DirIndex) {
+
+            CdFreeDirIndex( IrpContext, Fcb->Vcb, &DirIndex );
+        }
+    } _SEH2_END;
+
+    return;
+}
+
+
+//
+//  Local support routine
+//
+
+_Success_(return != FALSE) BOOLEAN
+CdFindFileInDirIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB Fcb,
+    _In_ PCD_NAME Name,
+    _In_ BOOLEAN IgnoreCase,
+    _Inout_ PFILE_ENUM_CONTEXT FileContext,
+    _Out_ PCD_NAME *MatchingName
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the indexed version of CdFindFile.  We binary search the
+    name index for the hash of the input name and check each file with that
+    hash in directory order.  Only dirents with a matching hash are read.
+
+Arguments:
+
+    Fcb - Fcb for the directory being searched.  It has a name index.
+
+    Name - Name to search for.  This can't be a generated short name.
+
+    IgnoreCase - Indicates the case of the search.
+
+    FileContext - File context to use for the search.  This has already been
+        initialized.
+
+    MatchingName - Pointer to buffer containing matching name.
+
+Return Value:
+
+    BOOLEAN - TRUE if matching entry is found, FALSE otherwise.
+
+--*/
+
+{
+    PCD_DIR_INDEX DirIndex = Fcb->DirIndex;
+    PDIRENT Dirent;
+
+    ULONG NameHash;
+    ULONG Low = 0;
+    ULONG High = DirIndex->EntryCount;
+    ULONG Middle;
+
+    PAGED_CODE();
+
+    NameHash = CdHashDirIndexName( &Name->FileName );
+
+    //
+    //  Find the first entry with this hash.
+    //
+
+    while (Low < High) {
+
+        Middle = Low + (High - Low) / 2;
+
+        if (DirIndex->Entries[ Middle ].NameHash < NameHash) {
+
+            Low = Middle + 1;
+
+        } else {
+
+            High = Middle;
+        }
+    }
+
+    while ((Low < DirIndex->EntryCount) &&
+           (DirIndex->Entries[ Low ].NameHash == NameHash)) {
+
+        //
+        //  Position the context at this file, dropping anything we mapped
+        //  or allocated for the previous candidate.
+        //
+
+        CdCleanupDirContext( IrpContext, &FileContext->InitialDirent->DirContext );
+        CdCleanupDirent( IrpContext, &FileContext->InitialDirent->Dirent );
+
+        CdInitializeDirContext( IrpContext, &FileContext->InitialDirent->DirContext );
+        CdInitializeDirent( IrpContext, &FileContext->InitialDirent->Dirent );
+
+        CdLookupInitialFileDirent( IrpContext,
+                                   Fcb,
+                                   FileContext,
+                                   DirIndex->Entries[ Low ].Offset );
+
+        Dirent = &FileContext->InitialDirent->Dirent;
+
+        CdUpdateDirentName( IrpContext, Dirent, IgnoreCase );
+
+        if (CdIsNameInExpression( IrpContext,
+                                  &Dirent->CdCaseFileName,
+                                  Name,
+                                  0,
+                                  TRUE )) {
+
+            *MatchingName = &Dirent->CdCaseFileName;
+
+            CdLookupLastFileDirent( IrpContext, Fcb, FileContext );
+            return TRUE;
+        }
+
+        Low += 1;
+    }
+
+    return FALSE;
+}
+
+
+ULONG
+CdHashDirIndexName (
+    _In_ PUNICODE_STRING Name
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the case insensitive hash of a name for the
+    directory name index.
+
+Arguments:
+
+    Name - Name to hash.  This is the name without any version string.
+
+Return Value:
+
+    ULONG - Hash value for this name.
+
+--*/
+
+{
+    ULONG Hash = 2166136261;
+    ULONG Index;
+
+    PAGED_CODE();
+
+    for (Index = 0; Index < Name->Length / sizeof( WCHAR ); Index++) {
+
+        Hash ^= RtlUpcaseUnicodeChar( Name->Buffer[ Index ] );
+        Hash *= 16777619;
+    }
+
+    return Hash;
+}
+
+
+//
+//  Local support routine
+//
+
+VOID
+CdPrefetchDirectory (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB Fcb
+    )
+
+/*++
+
+Routine Description:
+
+    This routine maps an entire directory stream into the cache in large
+    aligned windows.  Each window is faulted in by a single multi-sector
+    read rather than one read per sector as the dirent walk would do.
+
+Arguments:
+
+    Fcb - Fcb for the directory.  It has a stream file.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    LONGLONG BaseOffset = 0;
+    ULONG Length;
+
+    PVOID Bcb;
+    PVOID Buffer;
+
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER( IrpContext );
+
+    while (BaseOffset < Fcb->FileSize.QuadPart) {
+
+        Length = CD_DIR_INDEX_READ_WINDOW;
+
+        if (Length > (Fcb->FileSize.QuadPart - BaseOffset)) {
+
+            Length = (ULONG) (Fcb->FileSize.QuadPart - BaseOffset);
+        }
+
+        CcMapData( Fcb->FileObject,
+                   (PLARGE_INTEGER) &BaseOffset,
+                   Length,
+                   TRUE,
+                   &Bcb,
+                   &Buffer );
+
+        CcUnpinData( Bcb );
+
+        BaseOffset += Length;
+    }
+
+    return;
+}
+
+
+VOID
+CdSortDirIndex (
+    _Inout_ PCD_DIR_INDEX DirIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine heap sorts the entries in a name index by hash and then by
+    offset.
+
+Arguments:
+
+    DirIndex - Index to sort.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PCD_DIR_INDEX_ENTRY Entries = DirIndex->Entries;
+    CD_DIR_INDEX_ENTRY Temp;
+
+    ULONG Count = DirIndex->EntryCount;
+    ULONG Start;
+    ULONG Root;
+    ULONG Child;
+
+#define CdDirIndexLess(A,B)                                             \
+    (((A)->NameHash < (B)->NameHash) ||                                 \
+     (((A)->NameHash == (B)->NameHash) && ((A)->Offset < (B)->Offset)))
+
+    PAGED_CODE();
+
+    if (Count < 2) {
+
+        return;
+    }
+
+    //
+    //  Build the heap and then repeatedly move the largest entry to the end.
+    //
 
+    Start = Count / 2;
+
+    while (Count > 1) {
+
+        if (Start > 0) {
+
+            Start -= 1;
+
+        } else {
+
+            Count -= 1;
+
+            Temp = Entries[ Count ];
+            Entries[ Count ] = Entries[ 0 ];
+            Entries[ 0 ] = Temp;
+        }
+
+        Root = Start;
+
+        while ((Child = 2 * Root + 1) < Count) {
+
+            if ((Child + 1 < Count) &&
+                CdDirIndexLess( &Entries[ Child ], &Entries[ Child + 1 ] )) {
+
+                Child += 1;
+            }
+
+            if (!CdDirIndexLess( &Entries[ Root ], &Entries[ Child ] )) {
+
+                break;
+            }
+
+            Temp = Entries[ Root ];
+            Entries[ Root ] = Entries[ Child ];
+            Entries[ Child ] = Temp;
+
+            Root = Child;
+        }
+    }
+
+#undef CdDirIndexLess
+
+    return;
+}
@@ -100,6 +100,22 @@ Abstract:
 //  Local support routines
 //
 
+VOID
+CdBuildPathIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB ParentFcb
+    );
+
+_Success_(return != FALSE)
+BOOLEAN
+CdFindPathEntryInIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB ParentFcb,
+    _In_ PCD_NAME DirName,
+    _In_ BOOLEAN IgnoreCase,
+    _Inout_ PCOMPOUND_PATH_ENTRY CompoundPathEntry
+    );
+
 VOID
 CdMapPathTableBlock (
     _In_ PIRP_CONTEXT IrpContext,
@@ -119,7 +135,9 @@ CdUpdatePathEntryFromRawPathEntry (
     );
 
 #ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE, CdBuildPathIndex)
 #pragma alloc_text(PAGE, CdFindPathEntry)
+#pragma alloc_text(PAGE, CdFindPathEntryInIndex)
 #pragma alloc_text(PAGE, CdLookupPathEntry)
 #pragma alloc_text(PAGE, CdLookupNextPathEntry)
 #pragma alloc_text(PAGE, CdMapPathTableBlock)
@@ -367,6 +385,28 @@ Return Value:
 		CdRaiseStatus( IrpContext, STATUS_DISK_CORRUPT_ERROR );
 	}
 
+    //
+    //  Use the name index of the child directories if there is one, building
+    //  it if this is the first lookup here.
+    //
+
+    if ((ParentFcb->PathIndex == NULL) &&
+        CdShouldBuildIndex( ParentFcb,
+                            FCB_STATE_NO_PATH_INDEX,
+                            FCB_STATE_PATH_INDEX_REFUSED )) {
+
+        CdBuildPathIndex( IrpContext, ParentFcb );
+    }
+
+    if (ParentFcb->PathIndex != NULL) {
+
+        return CdFindPathEntryInIndex( IrpContext,
+                                       ParentFcb,
+                                       DirName,
+                                       IgnoreCase,
+                                       CompoundPathEntry );
+    }
+
     CdLockFcb( IrpContext, ParentFcb );
 
     if (ParentFcb->ChildPathTableOffset != 0) {
@@ -999,3 +1039,279 @@ Return Value:
 }
 
 
+//
+//  Local support routine
+//
+
+VOID
+CdBuildPathIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB ParentFcb
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to build the name index for the child directories
+    of a directory in the path table.  The children of a directory are
+    contiguous in the path table.  We make one pass to count them and a
+    second pass to record the name hash, path table offset and ordinal of
+    each.  Directories with few children are never indexed.  The index is
+    charged against the Vcb like a directory name index.
+
+Arguments:
+
+    ParentFcb - This is the directory whose children we index.  It is
+        acquired exclusively.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    COMPOUND_PATH_ENTRY CompoundPathEntry;
+    PPATH_ENTRY PathEntry = &CompoundPathEntry.PathEntry;
+    PCD_DIR_INDEX_ENTRY Entry;
+
+    PCD_DIR_INDEX PathIndex = NULL;
+    ULONG StartingOffset;
+    ULONG StartingOrdinal;
+    ULONG FirstOffset = 0;
+    ULONG FirstOrdinal = 0;
+    ULONG Count = 0;
+
+    PAGED_CODE();
+
+    //
+    //  Position ourselves at either the first child or at the directory itself.
+    //
+
+    StartingOffset = CdQueryFidPathTableOffset( ParentFcb->FileId );
+    StartingOrdinal = ParentFcb->Ordinal;
+
+    CdLockFcb( IrpContext, ParentFcb );
+
+    if (ParentFcb->ChildPathTableOffset != 0) {
+
+        StartingOffset = ParentFcb->ChildPathTableOffset;
+        StartingOrdinal = ParentFcb->ChildOrdinal;
+    }
+
+    CdUnlockFcb( IrpContext, ParentFcb );
+
+    CdInitializeCompoundPathEntry( IrpContext, &CompoundPathEntry );
+
+    //
+    //  Use a try-finally to facilitate cleanup.
+    //
+
+    _SEH2_TRY {
+
+        //
+        //  Count the children.  The root is its own parent so skip the
+        //  directory itself.
+        //
+
+        CdLookupPathEntry( IrpContext, StartingOffset, StartingOrdinal, FALSE, &CompoundPathEntry );
+
+        do {
+
+            if (PathEntry->ParentOrdinal > ParentFcb->Ordinal) {
+
+                break;
+            }
+
+            if ((PathEntry->ParentOrdinal == ParentFcb->Ordinal) &&
+                (PathEntry->Ordinal != ParentFcb->Ordinal)) {
+
+                if (Count == 0) {
+
+                    FirstOffset = PathEntry->PathTableOffset;
+                    FirstOrdinal = PathEntry->Ordinal;
+                }
+
+                Count += 1;
+            }
+
+        } while (CdLookupNextPathEntry( IrpContext,
+                                        &CompoundPathEntry.PathContext,
+                                        PathEntry ));
+
+        //
+        //  The path table never changes so a directory out of range is never
+        //  indexed.
+        //
+
+        if ((Count < CD_PATH_INDEX_MIN_ENTRIES) ||
+            (Count > (CD_DIR_INDEX_MAX_BYTES / sizeof( CD_DIR_INDEX_ENTRY )))) {
+
+            SetFlag( ParentFcb->FcbState, FCB_STATE_NO_PATH_INDEX );
+            try_return( NOTHING );
+        }
+
+        PathIndex = CdAllocateDirIndex( IrpContext,
+                                        ParentFcb,
+                                        Count,
+                                        FCB_STATE_PATH_INDEX_REFUSED );
+
+        if (PathIndex == NULL) {
+
+            try_return( NOTHING );
+        }
+
+        //
+        //  Now walk the children again and record their names.
+        //
+
+        CdCleanupCompoundPathEntry( IrpContext, &CompoundPathEntry );
+        CdInitializeCompoundPathEntry( IrpContext, &CompoundPathEntry );
+
+        CdLookupPathEntry( IrpContext, FirstOffset, FirstOrdinal, FALSE, &CompoundPathEntry );
+
+        do {
+
+            if ((PathEntry->ParentOrdinal != ParentFcb->Ordinal) ||
+                (PathIndex->EntryCount == Count)) {
+
+                break;
+            }
+
+            CdUpdatePathEntryName( IrpContext, PathEntry, FALSE );
+
+            Entry = &PathIndex->Entries[ PathIndex->EntryCount ];
+            PathIndex->EntryCount += 1;
+
+            Entry->NameHash = CdHashDirIndexName( &PathEntry->CdDirName.FileName );
+            Entry->Offset = PathEntry->PathTableOffset;
+            Entry->Ordinal = PathEntry->Ordinal;
+
+        } while (CdLookupNextPathEntry( IrpContext,
+                                        &CompoundPathEntry.PathContext,
+                                        PathEntry ));
+
+        CdSortDirIndex( PathIndex );
+
+        ParentFcb->PathIndex = PathIndex;
+
+    try_exit:  NOTHING;
+    } _SEH2_FINALLY {
+
+        CdCleanupCompoundPathEntry( IrpContext, &CompoundPathEntry );
+
+        if (ParentFcb->PathIndex != PathIndex) {
+
+            CdFreeDirIndex( IrpContext, ParentFcb->Vcb, &PathIndex );
+        }
+    } _SEH2_END;
+
+    return;
+}
+
+
+//
+//  Local support routine
+//
+
+_Success_(return != FALSE)
+BOOLEAN
+CdFindPathEntryInIndex (
+    _In_ PIRP_CONTEXT IrpContext,
+    _In_ PFCB ParentFcb,
+    _In_ PCD_NAME DirName,
+    _In_ BOOLEAN IgnoreCase,
+    _Inout_ PCOMPOUND_PATH_ENTRY CompoundPathEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the indexed version of CdFindPathEntry.  We binary search
+    the path index for the hash of the input name and only look at the path
+    table entries with that hash.
+
+Arguments:
+
+    ParentFcb - This is the directory we are examining.  It has a path index.
+
+    DirName - This is the name we are searching for.  This name will not contain
+        wildcard characters or a version string.
+
+    IgnoreCase - Indicates if this search is exact or ignore case.
+
+    CompoundPathEntry - Complete path table enumeration structure.  We will have
+        initialized it for the search on entry.  This will be positioned at the
+        matching name if found.
+
+Return Value:
+
+    BOOLEAN - TRUE if matching entry found, FALSE otherwise.
+
+--*/
+
+{
+    PCD_DIR_INDEX PathIndex = ParentFcb->PathIndex;
+    PCD_DIR_INDEX_ENTRY Entry;
+
+    ULONG NameHash;
+    ULONG Low = 0;
+    ULONG High = PathIndex->EntryCount;
+    ULONG Middle;
+
+    PAGED_CODE();
+
+    NameHash = CdHashDirIndexName( &DirName->FileName );
+
+    //
+    //  Find the first entry with this hash.
+    //
+
+    while (Low < High) {
+
+        Middle = Low + (High - Low) / 2;
+
+        if (PathIndex->Entries[ Middle ].NameHash < NameHash) {
+
+            Low = Middle + 1;
+
+        } else {
+
+            High = Middle;
+        }
+    }
+
+    while ((Low < PathIndex->EntryCount) &&
+           (PathIndex->Entries[ Low ].NameHash == NameHash)) {
+
+        Entry = &PathIndex->Entries[ Low ];
+
+        //
+        //  Position the path entry at this child, dropping anything we mapped
+        //  or allocated for the previous candidate.
+        //
+
+        CdCleanupCompoundPathEntry( IrpContext, CompoundPathEntry );
+        CdInitializeCompoundPathEntry( IrpContext, CompoundPathEntry );
+
+        CdLookupPathEntry( IrpContext, Entry->Offset, Entry->Ordinal, FALSE, CompoundPathEntry );
+
+        CdUpdatePathEntryName( IrpContext, &CompoundPathEntry->PathEntry, IgnoreCase );
+
+        if (CdIsNameInExpression( IrpContext,
+                                  &CompoundPathEntry->PathEntry.CdCaseDirName,
+                                  DirName,
+                                  0,
+                                  FALSE )) {
+
+            return TRUE;
+        }
+
+        Low += 1;
+    }
+
+    return FALSE;
+}
+
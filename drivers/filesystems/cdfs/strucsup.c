@@ -2500,6 +2500,8 @@ Return Value:
         NT_ASSERT( Fcb->FileObject == NULL );
         NT_ASSERT( IsListEmpty( &Fcb->FcbQueue ));
 
+        CdDeleteDirIndex( IrpContext, Fcb );
+
         if (Fcb == Fcb->Vcb->RootIndexFcb) {
 
             Vcb = Fcb->Vcb;
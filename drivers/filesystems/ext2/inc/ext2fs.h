@@ -650,6 +650,9 @@ typedef struct _EXT2_VCB {
     // Resource for Mcb (Meta data control block)
     ERESOURCE                   McbLock;
 
+    // Resource for the case insensitive directory name indexes
+    ERESOURCE                   DirIndexLock;
+
     // List of FCBs for open files on this volume
     ERESOURCE                   FcbLock;
     LIST_ENTRY                  FcbList;
@@ -771,6 +774,10 @@ typedef struct _EXT2_VCB {
     ULONG                       max_data_blocks;
     loff_t                      max_bitmap_bytes;
     loff_t                      max_bytes;
+
+    /* Blocks reserved by delayed allocation, not yet allocated,
+       including the extent blocks needed to map them */
+    ULONG                       DelallocBlocks;
 } EXT2_VCB, *PEXT2_VCB;
 
 //
@@ -862,6 +869,9 @@ typedef struct _EXT2_FCB {
     // Mcb Node ...
     PEXT2_MCB                       Mcb;
 
+    // Blocks reserved by extending writes (delayed allocation)
+    ULONG                           DelallocBlocks;
+
 } EXT2_FCB, *PEXT2_FCB;
 
 //
@@ -935,6 +945,9 @@ struct _EXT2_MCB {
 
     struct inode                    Inode;
     struct dentry                  *de;
+
+    // Case insensitive name index of a hashed directory
+    struct dx_ci_index             *CiIndex;
 };
 
 //
@@ -1059,6 +1072,9 @@ typedef struct ext2_icb {
     PEXT2_FCB           Fcb;
     PEXT2_CCB           Ccb;
 
+    // Fcb whose delayed allocation reservation the new blocks come from
+    PEXT2_FCB           DelallocFcb;
+
     // If the request is top level
     BOOLEAN             IsTopLevel;
 
@@ -1684,6 +1700,32 @@ Ext2TruncateExtent(
     PLARGE_INTEGER    Size
     );
 
+BOOLEAN
+Ext2CanDelayAllocation(
+    PEXT2_IRP_CONTEXT IrpContext,
+    PEXT2_MCB         Mcb
+    );
+
+NTSTATUS
+Ext2ReserveExtent(
+    PEXT2_VCB         Vcb,
+    PEXT2_FCB         Fcb,
+    ULONG             Number
+    );
+
+ULONG
+Ext2DelallocOwned(
+    PEXT2_VCB         Vcb,
+    PEXT2_FCB         Fcb
+    );
+
+VOID
+Ext2ReleaseExtent(
+    PEXT2_VCB         Vcb,
+    PEXT2_FCB         Fcb,
+    ULONG             Number
+    );
+
 
 //
 // generic.c
@@ -2506,6 +2548,9 @@ struct ext3_dir_entry_2 *
 
 int ext3_add_entry(struct ext2_icb *icb, struct dentry *dentry, struct inode *inode);
 
+void ext3_dx_ci_add_block(struct inode *dir, struct buffer_head *bh);
+void ext3_dx_ci_free(struct inode *dir);
+
 int ext3_delete_entry(struct ext2_icb *icb, struct inode *dir,
                       struct ext3_dir_entry_2 *de_del,
                       struct buffer_head *bh);
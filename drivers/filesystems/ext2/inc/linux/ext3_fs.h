@@ -720,7 +720,8 @@ static inline int ext3_valid_inum(struct super_block *sb, unsigned long ino)
 					EXT4_FEATURE_INCOMPAT_RECOVER|          \
 					EXT4_FEATURE_INCOMPAT_META_BG|          \
 					EXT4_FEATURE_INCOMPAT_EXTENTS|          \
-					EXT4_FEATURE_INCOMPAT_FLEX_BG)
+					EXT4_FEATURE_INCOMPAT_FLEX_BG|          \
+					EXT4_FEATURE_INCOMPAT_LARGEDIR)
 #define EXT4_FEATURE_RO_COMPAT_SUPP	(                       \
                     EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER|    \
 					EXT4_FEATURE_RO_COMPAT_LARGE_FILE|      \
@@ -979,6 +980,19 @@ ext3_group_first_block_no(struct super_block *sb, unsigned long group_no)
  */
 #define ERR_BAD_DX_DIR	-75000
 
+/*
+ * Maximal count of htree levels (root included). A third level is only
+ * allowed if the large directory feature is set on the volume.
+ */
+#define EXT3_HTREE_LEVEL_COMPAT	2
+#define EXT3_HTREE_LEVEL	3
+
+static inline int ext3_dir_htree_level(struct super_block *sb)
+{
+    return EXT3_HAS_INCOMPAT_FEATURE(sb, EXT4_FEATURE_INCOMPAT_LARGEDIR) ?
+           EXT3_HTREE_LEVEL : EXT3_HTREE_LEVEL_COMPAT;
+}
+
 /*
  * This structure will be used for multiple mount protection. It will be
  * written into the block number saved in the s_mmp_block field in the
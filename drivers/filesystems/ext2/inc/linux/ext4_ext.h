@@ -253,5 +253,7 @@ int ext4_ext_get_blocks(void *icb, handle_t *handle, struct inode *inode, ext4_f
 			int create, int flags);
 int ext4_ext_tree_init(void *icb, handle_t *handle, struct inode *inode);
 int ext4_ext_truncate(void *icb, struct inode *inode, unsigned long start);
+long ext4_ext_count_blocks(struct inode *inode, ext4_lblk_t start,
+		ext4_lblk_t end);
 
 #endif	/* _LINUX_EXT4_EXT */
@@ -454,7 +454,8 @@ void Ext2DecodeInode(struct inode *dst, struct ext3_inode *src)
     dst->i_nlink = src->i_links_count;
     dst->i_generation = src->i_generation;
     dst->i_size = src->i_size;
-    if (S_ISREG(src->i_mode)) {
+    if (S_ISREG(src->i_mode) ||
+        EXT3_HAS_INCOMPAT_FEATURE(dst->i_sb, EXT4_FEATURE_INCOMPAT_LARGEDIR)) {
         dst->i_size |= (loff_t)src->i_size_high << 32;
     }
     dst->i_file_acl = src->i_file_acl_lo;
@@ -481,7 +482,8 @@ void Ext2EncodeInode(struct ext3_inode *dst,  struct inode *src)
     dst->i_links_count = src->i_nlink;
     dst->i_generation = src->i_generation;
     dst->i_size = (__u32)src->i_size;
-    if (S_ISREG(src->i_mode)) {
+    if (S_ISREG(src->i_mode) ||
+        EXT3_HAS_INCOMPAT_FEATURE(src->i_sb, EXT4_FEATURE_INCOMPAT_LARGEDIR)) {
         dst->i_size_high = (__u32)(src->i_size >> 32);
     }
     dst->i_file_acl_lo = (__u32)src->i_file_acl;
@@ -960,6 +962,7 @@ Ext2NewBlock(
     ULONG                   dwHint = 0;
     ULONG                   Count = 0;
     ULONG                   Length = 0;
+    ULONGLONG               Free, Reserved;
 
     NTSTATUS                Status = STATUS_DISK_FULL;
 
@@ -967,6 +970,20 @@ Ext2NewBlock(
 
     ExAcquireResourceExclusiveLite(&Vcb->MetaBlock, TRUE);
 
+    /* blocks reserved by delayed allocation are only for their owner */
+    Reserved = Vcb->DelallocBlocks;
+    if (IrpContext) {
+        ULONG Owned = Ext2DelallocOwned(Vcb, IrpContext->DelallocFcb);
+        Reserved = (Reserved > Owned) ? (Reserved - Owned) : 0;
+    }
+    Free = ext3_free_blocks_count(SUPER_BLOCK);
+    if (Free <= Reserved) {
+        goto errorout;
+    }
+    if (*Number > Free - Reserved) {
+        *Number = (ULONG)(Free - Reserved);
+    }
+
     /* validate the hint group and hint block */
     if (GroupHint >= Vcb->sbi.s_groups_count) {
         DbgBreak();
@@ -1052,9 +1069,16 @@ Again:
 
             /* search clear bits from the hint block */
             Count = RtlFindNextForwardRunClear(&BlockBitmap, dwHint, &Index);
-            if (dwHint != 0 && Count == 0) {
-                /* search clear bits from the very beginning */
-                Count = RtlFindNextForwardRunClear(&BlockBitmap, 0, &Index);
+            if (Count < *Number) {
+                ULONG Longest, Start = 0;
+
+                /* prefer the longest free run of the group, instead of
+                   splitting a large extent into tiny fragments */
+                Longest = RtlFindLongestRunClear(&BlockBitmap, &Start);
+                if (Longest > Count) {
+                    Count = Longest;
+                    Index = Start;
+                }
             }
 
             if (Count == 0) {
@@ -437,6 +437,9 @@ int add_dirent_to_buf(struct ext2_icb *icb, struct dentry *dentry,
         de->inode = 0;
     de->name_len = (__u8)namelen;
     memcpy(de->name, name, namelen);
+#ifdef EXT2_HTREE_INDEX
+    ext3_dx_ci_add_block(dir, bh);
+#endif
 
     /*
      * XXX shouldn't update any times until successful
@@ -1042,7 +1045,7 @@ static struct dx_frame *
         goto fail;
     }
 
-    if ((indirect = root->info.indirect_levels) > 1) {
+    if ((indirect = root->info.indirect_levels) >= ext3_dir_htree_level(dir->i_sb)) {
         ext3_warning(dir->i_sb, __FUNCTION__,
                      "Unimplemented inode hash depth: %#06x",
                      root->info.indirect_levels);
@@ -1134,12 +1137,18 @@ fail:
 
 static void dx_release (struct dx_frame *frames)
 {
+    unsigned i, indirect_levels;
+
     if (frames[0].bh == NULL)
         return;
 
-    if (((struct dx_root *) frames[0].bh->b_data)->info.indirect_levels)
-        brelse(frames[1].bh);
-    brelse(frames[0].bh);
+    indirect_levels = ((struct dx_root *) frames[0].bh->b_data)->info.indirect_levels;
+    for (i = 0; i <= indirect_levels; i++) {
+        if (frames[i].bh == NULL)
+            break;
+        brelse(frames[i].bh);
+        frames[i].bh = NULL;
+    }
 }
 
 /*
@@ -1278,7 +1287,7 @@ int ext3_htree_fill_tree(struct ext2_icb *icb, struct file *dir_file,
 {
     struct dx_hash_info hinfo;
     struct ext3_dir_entry_2 *de;
-    struct dx_frame frames[2], *frame;
+    struct dx_frame frames[EXT3_HTREE_LEVEL], *frame;
     int block, err = 0;
     struct inode *dir;
     int count = 0;
@@ -1437,7 +1446,7 @@ struct buffer_head *
     struct super_block * sb;
     struct dx_hash_info	hinfo = {0};
     u32 hash;
-    struct dx_frame frames[2], *frame;
+    struct dx_frame frames[EXT3_HTREE_LEVEL], *frame;
     struct ext3_dir_entry_2 *de, *top;
     struct buffer_head *bh;
     unsigned long block;
@@ -1607,15 +1616,19 @@ struct ext3_dir_entry_2* do_split(struct ext2_icb *icb, struct inode *dir, struc
 int ext3_dx_add_entry(struct ext2_icb *icb, struct dentry *dentry,
                       struct inode *inode)
 {
-    struct dx_frame frames[2], *frame;
+    struct dx_frame frames[EXT3_HTREE_LEVEL], *frame;
     struct dx_entry *entries, *at;
     struct dx_hash_info hinfo;
     struct buffer_head * bh;
     struct inode *dir = dentry->d_parent->d_inode;
     struct super_block * sb = dir->i_sb;
     struct ext3_dir_entry_2 *de;
+    int restart;
     int err;
 
+again:
+    restart = 0;
+    memset(frames, 0, sizeof(frames));
     frame = dx_probe(icb, dentry, NULL, &hinfo, frames, &err);
     if (!frame)
         return err;
@@ -1637,28 +1650,46 @@ int ext3_dx_add_entry(struct ext2_icb *icb, struct dentry *dentry,
     /* Need to split index? */
     if (dx_get_count(entries) == dx_get_limit(entries)) {
         u32 newblock;
-        unsigned icount = dx_get_count(entries);
-        int levels = (int)(frame - frames);
+        unsigned icount;
+        int levels = (int)(frame - frames) + 1;
+        int add_level = 1;
         struct dx_entry *entries2;
         struct dx_node *node2;
         struct buffer_head *bh2;
 
-        if (levels && (dx_get_count(frames->entries) ==
-                       dx_get_limit(frames->entries))) {
+        /*
+         * Walk up to the first index block which still has room for
+         * one more entry. Splitting an upper level leaves the lower
+         * levels unchanged, so the insertion is restarted afterwards.
+         */
+        while (frame > frames) {
+            if (dx_get_count((frame - 1)->entries) <
+                    dx_get_limit((frame - 1)->entries)) {
+                add_level = 0;
+                break;
+            }
+            frame--;
+            at = frame->at;
+            entries = frame->entries;
+            restart = 1;
+        }
+        if (add_level && levels == ext3_dir_htree_level(sb)) {
             ext3_warning(sb, __FUNCTION__,
-                         "Directory index full!");
+                         "Directory (ino: %lu) index full, reach max htree level: %d",
+                         dir->i_ino, levels);
             err = -ENOSPC;
             goto cleanup;
         }
+        icount = dx_get_count(entries);
         bh2 = ext3_append (icb, dir, &newblock, &err);
         if (!(bh2))
             goto cleanup;
         node2 = (struct dx_node *)(bh2->b_data);
         entries2 = node2->entries;
-        node2->fake.rec_len = cpu_to_le16(sb->s_blocksize);
-        node2->fake.inode = 0;
+        memset(&node2->fake, 0, sizeof(struct fake_dirent));
+        node2->fake.rec_len = ext3_rec_len_to_disk(sb->s_blocksize);
 
-        if (levels) {
+        if (!add_level) {
             unsigned icount1 = icount/2, icount2 = icount - icount1;
             unsigned hash2 = dx_get_hash(entries + icount1);
             dxtrace(printk("Split index %i/%i\n", icount1, icount2));
@@ -1675,14 +1706,21 @@ int ext3_dx_add_entry(struct ext2_icb *icb, struct dentry *dentry,
                 frame->entries = entries = entries2;
                 swap(struct buffer_head *, frame->bh, bh2);
             }
-            dx_insert_block (frames + 0, hash2, newblock);
-            dxtrace(dx_show_index ("node", frames[1].entries));
+            dx_insert_block (frame - 1, hash2, newblock);
+            dxtrace(dx_show_index ("node", frame->entries));
             dxtrace(dx_show_index ("node",
                                    ((struct dx_node *) bh2->b_data)->entries));
             set_buffer_dirty(bh2);
             brelse (bh2);
+            set_buffer_dirty(frame->bh);
+            set_buffer_dirty((frame - 1)->bh);
+            if (restart) {
+                err = 0;
+                goto cleanup;
+            }
         } else {
-            dxtrace(printk("Creating second level index...\n"));
+            struct dx_root *dxroot;
+
             memcpy((char *) entries2, (char *) entries,
                    icount * sizeof(struct dx_entry));
             dx_set_limit(entries2, dx_node_limit(dir));
@@ -1690,16 +1728,20 @@ int ext3_dx_add_entry(struct ext2_icb *icb, struct dentry *dentry,
             /* Set up root */
             dx_set_count(entries, 1);
             dx_set_block(entries + 0, newblock);
-            ((struct dx_root *) frames[0].bh->b_data)->info.indirect_levels = 1;
+            dxroot = (struct dx_root *) frames[0].bh->b_data;
+            dxroot->info.indirect_levels += 1;
+            dxtrace(printk("Creating %d level index...\n",
+                           dxroot->info.indirect_levels));
+            set_buffer_dirty(bh2);
+            brelse (bh2);
+            // ext3_journal_dirty_metadata(handle, frames[0].bh);
+            set_buffer_dirty(frames[0].bh);
 
-            /* Add new access path frame */
-            frame = frames + 1;
-            frame->at = at = at - entries + entries2;
-            frame->entries = entries = entries2;
-            frame->bh = bh2;
+            /* Probe again, now through the new index level */
+            restart = 1;
+            err = 0;
+            goto cleanup;
         }
-        // ext3_journal_dirty_metadata(handle, frames[0].bh);
-        set_buffer_dirty(frames[0].bh);
     }
     de = do_split(icb, dir, &bh, frame, &hinfo, &err);
     if (!de)
@@ -1712,6 +1754,8 @@ cleanup:
     if (bh)
         brelse(bh);
     dx_release(frames);
+    if (restart && err == 0)
+        goto again;
     return err;
 }
 
@@ -1821,6 +1865,8 @@ struct ext3_dir_entry_2 *
     de = dx_pack_dirents(data1,blocksize);
     de->rec_len = cpu_to_le16(data1 + blocksize - (char *) de);
     de2->rec_len = cpu_to_le16(data2 + blocksize - (char *) de2);
+    ext3_dx_ci_add_block(dir, *bh);
+    ext3_dx_ci_add_block(dir, bh2);
     dxtrace(dx_show_leaf (icb, hinfo, (struct ext3_dir_entry_2 *) data1, blocksize, 1));
     dxtrace(dx_show_leaf (icb, hinfo, (struct ext3_dir_entry_2 *) data2, blocksize, 1));
 
@@ -1852,7 +1898,7 @@ int make_indexed_dir(struct ext2_icb *icb, struct dentry *dentry,
     int		namelen = dentry->d_name.len;
     struct buffer_head *bh2;
     struct dx_root	*root;
-    struct dx_frame	frames[2], *frame;
+    struct dx_frame	frames[EXT3_HTREE_LEVEL], *frame;
     struct dx_entry *entries;
     struct ext3_dir_entry_2	*de, *de2;
     char		*data1, *top;
@@ -2144,6 +2190,287 @@ static inline int search_dirblock(struct buffer_head * bh,
     return 0;
 }
 
+#ifdef EXT2_HTREE_INDEX
+/*
+ * Name lookups issued by IRP_MJ_CREATE are case insensitive unless the
+ * caller asked otherwise, and cannot be answered by the hash index alone.
+ */
+static inline int ext3_dx_case_blind(struct ext2_icb *icb)
+{
+    return icb->MajorFunction == IRP_MJ_CREATE && icb->Irp &&
+           !IsFlagOn(IoGetCurrentIrpStackLocation(icb->Irp)->Flags,
+                     SL_CASE_SENSITIVE);
+}
+
+/*
+ * Case insensitive name index
+ *
+ * The htree hashes names exactly as they are stored, while names are
+ * matched case insensitively, so a miss in the htree alone doesn't prove
+ * that a name is absent. Directories which get such lookups keep a table
+ * of (case folded name hash, leaf block) pairs in memory, which covers
+ * every live entry: it is built from a single pass over the directory and
+ * updated whenever a name is added to a block or moved by a split. Pairs
+ * are never removed, a stale one only costs the search of a block.
+ *
+ * All indexes of a volume are protected by Vcb->DirIndexLock.
+ */
+
+#define DX_CI_BUCKETS       64
+#define DX_CI_SLAB_NODES    254
+
+struct dx_ci_node {
+    struct dx_ci_node  *next;
+    __u32               hash;
+    __u32               block;
+};
+
+struct dx_ci_slab {
+    struct dx_ci_slab  *next;
+    unsigned            used;
+    struct dx_ci_node   nodes[DX_CI_SLAB_NODES];
+};
+
+struct dx_ci_index {
+    struct dx_ci_node **buckets;
+    unsigned            mask;
+    unsigned            count;
+    struct dx_ci_slab  *slabs;
+};
+
+/* Must fold exactly like ext3_match() */
+static __u32 dx_ci_hash(const char *name, int len)
+{
+    __u32 hash = 0x811c9dc5;
+
+    while (len--)
+        hash = (hash ^ (__u8)toupper(*name++)) * 0x01000193;
+    return hash;
+}
+
+static void dx_ci_destroy(struct dx_ci_index *ci)
+{
+    struct dx_ci_slab *slab;
+
+    while ((slab = ci->slabs) != NULL) {
+        ci->slabs = slab->next;
+        kfree(slab);
+    }
+    kfree(ci->buckets);
+    kfree(ci);
+}
+
+static struct dx_ci_index *dx_ci_create(void)
+{
+    struct dx_ci_index *ci;
+
+    ci = kzalloc(sizeof(struct dx_ci_index), GFP_KERNEL);
+    if (!ci)
+        return NULL;
+    ci->buckets = kzalloc(DX_CI_BUCKETS * sizeof(struct dx_ci_node *), GFP_KERNEL);
+    if (!ci->buckets) {
+        kfree(ci);
+        return NULL;
+    }
+    ci->mask = DX_CI_BUCKETS - 1;
+    return ci;
+}
+
+/* Keep the chains short, a failure to grow only makes them longer */
+static void dx_ci_grow(struct dx_ci_index *ci)
+{
+    struct dx_ci_node **buckets, *node, *next;
+    unsigned mask = ci->mask * 2 + 1, i;
+
+    buckets = kzalloc((mask + 1) * sizeof(struct dx_ci_node *), GFP_KERNEL);
+    if (!buckets)
+        return;
+    for (i = 0; i <= ci->mask; i++) {
+        for (node = ci->buckets[i]; node; node = next) {
+            next = node->next;
+            node->next = buckets[node->hash & mask];
+            buckets[node->hash & mask] = node;
+        }
+    }
+    kfree(ci->buckets);
+    ci->buckets = buckets;
+    ci->mask = mask;
+}
+
+static int dx_ci_insert(struct dx_ci_index *ci, __u32 hash, __u32 block)
+{
+    struct dx_ci_node *node;
+    struct dx_ci_slab *slab = ci->slabs;
+
+    /* A block already known for this hash needs no second pair */
+    for (node = ci->buckets[hash & ci->mask]; node; node = node->next) {
+        if (node->hash == hash && node->block == block)
+            return 0;
+    }
+
+    if (!slab || slab->used == DX_CI_SLAB_NODES) {
+        slab = kmalloc(sizeof(struct dx_ci_slab), GFP_KERNEL);
+        if (!slab)
+            return -ENOMEM;
+        slab->used = 0;
+        slab->next = ci->slabs;
+        ci->slabs = slab;
+    }
+
+    node = &slab->nodes[slab->used++];
+    node->hash = hash;
+    node->block = block;
+    node->next = ci->buckets[hash & ci->mask];
+    ci->buckets[hash & ci->mask] = node;
+
+    if (++ci->count > 2 * (ci->mask + 1))
+        dx_ci_grow(ci);
+    return 0;
+}
+
+static int dx_ci_insert_block(struct dx_ci_index *ci, struct inode *dir,
+                              struct buffer_head *bh)
+{
+    struct ext3_dir_entry_2 *de;
+    char *dlimit;
+    int err;
+
+    de = (struct ext3_dir_entry_2 *) bh->b_data;
+    dlimit = bh->b_data + dir->i_sb->s_blocksize;
+    while ((char *) de < dlimit) {
+        if (!ext3_check_dir_entry("dx_ci_insert_block", dir, de, bh,
+                                  (unsigned long)((char *) de - bh->b_data)))
+            return -EIO;
+        if (de->inode && de->name_len) {
+            err = dx_ci_insert(ci, dx_ci_hash(de->name, de->name_len),
+                               (__u32)bh->b_blocknr);
+            if (err)
+                return err;
+        }
+        de = ext3_next_entry(de);
+    }
+    return 0;
+}
+
+/*
+ * Record the names of a directory block which just got new entries.
+ * If that fails, the index can no longer be trusted and is dropped.
+ */
+void ext3_dx_ci_add_block(struct inode *dir, struct buffer_head *bh)
+{
+    PEXT2_MCB Mcb = CONTAINING_RECORD(dir, EXT2_MCB, Inode);
+    PEXT2_VCB Vcb = dir->i_sb->s_priv;
+
+    ExAcquireResourceExclusiveLite(&Vcb->DirIndexLock, TRUE);
+    if (Mcb->CiIndex && dx_ci_insert_block(Mcb->CiIndex, dir, bh)) {
+        dx_ci_destroy(Mcb->CiIndex);
+        Mcb->CiIndex = NULL;
+    }
+    ExReleaseResourceLite(&Vcb->DirIndexLock);
+}
+
+void ext3_dx_ci_free(struct inode *dir)
+{
+    PEXT2_MCB Mcb = CONTAINING_RECORD(dir, EXT2_MCB, Inode);
+
+    if (Mcb->CiIndex) {
+        dx_ci_destroy(Mcb->CiIndex);
+        Mcb->CiIndex = NULL;
+    }
+}
+
+/*
+ * Index every block of the directory. Called with DirIndexLock held
+ * exclusively, so blocks which change while we read them get recorded
+ * again once the index is published.
+ */
+static struct dx_ci_index *dx_ci_build(struct ext2_icb *icb, struct inode *dir)
+{
+    struct dx_ci_index *ci;
+    struct buffer_head *bh;
+    ext3_lblk_t block, nblocks;
+    int err = 0;
+
+    ci = dx_ci_create();
+    if (!ci)
+        return NULL;
+
+    nblocks = (ext3_lblk_t)(dir->i_size >> EXT3_BLOCK_SIZE_BITS(dir->i_sb));
+    for (block = 0; block < nblocks && !err; block++) {
+        bh = ext3_bread(icb, dir, block, &err);
+        if (!bh) {
+            err = err ? err : -EIO;
+            break;
+        }
+        err = dx_ci_insert_block(ci, dir, bh);
+        brelse(bh);
+    }
+
+    if (err) {
+        dx_ci_destroy(ci);
+        return NULL;
+    }
+    return ci;
+}
+
+/*
+ * Look a name up through the case insensitive index. A miss is final,
+ * ERR_BAD_DX_DIR is returned if the index isn't available.
+ */
+static struct buffer_head *
+            ext3_dx_ci_find_entry(struct ext2_icb *icb, struct dentry *dentry,
+                                  struct ext3_dir_entry_2 **res_dir, int *err)
+{
+    struct inode *dir = dentry->d_parent->d_inode;
+    PEXT2_MCB Mcb = CONTAINING_RECORD(dir, EXT2_MCB, Inode);
+    PEXT2_VCB Vcb = dir->i_sb->s_priv;
+    struct dx_ci_node *node;
+    struct buffer_head *bh = NULL;
+    __u32 hash;
+    int rc;
+
+    *err = ERR_BAD_DX_DIR;
+    hash = dx_ci_hash(dentry->d_name.name, dentry->d_name.len);
+
+    ExAcquireResourceSharedLite(&Vcb->DirIndexLock, TRUE);
+    if (!Mcb->CiIndex) {
+        ExReleaseResourceLite(&Vcb->DirIndexLock);
+        ExAcquireResourceExclusiveLite(&Vcb->DirIndexLock, TRUE);
+        if (!Mcb->CiIndex)
+            Mcb->CiIndex = dx_ci_build(icb, dir);
+        if (!Mcb->CiIndex)
+            goto out;
+    }
+
+    *err = -ENOENT;
+    for (node = Mcb->CiIndex->buckets[hash & Mcb->CiIndex->mask];
+            node; node = node->next) {
+        if (node->hash != hash)
+            continue;
+        bh = sb_bread(dir->i_sb, node->block);
+        if (!bh) {
+            *err = -EIO;
+            break;
+        }
+        rc = search_dirblock(bh, dir, dentry, 0, res_dir);
+        if (rc == 1) {
+            *err = 0;
+            break;
+        }
+        brelse(bh);
+        bh = NULL;
+        if (rc < 0) {
+            *err = ERR_BAD_DX_DIR;
+            break;
+        }
+    }
+
+out:
+    ExReleaseResourceLite(&Vcb->DirIndexLock);
+    return bh;
+}
+#endif
+
 /*
  * define how far ahead to read directories while searching them.
  */
@@ -2186,14 +2513,22 @@ struct buffer_head * ext3_find_entry (struct ext2_icb *icb,
         return NULL;
 
 #ifdef EXT2_HTREE_INDEX
-    if (icb->MajorFunction != IRP_MJ_CREATE && is_dx(dir)) {
+    if (is_dx(dir)) {
         bh = ext3_dx_find_entry(icb, dentry, res_dir, &err);
         /*
          * On success, or if the error was file not found,
          * return.  Otherwise, fall back to doing a search the
          * old fashioned way.
+         *
+         * The hash is computed on the name as given, so a case
+         * insensitive open which missed in the htree has to ask
+         * the case insensitive index as well.
          */
-        if (bh || (err != ERR_BAD_DX_DIR))
+        if (bh)
+            return bh;
+        if (err != ERR_BAD_DX_DIR && ext3_dx_case_blind(icb))
+            bh = ext3_dx_ci_find_entry(icb, dentry, res_dir, &err);
+        if (bh || err != ERR_BAD_DX_DIR)
             return bh;
         dxtrace(printk("ext4_find_entry: dx failed, "
                        "falling back\n"));
@@ -2517,6 +2517,54 @@ int ext4_ext_truncate(void *icb, struct inode *inode, unsigned long start)
 	return ret;
 }
 
+/*
+ * ext4_ext_count_blocks:
+ * returns the number of blocks in [start, end) backed by an extent,
+ * written or unwritten, or a negative error code.
+ */
+long ext4_ext_count_blocks(struct inode *inode, ext4_lblk_t start,
+		ext4_lblk_t end)
+{
+	struct ext4_ext_path *path;
+	struct ext4_extent *ex;
+	ext4_lblk_t ee_block, next;
+	unsigned short ee_len;
+	long count = 0;
+
+	while (start < end) {
+		path = ext4_find_extent(inode, start, NULL, 0);
+		if (IS_ERR(path))
+			return PTR_ERR(path);
+
+		ex = path[ext_depth(inode)].p_ext;
+		if (ex == NULL) {
+			/* empty tree */
+			next = EXT_MAX_BLOCKS;
+		} else {
+			ee_block = le32_to_cpu(ex->ee_block);
+			ee_len = ext4_ext_get_actual_len(ex);
+			if (start < ee_block) {
+				/* hole before the first extent */
+				next = ee_block;
+			} else if (start < ee_block + ee_len) {
+				next = min(ee_block + ee_len, end);
+				count += next - start;
+			} else {
+				next = ext4_ext_next_allocated_block(path);
+			}
+		}
+
+		ext4_ext_drop_refs(path);
+		kfree(path);
+
+		if (next <= start)
+			break;
+		start = next;
+	}
+
+	return count;
+}
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
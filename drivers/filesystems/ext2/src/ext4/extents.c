@@ -69,7 +69,8 @@ Ext2MapExtent(
     }
     
     if (Alloc) {
-        if (Number && !*Number) {
+        /* allocate the whole range wanted by caller in one extent */
+        if (Number && *Number) {
             if (max_blocks > *Number) {
                 max_blocks = *Number;
             }
@@ -196,6 +197,41 @@ Ext2ExpandExtent(
 }
 
 
+/*
+ * Blocks reserved by delayed allocation are the holes below AllocationSize:
+ * count the ones at or beyond Wanted, clamped to the reservation of the FCB.
+ */
+
+static ULONG
+Ext2DelallocBeyond(
+    PEXT2_VCB         Vcb,
+    PEXT2_MCB         Mcb,
+    ULONG             Wanted
+    )
+{
+    LONGLONG Size = Mcb->Fcb->Header.AllocationSize.QuadPart;
+    ULONG    End;
+    long     Allocated;
+
+    if (Size < Mcb->Inode.i_size)
+        Size = Mcb->Inode.i_size;
+    End = (ULONG)((Size + BLOCK_SIZE - 1) >> BLOCK_BITS);
+    if (End <= Wanted)
+        return 0;
+
+    if (get_ext4_header(&Mcb->Inode)->eh_magic != EXT4_EXT_MAGIC)
+        Allocated = 0;
+    else
+        Allocated = ext4_ext_count_blocks(&Mcb->Inode, Wanted, End);
+    if (Allocated < 0)
+        return 0;
+    if (End - Wanted - (ULONG)Allocated > Mcb->Fcb->DelallocBlocks)
+        return Mcb->Fcb->DelallocBlocks;
+
+    return End - Wanted - (ULONG)Allocated;
+}
+
+
 NTSTATUS
 Ext2TruncateExtent(
     PEXT2_IRP_CONTEXT IrpContext,
@@ -208,6 +244,7 @@ Ext2TruncateExtent(
 
     ULONG    Extra = 0;
     ULONG    Wanted = 0;
+    ULONG    Reserved = 0;
     ULONG    End;
     ULONG    Removed;
     int      err;
@@ -219,6 +256,11 @@ Ext2TruncateExtent(
     /* calculate blocks to be freed */
     Extra = End - Wanted;
 
+    /* reserved blocks beyond the new size won't be written out any more */
+    if (Mcb->Fcb && Mcb->Fcb->DelallocBlocks) {
+        Reserved = Ext2DelallocBeyond(Vcb, Mcb, Wanted);
+    }
+
     err = ext4_ext_truncate(IrpContext, &Mcb->Inode, Wanted);
     if (err == 0) {
         if (!Ext2RemoveBlockExtent(Vcb, Mcb, Wanted, Extra)) {
@@ -237,8 +279,131 @@ Ext2TruncateExtent(
     if (Mcb->Inode.i_size > (loff_t)(Size->QuadPart))
         Mcb->Inode.i_size = (loff_t)(Size->QuadPart);
 
+    if (NT_SUCCESS(Status) && Reserved) {
+        Ext2ReleaseExtent(Vcb, Mcb->Fcb, Reserved);
+    }
+
     /* Save modifications on i_blocks field and i_size field of the inode. */
     Ext2SaveInode(IrpContext, Vcb, &Mcb->Inode);
 
     return Status;
 }
+
+
+/*
+ * Delayed allocation: extending writes to extent-mapped files only reserve
+ * blocks. The blocks get allocated when data is written out by the lazy
+ * writer or a flush, as contiguous extents covering the whole i/o range.
+ *
+ * Fcb->DelallocBlocks counts the reserved data blocks of a file, while
+ * Vcb->DelallocBlocks also covers the extent tree blocks which might be
+ * needed to map them. Ext2NewBlock() keeps reserved blocks for their
+ * owner (IrpContext->DelallocFcb) only.
+ */
+
+static ULONG
+Ext2DelallocMetaBlocks(
+    PEXT2_VCB         Vcb,
+    ULONG             Number
+    )
+{
+    ULONG PerBlock = (BLOCK_SIZE - sizeof(EXT4_EXTENT_HEADER)) /
+                     sizeof(EXT4_EXTENT);
+
+    if (Number == 0)
+        return 0;
+
+    /* one leaf per PerBlock extents when each block ends up in its
+       own extent, plus one index block for the leaves to split */
+    return (Number + PerBlock - 1) / PerBlock + 1;
+}
+
+
+BOOLEAN
+Ext2CanDelayAllocation(
+    PEXT2_IRP_CONTEXT IrpContext,
+    PEXT2_MCB         Mcb
+    )
+{
+    /* Ext2WriteFile marks extending writes with IRP_MJ_MAXIMUM_FUNCTION */
+    if (IrpContext == NULL ||
+        IrpContext->MajorFunction != IRP_MJ_WRITE + IRP_MJ_MAXIMUM_FUNCTION)
+        return FALSE;
+
+    if (IsMcbDirectory(Mcb) || IsMcbSpecialFile(Mcb) || Mcb->Fcb == NULL)
+        return FALSE;
+
+    /* paging file must have all its blocks at hand */
+    return !IsFlagOn(Mcb->Fcb->Flags, FCB_PAGE_FILE);
+}
+
+
+NTSTATUS
+Ext2ReserveExtent(
+    PEXT2_VCB         Vcb,
+    PEXT2_FCB         Fcb,
+    ULONG             Number
+    )
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+    ULONG    Meta;
+
+    ExAcquireResourceExclusiveLite(&Vcb->MetaBlock, TRUE);
+
+    Meta = Ext2DelallocMetaBlocks(Vcb, Fcb->DelallocBlocks + Number) -
+           Ext2DelallocMetaBlocks(Vcb, Fcb->DelallocBlocks);
+
+    if (ext3_free_blocks_count(SUPER_BLOCK) <
+        (ext3_fsblk_t)Vcb->DelallocBlocks + Number + Meta) {
+        Status = STATUS_DISK_FULL;
+    } else {
+        Vcb->DelallocBlocks += Number + Meta;
+        Fcb->DelallocBlocks += Number;
+    }
+
+    ExReleaseResourceLite(&Vcb->MetaBlock);
+
+    return Status;
+}
+
+
+/* called with Vcb->MetaBlock held: the blocks Fcb may take from the reserve */
+ULONG
+Ext2DelallocOwned(
+    PEXT2_VCB         Vcb,
+    PEXT2_FCB         Fcb
+    )
+{
+    if (Fcb == NULL)
+        return 0;
+
+    return Fcb->DelallocBlocks +
+           Ext2DelallocMetaBlocks(Vcb, Fcb->DelallocBlocks);
+}
+
+
+VOID
+Ext2ReleaseExtent(
+    PEXT2_VCB         Vcb,
+    PEXT2_FCB         Fcb,
+    ULONG             Number
+    )
+{
+    ULONG Meta;
+
+    ExAcquireResourceExclusiveLite(&Vcb->MetaBlock, TRUE);
+
+    if (Number > Fcb->DelallocBlocks)
+        Number = Fcb->DelallocBlocks;
+    Meta = Ext2DelallocMetaBlocks(Vcb, Fcb->DelallocBlocks) -
+           Ext2DelallocMetaBlocks(Vcb, Fcb->DelallocBlocks - Number);
+    Fcb->DelallocBlocks -= Number;
+    Number += Meta;
+
+    ASSERT(Vcb->DelallocBlocks >= Number);
+    if (Number > Vcb->DelallocBlocks)
+        Number = Vcb->DelallocBlocks;
+    Vcb->DelallocBlocks -= Number;
+
+    ExReleaseResourceLite(&Vcb->MetaBlock);
+}
@@ -1172,7 +1172,24 @@ Ext2ExpandFile(
 	/* expandind file extents */ 
     if (INODE_HAS_EXTENT(&Mcb->Inode)) {
 
-        status = Ext2ExpandExtent(IrpContext, Vcb, Mcb, Start, End, Size);
+        if (Ext2CanDelayAllocation(IrpContext, Mcb)) {
+
+            /* blocks already covered by AllocationSize are allocated */
+            ULONG Allocated = (ULONG)((Mcb->Fcb->Header.AllocationSize.QuadPart +
+                                       BLOCK_SIZE - 1) >> BLOCK_BITS);
+            if (Start < Allocated)
+                Start = Allocated;
+
+            /* only reserve blocks here, Ext2WriteInode allocates them */
+            if (End > Start)
+                status = Ext2ReserveExtent(Vcb, Mcb->Fcb, End - Start);
+            if (!NT_SUCCESS(status))
+                Size->QuadPart = ((LONGLONG) Start) << BLOCK_BITS;
+
+        } else {
+
+            status = Ext2ExpandExtent(IrpContext, Vcb, Mcb, Start, End, Size);
+        }
 
     } else {
 
@@ -251,6 +251,11 @@ Ext2FreeFcb (IN PEXT2_FCB Fcb)
         FsRtlTeardownPerStreamContexts(&Fcb->Header);
 #endif
 
+        /* return reservation of data never written out */
+        if (Fcb->DelallocBlocks) {
+            Ext2ReleaseExtent(Vcb, Fcb, Fcb->DelallocBlocks);
+        }
+
         FsRtlUninitializeFileLock(&Fcb->FileLockAnchor);
         FsRtlUninitializeOplock(&Fcb->Oplock);
         ExDeleteResourceLite(&Fcb->MainResource);
@@ -1270,6 +1275,18 @@ Ext2BuildExtents(
         /* try to BlockMap in case failed to access Extents cache */
         if (!IsZoneInited(Mcb) || (bAlloc && Block == 0)) {
 
+            ULONGLONG Blocks = Mcb->Inode.i_blocks;
+
+            /* ask for the rest of the range to get one contiguous extent */
+            if (bAlloc) {
+                Mapped = End - Start;
+            }
+
+            /* new blocks may come from the reservation of this file */
+            if (bAlloc && IrpContext) {
+                IrpContext->DelallocFcb = Mcb->Fcb;
+            }
+
             Status = Ext2BlockMap(
                              IrpContext,
                              Vcb,
@@ -1279,10 +1296,24 @@ Ext2BuildExtents(
                              &Block,
                              &Mapped
                      );
+
+            if (bAlloc && IrpContext) {
+                IrpContext->DelallocFcb = NULL;
+            }
+
             if (!NT_SUCCESS(Status)) {
                 break;
             }
 
+            /* consume the data blocks reserved by delayed allocation,
+               the extent blocks are accounted along with them */
+            if (Mcb->Fcb && Mcb->Fcb->DelallocBlocks &&
+                Mcb->Inode.i_blocks > Blocks) {
+                ULONG Allocated = (ULONG)((Mcb->Inode.i_blocks - Blocks) >>
+                                          (BLOCK_BITS - 9));
+                Ext2ReleaseExtent(Vcb, Mcb->Fcb, min(Allocated, Mapped));
+            }
+
             /* skip wrong blocks, in case wrongly treating symlink
                target names as blocks, silly  */
             if (Block >= TOTAL_BLOCKS) {
@@ -1586,6 +1617,11 @@ Ext2FreeMcb (IN PEXT2_VCB Vcb, IN PEXT2_MCB Mcb)
         Ext2FreeEntry(Mcb->de);
     }
 
+#ifdef EXT2_HTREE_INDEX
+    /* free case insensitive name index */
+    ext3_dx_ci_free(&Mcb->Inode);
+#endif
+
     Mcb->Identifier.Type = 0;
     Mcb->Identifier.Size = 0;
 
@@ -2370,6 +2406,7 @@ Ext2InitializeVcb( IN PEXT2_IRP_CONTEXT IrpContext,
         ExInitializeResourceLite(&Vcb->MetaInode);
         ExInitializeResourceLite(&Vcb->MetaBlock);
         ExInitializeResourceLite(&Vcb->McbLock);
+        ExInitializeResourceLite(&Vcb->DirIndexLock);
         ExInitializeResourceLite(&Vcb->FcbLock);
         ExInitializeResourceLite(&Vcb->sbi.s_gd_lock);
 #ifndef _WIN2K_TARGET_
@@ -2769,6 +2806,7 @@ Ext2InitializeVcb( IN PEXT2_IRP_CONTEXT IrpContext,
             if (VcbResourceInitialized) {
                 ExDeleteResourceLite(&Vcb->FcbLock);
                 ExDeleteResourceLite(&Vcb->McbLock);
+                ExDeleteResourceLite(&Vcb->DirIndexLock);
                 ExDeleteResourceLite(&Vcb->MetaInode);
                 ExDeleteResourceLite(&Vcb->MetaBlock);
                 ExDeleteResourceLite(&Vcb->sbi.s_gd_lock);
@@ -2853,6 +2891,7 @@ Ext2DestroyVcb (IN PEXT2_VCB Vcb)
     ExDeleteNPagedLookasideList(&(Vcb->InodeLookasideList));
     ExDeleteResourceLite(&Vcb->FcbLock);
     ExDeleteResourceLite(&Vcb->McbLock);
+    ExDeleteResourceLite(&Vcb->DirIndexLock);
     ExDeleteResourceLite(&Vcb->MetaInode);
     ExDeleteResourceLite(&Vcb->MetaBlock);
     ExDeleteResourceLite(&Vcb->sbi.s_gd_lock);
@@ -22,6 +22,17 @@ extern PEXT2_GLOBAL Ext2Global;
 #pragma alloc_text(PAGE, Ext2SetVolumeInformation)
 #endif
 
+/* free blocks minus the ones reserved by delayed allocation */
+static ULONGLONG
+Ext2AvailableBlocks(PEXT2_VCB Vcb)
+{
+    ULONGLONG Free = ext3_free_blocks_count(SUPER_BLOCK);
+
+    if (Free <= Vcb->DelallocBlocks)
+        return 0;
+    return Free - Vcb->DelallocBlocks;
+}
+
 
 NTSTATUS
 Ext2QueryVolumeInformation (IN PEXT2_IRP_CONTEXT IrpContext)
@@ -133,7 +144,7 @@ Ext2QueryVolumeInformation (IN PEXT2_IRP_CONTEXT IrpContext)
             FsSizeInfo->TotalAllocationUnits.QuadPart =
                 ext3_blocks_count(SUPER_BLOCK);
             FsSizeInfo->AvailableAllocationUnits.QuadPart =
-                ext3_free_blocks_count(SUPER_BLOCK);
+                Ext2AvailableBlocks(Vcb);
             FsSizeInfo->SectorsPerAllocationUnit =
                 Vcb->BlockSize / Vcb->DiskGeometry.BytesPerSector;
             FsSizeInfo->BytesPerSector =
@@ -246,11 +257,11 @@ Ext2QueryVolumeInformation (IN PEXT2_IRP_CONTEXT IrpContext)
                     ext3_blocks_count(SUPER_BLOCK);
 
                 PFFFSI->CallerAvailableAllocationUnits.QuadPart =
-                    ext3_free_blocks_count(SUPER_BLOCK);
+                    Ext2AvailableBlocks(Vcb);
 
                 /* - Vcb->SuperBlock->s_r_blocks_count; */
                 PFFFSI->ActualAvailableAllocationUnits.QuadPart =
-                    ext3_free_blocks_count(SUPER_BLOCK);
+                    Ext2AvailableBlocks(Vcb);
             }
 
             PFFFSI->SectorsPerAllocationUnit =
@@ -517,6 +517,9 @@ AfdStreamSocketConnect(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         if( !NT_SUCCESS(Status) )
             break;
 
+        /* Before the SYN goes out, so that it advertises the right window */
+        ApplyTransportBufferSizes( FCB );
+
         if (FCB->ConnectReturnInfo)
         {
             ExFreePoolWithTag(FCB->ConnectReturnInfo, TAG_AFD_TDI_CONNECTION_INFORMATION);
@@ -10,6 +10,8 @@
 
 #include "afd.h"
 
+#include <tdiinfo.h>
+
 NTSTATUS NTAPI
 AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
             PIO_STACK_LOCATION IrpSp ) {
@@ -98,6 +100,34 @@ AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     return UnlockAndMaybeComplete( FCB, Status, Irp, 0 );
 }
 
+static VOID
+SetTransportBufferSize(PAFD_FCB FCB, ULONG Id, ULONG Size)
+{
+    /* Stream transports keep their own per-connection buffers, which
+     * may be larger than what we buffer here */
+    if ((FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS) || !FCB->Connection.Object || !Size)
+        return;
+
+    /* This is only a hint, the transport clamps or ignores it */
+    TdiSetInformationEx(FCB->Connection.Object,
+                        CO_TL_ENTITY,
+                        0,
+                        INFO_CLASS_PROTOCOL,
+                        INFO_TYPE_CONNECTION,
+                        Id,
+                        &Size,
+                        sizeof(Size));
+}
+
+/* Stream sockets only get a connection object when they connect or are
+ * accepted, the sizes set before that are applied from there */
+VOID
+ApplyTransportBufferSizes(PAFD_FCB FCB)
+{
+    SetTransportBufferSize(FCB, TCP_SOCKET_RCVBUF, FCB->Recv.TransportSize);
+    SetTransportBufferSize(FCB, TCP_SOCKET_SNDBUF, FCB->Send.TransportSize);
+}
+
 NTSTATUS NTAPI
 AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
             PIO_STACK_LOCATION IrpSp ) {
@@ -124,9 +154,14 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 FCB->OobInline = InfoReq->Information.Boolean;
                 break;
             case AFD_INFO_RECEIVE_WINDOW_SIZE:
+                if (InfoReq->Information.Ulong > 0)
+                    FCB->Recv.TransportSize = InfoReq->Information.Ulong;
+
                 if (FCB->State == SOCKET_STATE_CONNECTED ||
                     FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS)
                 {
+                    SetTransportBufferSize(FCB, TCP_SOCKET_RCVBUF, InfoReq->Information.Ulong);
+
                     /* FIXME: likely not right, check tcpip.sys for TDI_QUERY_MAX_DATAGRAM_INFO */
                     if (InfoReq->Information.Ulong > 0 && InfoReq->Information.Ulong < 0xFFFF &&
                         InfoReq->Information.Ulong != FCB->Recv.Size)
@@ -137,17 +172,27 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 
                         if (NewBuffer)
                         {
-                            if (FCB->Recv.Content > InfoReq->Information.Ulong)
-                                FCB->Recv.Content = InfoReq->Information.Ulong;
-
-                            if (FCB->Recv.Window)
+                            if (!(FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS) && FCB->Recv.Window)
                             {
-                                RtlCopyMemory(NewBuffer,
-                                              FCB->Recv.Window,
-                                              FCB->Recv.Content);
+                                /* Unwrap the buffered stream data into the new window */
+                                LinearizeReceiveRing(FCB, NewBuffer, InfoReq->Information.Ulong);
 
                                 ExFreePoolWithTag(FCB->Recv.Window, TAG_AFD_DATA_BUFFER);
                             }
+                            else
+                            {
+                                if (FCB->Recv.Content > InfoReq->Information.Ulong)
+                                    FCB->Recv.Content = InfoReq->Information.Ulong;
+
+                                if (FCB->Recv.Window)
+                                {
+                                    RtlCopyMemory(NewBuffer,
+                                                  FCB->Recv.Window,
+                                                  FCB->Recv.Content);
+
+                                    ExFreePoolWithTag(FCB->Recv.Window, TAG_AFD_DATA_BUFFER);
+                                }
+                            }
 
                             FCB->Recv.Size = InfoReq->Information.Ulong;
                             FCB->Recv.Window = NewBuffer;
@@ -166,13 +211,23 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 }
                 else
                 {
+                    /* Like on Windows, our own window can't change before connecting,
+                     * the transport still gets the size once there is a connection */
+                    if (FCB->State == SOCKET_STATE_CONNECTING)
+                        SetTransportBufferSize(FCB, TCP_SOCKET_RCVBUF, FCB->Recv.TransportSize);
+
                     Status = STATUS_INVALID_PARAMETER;
                 }
                 break;
             case AFD_INFO_SEND_WINDOW_SIZE:
+                if (InfoReq->Information.Ulong > 0)
+                    FCB->Send.TransportSize = InfoReq->Information.Ulong;
+
                 if (FCB->State == SOCKET_STATE_CONNECTED ||
                     FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS)
                 {
+                    SetTransportBufferSize(FCB, TCP_SOCKET_SNDBUF, InfoReq->Information.Ulong);
+
                     if (InfoReq->Information.Ulong > 0 && InfoReq->Information.Ulong < 0xFFFF &&
                         InfoReq->Information.Ulong != FCB->Send.Size)
                     {
@@ -211,6 +266,9 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 }
                 else
                 {
+                    if (FCB->State == SOCKET_STATE_CONNECTING)
+                        SetTransportBufferSize(FCB, TCP_SOCKET_SNDBUF, FCB->Send.TransportSize);
+
                     Status = STATUS_INVALID_PARAMETER;
                 }
                 break;
@@ -12,6 +12,7 @@
 
 static NTSTATUS SatisfyAccept( PAFD_DEVICE_EXTENSION DeviceExt,
                                PIRP Irp,
+                               PAFD_FCB ListenFCB,
                                PFILE_OBJECT NewFileObject,
                                PAFD_TDI_OBJECT_QELT Qelt ) {
     PAFD_FCB FCB = NewFileObject->FsContext;
@@ -27,6 +28,13 @@ static NTSTATUS SatisfyAccept( PAFD_DEVICE_EXTENSION DeviceExt,
 
     FCB->Connection = Qelt->Object;
 
+    /* The accepted socket inherits the buffer sizes of the listening one */
+    if (!FCB->Recv.TransportSize)
+        FCB->Recv.TransportSize = ListenFCB->Recv.TransportSize;
+    if (!FCB->Send.TransportSize)
+        FCB->Send.TransportSize = ListenFCB->Send.TransportSize;
+    ApplyTransportBufferSizes( FCB );
+
     if (FCB->RemoteAddress)
     {
         ExFreePoolWithTag(FCB->RemoteAddress, TAG_AFD_TRANSPORT_ADDRESS);
@@ -379,7 +387,7 @@ NTSTATUS AfdAccept( PDEVICE_OBJECT DeviceObject, PIRP Irp,
             ASSERT(NewFileObject->FsContext != FCB);
 
             /* We have a pending connection ... complete this irp right away */
-            Status = SatisfyAccept( DeviceExt, Irp, NewFileObject, PendingConnObj );
+            Status = SatisfyAccept( DeviceExt, Irp, FCB, NewFileObject, PendingConnObj );
 
             ObDereferenceObject( NewFileObject );
 
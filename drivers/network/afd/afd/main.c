@@ -1277,6 +1277,14 @@ AfdCancelHandler(PDEVICE_OBJECT DeviceObject,
             return;
     }
 
+    /* A direct receive is finished by its transport request */
+    if (Function == FUNCTION_RECV && Irp == FCB->RecvDirect.Irp)
+    {
+        IoCancelIrp(FCB->ReceiveIrp.InFlightRequest);
+        SocketStateUnlock(FCB);
+        return;
+    }
+
     CurrentEntry = FCB->PendingIrpList[Function].Flink;
     while (CurrentEntry != &FCB->PendingIrpList[Function])
     {
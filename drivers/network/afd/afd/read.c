@@ -10,33 +10,134 @@
 
 #include "afd.h"
 
+static IO_COMPLETION_ROUTINE DirectReceiveComplete;
+
+/* Recv.Window is a ring for stream sockets.  Recv.BytesUsed is the position
+ * of the first unread byte (always below Recv.Size) and Recv.Content is
+ * BytesUsed plus the number of bytes buffered, so it may run up to twice the
+ * window size.  Content - BytesUsed is the amount of data waiting. */
+
+static VOID CopyFromReceiveRing( PAFD_FCB FCB, UINT Position,
+                                 PCHAR Buffer, UINT Length )
+{
+    UINT Chunk;
+
+    if (Position >= FCB->Recv.Size)
+        Position -= FCB->Recv.Size;
+
+    Chunk = MIN(Length, FCB->Recv.Size - Position);
+
+    RtlCopyMemory(Buffer, FCB->Recv.Window + Position, Chunk);
+    RtlCopyMemory(Buffer + Chunk, FCB->Recv.Window, Length - Chunk);
+}
+
+VOID LinearizeReceiveRing( PAFD_FCB FCB, PCHAR NewWindow, UINT NewSize )
+{
+    UINT BytesAvailable = MIN(FCB->Recv.Content - FCB->Recv.BytesUsed, NewSize);
+
+    CopyFromReceiveRing(FCB, FCB->Recv.BytesUsed, NewWindow, BytesAvailable);
+
+    FCB->Recv.BytesUsed = 0;
+    FCB->Recv.Content = BytesAvailable;
+}
+
+static BOOLEAN PostDirectReceive( PAFD_FCB FCB )
+{
+    PIRP NextIrp;
+    PIO_STACK_LOCATION NextIrpSp;
+    PAFD_RECV_INFO RecvReq;
+    PAFD_MAPBUF Map;
+    PVOID Buffer;
+    NTSTATUS Status;
+
+    if (IsListEmpty(&FCB->PendingIrpList[FUNCTION_RECV]))
+        return FALSE;
+
+    NextIrp = CONTAINING_RECORD(FCB->PendingIrpList[FUNCTION_RECV].Flink,
+                                IRP, Tail.Overlay.ListEntry);
+    NextIrpSp = IoGetCurrentIrpStackLocation(NextIrp);
+    RecvReq = GetLockedData(NextIrp, NextIrpSp);
+
+    /* Only worth it when the first buffer can take a whole window */
+    if ((RecvReq->TdiFlags & TDI_RECEIVE_PEEK) ||
+        !RecvReq->BufferArray ||
+        !RecvReq->BufferCount ||
+        RecvReq->BufferArray[0].len < FCB->Recv.Size)
+        return FALSE;
+
+    Map = (PAFD_MAPBUF)(RecvReq->BufferArray + RecvReq->BufferCount);
+    if (!Map[0].Mdl)
+        return FALSE;
+
+    Buffer = MmMapLockedPagesSpecifyCache(Map[0].Mdl, KernelMode, MmCached,
+                                          NULL, FALSE, NormalPagePriority);
+    if (!Buffer)
+        return FALSE;
+
+    AFD_DbgPrint(MID_TRACE,("Receiving directly into %p (%u)\n",
+                            NextIrp, RecvReq->BufferArray[0].len));
+
+    RemoveEntryList(&NextIrp->Tail.Overlay.ListEntry);
+    FCB->RecvDirect.Irp = NextIrp;
+    FCB->RecvDirect.Buffer = Buffer;
+
+    Status = TdiReceive( &FCB->ReceiveIrp.InFlightRequest,
+                         FCB->Connection.Object,
+                         TDI_RECEIVE_NORMAL,
+                         Buffer,
+                         RecvReq->BufferArray[0].len,
+                         DirectReceiveComplete,
+                         FCB );
+
+    if (!NT_SUCCESS(Status))
+    {
+        /* Nothing was sent down, so put the request back */
+        MmUnmapLockedPages(Buffer, Map[0].Mdl);
+        FCB->RecvDirect.Irp = NULL;
+        FCB->RecvDirect.Buffer = NULL;
+        InsertHeadList(&FCB->PendingIrpList[FUNCTION_RECV],
+                       &NextIrp->Tail.Overlay.ListEntry);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 static VOID RefillSocketBuffer( PAFD_FCB FCB )
 {
+    UINT Offset, Length;
+
     /* Make sure nothing's in flight first */
     if (FCB->ReceiveIrp.InFlightRequest) return;
 
     /* Now ensure that receive is still allowed */
     if (FCB->TdiReceiveClosed) return;
 
-    /* Check if the buffer is full */
-    if (FCB->Recv.Content == FCB->Recv.Size)
+    if (FCB->Recv.Content == FCB->Recv.BytesUsed)
     {
-        /* If there are bytes used, we can solve this problem */
-        if (FCB->Recv.BytesUsed != 0)
-        {
-            /* Reposition the unused portion to the beginning of the receive window */
-            RtlMoveMemory(FCB->Recv.Window,
-                          FCB->Recv.Window + FCB->Recv.BytesUsed,
-                          FCB->Recv.Content - FCB->Recv.BytesUsed);
+        /* Nothing is buffered, so start over at the beginning of the window */
+        FCB->Recv.Content = 0;
+        FCB->Recv.BytesUsed = 0;
 
-            FCB->Recv.Content -= FCB->Recv.BytesUsed;
-            FCB->Recv.BytesUsed = 0;
-        }
-        else
-        {
-            /* No space in the buffer to receive */
-            return;
-        }
+        /* A large waiting receive can take the data without staging it */
+        if (PostDirectReceive(FCB)) return;
+    }
+    else if (FCB->Recv.Content - FCB->Recv.BytesUsed == FCB->Recv.Size)
+    {
+        /* No space in the buffer to receive */
+        return;
+    }
+
+    /* Receive into the free space following the buffered data */
+    if (FCB->Recv.Content < FCB->Recv.Size)
+    {
+        Offset = FCB->Recv.Content;
+        Length = FCB->Recv.Size - FCB->Recv.Content;
+    }
+    else
+    {
+        Offset = FCB->Recv.Content - FCB->Recv.Size;
+        Length = FCB->Recv.BytesUsed - Offset;
     }
 
     AFD_DbgPrint(MID_TRACE,("Replenishing buffer\n"));
@@ -44,14 +145,26 @@ static VOID RefillSocketBuffer( PAFD_FCB FCB )
     TdiReceive( &FCB->ReceiveIrp.InFlightRequest,
                 FCB->Connection.Object,
                 TDI_RECEIVE_NORMAL,
-                FCB->Recv.Window + FCB->Recv.Content,
-                FCB->Recv.Size - FCB->Recv.Content,
+                FCB->Recv.Window + Offset,
+                Length,
                 ReceiveComplete,
                 FCB );
 }
 
 static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Information )
 {
+    BOOLEAN Redirected = FCB->RecvDirect.Redirect;
+
+    FCB->RecvDirect.Redirect = FALSE;
+
+    /* The receive was cancelled to let a direct receive take its place */
+    if (Redirected && Status == STATUS_CANCELLED && !FCB->TdiReceiveClosed)
+    {
+        FCB->Recv.Content += Information;
+        RefillSocketBuffer(FCB);
+        return;
+    }
+
     FCB->LastReceiveStatus = Status;
 
     /* We got closed while the receive was in progress */
@@ -63,7 +176,7 @@ static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Info
     else if (Status == STATUS_SUCCESS)
     {
         FCB->Recv.Content += Information;
-        ASSERT(FCB->Recv.Content <= FCB->Recv.Size);
+        ASSERT(FCB->Recv.Content - FCB->Recv.BytesUsed <= FCB->Recv.Size);
 
         /* Check for graceful closure */
         if (Information == 0)
@@ -127,9 +240,9 @@ static NTSTATUS TryToSatisfyRecvRequestFromBuffer( PAFD_FCB FCB,
                                     Map[i].BufferAddress,
                                     BytesToCopy));
 
-            RtlCopyMemory( Map[i].BufferAddress,
-                           FCB->Recv.Window + FcbBytesCopied,
-                           BytesToCopy );
+            CopyFromReceiveRing( FCB, FcbBytesCopied,
+                                 (PCHAR)Map[i].BufferAddress,
+                                 BytesToCopy );
 
             MmUnmapLockedPages( Map[i].BufferAddress, Map[i].Mdl );
 
@@ -142,6 +255,13 @@ static NTSTATUS TryToSatisfyRecvRequestFromBuffer( PAFD_FCB FCB,
         }
     }
 
+    /* Keep the read position inside the window */
+    if (FCB->Recv.BytesUsed >= FCB->Recv.Size)
+    {
+        FCB->Recv.BytesUsed -= FCB->Recv.Size;
+        FCB->Recv.Content -= FCB->Recv.Size;
+    }
+
     /* Issue another receive IRP to keep the buffer well stocked */
     RefillSocketBuffer(FCB);
 
@@ -266,15 +386,35 @@ static NTSTATUS ReceiveActivity( PAFD_FCB FCB, PIRP Irp ) {
     return RetStatus;
 }
 
+static VOID CompleteReceiveRequest( PIRP Irp, NTSTATUS Status, ULONG_PTR Information ) {
+    PIO_STACK_LOCATION IrpSp = IoGetCurrentIrpStackLocation(Irp);
+    PAFD_RECV_INFO RecvReq = GetLockedData(Irp, IrpSp);
+
+    Irp->IoStatus.Status = Status;
+    Irp->IoStatus.Information = Information;
+    UnlockBuffers(RecvReq->BufferArray, RecvReq->BufferCount, FALSE);
+    if( Irp->MdlAddress ) UnlockRequest( Irp, IrpSp );
+    (void)IoSetCancelRoutine(Irp, NULL);
+    IoCompleteRequest( Irp, IO_NETWORK_INCREMENT );
+}
+
+static VOID FlushPendingReceives( PAFD_FCB FCB ) {
+    PLIST_ENTRY NextIrpEntry;
+    PIRP NextIrp;
+
+    /* Cleanup our IRP queue because the FCB is being destroyed */
+    while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_RECV] ) ) {
+        NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_RECV]);
+        NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
+        CompleteReceiveRequest( NextIrp, STATUS_FILE_CLOSED, 0 );
+    }
+}
+
 NTSTATUS NTAPI ReceiveComplete
 ( PDEVICE_OBJECT DeviceObject,
   PIRP Irp,
   PVOID Context ) {
     PAFD_FCB FCB = (PAFD_FCB)Context;
-    PLIST_ENTRY NextIrpEntry;
-    PIRP NextIrp;
-    PAFD_RECV_INFO RecvReq;
-    PIO_STACK_LOCATION NextIrpSp;
 
     UNREFERENCED_PARAMETER(DeviceObject);
 
@@ -287,19 +427,7 @@ NTSTATUS NTAPI ReceiveComplete
     FCB->ReceiveIrp.InFlightRequest = NULL;
 
     if( FCB->State == SOCKET_STATE_CLOSED ) {
-        /* Cleanup our IRP queue because the FCB is being destroyed */
-        while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_RECV] ) ) {
-            NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_RECV]);
-            NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
-            NextIrpSp = IoGetCurrentIrpStackLocation(NextIrp);
-            RecvReq = GetLockedData(NextIrp, NextIrpSp);
-            NextIrp->IoStatus.Status = STATUS_FILE_CLOSED;
-            NextIrp->IoStatus.Information = 0;
-            UnlockBuffers(RecvReq->BufferArray, RecvReq->BufferCount, FALSE);
-            if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, IoGetCurrentIrpStackLocation( NextIrp ) );
-            (void)IoSetCancelRoutine(NextIrp, NULL);
-            IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
-        }
+        FlushPendingReceives( FCB );
         SocketStateUnlock( FCB );
         return STATUS_FILE_CLOSED;
     } else if( FCB->State == SOCKET_STATE_LISTENING ) {
@@ -317,6 +445,70 @@ NTSTATUS NTAPI ReceiveComplete
     return STATUS_SUCCESS;
 }
 
+static NTSTATUS NTAPI
+DirectReceiveComplete
+( PDEVICE_OBJECT DeviceObject,
+  PIRP Irp,
+  PVOID Context ) {
+    PAFD_FCB FCB = (PAFD_FCB)Context;
+    PIRP NextIrp;
+    PAFD_RECV_INFO RecvReq;
+    PAFD_MAPBUF Map;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    AFD_DbgPrint(MID_TRACE,("Called\n"));
+
+    if( !SocketAcquireStateLock( FCB ) )
+        return STATUS_FILE_CLOSED;
+
+    ASSERT(FCB->ReceiveIrp.InFlightRequest == Irp);
+    FCB->ReceiveIrp.InFlightRequest = NULL;
+
+    NextIrp = FCB->RecvDirect.Irp;
+    RecvReq = GetLockedData(NextIrp, IoGetCurrentIrpStackLocation(NextIrp));
+    Map = (PAFD_MAPBUF)(RecvReq->BufferArray + RecvReq->BufferCount);
+
+    MmUnmapLockedPages(FCB->RecvDirect.Buffer, Map[0].Mdl);
+    FCB->RecvDirect.Irp = NULL;
+    FCB->RecvDirect.Buffer = NULL;
+
+    if( FCB->State == SOCKET_STATE_CLOSED ) {
+        CompleteReceiveRequest( NextIrp, STATUS_FILE_CLOSED, 0 );
+        FlushPendingReceives( FCB );
+        SocketStateUnlock( FCB );
+        return STATUS_FILE_CLOSED;
+    }
+
+    if (Irp->IoStatus.Status == STATUS_SUCCESS && Irp->IoStatus.Information != 0)
+    {
+        /* The data landed in the caller's buffer */
+        FCB->LastReceiveStatus = STATUS_SUCCESS;
+        CompleteReceiveRequest( NextIrp, STATUS_SUCCESS, Irp->IoStatus.Information );
+        RefillSocketBuffer( FCB );
+    }
+    else if (Irp->IoStatus.Status == STATUS_CANCELLED && !FCB->TdiReceiveClosed)
+    {
+        /* The caller cancelled the receive */
+        CompleteReceiveRequest( NextIrp, STATUS_CANCELLED, 0 );
+        RefillSocketBuffer( FCB );
+    }
+    else
+    {
+        /* Closure or failure; requeue the request and let it be handled
+         * like any other receive that was waiting for data */
+        InsertHeadList(&FCB->PendingIrpList[FUNCTION_RECV],
+                       &NextIrp->Tail.Overlay.ListEntry);
+        HandleReceiveComplete( FCB, Irp->IoStatus.Status, 0 );
+    }
+
+    ReceiveActivity( FCB, NULL );
+
+    SocketStateUnlock( FCB );
+
+    return STATUS_SUCCESS;
+}
+
 static NTSTATUS NTAPI
 SatisfyPacketRecvRequest( PAFD_FCB FCB, PIRP Irp,
                          PAFD_STORED_DATAGRAM DatagramRecv,
@@ -532,6 +724,21 @@ AfdConnectedSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         AFD_DbgPrint(MID_TRACE,("Leaving read irp\n"));
         IoMarkIrpPending( Irp );
         (void)IoSetCancelRoutine(Irp, AfdCancelHandler);
+
+        /* If this is a large receive at the head of the queue and nothing
+         * is buffered, pull back the window receive so the data can be
+         * placed straight into the caller's buffer instead */
+        if( FCB->ReceiveIrp.InFlightRequest &&
+            !FCB->RecvDirect.Irp &&
+            !FCB->RecvDirect.Redirect &&
+            FCB->Recv.Content == FCB->Recv.BytesUsed &&
+            FCB->PendingIrpList[FUNCTION_RECV].Flink == &Irp->Tail.Overlay.ListEntry &&
+            !(RecvReq->TdiFlags & TDI_RECEIVE_PEEK) &&
+            RecvReq->BufferCount &&
+            RecvReq->BufferArray[0].len >= FCB->Recv.Size ) {
+            FCB->RecvDirect.Redirect = TRUE;
+            IoCancelIrp( FCB->ReceiveIrp.InFlightRequest );
+        }
     } else {
         AFD_DbgPrint(MID_TRACE,("Completed with status %x\n", Status));
     }
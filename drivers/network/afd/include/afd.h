@@ -51,6 +51,7 @@
 #define TAG_AFD_STORED_DATAGRAM            'gsfA'
 #define TAG_AFD_SNMP_ADDRESS_INFO          'asfA'
 #define TAG_AFD_TDI_CONNECTION_INFORMATION 'cTfA'
+#define TAG_AFD_TDI_SET_INFO               'sTfA'
 #define TAG_AFD_WSA_BUFFER                 'bWfA'
 
 typedef struct IPADDR_ENTRY {
@@ -149,8 +150,15 @@ typedef struct _AFD_IN_FLIGHT_REQUEST {
 typedef struct _AFD_DATA_WINDOW {
     PCHAR Window;
     UINT BytesUsed, Size, Content;
+    UINT TransportSize; /* SO_RCVBUF/SO_SNDBUF for the transport, 0 if never set */
 } AFD_DATA_WINDOW, *PAFD_DATA_WINDOW;
 
+typedef struct _AFD_DIRECT_RECEIVE {
+    PIRP Irp;           /* Receive whose buffer the transport is filling */
+    PVOID Buffer;       /* System mapping of that buffer */
+    BOOLEAN Redirect;   /* Window receive is being cancelled for a direct one */
+} AFD_DIRECT_RECEIVE, *PAFD_DIRECT_RECEIVE;
+
 typedef struct _AFD_STORED_DATAGRAM {
     LIST_ENTRY ListEntry;
     UINT Len;
@@ -176,6 +184,7 @@ typedef struct _AFD_FCB {
     AFD_TDI_OBJECT AddressFile, Connection;
     AFD_IN_FLIGHT_REQUEST ConnectIrp, ListenIrp, ReceiveIrp, SendIrp, DisconnectIrp;
     AFD_DATA_WINDOW Send, Recv;
+    AFD_DIRECT_RECEIVE RecvDirect;
     KMUTEX Mutex;
     PKEVENT EventSelect;
     DWORD EventSelectTriggers;
@@ -266,6 +275,8 @@ NTSTATUS NTAPI
 AfdGetPeerName( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 PIO_STACK_LOCATION IrpSp );
 
+VOID ApplyTransportBufferSizes( PAFD_FCB FCB );
+
 /* listen.c */
 NTSTATUS AfdWaitForListen( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 			   PIO_STACK_LOCATION IrpSp );
@@ -311,6 +322,8 @@ IO_COMPLETION_ROUTINE ReceiveComplete;
 
 IO_COMPLETION_ROUTINE PacketSocketRecvComplete;
 
+VOID LinearizeReceiveRing( PAFD_FCB FCB, PCHAR NewWindow, UINT NewSize );
+
 NTSTATUS NTAPI
 AfdConnectedSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp, PIO_STACK_LOCATION IrpSp, BOOLEAN Short);
 NTSTATUS NTAPI
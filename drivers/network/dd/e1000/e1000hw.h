@@ -96,11 +96,69 @@ typedef struct _E1000_TRANSMIT_DESCRIPTOR
 
 } E1000_TRANSMIT_DESCRIPTOR, *PE1000_TRANSMIT_DESCRIPTOR;
 
+
+/* 3.3.6 TCP/IP Context Transmit Descriptor Format */
+
+#define E1000_TCTX_CMD_IDE              (1 << 7)    /* Interrupt Delay Enable */
+#define E1000_TCTX_CMD_DEXT             (1 << 5)    /* Descriptor Extension */
+#define E1000_TCTX_CMD_RS               (1 << 3)    /* Report Status */
+#define E1000_TCTX_CMD_TSE              (1 << 2)    /* TCP Segmentation Enable */
+#define E1000_TCTX_CMD_IP               (1 << 1)    /* IPv4 packet type */
+#define E1000_TCTX_CMD_TCP              (1 << 0)    /* TCP packet type */
+
+typedef struct _E1000_CONTEXT_DESCRIPTOR
+{
+    UCHAR IpChecksumStart;
+    UCHAR IpChecksumOffset;
+    USHORT IpChecksumEnd;
+    UCHAR TuChecksumStart;
+    UCHAR TuChecksumOffset;
+    USHORT TuChecksumEnd;
+
+    USHORT PayloadLength;
+    UCHAR PayloadLengthHighAndType;
+    UCHAR Command;
+    UCHAR Status;
+    UCHAR HeaderLength;
+    USHORT MaximumSegmentSize;
+
+} E1000_CONTEXT_DESCRIPTOR, *PE1000_CONTEXT_DESCRIPTOR;
+
+
+/* 3.3.7 TCP/IP Data Transmit Descriptor Format */
+
+#define E1000_TDATA_TYPE                (1 << 4)    /* Descriptor type, in LengthHighAndType */
+
+#define E1000_TDATA_CMD_IDE             (1 << 7)    /* Interrupt Delay Enable */
+#define E1000_TDATA_CMD_DEXT            (1 << 5)    /* Descriptor Extension */
+#define E1000_TDATA_CMD_RS              (1 << 3)    /* Report Status */
+#define E1000_TDATA_CMD_TSE             (1 << 2)    /* TCP Segmentation Enable */
+#define E1000_TDATA_CMD_IFCS            (1 << 1)    /* Insert FCS */
+#define E1000_TDATA_CMD_EOP             (1 << 0)    /* End Of Packet */
+
+#define E1000_TDATA_POPTS_TXSM          (1 << 1)    /* Insert TCP/UDP Checksum */
+#define E1000_TDATA_POPTS_IXSM          (1 << 0)    /* Insert IP Checksum */
+
+typedef struct _E1000_DATA_DESCRIPTOR
+{
+    UINT64 Address;
+
+    USHORT Length;
+    UCHAR LengthHighAndType;
+    UCHAR Command;
+    UCHAR Status;
+    UCHAR Options;
+    USHORT Special;
+
+} E1000_DATA_DESCRIPTOR, *PE1000_DATA_DESCRIPTOR;
+
 #include <poppack.h>
 
 
 C_ASSERT(sizeof(E1000_RECEIVE_DESCRIPTOR) == 16);
 C_ASSERT(sizeof(E1000_TRANSMIT_DESCRIPTOR) == 16);
+C_ASSERT(sizeof(E1000_CONTEXT_DESCRIPTOR) == 16);
+C_ASSERT(sizeof(E1000_DATA_DESCRIPTOR) == 16);
 
 
 /* Valid Range: 80-256 for 82542 and 82543 gigabit ethernet controllers
@@ -191,6 +249,7 @@ C_ASSERT(sizeof(E1000_TRANSMIT_DESCRIPTOR) == 16);
 /* E1000_REG_ITR */
 #define MAX_INTS_PER_SEC        2000
 #define DEFAULT_ITR             1000000000/(MAX_INTS_PER_SEC * 256)
+#define E1000_ITR_INTERVAL(IntsPerSec)  (1000000000 / ((IntsPerSec) * 256))
 
 
 /* E1000_REG_RCTL */
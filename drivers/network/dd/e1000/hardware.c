@@ -415,6 +415,55 @@ NICAllocateIoResources(
         Descriptor->Address = Adapter->ReceiveBufferPa.QuadPart + n * Adapter->ReceiveBufferEntrySize;
     }
 
+    /* Every receive buffer gets a packet describing it, so frames go up straight from DMA memory */
+    NdisAllocatePacketPool(&Status,
+                           &Adapter->ReceivePacketPool,
+                           NUM_RECEIVE_DESCRIPTORS,
+                           PROTOCOL_RESERVED_SIZE_IN_PACKET);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet pool\n"));
+        return NDIS_STATUS_RESOURCES;
+    }
+
+    NdisAllocateBufferPool(&Status, &Adapter->ReceiveBufferPool, NUM_RECEIVE_DESCRIPTORS);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive buffer pool\n"));
+        return NDIS_STATUS_RESOURCES;
+    }
+
+    for (n = 0; n < NUM_RECEIVE_DESCRIPTORS; ++n)
+    {
+        PNDIS_PACKET Packet;
+        PNDIS_BUFFER Buffer;
+
+        NdisAllocatePacket(&Status, &Packet, Adapter->ReceivePacketPool);
+        if (Status != NDIS_STATUS_SUCCESS)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet\n"));
+            return NDIS_STATUS_RESOURCES;
+        }
+
+        NdisAllocateBuffer(&Status,
+                           &Buffer,
+                           Adapter->ReceiveBufferPool,
+                           Adapter->ReceiveBuffer + n * Adapter->ReceiveBufferEntrySize,
+                           Adapter->ReceiveBufferEntrySize);
+        if (Status != NDIS_STATUS_SUCCESS)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive buffer\n"));
+            NdisFreePacket(Packet);
+            return NDIS_STATUS_RESOURCES;
+        }
+
+        NdisChainBufferAtFront(Packet, Buffer);
+        NDIS_SET_PACKET_HEADER_SIZE(Packet, sizeof(ETH_HEADER));
+        RECEIVE_PACKET_INDEX(Packet) = n;
+
+        Adapter->ReceivePackets[n] = Packet;
+    }
+
     return NDIS_STATUS_SUCCESS;
 }
 
@@ -464,8 +513,40 @@ NTAPI
 NICReleaseIoResources(
     IN PE1000_ADAPTER Adapter)
 {
+    UINT n;
+
     NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
+    for (n = 0; n < NUM_RECEIVE_DESCRIPTORS; ++n)
+    {
+        PNDIS_PACKET Packet = Adapter->ReceivePackets[n];
+        PNDIS_BUFFER Buffer;
+
+        if (Packet == NULL)
+            continue;
+
+        ASSERT(!Adapter->ReceivePending[n]);
+
+        NdisUnchainBufferAtFront(Packet, &Buffer);
+        if (Buffer != NULL)
+            NdisFreeBuffer(Buffer);
+
+        NdisFreePacket(Packet);
+        Adapter->ReceivePackets[n] = NULL;
+    }
+
+    if (Adapter->ReceiveBufferPool != NULL)
+    {
+        NdisFreeBufferPool(Adapter->ReceiveBufferPool);
+        Adapter->ReceiveBufferPool = NULL;
+    }
+
+    if (Adapter->ReceivePacketPool != NULL)
+    {
+        NdisFreePacketPool(Adapter->ReceivePacketPool);
+        Adapter->ReceivePacketPool = NULL;
+    }
+
     if (Adapter->ReceiveDescriptors != NULL)
     {
         /* Disassociate our shared buffer before freeing it to avoid NIC-induced memory corruption */
@@ -624,6 +705,9 @@ NICEnableTxRx(
     E1000WriteUlong(Adapter, E1000_REG_TDH, 0);
     E1000WriteUlong(Adapter, E1000_REG_TDT, 0);
     Adapter->CurrentTxDesc = 0;
+    Adapter->LastTxDesc = 0;
+    Adapter->TxContextStart = 0;
+    Adapter->TxContextOffset = 0;
 
     /* Set up interrupt timers */
     E1000WriteUlong(Adapter, E1000_REG_TADV, 96); // value is in 1.024 of usec
@@ -648,11 +732,17 @@ NICEnableTxRx(
     /* Receive descriptor tail / head */
     E1000WriteUlong(Adapter, E1000_REG_RDH, 0);
     E1000WriteUlong(Adapter, E1000_REG_RDT, NUM_RECEIVE_DESCRIPTORS - 1);
+    Adapter->CurrentRxDesc = 0;
+    Adapter->ReceiveTail = NUM_RECEIVE_DESCRIPTORS - 1;
 
     /* Set up interrupt timers */
     E1000WriteUlong(Adapter, E1000_REG_RADV, 96);
     E1000WriteUlong(Adapter, E1000_REG_RDTR, 16);
 
+    /* Start out in between, NICUpdateInterruptRate adapts it to the load */
+    Adapter->InterruptRate = LOW_LATENCY_INTS_PER_SEC;
+    E1000WriteUlong(Adapter, E1000_REG_ITR, E1000_ITR_INTERVAL(Adapter->InterruptRate));
+
     /* Some defaults */
     Value = E1000_RCTL_SECRC | E1000_RCTL_EN;
 
@@ -824,31 +914,139 @@ NDIS_STATUS
 NTAPI
 NICTransmitPacket(
     IN PE1000_ADAPTER Adapter,
-    IN PHYSICAL_ADDRESS PhysicalAddress,
-    IN ULONG Length)
+    IN PNDIS_PACKET Packet,
+    IN PSCATTER_GATHER_LIST ScatterGatherList,
+    IN ULONG ChecksumStart,
+    IN ULONG ChecksumOffset)
 {
-    volatile PE1000_TRANSMIT_DESCRIPTOR TransmitDescriptor;
+    volatile PE1000_CONTEXT_DESCRIPTOR ContextDescriptor;
+    volatile PE1000_DATA_DESCRIPTOR DataDescriptor;
+    BOOLEAN NeedContext;
+    ULONG n;
 
     NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
-    TransmitDescriptor = Adapter->TransmitDescriptors + Adapter->CurrentTxDesc;
-    TransmitDescriptor->Address = PhysicalAddress.QuadPart;
-    TransmitDescriptor->Length = Length;
-    TransmitDescriptor->ChecksumOffset = 0;
-    TransmitDescriptor->Command = E1000_TDESC_CMD_RS | E1000_TDESC_CMD_IFCS | E1000_TDESC_CMD_EOP | E1000_TDESC_CMD_IDE;
-    TransmitDescriptor->Status = 0;
-    TransmitDescriptor->ChecksumStartField = 0;
-    TransmitDescriptor->Special = 0;
+    /* The checksum fields live in a context descriptor, only queue one when they change */
+    NeedContext = ChecksumOffset != 0 &&
+                  (ChecksumStart != Adapter->TxContextStart || ChecksumOffset != Adapter->TxContextOffset);
 
-    Adapter->CurrentTxDesc = (Adapter->CurrentTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
+    if (ScatterGatherList->NumberOfElements + (NeedContext ? 1 : 0) > NICTransmitDescriptorsFree(Adapter))
+    {
+        NDIS_DbgPrint(MID_TRACE, ("Not enough TX descriptors for %lu fragments\n", ScatterGatherList->NumberOfElements));
+        return NDIS_STATUS_RESOURCES;
+    }
 
-    E1000WriteUlong(Adapter, E1000_REG_TDT, Adapter->CurrentTxDesc);
+    if (NeedContext)
+    {
+        ContextDescriptor = (PE1000_CONTEXT_DESCRIPTOR)(Adapter->TransmitDescriptors + Adapter->CurrentTxDesc);
+        RtlZeroMemory((PVOID)ContextDescriptor, sizeof(*ContextDescriptor));
+        ContextDescriptor->TuChecksumStart = (UCHAR)ChecksumStart;
+        ContextDescriptor->TuChecksumOffset = (UCHAR)ChecksumOffset;
+        ContextDescriptor->TuChecksumEnd = 0; /* Up to the end of the frame */
+        ContextDescriptor->Command = E1000_TCTX_CMD_DEXT | E1000_TCTX_CMD_RS | E1000_TCTX_CMD_IP;
+
+        Adapter->TxContextStart = ChecksumStart;
+        Adapter->TxContextOffset = ChecksumOffset;
+        Adapter->CurrentTxDesc = (Adapter->CurrentTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
+    }
 
-    if (Adapter->CurrentTxDesc == Adapter->LastTxDesc)
+    for (n = 0; n < ScatterGatherList->NumberOfElements; ++n)
     {
-        NDIS_DbgPrint(MID_TRACE, ("All TX descriptors are full now\n"));
-        Adapter->TxFull = TRUE;
+        DataDescriptor = (PE1000_DATA_DESCRIPTOR)(Adapter->TransmitDescriptors + Adapter->CurrentTxDesc);
+        DataDescriptor->Address = ScatterGatherList->Elements[n].Address.QuadPart;
+        DataDescriptor->Length = (USHORT)ScatterGatherList->Elements[n].Length;
+        DataDescriptor->LengthHighAndType = E1000_TDATA_TYPE;
+        DataDescriptor->Command = E1000_TDATA_CMD_DEXT | E1000_TDATA_CMD_RS | E1000_TDATA_CMD_IFCS | E1000_TDATA_CMD_IDE;
+        DataDescriptor->Status = 0;
+        /* The options are taken from the first descriptor of the frame */
+        DataDescriptor->Options = (n == 0 && ChecksumOffset != 0) ? E1000_TDATA_POPTS_TXSM : 0;
+        DataDescriptor->Special = 0;
+
+        if (n == ScatterGatherList->NumberOfElements - 1)
+        {
+            DataDescriptor->Command |= E1000_TDATA_CMD_EOP;
+
+            /* Completed once the last descriptor of the frame is done */
+            Adapter->TransmitPackets[Adapter->CurrentTxDesc] = Packet;
+        }
+
+        Adapter->CurrentTxDesc = (Adapter->CurrentTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
     }
 
     return NDIS_STATUS_SUCCESS;
 }
+
+VOID
+NTAPI
+NICStartTransmit(
+    IN PE1000_ADAPTER Adapter)
+{
+    NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
+
+    /* One doorbell for everything queued by NICTransmitPacket since the last call */
+    E1000WriteUlong(Adapter, E1000_REG_TDT, Adapter->CurrentTxDesc);
+}
+
+VOID
+NTAPI
+NICReturnReceiveDescriptors(
+    IN PE1000_ADAPTER Adapter)
+{
+    ULONG Tail, Next;
+
+    NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
+
+    NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+
+    /*
+     * RDT is a single pointer, so descriptors go back to the NIC in ring order.
+     * A packet still held by a protocol stops the walk until it is returned.
+     */
+    Tail = Adapter->ReceiveTail;
+    Next = (Tail + 1) % NUM_RECEIVE_DESCRIPTORS;
+    while (Next != Adapter->CurrentRxDesc && !Adapter->ReceivePending[Next])
+    {
+        Tail = Next;
+        Next = (Tail + 1) % NUM_RECEIVE_DESCRIPTORS;
+    }
+
+    if (Tail != Adapter->ReceiveTail)
+    {
+        Adapter->ReceiveTail = Tail;
+        E1000WriteUlong(Adapter, E1000_REG_RDT, Tail);
+    }
+
+    NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
+}
+
+VOID
+NTAPI
+NICUpdateInterruptRate(
+    IN PE1000_ADAPTER Adapter,
+    IN ULONG Packets,
+    IN ULONG Bytes)
+{
+    ULONG Target, Rate;
+
+    if (Packets == 0)
+        return;
+
+    /* Few small frames want latency, full frames or deep batches want fewer interrupts */
+    if (Packets > 32 || Bytes / Packets > 1200)
+        Target = BULK_LATENCY_INTS_PER_SEC;
+    else if (Packets <= 2 && Bytes < 512)
+        Target = LOWEST_LATENCY_INTS_PER_SEC;
+    else
+        Target = LOW_LATENCY_INTS_PER_SEC;
+
+    /* Move a quarter of the way each time so a single odd interrupt does not swing it */
+    Rate = (3 * Adapter->InterruptRate + Target) / 4;
+
+    /* Only touch the register on a noticeable change */
+    if (Rate * 8 < Adapter->InterruptRate * 7 || Rate * 8 > Adapter->InterruptRate * 9)
+    {
+        NDIS_DbgPrint(MID_TRACE, ("Interrupt rate %lu -> %lu\n", Adapter->InterruptRate, Rate));
+        Adapter->InterruptRate = Rate;
+        E1000WriteUlong(Adapter, E1000_REG_ITR, E1000_ITR_INTERVAL(Rate));
+    }
+}
@@ -37,6 +37,7 @@ static ULONG SupportedOidList[] =
     OID_802_3_PERMANENT_ADDRESS,
     OID_802_3_CURRENT_ADDRESS,
     OID_802_3_MAXIMUM_LIST_SIZE,
+    OID_TCP_TASK_OFFLOAD,
     /* Statistics */
     OID_GEN_XMIT_OK,
     OID_GEN_RCV_OK,
@@ -45,6 +46,52 @@ static ULONG SupportedOidList[] =
     OID_GEN_RCV_NO_BUFFER,
 };
 
+#define TASK_OFFLOAD_LENGTH \
+    (sizeof(NDIS_TASK_OFFLOAD_HEADER) + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(NDIS_TASK_TCP_IP_CHECKSUM))
+
+static
+BOOLEAN
+IsEthernetTaskOffload(
+    IN PVOID InformationBuffer,
+    IN ULONG InformationBufferLength)
+{
+    PNDIS_TASK_OFFLOAD_HEADER OffloadHeader = InformationBuffer;
+
+    if (InformationBufferLength < sizeof(NDIS_TASK_OFFLOAD_HEADER))
+        return FALSE;
+
+    return OffloadHeader->Version == NDIS_TASK_OFFLOAD_VERSION &&
+           OffloadHeader->EncapsulationFormat.Encapsulation == IEEE_802_3_Encapsulation;
+}
+
+static
+VOID
+FillTaskOffload(
+    OUT PUCHAR Buffer,
+    IN PNDIS_TASK_OFFLOAD_HEADER RequestHeader)
+{
+    PNDIS_TASK_OFFLOAD_HEADER OffloadHeader = (PNDIS_TASK_OFFLOAD_HEADER)Buffer;
+    PNDIS_TASK_OFFLOAD Task;
+    PNDIS_TASK_TCP_IP_CHECKSUM Checksum;
+
+    NdisZeroMemory(Buffer, TASK_OFFLOAD_LENGTH);
+    *OffloadHeader = *RequestHeader;
+    OffloadHeader->OffsetFirstTask = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+
+    Task = (PNDIS_TASK_OFFLOAD)(Buffer + OffloadHeader->OffsetFirstTask);
+    Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+    Task->Task = TcpIpChecksumNdisTask;
+    Task->OffsetNextTask = 0;
+    Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+
+    /* The legacy descriptor inserts one checksum per frame, so no IP header checksum */
+    Checksum = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+    Checksum->V4Transmit.IpOptionsSupported = 1;
+    Checksum->V4Transmit.TcpOptionsSupported = 1;
+    Checksum->V4Transmit.TcpChecksum = 1;
+    Checksum->V4Transmit.UdpChecksum = 1;
+}
 
 NDIS_STATUS
 NTAPI
@@ -60,6 +107,7 @@ MiniportQueryInformation(
     ULONG genericUlong;
     ULONG copyLength;
     PVOID copySource;
+    UCHAR taskOffload[TASK_OFFLOAD_LENGTH];
     NDIS_STATUS status;
 
     status = NDIS_STATUS_SUCCESS;
@@ -149,7 +197,7 @@ MiniportQueryInformation(
         break;
 
     case OID_GEN_MAXIMUM_SEND_PACKETS:
-        genericUlong = 1;
+        genericUlong = NUM_TRANSMIT_DESCRIPTORS / 2;
         break;
 
     case OID_GEN_MAC_OPTIONS:
@@ -190,6 +238,18 @@ MiniportQueryInformation(
         genericUlong = 0;
         break;
 
+    case OID_TCP_TASK_OFFLOAD:
+        if (!IsEthernetTaskOffload(InformationBuffer, InformationBufferLength))
+        {
+            status = NDIS_STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        FillTaskOffload(taskOffload, InformationBuffer);
+        copySource = taskOffload;
+        copyLength = sizeof(taskOffload);
+        break;
+
     default:
         NDIS_DbgPrint(MIN_TRACE, ("Unknown OID 0x%x(%s)\n", Oid, Oid2Str(Oid)));
         status = NDIS_STATUS_NOT_SUPPORTED;
@@ -324,6 +384,70 @@ MiniportSetInformation(
         NICUpdateMulticastList(Adapter);
         break;
 
+    case OID_TCP_TASK_OFFLOAD:
+    {
+        PNDIS_TASK_OFFLOAD_HEADER offloadHeader = InformationBuffer;
+        PNDIS_TASK_OFFLOAD task;
+        PNDIS_TASK_TCP_IP_CHECKSUM checksum;
+        BOOLEAN tcpChecksum = FALSE, udpChecksum = FALSE;
+        ULONG offset;
+
+        if (!IsEthernetTaskOffload(InformationBuffer, InformationBufferLength))
+        {
+            *BytesRead = 0;
+            *BytesNeeded = 0;
+            status = NDIS_STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        /* An empty task list turns all offloads off */
+        for (offset = offloadHeader->OffsetFirstTask; offset != 0; offset += task->OffsetNextTask)
+        {
+            if (offset + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) > InformationBufferLength)
+            {
+                status = NDIS_STATUS_INVALID_LENGTH;
+                break;
+            }
+
+            task = (PNDIS_TASK_OFFLOAD)((PUCHAR)InformationBuffer + offset);
+            if (task->Task != TcpIpChecksumNdisTask ||
+                task->TaskBufferLength < sizeof(NDIS_TASK_TCP_IP_CHECKSUM) ||
+                offset + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(NDIS_TASK_TCP_IP_CHECKSUM) > InformationBufferLength)
+            {
+                status = NDIS_STATUS_NOT_SUPPORTED;
+                break;
+            }
+
+            checksum = (PNDIS_TASK_TCP_IP_CHECKSUM)task->TaskBuffer;
+            if (checksum->V4Transmit.IpChecksum ||
+                checksum->V4Receive.TcpChecksum || checksum->V4Receive.UdpChecksum ||
+                checksum->V4Receive.IpChecksum ||
+                checksum->V6Transmit.TcpChecksum || checksum->V6Transmit.UdpChecksum ||
+                checksum->V6Receive.TcpChecksum || checksum->V6Receive.UdpChecksum)
+            {
+                status = NDIS_STATUS_NOT_SUPPORTED;
+                break;
+            }
+
+            tcpChecksum = (BOOLEAN)checksum->V4Transmit.TcpChecksum;
+            udpChecksum = (BOOLEAN)checksum->V4Transmit.UdpChecksum;
+
+            if (task->OffsetNextTask == 0)
+                break;
+        }
+
+        if (status != NDIS_STATUS_SUCCESS)
+        {
+            *BytesRead = 0;
+            *BytesNeeded = 0;
+            break;
+        }
+
+        Adapter->TcpChecksumOffload = tcpChecksum;
+        Adapter->UdpChecksumOffload = udpChecksum;
+        break;
+    }
+
     default:
         NDIS_DbgPrint(MIN_TRACE, ("Unknown OID 0x%x(%s)\n", Oid, Oid2Str(Oid)));
         status = NDIS_STATUS_NOT_SUPPORTED;
@@ -43,6 +43,7 @@ MiniportHandleInterrupt(
     ULONG InterruptPending;
     PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
     volatile PE1000_TRANSMIT_DESCRIPTOR TransmitDescriptor;
+    ULONG Packets = 0, RxBytes = 0;
 
     NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
@@ -69,21 +70,21 @@ MiniportHandleInterrupt(
     if (InterruptPending & (E1000_IMS_RXDMT0 | E1000_IMS_RXT0))
     {
         volatile PE1000_RECEIVE_DESCRIPTOR ReceiveDescriptor;
-        PETH_HEADER EthHeader;
-        ULONG BufferOffset;
-        BOOLEAN bGotAny = FALSE;
-        ULONG RxDescHead, RxDescTail, CurrRxDesc;
+        PNDIS_PACKET Packet;
+        ULONG NumPackets = 0, i;
+        ULONG CurrRxDesc, LoanedCount;
 
         /* Clear out these interrupts */
         InterruptPending &= ~(E1000_IMS_RXDMT0 | E1000_IMS_RXT0);
 
-        E1000ReadUlong(Adapter, E1000_REG_RDH, &RxDescHead);
-        E1000ReadUlong(Adapter, E1000_REG_RDT, &RxDescTail);
+        NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+        LoanedCount = Adapter->ReceivePendingCount;
+        NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
+
+        CurrRxDesc = Adapter->CurrentRxDesc;
 
-        while (((RxDescTail + 1) % NUM_RECEIVE_DESCRIPTORS) != RxDescHead)
+        while (TRUE)
         {
-            CurrRxDesc = (RxDescTail + 1) % NUM_RECEIVE_DESCRIPTORS;
-            BufferOffset = CurrRxDesc * Adapter->ReceiveBufferEntrySize;
             ReceiveDescriptor = Adapter->ReceiveDescriptors + CurrRxDesc;
 
             /* Check if the hardware have released this descriptor (DD - Descriptor Done) */
@@ -101,71 +102,106 @@ MiniportHandleInterrupt(
                 NDIS_DbgPrint(MIN_TRACE, ("Unrecognized ReceiveDescriptor status flag: %u\n", ReceiveDescriptor->Status));
             }
 
-            if (ReceiveDescriptor->Length != 0 && ReceiveDescriptor->Address != 0)
+            if (ReceiveDescriptor->Length >= sizeof(ETH_HEADER) && ReceiveDescriptor->Address != 0)
             {
-                EthHeader = (PETH_HEADER)(Adapter->ReceiveBuffer + BufferOffset);
+                Packet = Adapter->ReceivePackets[CurrRxDesc];
+
+                NdisAdjustBufferLength(Packet->Private.Head, ReceiveDescriptor->Length);
+                NdisRecalculatePacketCounts(Packet);
 
-                NdisMEthIndicateReceive(Adapter->AdapterHandle,
-                                        NULL,
-                                        (PCHAR)EthHeader,
-                                        sizeof(ETH_HEADER),
-                                        (PCHAR)(EthHeader + 1),
-                                        ReceiveDescriptor->Length - sizeof(ETH_HEADER),
-                                        ReceiveDescriptor->Length - sizeof(ETH_HEADER));
+                /* Lend the buffer to the protocols unless too many are out already, then they must copy */
+                if (LoanedCount + NumPackets < RECEIVE_LOAN_THRESHOLD)
+                    NDIS_SET_PACKET_STATUS(Packet, NDIS_STATUS_SUCCESS);
+                else
+                    NDIS_SET_PACKET_STATUS(Packet, NDIS_STATUS_RESOURCES);
 
-                bGotAny = TRUE;
+                Adapter->IndicatePackets[NumPackets++] = Packet;
+                RxBytes += ReceiveDescriptor->Length;
             }
             else
             {
                 NDIS_DbgPrint(MIN_TRACE, ("Got a NULL descriptor"));
             }
 
-            /* Give the descriptor back */
+            /* Processed, the descriptor goes back to the NIC in NICReturnReceiveDescriptors */
             ReceiveDescriptor->Status = 0;
 
-            RxDescTail = CurrRxDesc;
+            CurrRxDesc = (CurrRxDesc + 1) % NUM_RECEIVE_DESCRIPTORS;
         }
 
-        if (bGotAny)
+        if (NumPackets)
         {
-            /* Write back new tail value */
-            E1000WriteUlong(Adapter, E1000_REG_RDT, RxDescTail);
+            NDIS_DbgPrint(MAX_TRACE, ("Rx done: %lu packets\n", NumPackets));
 
-            NDIS_DbgPrint(MAX_TRACE, ("Rx done (RDH: %u, RDT: %u)\n", RxDescHead, RxDescTail));
+            /* Lent packets may be returned before the indication is over, so mark them first */
+            NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+            for (i = 0; i < NumPackets; ++i)
+            {
+                Packet = Adapter->IndicatePackets[i];
+                if (NDIS_GET_PACKET_STATUS(Packet) == NDIS_STATUS_SUCCESS)
+                {
+                    Adapter->ReceivePending[RECEIVE_PACKET_INDEX(Packet)] = TRUE;
+                    Adapter->ReceivePendingCount++;
+                }
+            }
+            NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
+
+            /* Hand the whole batch to NDIS at once */
+            NdisMIndicateReceivePacket(Adapter->AdapterHandle, Adapter->IndicatePackets, NumPackets);
+
+            NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+            for (i = 0; i < NumPackets; ++i)
+            {
+                /* NDIS_STATUS_PENDING ones come back through MiniportReturnPacket */
+                Packet = Adapter->IndicatePackets[i];
+                if (NDIS_GET_PACKET_STATUS(Packet) == NDIS_STATUS_SUCCESS)
+                {
+                    Adapter->ReceivePending[RECEIVE_PACKET_INDEX(Packet)] = FALSE;
+                    Adapter->ReceivePendingCount--;
+                }
+            }
+            Adapter->CurrentRxDesc = CurrRxDesc;
+            NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
 
             NdisMEthIndicateReceiveComplete(Adapter->AdapterHandle);
         }
+        else
+        {
+            NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+            Adapter->CurrentRxDesc = CurrRxDesc;
+            NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
+        }
+
+        NICReturnReceiveDescriptors(Adapter);
+
+        Packets += NumPackets;
     }
 
     /* Handling transmit interrupts */
     if (InterruptPending & (E1000_IMS_TXD_LOW | E1000_IMS_TXDW | E1000_IMS_TXQE))
     {
-        PNDIS_PACKET AckPackets[40] = {0};
+        PNDIS_PACKET AckPackets[NUM_TRANSMIT_DESCRIPTORS];
         ULONG NumPackets = 0, i;
 
         /* Clear out these interrupts */
         InterruptPending &= ~(E1000_IMS_TXD_LOW | E1000_IMS_TXDW | E1000_IMS_TXQE);
 
-        while ((Adapter->TxFull || Adapter->LastTxDesc != Adapter->CurrentTxDesc) && NumPackets < ARRAYSIZE(AckPackets))
+        while (Adapter->LastTxDesc != Adapter->CurrentTxDesc)
         {
             TransmitDescriptor = Adapter->TransmitDescriptors + Adapter->LastTxDesc;
 
-            if (TransmitDescriptor->Status & E1000_TDESC_STATUS_DD)
-            {
-                if (Adapter->TransmitPackets[Adapter->LastTxDesc])
-                {
-                    AckPackets[NumPackets++] = Adapter->TransmitPackets[Adapter->LastTxDesc];
-                    Adapter->TransmitPackets[Adapter->LastTxDesc] = NULL;
-                    TransmitDescriptor->Status = 0;
-                }
+            if (!(TransmitDescriptor->Status & E1000_TDESC_STATUS_DD))
+                break;
 
-                Adapter->LastTxDesc = (Adapter->LastTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
-                Adapter->TxFull = FALSE;
-            }
-            else
+            /* Only the last descriptor of a frame carries its packet */
+            if (Adapter->TransmitPackets[Adapter->LastTxDesc])
             {
-                break;
+                AckPackets[NumPackets++] = Adapter->TransmitPackets[Adapter->LastTxDesc];
+                Adapter->TransmitPackets[Adapter->LastTxDesc] = NULL;
             }
+
+            TransmitDescriptor->Status = 0;
+            Adapter->LastTxDesc = (Adapter->LastTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
         }
 
         if (NumPackets)
@@ -178,7 +214,38 @@ MiniportHandleInterrupt(
                 NdisMSendComplete(Adapter->AdapterHandle, AckPackets[i], NDIS_STATUS_SUCCESS);
             }
         }
+
+        /* The reclaimed descriptors go to the packets that were waiting for them */
+        if (Adapter->TransmitBacklogHead)
+            E1000SendBacklog(Adapter);
+
+        Packets += NumPackets;
     }
 
+    NICUpdateInterruptRate(Adapter, Packets, RxBytes);
+
     ASSERT(InterruptPending == 0);
 }
+
+VOID
+NTAPI
+MiniportReturnPacket(
+    IN NDIS_HANDLE MiniportAdapterContext,
+    IN PNDIS_PACKET Packet)
+{
+    PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
+    ULONG Index = RECEIVE_PACKET_INDEX(Packet);
+
+    NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
+
+    ASSERT(Index < NUM_RECEIVE_DESCRIPTORS);
+    ASSERT(Adapter->ReceivePackets[Index] == Packet);
+
+    NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+    ASSERT(Adapter->ReceivePending[Index]);
+    Adapter->ReceivePending[Index] = FALSE;
+    Adapter->ReceivePendingCount--;
+    NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
+
+    NICReturnReceiveDescriptors(Adapter);
+}
@@ -23,42 +23,114 @@ MiniportReset(
     return NDIS_STATUS_FAILURE;
 }
 
-NDIS_STATUS
-NTAPI
-MiniportSend(
-    IN NDIS_HANDLE MiniportAdapterContext,
+static
+VOID
+GetChecksumOffsets(
+    IN PE1000_ADAPTER Adapter,
     IN PNDIS_PACKET Packet,
-    IN UINT Flags)
+    OUT PULONG ChecksumStart,
+    OUT PULONG ChecksumOffset)
 {
-    PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
-    PSCATTER_GATHER_LIST sgList = NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, ScatterGatherListPacketInfo);
-    ULONG TransmitLength;
-    PHYSICAL_ADDRESS TransmitBuffer;
-    NDIS_STATUS Status;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+    PNDIS_BUFFER Buffer;
+    PUCHAR Frame;
+    UINT FirstLength, TotalLength;
+    ULONG HeaderLength;
+
+    *ChecksumStart = 0;
+    *ChecksumOffset = 0;
 
-    ASSERT(sgList != NULL);
-    ASSERT(sgList->NumberOfElements == 1);
-    ASSERT((sgList->Elements[0].Address.LowPart & 3) == 0);
-    ASSERT(sgList->Elements[0].Length <= MAXIMUM_FRAME_SIZE);
+    ChecksumInfo.Value = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpIpChecksumPacketInfo));
+    if (!ChecksumInfo.Transmit.NdisPacketChecksumV4)
+        return;
 
-    if (Adapter->TxFull)
+    if (!(ChecksumInfo.Transmit.NdisPacketTcpChecksum && Adapter->TcpChecksumOffload) &&
+        !(ChecksumInfo.Transmit.NdisPacketUdpChecksum && Adapter->UdpChecksumOffload))
     {
-        NDIS_DbgPrint(MIN_TRACE, ("All TX descriptors are full\n"));
-        return NDIS_STATUS_RESOURCES;
+        return;
     }
 
-    TransmitLength = sgList->Elements[0].Length;
-    TransmitBuffer = sgList->Elements[0].Address;
-    Adapter->TransmitPackets[Adapter->CurrentTxDesc] = Packet;
+    NdisGetFirstBufferFromPacketSafe(Packet, &Buffer, (PVOID*)&Frame, &FirstLength, &TotalLength, NormalPagePriority);
+    if (!Frame || FirstLength < sizeof(ETH_HEADER) + 20)
+        return;
+
+    /* The transport stored the pseudo header sum in the checksum field */
+    HeaderLength = (Frame[sizeof(ETH_HEADER)] & 0x0F) * 4;
+    *ChecksumStart = sizeof(ETH_HEADER) + HeaderLength;
+    if (ChecksumInfo.Transmit.NdisPacketTcpChecksum)
+        *ChecksumOffset = *ChecksumStart + 16;
+    else
+        *ChecksumOffset = *ChecksumStart + 6;
+}
 
-    Status = NICTransmitPacket(Adapter, TransmitBuffer, TransmitLength);
-    if (Status != NDIS_STATUS_SUCCESS)
+VOID
+NTAPI
+E1000SendBacklog(
+    IN PE1000_ADAPTER Adapter)
+{
+    PNDIS_PACKET Packet;
+    PSCATTER_GATHER_LIST sgList;
+    ULONG ChecksumStart, ChecksumOffset;
+    UINT Queued = 0;
+
+    /* Move backlogged packets onto the ring in order, for as long as they fit */
+    while ((Packet = Adapter->TransmitBacklogHead) != NULL)
+    {
+        sgList = NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, ScatterGatherListPacketInfo);
+
+        GetChecksumOffsets(Adapter, Packet, &ChecksumStart, &ChecksumOffset);
+        if (NICTransmitPacket(Adapter, Packet, sgList, ChecksumStart, ChecksumOffset) != NDIS_STATUS_SUCCESS)
+            break;
+
+        Adapter->TransmitBacklogHead = TRANSMIT_PACKET_NEXT(Packet);
+        if (!Adapter->TransmitBacklogHead)
+            Adapter->TransmitBacklogTail = NULL;
+        Queued++;
+    }
+
+    /* One doorbell for the whole batch */
+    if (Queued)
+        NICStartTransmit(Adapter);
+}
+
+VOID
+NTAPI
+MiniportSendPackets(
+    IN NDIS_HANDLE MiniportAdapterContext,
+    IN PPNDIS_PACKET PacketArray,
+    IN UINT NumberOfPackets)
+{
+    PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
+    PSCATTER_GATHER_LIST sgList;
+    UINT i;
+
+    for (i = 0; i < NumberOfPackets; i++)
     {
-        NDIS_DbgPrint(MIN_TRACE, ("Transmit packet failed\n"));
-        return Status;
+        sgList = NDIS_PER_PACKET_INFO_FROM_PACKET(PacketArray[i], ScatterGatherListPacketInfo);
+        ASSERT(sgList != NULL);
+        ASSERT(sgList->NumberOfElements != 0);
+
+        /* A context descriptor plus the fragments have to fit an otherwise empty ring */
+        if (sgList->NumberOfElements + 1 > NUM_TRANSMIT_DESCRIPTORS - 1)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Packet with %lu fragments can never be sent\n", sgList->NumberOfElements));
+            NDIS_SET_PACKET_STATUS(PacketArray[i], NDIS_STATUS_FAILURE);
+            continue;
+        }
+
+        /* NDIS fails packets that a serialized miniport hands back with NDIS_STATUS_RESOURCES,
+         * so whatever doesn't fit the ring now waits in the backlog until descriptors complete */
+        TRANSMIT_PACKET_NEXT(PacketArray[i]) = NULL;
+        if (Adapter->TransmitBacklogTail)
+            TRANSMIT_PACKET_NEXT(Adapter->TransmitBacklogTail) = PacketArray[i];
+        else
+            Adapter->TransmitBacklogHead = PacketArray[i];
+        Adapter->TransmitBacklogTail = PacketArray[i];
+
+        NDIS_SET_PACKET_STATUS(PacketArray[i], NDIS_STATUS_PENDING);
     }
 
-    return NDIS_STATUS_PENDING;
+    E1000SendBacklog(Adapter);
 }
 
 VOID
@@ -67,18 +139,29 @@ MiniportHalt(
     IN NDIS_HANDLE MiniportAdapterContext)
 {
     PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
+    PNDIS_PACKET Packet;
 
     ASSERT(Adapter != NULL);
 
     /* First disable sending / receiving */
     NICDisableTxRx(Adapter);
 
+    /* Nothing will pick up the backlog anymore */
+    while ((Packet = Adapter->TransmitBacklogHead) != NULL)
+    {
+        Adapter->TransmitBacklogHead = TRANSMIT_PACKET_NEXT(Packet);
+        NdisMSendComplete(Adapter->AdapterHandle, Packet, NDIS_STATUS_FAILURE);
+    }
+    Adapter->TransmitBacklogTail = NULL;
+
     /* Then unregister interrupts */
     NICUnregisterInterrupts(Adapter);
 
     /* Finally, free other resources (Ports, IO ranges,...) */
     NICReleaseIoResources(Adapter);
 
+    NdisFreeSpinLock(&Adapter->ReceiveLock);
+
     /* Destroy the adapter context */
     NdisFreeMemory(Adapter, sizeof(*Adapter), 0);
 }
@@ -131,6 +214,7 @@ MiniportInitialize(
 
     RtlZeroMemory(Adapter, sizeof(*Adapter));
     Adapter->AdapterHandle = MiniportAdapterHandle;
+    NdisAllocateSpinLock(&Adapter->ReceiveLock);
 
     /* Notify NDIS of some characteristics of our NIC */
     NdisMSetAttributesEx(MiniportAdapterHandle,
@@ -314,11 +398,11 @@ DriverEntry(
     Characteristics.QueryInformationHandler = MiniportQueryInformation;
     Characteristics.ReconfigureHandler = NULL;
     Characteristics.ResetHandler = MiniportReset;
-    Characteristics.SendHandler = MiniportSend;
+    Characteristics.SendHandler = NULL;
     Characteristics.SetInformationHandler = MiniportSetInformation;
     Characteristics.TransferDataHandler = NULL;
-    Characteristics.ReturnPacketHandler = NULL;
-    Characteristics.SendPacketsHandler = NULL;
+    Characteristics.ReturnPacketHandler = MiniportReturnPacket;
+    Characteristics.SendPacketsHandler = MiniportSendPackets;
     Characteristics.AllocateCompleteHandler = NULL;
 
     NdisMInitializeWrapper(&WrapperHandle, DriverObject, RegistryPath, NULL);
@@ -23,6 +23,20 @@
 
 #define DEFAULT_INTERRUPT_MASK  (E1000_IMS_LSC | E1000_IMS_TXDW | E1000_IMS_TXQE | E1000_IMS_RXDMT0 | E1000_IMS_RXT0 | E1000_IMS_TXD_LOW)
 
+/* Interrupt moderation targets, picked from the traffic seen per interrupt */
+#define LOWEST_LATENCY_INTS_PER_SEC 70000
+#define LOW_LATENCY_INTS_PER_SEC    20000
+#define BULK_LATENCY_INTS_PER_SEC   4000
+
+/* Past this many receive packets held by protocols, indicate with NDIS_STATUS_RESOURCES */
+#define RECEIVE_LOAN_THRESHOLD      (NUM_RECEIVE_DESCRIPTORS / 2)
+
+/* Receive descriptor index of a receive packet */
+#define RECEIVE_PACKET_INDEX(Packet)    (*(PULONG)&(Packet)->MiniportReserved[0])
+
+/* Link of a send packet waiting in the transmit backlog */
+#define TRANSMIT_PACKET_NEXT(Packet)    (*(PNDIS_PACKET*)&(Packet)->MiniportReserved[0])
+
 
 typedef struct _E1000_ADAPTER
 {
@@ -74,7 +88,18 @@ typedef struct _E1000_ADAPTER
 
     ULONG CurrentTxDesc;
     ULONG LastTxDesc;
-    BOOLEAN TxFull;
+
+    /* Packets waiting for free descriptors, in send order (serialized with the DPC by NDIS) */
+    PNDIS_PACKET TransmitBacklogHead;
+    PNDIS_PACKET TransmitBacklogTail;
+
+    /* Checksum fields of the last context descriptor, 0 if none was queued yet */
+    ULONG TxContextStart;
+    ULONG TxContextOffset;
+
+    /* Checksum offload (OID_TCP_TASK_OFFLOAD) */
+    BOOLEAN TcpChecksumOffload;
+    BOOLEAN UdpChecksumOffload;
 
 
     /* Receive */
@@ -86,9 +111,38 @@ typedef struct _E1000_ADAPTER
     NDIS_PHYSICAL_ADDRESS ReceiveBufferPa;
     ULONG ReceiveBufferEntrySize;
 
+    /* One packet per receive descriptor, indicated up without copying */
+    NDIS_HANDLE ReceivePacketPool;
+    NDIS_HANDLE ReceiveBufferPool;
+    PNDIS_PACKET ReceivePackets[NUM_RECEIVE_DESCRIPTORS];
+    PNDIS_PACKET IndicatePackets[NUM_RECEIVE_DESCRIPTORS];
+
+    /* Protects the fields below, MiniportReturnPacket is not serialized with the DPC */
+    NDIS_SPIN_LOCK ReceiveLock;
+    BOOLEAN ReceivePending[NUM_RECEIVE_DESCRIPTORS];
+    ULONG ReceivePendingCount;
+    ULONG CurrentRxDesc;
+    ULONG ReceiveTail;
+
+    /* Interrupt moderation */
+    ULONG InterruptRate;
+
 } E1000_ADAPTER, *PE1000_ADAPTER;
 
 
+FORCEINLINE
+ULONG
+NICTransmitDescriptorsFree(
+    IN PE1000_ADAPTER Adapter)
+{
+    ULONG Used;
+
+    /* TDH == TDT means an empty ring, so one descriptor always stays unused */
+    Used = (Adapter->CurrentTxDesc + NUM_TRANSMIT_DESCRIPTORS - Adapter->LastTxDesc) % NUM_TRANSMIT_DESCRIPTORS;
+    return NUM_TRANSMIT_DESCRIPTORS - 1 - Used;
+}
+
+
 BOOLEAN
 NTAPI
 NICRecognizeHardware(
@@ -181,8 +235,32 @@ NDIS_STATUS
 NTAPI
 NICTransmitPacket(
     IN PE1000_ADAPTER Adapter,
-    IN PHYSICAL_ADDRESS PhysicalAddress,
-    IN ULONG Length);
+    IN PNDIS_PACKET Packet,
+    IN PSCATTER_GATHER_LIST ScatterGatherList,
+    IN ULONG ChecksumStart,
+    IN ULONG ChecksumOffset);
+
+VOID
+NTAPI
+NICStartTransmit(
+    IN PE1000_ADAPTER Adapter);
+
+VOID
+NTAPI
+E1000SendBacklog(
+    IN PE1000_ADAPTER Adapter);
+
+VOID
+NTAPI
+NICReturnReceiveDescriptors(
+    IN PE1000_ADAPTER Adapter);
+
+VOID
+NTAPI
+NICUpdateInterruptRate(
+    IN PE1000_ADAPTER Adapter,
+    IN ULONG Packets,
+    IN ULONG Bytes);
 
 NDIS_STATUS
 NTAPI
@@ -216,6 +294,12 @@ NTAPI
 MiniportHandleInterrupt(
     IN NDIS_HANDLE MiniportAdapterContext);
 
+VOID
+NTAPI
+MiniportReturnPacket(
+    IN NDIS_HANDLE MiniportAdapterContext,
+    IN PNDIS_PACKET Packet);
+
 
 VOID
 NTAPI
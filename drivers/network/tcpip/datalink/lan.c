@@ -1006,6 +1006,10 @@ VOID LANTransmit(
 
     RtlCopyMemory(Data + Adapter->HeaderSize, OldData, OldSize);
 
+    /* Carry over the checksums the IP layer left to the adapter */
+    NDIS_PER_PACKET_INFO_FROM_PACKET(XmitPacket, TcpIpChecksumPacketInfo) =
+        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpIpChecksumPacketInfo);
+
     (*PC(NdisPacket)->DLComplete)(PC(NdisPacket)->Context, NdisPacket, NDIS_STATUS_SUCCESS);
 
     switch (Adapter->Media) {
@@ -1309,6 +1313,114 @@ VOID GetName( PUNICODE_STRING RegistryKey,
     AppendUnicodeString( OutName, &PartialRegistryKey, FALSE );
 }
 
+static VOID NegotiateChecksumOffload(
+    PLAN_ADAPTER Adapter,
+    PIP_INTERFACE IF)
+/*
+ * FUNCTION: Enables transmit checksum offload on a LAN adapter
+ * ARGUMENTS:
+ *     Adapter = Pointer to LAN_ADAPTER structure
+ *     IF      = Pointer to IP interface of the adapter
+ * NOTES:
+ *    IF->ChecksumOffload is left zero if the miniport does not
+ *    support OID_TCP_TASK_OFFLOAD
+ */
+{
+    UCHAR Buffer[256];
+    PNDIS_TASK_OFFLOAD_HEADER OffloadHeader = (PNDIS_TASK_OFFLOAD_HEADER)Buffer;
+    PNDIS_TASK_OFFLOAD Task;
+    PNDIS_TASK_TCP_IP_CHECKSUM Checksum;
+    NDIS_TASK_TCP_IP_CHECKSUM Supported;
+    ULONG Offset, Offload = 0;
+    NDIS_STATUS NdisStatus;
+
+    if (Adapter->Media != NdisMedium802_3)
+        return;
+
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+    OffloadHeader->Version = NDIS_TASK_OFFLOAD_VERSION;
+    OffloadHeader->Size = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    OffloadHeader->EncapsulationFormat.Encapsulation = IEEE_802_3_Encapsulation;
+    OffloadHeader->EncapsulationFormat.Flags.FixedHeaderSize = 1;
+    OffloadHeader->EncapsulationFormat.EncapsulationHeaderSize = sizeof(ETH_HEADER);
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestQueryInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          sizeof(Buffer));
+    if (NdisStatus != NDIS_STATUS_SUCCESS) {
+        TI_DbgPrint(DEBUG_DATALINK, ("No task offload support (0x%X).\n", NdisStatus));
+        return;
+    }
+
+    /* Look for the checksum task in the list the miniport returned */
+    RtlZeroMemory(&Supported, sizeof(Supported));
+    Offset = OffloadHeader->OffsetFirstTask;
+    while (Offset != 0 &&
+           Offset + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(NDIS_TASK_TCP_IP_CHECKSUM) <= sizeof(Buffer))
+    {
+        Task = (PNDIS_TASK_OFFLOAD)(Buffer + Offset);
+
+        if (Task->Task == TcpIpChecksumNdisTask &&
+            Task->TaskBufferLength >= sizeof(NDIS_TASK_TCP_IP_CHECKSUM))
+        {
+            Supported = *(PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+            break;
+        }
+
+        if (Task->OffsetNextTask == 0)
+            break;
+
+        Offset += Task->OffsetNextTask;
+    }
+
+    /* We send TCP options and raw sockets may send IP options */
+    if (Supported.V4Transmit.IpChecksum && Supported.V4Transmit.IpOptionsSupported)
+        Offload |= IP_CHECKSUM_OFFLOAD_IP;
+    if (Supported.V4Transmit.TcpChecksum && Supported.V4Transmit.TcpOptionsSupported)
+        Offload |= IP_CHECKSUM_OFFLOAD_TCP;
+    if (Supported.V4Transmit.UdpChecksum)
+        Offload |= IP_CHECKSUM_OFFLOAD_UDP;
+
+    if (Offload == 0)
+        return;
+
+    /* Enable only the transmit checksums we are going to use */
+    RtlZeroMemory(Buffer + sizeof(NDIS_TASK_OFFLOAD_HEADER),
+                  sizeof(Buffer) - sizeof(NDIS_TASK_OFFLOAD_HEADER));
+    OffloadHeader->OffsetFirstTask = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+
+    Task = (PNDIS_TASK_OFFLOAD)(Buffer + OffloadHeader->OffsetFirstTask);
+    Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+    Task->Task = TcpIpChecksumNdisTask;
+    Task->OffsetNextTask = 0;
+    Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+
+    Checksum = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+    Checksum->V4Transmit.IpOptionsSupported = Supported.V4Transmit.IpOptionsSupported;
+    Checksum->V4Transmit.TcpOptionsSupported = Supported.V4Transmit.TcpOptionsSupported;
+    Checksum->V4Transmit.IpChecksum = !!(Offload & IP_CHECKSUM_OFFLOAD_IP);
+    Checksum->V4Transmit.TcpChecksum = !!(Offload & IP_CHECKSUM_OFFLOAD_TCP);
+    Checksum->V4Transmit.UdpChecksum = !!(Offload & IP_CHECKSUM_OFFLOAD_UDP);
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestSetInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          OffloadHeader->OffsetFirstTask +
+                          FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) +
+                          sizeof(NDIS_TASK_TCP_IP_CHECKSUM));
+    if (NdisStatus != NDIS_STATUS_SUCCESS) {
+        TI_DbgPrint(DEBUG_DATALINK, ("Could not enable checksum offload (0x%X).\n", NdisStatus));
+        return;
+    }
+
+    TI_DbgPrint(DEBUG_DATALINK, ("Checksum offload enabled (0x%X).\n", Offload));
+    IF->ChecksumOffload = Offload;
+}
+
 BOOLEAN BindAdapter(
     PLAN_ADAPTER Adapter,
     PNDIS_STRING RegistryPath)
@@ -1410,6 +1522,9 @@ BOOLEAN BindAdapter(
     if (NdisStatus != NDIS_STATUS_SUCCESS)
         return FALSE;
 
+    /* Let the adapter compute transmit checksums if it can */
+    NegotiateChecksumOffload(Adapter, IF);
+
     /* Register interface with IP layer */
     IPRegisterInterface(IF);
 
@@ -15,6 +15,22 @@ ULONG ChecksumCompute(
     UINT Count,
     ULONG Seed);
 
+ULONG ChecksumCopy(
+    PVOID Destination,
+    PVOID Source,
+    UINT Count,
+    ULONG Seed);
+
+ULONG ChecksumAdd(
+    ULONG Sum,
+    ULONG PartSum,
+    UINT Offset);
+
+ULONG ChecksumPseudoHeaderIPv4(
+    PIPv4_HEADER IPHeader,
+    UCHAR Protocol,
+    USHORT Length);
+
 unsigned int
 csum_partial(
   const unsigned char * buff,
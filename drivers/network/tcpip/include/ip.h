@@ -91,6 +91,7 @@ typedef struct _IP_PACKET {
 } IP_PACKET, *PIP_PACKET;
 
 #define IP_PACKET_FLAG_RAW      0x01    /* Raw IP packet */
+#define IP_PACKET_FLAG_CHECKSUM_OFFLOAD 0x02 /* Transport checksum is left to the adapter */
 
 
 /* Packet context */
@@ -156,6 +157,7 @@ typedef struct _IP_INTERFACE {
     UINT  MinFrameSize;           /* Minimum frame size in bytes */
     UINT  MTU;                    /* Maximum transmission unit */
     UINT  Speed;                  /* Link speed */
+    ULONG ChecksumOffload;        /* Checksums the adapter computes on transmit (see IP_CHECKSUM_OFFLOAD_xx below) */
     IP_ADDRESS Unicast;           /* Unicast address */
     IP_ADDRESS PointToPoint;      /* Point to point address */
     IP_ADDRESS Netmask;           /* Netmask */
@@ -170,6 +172,11 @@ typedef struct _IP_INTERFACE {
     SEND_RECV_STATS Stats;        /* Send/Receive statistics */
 } IP_INTERFACE, *PIP_INTERFACE;
 
+/* IP interface checksum offload flags */
+#define IP_CHECKSUM_OFFLOAD_IP  0x01    /* IPv4 header checksum */
+#define IP_CHECKSUM_OFFLOAD_TCP 0x02    /* TCP checksum over IPv4 */
+#define IP_CHECKSUM_OFFLOAD_UDP 0x04    /* UDP checksum over IPv4 */
+
 typedef struct _IP_SET_ADDRESS {
     ULONG NteIndex;
     IPv4_RAW_ADDRESS Address;
@@ -10,9 +10,25 @@
 #include <neighbor.h>
 
 
+/* Number of destinations remembered by the route cache */
+#define ROUTE_CACHE_SIZE 64
+
+/* Routing trie node. A node stands for one network prefix and holds
+ * the routes to exactly that prefix. Nodes without routes only join
+ * two subtrees */
+typedef struct _FIB_NODE {
+    struct _FIB_NODE *Parent;     /* Pointer to parent node */
+    struct _FIB_NODE *Child[2];   /* Subtrees selected by the bit after the prefix */
+    IP_ADDRESS Prefix;            /* Network prefix with the host bits cleared */
+    UINT PrefixLength;            /* Number of significant bits in Prefix */
+    LIST_ENTRY FIBList;           /* Routes to this prefix */
+} FIB_NODE, *PFIB_NODE;
+
 /* Forward Information Base Entry */
 typedef struct _FIB_ENTRY {
     LIST_ENTRY ListEntry;         /* Entry on list */
+    LIST_ENTRY NodeEntry;         /* Entry on the trie node route list */
+    PFIB_NODE Node;               /* Trie node holding this route */
     OBJECT_FREE_ROUTINE Free;     /* Routine used to free resources for the object */
     IP_ADDRESS NetworkAddress;    /* Address of network */
     IP_ADDRESS Netmask;           /* Netmask of network */
@@ -20,6 +36,13 @@ typedef struct _FIB_ENTRY {
     UINT Metric;                  /* Cost of this route */
 } FIB_ENTRY, *PFIB_ENTRY;
 
+/* Route cache entry, valid while Generation matches the FIB */
+typedef struct _ROUTE_CACHE_ENTRY {
+    IP_ADDRESS Destination;       /* Destination address */
+    PNEIGHBOR_CACHE_ENTRY Router; /* Pointer to NCE of router to use */
+    ULONG Generation;             /* FIB generation the entry was made in */
+} ROUTE_CACHE_ENTRY, *PROUTE_CACHE_ENTRY;
+
 PFIB_ENTRY RouterAddRoute(
     PIP_ADDRESS NetworkAddress,
     PIP_ADDRESS Netmask,
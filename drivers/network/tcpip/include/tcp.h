@@ -188,6 +188,8 @@ BOOLEAN TCPRemoveIRP( PCONNECTION_ENDPOINT Connection, PIRP Irp );
 
 NTSTATUS TCPSetNoDelay(PCONNECTION_ENDPOINT Connection, BOOLEAN Set);
 
+NTSTATUS TCPSetBufferSize(PCONNECTION_ENDPOINT Connection, BOOLEAN Receive, ULONG Size);
+
 VOID
 TCPUpdateInterfaceLinkStatus(PIP_INTERFACE IF);
 
@@ -25,11 +25,14 @@ typedef struct IPFRAGMENT_CONTEXT {
     UINT BytesLeft;                     /* Number of bytes left to send */
     UINT PathMTU;                       /* Path Maximum Transmission Unit */
     PNEIGHBOR_CACHE_ENTRY NCE;          /* Pointer to NCE to use */
+    ULONG ChecksumOffload;              /* Checksums left to the adapter (IP_CHECKSUM_OFFLOAD_xx) */
     KEVENT Event;                       /* Signalled when the transmission is complete */
     NDIS_STATUS Status;                 /* Status of the transmission */
 } IPFRAGMENT_CONTEXT, *PIPFRAGMENT_CONTEXT;
 
 
+BOOLEAN IPCanOffloadChecksum(PIP_INTERFACE Interface, ULONG Checksum, UINT TotalSize);
+
 NTSTATUS IPSendDatagram(PIP_PACKET IPPacket, PNEIGHBOR_CACHE_ENTRY NCE);
 
 /* EOF */
@@ -24,6 +24,15 @@ TDI_STATUS SetConnectionInfo(TDIObjectID *ID,
             Set = *(BOOLEAN*)Buffer;
             return TCPSetNoDelay(Connection, Set);
         }
+        case TCP_SOCKET_RCVBUF:
+        case TCP_SOCKET_SNDBUF:
+        {
+            if (BufferSize < sizeof(ULONG))
+                return TDI_INVALID_PARAMETER;
+            return TCPSetBufferSize(Connection,
+                                    ID->toi_id == TCP_SOCKET_RCVBUF,
+                                    *(PULONG)Buffer);
+        }
         default:
             DbgPrint("TCPIP: Unknown connection info ID: %u.\n", ID->toi_id);
     }
@@ -1537,6 +1537,18 @@ NTSTATUS DispTdiSetInformationEx(
     Request.RequestNotifyObject = NULL;
     Request.RequestContext      = NULL;
 
+    /* Connection options sent on a connection file object (AFD does this)
+     * apply to that connection instead of the one looked up by entity */
+    if ((ULONG_PTR)IrpSp->FileObject->FsContext2 == TDI_CONNECTION_FILE &&
+        Info->ID.toi_class == INFO_CLASS_PROTOCOL &&
+        Info->ID.toi_type == INFO_TYPE_CONNECTION)
+    {
+        return SetConnectionInfo(&Info->ID,
+                                 TranContext->Handle.ConnectionContext,
+                                 &Info->Buffer,
+                                 Info->BufferSize);
+    }
+
     Status = InfoTdiSetInformationEx(&Request, &Info->ID,
             &Info->Buffer, Info->BufferSize);
 
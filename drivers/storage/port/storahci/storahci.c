@@ -440,30 +440,38 @@ AhciCommandCompletionDpcRoutine (
     AdapterExtension = (PAHCI_ADAPTER_EXTENSION)HwDeviceExtension;
     PortExtension = (PAHCI_PORT_EXTENSION)SystemArgument1;
 
-    StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
-    Srb = RemoveQueue(&PortExtension->CompletionQueue);
-    StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
+    // the DPC is queued only once for any number of interrupts,
+    // so process every Srb completed since the last run
+    for (;;)
+    {
+        StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
+        Srb = RemoveQueue(&PortExtension->CompletionQueue);
+        StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
 
-    NT_ASSERT(Srb != NULL);
+        if (Srb == NULL)
+        {
+            break;
+        }
 
-    if (Srb->SrbStatus == SRB_STATUS_PENDING)
-    {
-        Srb->SrbStatus = SRB_STATUS_SUCCESS;
-    }
-    else
-    {
-        return;
-    }
+        if (Srb->SrbStatus == SRB_STATUS_PENDING)
+        {
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        }
+        else
+        {
+            continue;
+        }
 
-    SrbExtension = GetSrbExtension(Srb);
+        SrbExtension = GetSrbExtension(Srb);
 
-    CompletionRoutine = SrbExtension->CompletionRoutine;
-    NT_ASSERT(CompletionRoutine != NULL);
+        CompletionRoutine = SrbExtension->CompletionRoutine;
+        NT_ASSERT(CompletionRoutine != NULL);
 
-    // now it's completion routine responsibility to set SrbStatus
-    CompletionRoutine(PortExtension, Srb);
+        // now it's completion routine responsibility to set SrbStatus
+        CompletionRoutine(PortExtension, Srb);
 
-    StorPortNotification(RequestComplete, AdapterExtension, Srb);
+        StorPortNotification(RequestComplete, AdapterExtension, Srb);
+    }
 
     return;
 }// -- AhciCommandCompletionDpcRoutine();
@@ -564,6 +572,7 @@ AhciCompleteIssuedSrb (
     )
 {
     ULONG NCS, i;
+    BOOLEAN issueDpc;
     PSCSI_REQUEST_BLOCK Srb;
     PAHCI_SRB_EXTENSION SrbExtension;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
@@ -576,6 +585,7 @@ AhciCompleteIssuedSrb (
 
     AdapterExtension = PortExtension->AdapterExtension;
     NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
+    issueDpc = FALSE;
 
     for (i = 0; i < NCS; i++)
     {
@@ -583,6 +593,10 @@ AhciCompleteIssuedSrb (
         {
             Srb = PortExtension->Slot[i];
 
+            // free the slot, so it can be reused right away
+            PortExtension->Slot[i] = NULL;
+            PortExtension->NcqSlots &= ~(1 << i);
+
             if (Srb == NULL)
             {
                 continue;
@@ -594,7 +608,7 @@ AhciCompleteIssuedSrb (
             if (SrbExtension->CompletionRoutine != NULL)
             {
                 AddQueue(&PortExtension->CompletionQueue, Srb);
-                StorPortIssueDpc(AdapterExtension, &PortExtension->CommandCompletion, PortExtension, Srb);
+                issueDpc = TRUE;
             }
             else
             {
@@ -605,6 +619,12 @@ AhciCompleteIssuedSrb (
         }
     }
 
+    // one DPC handles every completion routine of this interrupt
+    if (issueDpc)
+    {
+        StorPortIssueDpc(AdapterExtension, &PortExtension->CommandCompletion, PortExtension, NULL);
+    }
+
     return;
 }// -- AhciCompleteIssuedSrb();
 
@@ -697,6 +717,9 @@ AhciInterruptHandler (
     {
         AhciCompleteIssuedSrb(PortExtension, (PortExtension->CommandIssuedSlots & (~outstanding)));
         PortExtension->CommandIssuedSlots &= outstanding;
+
+        // the interrupt lock is already held, issue pending Srbs into the freed slots
+        AhciIssueQueuedSrbs(PortExtension);
     }
 
     return;
@@ -1403,6 +1426,12 @@ AhciProcessSrb (
     NT_ASSERT(SlotIndex < AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
     SrbExtension->SlotIndex = SlotIndex;
 
+    // native queued commands carry the slot number as tag in SectorCount[7:3]
+    if (IsNcqCommand(SrbExtension))
+    {
+        SrbExtension->SectorCountLow = (UCHAR)(SlotIndex << 3);
+    }
+
     // program the CFIS in the CommandTable
     CommandHeader = &PortExtension->CommandList[SlotIndex];
 
@@ -1468,6 +1497,11 @@ AhciProcessSrb (
     // mark this slot
     PortExtension->Slot[SlotIndex] = Srb;
     PortExtension->QueueSlots |= 1 << SlotIndex;
+
+    if (IsNcqCommand(SrbExtension))
+    {
+        PortExtension->NcqSlots |= 1 << SlotIndex;
+    }
     return;
 }// -- AhciProcessSrb();
 
@@ -1492,7 +1526,7 @@ AhciActivatePort (
     )
 {
     AHCI_PORT_CMD cmd;
-    ULONG QueueSlots, slotToActivate, tmp;
+    ULONG QueueSlots, ncqSlots;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
 
     AhciDebugPrint("AhciActivatePort()\n");
@@ -1514,23 +1548,22 @@ AhciActivatePort (
         return;
     }
 
-    // get the lowest set bit
-    tmp = QueueSlots & (QueueSlots - 1);
-
-    if (tmp == 0)
-        slotToActivate = QueueSlots;
-    else
-        slotToActivate = (QueueSlots & (~tmp));
-
-    // mark that bit off in QueueSlots
-    // so we can know we it is really needed to activate port or not
-    PortExtension->QueueSlots &= ~slotToActivate;
+    // issue every prepared slot at once, the HBA works through them itself
+    PortExtension->QueueSlots = 0;
     // mark this CommandIssuedSlots
     // to validate in completeIssuedCommand
-    PortExtension->CommandIssuedSlots |= slotToActivate;
+    PortExtension->CommandIssuedSlots |= QueueSlots;
+
+    // section 3.3.13
+    // For native queued commands software sets the PxSACT bit before the PxCI bit
+    ncqSlots = QueueSlots & PortExtension->NcqSlots;
+    if (ncqSlots != 0)
+    {
+        StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->SACT, ncqSlots);
+    }
 
-    // tell the HBA to issue this Command Slot to the given port
-    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, slotToActivate);
+    // tell the HBA to issue these Command Slots to the given port
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, QueueSlots);
 
     return;
 }// -- AhciActivatePort();
@@ -1539,6 +1572,91 @@ AhciActivatePort (
     #pragma warning(pop)
 #endif
 
+/**
+ * @name AhciIssueQueuedSrbs
+ * @implemented
+ *
+ * Move pending Srbs from the port queue into free command slots and
+ * program the port. Caller must hold the InterruptLock.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciIssueQueuedSrbs (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    PSCSI_REQUEST_BLOCK tmpSrb;
+    PAHCI_SRB_EXTENSION SrbExtension;
+    PAHCI_ADAPTER_EXTENSION AdapterExtension;
+    ULONG freeSlots, occupiedSlots, slotIndex, slotCount, NCS;
+
+    AhciDebugPrint("AhciIssueQueuedSrbs()\n");
+
+    AdapterExtension = PortExtension->AdapterExtension;
+
+    if (PortExtension->DeviceParams.IsActive == FALSE)
+    {
+        return; // we should wait for device to get active
+    }
+
+    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
+    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
+
+    for (;;)
+    {
+        tmpSrb = PeekQueue(&PortExtension->SrbQueue);
+        if (tmpSrb == NULL)
+        {
+            break;
+        }
+
+        NT_ASSERT(tmpSrb->PathId == PortExtension->PortNumber);
+        SrbExtension = GetSrbExtension(tmpSrb);
+
+        // 5.5.1 -- software must not mix native queued and non-queued commands,
+        // wait until the commands of the other kind have completed
+        if (IsNcqCommand(SrbExtension))
+        {
+            if ((occupiedSlots & ~PortExtension->NcqSlots) != 0)
+            {
+                break;
+            }
+
+            // the slot number is the NCQ tag, it must be below the device queue depth
+            slotCount = min(NCS, PortExtension->DeviceParams.NcqQueueDepth);
+        }
+        else
+        {
+            if (PortExtension->NcqSlots != 0)
+            {
+                break;
+            }
+
+            slotCount = NCS;
+        }
+
+        freeSlots = AHCI_COMMAND_SLOT_MASK(slotCount) & ~occupiedSlots;
+        if (freeSlots == 0)
+        {
+            break;
+        }
+
+        // find first free slot
+        for (slotIndex = 0; (freeSlots & (1 << slotIndex)) == 0; slotIndex++);
+
+        RemoveQueue(&PortExtension->SrbQueue);
+        AhciProcessSrb(PortExtension, tmpSrb, slotIndex);
+        occupiedSlots |= (1 << slotIndex);
+    }
+
+    // program HBA port
+    AhciActivatePort(PortExtension);
+
+    return;
+}// -- AhciIssueQueuedSrbs();
+
 /**
  * @name AhciProcessIO
  * @implemented
@@ -1558,10 +1676,8 @@ AhciProcessIO (
     __in PSCSI_REQUEST_BLOCK Srb
     )
 {
-    PSCSI_REQUEST_BLOCK tmpSrb;
     STOR_LOCK_HANDLE lockhandle = {0};
     PAHCI_PORT_EXTENSION PortExtension;
-    ULONG commandSlotMask, occupiedSlots, slotIndex, NCS;
 
     AhciDebugPrint("AhciProcessIO()\n");
     AhciDebugPrint("\tPathId: %d\n", PathId);
@@ -1576,46 +1692,7 @@ AhciProcessIO (
     // add Srb to queue
     AddQueue(&PortExtension->SrbQueue, Srb);
 
-    if (PortExtension->DeviceParams.IsActive == FALSE)
-    {
-        // Release Lock
-        StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
-        return; // we should wait for device to get active
-    }
-
-    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
-    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
-    commandSlotMask = (1 << NCS) - 1; // available slots mask
-
-    commandSlotMask = (commandSlotMask & ~occupiedSlots);
-    if(commandSlotMask != 0)
-    {
-        // iterate over HBA port slots
-        for (slotIndex = 0; slotIndex < NCS; slotIndex++)
-        {
-            // find first free slot
-            if ((commandSlotMask & (1 << slotIndex)) != 0)
-            {
-                tmpSrb = RemoveQueue(&PortExtension->SrbQueue);
-                if (tmpSrb != NULL)
-                {
-                    NT_ASSERT(tmpSrb->PathId == PathId);
-                    AhciProcessSrb(PortExtension, tmpSrb, slotIndex);
-                }
-                else
-                {
-                    break;
-                }
-            }
-            else
-            {
-                break;
-            }
-        }
-    }
-
-    // program HBA port
-    AhciActivatePort(PortExtension);
+    AhciIssueQueuedSrbs(PortExtension);
 
     // Release Lock
     StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
@@ -1766,6 +1843,18 @@ InquiryCompletion (
 
         PortExtension->DeviceParams.BytesPerPhysicalSector = DEVICE_ATA_BLOCK_SIZE;
 
+        /* Native Command Queuing, both HBA and device have to support it */
+        PortExtension->DeviceParams.NativeCommandQueuing = 0;
+        if (IsAdapterCAPSNCQ(AdapterExtension->CAP) &&
+            IsNcqSupported(IdentifyDeviceData) &&
+            PortExtension->DeviceParams.Lba48BitMode)
+        {
+            PortExtension->DeviceParams.NativeCommandQueuing = 1;
+            PortExtension->DeviceParams.NcqQueueDepth = min(IdentifyDeviceData->QueueDepth + 1,
+                                                           AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
+            AhciDebugPrint("\tNCQ queue depth: %d\n", PortExtension->DeviceParams.NcqQueueDepth);
+        }
+
         // last byte should be NULL
         StorPortCopyMemory(PortExtension->DeviceParams.VendorId, IdentifyDeviceData->ModelNumber, sizeof(PortExtension->DeviceParams.VendorId) - 1);
         StorPortCopyMemory(PortExtension->DeviceParams.RevisionID, IdentifyDeviceData->FirmwareRevision, sizeof(PortExtension->DeviceParams.RevisionID) - 1);
@@ -1798,7 +1887,7 @@ InquiryCompletion (
     // prepare data to send
     InquiryData->Versions = 2;
     InquiryData->Wide32Bit = 1;
-    InquiryData->CommandQueue = 0; // NCQ not supported
+    InquiryData->CommandQueue = PortExtension->DeviceParams.NativeCommandQueuing;
     InquiryData->ResponseDataFormat = 0x2;
     InquiryData->DeviceTypeModifier = 0;
     InquiryData->DeviceTypeQualifier = DEVICE_CONNECTED;
@@ -1820,6 +1909,8 @@ InquiryCompletion (
                                          Srb->PathId,
                                          Srb->TargetId,
                                          Srb->Lun,
+                                         PortExtension->DeviceParams.NativeCommandQueuing ?
+                                         PortExtension->DeviceParams.NcqQueueDepth :
                                          AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
 
     NT_ASSERT(status == TRUE);
@@ -2074,7 +2165,23 @@ DeviceRequestReadWrite (
     SrbExtension->SectorCountLow = (SectorCount >> 0) & 0xFF;
     SrbExtension->SectorCountHigh = (SectorCount >> 8) & 0xFF;
 
-    NT_ASSERT(SectorCount < 0x100);
+    if (PortExtension->DeviceParams.NativeCommandQueuing)
+    {
+        // READ/WRITE FPDMA QUEUED
+        // sector count goes to the Features registers, the tag into SectorCount[7:3]
+        // once a slot is assigned (AhciProcessSrb)
+        SrbExtension->Flags |= ATA_FLAGS_NCQ_COMMAND;
+        SrbExtension->CommandReg = IsReading ? IDE_COMMAND_READ_FPDMA_QUEUED : IDE_COMMAND_WRITE_FPDMA_QUEUED;
+        SrbExtension->FeaturesLow = (SectorCount >> 0) & 0xFF;
+        SrbExtension->FeaturesHigh = (SectorCount >> 8) & 0xFF;
+        SrbExtension->SectorCountLow = 0;
+        SrbExtension->SectorCountHigh = 0;
+        SrbExtension->Device = IDE_LBA_MODE;
+    }
+    else
+    {
+        NT_ASSERT(SectorCount < 0x100);
+    }
 
     SrbExtension->pSgl = (PLOCAL_SCATTER_GATHER_LIST)StorPortGetScatterGatherList(AdapterExtension, Srb);
 
@@ -2547,6 +2654,33 @@ RemoveQueue (
     return Srb;
 }// -- RemoveQueue();
 
+/**
+ * @name PeekQueue
+ * @implemented
+ *
+ * Return Srb at the front of Queue without removing it
+ *
+ * @param Queue
+ *
+ * @return
+ * return Srb
+ *
+ */
+__inline
+PVOID
+PeekQueue (
+    __in PAHCI_QUEUE Queue
+    )
+{
+    NT_ASSERT(Queue->Head < MAXIMUM_QUEUE_BUFFER_SIZE);
+    NT_ASSERT(Queue->Tail < MAXIMUM_QUEUE_BUFFER_SIZE);
+
+    if (Queue->Head == Queue->Tail)
+        return NULL;
+
+    return Queue->Buffer[Queue->Tail];
+}// -- PeekQueue();
+
 /**
  * @name GetSrbExtension
  * @implemented
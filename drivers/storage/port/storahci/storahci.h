@@ -20,7 +20,7 @@
 
 #define MAXIMUM_AHCI_PORT_COUNT             32
 #define MAXIMUM_AHCI_PRDT_ENTRIES           32
-#define MAXIMUM_AHCI_PORT_NCS               30
+#define MAXIMUM_AHCI_PORT_NCS               32
 #define MAXIMUM_QUEUE_BUFFER_SIZE           255
 #define MAXIMUM_TRANSFER_LENGTH             (128*1024) // 128 KB
 
@@ -33,6 +33,18 @@
 
 // section 3.1.2
 #define AHCI_Global_HBA_CAP_S64A            (1 << 31)
+#define AHCI_Global_HBA_CAP_SNCQ            (1 << 30)
+
+// ATA8-ACS native command queuing
+#ifndef IDE_COMMAND_READ_FPDMA_QUEUED
+#define IDE_COMMAND_READ_FPDMA_QUEUED       0x60
+#endif
+#ifndef IDE_COMMAND_WRITE_FPDMA_QUEUED
+#define IDE_COMMAND_WRITE_FPDMA_QUEUED      0x61
+#endif
+
+// IDENTIFY DEVICE word 76 (Serial ATA capabilities), bit 8 -- NCQ supported
+#define IsNcqSupported(IdentifyData)        ((IdentifyData)->ReservedWords76[0] & (1 << 8))
 
 // FIS Types : http://wiki.osdev.org/AHCI
 #define FIS_TYPE_REG_H2D        0x27 // Register FIS - host to device
@@ -71,14 +83,20 @@
 #define ATA_FLAGS_DATA_OUT                  (1 << 2)
 #define ATA_FLAGS_48BIT_COMMAND             (1 << 3)
 #define ATA_FLAGS_USE_DMA                   (1 << 4)
+#define ATA_FLAGS_NCQ_COMMAND               (1 << 5)
 
 #define IsAtaCommand(AtaFunction)           (AtaFunction & ATA_FUNCTION_ATA_COMMAND)
 #define IsAtapiCommand(AtaFunction)         (AtaFunction & ATA_FUNCTION_ATAPI_COMMAND)
 #define IsDataTransferNeeded(SrbExtension)  (SrbExtension->Flags & (ATA_FLAGS_DATA_IN | ATA_FLAGS_DATA_OUT))
 #define IsAdapterCAPS64(CAP)                (CAP & AHCI_Global_HBA_CAP_S64A)
+#define IsAdapterCAPSNCQ(CAP)               (CAP & AHCI_Global_HBA_CAP_SNCQ)
+#define IsNcqCommand(SrbExtension)          (SrbExtension->Flags & ATA_FLAGS_NCQ_COMMAND)
+
+// 3.1.1 NCS = CAP[12:08] -> 0's based value
+#define AHCI_Global_Port_CAP_NCS(x)         ((((x) & 0x1F00) >> 8) + 1)
 
-// 3.1.1 NCS = CAP[12:08] -> Align
-#define AHCI_Global_Port_CAP_NCS(x)         (((x) & 0xF00) >> 8)
+// bit mask of the first NCS command slots, NCS may be 32
+#define AHCI_COMMAND_SLOT_MASK(NCS)         ((NCS) >= 32 ? 0xFFFFFFFF : ((1 << (NCS)) - 1))
 
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 //#define AhciDebugPrint(format, ...) StorPortDebugPrint(0, format, __VA_ARGS__)
@@ -464,6 +482,7 @@ typedef struct _AHCI_PORT_EXTENSION
     ULONG PortNumber;
     ULONG QueueSlots;                                   // slots which we have already assigned task (Slot)
     ULONG CommandIssuedSlots;                           // slots which has been programmed
+    ULONG NcqSlots;                                     // assigned slots holding native queued commands
     ULONG MaxPortQueueDepth;
 
     struct
@@ -473,6 +492,8 @@ typedef struct _AHCI_PORT_EXTENSION
         UCHAR AccessType;
         UCHAR DeviceType;
         UCHAR IsActive;
+        UCHAR NativeCommandQueuing;
+        ULONG NcqQueueDepth;
         LARGE_INTEGER MaxLba;
         ULONG BytesPerLogicalSector;
         ULONG BytesPerPhysicalSector;
@@ -576,6 +597,11 @@ AhciProcessIO (
     __in PSCSI_REQUEST_BLOCK Srb
     );
 
+VOID
+AhciIssueQueuedSrbs (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    );
+
 BOOLEAN
 AhciAdapterReset (
     __in PAHCI_ADAPTER_EXTENSION AdapterExtension
@@ -645,6 +671,12 @@ RemoveQueue (
     __inout PAHCI_QUEUE Queue
     );
 
+__inline
+PVOID
+PeekQueue (
+    __in PAHCI_QUEUE Queue
+    );
+
 __inline
 PAHCI_SRB_EXTENSION
 GetSrbExtension(
@@ -555,6 +555,111 @@ PortFdoFilterRequirements(
 }
 
 
+PPDO_DEVICE_EXTENSION
+PortFdoFindPdo(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ ULONG Bus,
+    _In_ ULONG Target,
+    _In_ ULONG Lun)
+{
+    PPDO_DEVICE_EXTENSION PdoExtension, Found = NULL;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PLIST_ENTRY ListEntry;
+
+    KeAcquireInStackQueuedSpinLock(&DeviceExtension->PdoListLock,
+                                   &LockHandle);
+
+    for (ListEntry = DeviceExtension->PdoListHead.Flink;
+         ListEntry != &DeviceExtension->PdoListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        PdoExtension = CONTAINING_RECORD(ListEntry,
+                                         PDO_DEVICE_EXTENSION,
+                                         PdoListEntry);
+        if (PdoExtension->Bus == Bus &&
+            PdoExtension->Target == Target &&
+            PdoExtension->Lun == Lun)
+        {
+            Found = PdoExtension;
+            break;
+        }
+    }
+
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    return Found;
+}
+
+
+VOID
+PortFdoQueueCompletedRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PPORT_REQUEST Request, Next;
+    PIRP Irp;
+
+    Irp = (PIRP)Srb->OriginalRequest;
+    Request = (PPORT_REQUEST)Irp->Tail.Overlay.DriverContext[0];
+    if (Request == NULL)
+    {
+        DPRINT1("Srb %p was not started by the port driver\n", Srb);
+        return;
+    }
+
+    /* Miniports may complete requests from their interrupt handler,
+       so push the request onto a lock-free list and let the DPC do the rest */
+    do
+    {
+        Next = DeviceExtension->CompletedList;
+        Request->NextCompleted = Next;
+    }
+    while (InterlockedCompareExchangePointer((PVOID*)&DeviceExtension->CompletedList,
+                                             Request,
+                                             Next) != Next);
+
+    KeInsertQueueDpc(&DeviceExtension->CompletionDpc, NULL, NULL);
+}
+
+
+VOID
+NTAPI
+PortFdoCompletionDpc(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    PPORT_REQUEST Request, Next, Ordered = NULL;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    DeviceExtension = (PFDO_DEVICE_EXTENSION)DeferredContext;
+
+    /* Take every request completed since the last run at once */
+    Request = InterlockedExchangePointer((PVOID*)&DeviceExtension->CompletedList, NULL);
+
+    /* The list is LIFO, reverse it to complete in the order the miniport did */
+    while (Request != NULL)
+    {
+        Next = Request->NextCompleted;
+        Request->NextCompleted = Ordered;
+        Ordered = Request;
+        Request = Next;
+    }
+
+    while (Ordered != NULL)
+    {
+        Next = Ordered->NextCompleted;
+        PortPdoCompleteRequest(Ordered);
+        Ordered = Next;
+    }
+}
+
+
 NTSTATUS
 NTAPI
 PortFdoScsi(
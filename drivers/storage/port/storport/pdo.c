@@ -70,6 +70,14 @@ PortCreatePdo(
     DeviceExtension->Target = Target;
     DeviceExtension->Lun = Lun;
 
+    KeInitializeSpinLock(&DeviceExtension->QueueLock);
+    InitializeListHead(&DeviceExtension->PendingIrpListHead);
+
+    /* Miniports that cannot handle more than one request per LUN get a queue depth of 1 */
+    if (FdoDeviceExtension->Miniport.PortConfig.MultipleRequestPerLu)
+        DeviceExtension->QueueDepth = PORT_DEFAULT_QUEUE_DEPTH;
+    else
+        DeviceExtension->QueueDepth = 1;
 
     // FIXME: More initialization
 
@@ -115,18 +123,343 @@ PortDeletePdo(
 }
 
 
+static
+NTSTATUS
+PortSrbStatusToNtStatus(
+    _In_ UCHAR SrbStatus)
+{
+    switch (SRB_STATUS(SrbStatus))
+    {
+        case SRB_STATUS_SUCCESS:
+        case SRB_STATUS_DATA_OVERRUN:
+            return STATUS_SUCCESS;
+
+        case SRB_STATUS_INVALID_REQUEST:
+        case SRB_STATUS_BAD_FUNCTION:
+        case SRB_STATUS_BAD_SRB_BLOCK_LENGTH:
+            return STATUS_INVALID_DEVICE_REQUEST;
+
+        case SRB_STATUS_NO_DEVICE:
+        case SRB_STATUS_SELECTION_TIMEOUT:
+            return STATUS_DEVICE_DOES_NOT_EXIST;
+
+        case SRB_STATUS_BUSY:
+            return STATUS_DEVICE_BUSY;
+
+        case SRB_STATUS_TIMEOUT:
+        case SRB_STATUS_COMMAND_TIMEOUT:
+            return STATUS_IO_TIMEOUT;
+
+        default:
+            return STATUS_IO_DEVICE_ERROR;
+    }
+}
+
+
+static
+VOID
+PortFreeRequest(
+    _In_ PPORT_REQUEST Request)
+{
+    if (Request->SrbExtension != NULL)
+        ExFreePoolWithTag(Request->SrbExtension, TAG_SRB_EXTENSION);
+
+    ExFreePoolWithTag(Request, TAG_PORT_REQUEST);
+}
+
+
+static
+PPORT_REQUEST
+PortAllocateRequest(
+    _In_ PPDO_DEVICE_EXTENSION PdoExtension,
+    _In_ PIRP Irp,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PPORT_REQUEST Request;
+    ULONG SrbExtensionSize;
+    ULONG MaximumElements = 0;
+
+    if (Srb->DataBuffer != NULL && Srb->DataTransferLength != 0)
+        MaximumElements = ADDRESS_AND_SIZE_TO_SPAN_PAGES(Srb->DataBuffer,
+                                                         Srb->DataTransferLength);
+
+    /* The scatter/gather list is stored right behind the request */
+    Request = ExAllocatePoolWithTag(NonPagedPool,
+                                    sizeof(PORT_REQUEST) +
+                                    FIELD_OFFSET(STOR_SCATTER_GATHER_LIST, List) +
+                                    MaximumElements * sizeof(STOR_SCATTER_GATHER_ELEMENT),
+                                    TAG_PORT_REQUEST);
+    if (Request == NULL)
+        return NULL;
+
+    RtlZeroMemory(Request, sizeof(PORT_REQUEST));
+    Request->PdoExtension = PdoExtension;
+    Request->Irp = Irp;
+    Request->Srb = Srb;
+    Request->MaximumElements = MaximumElements;
+    Request->ScatterGatherList = (PSTOR_SCATTER_GATHER_LIST)(Request + 1);
+
+    /* Allocate the miniport's per-request context. Pool blocks smaller than
+       a page never cross a page boundary, so it stays physically contiguous. */
+    SrbExtensionSize = PdoExtension->FdoExtension->Miniport.InitData->SrbExtensionSize;
+    if (SrbExtensionSize != 0 && Srb->SrbExtension == NULL)
+    {
+        Request->SrbExtension = ExAllocatePoolWithTag(NonPagedPool,
+                                                      SrbExtensionSize,
+                                                      TAG_SRB_EXTENSION);
+        if (Request->SrbExtension == NULL)
+        {
+            ExFreePoolWithTag(Request, TAG_PORT_REQUEST);
+            return NULL;
+        }
+
+        RtlZeroMemory(Request->SrbExtension, SrbExtensionSize);
+        Srb->SrbExtension = Request->SrbExtension;
+    }
+
+    return Request;
+}
+
+
+PSTOR_SCATTER_GATHER_LIST
+PortGetScatterGatherList(
+    _In_ PPORT_REQUEST Request)
+{
+    PSTOR_SCATTER_GATHER_LIST List = Request->ScatterGatherList;
+    PSCSI_REQUEST_BLOCK Srb = Request->Srb;
+    PMDL Mdl = Request->Irp->MdlAddress;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PPFN_NUMBER PfnArray = NULL;
+    ULONG_PTR MdlOffset = 0;
+    PUCHAR VirtualAddress;
+    ULONG Remaining, Length, Index = 0;
+
+    if (Request->ScatterGatherBuilt)
+        return List;
+
+    if (Request->MaximumElements == 0)
+        return NULL;
+
+    VirtualAddress = Srb->DataBuffer;
+    Remaining = Srb->DataTransferLength;
+
+    /* Use the MDL page array when it describes the data buffer,
+       the buffer may not be mapped in the current process */
+    if (Mdl != NULL)
+    {
+        MdlOffset = (ULONG_PTR)VirtualAddress - (ULONG_PTR)MmGetMdlVirtualAddress(Mdl);
+        if (MdlOffset < MmGetMdlByteCount(Mdl) &&
+            MdlOffset + Remaining <= MmGetMdlByteCount(Mdl))
+        {
+            PfnArray = MmGetMdlPfnArray(Mdl);
+            MdlOffset += MmGetMdlByteOffset(Mdl);
+        }
+    }
+
+    List->NumberOfElements = 0;
+
+    while (Remaining != 0)
+    {
+        if (PfnArray != NULL)
+        {
+            PhysicalAddress.QuadPart = ((LONGLONG)PfnArray[MdlOffset >> PAGE_SHIFT] << PAGE_SHIFT) +
+                                       (MdlOffset & (PAGE_SIZE - 1));
+            Length = PAGE_SIZE - (ULONG)(MdlOffset & (PAGE_SIZE - 1));
+        }
+        else
+        {
+            PhysicalAddress = MmGetPhysicalAddress(VirtualAddress);
+            Length = PAGE_SIZE - BYTE_OFFSET(VirtualAddress);
+        }
+
+        if (Length > Remaining)
+            Length = Remaining;
+
+        /* Merge physically contiguous pages into one element */
+        if (Index != 0 &&
+            List->List[Index - 1].PhysicalAddress.QuadPart + List->List[Index - 1].Length == PhysicalAddress.QuadPart)
+        {
+            List->List[Index - 1].Length += Length;
+        }
+        else
+        {
+            ASSERT(Index < Request->MaximumElements);
+            List->List[Index].PhysicalAddress = PhysicalAddress;
+            List->List[Index].Length = Length;
+            List->List[Index].Reserved = 0;
+            Index++;
+        }
+
+        VirtualAddress += Length;
+        MdlOffset += Length;
+        Remaining -= Length;
+    }
+
+    List->NumberOfElements = Index;
+    Request->ScatterGatherBuilt = TRUE;
+
+    return List;
+}
+
+
+VOID
+PortPdoStartNextRequests(
+    _In_ PPDO_DEVICE_EXTENSION PdoExtension)
+{
+    PFDO_DEVICE_EXTENSION FdoExtension = PdoExtension->FdoExtension;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PLIST_ENTRY ListEntry;
+    PPORT_REQUEST Request;
+    PIRP Irp;
+    KIRQL OldIrql;
+
+    for (;;)
+    {
+        /* Start as many requests as the LUN queue depth allows */
+        KeAcquireInStackQueuedSpinLock(&PdoExtension->QueueLock, &LockHandle);
+
+        if (IsListEmpty(&PdoExtension->PendingIrpListHead) ||
+            PdoExtension->OutstandingCount >= PdoExtension->QueueDepth)
+        {
+            KeReleaseInStackQueuedSpinLock(&LockHandle);
+            return;
+        }
+
+        ListEntry = RemoveHeadList(&PdoExtension->PendingIrpListHead);
+        PdoExtension->OutstandingCount++;
+
+        KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+        Irp = CONTAINING_RECORD(ListEntry, IRP, Tail.Overlay.ListEntry);
+        Request = (PPORT_REQUEST)Irp->Tail.Overlay.DriverContext[0];
+
+        Request->Srb->SrbStatus = SRB_STATUS_PENDING;
+
+        KeAcquireSpinLock(&FdoExtension->StartIoLock, &OldIrql);
+        MiniportStartIo(&FdoExtension->Miniport, Request->Srb);
+        KeReleaseSpinLock(&FdoExtension->StartIoLock, OldIrql);
+    }
+}
+
+
+VOID
+PortPdoCompleteRequest(
+    _In_ PPORT_REQUEST Request)
+{
+    PPDO_DEVICE_EXTENSION PdoExtension = Request->PdoExtension;
+    PSCSI_REQUEST_BLOCK Srb = Request->Srb;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PIRP Irp = Request->Irp;
+
+    DPRINT("PortPdoCompleteRequest(%p) SrbStatus 0x%02x\n", Request, Srb->SrbStatus);
+
+    Irp->IoStatus.Status = PortSrbStatusToNtStatus(Srb->SrbStatus);
+    Irp->IoStatus.Information = NT_SUCCESS(Irp->IoStatus.Status) ? Srb->DataTransferLength : 0;
+    Irp->Tail.Overlay.DriverContext[0] = NULL;
+
+    if (Request->SrbExtension != NULL)
+        Srb->SrbExtension = NULL;
+
+    PortFreeRequest(Request);
+
+    KeAcquireInStackQueuedSpinLock(&PdoExtension->QueueLock, &LockHandle);
+    ASSERT(PdoExtension->OutstandingCount != 0);
+    PdoExtension->OutstandingCount--;
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    IoCompleteRequest(Irp, IO_DISK_INCREMENT);
+
+    /* Refill the slot we just freed */
+    PortPdoStartNextRequests(PdoExtension);
+}
+
+
 NTSTATUS
 NTAPI
 PortPdoScsi(
     _In_ PDEVICE_OBJECT DeviceObject,
     _In_ PIRP Irp)
 {
-    DPRINT1("PortPdoScsi(%p %p)\n", DeviceObject, Irp);
+    PPDO_DEVICE_EXTENSION DeviceExtension;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PIO_STACK_LOCATION Stack;
+    PSCSI_REQUEST_BLOCK Srb;
+    PPORT_REQUEST Request;
+    NTSTATUS Status;
+
+    DPRINT("PortPdoScsi(%p %p)\n", DeviceObject, Irp);
+
+    DeviceExtension = (PPDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
+    ASSERT(DeviceExtension);
+    ASSERT(DeviceExtension->ExtensionType == PdoExtension);
+
+    Stack = IoGetCurrentIrpStackLocation(Irp);
+    Srb = Stack->Parameters.Scsi.Srb;
+    if (Srb == NULL)
+    {
+        Status = STATUS_INVALID_PARAMETER;
+        goto done;
+    }
 
+    switch (Srb->Function)
+    {
+        case SRB_FUNCTION_EXECUTE_SCSI:
+        case SRB_FUNCTION_IO_CONTROL:
+        case SRB_FUNCTION_SHUTDOWN:
+        case SRB_FUNCTION_FLUSH:
+        case SRB_FUNCTION_RESET_DEVICE:
+        case SRB_FUNCTION_RESET_LOGICAL_UNIT:
+        case SRB_FUNCTION_PNP:
+            break;
+
+        case SRB_FUNCTION_CLAIM_DEVICE:
+            Srb->DataBuffer = DeviceObject;
+            /* Fall through */
+        case SRB_FUNCTION_RELEASE_DEVICE:
+        case SRB_FUNCTION_RELEASE_QUEUE:
+        case SRB_FUNCTION_FLUSH_QUEUE:
+        case SRB_FUNCTION_LOCK_QUEUE:
+        case SRB_FUNCTION_UNLOCK_QUEUE:
+            /* Queue management is done by the port, not by the miniport */
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+            Status = STATUS_SUCCESS;
+            goto done;
+
+        default:
+            DPRINT1("Unsupported SRB function 0x%x\n", Srb->Function);
+            Srb->SrbStatus = SRB_STATUS_INVALID_REQUEST;
+            Status = STATUS_NOT_SUPPORTED;
+            goto done;
+    }
+
+    Srb->OriginalRequest = Irp;
+
+    Request = PortAllocateRequest(DeviceExtension, Irp, Srb);
+    if (Request == NULL)
+    {
+        Srb->SrbStatus = SRB_STATUS_ERROR;
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto done;
+    }
+
+    Irp->Tail.Overlay.DriverContext[0] = Request;
+
+    IoMarkIrpPending(Irp);
+
+    KeAcquireInStackQueuedSpinLock(&DeviceExtension->QueueLock, &LockHandle);
+    InsertTailList(&DeviceExtension->PendingIrpListHead,
+                   &Irp->Tail.Overlay.ListEntry);
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    PortPdoStartNextRequests(DeviceExtension);
+
+    return STATUS_PENDING;
+
+done:
     Irp->IoStatus.Information = 0;
-    Irp->IoStatus.Status = STATUS_SUCCESS;
+    Irp->IoStatus.Status = Status;
     IoCompleteRequest(Irp, IO_NO_INCREMENT);
-    return STATUS_SUCCESS;
+    return Status;
 }
 
 
@@ -31,6 +31,11 @@
 #define TAG_ADDRESS_MAPPING 'MAtS'
 #define TAG_INQUIRY_DATA    'QItS'
 #define TAG_SENSE_DATA      'NStS'
+#define TAG_PORT_REQUEST    'QRtS'
+#define TAG_SRB_EXTENSION   'EStS'
+
+/* Per-LUN queue depth used until the miniport sets its own */
+#define PORT_DEFAULT_QUEUE_DEPTH    20
 
 typedef enum
 {
@@ -81,6 +86,18 @@ typedef struct _MINIPORT
     PMINIPORT_DEVICE_EXTENSION MiniportExtension;
 } MINIPORT, *PMINIPORT;
 
+typedef struct _PORT_REQUEST
+{
+    struct _PORT_REQUEST *NextCompleted;
+    struct _PDO_DEVICE_EXTENSION *PdoExtension;
+    PIRP Irp;
+    PSCSI_REQUEST_BLOCK Srb;
+    PVOID SrbExtension;
+    ULONG MaximumElements;
+    BOOLEAN ScatterGatherBuilt;
+    PSTOR_SCATTER_GATHER_LIST ScatterGatherList;
+} PORT_REQUEST, *PPORT_REQUEST;
+
 typedef struct _UNIT_DATA
 {
     LIST_ENTRY ListEntry;
@@ -115,6 +132,13 @@ typedef struct _FDO_DEVICE_EXTENSION
     KSPIN_LOCK PdoListLock;
     LIST_ENTRY PdoListHead;
     ULONG PdoCount;
+
+    /* Serializes calls to HwStartIo */
+    KSPIN_LOCK StartIoLock;
+
+    /* Requests completed by the miniport, pushed at any IRQL */
+    PPORT_REQUEST CompletedList;
+    KDPC CompletionDpc;
 } FDO_DEVICE_EXTENSION, *PFDO_DEVICE_EXTENSION;
 
 
@@ -132,7 +156,11 @@ typedef struct _PDO_DEVICE_EXTENSION
     ULONG Lun;
     PINQUIRYDATA InquiryBuffer;
 
-
+    /* Requests waiting for a free queue slot */
+    KSPIN_LOCK QueueLock;
+    LIST_ENTRY PendingIrpListHead;
+    ULONG QueueDepth;
+    ULONG OutstandingCount;
 } PDO_DEVICE_EXTENSION, *PPDO_DEVICE_EXTENSION;
 
 
@@ -150,6 +178,26 @@ PortFdoPnp(
     _In_ PDEVICE_OBJECT DeviceObject,
     _In_ PIRP Irp);
 
+VOID
+NTAPI
+PortFdoCompletionDpc(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2);
+
+VOID
+PortFdoQueueCompletedRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+PPDO_DEVICE_EXTENSION
+PortFdoFindPdo(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ ULONG Bus,
+    _In_ ULONG Target,
+    _In_ ULONG Lun);
+
 
 /* miniport.c */
 
@@ -260,6 +308,18 @@ PortPdoPnp(
     _In_ PDEVICE_OBJECT DeviceObject,
     _In_ PIRP Irp);
 
+VOID
+PortPdoStartNextRequests(
+    _In_ PPDO_DEVICE_EXTENSION PdoExtension);
+
+VOID
+PortPdoCompleteRequest(
+    _In_ PPORT_REQUEST Request);
+
+PSTOR_SCATTER_GATHER_LIST
+PortGetScatterGatherList(
+    _In_ PPORT_REQUEST Request);
+
 
 /* storport.c */
 
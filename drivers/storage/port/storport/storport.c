@@ -121,6 +121,8 @@ PortAcquireSpinLock(
 
         case StartIoLock: /* 2 */
             DPRINT1("StartIoLock\n");
+            KeAcquireSpinLock(&DeviceExtension->StartIoLock,
+                              &LockHandle->Context.OldIrql);
             break;
 
         case InterruptLock: /* 3 */
@@ -151,6 +153,8 @@ PortReleaseSpinLock(
 
         case StartIoLock: /* 2 */
             DPRINT1("StartIoLock\n");
+            KeReleaseSpinLock(&DeviceExtension->StartIoLock,
+                              LockHandle->Context.OldIrql);
             break;
 
         case InterruptLock: /* 3 */
@@ -226,6 +230,11 @@ PortAddDevice(
     KeInitializeSpinLock(&DeviceExtension->PdoListLock);
     InitializeListHead(&DeviceExtension->PdoListHead);
 
+    KeInitializeSpinLock(&DeviceExtension->StartIoLock);
+    KeInitializeDpc(&DeviceExtension->CompletionDpc,
+                    PortFdoCompletionDpc,
+                    DeviceExtension);
+
     /* Attach the FDO to the device stack */
     Status = IoAttachDeviceToDeviceStackSafe(Fdo,
                                              PhysicalDeviceObject,
@@ -838,7 +847,7 @@ StorPortGetPhysicalAddress(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 PSTOR_SCATTER_GATHER_LIST
@@ -847,9 +856,20 @@ StorPortGetScatterGatherList(
     _In_ PVOID DeviceExtension,
     _In_ PSCSI_REQUEST_BLOCK Srb)
 {
-    DPRINT1("StorPortGetScatterGatherList()\n");
-    UNIMPLEMENTED;
-    return NULL;
+    PPORT_REQUEST Request;
+    PIRP Irp;
+
+    DPRINT("StorPortGetScatterGatherList(%p %p)\n", DeviceExtension, Srb);
+
+    Irp = (PIRP)Srb->OriginalRequest;
+    if (Irp == NULL)
+        return NULL;
+
+    Request = (PPORT_REQUEST)Irp->Tail.Overlay.DriverContext[0];
+    if (Request == NULL || Request->Srb != Srb)
+        return NULL;
+
+    return PortGetScatterGatherList(Request);
 }
 
 
@@ -1132,10 +1152,10 @@ StorPortNotification(
             DPRINT1("RequestComplete\n");
             Srb = (PSCSI_REQUEST_BLOCK)va_arg(ap, PSCSI_REQUEST_BLOCK);
             DPRINT1("Srb %p\n", Srb);
-            if (Srb->OriginalRequest != NULL)
+            if ((DeviceExtension != NULL) &&
+                (Srb->OriginalRequest != NULL))
             {
-                DPRINT1("Need to complete the IRP!\n");
-
+                PortFdoQueueCompletedRequest(DeviceExtension, Srb);
             }
             break;
 
@@ -1390,7 +1410,7 @@ StorPortSetBusDataByOffset(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 BOOLEAN
@@ -1402,9 +1422,34 @@ StorPortSetDeviceQueueDepth(
     _In_ UCHAR Lun,
     _In_ ULONG Depth)
 {
-    DPRINT1("StorPortSetDeviceQueueDepth()\n");
-    UNIMPLEMENTED;
-    return FALSE;
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+    PPDO_DEVICE_EXTENSION PdoExtension;
+    KLOCK_QUEUE_HANDLE LockHandle;
+
+    DPRINT("StorPortSetDeviceQueueDepth(%p %u %u %u %lu)\n",
+           HwDeviceExtension, PathId, TargetId, Lun, Depth);
+
+    if (Depth == 0)
+        return FALSE;
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+
+    PdoExtension = PortFdoFindPdo(MiniportExtension->Miniport->DeviceExtension,
+                                  PathId,
+                                  TargetId,
+                                  Lun);
+    if (PdoExtension == NULL)
+        return FALSE;
+
+    /* Takes effect with the next request that is queued or completed */
+    KeAcquireInStackQueuedSpinLock(&PdoExtension->QueueLock, &LockHandle);
+    PdoExtension->QueueDepth = Depth;
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    return TRUE;
 }
 
 
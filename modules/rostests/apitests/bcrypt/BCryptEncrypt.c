@@ -0,0 +1,286 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Tests for the AES provider of BCryptEncrypt/BCryptDecrypt
+ */
+
+#include <apitest.h>
+
+#include <ntstatus.h>
+#include <bcrypt.h>
+
+static UCHAR Secret[] =
+    {0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f,
+     0x10,0x11,0x12,0x13,0x14,0x15,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x1e,0x1f};
+static UCHAR Iv[] =
+    {0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f};
+static UCHAR Data[] = "0123456789abcdefghijklmnopqrstuv";
+
+static void TestProperties(BCRYPT_ALG_HANDLE Alg)
+{
+    BCRYPT_KEY_LENGTHS_STRUCT KeyLengths;
+    BCRYPT_AUTH_TAG_LENGTHS_STRUCT TagLengths;
+    UCHAR Mode[64];
+    ULONG Size, Length;
+    NTSTATUS Status;
+
+    Length = Size = 0;
+    Status = BCryptGetProperty(Alg, BCRYPT_OBJECT_LENGTH, (PUCHAR)&Length, sizeof(Length), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Length != 0, "Object length is 0\n");
+    ok(Size == sizeof(Length), "Size = %lu\n", Size);
+
+    Length = Size = 0;
+    Status = BCryptGetProperty(Alg, BCRYPT_BLOCK_LENGTH, (PUCHAR)&Length, sizeof(Length), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Length == 16, "Length = %lu\n", Length);
+    ok(Size == sizeof(Length), "Size = %lu\n", Size);
+
+    Size = 0;
+    Status = BCryptGetProperty(Alg, BCRYPT_CHAINING_MODE, Mode, sizeof(Mode), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(!lstrcmpW((PCWSTR)Mode, BCRYPT_CHAIN_MODE_CBC), "Mode = %s\n", wine_dbgstr_w((PCWSTR)Mode));
+    ok(Size == sizeof(BCRYPT_CHAIN_MODE_CBC), "Size = %lu\n", Size);
+
+    Size = 0;
+    ZeroMemory(&KeyLengths, sizeof(KeyLengths));
+    Status = BCryptGetProperty(Alg, BCRYPT_KEY_LENGTHS, (PUCHAR)&KeyLengths, sizeof(KeyLengths), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == sizeof(KeyLengths), "Size = %lu\n", Size);
+    ok(KeyLengths.dwMinLength == 128, "dwMinLength = %lu\n", KeyLengths.dwMinLength);
+    ok(KeyLengths.dwMaxLength == 256, "dwMaxLength = %lu\n", KeyLengths.dwMaxLength);
+    ok(KeyLengths.dwIncrement == 64, "dwIncrement = %lu\n", KeyLengths.dwIncrement);
+
+    /* Only GCM has a tag */
+    Status = BCryptGetProperty(Alg, BCRYPT_AUTH_TAG_LENGTH, (PUCHAR)&TagLengths, sizeof(TagLengths), &Size, 0);
+    ok(Status == STATUS_NOT_SUPPORTED, "Status = 0x%lx\n", Status);
+}
+
+static void TestCbc(BCRYPT_ALG_HANDLE Alg)
+{
+    static const UCHAR ExpectedCbc[] =
+        {0xa1,0x84,0x8c,0x42,0xbb,0x8b,0x5e,0x1a,0x46,0xac,0xd9,0x58,0xcc,0xfe,0xc5,0x4f,
+         0x98,0x02,0x28,0x5d,0x23,0x29,0xba,0x89,0xd5,0xae,0x36,0x4f,0x63,0x11,0xd3,0x43};
+    static const UCHAR ExpectedCbcPadded[] =
+        {0xa1,0x84,0x8c,0x42,0xbb,0x8b,0x5e,0x1a,0x46,0xac,0xd9,0x58,0xcc,0xfe,0xc5,0x4f,
+         0xea,0xca,0x42,0x37,0x8f,0x62,0xd9,0xd0,0x77,0x91,0xbe,0x6e,0x8d,0x8d,0x1c,0x6a};
+    BCRYPT_KEY_HANDLE Key = NULL;
+    UCHAR IvBuffer[16], Buffer[64];
+    PUCHAR Large, LargeOut;
+    ULONG Size, i;
+    NTSTATUS Status;
+
+    Status = BCryptGenerateSymmetricKey(Alg, &Key, NULL, 0, Secret, 16, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    Size = 0;
+    memcpy(IvBuffer, Iv, sizeof(Iv));
+    Status = BCryptEncrypt(Key, Data, 32, NULL, IvBuffer, 16, NULL, 0, &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 32, "Size = %lu\n", Size);
+
+    Size = 0;
+    ZeroMemory(Buffer, sizeof(Buffer));
+    Status = BCryptEncrypt(Key, Data, 32, NULL, IvBuffer, 16, Buffer, sizeof(Buffer), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 32, "Size = %lu\n", Size);
+    ok(!memcmp(Buffer, ExpectedCbc, sizeof(ExpectedCbc)), "Wrong ciphertext\n");
+    ok(!memcmp(IvBuffer, ExpectedCbc + 16, 16), "IV was not updated\n");
+
+    /* Without padding the input must be a multiple of the block size */
+    memcpy(IvBuffer, Iv, sizeof(Iv));
+    Status = BCryptEncrypt(Key, Data, 17, NULL, IvBuffer, 16, Buffer, sizeof(Buffer), &Size, 0);
+    ok(Status == STATUS_INVALID_BUFFER_SIZE, "Status = 0x%lx\n", Status);
+
+    Size = 0;
+    memcpy(IvBuffer, Iv, sizeof(Iv));
+    Status = BCryptEncrypt(Key, Data, 17, NULL, IvBuffer, 16, NULL, 0, &Size, BCRYPT_BLOCK_PADDING);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 32, "Size = %lu\n", Size);
+
+    memcpy(IvBuffer, Iv, sizeof(Iv));
+    Status = BCryptEncrypt(Key, Data, 17, NULL, IvBuffer, 16, Buffer, 16, &Size, BCRYPT_BLOCK_PADDING);
+    ok(Status == STATUS_BUFFER_TOO_SMALL, "Status = 0x%lx\n", Status);
+
+    Size = 0;
+    memcpy(IvBuffer, Iv, sizeof(Iv));
+    ZeroMemory(Buffer, sizeof(Buffer));
+    Status = BCryptEncrypt(Key, Data, 17, NULL, IvBuffer, 16, Buffer, sizeof(Buffer), &Size, BCRYPT_BLOCK_PADDING);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 32, "Size = %lu\n", Size);
+    ok(!memcmp(Buffer, ExpectedCbcPadded, sizeof(ExpectedCbcPadded)), "Wrong ciphertext\n");
+
+    Size = 0;
+    memcpy(IvBuffer, Iv, sizeof(Iv));
+    ZeroMemory(Buffer, sizeof(Buffer));
+    Status = BCryptDecrypt(Key, (PUCHAR)ExpectedCbc, 32, NULL, IvBuffer, 16, Buffer, sizeof(Buffer), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 32, "Size = %lu\n", Size);
+    ok(!memcmp(Buffer, Data, 32), "Wrong plaintext\n");
+
+    Size = 0;
+    memcpy(IvBuffer, Iv, sizeof(Iv));
+    ZeroMemory(Buffer, sizeof(Buffer));
+    Status = BCryptDecrypt(Key, (PUCHAR)ExpectedCbcPadded, 32, NULL, IvBuffer, 16, Buffer, sizeof(Buffer), &Size, BCRYPT_BLOCK_PADDING);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 17, "Size = %lu\n", Size);
+    ok(!memcmp(Buffer, Data, 17), "Wrong plaintext\n");
+
+    /* A long run goes through the wide code paths and must round trip */
+    Large = HeapAlloc(GetProcessHeap(), 0, 4096);
+    LargeOut = HeapAlloc(GetProcessHeap(), 0, 4096);
+    if (Large && LargeOut)
+    {
+        for (i = 0; i < 4096; i++)
+            Large[i] = (UCHAR)(i * 7 + (i >> 8));
+
+        Size = 0;
+        memcpy(IvBuffer, Iv, sizeof(Iv));
+        Status = BCryptEncrypt(Key, Large, 4096, NULL, IvBuffer, 16, LargeOut, 4096, &Size, 0);
+        ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+        ok(Size == 4096, "Size = %lu\n", Size);
+
+        Size = 0;
+        memcpy(IvBuffer, Iv, sizeof(Iv));
+        Status = BCryptDecrypt(Key, LargeOut, 4096, NULL, IvBuffer, 16, LargeOut, 4096, &Size, 0);
+        ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+        ok(Size == 4096, "Size = %lu\n", Size);
+        ok(!memcmp(Large, LargeOut, 4096), "Wrong plaintext\n");
+    }
+    else
+    {
+        skip("Out of memory\n");
+    }
+    HeapFree(GetProcessHeap(), 0, Large);
+    HeapFree(GetProcessHeap(), 0, LargeOut);
+
+    Status = BCryptDestroyKey(Key);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+}
+
+static void TestEcb(BCRYPT_ALG_HANDLE Alg)
+{
+    static const UCHAR ExpectedEcb[] =
+        {0xd8,0xc9,0x57,0x58,0xe3,0x35,0x3e,0x53,0x0f,0xa5,0x2b,0xd1,0x0e,0x73,0xb9,0x86};
+    BCRYPT_KEY_HANDLE Key = NULL;
+    UCHAR Buffer[64];
+    ULONG Size;
+    NTSTATUS Status;
+
+    Status = BCryptSetProperty(Alg, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_ECB, sizeof(BCRYPT_CHAIN_MODE_ECB), 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+
+    Status = BCryptGenerateSymmetricKey(Alg, &Key, NULL, 0, Secret, 32, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    Size = 0;
+    ZeroMemory(Buffer, sizeof(Buffer));
+    Status = BCryptEncrypt(Key, Data, 16, NULL, NULL, 0, Buffer, sizeof(Buffer), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 16, "Size = %lu\n", Size);
+    ok(!memcmp(Buffer, ExpectedEcb, sizeof(ExpectedEcb)), "Wrong ciphertext\n");
+
+    Size = 0;
+    ZeroMemory(Buffer, sizeof(Buffer));
+    Status = BCryptDecrypt(Key, (PUCHAR)ExpectedEcb, 16, NULL, NULL, 0, Buffer, sizeof(Buffer), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 16, "Size = %lu\n", Size);
+    ok(!memcmp(Buffer, Data, 16), "Wrong plaintext\n");
+
+    Status = BCryptDestroyKey(Key);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+}
+
+static void TestGcm(BCRYPT_ALG_HANDLE Alg)
+{
+    static UCHAR AuthData[] =
+        {0x80,0x81,0x82,0x83,0x84,0x85,0x86,0x87,0x88,0x89,0x8a,0x8b,0x8c,0x8d,0x8e,0x8f,
+         0x90,0x91,0x92,0x93};
+    static const UCHAR ExpectedGcm[] =
+        {0xa3,0x5d,0x95,0xfd,0x52,0x2e,0xc1,0x63,0x73,0xeb,0x00,0xe8,0x55,0xc7,0x15,0x6e,
+         0xd4,0x4e,0x73,0x8c,0x38,0x81,0x90};
+    static const UCHAR ExpectedTag[] =
+        {0x23,0x7d,0x2c,0x9a,0xbd,0x71,0x6e,0x62,0xe3,0xdc,0x99,0x63,0xeb,0x53,0x76,0x4b};
+    BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO AuthInfo;
+    BCRYPT_AUTH_TAG_LENGTHS_STRUCT TagLengths;
+    BCRYPT_KEY_HANDLE Key = NULL;
+    UCHAR Tag[16], Buffer[64];
+    ULONG Size;
+    NTSTATUS Status;
+
+    Status = BCryptSetProperty(Alg, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_GCM, sizeof(BCRYPT_CHAIN_MODE_GCM), 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+
+    Size = 0;
+    ZeroMemory(&TagLengths, sizeof(TagLengths));
+    Status = BCryptGetProperty(Alg, BCRYPT_AUTH_TAG_LENGTH, (PUCHAR)&TagLengths, sizeof(TagLengths), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == sizeof(TagLengths), "Size = %lu\n", Size);
+    ok(TagLengths.dwMinLength == 12, "dwMinLength = %lu\n", TagLengths.dwMinLength);
+    ok(TagLengths.dwMaxLength == 16, "dwMaxLength = %lu\n", TagLengths.dwMaxLength);
+    ok(TagLengths.dwIncrement == 1, "dwIncrement = %lu\n", TagLengths.dwIncrement);
+
+    Status = BCryptGenerateSymmetricKey(Alg, &Key, NULL, 0, Secret, 16, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    BCRYPT_INIT_AUTH_MODE_INFO(AuthInfo);
+    AuthInfo.pbNonce = Iv;
+    AuthInfo.cbNonce = 12;
+    AuthInfo.pbAuthData = AuthData;
+    AuthInfo.cbAuthData = sizeof(AuthData);
+    AuthInfo.pbTag = Tag;
+    AuthInfo.cbTag = sizeof(Tag);
+
+    Size = 0;
+    ZeroMemory(Buffer, sizeof(Buffer));
+    ZeroMemory(Tag, sizeof(Tag));
+    Status = BCryptEncrypt(Key, Data, 23, &AuthInfo, NULL, 0, Buffer, sizeof(Buffer), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 23, "Size = %lu\n", Size);
+    ok(!memcmp(Buffer, ExpectedGcm, sizeof(ExpectedGcm)), "Wrong ciphertext\n");
+    ok(!memcmp(Tag, ExpectedTag, sizeof(ExpectedTag)), "Wrong tag\n");
+
+    Size = 0;
+    ZeroMemory(Buffer, sizeof(Buffer));
+    Status = BCryptDecrypt(Key, (PUCHAR)ExpectedGcm, 23, &AuthInfo, NULL, 0, Buffer, sizeof(Buffer), &Size, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    ok(Size == 23, "Size = %lu\n", Size);
+    ok(!memcmp(Buffer, Data, 23), "Wrong plaintext\n");
+
+    Tag[0] ^= 1;
+    Status = BCryptDecrypt(Key, (PUCHAR)ExpectedGcm, 23, &AuthInfo, NULL, 0, Buffer, sizeof(Buffer), &Size, 0);
+    ok(Status == STATUS_AUTH_TAG_MISMATCH, "Status = 0x%lx\n", Status);
+
+    Status = BCryptDestroyKey(Key);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+}
+
+START_TEST(BCryptEncrypt)
+{
+    BCRYPT_ALG_HANDLE Alg = NULL;
+    NTSTATUS Status;
+
+    Status = BCryptOpenAlgorithmProvider(&Alg, BCRYPT_AES_ALGORITHM, MS_PRIMITIVE_PROVIDER, 0);
+    if (Status == STATUS_NOT_FOUND)
+    {
+        skip("AES is not supported\n");
+        return;
+    }
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    TestProperties(Alg);
+    TestCbc(Alg);
+    TestEcb(Alg);
+    TestGcm(Alg);
+
+    Status = BCryptCloseAlgorithmProvider(Alg, 0);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%lx\n", Status);
+}
@@ -0,0 +1,10 @@
+#define STANDALONE
+#include <apitest.h>
+
+extern void func_BCryptEncrypt(void);
+
+const struct test winetest_testlist[] =
+{
+    { "BCryptEncrypt", func_BCryptEncrypt },
+    { 0, 0 }
+};
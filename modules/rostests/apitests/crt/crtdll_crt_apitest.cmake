@@ -429,7 +429,7 @@ list(APPEND SOURCE_CRTDLL
 #    memchr.c
 #    memcmp.c
 #    memcpy.c
-#    memmove.c
+    memmove.c
 #    memset.c
 #    mktime.c
 #    modf.c
@@ -458,7 +458,7 @@ list(APPEND SOURCE_CRTDLL
 #    srand.c
 #    sscanf.c
 #    strcat.c
-#    strchr.c
+    strchr.c
 #    strcmp.c
 #    strcoll.c
     strcpy.c
@@ -0,0 +1,158 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Tests for memcpy, memmove, memset and memcmp
+ */
+
+#include <apitest.h>
+
+#include <string.h>
+
+#define BUFFER_SIZE     0x1000
+
+typedef void * (__cdecl *PFN_MEMMOVE)(void *, const void *, size_t);
+typedef void * (__cdecl *PFN_MEMSET)(void *, int, size_t);
+typedef int (__cdecl *PFN_MEMCMP)(const void *, const void *, size_t);
+
+/* Called through pointers so the compiler can't use its builtins */
+static PFN_MEMMOVE volatile pmemcpy = memcpy;
+static PFN_MEMMOVE volatile pmemmove = memmove;
+static PFN_MEMSET volatile pmemset = memset;
+static PFN_MEMCMP volatile pmemcmp = memcmp;
+
+static unsigned char Buffer[BUFFER_SIZE];
+static unsigned char Expected[BUFFER_SIZE];
+static unsigned char Temp[BUFFER_SIZE];
+
+static void FillBuffers(void)
+{
+    size_t i;
+
+    for (i = 0; i < BUFFER_SIZE; i++)
+        Buffer[i] = Expected[i] = (unsigned char)(i * 7 + (i >> 8) + 1);
+}
+
+static void RefMove(unsigned char *dest, const unsigned char *src, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        Temp[i] = src[i];
+    for (i = 0; i < count; i++)
+        dest[i] = Temp[i];
+}
+
+static int Sign(int Value)
+{
+    return (Value > 0) - (Value < 0);
+}
+
+static void Test_Move(PFN_MEMMOVE pfn, const char *Name)
+{
+    size_t Size, Source, Failures = 0;
+    int Delta;
+    void *Result;
+
+    /* All sizes up to 300 bytes and then some, every source alignment,
+       overlapping in both directions and not overlapping at all */
+    for (Size = 0; Size < 1200; Size += (Size < 300) ? 1 : 61)
+    {
+        for (Source = 0; Source < 16; Source++)
+        {
+            for (Delta = -80; Delta <= 80; Delta += (Delta > -20 && Delta < 20) ? 1 : 15)
+            {
+                FillBuffers();
+                RefMove(Expected + 1024 + Source + Delta, Expected + 1024 + Source, Size);
+                Result = pfn(Buffer + 1024 + Source + Delta, Buffer + 1024 + Source, Size);
+
+                if (Result != Buffer + 1024 + Source + Delta ||
+                    memcmp(Buffer, Expected, BUFFER_SIZE) != 0)
+                {
+                    if (Failures++ < 10)
+                        ok(0, "%s failed for size %Iu, source offset %Iu, delta %d\n", Name, Size, Source, Delta);
+                }
+            }
+        }
+    }
+
+    ok(Failures == 0, "%s failed %Iu times\n", Name, Failures);
+}
+
+static void Test_memset(void)
+{
+    size_t Size, Offset, i, Failures = 0;
+    void *Result;
+
+    for (Size = 0; Size < 1200; Size += (Size < 300) ? 1 : 61)
+    {
+        for (Offset = 0; Offset < 16; Offset++)
+        {
+            FillBuffers();
+            for (i = 0; i < Size; i++)
+                Expected[1024 + Offset + i] = 0xA5;
+
+            /* Only the low byte of the value is used */
+            Result = pmemset(Buffer + 1024 + Offset, 0x3A5, Size);
+
+            if (Result != Buffer + 1024 + Offset ||
+                memcmp(Buffer, Expected, BUFFER_SIZE) != 0)
+            {
+                if (Failures++ < 10)
+                    ok(0, "memset failed for size %Iu, offset %Iu\n", Size, Offset);
+            }
+        }
+    }
+
+    ok(Failures == 0, "memset failed %Iu times\n", Failures);
+}
+
+static void Test_memcmp(void)
+{
+    size_t Size, Offset1, Offset2, Position, Failures = 0;
+    unsigned char *p1, *p2;
+
+    FillBuffers();
+
+    for (Size = 1; Size < 100; Size++)
+    {
+        for (Offset1 = 0; Offset1 < 16; Offset1++)
+        {
+            for (Offset2 = 0; Offset2 < 16; Offset2++)
+            {
+                p1 = Buffer + Offset1;
+                p2 = Buffer + 2048 + Offset2;
+                memcpy(p2, p1, Size);
+
+                if (pmemcmp(p1, p2, Size) != 0)
+                    Failures++;
+
+                /* The first difference decides, compared as unsigned */
+                Position = (Size * 5 + Offset1) % Size;
+                p2[Position] = p1[Position] ^ 0x80;
+                if (Position + 1 < Size)
+                    p2[Position + 1] = p1[Position + 1] + 1;
+                if (Sign(pmemcmp(p1, p2, Size)) != ((p1[Position] < p2[Position]) ? -1 : 1))
+                    Failures++;
+                if (Sign(pmemcmp(p2, p1, Size)) != ((p2[Position] < p1[Position]) ? -1 : 1))
+                    Failures++;
+
+                /* Bytes past the difference are not looked at */
+                if (pmemcmp(p1, p2, Position) != 0)
+                    Failures++;
+            }
+        }
+    }
+
+    ok(Failures == 0, "memcmp failed %Iu times\n", Failures);
+}
+
+START_TEST(memmove)
+{
+    Test_Move(pmemmove, "memmove");
+#ifndef TEST_CRTDLL
+    /* memcpy handles overlapping buffers in msvcrt and ntdll as well */
+    Test_Move(pmemcpy, "memcpy");
+#endif
+    Test_memset();
+    Test_memcmp();
+}
@@ -0,0 +1,86 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Benchmark for memcpy, memset and memcmp
+ */
+
+#include <apitest.h>
+
+#include <string.h>
+
+#define BENCH_MAX_SIZE  (1024 * 1024)
+#define BENCH_BYTES     (64 * 1024 * 1024)
+
+typedef void * (__cdecl *PFN_MEMMOVE)(void *, const void *, size_t);
+typedef void * (__cdecl *PFN_MEMSET)(void *, int, size_t);
+typedef int (__cdecl *PFN_MEMCMP)(const void *, const void *, size_t);
+
+/* Called through pointers so the compiler can't use its builtins */
+static PFN_MEMMOVE volatile pmemcpy = memcpy;
+static PFN_MEMSET volatile pmemset = memset;
+static PFN_MEMCMP volatile pmemcmp = memcmp;
+
+START_TEST(memmove_bench)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    unsigned char *Source, *Dest;
+    size_t Size, Iterations, i;
+    ULONG Alignment;
+    double Microseconds;
+
+    /* Takes a while and only produces numbers, so only run it on request */
+    if (!winetest_interactive)
+    {
+        skip("Set WINETEST_INTERACTIVE=1 to run the benchmark\n");
+        return;
+    }
+
+    Source = HeapAlloc(GetProcessHeap(), 0, BENCH_MAX_SIZE + 64);
+    Dest = HeapAlloc(GetProcessHeap(), 0, BENCH_MAX_SIZE + 64);
+    if (!Source || !Dest || !QueryPerformanceFrequency(&Frequency))
+    {
+        skip("Benchmark setup failed\n");
+        HeapFree(GetProcessHeap(), 0, Source);
+        HeapFree(GetProcessHeap(), 0, Dest);
+        return;
+    }
+
+    memset(Source, 0x5A, BENCH_MAX_SIZE + 64);
+
+    for (Size = 1; Size <= BENCH_MAX_SIZE; Size *= 4)
+    {
+        Iterations = BENCH_BYTES / Size;
+        if (Iterations > 1000000)
+            Iterations = 1000000;
+
+        /* Mutually aligned and misaligned buffers */
+        for (Alignment = 0; Alignment < 2; Alignment++)
+        {
+            QueryPerformanceCounter(&Start);
+            for (i = 0; i < Iterations; i++)
+                pmemcpy(Dest + Alignment * 3, Source + Alignment * 13, Size);
+            QueryPerformanceCounter(&End);
+            Microseconds = (double)(End.QuadPart - Start.QuadPart) * 1000000.0 / Frequency.QuadPart;
+            trace("memcpy  %7Iu bytes, %s: %.3f us per call\n", Size,
+                  Alignment ? "misaligned" : "aligned", Microseconds / Iterations);
+        }
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            pmemset(Dest + 1, (int)i, Size);
+        QueryPerformanceCounter(&End);
+        Microseconds = (double)(End.QuadPart - Start.QuadPart) * 1000000.0 / Frequency.QuadPart;
+        trace("memset  %7Iu bytes: %.3f us per call\n", Size, Microseconds / Iterations);
+
+        memcpy(Dest, Source, Size);
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            pmemcmp(Dest, Source, Size);
+        QueryPerformanceCounter(&End);
+        Microseconds = (double)(End.QuadPart - Start.QuadPart) * 1000000.0 / Frequency.QuadPart;
+        trace("memcmp  %7Iu bytes: %.3f us per call\n", Size, Microseconds / Iterations);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Source);
+    HeapFree(GetProcessHeap(), 0, Dest);
+}
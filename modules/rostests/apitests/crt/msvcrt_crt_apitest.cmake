@@ -1124,7 +1124,8 @@ list(APPEND SOURCE_MSVCRT
 #    memcmp.c
 #    memcpy.c
 #    memcpy_s.c memmove_s
-#    memmove.c
+    memmove.c
+    memmove_bench.c
 #    memmove_s.c
 #    memset.c
 #    mktime.c
@@ -1164,7 +1165,7 @@ list(APPEND SOURCE_MSVCRT
 #    sscanf_s.c
 #    strcat.c
 #    strcat_s.c
-#    strchr.c
+    strchr.c
 #    strcmp.c
 #    strcoll.c
     strcpy.c
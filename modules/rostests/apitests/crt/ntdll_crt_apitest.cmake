@@ -75,7 +75,7 @@ list(APPEND SOURCE_NTDLL
 #    memchr.c
 #    memcmp.c
     # memcpy == memmove
-#    memmove.c
+    memmove.c
 #    memset.c
 #    pow.c
 #    qsort.c
@@ -84,7 +84,7 @@ list(APPEND SOURCE_NTDLL
 #    sqrt.c
 #    sscanf.c
 #    strcat.c
-#    strchr.c
+    strchr.c
 #    strcmp.c
     strcpy.c
 #    strcspn.c
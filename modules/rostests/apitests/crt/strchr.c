@@ -0,0 +1,405 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Tests and benchmark for strlen, strchr, strcmp, memchr and
+ *              their wide character variants
+ */
+
+#include <apitest.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define FUZZ_ITERATIONS 100000
+#define BENCH_MAX_SIZE  (64 * 1024)
+#define BENCH_CHARS     (32 * 1024 * 1024)
+
+typedef size_t (__cdecl *PFN_STRLEN)(const char *);
+typedef size_t (__cdecl *PFN_WCSLEN)(const wchar_t *);
+typedef char * (__cdecl *PFN_STRCHR)(const char *, int);
+typedef wchar_t * (__cdecl *PFN_WCSCHR)(const wchar_t *, wchar_t);
+typedef int (__cdecl *PFN_STRCMP)(const char *, const char *);
+typedef int (__cdecl *PFN_WCSCMP)(const wchar_t *, const wchar_t *);
+typedef void * (__cdecl *PFN_MEMCHR)(const void *, int, size_t);
+
+/* Called through pointers so the compiler can't use its builtins */
+static PFN_STRLEN volatile pstrlen = strlen;
+static PFN_WCSLEN volatile pwcslen = wcslen;
+static PFN_STRCHR volatile pstrchr = strchr;
+static PFN_WCSCHR volatile pwcschr = wcschr;
+static PFN_STRCMP volatile pstrcmp = strcmp;
+static PFN_WCSCMP volatile pwcscmp = wcscmp;
+static PFN_MEMCHR volatile pmemchr = memchr;
+
+static ULONG Seed = 0x12345678;
+
+/* The last page of each buffer is followed by an inaccessible one */
+static unsigned char *Page1, *Page2;
+static SYSTEM_INFO SystemInfo;
+
+static ULONG Random(ULONG Range)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return (Seed >> 8) % Range;
+}
+
+static int Sign(int Value)
+{
+    return (Value > 0) - (Value < 0);
+}
+
+static size_t __cdecl RefStrLen(const char *Str)
+{
+    size_t Length = 0;
+
+    while (Str[Length])
+        Length++;
+    return Length;
+}
+
+static size_t __cdecl RefWcsLen(const wchar_t *Str)
+{
+    size_t Length = 0;
+
+    while (Str[Length])
+        Length++;
+    return Length;
+}
+
+static char * __cdecl RefStrChr(const char *Str, int c)
+{
+    for (;; Str++)
+    {
+        if (*Str == (char)c)
+            return (char *)Str;
+        if (!*Str)
+            return NULL;
+    }
+}
+
+static wchar_t * __cdecl RefWcsChr(const wchar_t *Str, wchar_t c)
+{
+    for (;; Str++)
+    {
+        if (*Str == c)
+            return (wchar_t *)Str;
+        if (!*Str)
+            return NULL;
+    }
+}
+
+static int __cdecl RefStrCmp(const char *s1, const char *s2)
+{
+    while (*s1 && *s1 == *s2)
+    {
+        s1++;
+        s2++;
+    }
+    return Sign((unsigned char)*s1 - (unsigned char)*s2);
+}
+
+static int __cdecl RefWcsCmp(const wchar_t *s1, const wchar_t *s2)
+{
+    while (*s1 && *s1 == *s2)
+    {
+        s1++;
+        s2++;
+    }
+    return (*s1 > *s2) - (*s1 < *s2);
+}
+
+static void * __cdecl RefMemChr(const void *Buffer, int c, size_t Count)
+{
+    const unsigned char *p = Buffer;
+
+    for (; Count; Count--, p++)
+    {
+        if (*p == (unsigned char)c)
+            return (void *)p;
+    }
+    return NULL;
+}
+
+static unsigned char *AllocGuarded(void)
+{
+    unsigned char *Buffer;
+    DWORD OldProtect;
+
+    Buffer = VirtualAlloc(NULL, 3 * SystemInfo.dwPageSize, MEM_COMMIT, PAGE_READWRITE);
+    if (!Buffer)
+        return NULL;
+
+    if (!VirtualProtect(Buffer + 2 * SystemInfo.dwPageSize, SystemInfo.dwPageSize,
+                        PAGE_NOACCESS, &OldProtect))
+    {
+        VirtualFree(Buffer, 0, MEM_RELEASE);
+        return NULL;
+    }
+
+    return Buffer;
+}
+
+/* A string that starts near the beginning or ends right before the guard page */
+static char *PlaceString(unsigned char *Page, size_t Bytes)
+{
+    SIZE_T Space = 2 * SystemInfo.dwPageSize;
+
+    if (Random(2))
+        return (char *)Page + Space - Bytes - Random(3);
+    return (char *)Page + Random(64);
+}
+
+static void RandomString(char *Str, size_t Length)
+{
+    size_t i;
+
+    /* Few distinct characters make matches and long common prefixes likely */
+    for (i = 0; i < Length; i++)
+        Str[i] = (char)(1 + Random(Random(2) ? 4 : 255));
+    Str[Length] = 0;
+}
+
+static void RandomWideString(wchar_t *Str, size_t Length)
+{
+    size_t i;
+
+    for (i = 0; i < Length; i++)
+        Str[i] = (wchar_t)(1 + Random(Random(2) ? 4 : 0xFFFF));
+    Str[Length] = 0;
+}
+
+static void Test_Ansi(void)
+{
+    size_t Iteration, Length, Count, Position, Failures = 0;
+    char *s1, *s2;
+    int c;
+
+    for (Iteration = 0; Iteration < FUZZ_ITERATIONS; Iteration++)
+    {
+        Length = Random((Iteration & 1) ? 40 : 300);
+
+        s1 = PlaceString(Page1, Length + 1);
+        RandomString(s1, Length);
+
+        if (pstrlen(s1) != RefStrLen(s1))
+            Failures++;
+
+        c = (unsigned char)s1[Random((ULONG)Length + 1)];
+        if (Random(4) == 0)
+            c = Random(256);
+        /* Only the low byte of the character is used */
+        if (Random(4) == 0)
+            c |= 0x100;
+        if (pstrchr(s1, c) != RefStrChr(s1, c))
+            Failures++;
+
+        Count = Random((ULONG)Length + 1);
+        if (pmemchr(s1, c, Count) != RefMemChr(s1, c, Count))
+            Failures++;
+
+        s2 = PlaceString(Page2, Length + 1);
+        memcpy(s2, s1, Length + 1);
+        if (Length && Random(3))
+        {
+            Position = Random((ULONG)Length);
+            s2[Position] = Random(4) ? (char)Random(256) : 0;
+        }
+
+        if (Sign(pstrcmp(s1, s2)) != RefStrCmp(s1, s2) ||
+            Sign(pstrcmp(s2, s1)) != RefStrCmp(s2, s1) ||
+            pstrcmp(s1, s1) != 0)
+        {
+            Failures++;
+        }
+    }
+
+    ok(Failures == 0, "%Iu mismatches in narrow string functions\n", Failures);
+
+    /* memchr must not look past the buffer, even without a match */
+    s1 = (char *)Page1 + 2 * SystemInfo.dwPageSize - 17;
+    memset(s1, 'a', 17);
+    ok(pmemchr(s1, 'b', 17) == NULL, "memchr found a byte past the buffer\n");
+    s1[16] = 'b';
+    ok(pmemchr(s1, 'b', 17) == s1 + 16, "memchr missed the last byte\n");
+}
+
+static void Test_Wide(void)
+{
+    size_t Iteration, Length, Position, Failures = 0;
+    wchar_t *s1, *s2;
+    wchar_t c;
+
+    for (Iteration = 0; Iteration < FUZZ_ITERATIONS; Iteration++)
+    {
+        Length = Random((Iteration & 1) ? 20 : 150);
+
+        /* Misaligned wide strings are legal, if slow */
+        s1 = (wchar_t *)(PlaceString(Page1, (Length + 1) * sizeof(wchar_t) + 1) +
+                         (Random(4) == 0));
+        RandomWideString(s1, Length);
+
+        if (pwcslen(s1) != RefWcsLen(s1))
+            Failures++;
+
+        c = s1[Random((ULONG)Length + 1)];
+        if (Random(4) == 0)
+            c = (wchar_t)Random(0x10000);
+        if (pwcschr(s1, c) != RefWcsChr(s1, c))
+            Failures++;
+
+        s2 = (wchar_t *)(PlaceString(Page2, (Length + 1) * sizeof(wchar_t) + 1) +
+                         (Random(4) == 0));
+        memcpy(s2, s1, (Length + 1) * sizeof(wchar_t));
+        if (Length && Random(3))
+        {
+            Position = Random((ULONG)Length);
+            s2[Position] = Random(4) ? (wchar_t)Random(0x10000) : 0;
+        }
+
+        if (Sign(pwcscmp(s1, s2)) != RefWcsCmp(s1, s2) ||
+            Sign(pwcscmp(s2, s1)) != RefWcsCmp(s2, s1) ||
+            pwcscmp(s1, s1) != 0)
+        {
+            Failures++;
+        }
+    }
+
+    ok(Failures == 0, "%Iu mismatches in wide string functions\n", Failures);
+}
+
+static double Elapsed(LARGE_INTEGER *Start, LARGE_INTEGER *Frequency)
+{
+    LARGE_INTEGER End;
+
+    QueryPerformanceCounter(&End);
+    return (double)(End.QuadPart - Start->QuadPart) * 1000000.0 / Frequency->QuadPart;
+}
+
+static void Benchmark(void)
+{
+    LARGE_INTEGER Frequency, Start;
+    char *Str, *Str2;
+    wchar_t *WideStr;
+    size_t Size, Iterations, i;
+    double Crt, Ref;
+
+    Str = HeapAlloc(GetProcessHeap(), 0, BENCH_MAX_SIZE + 1);
+    Str2 = HeapAlloc(GetProcessHeap(), 0, BENCH_MAX_SIZE + 1);
+    WideStr = HeapAlloc(GetProcessHeap(), 0, (BENCH_MAX_SIZE + 1) * sizeof(wchar_t));
+    if (!Str || !Str2 || !WideStr || !QueryPerformanceFrequency(&Frequency))
+    {
+        skip("Benchmark setup failed\n");
+        HeapFree(GetProcessHeap(), 0, Str);
+        HeapFree(GetProcessHeap(), 0, Str2);
+        HeapFree(GetProcessHeap(), 0, WideStr);
+        return;
+    }
+
+    for (Size = 4; Size <= BENCH_MAX_SIZE; Size *= 4)
+    {
+        memset(Str, 'a', Size);
+        Str[Size] = 0;
+        memcpy(Str2, Str, Size + 1);
+        for (i = 0; i < Size; i++)
+            WideStr[i] = L'a';
+        WideStr[Size] = 0;
+
+        Iterations = BENCH_CHARS / Size;
+        if (Iterations > 1000000)
+            Iterations = 1000000;
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            pstrlen(Str);
+        Crt = Elapsed(&Start, &Frequency);
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            RefStrLen(Str);
+        Ref = Elapsed(&Start, &Frequency);
+        trace("strlen  %6Iu chars: %.3f us per call, scalar %.3f us\n", Size,
+              Crt / Iterations, Ref / Iterations);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            pwcslen(WideStr);
+        Crt = Elapsed(&Start, &Frequency);
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            RefWcsLen(WideStr);
+        Ref = Elapsed(&Start, &Frequency);
+        trace("wcslen  %6Iu chars: %.3f us per call, scalar %.3f us\n", Size,
+              Crt / Iterations, Ref / Iterations);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            pstrchr(Str, 'b');
+        Crt = Elapsed(&Start, &Frequency);
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            RefStrChr(Str, 'b');
+        Ref = Elapsed(&Start, &Frequency);
+        trace("strchr  %6Iu chars: %.3f us per call, scalar %.3f us\n", Size,
+              Crt / Iterations, Ref / Iterations);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            pwcschr(WideStr, L'b');
+        Crt = Elapsed(&Start, &Frequency);
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            RefWcsChr(WideStr, L'b');
+        Ref = Elapsed(&Start, &Frequency);
+        trace("wcschr  %6Iu chars: %.3f us per call, scalar %.3f us\n", Size,
+              Crt / Iterations, Ref / Iterations);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            pstrcmp(Str, Str2);
+        Crt = Elapsed(&Start, &Frequency);
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            RefStrCmp(Str, Str2);
+        Ref = Elapsed(&Start, &Frequency);
+        trace("strcmp  %6Iu chars: %.3f us per call, scalar %.3f us\n", Size,
+              Crt / Iterations, Ref / Iterations);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            pmemchr(Str, 'b', Size);
+        Crt = Elapsed(&Start, &Frequency);
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            RefMemChr(Str, 'b', Size);
+        Ref = Elapsed(&Start, &Frequency);
+        trace("memchr  %6Iu bytes: %.3f us per call, scalar %.3f us\n", Size,
+              Crt / Iterations, Ref / Iterations);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Str);
+    HeapFree(GetProcessHeap(), 0, Str2);
+    HeapFree(GetProcessHeap(), 0, WideStr);
+}
+
+START_TEST(strchr)
+{
+    GetSystemInfo(&SystemInfo);
+
+    Page1 = AllocGuarded();
+    Page2 = AllocGuarded();
+    if (!Page1 || !Page2)
+    {
+        skip("Failed to allocate the guarded buffers\n");
+    }
+    else
+    {
+        Test_Ansi();
+        Test_Wide();
+    }
+
+    if (Page1)
+        VirtualFree(Page1, 0, MEM_RELEASE);
+    if (Page2)
+        VirtualFree(Page2, 0, MEM_RELEASE);
+
+    Benchmark();
+}
@@ -4,6 +4,7 @@
 #include <apitest.h>
 
 #if defined(TEST_MSVCRT)
+extern void func_memmove_bench(void);
 extern void func__vscprintf(void);
 extern void func__vscwprintf(void);
 #endif
@@ -17,7 +18,9 @@ extern void func__snwprintf(void);
 extern void func__vsnprintf(void);
 extern void func__vsnwprintf(void);
 extern void func_mbstowcs(void);
+extern void func_memmove(void);
 extern void func_sprintf(void);
+extern void func_strchr(void);
 extern void func_strcpy(void);
 extern void func_strlen(void);
 extern void func_strnlen(void);
@@ -35,9 +38,11 @@ const struct test winetest_testlist[] =
     { "_vsnprintf", func__vsnprintf },
     { "_vsnwprintf", func__vsnwprintf },
     { "mbstowcs", func_mbstowcs },
+    { "memmove", func_memmove },
     { "_snprintf", func__snprintf },
     { "_snwprintf", func__snwprintf },
     { "sprintf", func_sprintf },
+    { "strchr", func_strchr },
     { "strcpy", func_strcpy },
     { "strlen", func_strlen },
     { "strtoul", func_strtoul },
@@ -54,6 +59,7 @@ const struct test winetest_testlist[] =
 #if defined(_M_IX86)
     { "__getmainargs", func___getmainargs },
 #endif
+    { "memmove_bench", func_memmove_bench },
     { "_vscprintf", func__vscprintf },
     { "_vscwprintf", func__vscwprintf },
 
@@ -0,0 +1,166 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Longest prefix match tests for CreateIpForwardEntry
+ */
+
+#include <apitest.h>
+
+#define WIN32_NO_STATUS
+#include <winsock2.h>
+#include <iphlpapi.h>
+
+/* Nested prefixes inside 127.0.0.0/8, so they only ever lead to the loopback */
+#define NET_8       0x7F000000  /* 127.0.0.0/8 */
+#define NET_16      0x7F4D0000  /* 127.77.0.0/16 */
+#define NET_24      0x7F4D0100  /* 127.77.1.0/24 */
+
+static MIB_IPFORWARDROW AddedRoutes[3];
+static ULONG AddedCount;
+
+static BOOL GetLoopbackIndex(PDWORD Index)
+{
+    PMIB_IPADDRTABLE Table;
+    ULONG Size = 0, i;
+    BOOL Found = FALSE;
+
+    if (GetIpAddrTable(NULL, &Size, FALSE) != ERROR_INSUFFICIENT_BUFFER)
+        return FALSE;
+
+    Table = HeapAlloc(GetProcessHeap(), 0, Size);
+    if (!Table)
+        return FALSE;
+
+    if (GetIpAddrTable(Table, &Size, FALSE) == NO_ERROR)
+    {
+        for (i = 0; i < Table->dwNumEntries; i++)
+        {
+            if (Table->table[i].dwAddr == htonl(INADDR_LOOPBACK))
+            {
+                *Index = Table->table[i].dwIndex;
+                Found = TRUE;
+                break;
+            }
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, Table);
+    return Found;
+}
+
+static BOOL RouteExists(ULONG Network, ULONG Mask)
+{
+    PMIB_IPFORWARDTABLE Table;
+    ULONG Size = 0, i;
+    BOOL Found = FALSE;
+
+    if (GetIpForwardTable(NULL, &Size, FALSE) != ERROR_INSUFFICIENT_BUFFER)
+        return FALSE;
+
+    Table = HeapAlloc(GetProcessHeap(), 0, Size);
+    if (!Table)
+        return FALSE;
+
+    if (GetIpForwardTable(Table, &Size, FALSE) == NO_ERROR)
+    {
+        for (i = 0; i < Table->dwNumEntries; i++)
+        {
+            if (Table->table[i].dwForwardDest == htonl(Network) &&
+                Table->table[i].dwForwardMask == htonl(Mask))
+            {
+                Found = TRUE;
+                break;
+            }
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, Table);
+    return Found;
+}
+
+static BOOL AddRoute(DWORD Index, ULONG Network, ULONG Mask)
+{
+    MIB_IPFORWARDROW Route;
+    DWORD Error;
+
+    ZeroMemory(&Route, sizeof(Route));
+    Route.dwForwardDest = htonl(Network);
+    Route.dwForwardMask = htonl(Mask);
+    Route.dwForwardNextHop = htonl(INADDR_LOOPBACK);
+    Route.dwForwardIfIndex = Index;
+    Route.dwForwardType = MIB_IPROUTE_TYPE_DIRECT;
+    Route.dwForwardProto = MIB_IPPROTO_NETMGMT;
+    Route.dwForwardMetric1 = 1;
+
+    Error = CreateIpForwardEntry(&Route);
+    ok(Error == NO_ERROR, "CreateIpForwardEntry(0x%08lx/0x%08lx) failed with %lu\n", Network, Mask, Error);
+    if (Error != NO_ERROR)
+        return FALSE;
+
+    AddedRoutes[AddedCount++] = Route;
+    return TRUE;
+}
+
+static VOID DeleteRoutes(VOID)
+{
+    DWORD Error;
+
+    while (AddedCount > 0)
+    {
+        AddedCount--;
+        Error = DeleteIpForwardEntry(&AddedRoutes[AddedCount]);
+        ok(Error == NO_ERROR, "DeleteIpForwardEntry(0x%08lx) failed with %lu\n",
+           ntohl(AddedRoutes[AddedCount].dwForwardDest), Error);
+    }
+}
+
+static VOID CheckBestRoute(ULONG Destination, ULONG Network, ULONG Mask, int Line)
+{
+    MIB_IPFORWARDROW Best;
+    DWORD Error;
+
+    ZeroMemory(&Best, sizeof(Best));
+    Error = GetBestRoute(htonl(Destination), 0, &Best);
+    ok_(__FILE__, Line)(Error == NO_ERROR, "GetBestRoute(0x%08lx) failed with %lu\n", Destination, Error);
+    ok_(__FILE__, Line)(Best.dwForwardDest == htonl(Network) && Best.dwForwardMask == htonl(Mask),
+                        "GetBestRoute(0x%08lx) picked 0x%08lx/0x%08lx, expected 0x%08lx/0x%08lx\n",
+                        Destination, ntohl(Best.dwForwardDest), ntohl(Best.dwForwardMask), Network, Mask);
+}
+#define CheckBestRoute(Destination, Network, Mask) CheckBestRoute(Destination, Network, Mask, __LINE__)
+
+START_TEST(CreateIpForwardEntry)
+{
+    DWORD Index;
+
+    if (!GetLoopbackIndex(&Index))
+    {
+        skip("No loopback interface\n");
+        return;
+    }
+
+    /* The stack normally has the /8 already, it must stay when we're done */
+    if (!RouteExists(NET_8, 0xFF000000) && !AddRoute(Index, NET_8, 0xFF000000))
+        goto Cleanup;
+    if (!AddRoute(Index, NET_24, 0xFFFFFF00))
+        goto Cleanup;
+    if (!AddRoute(Index, NET_16, 0xFFFF0000))
+        goto Cleanup;
+
+    CheckBestRoute(NET_24 + 5, NET_24, 0xFFFFFF00);
+    CheckBestRoute(NET_16 + 0x0205, NET_16, 0xFFFF0000);
+    CheckBestRoute(NET_8 + 0x4E0001, NET_8, 0xFF000000);
+
+    /* Adding a route twice must fail */
+    ok(CreateIpForwardEntry(&AddedRoutes[AddedCount - 1]) != NO_ERROR, "Duplicate route was added\n");
+
+    /* Removing the middle prefix leaves both others in place */
+    ok(DeleteIpForwardEntry(&AddedRoutes[--AddedCount]) == NO_ERROR, "DeleteIpForwardEntry failed\n");
+    ok(!RouteExists(NET_16, 0xFFFF0000), "/16 route still present\n");
+    CheckBestRoute(NET_24 + 5, NET_24, 0xFFFFFF00);
+    CheckBestRoute(NET_16 + 0x0205, NET_8, 0xFF000000);
+
+Cleanup:
+    DeleteRoutes();
+    ok(!RouteExists(NET_24, 0xFFFFFF00), "/24 route left behind\n");
+    ok(!RouteExists(NET_16, 0xFFFF0000), "/16 route left behind\n");
+}
@@ -3,6 +3,7 @@
 #define STANDALONE
 #include <apitest.h>
 
+extern void func_CreateIpForwardEntry(void);
 extern void func_GetExtendedTcpTable(void);
 extern void func_GetExtendedUdpTable(void);
 extern void func_GetInterfaceName(void);
@@ -14,6 +15,7 @@ extern void func_SendARP(void);
 
 const struct test winetest_testlist[] =
 {
+    { "CreateIpForwardEntry",       func_CreateIpForwardEntry },
     { "GetExtendedTcpTable",        func_GetExtendedTcpTable },
     { "GetExtendedUdpTable",        func_GetExtendedUdpTable },
     { "GetInterfaceName",           func_GetInterfaceName },
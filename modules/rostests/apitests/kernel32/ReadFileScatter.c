@@ -0,0 +1,289 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for ReadFileScatter and WriteFileGather
+ */
+
+#include "precomp.h"
+
+#define CHUNK_PAGES 64
+#define FILE_CHUNKS 64
+
+static SYSTEM_INFO SystemInfo;
+static WCHAR TestFileName[MAX_PATH];
+static PUCHAR Pages;
+static FILE_SEGMENT_ELEMENT Segments[CHUNK_PAGES + 1];
+
+/* Point the segments at every other page, backwards, so they are never contiguous */
+static
+VOID
+InitSegments(VOID)
+{
+    ULONG i;
+
+    for (i = 0; i < CHUNK_PAGES; i++)
+    {
+        Segments[i].Alignment = (ULONG_PTR)(Pages + (2 * (CHUNK_PAGES - 1 - i)) * SystemInfo.dwPageSize);
+    }
+    Segments[CHUNK_PAGES].Alignment = 0;
+}
+
+static
+VOID
+FillPages(
+    _In_ ULONG Chunk)
+{
+    ULONG i;
+
+    for (i = 0; i < CHUNK_PAGES; i++)
+    {
+        memset((PVOID)(ULONG_PTR)Segments[i].Alignment, (Chunk * CHUNK_PAGES + i) & 0xFF, SystemInfo.dwPageSize);
+    }
+}
+
+static
+BOOLEAN
+CheckPages(
+    _In_ ULONG Chunk)
+{
+    PUCHAR Page;
+    ULONG i, j;
+
+    for (i = 0; i < CHUNK_PAGES; i++)
+    {
+        Page = (PUCHAR)(ULONG_PTR)Segments[i].Alignment;
+        for (j = 0; j < SystemInfo.dwPageSize; j++)
+        {
+            if (Page[j] != ((Chunk * CHUNK_PAGES + i) & 0xFF))
+                return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static
+BOOL
+WaitForTransfer(
+    _In_ HANDLE hFile,
+    _In_ LPOVERLAPPED Overlapped,
+    _In_ BOOL Result,
+    _Out_ LPDWORD Transferred)
+{
+    if (!Result && GetLastError() != ERROR_IO_PENDING)
+    {
+        *Transferred = 0;
+        return FALSE;
+    }
+
+    return GetOverlappedResult(hFile, Overlapped, Transferred, TRUE);
+}
+
+static
+VOID
+TestParameters(VOID)
+{
+    OVERLAPPED Overlapped = { 0 };
+    FILE_SEGMENT_ELEMENT Unaligned[2];
+    HANDLE hFile;
+    BOOL Ret;
+
+    /* The cached path is not supported */
+    hFile = CreateFileW(TestFileName,
+                        GENERIC_READ | GENERIC_WRITE,
+                        0,
+                        NULL,
+                        OPEN_EXISTING,
+                        FILE_FLAG_OVERLAPPED,
+                        NULL);
+    ok(hFile != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+
+    SetLastError(0xdeadbeef);
+    Ret = ReadFileScatter(hFile, Segments, SystemInfo.dwPageSize, NULL, &Overlapped);
+    ok(!Ret, "ReadFileScatter succeeded on a cached handle\n");
+    ok_err(ERROR_INVALID_PARAMETER);
+    CloseHandle(hFile);
+
+    hFile = CreateFileW(TestFileName,
+                        GENERIC_READ | GENERIC_WRITE,
+                        0,
+                        NULL,
+                        OPEN_EXISTING,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING,
+                        NULL);
+    ok(hFile != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+
+    /* Segments have to be page aligned */
+    Unaligned[0].Alignment = (ULONG_PTR)(Pages + 512);
+    Unaligned[1].Alignment = 0;
+    SetLastError(0xdeadbeef);
+    Ret = ReadFileScatter(hFile, Unaligned, SystemInfo.dwPageSize, NULL, &Overlapped);
+    ok(!Ret, "ReadFileScatter succeeded with an unaligned segment\n");
+    ok_err(ERROR_INVALID_PARAMETER);
+
+    /* Lengths have to be sector multiples */
+    SetLastError(0xdeadbeef);
+    Ret = WriteFileGather(hFile, Segments, 1, NULL, &Overlapped);
+    ok(!Ret, "WriteFileGather succeeded with a partial sector\n");
+    ok_err(ERROR_INVALID_PARAMETER);
+
+    CloseHandle(hFile);
+}
+
+static
+ULONG
+MegabytesPerSecond(
+    _In_ LARGE_INTEGER Start,
+    _In_ LARGE_INTEGER End,
+    _In_ LARGE_INTEGER Frequency)
+{
+    ULONGLONG Bytes = (ULONGLONG)FILE_CHUNKS * CHUNK_PAGES * SystemInfo.dwPageSize;
+    LONGLONG Ticks = max(End.QuadPart - Start.QuadPart, 1);
+
+    return (ULONG)(Bytes * Frequency.QuadPart / Ticks / (1024 * 1024));
+}
+
+/* Read the whole file in chunks, either scattered or into one contiguous buffer */
+static
+VOID
+BenchmarkReads(
+    _In_ HANDLE hFile,
+    _In_ LPOVERLAPPED Overlapped,
+    _In_ BOOLEAN Scatter)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    ULONGLONG Offset;
+    ULONG ChunkSize = CHUNK_PAGES * SystemInfo.dwPageSize;
+    ULONG Chunk;
+    DWORD Transferred;
+    BOOL Ret;
+
+    QueryPerformanceFrequency(&Frequency);
+
+    QueryPerformanceCounter(&Start);
+    for (Chunk = 0; Chunk < FILE_CHUNKS; Chunk++)
+    {
+        Offset = (ULONGLONG)Chunk * ChunkSize;
+        Overlapped->Offset = (DWORD)Offset;
+        Overlapped->OffsetHigh = (DWORD)(Offset >> 32);
+
+        if (Scatter)
+            Ret = ReadFileScatter(hFile, Segments, ChunkSize, NULL, Overlapped);
+        else
+            Ret = ReadFile(hFile, Pages, ChunkSize, NULL, Overlapped);
+        Ret = WaitForTransfer(hFile, Overlapped, Ret, &Transferred);
+        if (!Ret || Transferred != ChunkSize)
+        {
+            ok(0, "Read failed on chunk %lu: %lu, %lu bytes\n", Chunk, GetLastError(), Transferred);
+            return;
+        }
+    }
+    QueryPerformanceCounter(&End);
+
+    trace("%s: %lu MB/s\n", Scatter ? "ReadFileScatter" : "ReadFile",
+          MegabytesPerSecond(Start, End, Frequency));
+}
+
+static
+VOID
+TestTransfer(VOID)
+{
+    OVERLAPPED Overlapped = { 0 };
+    ULONGLONG Offset;
+    ULONG ChunkSize = CHUNK_PAGES * SystemInfo.dwPageSize;
+    ULONG Chunk, Errors = 0;
+    DWORD Transferred;
+    HANDLE hFile;
+    BOOL Ret;
+
+    hFile = CreateFileW(TestFileName,
+                        GENERIC_READ | GENERIC_WRITE,
+                        0,
+                        NULL,
+                        CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING,
+                        NULL);
+    ok(hFile != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+
+    Overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    /* Write the file out with a distinct pattern per page */
+    for (Chunk = 0; Chunk < FILE_CHUNKS; Chunk++)
+    {
+        FillPages(Chunk);
+        Offset = (ULONGLONG)Chunk * ChunkSize;
+        Overlapped.Offset = (DWORD)Offset;
+        Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+
+        Ret = WriteFileGather(hFile, Segments, ChunkSize, NULL, &Overlapped);
+        Ret = WaitForTransfer(hFile, &Overlapped, Ret, &Transferred);
+        if (!Ret || Transferred != ChunkSize)
+        {
+            ok(0, "WriteFileGather failed on chunk %lu: %lu, %lu bytes\n", Chunk, GetLastError(), Transferred);
+            goto Cleanup;
+        }
+    }
+
+    /* Read it back into the scattered pages */
+    for (Chunk = 0; Chunk < FILE_CHUNKS; Chunk++)
+    {
+        ZeroMemory(Pages, 2 * CHUNK_PAGES * SystemInfo.dwPageSize);
+        Offset = (ULONGLONG)Chunk * ChunkSize;
+        Overlapped.Offset = (DWORD)Offset;
+        Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+
+        Ret = ReadFileScatter(hFile, Segments, ChunkSize, NULL, &Overlapped);
+        Ret = WaitForTransfer(hFile, &Overlapped, Ret, &Transferred);
+        if (!Ret || Transferred != ChunkSize)
+        {
+            ok(0, "ReadFileScatter failed on chunk %lu: %lu, %lu bytes\n", Chunk, GetLastError(), Transferred);
+            goto Cleanup;
+        }
+        if (!CheckPages(Chunk))
+            Errors++;
+    }
+    ok_long(Errors, 0);
+
+    /* Compare with plain reads of the same size into a contiguous buffer */
+    BenchmarkReads(hFile, &Overlapped, TRUE);
+    BenchmarkReads(hFile, &Overlapped, FALSE);
+
+Cleanup:
+    CloseHandle(Overlapped.hEvent);
+    CloseHandle(hFile);
+}
+
+START_TEST(ReadFileScatter)
+{
+    WCHAR TempPath[MAX_PATH];
+
+    GetSystemInfo(&SystemInfo);
+
+    if (!GetTempPathW(ARRAYSIZE(TempPath), TempPath) ||
+        !GetTempFileNameW(TempPath, L"rfs", 0, TestFileName))
+    {
+        skip("No temporary file available\n");
+        return;
+    }
+
+    Pages = VirtualAlloc(NULL, 2 * CHUNK_PAGES * SystemInfo.dwPageSize, MEM_COMMIT, PAGE_READWRITE);
+    ok(Pages != NULL, "VirtualAlloc failed with %lu\n", GetLastError());
+    if (!Pages)
+    {
+        DeleteFileW(TestFileName);
+        return;
+    }
+    InitSegments();
+
+    TestTransfer();
+    TestParameters();
+
+    VirtualFree(Pages, 0, MEM_RELEASE);
+    DeleteFileW(TestFileName);
+}
@@ -0,0 +1,127 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test for LdrGetProcedureAddress and LdrGetDllHandle
+ */
+
+#include "precomp.h"
+
+static
+VOID
+TestExports(
+    _In_ PCWSTR DllName)
+{
+    UNICODE_STRING DllString;
+    ANSI_STRING ProcName;
+    PVOID DllBase;
+    PIMAGE_EXPORT_DIRECTORY ExportDir;
+    PULONG NameTable;
+    PUSHORT OrdinalTable;
+    PVOID ByName, ByOrdinal;
+    ULONG Size, i, Mismatches = 0;
+    NTSTATUS Status;
+
+    RtlInitUnicodeString(&DllString, DllName);
+    Status = LdrGetDllHandle(NULL, NULL, &DllString, &DllBase);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    ExportDir = RtlImageDirectoryEntryToData(DllBase,
+                                             TRUE,
+                                             IMAGE_DIRECTORY_ENTRY_EXPORT,
+                                             &Size);
+    ok(ExportDir != NULL, "No export directory in %S\n", DllName);
+    if (!ExportDir)
+        return;
+
+    NameTable = (PULONG)((ULONG_PTR)DllBase + ExportDir->AddressOfNames);
+    OrdinalTable = (PUSHORT)((ULONG_PTR)DllBase + ExportDir->AddressOfNameOrdinals);
+
+    /* Every exported name must resolve to the same address as its ordinal */
+    for (i = 0; i < ExportDir->NumberOfNames; i++)
+    {
+        RtlInitAnsiString(&ProcName, (PCSTR)((ULONG_PTR)DllBase + NameTable[i]));
+
+        ByName = NULL;
+        Status = LdrGetProcedureAddress(DllBase, &ProcName, 0, &ByName);
+        if (!NT_SUCCESS(Status))
+        {
+            ok(0, "%S!%s: Status 0x%lx\n", DllName, ProcName.Buffer, Status);
+            Mismatches++;
+            continue;
+        }
+
+        ByOrdinal = NULL;
+        Status = LdrGetProcedureAddress(DllBase,
+                                        NULL,
+                                        ExportDir->Base + OrdinalTable[i],
+                                        &ByOrdinal);
+        if (!NT_SUCCESS(Status) || ByName != ByOrdinal)
+        {
+            ok(0, "%S!%s: %p by name, %p by ordinal\n", DllName, ProcName.Buffer, ByName, ByOrdinal);
+            Mismatches++;
+        }
+    }
+    ok(Mismatches == 0, "%lu of %lu names in %S failed\n", Mismatches, ExportDir->NumberOfNames, DllName);
+
+    /* Names that aren't exported, including near misses */
+    RtlInitAnsiString(&ProcName, "ThisFunctionDoesNotExist");
+    Status = LdrGetProcedureAddress(DllBase, &ProcName, 0, &ByName);
+    ok_ntstatus(Status, STATUS_PROCEDURE_NOT_FOUND);
+
+    if (ExportDir->NumberOfNames)
+    {
+        CHAR Buffer[256];
+
+        StringCbPrintfA(Buffer, sizeof(Buffer), "%sX", (PCSTR)((ULONG_PTR)DllBase + NameTable[0]));
+        RtlInitAnsiString(&ProcName, Buffer);
+        Status = LdrGetProcedureAddress(DllBase, &ProcName, 0, &ByName);
+        ok_ntstatus(Status, STATUS_PROCEDURE_NOT_FOUND);
+    }
+}
+
+static
+VOID
+TestDllHandle(VOID)
+{
+    static const PCWSTR Names[] =
+    {
+        L"ntdll.dll",
+        L"NTDLL.DLL",
+        L"NtDll.Dll",
+        L"ntdll",
+    };
+    UNICODE_STRING DllString;
+    PVOID DllBase, Expected;
+    NTSTATUS Status;
+    ULONG i;
+
+    RtlInitUnicodeString(&DllString, L"ntdll.dll");
+    Status = LdrGetDllHandle(NULL, NULL, &DllString, &Expected);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+
+    /* The loaded module index is case insensitive over the whole name */
+    for (i = 0; i < RTL_NUMBER_OF(Names); i++)
+    {
+        DllBase = NULL;
+        RtlInitUnicodeString(&DllString, Names[i]);
+        Status = LdrGetDllHandle(NULL, NULL, &DllString, &DllBase);
+        ok_ntstatus(Status, STATUS_SUCCESS);
+        ok(DllBase == Expected, "%S: %p, expected %p\n", Names[i], DllBase, Expected);
+    }
+
+    /* Same first letter, different name */
+    DllBase = NULL;
+    RtlInitUnicodeString(&DllString, L"ntdlx.dll");
+    Status = LdrGetDllHandle(NULL, NULL, &DllString, &DllBase);
+    ok_ntstatus(Status, STATUS_DLL_NOT_FOUND);
+    ok(DllBase == NULL, "DllBase = %p\n", DllBase);
+}
+
+START_TEST(LdrGetProcedureAddress)
+{
+    TestDllHandle();
+    TestExports(L"ntdll.dll");
+    TestExports(L"kernel32.dll");
+}
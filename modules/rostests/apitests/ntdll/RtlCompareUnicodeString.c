@@ -0,0 +1,137 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for case-insensitive UNICODE_STRING compare and hash
+ */
+
+#include "precomp.h"
+
+#define BENCH_ROUNDS 200000
+
+static
+VOID
+InitString(
+    _Out_ PUNICODE_STRING String,
+    _In_ PWSTR Buffer,
+    _In_ ULONG Length)
+{
+    String->Buffer = Buffer;
+    String->Length = (USHORT)(Length * sizeof(WCHAR));
+    String->MaximumLength = String->Length;
+}
+
+/* Differences and case pairs at every offset, across the 8-character blocks */
+static
+VOID
+TestOffsets(VOID)
+{
+    static const WCHAR Pairs[][2] =
+    {
+        { L'a', L'A' },
+        { L'z', L'Z' },
+        { 0xE9, 0xC9 },     /* e acute */
+        { 0x430, 0x410 },   /* Cyrillic a */
+    };
+    WCHAR Buffer1[40], Buffer2[40];
+    UNICODE_STRING String1, String2;
+    ULONG Hash1, Hash2, Length, Offset, i;
+
+    for (Length = 1; Length <= ARRAYSIZE(Buffer1); Length++)
+    {
+        for (Offset = 0; Offset < Length; Offset++)
+        {
+            for (i = 0; i < Length; i++)
+                Buffer1[i] = Buffer2[i] = L'a' + (i % 26);
+            InitString(&String1, Buffer1, Length);
+            InitString(&String2, Buffer2, Length);
+
+            for (i = 0; i < ARRAYSIZE(Pairs); i++)
+            {
+                Buffer1[Offset] = Pairs[i][0];
+                Buffer2[Offset] = Pairs[i][1];
+
+                ok(RtlCompareUnicodeString(&String1, &String2, TRUE) == 0,
+                   "Length %lu, offset %lu, pair %lu: not equal\n", Length, Offset, i);
+                ok(RtlCompareUnicodeString(&String1, &String2, FALSE) == Pairs[i][0] - Pairs[i][1],
+                   "Length %lu, offset %lu, pair %lu: wrong difference\n", Length, Offset, i);
+                ok(RtlEqualUnicodeString(&String1, &String2, TRUE),
+                   "Length %lu, offset %lu, pair %lu: not equal\n", Length, Offset, i);
+                ok(!RtlEqualUnicodeString(&String1, &String2, FALSE),
+                   "Length %lu, offset %lu, pair %lu: equal\n", Length, Offset, i);
+                ok(RtlPrefixUnicodeString(&String1, &String2, TRUE),
+                   "Length %lu, offset %lu, pair %lu: not a prefix\n", Length, Offset, i);
+
+                /* Strings that compare equal must hash equal */
+                RtlHashUnicodeString(&String1, TRUE, HASH_STRING_ALGORITHM_X65599, &Hash1);
+                RtlHashUnicodeString(&String2, TRUE, HASH_STRING_ALGORITHM_X65599, &Hash2);
+                ok(Hash1 == Hash2, "Length %lu, offset %lu, pair %lu: hash 0x%lx != 0x%lx\n",
+                   Length, Offset, i, Hash1, Hash2);
+            }
+
+            /* A real difference is reported with its sign */
+            Buffer1[Offset] = L'b';
+            Buffer2[Offset] = L'C';
+            ok(RtlCompareUnicodeString(&String1, &String2, TRUE) < 0,
+               "Length %lu, offset %lu: not less\n", Length, Offset);
+            ok(RtlCompareUnicodeString(&String2, &String1, TRUE) > 0,
+               "Length %lu, offset %lu: not greater\n", Length, Offset);
+            ok(!RtlEqualUnicodeString(&String1, &String2, TRUE),
+               "Length %lu, offset %lu: equal\n", Length, Offset);
+        }
+    }
+}
+
+static
+VOID
+TestHashedString(VOID)
+{
+    RTL_HASHED_UNICODE_STRING Hashed1, Hashed2, Hashed3;
+    UNICODE_STRING String;
+
+    RtlInitUnicodeString(&String, L"\\REGISTRY\\Machine\\Software");
+    RtlInitHashedUnicodeString(&Hashed1, &String);
+    RtlInitUnicodeString(&String, L"\\Registry\\MACHINE\\software");
+    RtlInitHashedUnicodeString(&Hashed2, &String);
+    RtlInitUnicodeString(&String, L"\\Registry\\Machine\\System");
+    RtlInitHashedUnicodeString(&Hashed3, &String);
+
+    ok_long(Hashed1.Hash, Hashed2.Hash);
+    ok(RtlEqualHashedUnicodeString(&Hashed1, &Hashed2), "Hashed strings not equal\n");
+    ok(!RtlEqualHashedUnicodeString(&Hashed1, &Hashed3), "Hashed strings equal\n");
+}
+
+static
+VOID
+Benchmark(VOID)
+{
+    UNICODE_STRING String1, String2;
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Hash, Equal = 0, i;
+
+    RtlInitUnicodeString(&String1, L"\\Device\\HarddiskVolume1\\Windows\\System32\\drivers\\etc\\hosts");
+    RtlInitUnicodeString(&String2, L"\\DEVICE\\HARDDISKVOLUME1\\WINDOWS\\SYSTEM32\\DRIVERS\\ETC\\HOSTS");
+
+    QueryPerformanceFrequency(&Frequency);
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        Equal += RtlEqualUnicodeString(&String1, &String2, TRUE);
+    QueryPerformanceCounter(&End);
+    ok_long(Equal, BENCH_ROUNDS);
+    trace("RtlEqualUnicodeString: %I64u ns per call\n",
+          (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / BENCH_ROUNDS);
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        RtlHashUnicodeString(&String1, TRUE, HASH_STRING_ALGORITHM_X65599, &Hash);
+    QueryPerformanceCounter(&End);
+    trace("RtlHashUnicodeString: %I64u ns per call\n",
+          (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / BENCH_ROUNDS);
+}
+
+START_TEST(RtlCompareUnicodeString)
+{
+    TestOffsets();
+    TestHashedString();
+    Benchmark();
+}
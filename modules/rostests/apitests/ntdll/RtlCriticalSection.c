@@ -0,0 +1,148 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test for RtlEnterCriticalSection under contention
+ */
+
+#include "precomp.h"
+
+#define THREAD_COUNT 4
+#define ITERATIONS 100000
+
+typedef struct _CS_TEST_CONTEXT
+{
+    RTL_CRITICAL_SECTION CriticalSection;
+    HANDLE StartEvent;
+    volatile LONG Inside;
+    ULONG Counter;
+    LONG Overlaps;
+} CS_TEST_CONTEXT, *PCS_TEST_CONTEXT;
+
+static
+DWORD
+WINAPI
+LockThread(
+    _In_ PVOID Param)
+{
+    PCS_TEST_CONTEXT Context = Param;
+    ULONG i;
+
+    WaitForSingleObject(Context->StartEvent, INFINITE);
+
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        RtlEnterCriticalSection(&Context->CriticalSection);
+        if (InterlockedIncrement(&Context->Inside) != 1)
+            InterlockedIncrement(&Context->Overlaps);
+
+        /* Recursive acquires must keep working while others spin */
+        if ((i % 16) == 0)
+        {
+            RtlEnterCriticalSection(&Context->CriticalSection);
+            RtlLeaveCriticalSection(&Context->CriticalSection);
+        }
+
+        Context->Counter++;
+        InterlockedDecrement(&Context->Inside);
+        RtlLeaveCriticalSection(&Context->CriticalSection);
+    }
+
+    return 0;
+}
+
+static
+VOID
+TestContention(
+    _In_ ULONG SpinCount)
+{
+    CS_TEST_CONTEXT Context;
+    HANDLE Threads[THREAD_COUNT];
+    PRTL_CRITICAL_SECTION_DEBUG DebugInfo;
+    ULONG Started = 0, i;
+    DWORD StartTime, Elapsed;
+    NTSTATUS Status;
+
+    RtlZeroMemory(&Context, sizeof(Context));
+    Status = RtlInitializeCriticalSectionAndSpinCount(&Context.CriticalSection, SpinCount);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    Context.StartEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(Context.StartEvent != NULL, "CreateEventW failed with %lu\n", GetLastError());
+    if (!Context.StartEvent)
+    {
+        RtlDeleteCriticalSection(&Context.CriticalSection);
+        return;
+    }
+
+    for (i = 0; i < THREAD_COUNT; i++)
+    {
+        Threads[Started] = CreateThread(NULL, 0, LockThread, &Context, 0, NULL);
+        ok(Threads[Started] != NULL, "CreateThread failed with %lu\n", GetLastError());
+        if (Threads[Started])
+            Started++;
+    }
+
+    StartTime = GetTickCount();
+    SetEvent(Context.StartEvent);
+    WaitForMultipleObjects(Started, Threads, TRUE, INFINITE);
+    Elapsed = GetTickCount() - StartTime;
+
+    for (i = 0; i < Started; i++)
+        CloseHandle(Threads[i]);
+    CloseHandle(Context.StartEvent);
+
+    ok_long(Context.Overlaps, 0);
+    ok_long(Context.Counter, Started * ITERATIONS);
+    ok_long(Context.CriticalSection.LockCount, -1);
+    ok_long(Context.CriticalSection.RecursionCount, 0);
+    ok(Context.CriticalSection.OwningThread == NULL,
+       "OwningThread = %p\n", Context.CriticalSection.OwningThread);
+
+    /* Whatever the lock learned, the spin count reads back as it was set */
+    ok_long(RtlSetCriticalSectionSpinCount(&Context.CriticalSection, 0),
+            (NtCurrentPeb()->NumberOfProcessors > 1) ? SpinCount : 0);
+
+    DebugInfo = Context.CriticalSection.DebugInfo;
+    if (DebugInfo && DebugInfo != (PVOID)-1)
+    {
+        /* Each wait is also a contention */
+        ok(DebugInfo->ContentionCount >= DebugInfo->EntryCount,
+           "ContentionCount %lu < EntryCount %lu\n",
+           DebugInfo->ContentionCount, DebugInfo->EntryCount);
+        trace("SpinCount %lu: %lu threads x %u in %lu ms, %lu waits, %lu contentions\n",
+              SpinCount, Started, ITERATIONS, Elapsed,
+              DebugInfo->EntryCount, DebugInfo->ContentionCount);
+    }
+    else
+    {
+        trace("SpinCount %lu: %lu threads x %u in %lu ms\n",
+              SpinCount, Started, ITERATIONS, Elapsed);
+    }
+
+    RtlDeleteCriticalSection(&Context.CriticalSection);
+}
+
+START_TEST(RtlCriticalSection)
+{
+    RTL_CRITICAL_SECTION CriticalSection;
+    ULONG ExpectedSpin = (NtCurrentPeb()->NumberOfProcessors > 1) ? 4000 : 0;
+    NTSTATUS Status;
+
+    /* Spin count bookkeeping */
+    Status = RtlInitializeCriticalSectionAndSpinCount(&CriticalSection, 4000);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (NT_SUCCESS(Status))
+    {
+        ok_long((ULONG)CriticalSection.SpinCount, ExpectedSpin);
+        ok_long(RtlSetCriticalSectionSpinCount(&CriticalSection, 100), ExpectedSpin);
+        ok_long(RtlSetCriticalSectionSpinCount(&CriticalSection, 0), ExpectedSpin ? 100 : 0);
+        ok_long((ULONG)CriticalSection.SpinCount, 0);
+        RtlDeleteCriticalSection(&CriticalSection);
+    }
+
+    /* The same workload, waiting right away and spinning first */
+    TestContention(0);
+    TestContention(4000);
+}
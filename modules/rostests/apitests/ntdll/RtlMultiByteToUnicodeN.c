@@ -0,0 +1,165 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for the RTL code page and UTF-8 conversions
+ */
+
+#include "precomp.h"
+
+#define BENCH_CHARS 4096
+#define BENCH_ROUNDS 2000
+
+static CHAR MbBuffer[BENCH_CHARS * 3];
+static WCHAR UnicodeBuffer[BENCH_CHARS];
+static WCHAR UnicodeBuffer2[BENCH_CHARS];
+
+/* Non-ASCII bytes at every offset of a run must still go through the table */
+static
+VOID
+TestAsciiRuns(VOID)
+{
+    CHAR Source[64], Result[64];
+    WCHAR Expected, Unicode[64];
+    ULONG ResultSize, Position, Length, i;
+    NTSTATUS Status;
+
+    for (Length = 1; Length <= sizeof(Source); Length++)
+    {
+        for (Position = 0; Position < Length; Position++)
+        {
+            for (i = 0; i < Length; i++)
+                Source[i] = 'a' + (i % 26);
+            Source[Position] = (CHAR)0xE9;
+
+            Status = RtlMultiByteToUnicodeN(Unicode, sizeof(Unicode), &ResultSize, Source, Length);
+            ok_ntstatus(Status, STATUS_SUCCESS);
+            ok_long(ResultSize, Length * sizeof(WCHAR));
+
+            RtlMultiByteToUnicodeN(&Expected, sizeof(Expected), NULL, &Source[Position], 1);
+            for (i = 0; i < Length; i++)
+            {
+                if (Unicode[i] != ((i == Position) ? Expected : (WCHAR)Source[i]))
+                    break;
+            }
+            ok(i == Length, "Length %lu, position %lu: mismatch at %lu\n", Length, Position, i);
+
+            Status = RtlUnicodeToMultiByteN(Result, sizeof(Result), &ResultSize, Unicode, Length * sizeof(WCHAR));
+            ok_ntstatus(Status, STATUS_SUCCESS);
+            ok_long(ResultSize, Length);
+            ok(!memcmp(Result, Source, Length), "Length %lu, position %lu: round trip failed\n", Length, Position);
+        }
+    }
+}
+
+static
+VOID
+TestUtf8RoundTrip(VOID)
+{
+    static const WCHAR Mixed[] = { 'C', ':', '\\', 0xE9, 0x20AC, 0xD83D, 0xDE00, 'x', 0 };
+    WCHAR Unicode[64];
+    CHAR Utf8[64 * 4];
+    ULONG Utf8Size, UnicodeSize, Length, Offset, i;
+    NTSTATUS Status;
+
+    /* Slide the non-ASCII tail through an ASCII prefix of every length */
+    for (Offset = 0; Offset < 40; Offset++)
+    {
+        for (i = 0; i < Offset; i++)
+            Unicode[i] = 'A' + (i % 26);
+        RtlCopyMemory(&Unicode[Offset], Mixed, sizeof(Mixed));
+        Length = Offset + ARRAYSIZE(Mixed) - 1;
+
+        Status = RtlUnicodeToUTF8N(NULL, 0, &Utf8Size, Unicode, Length * sizeof(WCHAR));
+        ok_ntstatus(Status, STATUS_SUCCESS);
+        ok_long(Utf8Size, Offset + 13);
+
+        Status = RtlUnicodeToUTF8N(Utf8, sizeof(Utf8), &Utf8Size, Unicode, Length * sizeof(WCHAR));
+        ok_ntstatus(Status, STATUS_SUCCESS);
+        ok_long(Utf8Size, Offset + 13);
+
+        Status = RtlUTF8ToUnicodeN(UnicodeBuffer, sizeof(UnicodeBuffer), &UnicodeSize, Utf8, Utf8Size);
+        ok_ntstatus(Status, STATUS_SUCCESS);
+        ok_long(UnicodeSize, Length * sizeof(WCHAR));
+        ok(!memcmp(UnicodeBuffer, Unicode, Length * sizeof(WCHAR)), "Offset %lu: round trip failed\n", Offset);
+    }
+}
+
+static
+ULONG
+MegabytesPerSecond(
+    _In_ ULONG Bytes,
+    _In_ LARGE_INTEGER Start,
+    _In_ LARGE_INTEGER End,
+    _In_ LARGE_INTEGER Frequency)
+{
+    LONGLONG Ticks = max(End.QuadPart - Start.QuadPart, 1);
+
+    return (ULONG)((ULONGLONG)Bytes * BENCH_ROUNDS * Frequency.QuadPart / Ticks / (1024 * 1024));
+}
+
+static
+VOID
+Benchmark(
+    _In_ PCSTR Name,
+    _In_ BOOLEAN Ascii)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG ResultSize, Utf8Size, i;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    /* Path-like text, optionally with an accented letter every 16 characters */
+    for (i = 0; i < BENCH_CHARS; i++)
+        MbBuffer[i] = (i % 16 == 15) ? '\\' : 'a' + (i % 26);
+    if (!Ascii)
+    {
+        for (i = 7; i < BENCH_CHARS; i += 16)
+            MbBuffer[i] = (CHAR)0xE9;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        Status |= RtlMultiByteToUnicodeN(UnicodeBuffer, sizeof(UnicodeBuffer), &ResultSize, MbBuffer, BENCH_CHARS);
+    QueryPerformanceCounter(&End);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    trace("%s: RtlMultiByteToUnicodeN %lu MB/s\n", Name, MegabytesPerSecond(BENCH_CHARS, Start, End, Frequency));
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        Status |= RtlUnicodeToMultiByteN(MbBuffer, BENCH_CHARS, &ResultSize, UnicodeBuffer, sizeof(UnicodeBuffer));
+    QueryPerformanceCounter(&End);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    trace("%s: RtlUnicodeToMultiByteN %lu MB/s\n", Name, MegabytesPerSecond(BENCH_CHARS, Start, End, Frequency));
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        Status |= RtlUnicodeToUTF8N(MbBuffer, sizeof(MbBuffer), &Utf8Size, UnicodeBuffer, sizeof(UnicodeBuffer));
+    QueryPerformanceCounter(&End);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    trace("%s: RtlUnicodeToUTF8N %lu MB/s\n", Name, MegabytesPerSecond(BENCH_CHARS, Start, End, Frequency));
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        Status |= RtlUTF8ToUnicodeN(UnicodeBuffer2, sizeof(UnicodeBuffer2), &ResultSize, MbBuffer, Utf8Size);
+    QueryPerformanceCounter(&End);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok(!memcmp(UnicodeBuffer, UnicodeBuffer2, sizeof(UnicodeBuffer)), "%s: UTF-8 round trip failed\n", Name);
+    trace("%s: RtlUTF8ToUnicodeN %lu MB/s\n", Name, MegabytesPerSecond(Utf8Size, Start, End, Frequency));
+}
+
+START_TEST(RtlMultiByteToUnicodeN)
+{
+    TestUtf8RoundTrip();
+    Benchmark("ASCII", TRUE);
+
+    /* 0xE9 has to be a character of its own */
+    if (IsDBCSLeadByte(0xE9))
+    {
+        skip("ANSI code page is double-byte\n");
+        return;
+    }
+
+    TestAsciiRuns();
+    Benchmark("Mixed", FALSE);
+}
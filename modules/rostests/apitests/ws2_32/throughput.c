@@ -0,0 +1,212 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Loopback receive throughput and data integrity test
+ */
+
+#include "ws2_32.h"
+
+#define TOTAL_BYTES     (8 * 1024 * 1024)
+#define SEND_CHUNK      0x10000
+
+typedef enum _RECV_MODE
+{
+    RecvSmall,
+    RecvLarge,
+    RecvScatter
+} RECV_MODE;
+
+static const char *ModeNames[] = { "small recv", "large recv", "scatter WSARecv" };
+
+static UCHAR PatternByte(ULONG Offset)
+{
+    /* 251 is prime so the pattern never lines up with buffer boundaries */
+    return (UCHAR)(Offset % 251);
+}
+
+static DWORD WINAPI SenderThread(LPVOID Parameter)
+{
+    SOCKET sck = (SOCKET)Parameter;
+    static UCHAR Buffer[SEND_CHUNK];
+    ULONG Sent = 0, i;
+    int iResult;
+
+    while (Sent < TOTAL_BYTES)
+    {
+        for (i = 0; i < SEND_CHUNK; i++)
+            Buffer[i] = PatternByte(Sent + i);
+
+        iResult = send(sck, (char *)Buffer, SEND_CHUNK, 0);
+        if (iResult <= 0)
+            break;
+
+        /* Resend the remainder of a short send on the next pass */
+        Sent += iResult;
+    }
+
+    shutdown(sck, SD_SEND);
+    return Sent;
+}
+
+static BOOL CreateConnectedPair(SOCKET *Server, SOCKET *Client)
+{
+    SOCKET Listener;
+    struct sockaddr_in addr;
+    int addrlen = sizeof(addr);
+
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Listener == INVALID_SOCKET)
+        return FALSE;
+
+    ZeroMemory(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    if (bind(Listener, (struct sockaddr *)&addr, sizeof(addr)) ||
+        getsockname(Listener, (struct sockaddr *)&addr, &addrlen) ||
+        listen(Listener, 1))
+    {
+        closesocket(Listener);
+        return FALSE;
+    }
+
+    *Client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (*Client == INVALID_SOCKET)
+    {
+        closesocket(Listener);
+        return FALSE;
+    }
+
+    if (connect(*Client, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        closesocket(*Client);
+        closesocket(Listener);
+        return FALSE;
+    }
+
+    *Server = accept(Listener, NULL, NULL);
+    closesocket(Listener);
+
+    if (*Server == INVALID_SOCKET)
+    {
+        closesocket(*Client);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static int ReceiveOnce(SOCKET sck, RECV_MODE Mode, UCHAR *Buffer)
+{
+    WSABUF Buffers[3];
+    DWORD Received, Flags = 0;
+
+    switch (Mode)
+    {
+        case RecvSmall:
+            return recv(sck, (char *)Buffer, 1000, 0);
+
+        case RecvLarge:
+            return recv(sck, (char *)Buffer, 0x20000, 0);
+
+        case RecvScatter:
+            /* Odd sizes so the pieces straddle the receive window wrap */
+            Buffers[0].buf = (char *)Buffer;
+            Buffers[0].len = 1237;
+            Buffers[1].buf = (char *)Buffer + 1237;
+            Buffers[1].len = 7;
+            Buffers[2].buf = (char *)Buffer + 1244;
+            Buffers[2].len = 5003;
+            if (WSARecv(sck, Buffers, 3, &Received, &Flags, NULL, NULL))
+                return SOCKET_ERROR;
+            return Received;
+    }
+
+    return SOCKET_ERROR;
+}
+
+static void TestThroughput(RECV_MODE Mode)
+{
+    SOCKET Server, Client;
+    HANDLE hThread;
+    UCHAR *Buffer;
+    ULONG Received = 0, Mismatch = 0, i;
+    DWORD Start, Elapsed, Sent = 0;
+    int iResult;
+
+    if (!CreateConnectedPair(&Server, &Client))
+    {
+        skip("Could not create a loopback connection, error %d\n", WSAGetLastError());
+        return;
+    }
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, 0x20000);
+    ok(Buffer != NULL, "HeapAlloc failed\n");
+    if (!Buffer)
+    {
+        closesocket(Client);
+        closesocket(Server);
+        return;
+    }
+
+    Start = GetTickCount();
+
+    hThread = CreateThread(NULL, 0, SenderThread, (LPVOID)Server, 0, NULL);
+    ok(hThread != NULL, "CreateThread failed\n");
+
+    while (hThread)
+    {
+        iResult = ReceiveOnce(Client, Mode, Buffer);
+        if (iResult <= 0)
+        {
+            ok(iResult == 0, "%s: receive failed, error %d\n", ModeNames[Mode], WSAGetLastError());
+            break;
+        }
+
+        for (i = 0; i < (ULONG)iResult; i++)
+        {
+            if (Buffer[i] != PatternByte(Received + i))
+                Mismatch++;
+        }
+
+        Received += iResult;
+    }
+
+    Elapsed = GetTickCount() - Start;
+
+    if (hThread)
+    {
+        WaitForSingleObject(hThread, INFINITE);
+        GetExitCodeThread(hThread, &Sent);
+        CloseHandle(hThread);
+    }
+
+    ok(Sent == TOTAL_BYTES, "%s: sent %lu bytes\n", ModeNames[Mode], Sent);
+    ok(Received == Sent, "%s: received %lu of %lu bytes\n", ModeNames[Mode], Received, Sent);
+    ok(Mismatch == 0, "%s: %lu bytes were corrupted\n", ModeNames[Mode], Mismatch);
+
+    trace("%s: %lu bytes in %lu ms (%lu KB/s)\n", ModeNames[Mode], Received, Elapsed,
+          Elapsed ? (Received / 1024) * 1000 / Elapsed : 0);
+
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    closesocket(Client);
+    closesocket(Server);
+}
+
+START_TEST(throughput)
+{
+    WSADATA wdata;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wdata))
+    {
+        skip("WSAStartup failed\n");
+        return;
+    }
+
+    TestThroughput(RecvSmall);
+    TestThroughput(RecvLarge);
+    TestThroughput(RecvScatter);
+
+    WSACleanup();
+}
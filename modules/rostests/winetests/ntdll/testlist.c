@@ -23,6 +23,7 @@ extern void func_rtl(void);
 extern void func_rtlbitmap(void);
 extern void func_rtlstr(void);
 extern void func_string(void);
+extern void func_threadpool(void);
 extern void func_time(void);
 
 const struct test winetest_testlist[] =
@@ -51,6 +52,7 @@ const struct test winetest_testlist[] =
     { "rtlbitmap", func_rtlbitmap },
     { "rtlstr", func_rtlstr },
     { "string", func_string },
+    { "threadpool", func_threadpool },
     { "time", func_time },
     { 0, 0 }
 };
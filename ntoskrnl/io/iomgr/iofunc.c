@@ -1134,6 +1134,289 @@ IopGetDriverPathInformation(IN PFILE_OBJECT FileObject,
     return STATUS_SUCCESS;
 }
 
+static
+NTSTATUS
+IopReadWriteFileSegments(IN HANDLE FileHandle,
+                         IN HANDLE Event OPTIONAL,
+                         IN PIO_APC_ROUTINE ApcRoutine OPTIONAL,
+                         IN PVOID ApcContext OPTIONAL,
+                         OUT PIO_STATUS_BLOCK IoStatusBlock,
+                         IN FILE_SEGMENT_ELEMENT SegmentArray[],
+                         IN ULONG Length,
+                         IN PLARGE_INTEGER ByteOffset OPTIONAL,
+                         IN PULONG Key OPTIONAL,
+                         IN BOOLEAN Write)
+{
+    NTSTATUS Status;
+    PFILE_OBJECT FileObject;
+    PIRP Irp;
+    PDEVICE_OBJECT DeviceObject;
+    PIO_STACK_LOCATION StackPtr;
+    KPROCESSOR_MODE PreviousMode = KeGetPreviousMode();
+    PKEVENT EventObject = NULL;
+    LARGE_INTEGER CapturedByteOffset;
+    ULONG CapturedKey = 0;
+    BOOLEAN Synchronous = FALSE;
+    PMDL Mdl = NULL;
+    PFN_NUMBER PageMdlBuffer[(sizeof(MDL) / sizeof(PFN_NUMBER)) + 1];
+    PMDL PageMdl = (PMDL)PageMdlBuffer;
+    PPFN_NUMBER MdlPages = NULL;
+    PVOID SegmentBuffer;
+    ULONG PageCount, PagesLocked = 0, i;
+
+    PAGED_CODE();
+    CapturedByteOffset.QuadPart = 0;
+    IOTRACE(IO_API_DEBUG, "FileHandle: %p\n", FileHandle);
+
+    /* Every segment describes one page, so there has to be at least one */
+    if (!Length) return STATUS_INVALID_PARAMETER;
+    PageCount = BYTES_TO_PAGES(Length);
+
+    /* Get File Object */
+    Status = ObReferenceObjectByHandle(FileHandle,
+                                       Write ? FILE_WRITE_DATA : FILE_READ_DATA,
+                                       IoFileObjectType,
+                                       PreviousMode,
+                                       (PVOID*)&FileObject,
+                                       NULL);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    /* Get the device object */
+    DeviceObject = IoGetRelatedDeviceObject(FileObject);
+
+    /*
+     * The pages go straight to the driver, so this only works for
+     * non-cached handles on devices that don't want a system buffer
+     */
+    if (!(FileObject->Flags & FO_NO_INTERMEDIATE_BUFFERING) ||
+        (DeviceObject->Flags & DO_BUFFERED_IO))
+    {
+        ObDereferenceObject(FileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Validate User-Mode Buffers */
+    if (PreviousMode != KernelMode)
+    {
+        _SEH2_TRY
+        {
+            /* Probe the status block */
+            ProbeForWriteIoStatusBlock(IoStatusBlock);
+
+            /* Probe the segment array, one element per page */
+            ProbeForRead(SegmentArray,
+                         PageCount * sizeof(FILE_SEGMENT_ELEMENT),
+                         TYPE_ALIGNMENT(FILE_SEGMENT_ELEMENT));
+
+            /* Check if we got a byte offset */
+            if (ByteOffset)
+            {
+                /* Capture and probe it */
+                CapturedByteOffset = ProbeForReadLargeInteger(ByteOffset);
+            }
+
+            /* Capture and probe the key */
+            if (Key) CapturedKey = ProbeForReadUlong(Key);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            /* Release the file object and return the exception code */
+            ObDereferenceObject(FileObject);
+            _SEH2_YIELD(return _SEH2_GetExceptionCode());
+        }
+        _SEH2_END;
+    }
+    else
+    {
+        /* Kernel mode: capture directly */
+        if (ByteOffset) CapturedByteOffset = *ByteOffset;
+        if (Key) CapturedKey = *Key;
+    }
+
+    /* Fail if Length or ByteOffset are not sector size aligned */
+    if ((DeviceObject->SectorSize != 0) &&
+        ((Length % DeviceObject->SectorSize != 0) ||
+         ((ByteOffset) &&
+          (CapturedByteOffset.QuadPart % DeviceObject->SectorSize != 0))))
+    {
+        /* Release the file object and fail */
+        ObDereferenceObject(FileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Check for event */
+    if (Event)
+    {
+        /* Reference it */
+        Status = ObReferenceObjectByHandle(Event,
+                                           EVENT_MODIFY_STATE,
+                                           ExEventObjectType,
+                                           PreviousMode,
+                                           (PVOID*)&EventObject,
+                                           NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            /* Fail */
+            ObDereferenceObject(FileObject);
+            return Status;
+        }
+
+        /* Otherwise reset the event */
+        KeClearEvent(EventObject);
+    }
+
+    /* Check if we should use Sync IO or not */
+    if (FileObject->Flags & FO_SYNCHRONOUS_IO)
+    {
+        /* Lock the file object */
+        Status = IopLockFileObject(FileObject, PreviousMode);
+        if (Status != STATUS_SUCCESS)
+        {
+            if (EventObject) ObDereferenceObject(EventObject);
+            ObDereferenceObject(FileObject);
+            return Status;
+        }
+
+        /* Check if we don't have a byte offset available */
+        if (!(ByteOffset) ||
+            ((CapturedByteOffset.u.LowPart == FILE_USE_FILE_POINTER_POSITION) &&
+             (CapturedByteOffset.u.HighPart == -1)))
+        {
+            /* Use the Current Byte Offset instead */
+            CapturedByteOffset = FileObject->CurrentByteOffset;
+        }
+
+        /* Remember we are sync */
+        Synchronous = TRUE;
+    }
+    else if (!ByteOffset)
+    {
+        /* Otherwise, this was async I/O without a byte offset, so fail */
+        if (EventObject) ObDereferenceObject(EventObject);
+        ObDereferenceObject(FileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Clear the File Object's event */
+    KeClearEvent(&FileObject->Event);
+
+    /* Allocate the IRP */
+    Irp = IoAllocateIrp(DeviceObject->StackSize, FALSE);
+    if (!Irp) return IopCleanupFailedIrp(FileObject, EventObject, NULL);
+
+    /* Set the IRP */
+    Irp->Tail.Overlay.OriginalFileObject = FileObject;
+    Irp->Tail.Overlay.Thread = PsGetCurrentThread();
+    Irp->RequestorMode = PreviousMode;
+    Irp->Overlay.AsynchronousParameters.UserApcRoutine = ApcRoutine;
+    Irp->Overlay.AsynchronousParameters.UserApcContext = ApcContext;
+    Irp->UserIosb = IoStatusBlock;
+    Irp->UserEvent = EventObject;
+    Irp->PendingReturned = FALSE;
+    Irp->Cancel = FALSE;
+    Irp->CancelRoutine = NULL;
+    Irp->AssociatedIrp.SystemBuffer = NULL;
+    Irp->MdlAddress = NULL;
+
+    /* Set the Stack Data */
+    StackPtr = IoGetNextIrpStackLocation(Irp);
+    StackPtr->FileObject = FileObject;
+    if (Write)
+    {
+        StackPtr->MajorFunction = IRP_MJ_WRITE;
+        StackPtr->Parameters.Write.Key = CapturedKey;
+        StackPtr->Parameters.Write.Length = Length;
+        StackPtr->Parameters.Write.ByteOffset = CapturedByteOffset;
+    }
+    else
+    {
+        StackPtr->MajorFunction = IRP_MJ_READ;
+        StackPtr->Parameters.Read.Key = CapturedKey;
+        StackPtr->Parameters.Read.Length = Length;
+        StackPtr->Parameters.Read.ByteOffset = CapturedByteOffset;
+    }
+
+    /*
+     * Build a single MDL for the whole transfer. It is laid out as if the
+     * first segment were followed by the others, and each segment page is
+     * locked on its own and its PFN placed in the shared page array, so the
+     * driver gets one request covering all of them.
+     */
+    _SEH2_TRY
+    {
+        for (i = 0; i < PageCount; i++)
+        {
+            /* Segments must be page aligned and addressable */
+#ifndef _WIN64
+            if (SegmentArray[i].Alignment >> 32)
+                ExRaiseStatus(STATUS_INVALID_PARAMETER);
+#endif
+            SegmentBuffer = (PVOID)(ULONG_PTR)SegmentArray[i].Alignment;
+            if (!SegmentBuffer || BYTE_OFFSET(SegmentBuffer))
+                ExRaiseStatus(STATUS_INVALID_PARAMETER);
+
+            if (!Mdl)
+            {
+                /* Allocate the MDL, described by the first segment */
+                Mdl = IoAllocateMdl(SegmentBuffer, Length, FALSE, FALSE, NULL);
+                if (!Mdl)
+                    ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
+                MdlPages = MmGetMdlPfnArray(Mdl);
+            }
+
+            /* Lock this page */
+            MmInitializeMdl(PageMdl, SegmentBuffer, PAGE_SIZE);
+            MmProbeAndLockPages(PageMdl,
+                                PreviousMode,
+                                Write ? IoReadAccess : IoWriteAccess);
+
+            /* Hand it over to the MDL, which now owns the lock */
+            MdlPages[i] = *MmGetMdlPfnArray(PageMdl);
+            Mdl->MdlFlags |= PageMdl->MdlFlags & (MDL_PAGES_LOCKED |
+                                                  MDL_WRITE_OPERATION |
+                                                  MDL_IO_SPACE);
+            Mdl->Process = PageMdl->Process;
+            PagesLocked++;
+        }
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        /* Unlock what we got so far and free the MDL */
+        if (Mdl)
+        {
+            if (PagesLocked)
+            {
+                Mdl->ByteCount = PagesLocked << PAGE_SHIFT;
+                MmUnlockPages(Mdl);
+            }
+            IoFreeMdl(Mdl);
+        }
+
+        /* Clean up and return the exception code */
+        IopCleanupAfterException(FileObject, Irp, EventObject, NULL);
+        _SEH2_YIELD(return _SEH2_GetExceptionCode());
+    }
+    _SEH2_END;
+
+    /* Attach the MDL, the completion path unlocks and frees it */
+    Irp->MdlAddress = Mdl;
+    Irp->UserBuffer = MmGetMdlVirtualAddress(Mdl);
+
+    /* Now set the deferred, non-cached transfer flags */
+    Irp->Flags = (Write ? IRP_WRITE_OPERATION : IRP_READ_OPERATION) |
+                 IRP_DEFER_IO_COMPLETION |
+                 IRP_NOCACHE;
+
+    /* Perform the call */
+    return IopPerformSynchronousRequest(DeviceObject,
+                                        Irp,
+                                        FileObject,
+                                        TRUE,
+                                        PreviousMode,
+                                        Synchronous,
+                                        Write ? IopWriteTransfer : IopReadTransfer);
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*
@@ -3002,7 +3285,7 @@ NtReadFile(IN HANDLE FileHandle,
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS
 NTAPI
@@ -3016,8 +3299,17 @@ NtReadFileScatter(IN HANDLE FileHandle,
                   IN PLARGE_INTEGER  ByteOffset,
                   IN PULONG Key OPTIONAL)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    /* Call the Generic Function */
+    return IopReadWriteFileSegments(FileHandle,
+                                    Event,
+                                    UserApcRoutine,
+                                    UserApcContext,
+                                    UserIoStatusBlock,
+                                    BufferDescription,
+                                    BufferLength,
+                                    ByteOffset,
+                                    Key,
+                                    FALSE);
 }
 
 /*
@@ -4060,6 +4352,9 @@ NtWriteFile(IN HANDLE FileHandle,
                                         IopWriteTransfer);
 }
 
+/*
+ * @implemented
+ */
 NTSTATUS
 NTAPI
 NtWriteFileGather(IN HANDLE FileHandle,
@@ -4072,8 +4367,17 @@ NtWriteFileGather(IN HANDLE FileHandle,
                   IN PLARGE_INTEGER ByteOffset,
                   IN PULONG Key OPTIONAL)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    /* Call the Generic Function */
+    return IopReadWriteFileSegments(FileHandle,
+                                    Event,
+                                    UserApcRoutine,
+                                    UserApcContext,
+                                    UserIoStatusBlock,
+                                    BufferDescription,
+                                    BufferLength,
+                                    ByteOffset,
+                                    Key,
+                                    TRUE);
 }
 
 /*
@@ -468,8 +468,9 @@ function(create_iso_lists)
         DESTINATION reactos
         NO_CAB FOR bootcd regtest)
 
+    # The LiveCD is only read by FreeLoader as a RAM disk, keep it compressed
     add_cd_file(
-        FILE ${CMAKE_CURRENT_BINARY_DIR}/livecd.iso
+        FILE ${CMAKE_CURRENT_BINARY_DIR}/livecd.iso.gz
         DESTINATION livecd
         FOR hybridcd)
 
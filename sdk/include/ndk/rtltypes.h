@@ -1821,6 +1821,18 @@ typedef struct _RTL_UNICODE_STRING_BUFFER
     WCHAR MinimumStaticBufferForTerminalNul;
 } RTL_UNICODE_STRING_BUFFER, *PRTL_UNICODE_STRING_BUFFER;
 
+#ifdef __REACTOS__ // ReactOS improvement
+//
+// Unicode String with its case-insensitive x65599 hash, for repeated lookups
+//
+typedef struct _RTL_HASHED_UNICODE_STRING
+{
+    UNICODE_STRING String;
+    ULONG Hash;
+} RTL_HASHED_UNICODE_STRING, *PRTL_HASHED_UNICODE_STRING;
+typedef const RTL_HASHED_UNICODE_STRING *PCRTL_HASHED_UNICODE_STRING;
+#endif
+
 #ifndef NTOS_MODE_USER
 
 //
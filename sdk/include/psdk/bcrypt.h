@@ -66,9 +66,17 @@ typedef NTSTATUS *PNTSTATUS;
 #define BCRYPT_RSAPUBLIC_BLOB    L"RSAPUBLICBLOB"
 #define BCRYPT_RSAPRIVATE_BLOB   L"RSAPRIVATEBLOB"
 
+#define BCRYPT_CHAIN_MODE_NA  L"ChainingModeN/A"
+#define BCRYPT_CHAIN_MODE_CBC L"ChainingModeCBC"
+#define BCRYPT_CHAIN_MODE_ECB L"ChainingModeECB"
+#define BCRYPT_CHAIN_MODE_CFB L"ChainingModeCFB"
+#define BCRYPT_CHAIN_MODE_CCM L"ChainingModeCCM"
+#define BCRYPT_CHAIN_MODE_GCM L"ChainingModeGCM"
+
 #define MS_PRIMITIVE_PROVIDER L"Microsoft Primitive Provider"
 #define MS_PLATFORM_CRYPTO_PROVIDER L"Microsoft Platform Crypto Provider"
 
+#define BCRYPT_AES_ALGORITHM        L"AES"
 #define BCRYPT_MD5_ALGORITHM        L"MD5"
 #define BCRYPT_RNG_ALGORITHM        L"RNG"
 #define BCRYPT_SHA1_ALGORITHM       L"SHA1"
@@ -159,6 +167,13 @@ typedef struct _BCRYPT_PKCS1_PADDING_INFO
 #define BCRYPT_AUTH_MODE_CHAIN_CALLS_FLAG 0x00000001
 #define BCRYPT_AUTH_MODE_IN_PROGRESS_FLAG 0x00000002
 
+#define BCRYPT_INIT_AUTH_MODE_INFO(_AUTH_INFO_STRUCT_) \
+    do { \
+        RtlZeroMemory(&(_AUTH_INFO_STRUCT_), sizeof(BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO)); \
+        (_AUTH_INFO_STRUCT_).cbSize = sizeof(BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO); \
+        (_AUTH_INFO_STRUCT_).dwInfoVersion = BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO_VERSION; \
+    } while (0)
+
 #define BCRYPT_KEY_DATA_BLOB_MAGIC    0x4d42444b
 #define BCRYPT_KEY_DATA_BLOB_VERSION1 1
 
@@ -171,6 +186,8 @@ typedef PVOID BCRYPT_HASH_HANDLE;
 #define BCRYPT_USE_SYSTEM_PREFERRED_RNG  0x00000002
 #define BCRYPT_ALG_HANDLE_HMAC_FLAG 0x00000008
 
+#define BCRYPT_BLOCK_PADDING 0x00000001
+
 NTSTATUS WINAPI BCryptCloseAlgorithmProvider(BCRYPT_ALG_HANDLE, ULONG);
 NTSTATUS WINAPI BCryptCreateHash(BCRYPT_ALG_HANDLE, BCRYPT_HASH_HANDLE *, PUCHAR, ULONG, PUCHAR, ULONG, ULONG);
 NTSTATUS WINAPI BCryptDecrypt(BCRYPT_KEY_HANDLE, PUCHAR, ULONG, VOID *, PUCHAR, ULONG, PUCHAR, ULONG, ULONG *, ULONG);
@@ -952,6 +952,7 @@ extern "C" {
 #define STATUS_WOW_ASSERTION                    ((NTSTATUS)0xC0009898)
 #define STATUS_INVALID_SIGNATURE                ((NTSTATUS)0xC000A000)
 #define STATUS_HMAC_NOT_SUPPORTED               ((NTSTATUS)0xC000A001)
+#define STATUS_AUTH_TAG_MISMATCH                ((NTSTATUS)0xC000A002)
 #define STATUS_IPSEC_QUEUE_OVERFLOW             ((NTSTATUS)0xC000A010)
 #define STATUS_ND_QUEUE_OVERFLOW                ((NTSTATUS)0xC000A011)
 #define STATUS_HOPLIMIT_EXCEEDED                ((NTSTATUS)0xC000A012)
@@ -99,6 +99,8 @@
 
 /* TCP connection options */
 #define TCP_SOCKET_NODELAY 1
+#define TCP_SOCKET_RCVBUF  2
+#define TCP_SOCKET_SNDBUF  3
 
 typedef struct IFEntry
 {
@@ -30,6 +30,100 @@ typedef struct _ROSSYM_ENTRY {
   ULONG SourceLine;
 } ROSSYM_ENTRY, *PROSSYM_ENTRY;
 
+/*
+ * Compact layout, emitted by rsym. The entries are sorted by address and
+ * delta encoded, every field as a variable length integer (7 bits per byte,
+ * low bits first), the offsets and the line as zigzag encoded differences.
+ * The stream is split into blocks at address changes; each block restarts
+ * from its own address and zero offsets. The page table holds, for each
+ * (1 << PageShift) bytes of RVA space, the last block starting at or below
+ * the page, so a lookup only has to search the blocks of a single page.
+ */
+#define ROSSYM_COMPACT_MAGIC 0x32595352 /* "RSY2" */
+
+typedef struct _ROSSYM_COMPACT_HEADER {
+  ULONG Magic;
+  ULONG SymbolsCount;
+  ULONG PageShift;
+  ULONG PagesOffset;
+  ULONG PagesCount;
+  ULONG BlocksOffset;
+  ULONG BlocksCount;
+  ULONG DataOffset;
+  ULONG DataLength;
+  ULONG StringsOffset;
+  ULONG StringsLength;
+} ROSSYM_COMPACT_HEADER, *PROSSYM_COMPACT_HEADER;
+
+typedef struct _ROSSYM_COMPACT_BLOCK {
+  ULONG Address;
+  ULONG DataOffset;
+} ROSSYM_COMPACT_BLOCK, *PROSSYM_COMPACT_BLOCK;
+
+FORCEINLINE
+BOOLEAN
+RosSymReadCompactValue(const UCHAR **Data, const UCHAR *End, ULONG *Value)
+{
+  ULONG Result = 0, Shift = 0;
+  UCHAR Byte;
+
+  do
+    {
+      if (*Data >= End || Shift > 28)
+        {
+          return FALSE;
+        }
+      Byte = *(*Data)++;
+      Result |= (ULONG)(Byte & 0x7F) << Shift;
+      Shift += 7;
+    }
+  while (Byte & 0x80);
+
+  *Value = Result;
+  return TRUE;
+}
+
+FORCEINLINE
+BOOLEAN
+RosSymIsValidCompactHeader(const ROSSYM_COMPACT_HEADER *Header, ULONG_PTR Size)
+{
+  return Size >= sizeof(ROSSYM_COMPACT_HEADER)
+         && Header->Magic == ROSSYM_COMPACT_MAGIC
+         && Header->PageShift < 32
+         && Header->PagesCount != 0
+         && Header->BlocksCount != 0
+         && Header->PagesOffset >= sizeof(ROSSYM_COMPACT_HEADER)
+         && Header->BlocksOffset >= sizeof(ROSSYM_COMPACT_HEADER)
+         && Header->DataOffset >= sizeof(ROSSYM_COMPACT_HEADER)
+         && Header->StringsOffset >= sizeof(ROSSYM_COMPACT_HEADER)
+         && Header->PagesOffset + (ULONGLONG)Header->PagesCount * sizeof(ULONG) <= Size
+         && Header->BlocksOffset + (ULONGLONG)Header->BlocksCount * sizeof(ROSSYM_COMPACT_BLOCK) <= Size
+         && Header->DataOffset + (ULONGLONG)Header->DataLength <= Size
+         && Header->StringsOffset + (ULONGLONG)Header->StringsLength <= Size;
+}
+
+/* Decodes the next entry of a block, Entry holds the previous one */
+FORCEINLINE
+BOOLEAN
+RosSymReadCompactEntry(const UCHAR **Data, const UCHAR *End, PROSSYM_ENTRY Entry)
+{
+  ULONG Address, Function, File, Line;
+
+  if (!RosSymReadCompactValue(Data, End, &Address)
+      || !RosSymReadCompactValue(Data, End, &Function)
+      || !RosSymReadCompactValue(Data, End, &File)
+      || !RosSymReadCompactValue(Data, End, &Line))
+    {
+      return FALSE;
+    }
+
+  Entry->Address += Address;
+  Entry->FunctionOffset += (Function >> 1) ^ (0 - (Function & 1));
+  Entry->FileOffset += (File >> 1) ^ (0 - (File & 1));
+  Entry->SourceLine += (Line >> 1) ^ (0 - (Line & 1));
+  return TRUE;
+}
+
 enum _ROSSYM_REGNAME {
     ROSSYM_X86_EAX = 0,
     ROSSYM_X86_ECX,
@@ -2782,6 +2782,11 @@ RtlContractHashTable(
 
 $endif (_NTDDK_)
 $if (_NTIFS_)
+#endif /* (NTDDI_VERSION >= NTDDI_WIN7) */
+
+/* ReactOS exports these from ntoskrnl on every version */
+#if (NTDDI_VERSION >= NTDDI_WIN7) || defined(__REACTOS__)
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
 NTSYSAPI
@@ -2806,6 +2811,10 @@ RtlUTF8ToUnicodeN(
   _In_reads_bytes_(UTF8StringByteCount) PCCH UTF8StringSource,
   _In_ ULONG UTF8StringByteCount);
 
+#endif /* (NTDDI_VERSION >= NTDDI_WIN7) || defined(__REACTOS__) */
+
+#if (NTDDI_VERSION >= NTDDI_WIN7)
+
 _IRQL_requires_max_(APC_LEVEL)
 NTSYSAPI
 NTSTATUS
@@ -4229,9 +4229,13 @@ DbgRaiseAssertionFailure(VOID)
 
 typedef struct _TP_POOL TP_POOL, *PTP_POOL;
 typedef struct _TP_WORK TP_WORK, *PTP_WORK;
+typedef struct _TP_TIMER TP_TIMER, *PTP_TIMER;
+typedef struct _TP_WAIT TP_WAIT, *PTP_WAIT;
+typedef struct _TP_IO TP_IO, *PTP_IO;
 typedef struct _TP_CALLBACK_INSTANCE TP_CALLBACK_INSTANCE, *PTP_CALLBACK_INSTANCE;
 
 typedef DWORD TP_VERSION, *PTP_VERSION;
+typedef DWORD TP_WAIT_RESULT;
 
 typedef enum _TP_CALLBACK_PRIORITY {
   TP_CALLBACK_PRIORITY_HIGH,
@@ -4247,6 +4251,19 @@ typedef VOID
   _Inout_opt_ PVOID Context,
   _Inout_ PTP_WORK Work);
 
+typedef VOID
+(NTAPI *PTP_TIMER_CALLBACK)(
+  _Inout_ PTP_CALLBACK_INSTANCE Instance,
+  _Inout_opt_ PVOID Context,
+  _Inout_ PTP_TIMER Timer);
+
+typedef VOID
+(NTAPI *PTP_WAIT_CALLBACK)(
+  _Inout_ PTP_CALLBACK_INSTANCE Instance,
+  _Inout_opt_ PVOID Context,
+  _Inout_ PTP_WAIT Wait,
+  _In_ TP_WAIT_RESULT WaitResult);
+
 typedef struct _TP_CLEANUP_GROUP TP_CLEANUP_GROUP, *PTP_CLEANUP_GROUP;
 
 typedef VOID
@@ -4259,8 +4276,7 @@ typedef VOID
   _Inout_opt_ PVOID ObjectContext,
   _Inout_opt_ PVOID CleanupContext);
 
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN7)
-typedef struct _TP_CALLBACK_ENVIRON_V3 {
+typedef struct _TP_CALLBACK_ENVIRON_V1 {
   TP_VERSION Version;
   PTP_POOL Pool;
   PTP_CLEANUP_GROUP CleanupGroup;
@@ -4276,11 +4292,10 @@ typedef struct _TP_CALLBACK_ENVIRON_V3 {
       DWORD Private:30;
     } s;
   } u;
-  TP_CALLBACK_PRIORITY CallbackPriority;
-  DWORD Size;
-} TP_CALLBACK_ENVIRON_V3, TP_CALLBACK_ENVIRON, *PTP_CALLBACK_ENVIRON;
-#else
-typedef struct _TP_CALLBACK_ENVIRON_V1 {
+} TP_CALLBACK_ENVIRON_V1;
+
+/* Version 3 is what Windows 7 and later use, ntdll accepts both */
+typedef struct _TP_CALLBACK_ENVIRON_V3 {
   TP_VERSION Version;
   PTP_POOL Pool;
   PTP_CLEANUP_GROUP CleanupGroup;
@@ -4296,7 +4311,14 @@ typedef struct _TP_CALLBACK_ENVIRON_V1 {
       DWORD Private:30;
     } s;
   } u;
-} TP_CALLBACK_ENVIRON_V1, TP_CALLBACK_ENVIRON, *PTP_CALLBACK_ENVIRON;
+  TP_CALLBACK_PRIORITY CallbackPriority;
+  DWORD Size;
+} TP_CALLBACK_ENVIRON_V3;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN7)
+typedef TP_CALLBACK_ENVIRON_V3 TP_CALLBACK_ENVIRON, *PTP_CALLBACK_ENVIRON;
+#else
+typedef TP_CALLBACK_ENVIRON_V1 TP_CALLBACK_ENVIRON, *PTP_CALLBACK_ENVIRON;
 #endif /* (_WIN32_WINNT >= _WIN32_WINNT_WIN7) */
 
 #ifdef __WINESRC__
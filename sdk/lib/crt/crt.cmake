@@ -472,7 +472,18 @@ elseif(ARCH STREQUAL "amd64")
         math/amd64/sqrt.S
         # math/amd64/sqrtf.S
         math/amd64/tan.S
-        setjmp/amd64/setjmp.s)
+        mem/amd64/memchr.S
+        mem/amd64/memmove.S
+        mem/amd64/memset.S
+        setjmp/amd64/setjmp.s
+        string/amd64/strchr_asm.s
+        string/amd64/strcmp_asm.s
+        string/amd64/strlen_asm.s
+        string/amd64/strnlen_asm.s
+        string/amd64/wcschr_asm.s
+        string/amd64/wcscmp_asm.s
+        string/amd64/wcslen_asm.s
+        string/amd64/wcsnlen_asm.s)
 
     list(APPEND CRT_SOURCE
         except/amd64/ehandler.c
@@ -564,32 +575,36 @@ if(NOT ARCH STREQUAL "i386")
         math/tanf.c
         math/tanhf.c
         math/stubs.c
-        mem/memchr.c
-        mem/memcpy.c
-        mem/memmove.c
-        mem/memset.c
         string/strcat.c
-        string/strchr.c
-        string/strcmp.c
         string/strcpy.c
-        string/strlen.c
         string/strncat.c
         string/strncmp.c
         string/strncpy.c
-        string/strnlen.c
         string/strrchr.c
         string/wcscat.c
-        string/wcschr.c
-        string/wcscmp.c
         string/wcscpy.c
-        string/wcslen.c
         string/wcsncat.c
         string/wcsncmp.c
         string/wcsncpy.c
-        string/wcsnlen.c
         string/wcsrchr.c)
 endif()
 
+if(NOT ARCH STREQUAL "i386" AND NOT ARCH STREQUAL "amd64")
+    list(APPEND CRT_SOURCE
+        mem/memchr.c
+        mem/memcpy.c
+        mem/memmove.c
+        mem/memset.c
+        string/strchr.c
+        string/strcmp.c
+        string/strlen.c
+        string/strnlen.c
+        string/wcschr.c
+        string/wcscmp.c
+        string/wcslen.c
+        string/wcsnlen.c)
+endif()
+
 # includes for wine code
 include_directories(${REACTOS_SOURCE_DIR}/sdk/include/reactos/wine)
 
@@ -115,6 +115,17 @@ elseif(ARCH STREQUAL "amd64")
         except/amd64/chkstk_asm.s
         except/amd64/seh.s
         setjmp/amd64/setjmp.s
+        mem/amd64/memchr.S
+        mem/amd64/memmove.S
+        mem/amd64/memset.S
+        string/amd64/strchr_asm.s
+        string/amd64/strcmp_asm.s
+        string/amd64/strlen_asm.s
+        string/amd64/strnlen_asm.s
+        string/amd64/wcschr_asm.s
+        string/amd64/wcscmp_asm.s
+        string/amd64/wcslen_asm.s
+        string/amd64/wcsnlen_asm.s
         math/amd64/atan.S
         math/amd64/atan2.S
         math/amd64/ceil.S
@@ -211,32 +222,36 @@ else()
         math/cos.c
         math/sin.c
         math/sqrt.c
-        mem/memchr.c
-        mem/memcpy.c
-        mem/memmove.c
-        mem/memset.c
         string/strcat.c
-        string/strchr.c
-        string/strcmp.c
         string/strcpy.c
-        string/strlen.c
         string/strncat.c
         string/strncmp.c
         string/strncpy.c
-        string/strnlen.c
         string/strrchr.c
         string/wcscat.c
-        string/wcschr.c
-        string/wcscmp.c
         string/wcscpy.c
-        string/wcslen.c
         string/wcsncat.c
         string/wcsncmp.c
         string/wcsncpy.c
-        string/wcsnlen.c
         string/wcsrchr.c)
 endif()
 
+if(NOT ARCH STREQUAL "i386" AND NOT ARCH STREQUAL "amd64")
+    list(APPEND LIBCNTPR_SOURCE
+        mem/memchr.c
+        mem/memcpy.c
+        mem/memmove.c
+        mem/memset.c
+        string/strchr.c
+        string/strcmp.c
+        string/strlen.c
+        string/strnlen.c
+        string/wcschr.c
+        string/wcscmp.c
+        string/wcslen.c
+        string/wcsnlen.c)
+endif()
+
 set_source_files_properties(${LIBCNTPR_ASM_SOURCE} PROPERTIES COMPILE_DEFINITIONS "NO_RTL_INLINES;_NTSYSTEM_;_NTDLLBUILD_;_LIBCNT_;__CRT__NO_INLINE;CRTDLL")
 add_asm_files(libcntpr_asm ${LIBCNTPR_ASM_SOURCE})
 
@@ -6,14 +6,43 @@
 #pragma function(memcmp)
 #endif
 
+#define MEM_WORD_SIZE sizeof(size_t)
+#define MEM_WORD_MASK (sizeof(size_t) - 1)
+
 int __cdecl memcmp(const void *s1, const void *s2, size_t n)
 {
-    if (n != 0) {
-        const unsigned char *p1 = s1, *p2 = s2;
-        do {
-            if (*p1++ != *p2++)
-                return (*--p1 - *--p2);
-        } while (--n != 0);
+    const unsigned char *p1 = s1, *p2 = s2;
+
+    /* With the same alignment, skip the equal words first */
+    if ((((size_t)p1 ^ (size_t)p2) & MEM_WORD_MASK) == 0)
+    {
+        while (((size_t)p1 & MEM_WORD_MASK) && (n != 0))
+        {
+            if (*p1 != *p2)
+                return (*p1 - *p2);
+            p1++;
+            p2++;
+            n--;
+        }
+
+        while ((n >= MEM_WORD_SIZE) &&
+               (*(const size_t *)p1 == *(const size_t *)p2))
+        {
+            p1 += MEM_WORD_SIZE;
+            p2 += MEM_WORD_SIZE;
+            n -= MEM_WORD_SIZE;
+        }
     }
+
+    /* Find the differing byte, or compare what is left */
+    while (n != 0)
+    {
+        if (*p1 != *p2)
+            return (*p1 - *p2);
+        p1++;
+        p2++;
+        n--;
+    }
+
     return 0;
 }
@@ -1,36 +1,6 @@
 #include <string.h>
 
-/* NOTE: This code is duplicated in memcpy function */
-void * __cdecl memmove(void *dest,const void *src,size_t count)
-{
-    char *char_dest = (char *)dest;
-    char *char_src = (char *)src;
+#define MEMMOVE memmove
+#include "memmove.h"
 
-    if ((char_dest <= char_src) || (char_dest >= (char_src+count)))
-    {
-        /*  non-overlapping buffers */
-        while(count > 0)
-	{
-            *char_dest = *char_src;
-            char_dest++;
-            char_src++;
-            count--;
-	}
-    }
-    else
-    {
-        /* overlaping buffers */
-        char_dest = (char *)dest + count - 1;
-        char_src = (char *)src + count - 1;
-
-        while(count > 0)
-	{
-           *char_dest = *char_src;
-           char_dest--;
-           char_src--;
-           count--;
-	}
-    }
-
-    return dest;
-}
+/* EOF */
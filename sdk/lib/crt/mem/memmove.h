@@ -0,0 +1,112 @@
+
+/*
+ * Shared implementation of memmove and memcpy. Like on Windows, memcpy
+ * handles overlapping buffers, callers of RtlCopyMemory depend on it.
+ *
+ * Buffers with the same alignment are copied a machine word at a time,
+ * everything else and the unaligned head and tail go byte by byte.
+ */
+
+#if defined(__GNUC__) && !defined(__clang__)
+/* Don't let GCC turn the copy loops back into a call to ourselves */
+#pragma GCC optimize("no-tree-loop-distribute-patterns")
+#endif
+
+#define MEM_WORD_SIZE sizeof(size_t)
+#define MEM_WORD_MASK (sizeof(size_t) - 1)
+
+void * __cdecl MEMMOVE(void *dest, const void *src, size_t count)
+{
+    unsigned char *char_dest = (unsigned char *)dest;
+    const unsigned char *char_src = (const unsigned char *)src;
+    size_t *word_dest;
+    const size_t *word_src;
+
+    if ((char_dest <= char_src) || (char_dest >= (char_src + count)))
+    {
+        /* Non-overlapping buffers, or dest before src: copy forward */
+        if ((((size_t)char_dest ^ (size_t)char_src) & MEM_WORD_MASK) == 0)
+        {
+            while (((size_t)char_dest & MEM_WORD_MASK) && (count > 0))
+            {
+                *char_dest++ = *char_src++;
+                count--;
+            }
+
+            word_dest = (size_t *)char_dest;
+            word_src = (const size_t *)char_src;
+
+            while (count >= 4 * MEM_WORD_SIZE)
+            {
+                word_dest[0] = word_src[0];
+                word_dest[1] = word_src[1];
+                word_dest[2] = word_src[2];
+                word_dest[3] = word_src[3];
+                word_dest += 4;
+                word_src += 4;
+                count -= 4 * MEM_WORD_SIZE;
+            }
+
+            while (count >= MEM_WORD_SIZE)
+            {
+                *word_dest++ = *word_src++;
+                count -= MEM_WORD_SIZE;
+            }
+
+            char_dest = (unsigned char *)word_dest;
+            char_src = (const unsigned char *)word_src;
+        }
+
+        while (count > 0)
+        {
+            *char_dest++ = *char_src++;
+            count--;
+        }
+    }
+    else
+    {
+        /* Overlapping buffers with dest after src: copy backward */
+        char_dest += count;
+        char_src += count;
+
+        if ((((size_t)char_dest ^ (size_t)char_src) & MEM_WORD_MASK) == 0)
+        {
+            while (((size_t)char_dest & MEM_WORD_MASK) && (count > 0))
+            {
+                *--char_dest = *--char_src;
+                count--;
+            }
+
+            word_dest = (size_t *)char_dest;
+            word_src = (const size_t *)char_src;
+
+            while (count >= 4 * MEM_WORD_SIZE)
+            {
+                word_dest -= 4;
+                word_src -= 4;
+                word_dest[3] = word_src[3];
+                word_dest[2] = word_src[2];
+                word_dest[1] = word_src[1];
+                word_dest[0] = word_src[0];
+                count -= 4 * MEM_WORD_SIZE;
+            }
+
+            while (count >= MEM_WORD_SIZE)
+            {
+                *--word_dest = *--word_src;
+                count -= MEM_WORD_SIZE;
+            }
+
+            char_dest = (unsigned char *)word_dest;
+            char_src = (const unsigned char *)word_src;
+        }
+
+        while (count > 0)
+        {
+            *--char_dest = *--char_src;
+            count--;
+        }
+    }
+
+    return dest;
+}
@@ -5,14 +5,53 @@
 #pragma function(memset)
 #endif /* _MSC_VER */
 
+#if defined(__GNUC__) && !defined(__clang__)
+/* Don't let GCC turn the fill loops back into a call to ourselves */
+#pragma GCC optimize("no-tree-loop-distribute-patterns")
+#endif
+
+#define MEM_WORD_SIZE sizeof(size_t)
+#define MEM_WORD_MASK (sizeof(size_t) - 1)
+
 void* __cdecl memset(void* src, int val, size_t count)
 {
-    char *char_src = (char *)src;
+    unsigned char *char_src = (unsigned char *)src;
+    size_t *word_src;
+    size_t word;
 
-    while(count>0) {
-        *char_src = val;
-        char_src++;
+    /* Fill up to the first aligned word byte by byte */
+    while (((size_t)char_src & MEM_WORD_MASK) && (count > 0))
+    {
+        *char_src++ = (unsigned char)val;
         count--;
     }
+
+    /* Replicate the byte into all bytes of a word */
+    word = ((size_t)-1 / 0xFF) * (unsigned char)val;
+    word_src = (size_t *)char_src;
+
+    while (count >= 4 * MEM_WORD_SIZE)
+    {
+        word_src[0] = word;
+        word_src[1] = word;
+        word_src[2] = word;
+        word_src[3] = word;
+        word_src += 4;
+        count -= 4 * MEM_WORD_SIZE;
+    }
+
+    while (count >= MEM_WORD_SIZE)
+    {
+        *word_src++ = word;
+        count -= MEM_WORD_SIZE;
+    }
+
+    char_src = (unsigned char *)word_src;
+    while (count > 0)
+    {
+        *char_src++ = (unsigned char)val;
+        count--;
+    }
+
     return src;
 }
@@ -0,0 +1,4 @@
+
+#include "tcsnlen.inc"
+
+/* EOF */
@@ -0,0 +1,38 @@
+
+#ifndef __TCHAR_INC_S__
+#define __TCHAR_INC_S__
+
+#ifdef _UNICODE
+
+#define _tcschr wcschr
+#define _tcscmp wcscmp
+#define _tcslen wcslen
+#define _tcsnlen wcsnlen
+
+#define _tpcmpeq pcmpeqw
+#define _tptr word ptr
+
+#define _tsize 2
+
+/* Characters per 16 byte block, as a shift */
+#define _tshift 1
+
+#else
+
+#define _tcschr strchr
+#define _tcscmp strcmp
+#define _tcslen strlen
+#define _tcsnlen strnlen
+
+#define _tpcmpeq pcmpeqb
+#define _tptr byte ptr
+
+#define _tsize 1
+
+#define _tshift 0
+
+#endif
+
+#endif
+
+/* EOF */
@@ -0,0 +1,5 @@
+
+#define _UNICODE
+#include "tcsnlen.inc"
+
+/* EOF */
@@ -0,0 +1,463 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     AES block cipher modes (ECB, CBC, CTR and GCM)
+ */
+
+#include "tomcrypt.h"
+#include "aesmodes.h"
+#include "cryptcpu.h"
+
+C_ASSERT(sizeof(aes_key) == RTL_FIELD_SIZE(AES_CONTEXT, TableKey));
+
+#define TABLE_KEY(Context) ((aes_key *)(Context)->TableKey)
+
+/* Reduction constants for the 4 bits shifted out of the low end */
+static const ULONGLONG GhashLast4[16] =
+{
+   0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+   0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0
+};
+
+static ULONGLONG
+LoadBe64(const UCHAR *p)
+{
+   ULONG High, Low;
+
+   LOAD32H(High, p);
+   LOAD32H(Low, p + 4);
+   return ((ULONGLONG)High << 32) | Low;
+}
+
+static VOID
+StoreBe64(UCHAR *p, ULONGLONG Value)
+{
+   STORE32H((ULONG)(Value >> 32), p);
+   STORE32H((ULONG)Value, p + 4);
+}
+
+static VOID
+XorBlock(UCHAR *Out, const UCHAR *In1, const UCHAR *In2, SIZE_T Size)
+{
+   SIZE_T i;
+
+   for (i = 0; i < Size; i++)
+      Out[i] = In1[i] ^ In2[i];
+}
+
+static VOID
+Increment32(UCHAR *Counter)
+{
+   ULONG Value;
+
+   LOAD32H(Value, Counter + 12);
+   Value++;
+   STORE32H(Value, Counter + 12);
+}
+
+static VOID
+AesEncryptBlock(PAES_CONTEXT Context, const UCHAR *In, UCHAR *Out)
+{
+#ifdef _M_AMD64
+   if (Context->Features & CRYPT_CPU_AES_NI)
+   {
+      AesNiEncryptEcb(Context->EncryptKeys[0], Context->Rounds, In, Out, 1);
+      return;
+   }
+#endif
+   aes_ecb_encrypt(In, Out, TABLE_KEY(Context));
+}
+
+static VOID
+GhashInit(PAES_CONTEXT Context, const UCHAR *H)
+{
+   ULONGLONG High, Low, Reduce;
+   ULONG i, j;
+
+   /* Table entry i holds H times the 4 bit polynomial i, bit 3 first */
+   High = LoadBe64(H);
+   Low = LoadBe64(H + 8);
+   Context->GhashTableHigh[0] = Context->GhashTableLow[0] = 0;
+   Context->GhashTableHigh[8] = High;
+   Context->GhashTableLow[8] = Low;
+   for (i = 4; i > 0; i >>= 1)
+   {
+      Reduce = (Low & 1) ? 0xE100000000000000ULL : 0;
+      Low = (High << 63) | (Low >> 1);
+      High = (High >> 1) ^ Reduce;
+      Context->GhashTableHigh[i] = High;
+      Context->GhashTableLow[i] = Low;
+   }
+   for (i = 2; i <= 8; i *= 2)
+   {
+      for (j = 1; j < i; j++)
+      {
+         Context->GhashTableHigh[i + j] = Context->GhashTableHigh[i] ^ Context->GhashTableHigh[j];
+         Context->GhashTableLow[i + j] = Context->GhashTableLow[i] ^ Context->GhashTableLow[j];
+      }
+   }
+
+   /* PCLMULQDQ works on the byte reversed value */
+   for (i = 0; i < 16; i++)
+      Context->GhashKey[0][i] = H[15 - i];
+   memset(Context->GhashKey[1], 0, AES_BLOCK_SIZE);
+   XorBlock(Context->GhashKey[1], Context->GhashKey[0], Context->GhashKey[0] + 8, 8);
+}
+
+/* Xi = Xi * H, four bits at a time */
+static VOID
+GhashMultiply(PAES_CONTEXT Context, UCHAR *Xi)
+{
+   ULONGLONG High, Low;
+   ULONG Nibble, Rem;
+   INT i;
+
+   Nibble = Xi[15] & 15;
+   High = Context->GhashTableHigh[Nibble];
+   Low = Context->GhashTableLow[Nibble];
+
+   for (i = 15; i >= 0; i--)
+   {
+      if (i != 15)
+      {
+         Nibble = Xi[i] & 15;
+         Rem = (ULONG)Low & 15;
+         Low = (High << 60) | (Low >> 4);
+         High = (High >> 4) ^ (GhashLast4[Rem] << 48);
+         High ^= Context->GhashTableHigh[Nibble];
+         Low ^= Context->GhashTableLow[Nibble];
+      }
+
+      Nibble = Xi[i] >> 4;
+      Rem = (ULONG)Low & 15;
+      Low = (High << 60) | (Low >> 4);
+      High = (High >> 4) ^ (GhashLast4[Rem] << 48);
+      High ^= Context->GhashTableHigh[Nibble];
+      Low ^= Context->GhashTableLow[Nibble];
+   }
+
+   StoreBe64(Xi, High);
+   StoreBe64(Xi + 8, Low);
+}
+
+/* Absorb Size bytes into Xi, zero padding the last block */
+static VOID
+Ghash(PAES_CONTEXT Context, UCHAR *Xi, const UCHAR *Data, SIZE_T Size)
+{
+   UCHAR Block[AES_BLOCK_SIZE];
+   SIZE_T Blocks = Size / AES_BLOCK_SIZE;
+
+#ifdef _M_AMD64
+   if (Context->Features & CRYPT_CPU_CLMUL)
+   {
+      if (Blocks)
+         GhashClmul(Xi, Context->GhashKey[0], Data, Blocks);
+      Data += Blocks * AES_BLOCK_SIZE;
+      Blocks = 0;
+   }
+#endif
+
+   while (Blocks--)
+   {
+      XorBlock(Xi, Xi, Data, AES_BLOCK_SIZE);
+      GhashMultiply(Context, Xi);
+      Data += AES_BLOCK_SIZE;
+   }
+
+   Size &= AES_BLOCK_SIZE - 1;
+   if (Size)
+   {
+      memset(Block, 0, sizeof(Block));
+      memcpy(Block, Data, Size);
+      Ghash(Context, Xi, Block, AES_BLOCK_SIZE);
+   }
+}
+
+/******************************************************************************
+ * AesSetKey
+ *
+ * Expand a 128, 192 or 256 bit key for all the functions below.
+ *
+ * RETURNS
+ *  FALSE if the key size is not supported
+ */
+BOOLEAN NTAPI
+AesSetKey(PAES_CONTEXT Context, const UCHAR *Key, ULONG KeySize)
+{
+   UCHAR H[AES_BLOCK_SIZE];
+   ULONG Index;
+
+   memset(Context, 0, sizeof(*Context));
+   if (aes_setup(Key, KeySize, 0, TABLE_KEY(Context)) != CRYPT_OK)
+      return FALSE;
+
+   Context->Rounds = TABLE_KEY(Context)->Nr;
+   Context->Features = CryptlibGetCpuFeatures();
+
+   /* The table code keeps the round keys as big endian words. AESDEC uses
+      the same equivalent inverse cipher schedule as the dK table. */
+   for (Index = 0; Index < 4 * (Context->Rounds + 1); Index++)
+   {
+      STORE32H(TABLE_KEY(Context)->eK[Index], (PUCHAR)Context->EncryptKeys + 4 * Index);
+      STORE32H(TABLE_KEY(Context)->dK[Index], (PUCHAR)Context->DecryptKeys + 4 * Index);
+   }
+
+   memset(H, 0, sizeof(H));
+   AesEncryptBlock(Context, H, H);
+   GhashInit(Context, H);
+
+   return TRUE;
+}
+
+/******************************************************************************
+ * AesEncryptEcb
+ */
+VOID NTAPI
+AesEncryptEcb(PAES_CONTEXT Context, const UCHAR *In, UCHAR *Out, SIZE_T Blocks)
+{
+#ifdef _M_AMD64
+   if (Context->Features & CRYPT_CPU_AES_NI)
+   {
+      if (Blocks)
+         AesNiEncryptEcb(Context->EncryptKeys[0], Context->Rounds, In, Out, Blocks);
+      return;
+   }
+#endif
+
+   while (Blocks--)
+   {
+      aes_ecb_encrypt(In, Out, TABLE_KEY(Context));
+      In += AES_BLOCK_SIZE;
+      Out += AES_BLOCK_SIZE;
+   }
+}
+
+/******************************************************************************
+ * AesDecryptEcb
+ */
+VOID NTAPI
+AesDecryptEcb(PAES_CONTEXT Context, const UCHAR *In, UCHAR *Out, SIZE_T Blocks)
+{
+#ifdef _M_AMD64
+   if (Context->Features & CRYPT_CPU_AES_NI)
+   {
+      if (Blocks)
+         AesNiDecryptEcb(Context->DecryptKeys[0], Context->Rounds, In, Out, Blocks);
+      return;
+   }
+#endif
+
+   while (Blocks--)
+   {
+      aes_ecb_decrypt(In, Out, TABLE_KEY(Context));
+      In += AES_BLOCK_SIZE;
+      Out += AES_BLOCK_SIZE;
+   }
+}
+
+/******************************************************************************
+ * AesEncryptCbc
+ *
+ * Iv is updated with the last ciphertext block, so that a message can be
+ * encrypted in several calls.
+ */
+VOID NTAPI
+AesEncryptCbc(PAES_CONTEXT Context, UCHAR *Iv, const UCHAR *In, UCHAR *Out, SIZE_T Blocks)
+{
+#ifdef _M_AMD64
+   if (Context->Features & CRYPT_CPU_AES_NI)
+   {
+      if (Blocks)
+         AesNiEncryptCbc(Context->EncryptKeys[0], Context->Rounds, In, Out, Blocks, Iv);
+      return;
+   }
+#endif
+
+   while (Blocks--)
+   {
+      XorBlock(Iv, Iv, In, AES_BLOCK_SIZE);
+      aes_ecb_encrypt(Iv, Out, TABLE_KEY(Context));
+      memcpy(Iv, Out, AES_BLOCK_SIZE);
+      In += AES_BLOCK_SIZE;
+      Out += AES_BLOCK_SIZE;
+   }
+}
+
+/******************************************************************************
+ * AesDecryptCbc
+ *
+ * In and Out may be the same buffer. Iv is updated with the last ciphertext
+ * block.
+ */
+VOID NTAPI
+AesDecryptCbc(PAES_CONTEXT Context, UCHAR *Iv, const UCHAR *In, UCHAR *Out, SIZE_T Blocks)
+{
+   UCHAR Block[AES_BLOCK_SIZE];
+
+#ifdef _M_AMD64
+   if (Context->Features & CRYPT_CPU_AES_NI)
+   {
+      if (Blocks)
+         AesNiDecryptCbc(Context->DecryptKeys[0], Context->Rounds, In, Out, Blocks, Iv);
+      return;
+   }
+#endif
+
+   while (Blocks--)
+   {
+      memcpy(Block, In, AES_BLOCK_SIZE);
+      aes_ecb_decrypt(Block, Out, TABLE_KEY(Context));
+      XorBlock(Out, Out, Iv, AES_BLOCK_SIZE);
+      memcpy(Iv, Block, AES_BLOCK_SIZE);
+      In += AES_BLOCK_SIZE;
+      Out += AES_BLOCK_SIZE;
+   }
+}
+
+/******************************************************************************
+ * AesCryptCtr
+ *
+ * Encrypt or decrypt in counter mode. Only the last 32 bits of the counter
+ * block are incremented, as a big endian number. Counter is updated to the
+ * next unused value; the rest of the key stream of a partial last block is
+ * thrown away, so only the last call for a message may have a Size which
+ * is not a multiple of the block size.
+ */
+VOID NTAPI
+AesCryptCtr(PAES_CONTEXT Context, UCHAR *Counter, const UCHAR *In, UCHAR *Out, SIZE_T Size)
+{
+   UCHAR KeyStream[AES_BLOCK_SIZE];
+   SIZE_T Blocks = Size / AES_BLOCK_SIZE;
+
+#ifdef _M_AMD64
+   if (Context->Features & CRYPT_CPU_AES_NI)
+   {
+      if (Blocks)
+         AesNiEncryptCtr32(Context->EncryptKeys[0], Context->Rounds, In, Out, Blocks, Counter);
+      In += Blocks * AES_BLOCK_SIZE;
+      Out += Blocks * AES_BLOCK_SIZE;
+      Blocks = 0;
+   }
+#endif
+
+   while (Blocks--)
+   {
+      aes_ecb_encrypt(Counter, KeyStream, TABLE_KEY(Context));
+      XorBlock(Out, In, KeyStream, AES_BLOCK_SIZE);
+      Increment32(Counter);
+      In += AES_BLOCK_SIZE;
+      Out += AES_BLOCK_SIZE;
+   }
+
+   Size &= AES_BLOCK_SIZE - 1;
+   if (Size)
+   {
+      AesEncryptBlock(Context, Counter, KeyStream);
+      XorBlock(Out, In, KeyStream, Size);
+      Increment32(Counter);
+   }
+}
+
+/* Pre-counter block J0 from the IV, see NIST SP 800-38D */
+static VOID
+GcmInitCounter(PAES_CONTEXT Context, const UCHAR *Iv, ULONG IvSize, UCHAR *Counter)
+{
+   UCHAR Lengths[AES_BLOCK_SIZE];
+
+   if (IvSize == 12)
+   {
+      memcpy(Counter, Iv, 12);
+      Counter[12] = Counter[13] = Counter[14] = 0;
+      Counter[15] = 1;
+      return;
+   }
+
+   memset(Counter, 0, AES_BLOCK_SIZE);
+   Ghash(Context, Counter, Iv, IvSize);
+   memset(Lengths, 0, sizeof(Lengths));
+   StoreBe64(Lengths + 8, (ULONGLONG)IvSize * 8);
+   Ghash(Context, Counter, Lengths, AES_BLOCK_SIZE);
+}
+
+static VOID
+GcmComputeTag(PAES_CONTEXT Context, const UCHAR *J0,
+              const UCHAR *AuthData, SIZE_T AuthDataSize,
+              const UCHAR *CipherText, SIZE_T Size, UCHAR *Tag)
+{
+   UCHAR Xi[AES_BLOCK_SIZE], Lengths[AES_BLOCK_SIZE];
+
+   memset(Xi, 0, sizeof(Xi));
+   Ghash(Context, Xi, AuthData, AuthDataSize);
+   Ghash(Context, Xi, CipherText, Size);
+   StoreBe64(Lengths, (ULONGLONG)AuthDataSize * 8);
+   StoreBe64(Lengths + 8, (ULONGLONG)Size * 8);
+   Ghash(Context, Xi, Lengths, AES_BLOCK_SIZE);
+
+   AesEncryptBlock(Context, J0, Tag);
+   XorBlock(Tag, Tag, Xi, AES_BLOCK_SIZE);
+}
+
+/******************************************************************************
+ * AesEncryptGcm
+ *
+ * Encrypt a whole message in Galois/Counter Mode and return the first
+ * TagSize bytes of its authentication tag.
+ */
+VOID NTAPI
+AesEncryptGcm(PAES_CONTEXT Context, const UCHAR *Iv, ULONG IvSize,
+              const UCHAR *AuthData, SIZE_T AuthDataSize,
+              const UCHAR *In, UCHAR *Out, SIZE_T Size,
+              UCHAR *Tag, ULONG TagSize)
+{
+   UCHAR J0[AES_BLOCK_SIZE], Counter[AES_BLOCK_SIZE], FullTag[AES_BLOCK_SIZE];
+
+   GcmInitCounter(Context, Iv, IvSize, J0);
+   memcpy(Counter, J0, AES_BLOCK_SIZE);
+   Increment32(Counter);
+
+   AesCryptCtr(Context, Counter, In, Out, Size);
+   GcmComputeTag(Context, J0, AuthData, AuthDataSize, Out, Size, FullTag);
+   memcpy(Tag, FullTag, MIN(TagSize, AES_BLOCK_SIZE));
+}
+
+/******************************************************************************
+ * AesDecryptGcm
+ *
+ * Check the authentication tag of a whole message and decrypt it. In and
+ * Out may be the same buffer.
+ *
+ * RETURNS
+ *  FALSE if the tag doesn't match, Out is zeroed then
+ */
+BOOLEAN NTAPI
+AesDecryptGcm(PAES_CONTEXT Context, const UCHAR *Iv, ULONG IvSize,
+              const UCHAR *AuthData, SIZE_T AuthDataSize,
+              const UCHAR *In, UCHAR *Out, SIZE_T Size,
+              const UCHAR *Tag, ULONG TagSize)
+{
+   UCHAR J0[AES_BLOCK_SIZE], Counter[AES_BLOCK_SIZE], FullTag[AES_BLOCK_SIZE];
+   UCHAR Difference = 0;
+   ULONG Index;
+
+   if (TagSize > AES_BLOCK_SIZE)
+      return FALSE;
+
+   GcmInitCounter(Context, Iv, IvSize, J0);
+   GcmComputeTag(Context, J0, AuthData, AuthDataSize, In, Size, FullTag);
+
+   memcpy(Counter, J0, AES_BLOCK_SIZE);
+   Increment32(Counter);
+   AesCryptCtr(Context, Counter, In, Out, Size);
+
+   /* Compare in constant time */
+   for (Index = 0; Index < TagSize; Index++)
+      Difference |= FullTag[Index] ^ Tag[Index];
+
+   if (Difference)
+   {
+      memset(Out, 0, Size);
+      return FALSE;
+   }
+
+   return TRUE;
+}
@@ -0,0 +1,64 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <ntdef.h>
+
+#define AES_BLOCK_SIZE 16
+
+/* Expanded AES key, for the AES-NI and the table driven code paths */
+typedef struct _AES_CONTEXT
+{
+   DECLSPEC_ALIGN(16) UCHAR EncryptKeys[15][AES_BLOCK_SIZE];
+   DECLSPEC_ALIGN(16) UCHAR DecryptKeys[15][AES_BLOCK_SIZE];
+
+   /* GCM hash key H byte reversed and the XOR of its halves, for PCLMULQDQ */
+   DECLSPEC_ALIGN(16) UCHAR GhashKey[2][AES_BLOCK_SIZE];
+
+   /* Multiples of H for the portable 4-bit table GHASH */
+   ULONGLONG GhashTableHigh[16];
+   ULONGLONG GhashTableLow[16];
+
+   /* Key schedule of the table driven implementation in aes.c */
+   ULONG TableKey[129];
+
+   ULONG Rounds;
+   ULONG Features;
+} AES_CONTEXT, *PAES_CONTEXT;
+
+BOOLEAN NTAPI
+AesSetKey(PAES_CONTEXT Context, const UCHAR *Key, ULONG KeySize);
+
+VOID NTAPI
+AesEncryptEcb(PAES_CONTEXT Context, const UCHAR *In, UCHAR *Out, SIZE_T Blocks);
+
+VOID NTAPI
+AesDecryptEcb(PAES_CONTEXT Context, const UCHAR *In, UCHAR *Out, SIZE_T Blocks);
+
+VOID NTAPI
+AesEncryptCbc(PAES_CONTEXT Context, UCHAR *Iv, const UCHAR *In, UCHAR *Out, SIZE_T Blocks);
+
+VOID NTAPI
+AesDecryptCbc(PAES_CONTEXT Context, UCHAR *Iv, const UCHAR *In, UCHAR *Out, SIZE_T Blocks);
+
+VOID NTAPI
+AesCryptCtr(PAES_CONTEXT Context, UCHAR *Counter, const UCHAR *In, UCHAR *Out, SIZE_T Size);
+
+VOID NTAPI
+AesEncryptGcm(PAES_CONTEXT Context, const UCHAR *Iv, ULONG IvSize,
+              const UCHAR *AuthData, SIZE_T AuthDataSize,
+              const UCHAR *In, UCHAR *Out, SIZE_T Size,
+              UCHAR *Tag, ULONG TagSize);
+
+BOOLEAN NTAPI
+AesDecryptGcm(PAES_CONTEXT Context, const UCHAR *Iv, ULONG IvSize,
+              const UCHAR *AuthData, SIZE_T AuthDataSize,
+              const UCHAR *In, UCHAR *Out, SIZE_T Size,
+              const UCHAR *Tag, ULONG TagSize);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,69 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Detection of the instruction set extensions used for crypto
+ */
+
+#include "cryptcpu.h"
+
+#ifdef _M_AMD64
+#include <intrin.h>
+#endif
+
+#define CRYPT_CPU_UNKNOWN 0x80000000
+
+static volatile ULONG CryptCpuFeatures = CRYPT_CPU_UNKNOWN;
+
+/******************************************************************************
+ * CryptlibGetCpuFeatures
+ *
+ * Return the CRYPT_CPU_* flags for the accelerated code paths that can be
+ * used on this processor. The result is computed on the first call; racing
+ * callers compute the same value.
+ *
+ * RETURNS
+ *  Combination of CRYPT_CPU_* flags, 0 if only portable code can be used
+ */
+ULONG NTAPI
+CryptlibGetCpuFeatures(VOID)
+{
+    ULONG Features = CryptCpuFeatures;
+#ifdef _M_AMD64
+    INT CpuInfo[4];
+    ULONG MaxLeaf, Ecx1, Ebx7 = 0;
+#endif
+
+    if (Features != CRYPT_CPU_UNKNOWN)
+        return Features;
+
+    Features = 0;
+
+#ifdef _M_AMD64
+    __cpuid(CpuInfo, 0);
+    MaxLeaf = CpuInfo[0];
+
+    __cpuid(CpuInfo, 1);
+    Ecx1 = CpuInfo[2];
+
+    if (MaxLeaf >= 7)
+    {
+        __cpuidex(CpuInfo, 7, 0);
+        Ebx7 = CpuInfo[1];
+    }
+
+    /* The assembly code uses PSHUFB, PALIGNR and PINSRD next to the
+       crypto instructions, so SSSE3 and SSE4.1 are required as well */
+    if ((Ecx1 & (1 << 9)) && (Ecx1 & (1 << 19)))
+    {
+        if (Ecx1 & (1 << 25))
+            Features |= CRYPT_CPU_AES_NI;
+        if (Ecx1 & (1 << 1))
+            Features |= CRYPT_CPU_CLMUL;
+        if (Ebx7 & (1 << 29))
+            Features |= CRYPT_CPU_SHA_NI;
+    }
+#endif
+
+    CryptCpuFeatures = Features;
+    return Features;
+}
@@ -0,0 +1,37 @@
+
+#pragma once
+
+#include <ntdef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Instruction set extensions usable by the accelerated code paths.
+   Each of them is only reported together with SSSE3 and SSE4.1. */
+#define CRYPT_CPU_AES_NI    0x00000001
+#define CRYPT_CPU_CLMUL     0x00000002
+#define CRYPT_CPU_SHA_NI    0x00000004
+
+ULONG NTAPI
+CryptlibGetCpuFeatures(VOID);
+
+#ifdef _M_AMD64
+
+/* amd64/aesni.S */
+VOID AesNiEncryptEcb(const UCHAR *Keys, ULONG Rounds, const UCHAR *In, UCHAR *Out, SIZE_T Blocks);
+VOID AesNiDecryptEcb(const UCHAR *Keys, ULONG Rounds, const UCHAR *In, UCHAR *Out, SIZE_T Blocks);
+VOID AesNiEncryptCbc(const UCHAR *Keys, ULONG Rounds, const UCHAR *In, UCHAR *Out, SIZE_T Blocks, UCHAR *Iv);
+VOID AesNiDecryptCbc(const UCHAR *Keys, ULONG Rounds, const UCHAR *In, UCHAR *Out, SIZE_T Blocks, UCHAR *Iv);
+VOID AesNiEncryptCtr32(const UCHAR *Keys, ULONG Rounds, const UCHAR *In, UCHAR *Out, SIZE_T Blocks, UCHAR *Counter);
+VOID GhashClmul(UCHAR *Xi, const UCHAR *Key, const UCHAR *Data, SIZE_T Blocks);
+
+/* amd64/sha.S */
+VOID Sha1TransformShaNi(ULONG State[5], const UCHAR *Data, SIZE_T Blocks);
+VOID Sha256TransformShaNi(ULONG State[8], const UCHAR *Data, SIZE_T Blocks, const ULONG *K);
+
+#endif /* _M_AMD64 */
+
+#ifdef __cplusplus
+}
+#endif
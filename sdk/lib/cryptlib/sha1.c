@@ -18,6 +18,7 @@
  */
 
 #include "sha1.h"
+#include "cryptcpu.h"
 
 /* SHA1 Helper Macros */
 
@@ -140,6 +141,28 @@ A_SHAUpdate(PSHA_CTX Context, const unsigned char *Buffer, ULONG BufferSize)
       memcpy(&Context->Buffer[BufferContentSize], Buffer,
                     BufferSize);
    }
+#ifdef _M_AMD64
+   else if (CryptlibGetCpuFeatures() & CRYPT_CPU_SHA_NI)
+   {
+      SIZE_T Blocks;
+
+      /* The SHA-NI transform leaves its input alone, so full blocks are
+         hashed straight from the caller's buffer */
+      if (BufferContentSize)
+      {
+         memcpy(Context->Buffer + BufferContentSize, Buffer,
+                       64 - BufferContentSize);
+         Buffer += 64 - BufferContentSize;
+         BufferSize -= 64 - BufferContentSize;
+         Sha1TransformShaNi(Context->State, Context->Buffer, 1);
+      }
+
+      Blocks = BufferSize / 64;
+      if (Blocks)
+         Sha1TransformShaNi(Context->State, Buffer, Blocks);
+      memcpy(Context->Buffer, Buffer + Blocks * 64, BufferSize & 63);
+   }
+#endif
    else
    {
       while (BufferContentSize + BufferSize >= 64)
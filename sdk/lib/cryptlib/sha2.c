@@ -0,0 +1,427 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     SHA-256, SHA-384 and SHA-512 (FIPS 180-4)
+ */
+
+#include <string.h>
+
+#include "sha2.h"
+#include "cryptcpu.h"
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define CH(x, y, z)  ((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+
+#define SIGMA256_0(x) (ROR32(x, 2) ^ ROR32(x, 13) ^ ROR32(x, 22))
+#define SIGMA256_1(x) (ROR32(x, 6) ^ ROR32(x, 11) ^ ROR32(x, 25))
+#define GAMMA256_0(x) (ROR32(x, 7) ^ ROR32(x, 18) ^ ((x) >> 3))
+#define GAMMA256_1(x) (ROR32(x, 17) ^ ROR32(x, 19) ^ ((x) >> 10))
+
+#define SIGMA512_0(x) (ROR64(x, 28) ^ ROR64(x, 34) ^ ROR64(x, 39))
+#define SIGMA512_1(x) (ROR64(x, 14) ^ ROR64(x, 18) ^ ROR64(x, 41))
+#define GAMMA512_0(x) (ROR64(x, 1) ^ ROR64(x, 8) ^ ((x) >> 7))
+#define GAMMA512_1(x) (ROR64(x, 19) ^ ROR64(x, 61) ^ ((x) >> 6))
+
+static ULONG
+LoadBe32(const UCHAR *p)
+{
+   return ((ULONG)p[0] << 24) | ((ULONG)p[1] << 16) | ((ULONG)p[2] << 8) | p[3];
+}
+
+static ULONGLONG
+LoadBe64(const UCHAR *p)
+{
+   return ((ULONGLONG)LoadBe32(p) << 32) | LoadBe32(p + 4);
+}
+
+static VOID
+StoreBe32(UCHAR *p, ULONG Value)
+{
+   p[0] = (UCHAR)(Value >> 24);
+   p[1] = (UCHAR)(Value >> 16);
+   p[2] = (UCHAR)(Value >> 8);
+   p[3] = (UCHAR)Value;
+}
+
+static VOID
+StoreBe64(UCHAR *p, ULONGLONG Value)
+{
+   StoreBe32(p, (ULONG)(Value >> 32));
+   StoreBe32(p + 4, (ULONG)Value);
+}
+
+static const ULONG Sha256InitialState[8] =
+{
+   0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+   0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+/* Also read 16 bytes at a time by the assembly code */
+static const ULONG Sha256K[64] =
+{
+   0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+   0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+   0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+   0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+   0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+   0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+   0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+   0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static const ULONGLONG Sha384InitialState[8] =
+{
+   0xCBBB9D5DC1059ED8ULL, 0x629A292A367CD507ULL, 0x9159015A3070DD17ULL, 0x152FECD8F70E5939ULL,
+   0x67332667FFC00B31ULL, 0x8EB44A8768581511ULL, 0xDB0C2E0D64F98FA7ULL, 0x47B5481DBEFA4FA4ULL
+};
+
+static const ULONGLONG Sha512InitialState[8] =
+{
+   0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL, 0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+   0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL, 0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL
+};
+
+static const ULONGLONG Sha512K[80] =
+{
+   0x428A2F98D728AE22ULL, 0x7137449123EF65CDULL, 0xB5C0FBCFEC4D3B2FULL, 0xE9B5DBA58189DBBCULL,
+   0x3956C25BF348B538ULL, 0x59F111F1B605D019ULL, 0x923F82A4AF194F9BULL, 0xAB1C5ED5DA6D8118ULL,
+   0xD807AA98A3030242ULL, 0x12835B0145706FBEULL, 0x243185BE4EE4B28CULL, 0x550C7DC3D5FFB4E2ULL,
+   0x72BE5D74F27B896FULL, 0x80DEB1FE3B1696B1ULL, 0x9BDC06A725C71235ULL, 0xC19BF174CF692694ULL,
+   0xE49B69C19EF14AD2ULL, 0xEFBE4786384F25E3ULL, 0x0FC19DC68B8CD5B5ULL, 0x240CA1CC77AC9C65ULL,
+   0x2DE92C6F592B0275ULL, 0x4A7484AA6EA6E483ULL, 0x5CB0A9DCBD41FBD4ULL, 0x76F988DA831153B5ULL,
+   0x983E5152EE66DFABULL, 0xA831C66D2DB43210ULL, 0xB00327C898FB213FULL, 0xBF597FC7BEEF0EE4ULL,
+   0xC6E00BF33DA88FC2ULL, 0xD5A79147930AA725ULL, 0x06CA6351E003826FULL, 0x142929670A0E6E70ULL,
+   0x27B70A8546D22FFCULL, 0x2E1B21385C26C926ULL, 0x4D2C6DFC5AC42AEDULL, 0x53380D139D95B3DFULL,
+   0x650A73548BAF63DEULL, 0x766A0ABB3C77B2A8ULL, 0x81C2C92E47EDAEE6ULL, 0x92722C851482353BULL,
+   0xA2BFE8A14CF10364ULL, 0xA81A664BBC423001ULL, 0xC24B8B70D0F89791ULL, 0xC76C51A30654BE30ULL,
+   0xD192E819D6EF5218ULL, 0xD69906245565A910ULL, 0xF40E35855771202AULL, 0x106AA07032BBD1B8ULL,
+   0x19A4C116B8D2D0C8ULL, 0x1E376C085141AB53ULL, 0x2748774CDF8EEB99ULL, 0x34B0BCB5E19B48A8ULL,
+   0x391C0CB3C5C95A63ULL, 0x4ED8AA4AE3418ACBULL, 0x5B9CCA4F7763E373ULL, 0x682E6FF3D6B2B8A3ULL,
+   0x748F82EE5DEFB2FCULL, 0x78A5636F43172F60ULL, 0x84C87814A1F0AB72ULL, 0x8CC702081A6439ECULL,
+   0x90BEFFFA23631E28ULL, 0xA4506CEBDE82BDE9ULL, 0xBEF9A3F7B2C67915ULL, 0xC67178F2E372532BULL,
+   0xCA273ECEEA26619CULL, 0xD186B8C721C0C207ULL, 0xEADA7DD6CDE0EB1EULL, 0xF57D4F7FEE6ED178ULL,
+   0x06F067AA72176FBAULL, 0x0A637DC5A2C898A6ULL, 0x113F9804BEF90DAEULL, 0x1B710B35131C471BULL,
+   0x28DB77F523047D84ULL, 0x32CAAB7B40C72493ULL, 0x3C9EBE0A15C9BEBCULL, 0x431D67C49C100D4CULL,
+   0x4CC5D4BECB3E42B6ULL, 0x597F299CFC657E2AULL, 0x5FCB6FAB3AD6FAECULL, 0x6C44198C4A475817ULL
+};
+
+static VOID
+Sha256TransformPortable(ULONG State[8], const UCHAR *Data, SIZE_T Blocks)
+{
+   ULONG W[64];
+   ULONG a, b, c, d, e, f, g, h, T1, T2;
+   INT i;
+
+   while (Blocks--)
+   {
+      for (i = 0; i < 16; i++)
+         W[i] = LoadBe32(Data + 4 * i);
+      for (i = 16; i < 64; i++)
+         W[i] = GAMMA256_1(W[i - 2]) + W[i - 7] + GAMMA256_0(W[i - 15]) + W[i - 16];
+
+      a = State[0];
+      b = State[1];
+      c = State[2];
+      d = State[3];
+      e = State[4];
+      f = State[5];
+      g = State[6];
+      h = State[7];
+
+      for (i = 0; i < 64; i++)
+      {
+         T1 = h + SIGMA256_1(e) + CH(e, f, g) + Sha256K[i] + W[i];
+         T2 = SIGMA256_0(a) + MAJ(a, b, c);
+         h = g;
+         g = f;
+         f = e;
+         e = d + T1;
+         d = c;
+         c = b;
+         b = a;
+         a = T1 + T2;
+      }
+
+      State[0] += a;
+      State[1] += b;
+      State[2] += c;
+      State[3] += d;
+      State[4] += e;
+      State[5] += f;
+      State[6] += g;
+      State[7] += h;
+
+      Data += 64;
+   }
+}
+
+static VOID
+Sha256Transform(ULONG State[8], const UCHAR *Data, SIZE_T Blocks)
+{
+#ifdef _M_AMD64
+   if (CryptlibGetCpuFeatures() & CRYPT_CPU_SHA_NI)
+   {
+      Sha256TransformShaNi(State, Data, Blocks, Sha256K);
+      return;
+   }
+#endif
+   Sha256TransformPortable(State, Data, Blocks);
+}
+
+static VOID
+Sha512Transform(ULONGLONG State[8], const UCHAR *Data, SIZE_T Blocks)
+{
+   ULONGLONG W[80];
+   ULONGLONG a, b, c, d, e, f, g, h, T1, T2;
+   INT i;
+
+   while (Blocks--)
+   {
+      for (i = 0; i < 16; i++)
+         W[i] = LoadBe64(Data + 8 * i);
+      for (i = 16; i < 80; i++)
+         W[i] = GAMMA512_1(W[i - 2]) + W[i - 7] + GAMMA512_0(W[i - 15]) + W[i - 16];
+
+      a = State[0];
+      b = State[1];
+      c = State[2];
+      d = State[3];
+      e = State[4];
+      f = State[5];
+      g = State[6];
+      h = State[7];
+
+      for (i = 0; i < 80; i++)
+      {
+         T1 = h + SIGMA512_1(e) + CH(e, f, g) + Sha512K[i] + W[i];
+         T2 = SIGMA512_0(a) + MAJ(a, b, c);
+         h = g;
+         g = f;
+         f = e;
+         e = d + T1;
+         d = c;
+         c = b;
+         b = a;
+         a = T1 + T2;
+      }
+
+      State[0] += a;
+      State[1] += b;
+      State[2] += c;
+      State[3] += d;
+      State[4] += e;
+      State[5] += f;
+      State[6] += g;
+      State[7] += h;
+
+      Data += 128;
+   }
+}
+
+/******************************************************************************
+ * SHA256Init
+ *
+ * Initialize a SHA-256 context structure.
+ */
+VOID NTAPI
+SHA256Init(PSHA256_CTX Context)
+{
+   memcpy(Context->State, Sha256InitialState, sizeof(Context->State));
+   Context->Count = 0;
+}
+
+/******************************************************************************
+ * SHA256Update
+ *
+ * Hash the supplied data. Full blocks are hashed straight from the caller's
+ * buffer, so the accelerated transform sees long runs of blocks.
+ */
+VOID NTAPI
+SHA256Update(PSHA256_CTX Context, const unsigned char *Buffer, ULONG BufferSize)
+{
+   ULONG BufferContentSize, Fill;
+   SIZE_T Blocks;
+
+   BufferContentSize = (ULONG)(Context->Count & 63);
+   Context->Count += BufferSize;
+
+   if (BufferContentSize)
+   {
+      Fill = 64 - BufferContentSize;
+      if (BufferSize < Fill)
+      {
+         memcpy(Context->Buffer + BufferContentSize, Buffer, BufferSize);
+         return;
+      }
+
+      memcpy(Context->Buffer + BufferContentSize, Buffer, Fill);
+      Sha256Transform(Context->State, Context->Buffer, 1);
+      Buffer += Fill;
+      BufferSize -= Fill;
+   }
+
+   Blocks = BufferSize / 64;
+   if (Blocks)
+   {
+      Sha256Transform(Context->State, Buffer, Blocks);
+      Buffer += Blocks * 64;
+      BufferSize &= 63;
+   }
+
+   memcpy(Context->Buffer, Buffer, BufferSize);
+}
+
+/******************************************************************************
+ * SHA256Final
+ *
+ * Finalize the SHA-256 context and store the 32 byte digest. The context is
+ * reinitialized.
+ */
+VOID NTAPI
+SHA256Final(PSHA256_CTX Context, PUCHAR Digest)
+{
+   ULONG BufferContentSize, Index;
+
+   BufferContentSize = (ULONG)(Context->Count & 63);
+   Context->Buffer[BufferContentSize++] = 0x80;
+   if (BufferContentSize > 56)
+   {
+      memset(Context->Buffer + BufferContentSize, 0, 64 - BufferContentSize);
+      Sha256Transform(Context->State, Context->Buffer, 1);
+      BufferContentSize = 0;
+   }
+
+   memset(Context->Buffer + BufferContentSize, 0, 56 - BufferContentSize);
+   StoreBe64(Context->Buffer + 56, Context->Count << 3);
+   Sha256Transform(Context->State, Context->Buffer, 1);
+
+   for (Index = 0; Index < 8; Index++)
+      StoreBe32(Digest + 4 * Index, Context->State[Index]);
+
+   SHA256Init(Context);
+}
+
+/******************************************************************************
+ * SHA384Init
+ *
+ * Initialize a SHA-384 context structure. SHA-384 uses SHA512Update.
+ */
+VOID NTAPI
+SHA384Init(PSHA384_CTX Context)
+{
+   memcpy(Context->State, Sha384InitialState, sizeof(Context->State));
+   Context->Count[0] = Context->Count[1] = 0;
+}
+
+/******************************************************************************
+ * SHA512Init
+ *
+ * Initialize a SHA-512 context structure.
+ */
+VOID NTAPI
+SHA512Init(PSHA512_CTX Context)
+{
+   memcpy(Context->State, Sha512InitialState, sizeof(Context->State));
+   Context->Count[0] = Context->Count[1] = 0;
+}
+
+/******************************************************************************
+ * SHA512Update
+ *
+ * Hash the supplied data with SHA-512 or SHA-384.
+ */
+VOID NTAPI
+SHA512Update(PSHA512_CTX Context, const unsigned char *Buffer, ULONG BufferSize)
+{
+   ULONG BufferContentSize, Fill;
+   SIZE_T Blocks;
+
+   BufferContentSize = (ULONG)(Context->Count[0] & 127);
+   Context->Count[0] += BufferSize;
+   if (Context->Count[0] < BufferSize)
+      Context->Count[1]++;
+
+   if (BufferContentSize)
+   {
+      Fill = 128 - BufferContentSize;
+      if (BufferSize < Fill)
+      {
+         memcpy(Context->Buffer + BufferContentSize, Buffer, BufferSize);
+         return;
+      }
+
+      memcpy(Context->Buffer + BufferContentSize, Buffer, Fill);
+      Sha512Transform(Context->State, Context->Buffer, 1);
+      Buffer += Fill;
+      BufferSize -= Fill;
+   }
+
+   Blocks = BufferSize / 128;
+   if (Blocks)
+   {
+      Sha512Transform(Context->State, Buffer, Blocks);
+      Buffer += Blocks * 128;
+      BufferSize &= 127;
+   }
+
+   memcpy(Context->Buffer, Buffer, BufferSize);
+}
+
+static VOID
+Sha512Pad(PSHA512_CTX Context)
+{
+   ULONG BufferContentSize;
+
+   BufferContentSize = (ULONG)(Context->Count[0] & 127);
+   Context->Buffer[BufferContentSize++] = 0x80;
+   if (BufferContentSize > 112)
+   {
+      memset(Context->Buffer + BufferContentSize, 0, 128 - BufferContentSize);
+      Sha512Transform(Context->State, Context->Buffer, 1);
+      BufferContentSize = 0;
+   }
+
+   memset(Context->Buffer + BufferContentSize, 0, 112 - BufferContentSize);
+   StoreBe64(Context->Buffer + 112, (Context->Count[1] << 3) | (Context->Count[0] >> 61));
+   StoreBe64(Context->Buffer + 120, Context->Count[0] << 3);
+   Sha512Transform(Context->State, Context->Buffer, 1);
+}
+
+/******************************************************************************
+ * SHA384Final
+ *
+ * Finalize the SHA-384 context and store the 48 byte digest. The context is
+ * reinitialized.
+ */
+VOID NTAPI
+SHA384Final(PSHA384_CTX Context, PUCHAR Digest)
+{
+   ULONG Index;
+
+   Sha512Pad(Context);
+   for (Index = 0; Index < 6; Index++)
+      StoreBe64(Digest + 8 * Index, Context->State[Index]);
+
+   SHA384Init(Context);
+}
+
+/******************************************************************************
+ * SHA512Final
+ *
+ * Finalize the SHA-512 context and store the 64 byte digest. The context is
+ * reinitialized.
+ */
+VOID NTAPI
+SHA512Final(PSHA512_CTX Context, PUCHAR Digest)
+{
+   ULONG Index;
+
+   Sha512Pad(Context);
+   for (Index = 0; Index < 8; Index++)
+      StoreBe64(Digest + 8 * Index, Context->State[Index]);
+
+   SHA512Init(Context);
+}
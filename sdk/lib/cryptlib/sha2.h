@@ -0,0 +1,58 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <ntdef.h>
+
+#define SHA256_DIGEST_LENGTH 32
+#define SHA384_DIGEST_LENGTH 48
+#define SHA512_DIGEST_LENGTH 64
+
+typedef struct
+{
+   ULONG State[8];
+   ULONGLONG Count;
+   UCHAR Buffer[64];
+} SHA256_CTX, *PSHA256_CTX;
+
+typedef struct
+{
+   ULONGLONG State[8];
+   ULONGLONG Count[2];
+   UCHAR Buffer[128];
+} SHA512_CTX, *PSHA512_CTX;
+
+typedef SHA512_CTX SHA384_CTX, *PSHA384_CTX;
+
+VOID NTAPI
+SHA256Init(PSHA256_CTX Context);
+
+VOID NTAPI
+SHA256Update(PSHA256_CTX Context, const unsigned char *Buffer, ULONG BufferSize);
+
+VOID NTAPI
+SHA256Final(PSHA256_CTX Context, PUCHAR Digest);
+
+VOID NTAPI
+SHA384Init(PSHA384_CTX Context);
+
+#define SHA384Update SHA512Update
+
+VOID NTAPI
+SHA384Final(PSHA384_CTX Context, PUCHAR Digest);
+
+VOID NTAPI
+SHA512Init(PSHA512_CTX Context);
+
+VOID NTAPI
+SHA512Update(PSHA512_CTX Context, const unsigned char *Buffer, ULONG BufferSize);
+
+VOID NTAPI
+SHA512Final(PSHA512_CTX Context, PUCHAR Digest);
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,6 +12,22 @@
 
 NEIGHBOR_CACHE_TABLE NeighborCache[NB_HASHMASK + 1];
 
+static __inline UINT NBHashAddress(PIP_ADDRESS Address)
+{
+    PULONG Words = (PULONG)&Address->Address;
+    ULONG HashValue = Words[0];
+
+    if (Address->Type == IP_ADDRESS_V6)
+        HashValue ^= Words[1] ^ Words[2] ^ Words[3];
+
+    /* Fold every octet into the bucket index, hosts on one subnet
+     * only differ in the low octets */
+    HashValue ^= HashValue >> 16;
+    HashValue ^= HashValue >> 8;
+
+    return HashValue & NB_HASHMASK;
+}
+
 VOID NBCompleteSend( PVOID Context,
 		     PNDIS_PACKET NdisPacket,
 		     NDIS_STATUS Status ) {
@@ -32,11 +48,7 @@ VOID NBSendPackets( PNEIGHBOR_CACHE_ENTRY NCE ) {
 
     ASSERT(!(NCE->State & NUD_INCOMPLETE));
 
-    HashValue  = *(PULONG)(&NCE->Address.Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
+    HashValue = NBHashAddress(&NCE->Address);
 
     /* Send any waiting packets */
     while ((PacketEntry = ExInterlockedRemoveHeadList(&NCE->PacketQueue,
@@ -327,11 +339,7 @@ PNEIGHBOR_CACHE_ENTRY NBAddNeighbor(
 
   TI_DbgPrint(MID_TRACE,("NCE: %x\n", NCE));
 
-  HashValue = *(PULONG)&Address->Address;
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(Address);
 
   TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -362,11 +370,7 @@ VOID NBUpdateNeighbor(
 
     TI_DbgPrint(DEBUG_NCACHE, ("Called. NCE (0x%X)  LinkAddress (0x%X)  State (0x%X).\n", NCE, LinkAddress, State));
 
-    HashValue  = *(PULONG)(&NCE->Address.Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
+    HashValue = NBHashAddress(&NCE->Address);
 
     TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -392,11 +396,7 @@ NBResetNeighborTimeout(PIP_ADDRESS Address)
 
     TI_DbgPrint(DEBUG_NCACHE, ("Resetting NCE timout for 0x%s\n", A2S(Address)));
 
-    HashValue  = *(PULONG)(&Address->Address);
-    HashValue ^= HashValue >> 16;
-    HashValue ^= HashValue >> 8;
-    HashValue ^= HashValue >> 4;
-    HashValue &= NB_HASHMASK;
+    HashValue = NBHashAddress(Address);
 
     TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -436,11 +436,7 @@ PNEIGHBOR_CACHE_ENTRY NBLocateNeighbor(
 
   TI_DbgPrint(DEBUG_NCACHE, ("Called. Address (0x%X).\n", Address));
 
-  HashValue = *(PULONG)&Address->Address;
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(Address);
 
   TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -566,11 +562,7 @@ BOOLEAN NBQueuePacket(
 
   /* FIXME: Should we limit the number of queued packets? */
 
-  HashValue  = *(PULONG)(&NCE->Address.Address);
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(&NCE->Address);
 
   TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
@@ -604,11 +596,7 @@ VOID NBRemoveNeighbor(
 
   TI_DbgPrint(DEBUG_NCACHE, ("Called. NCE (0x%X).\n", NCE));
 
-  HashValue  = *(PULONG)(&NCE->Address.Address);
-  HashValue ^= HashValue >> 16;
-  HashValue ^= HashValue >> 8;
-  HashValue ^= HashValue >> 4;
-  HashValue &= NB_HASHMASK;
+  HashValue = NBHashAddress(&NCE->Address);
 
   TcpipAcquireSpinLock(&NeighborCache[HashValue].Lock, &OldIrql);
 
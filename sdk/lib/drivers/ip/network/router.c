@@ -16,6 +16,9 @@
 
 LIST_ENTRY FIBListHead;
 KSPIN_LOCK FIBLock;
+PFIB_NODE FIBRoot[2];         /* Routing tries for IPv4 and IPv6 */
+ULONG FIBGeneration;          /* Changes whenever a route is added or removed */
+ROUTE_CACHE_ENTRY RouteCache[ROUTE_CACHE_SIZE];
 
 void RouterDumpRoutes() {
     PLIST_ENTRY CurrentEntry;
@@ -42,6 +45,358 @@ void RouterDumpRoutes() {
     TI_DbgPrint(DEBUG_ROUTER,("Dumping Routes ... Done\n"));
 }
 
+static UINT FIBAddressBits(
+    PIP_ADDRESS Address)
+{
+    return (Address->Type == IP_ADDRESS_V4) ? 32 : 128;
+}
+
+
+static PFIB_NODE *FIBRootLink(
+    PIP_ADDRESS Address)
+{
+    return &FIBRoot[(Address->Type == IP_ADDRESS_V4) ? 0 : 1];
+}
+
+
+static UINT FIBAddressBit(
+    PIP_ADDRESS Address,
+    UINT Bit)
+/*
+ * FUNCTION: Returns one bit of an address, counting from the most significant
+ */
+{
+    PUCHAR Bytes = (PUCHAR)&Address->Address;
+
+    return (Bytes[Bit >> 3] >> (7 - (Bit & 7))) & 1;
+}
+
+
+static UINT FIBMatchLength(
+    PIP_ADDRESS Address1,
+    PIP_ADDRESS Address2,
+    UINT MaxLength)
+/*
+ * FUNCTION: Computes the length of the prefix common to two addresses
+ * ARGUMENTS:
+ *     Address1  = Pointer to first address
+ *     Address2  = Pointer to second address
+ *     MaxLength = Number of bits to compare at most
+ * RETURNS:
+ *     Length of common prefix, at most MaxLength
+ */
+{
+    PUCHAR Addr1 = (PUCHAR)&Address1->Address;
+    PUCHAR Addr2 = (PUCHAR)&Address2->Address;
+    UINT Length = 0;
+    UCHAR Diff;
+
+    while (Length < MaxLength) {
+        Diff = Addr1[Length >> 3] ^ Addr2[Length >> 3];
+        if (Diff) {
+            /* Count the matching bits of the first differing byte */
+            while (!(Diff & 0x80)) {
+                Diff <<= 1;
+                Length++;
+            }
+            break;
+        }
+        Length += 8;
+    }
+
+    return min(Length, MaxLength);
+}
+
+
+static VOID FIBMaskAddress(
+    PIP_ADDRESS Target,
+    PIP_ADDRESS Address,
+    UINT Length)
+/*
+ * FUNCTION: Copies an address, clearing all bits after the prefix
+ */
+{
+    PUCHAR Bytes;
+    UINT i;
+
+    *Target = *Address;
+    Bytes = (PUCHAR)&Target->Address;
+
+    for (i = 0; i < FIBAddressBits(Address) / 8; i++) {
+        if (Length <= 8 * i)
+            Bytes[i] = 0;
+        else if (Length < 8 * (i + 1))
+            Bytes[i] &= (UCHAR)(0xFF << (8 * (i + 1) - Length));
+    }
+}
+
+
+static VOID FIBChanged(
+    VOID)
+/*
+ * FUNCTION: Invalidates the route cache after a FIB change
+ * NOTES:
+ *     The forward information base lock must be held when called
+ */
+{
+    /* Generation 0 is never current, so unused cache entries never match */
+    if (++FIBGeneration == 0)
+        FIBGeneration = 1;
+}
+
+
+static PFIB_NODE FIBAllocateNode(
+    PIP_ADDRESS Prefix,
+    UINT PrefixLength,
+    PFIB_NODE Parent)
+{
+    PFIB_NODE Node;
+
+    Node = ExAllocatePoolWithTag(NonPagedPool, sizeof(FIB_NODE), FIB_TAG);
+    if (!Node)
+        return NULL;
+
+    RtlZeroMemory(Node, sizeof(FIB_NODE));
+    FIBMaskAddress(&Node->Prefix, Prefix, PrefixLength);
+    Node->PrefixLength = PrefixLength;
+    Node->Parent = Parent;
+    InitializeListHead(&Node->FIBList);
+
+    return Node;
+}
+
+
+static PFIB_NODE *FIBNodeLink(
+    PFIB_NODE Node)
+/*
+ * FUNCTION: Returns the pointer that links a node into its trie
+ */
+{
+    if (!Node->Parent)
+        return FIBRootLink(&Node->Prefix);
+
+    return &Node->Parent->Child[Node->Parent->Child[1] == Node];
+}
+
+
+static PFIB_NODE FIBFindNode(
+    PIP_ADDRESS Prefix,
+    UINT PrefixLength)
+/*
+ * FUNCTION: Finds the trie node for a prefix
+ * ARGUMENTS:
+ *     Prefix       = Pointer to network address
+ *     PrefixLength = Number of significant bits in Prefix
+ * RETURNS:
+ *     Pointer to node, NULL if the prefix has none
+ * NOTES:
+ *     The forward information base lock must be held when called
+ */
+{
+    PFIB_NODE Node = *FIBRootLink(Prefix);
+
+    while (Node && Node->PrefixLength <= PrefixLength) {
+        if (FIBMatchLength(Prefix, &Node->Prefix, Node->PrefixLength) < Node->PrefixLength)
+            return NULL;
+
+        if (Node->PrefixLength == PrefixLength)
+            return Node;
+
+        Node = Node->Child[FIBAddressBit(Prefix, Node->PrefixLength)];
+    }
+
+    return NULL;
+}
+
+
+static PFIB_NODE FIBInsertNode(
+    PIP_ADDRESS Prefix,
+    UINT PrefixLength)
+/*
+ * FUNCTION: Finds or creates the trie node for a prefix
+ * ARGUMENTS:
+ *     Prefix       = Pointer to network address
+ *     PrefixLength = Number of significant bits in Prefix
+ * RETURNS:
+ *     Pointer to node, NULL if out of resources
+ * NOTES:
+ *     The forward information base lock must be held when called
+ */
+{
+    PFIB_NODE *Link = FIBRootLink(Prefix);
+    PFIB_NODE Node, Parent = NULL, NewNode, Glue;
+    UINT Length = 0;
+
+    /* Walk down as long as the nodes cover a part of our prefix */
+    while ((Node = *Link) != NULL) {
+        Length = FIBMatchLength(Prefix, &Node->Prefix,
+                                min(PrefixLength, Node->PrefixLength));
+        if (Length < Node->PrefixLength)
+            break;
+
+        if (Node->PrefixLength == PrefixLength)
+            return Node;
+
+        Parent = Node;
+        Link = &Node->Child[FIBAddressBit(Prefix, Node->PrefixLength)];
+    }
+
+    NewNode = FIBAllocateNode(Prefix, PrefixLength, Parent);
+    if (!NewNode)
+        return NULL;
+
+    if (!Node) {
+        *Link = NewNode;
+    } else if (Length == PrefixLength) {
+        /* Our prefix covers the node, so it goes below us */
+        NewNode->Child[FIBAddressBit(&Node->Prefix, PrefixLength)] = Node;
+        Node->Parent = NewNode;
+        *Link = NewNode;
+    } else {
+        /* The prefixes part after Length bits, join them with a new node */
+        Glue = FIBAllocateNode(Prefix, Length, Parent);
+        if (!Glue) {
+            ExFreePoolWithTag(NewNode, FIB_TAG);
+            return NULL;
+        }
+
+        Glue->Child[FIBAddressBit(&Node->Prefix, Length)] = Node;
+        Glue->Child[FIBAddressBit(Prefix, Length)] = NewNode;
+        Node->Parent = Glue;
+        NewNode->Parent = Glue;
+        *Link = Glue;
+    }
+
+    return NewNode;
+}
+
+
+static VOID FIBPruneNode(
+    PFIB_NODE Node)
+/*
+ * FUNCTION: Removes trie nodes that are no longer needed
+ * ARGUMENTS:
+ *     Node = Pointer to node that lost a route
+ * NOTES:
+ *     The forward information base lock must be held when called
+ */
+{
+    PFIB_NODE Parent, Child;
+
+    while (Node && IsListEmpty(&Node->FIBList)) {
+        /* Still needed to join two subtrees */
+        if (Node->Child[0] && Node->Child[1])
+            break;
+
+        Child = Node->Child[0] ? Node->Child[0] : Node->Child[1];
+        Parent = Node->Parent;
+
+        *FIBNodeLink(Node) = Child;
+        if (Child)
+            Child->Parent = Parent;
+
+        ExFreePoolWithTag(Node, FIB_TAG);
+
+        /* The parent only loses a subtree if we were a leaf */
+        if (Child)
+            break;
+
+        Node = Parent;
+    }
+}
+
+
+static PNEIGHBOR_CACHE_ENTRY FIBSelectRouter(
+    PFIB_NODE Node,
+    PBOOLEAN Usable)
+/*
+ * FUNCTION: Picks the best of the routes to one prefix
+ * ARGUMENTS:
+ *     Node   = Pointer to trie node
+ *     Usable = Address of buffer that receives whether the router is reachable
+ * RETURNS:
+ *     Pointer to NCE for router, NULL if the node has no routes
+ */
+{
+    PLIST_ENTRY CurrentEntry;
+    PFIB_ENTRY Current, Best = NULL;
+    BOOLEAN Good, BestGood = FALSE;
+
+    CurrentEntry = Node->FIBList.Flink;
+    while (CurrentEntry != &Node->FIBList) {
+        Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, NodeEntry);
+
+        Good = !(Current->Router->State & (NUD_STALE | NUD_INCOMPLETE));
+
+        /* Prefer reachable routers, then the lowest metric */
+        if (!Best || (Good && !BestGood) ||
+            (Good == BestGood && Current->Metric < Best->Metric)) {
+            Best = Current;
+            BestGood = Good;
+        }
+
+        CurrentEntry = CurrentEntry->Flink;
+    }
+
+    *Usable = BestGood;
+
+    return Best ? Best->Router : NULL;
+}
+
+
+static PNEIGHBOR_CACHE_ENTRY FIBLookup(
+    PIP_ADDRESS Destination)
+/*
+ * FUNCTION: Finds the route with the longest prefix matching a destination
+ * ARGUMENTS:
+ *     Destination = Pointer to destination address
+ * RETURNS:
+ *     Pointer to NCE for router, NULL if none was found
+ * NOTES:
+ *     Routes through reachable routers are preferred over longer
+ *     prefixes through stale or incomplete ones.
+ *     The forward information base lock must be held when called
+ */
+{
+    PFIB_NODE Node = *FIBRootLink(Destination);
+    PNEIGHBOR_CACHE_ENTRY NCE, BestNCE = NULL;
+    BOOLEAN Usable, BestUsable = FALSE;
+
+    while (Node) {
+        if (FIBMatchLength(Destination, &Node->Prefix, Node->PrefixLength) < Node->PrefixLength)
+            break;
+
+        /* Nodes further down have longer prefixes */
+        NCE = FIBSelectRouter(Node, &Usable);
+        if (NCE && (Usable || !BestUsable)) {
+            BestNCE = NCE;
+            BestUsable = Usable;
+        }
+
+        if (Node->PrefixLength >= FIBAddressBits(Destination))
+            break;
+
+        Node = Node->Child[FIBAddressBit(Destination, Node->PrefixLength)];
+    }
+
+    return BestNCE;
+}
+
+
+static UINT RouteCacheHash(
+    PIP_ADDRESS Destination)
+{
+    PUCHAR Bytes = (PUCHAR)&Destination->Address;
+    UINT Hash = 0;
+    UINT i;
+
+    for (i = 0; i < FIBAddressBits(Destination) / 8; i++)
+        Hash = Hash * 31 + Bytes[i];
+
+    return (Hash ^ (Hash >> 8)) & (ROUTE_CACHE_SIZE - 1);
+}
+
+
 VOID FreeFIB(
     PVOID Object)
 /*
@@ -66,8 +421,11 @@ VOID DestroyFIBE(
 {
     TI_DbgPrint(DEBUG_ROUTER, ("Called. FIBE (0x%X).\n", FIBE));
 
-    /* Unlink the FIB entry from the list */
+    /* Unlink the FIB entry from the list and the trie */
     RemoveEntryList(&FIBE->ListEntry);
+    RemoveEntryList(&FIBE->NodeEntry);
+    FIBPruneNode(FIBE->Node);
+    FIBChanged();
 
     /* And free the FIB entry */
     FreeFIB(FIBE);
@@ -139,53 +497,6 @@ UINT CopyFIBs( PIP_INTERFACE IF, PFIB_ENTRY Target ) {
 }
 
 
-UINT CommonPrefixLength(
-    PIP_ADDRESS Address1,
-    PIP_ADDRESS Address2)
-/*
- * FUNCTION: Computes the length of the longest prefix common to two addresses
- * ARGUMENTS:
- *     Address1 = Pointer to first address
- *     Address2 = Pointer to second address
- * NOTES:
- *     The two addresses must be of the same type
- * RETURNS:
- *     Length of longest common prefix
- */
-{
-    PUCHAR Addr1, Addr2;
-    UINT Size;
-    UINT i, j;
-    UINT Bitmask;
-
-    TI_DbgPrint(DEBUG_ROUTER, ("Called. Address1 (0x%X)  Address2 (0x%X).\n", Address1, Address2));
-
-    /*TI_DbgPrint(DEBUG_ROUTER, ("Target  (%s) \n", A2S(Address1)));*/
-    /*TI_DbgPrint(DEBUG_ROUTER, ("Adapter (%s).\n", A2S(Address2)));*/
-
-    if (Address1->Type == IP_ADDRESS_V4)
-        Size = sizeof(IPv4_RAW_ADDRESS);
-    else
-        Size = sizeof(IPv6_RAW_ADDRESS);
-
-    Addr1 = (PUCHAR)&Address1->Address.IPv4Address;
-    Addr2 = (PUCHAR)&Address2->Address.IPv4Address;
-
-    /* Find first non-matching byte */
-    for (i = 0; i < Size && Addr1[i] == Addr2[i]; i++);
-    if( i == Size ) return 8 * i;
-
-    /* Find first non-matching bit */
-    Bitmask = 0x80;
-    for (j = 0; (Addr1[i] & Bitmask) == (Addr2[i] & Bitmask); j++)
-        Bitmask >>= 1;
-
-    TI_DbgPrint(DEBUG_ROUTER, ("Returning %d\n", 8 * i + j));
-
-    return 8 * i + j;
-}
-
-
 PFIB_ENTRY RouterAddRoute(
     PIP_ADDRESS NetworkAddress,
     PIP_ADDRESS Netmask,
@@ -206,7 +517,10 @@ PFIB_ENTRY RouterAddRoute(
  *     these references
  */
 {
+    KIRQL OldIrql;
     PFIB_ENTRY FIBE;
+    PFIB_NODE Node;
+    UINT PrefixLength;
 
     TI_DbgPrint(DEBUG_ROUTER, ("Called. NetworkAddress (0x%X)  Netmask (0x%X) "
         "Router (0x%X)  Metric (%d).\n", NetworkAddress, Netmask, Router, Metric));
@@ -229,8 +543,25 @@ PFIB_ENTRY RouterAddRoute(
     FIBE->Router         = Router;
     FIBE->Metric         = Metric;
 
+    PrefixLength = min(AddrCountPrefixBits(Netmask), FIBAddressBits(NetworkAddress));
+
+    TcpipAcquireSpinLock(&FIBLock, &OldIrql);
+
+    Node = FIBInsertNode(NetworkAddress, PrefixLength);
+    if (!Node) {
+        TcpipReleaseSpinLock(&FIBLock, OldIrql);
+        TI_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+        FreeFIB(FIBE);
+        return NULL;
+    }
+
     /* Add FIB to the forward information base */
-    TcpipInterlockedInsertTailList(&FIBListHead, &FIBE->ListEntry, &FIBLock);
+    FIBE->Node = Node;
+    InsertTailList(&Node->FIBList, &FIBE->NodeEntry);
+    InsertTailList(&FIBListHead, &FIBE->ListEntry);
+    FIBChanged();
+
+    TcpipReleaseSpinLock(&FIBLock, OldIrql);
 
     return FIBE;
 }
@@ -248,12 +579,8 @@ PNEIGHBOR_CACHE_ENTRY RouterGetRoute(PIP_ADDRESS Destination)
  */
 {
     KIRQL OldIrql;
-    PLIST_ENTRY CurrentEntry;
-    PLIST_ENTRY NextEntry;
-    PFIB_ENTRY Current;
-    UCHAR State;
-    UINT Length, BestLength = 0, MaskLength;
-    PNEIGHBOR_CACHE_ENTRY NCE, BestNCE = NULL;
+    PROUTE_CACHE_ENTRY Cache;
+    PNEIGHBOR_CACHE_ENTRY BestNCE;
 
     TI_DbgPrint(DEBUG_ROUTER, ("Called. Destination (0x%X)\n", Destination));
 
@@ -261,29 +588,21 @@ PNEIGHBOR_CACHE_ENTRY RouterGetRoute(PIP_ADDRESS Destination)
 
     TcpipAcquireSpinLock(&FIBLock, &OldIrql);
 
-    CurrentEntry = FIBListHead.Flink;
-    while (CurrentEntry != &FIBListHead) {
-        NextEntry = CurrentEntry->Flink;
-	    Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, ListEntry);
-
-        NCE   = Current->Router;
-        State = NCE->State;
-
-	Length = CommonPrefixLength(Destination, &Current->NetworkAddress);
-	MaskLength = AddrCountPrefixBits(&Current->Netmask);
-
-	TI_DbgPrint(DEBUG_ROUTER,("This-Route: %s (Sharing %d bits)\n",
-				  A2S(&NCE->Address), Length));
-
-	if(Length >= MaskLength && (Length > BestLength || !BestNCE) &&
-           ((!(State & NUD_STALE) && !(State & NUD_INCOMPLETE)) || !BestNCE)) {
-	    /* This seems to be a better router */
-	    BestNCE    = NCE;
-	    BestLength = Length;
-	    TI_DbgPrint(DEBUG_ROUTER,("Route selected\n"));
-	}
-
-        CurrentEntry = NextEntry;
+    /* A cached router is only trusted while it is reachable, otherwise
+     * another route may be preferred now */
+    Cache = &RouteCache[RouteCacheHash(Destination)];
+    if (Cache->Generation == FIBGeneration &&
+        Cache->Destination.Type == Destination->Type &&
+        AddrIsEqual(&Cache->Destination, Destination) &&
+        !(Cache->Router->State & (NUD_STALE | NUD_INCOMPLETE))) {
+        BestNCE = Cache->Router;
+    } else {
+        BestNCE = FIBLookup(Destination);
+        if (BestNCE) {
+            Cache->Destination = *Destination;
+            Cache->Router = BestNCE;
+            Cache->Generation = FIBGeneration;
+        }
     }
 
     TcpipReleaseSpinLock(&FIBLock, OldIrql);
@@ -373,8 +692,8 @@ NTSTATUS RouterRemoveRoute(PIP_ADDRESS Target, PIP_ADDRESS Router)
 {
     KIRQL OldIrql;
     PLIST_ENTRY CurrentEntry;
-    PLIST_ENTRY NextEntry;
-    PFIB_ENTRY Current;
+    PFIB_NODE Node;
+    PFIB_ENTRY Current = NULL;
     BOOLEAN Found = FALSE;
     PNEIGHBOR_CACHE_ENTRY NCE;
 
@@ -386,21 +705,32 @@ NTSTATUS RouterRemoveRoute(PIP_ADDRESS Target, PIP_ADDRESS Router)
 
     RouterDumpRoutes();
 
-    CurrentEntry = FIBListHead.Flink;
-    while (CurrentEntry != &FIBListHead) {
-        NextEntry = CurrentEntry->Flink;
-	Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, ListEntry);
+    /* Any route to Target has a prefix of Target, so it hangs off
+     * the path that a lookup of Target takes */
+    Node = *FIBRootLink(Target);
+    while (Node && !Found) {
+        if (FIBMatchLength(Target, &Node->Prefix, Node->PrefixLength) < Node->PrefixLength)
+            break;
 
-        NCE   = Current->Router;
+        CurrentEntry = Node->FIBList.Flink;
+        while (CurrentEntry != &Node->FIBList) {
+            Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, NodeEntry);
 
-	if( AddrIsEqual( &Current->NetworkAddress, Target ) &&
-	    AddrIsEqual( &NCE->Address, Router ) ) {
-	    Found = TRUE;
-	    break;
-	}
+            NCE   = Current->Router;
 
-	Current = NULL;
-        CurrentEntry = NextEntry;
+            if( AddrIsEqual( &Current->NetworkAddress, Target ) &&
+                AddrIsEqual( &NCE->Address, Router ) ) {
+                Found = TRUE;
+                break;
+            }
+
+            CurrentEntry = CurrentEntry->Flink;
+        }
+
+        if (Node->PrefixLength >= FIBAddressBits(Target))
+            break;
+
+        Node = Node->Child[FIBAddressBit(Target, Node->PrefixLength)];
     }
 
     if( Found ) {
@@ -442,14 +772,19 @@ PFIB_ENTRY RouterCreateRoute(
     PLIST_ENTRY CurrentEntry;
     PLIST_ENTRY NextEntry;
     PFIB_ENTRY Current;
+    PFIB_NODE Node;
     PNEIGHBOR_CACHE_ENTRY NCE;
 
     TcpipAcquireSpinLock(&FIBLock, &OldIrql);
 
-    CurrentEntry = FIBListHead.Flink;
-    while (CurrentEntry != &FIBListHead) {
+    /* Duplicates share the prefix, so only its node needs checking */
+    Node = FIBFindNode(NetworkAddress,
+                       min(AddrCountPrefixBits(Netmask), FIBAddressBits(NetworkAddress)));
+
+    CurrentEntry = Node ? Node->FIBList.Flink : NULL;
+    while (Node && CurrentEntry != &Node->FIBList) {
         NextEntry = CurrentEntry->Flink;
-        Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, ListEntry);
+        Current = CONTAINING_RECORD(CurrentEntry, FIB_ENTRY, NodeEntry);
 
         NCE   = Current->Router;
 
@@ -492,6 +827,9 @@ NTSTATUS RouterStartup(
     /* Initialize the Forward Information Base */
     InitializeListHead(&FIBListHead);
     TcpipInitializeSpinLock(&FIBLock);
+    FIBRoot[0] = FIBRoot[1] = NULL;
+    FIBGeneration = 1;
+    RtlZeroMemory(RouteCache, sizeof(RouteCache));
 
     return STATUS_SUCCESS;
 }
@@ -112,9 +112,10 @@ BOOLEAN PrepareNextFragment(
 
         /* FIXME: Handle options */
 
-        /* Calculate checksum of IP header */
+        /* Calculate checksum of IP header unless the adapter does it */
         Header->Checksum = 0;
-        Header->Checksum = (USHORT)IPv4Checksum(Header, IFC->HeaderSize, 0);
+        if (!(IFC->ChecksumOffload & IP_CHECKSUM_OFFLOAD_IP))
+            Header->Checksum = (USHORT)IPv4Checksum(Header, IFC->HeaderSize, 0);
 	TI_DbgPrint(MID_TRACE,("IP Check: %x\n", Header->Checksum));
 
         /* Update pointers */
@@ -147,6 +148,7 @@ NTSTATUS SendFragments(
 {
     PIPFRAGMENT_CONTEXT IFC;
     NDIS_STATUS NdisStatus;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
     PVOID Data;
     UINT BufferSize = PathMTU, InSize;
     PCHAR InData;
@@ -188,8 +190,35 @@ NTSTATUS SendFragments(
     IFC->Position     = 0;
     IFC->BytesLeft    = IPPacket->TotalSize - IPPacket->HeaderSize;
     IFC->Data         = (PVOID)((ULONG_PTR)IFC->Header + IPPacket->HeaderSize);
+    IFC->ChecksumOffload = 0;
     KeInitializeEvent(&IFC->Event, NotificationEvent, FALSE);
 
+    /* The adapter can only checksum datagrams that go out unfragmented */
+    if (IPPacket->TotalSize <= PathMTU)
+    {
+        IFC->ChecksumOffload = NCE->Interface->ChecksumOffload & IP_CHECKSUM_OFFLOAD_IP;
+
+        if (IPPacket->Flags & IP_PACKET_FLAG_CHECKSUM_OFFLOAD)
+        {
+            if (((PIPv4_HEADER)IPPacket->Header)->Protocol == IPPROTO_TCP)
+                IFC->ChecksumOffload |= IP_CHECKSUM_OFFLOAD_TCP;
+            else
+                IFC->ChecksumOffload |= IP_CHECKSUM_OFFLOAD_UDP;
+        }
+    }
+
+    if (IFC->ChecksumOffload)
+    {
+        ChecksumInfo.Value = 0;
+        ChecksumInfo.Transmit.NdisPacketChecksumV4 = 1;
+        ChecksumInfo.Transmit.NdisPacketIpChecksum = !!(IFC->ChecksumOffload & IP_CHECKSUM_OFFLOAD_IP);
+        ChecksumInfo.Transmit.NdisPacketTcpChecksum = !!(IFC->ChecksumOffload & IP_CHECKSUM_OFFLOAD_TCP);
+        ChecksumInfo.Transmit.NdisPacketUdpChecksum = !!(IFC->ChecksumOffload & IP_CHECKSUM_OFFLOAD_UDP);
+
+        NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket, TcpIpChecksumPacketInfo) =
+            (PVOID)(ULONG_PTR)ChecksumInfo.Value;
+    }
+
     TI_DbgPrint(MID_TRACE,("Copying header from %x to %x (%d)\n",
 			   IPPacket->Header, IFC->Header,
 			   IPPacket->HeaderSize));
@@ -220,6 +249,25 @@ NTSTATUS SendFragments(
     return NdisStatus;
 }
 
+BOOLEAN IPCanOffloadChecksum(
+    PIP_INTERFACE Interface,
+    ULONG Checksum,
+    UINT TotalSize)
+/*
+ * FUNCTION: Tells whether a transport checksum can be left to the adapter
+ * ARGUMENTS:
+ *     Interface = Pointer to interface the datagram will be sent on
+ *     Checksum  = IP_CHECKSUM_OFFLOAD_TCP or IP_CHECKSUM_OFFLOAD_UDP
+ *     TotalSize = Size of the datagram including the IP header
+ * RETURNS:
+ *     TRUE if the caller should only store the pseudo header checksum,
+ *     FALSE if it must calculate the full checksum itself
+ */
+{
+    /* Fragmented datagrams are checksummed in software */
+    return (Interface->ChecksumOffload & Checksum) && TotalSize <= Interface->MTU;
+}
+
 NTSTATUS IPSendDatagram(PIP_PACKET IPPacket, PNEIGHBOR_CACHE_ENTRY NCE)
 /*
  * FUNCTION: Sends an IP datagram to a remote address
@@ -15,8 +15,12 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
     IP_PACKET Packet;
     IP_ADDRESS RemoteAddress, LocalAddress;
     PIPv4_HEADER Header;
+    PTCPv4_HEADER TCPHeader;
     ULONG Length;
     ULONG TotalLength;
+    ULONG HeaderLength;
+    ULONG Sum, PseudoSum;
+    BOOLEAN Offload;
 
     /* The caller frees the pbuf struct */
 
@@ -54,17 +58,54 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
     ASSERT(Packet.TotalSize == p->tot_len);
 
     TotalLength = p->tot_len;
+    HeaderLength = (Header->VerIHL & 0x0F) << 2;
+    Offload = Header->Protocol == IPPROTO_TCP &&
+              IPCanOffloadChecksum(NCE->Interface, IP_CHECKSUM_OFFLOAD_TCP, TotalLength);
+
     Length = 0;
+    Sum = 0;
     while (Length < TotalLength)
     {
         ASSERT(p->len <= TotalLength - Length);
         ASSERT(p->tot_len == TotalLength - Length);
-        RtlCopyMemory((PCHAR)Packet.Header + Length, p->payload, p->len);
+        if (Offload || Header->Protocol != IPPROTO_TCP)
+        {
+            RtlCopyMemory((PCHAR)Packet.Header + Length, p->payload, p->len);
+        }
+        else
+        {
+            /* Checksum the segment while it is being copied */
+            Sum = ChecksumAdd(Sum,
+                              ChecksumCopy((PCHAR)Packet.Header + Length, p->payload, p->len, 0),
+                              Length);
+        }
         Length += p->len;
         p = p->next;
     }
     ASSERT(Length == TotalLength);
 
+    if (Header->Protocol == IPPROTO_TCP)
+    {
+        TCPHeader = (PTCPv4_HEADER)((PCHAR)Packet.Header + HeaderLength);
+
+        /* lwIP leaves both checksums zero, see CHECKSUM_GEN_IP/TCP */
+        PseudoSum = ChecksumPseudoHeaderIPv4(Packet.Header,
+                                             IPPROTO_TCP,
+                                             (USHORT)(TotalLength - HeaderLength));
+        if (Offload)
+        {
+            /* The adapter sums the segment on top of the pseudo header */
+            TCPHeader->Checksum = (USHORT)PseudoSum;
+            Packet.Flags |= IP_PACKET_FLAG_CHECKSUM_OFFLOAD;
+        }
+        else
+        {
+            /* Take the IP header back out of the sum */
+            Sum = ChecksumFold(Sum + (~ChecksumCompute(Packet.Header, HeaderLength, 0) & 0xFFFF));
+            TCPHeader->Checksum = (USHORT)~ChecksumFold(Sum + PseudoSum);
+        }
+    }
+
     Packet.HeaderSize = sizeof(IPv4_HEADER);
     Packet.TotalSize = TotalLength;
     Packet.SrcAddr = LocalAddress;
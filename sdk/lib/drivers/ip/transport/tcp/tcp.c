@@ -691,6 +691,21 @@ TCPSetNoDelay(
     return STATUS_SUCCESS;
 }
 
+NTSTATUS
+TCPSetBufferSize(
+    PCONNECTION_ENDPOINT Connection,
+    BOOLEAN Receive,
+    ULONG Size)
+{
+    if (!Connection)
+        return STATUS_UNSUCCESSFUL;
+
+    if (Connection->SocketContext == NULL)
+        return STATUS_UNSUCCESSFUL;
+
+    return TCPTranslateError(LibTCPSetBufferSize(Connection, Receive, Size));
+}
+
 NTSTATUS
 TCPGetSocketStatus(
     PCONNECTION_ENDPOINT Connection,
@@ -15,6 +15,7 @@ PORT_SET UDPPorts;
 
 NTSTATUS AddUDPHeaderIPv4(
     PADDRESS_FILE AddrFile,
+    PIP_INTERFACE Interface,
     PIP_ADDRESS RemoteAddress,
     USHORT RemotePort,
     PIP_ADDRESS LocalAddress,
@@ -26,6 +27,7 @@ NTSTATUS AddUDPHeaderIPv4(
  * FUNCTION: Adds an IPv4 and UDP header to an IP packet
  * ARGUMENTS:
  *     SendRequest  = Pointer to send request
+ *     Interface    = Pointer to interface the datagram will be sent on
  *     LocalAddress = Pointer to our local address
  *     LocalPort    = The port we send this datagram from
  *     IPPacket     = Pointer to IP packet
@@ -35,6 +37,7 @@ NTSTATUS AddUDPHeaderIPv4(
 {
     PUDP_HEADER UDPHeader;
     NTSTATUS Status;
+    ULONG Sum;
 
     TI_DbgPrint(MID_TRACE, ("Packet: %x NdisPacket %x\n",
 			    IPPacket, IPPacket->NdisPacket));
@@ -59,12 +62,29 @@ NTSTATUS AddUDPHeaderIPv4(
 			    IPPacket->Header, IPPacket->Data,
 			    (PCHAR)IPPacket->Data - (PCHAR)IPPacket->Header));
 
-    RtlCopyMemory(IPPacket->Data, Data, DataLength);
+    Sum = ChecksumPseudoHeaderIPv4((PIPv4_HEADER)IPPacket->Header,
+                                   IPPROTO_UDP,
+                                   (USHORT)(DataLength + sizeof(UDP_HEADER)));
 
-    UDPHeader->Checksum = UDPv4ChecksumCalculate((PIPv4_HEADER)IPPacket->Header,
-                                                 (PUCHAR)UDPHeader,
-                                                 DataLength + sizeof(UDP_HEADER));
-    UDPHeader->Checksum = WH2N(UDPHeader->Checksum);
+    if (IPCanOffloadChecksum(Interface, IP_CHECKSUM_OFFLOAD_UDP, IPPacket->TotalSize))
+    {
+        RtlCopyMemory(IPPacket->Data, Data, DataLength);
+
+        /* The adapter sums the datagram on top of the pseudo header */
+        UDPHeader->Checksum = (USHORT)Sum;
+        IPPacket->Flags |= IP_PACKET_FLAG_CHECKSUM_OFFLOAD;
+    }
+    else
+    {
+        /* Checksum the data while it is being copied */
+        Sum = ChecksumCompute(UDPHeader, sizeof(UDP_HEADER), Sum);
+        Sum = ChecksumCopy(IPPacket->Data, Data, DataLength, Sum);
+
+        /* A zero checksum means none was computed, send all ones instead */
+        UDPHeader->Checksum = (USHORT)~Sum;
+        if (UDPHeader->Checksum == 0)
+            UDPHeader->Checksum = 0xFFFF;
+    }
 
     TI_DbgPrint(MID_TRACE, ("Packet: %d ip %d udp %d payload\n",
 			    (PCHAR)UDPHeader - (PCHAR)IPPacket->Header,
@@ -77,6 +97,7 @@ NTSTATUS AddUDPHeaderIPv4(
 
 NTSTATUS BuildUDPPacket(
     PADDRESS_FILE AddrFile,
+    PIP_INTERFACE Interface,
     PIP_PACKET Packet,
     PIP_ADDRESS RemoteAddress,
     USHORT RemotePort,
@@ -88,6 +109,7 @@ NTSTATUS BuildUDPPacket(
  * FUNCTION: Builds an UDP packet
  * ARGUMENTS:
  *     Context      = Pointer to context information (DATAGRAM_SEND_REQUEST)
+ *     Interface    = Pointer to interface the datagram will be sent on
  *     LocalAddress = Pointer to our local address
  *     LocalPort    = The port we send this datagram from
  *     IPPacket     = Address of pointer to IP packet
@@ -121,7 +143,7 @@ NTSTATUS BuildUDPPacket(
 
     switch (RemoteAddress->Type) {
         case IP_ADDRESS_V4:
-            Status = AddUDPHeaderIPv4(AddrFile, RemoteAddress, RemotePort,
+            Status = AddUDPHeaderIPv4(AddrFile, Interface, RemoteAddress, RemotePort,
                                       LocalAddress, LocalPort, Packet, DataBuffer, DataLen);
             break;
         case IP_ADDRESS_V6:
@@ -215,6 +237,7 @@ NTSTATUS UDPSendDatagram(
     }
 
     Status = BuildUDPPacket( AddrFile,
+							 NCE->Interface,
 							 &Packet,
 							 &RemoteAddress,
 							 RemotePort,
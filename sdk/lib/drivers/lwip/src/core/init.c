@@ -112,6 +112,18 @@
 #if (LWIP_TCP && (TCP_WND > 0xffff))
   #error "If you want to use TCP, TCP_WND must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
 #endif
+#if (LWIP_TCP && (TCP_RCV_BUF_MAX < TCP_WND))
+  #error "TCP_RCV_BUF_MAX must be at least TCP_WND, so, you have to increase it in your lwipopts.h"
+#endif
+#if (LWIP_TCP && (TCP_SND_BUF_MAX < TCP_SND_BUF))
+  #error "TCP_SND_BUF_MAX must be at least TCP_SND_BUF, so, you have to increase it in your lwipopts.h"
+#endif
+#if (LWIP_TCP && !LWIP_WND_SCALE && ((TCP_RCV_BUF_MAX > 0xffff) || (TCP_SND_BUF_MAX > 0xffff)))
+  #error "If you want to use TCP without LWIP_WND_SCALE, TCP_RCV_BUF_MAX and TCP_SND_BUF_MAX must fit in an u16_t, so, you have to reduce them in your lwipopts.h"
+#endif
+#if (LWIP_TCP && LWIP_WND_SCALE && ((TCP_RCV_SCALE > 14) || ((TCP_RCV_BUF_MAX >> TCP_RCV_SCALE) > 0xffff)))
+  #error "If you want to use TCP window scaling, TCP_RCV_SCALE must be at most 14 and TCP_RCV_BUF_MAX >> TCP_RCV_SCALE must fit in an u16_t, so, you have to adjust them in your lwipopts.h"
+#endif
 #if (LWIP_TCP && (TCP_SND_QUEUELEN > 0xffff))
   #error "If you want to use TCP, TCP_SND_QUEUELEN must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
 #endif
@@ -261,8 +273,8 @@
 #if TCP_SND_BUF < (2 * TCP_MSS)
   #error "lwip_sanity_check: WARNING: TCP_SND_BUF must be at least as much as (2 * TCP_MSS) for things to work smoothly. If you know what you are doing, define LWIP_DISABLE_TCP_SANITY_CHECKS to 1 to disable this error."
 #endif
-#if TCP_SND_QUEUELEN < (2 * (TCP_SND_BUF / TCP_MSS))
-  #error "lwip_sanity_check: WARNING: TCP_SND_QUEUELEN must be at least as much as (2 * TCP_SND_BUF/TCP_MSS) for things to work. If you know what you are doing, define LWIP_DISABLE_TCP_SANITY_CHECKS to 1 to disable this error."
+#if TCP_SND_QUEUELEN < (2 * (TCP_SND_BUF_MAX / TCP_MSS))
+  #error "lwip_sanity_check: WARNING: TCP_SND_QUEUELEN must be at least as much as (2 * TCP_SND_BUF_MAX/TCP_MSS) for things to work. If you know what you are doing, define LWIP_DISABLE_TCP_SANITY_CHECKS to 1 to disable this error."
 #endif
 #if TCP_SNDLOWAT >= TCP_SND_BUF
   #error "lwip_sanity_check: WARNING: TCP_SNDLOWAT must be less than TCP_SND_BUF. If you know what you are doing, define LWIP_DISABLE_TCP_SANITY_CHECKS to 1 to disable this error."
@@ -172,7 +172,7 @@ tcp_close_shutdown(struct tcp_pcb *pcb, u8_t rst_on_unacked_data)
   err_t err;
 
   if (rst_on_unacked_data && ((pcb->state == ESTABLISHED) || (pcb->state == CLOSE_WAIT))) {
-    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != TCP_WND)) {
+    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != pcb->rcv_wnd_max)) {
       /* Not all data received by application, send RST to tell the remote
          side about this. */
       LWIP_ASSERT("pcb->flags & TF_RXCLOSED", pcb->flags & TF_RXCLOSED);
@@ -580,7 +580,7 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
 {
   u32_t new_right_edge = pcb->rcv_nxt + pcb->rcv_wnd;
 
-  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((TCP_WND / 2), pcb->mss))) {
+  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((pcb->rcv_wnd_max / 2), pcb->mss))) {
     /* we can advertise more window */
     pcb->rcv_ann_wnd = pcb->rcv_wnd;
     return new_right_edge - pcb->rcv_ann_right_edge;
@@ -592,8 +592,10 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
     } else {
       /* keep the right edge of window constant */
       u32_t new_rcv_ann_wnd = pcb->rcv_ann_right_edge - pcb->rcv_nxt;
+#if !LWIP_WND_SCALE
       LWIP_ASSERT("new_rcv_ann_wnd <= 0xffff", new_rcv_ann_wnd <= 0xffff);
-      pcb->rcv_ann_wnd = (u16_t)new_rcv_ann_wnd;
+#endif /* !LWIP_WND_SCALE */
+      pcb->rcv_ann_wnd = (tcpwnd_size_t)new_rcv_ann_wnd;
     }
     return 0;
   }
@@ -611,17 +613,18 @@ void
 tcp_recved(struct tcp_pcb *pcb, u16_t len)
 {
   int wnd_inflation;
+  tcpwnd_size_t rcv_wnd;
 
   /* pcb->state LISTEN not allowed here */
   LWIP_ASSERT("don't call tcp_recved for listen-pcbs",
     pcb->state != LISTEN);
-  LWIP_ASSERT("tcp_recved: len would wrap rcv_wnd\n",
-              len <= 0xffff - pcb->rcv_wnd );
 
-  pcb->rcv_wnd += len;
-  if (pcb->rcv_wnd > TCP_WND) {
-    pcb->rcv_wnd = TCP_WND;
+  rcv_wnd = pcb->rcv_wnd + len;
+  if ((rcv_wnd < pcb->rcv_wnd) || (rcv_wnd > pcb->rcv_wnd_max)) {
+    /* the receive buffer may have shrunk since the data arrived */
+    rcv_wnd = pcb->rcv_wnd_max;
   }
+  pcb->rcv_wnd = rcv_wnd;
 
   wnd_inflation = tcp_update_rcv_ann_wnd(pcb);
 
@@ -634,8 +637,8 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
     tcp_output(pcb);
   }
 
-  LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"U16_F" (%"U16_F").\n",
-         len, pcb->rcv_wnd, TCP_WND - pcb->rcv_wnd));
+  LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"U32_F" (%"U32_F").\n",
+         len, (u32_t)pcb->rcv_wnd, (u32_t)(pcb->rcv_wnd_max - pcb->rcv_wnd)));
 }
 
 /**
@@ -743,8 +746,10 @@ tcp_connect(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port,
   pcb->snd_nxt = iss;
   pcb->lastack = iss - 1;
   pcb->snd_lbb = iss - 1;
-  pcb->rcv_wnd = TCP_WND;
-  pcb->rcv_ann_wnd = TCP_WND;
+  /* The window in a SYN is never scaled; the rest of a larger receive
+     buffer is opened once the remote host agrees to window scaling. */
+  pcb->rcv_wnd = TCPWND16(pcb->rcv_wnd_max);
+  pcb->rcv_ann_wnd = pcb->rcv_wnd;
   pcb->rcv_ann_right_edge = pcb->rcv_nxt;
   pcb->snd_wnd = TCP_WND;
   /* As initial send MSS, we use TCP_MSS but limit it to 536.
@@ -788,7 +793,7 @@ void
 tcp_slowtmr(void)
 {
   struct tcp_pcb *pcb, *prev;
-  u16_t eff_wnd;
+  tcpwnd_size_t eff_wnd;
   u8_t pcb_remove;      /* flag if a PCB should be removed */
   u8_t pcb_reset;       /* flag if a RST should be sent when removing */
   err_t err;
@@ -867,8 +872,8 @@ tcp_slowtmr_start:
             pcb->ssthresh = (pcb->mss << 1);
           }
           pcb->cwnd = pcb->mss;
-          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"U16_F
-                                       " ssthresh %"U16_F"\n",
+          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"TCPWNDSIZE_F
+                                       " ssthresh %"TCPWNDSIZE_F"\n",
                                        pcb->cwnd, pcb->ssthresh));
  
           /* The following needs to be called AFTER cwnd is set to one
@@ -1098,7 +1103,7 @@ tcp_process_refused_data(struct tcp_pcb *pcb)
     if (refused_flags & PBUF_FLAG_TCP_FIN) {
       /* correct rcv_wnd as the application won't call tcp_recved()
          for the FIN's seqno */
-      if (pcb->rcv_wnd != TCP_WND) {
+      if (pcb->rcv_wnd != pcb->rcv_wnd_max) {
         pcb->rcv_wnd++;
       }
       TCP_EVENT_CLOSED(pcb, err);
@@ -1165,6 +1170,71 @@ tcp_setprio(struct tcp_pcb *pcb, u8_t prio)
   pcb->prio = prio;
 }
 
+/**
+ * Sets the receive buffer size of a connection, i.e. the largest window
+ * that is announced to the remote host. Windows above 64K are only used
+ * once window scaling has been negotiated. Setting the buffer turns off
+ * receive window autotuning for this connection.
+ *
+ * @param pcb the tcp_pcb to manipulate
+ * @param size new receive buffer size in bytes
+ */
+void
+tcp_setrcvbuf(struct tcp_pcb *pcb, u32_t size)
+{
+  tcpwnd_size_t old_max = pcb->rcv_wnd_max;
+
+  LWIP_ASSERT("don't call tcp_setrcvbuf for listen-pcbs",
+    pcb->state != LISTEN);
+
+  size = LWIP_MAX(size, TCP_MSS);
+  size = LWIP_MIN(size, TCP_RCV_WND_LIMIT(pcb));
+
+  pcb->rcv_wnd_max = (tcpwnd_size_t)size;
+  pcb->flags |= TF_RCVBUF_SET;
+
+  if (pcb->rcv_wnd_max > old_max) {
+    pcb->rcv_wnd += pcb->rcv_wnd_max - old_max;
+    if (pcb->state < ESTABLISHED) {
+      /* the handshake announces the initial window */
+      return;
+    }
+    /* announce the larger window right away if it makes a difference */
+    if (tcp_update_rcv_ann_wnd(pcb) >= TCP_WND_UPDATE_THRESHOLD) {
+      tcp_ack_now(pcb);
+      tcp_output(pcb);
+    }
+  } else {
+    /* The announced right edge is never moved back, the window closes
+       as the data already announced arrives. */
+    pcb->rcv_wnd -= LWIP_MIN(pcb->rcv_wnd, old_max - pcb->rcv_wnd_max);
+  }
+}
+
+/**
+ * Sets the send buffer size of a connection. The buffer never shrinks
+ * below the data that is already queued.
+ *
+ * @param pcb the tcp_pcb to manipulate
+ * @param size new send buffer size in bytes
+ */
+void
+tcp_setsndbuf(struct tcp_pcb *pcb, u32_t size)
+{
+  tcpwnd_size_t queued;
+
+  LWIP_ASSERT("don't call tcp_setsndbuf for listen-pcbs",
+    pcb->state != LISTEN);
+
+  queued = (pcb->snd_buf < pcb->snd_buf_max) ? pcb->snd_buf_max - pcb->snd_buf : 0;
+  size = LWIP_MAX(size, 2 * TCP_MSS);
+  size = LWIP_MIN(size, TCP_SND_BUF_MAX);
+  size = LWIP_MAX(size, queued);
+
+  pcb->snd_buf = (tcpwnd_size_t)size - queued;
+  pcb->snd_buf_max = (tcpwnd_size_t)size;
+}
+
 #if TCP_QUEUE_OOSEQ
 /**
  * Returns a copy of the given TCP segment.
@@ -1307,9 +1377,15 @@ tcp_alloc(u8_t prio)
     memset(pcb, 0, sizeof(struct tcp_pcb));
     pcb->prio = prio;
     pcb->snd_buf = TCP_SND_BUF;
+    pcb->snd_buf_max = TCP_SND_BUF;
     pcb->snd_queuelen = 0;
     pcb->rcv_wnd = TCP_WND;
     pcb->rcv_ann_wnd = TCP_WND;
+    pcb->rcv_wnd_max = TCP_WND;
+#if LWIP_WND_SCALE
+    /* offered in our SYN; cleared again if the remote host doesn't agree */
+    pcb->rcv_scale = TCP_RCV_SCALE;
+#endif /* LWIP_WND_SCALE */
     pcb->tos = 0;
     pcb->ttl = TCP_TTL;
     /* As initial send MSS, we use TCP_MSS but limit it to 536.
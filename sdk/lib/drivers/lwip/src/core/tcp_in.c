@@ -75,6 +75,10 @@ struct tcp_pcb *tcp_input_pcb;
 static err_t tcp_process(struct tcp_pcb *pcb);
 static void tcp_receive(struct tcp_pcb *pcb);
 static void tcp_parseopt(struct tcp_pcb *pcb);
+static void tcp_syn_wnd_scale(struct tcp_pcb *pcb);
+#if LWIP_TCP_RCV_AUTOTUNE
+static void tcp_rcv_autotune(struct tcp_pcb *pcb, u16_t len);
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
 
 static err_t tcp_listen_input(struct tcp_pcb_listen *pcb);
 static err_t tcp_timewait_input(struct tcp_pcb *pcb);
@@ -330,10 +334,26 @@ tcp_input(struct pbuf *p, struct netif *inp)
            called when new send buffer space is available, we call it
            now. */
         if (pcb->acked > 0) {
+#if LWIP_WND_SCALE
+          /* pcb->acked is 32 bits wide but the sent callback only takes
+             a u16_t, so it may have to be called more than once */
+          tcpwnd_size_t acked = pcb->acked;
+          u16_t acked16;
+
+          while (acked > 0) {
+            acked16 = TCPWND16(acked);
+            acked -= acked16;
+            TCP_EVENT_SENT(pcb, acked16, err);
+            if (err == ERR_ABRT) {
+              goto aborted;
+            }
+          }
+#else /* LWIP_WND_SCALE */
           TCP_EVENT_SENT(pcb, pcb->acked, err);
           if (err == ERR_ABRT) {
             goto aborted;
           }
+#endif /* LWIP_WND_SCALE */
         }
 
         if (recv_data != NULL) {
@@ -368,7 +388,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
           } else {
             /* correct rcv_wnd as the application won't call tcp_recved()
                for the FIN's seqno */
-            if (pcb->rcv_wnd != TCP_WND) {
+            if (pcb->rcv_wnd != pcb->rcv_wnd_max) {
               pcb->rcv_wnd++;
             }
             TCP_EVENT_CLOSED(pcb, err);
@@ -499,6 +519,7 @@ tcp_listen_input(struct tcp_pcb_listen *pcb)
 
     /* Parse any options in the SYN. */
     tcp_parseopt(npcb);
+    tcp_syn_wnd_scale(npcb);
 #if TCP_CALCULATE_EFF_SEND_MSS
     npcb->mss = tcp_eff_send_mss(npcb->mss, &(npcb->remote_ip));
 #endif /* TCP_CALCULATE_EFF_SEND_MSS */
@@ -639,6 +660,7 @@ tcp_process(struct tcp_pcb *pcb)
       pcb->snd_wnd_max = tcphdr->wnd;
       pcb->snd_wl1 = seqno - 1; /* initialise to seqno - 1 to force window update */
       pcb->state = ESTABLISHED;
+      tcp_syn_wnd_scale(pcb);
 
 #if TCP_CALCULATE_EFF_SEND_MSS
       pcb->mss = tcp_eff_send_mss(pcb->mss, &(pcb->remote_ip));
@@ -684,7 +706,7 @@ tcp_process(struct tcp_pcb *pcb)
     if (flags & TCP_ACK) {
       /* expected ACK number? */
       if (TCP_SEQ_BETWEEN(ackno, pcb->lastack+1, pcb->snd_nxt)) {
-        u16_t old_cwnd;
+        tcpwnd_size_t old_cwnd;
         pcb->state = ESTABLISHED;
         LWIP_DEBUGF(TCP_DEBUG, ("TCP connection established %"U16_F" -> %"U16_F".\n", inseg.tcphdr->src, inseg.tcphdr->dest));
 #if LWIP_CALLBACK_API
@@ -869,12 +891,12 @@ tcp_receive(struct tcp_pcb *pcb)
     /* Update window. */
     if (TCP_SEQ_LT(pcb->snd_wl1, seqno) ||
        (pcb->snd_wl1 == seqno && TCP_SEQ_LT(pcb->snd_wl2, ackno)) ||
-       (pcb->snd_wl2 == ackno && tcphdr->wnd > pcb->snd_wnd)) {
-      pcb->snd_wnd = tcphdr->wnd;
+       (pcb->snd_wl2 == ackno && SND_WND_SCALE(pcb, tcphdr->wnd) > pcb->snd_wnd)) {
+      pcb->snd_wnd = SND_WND_SCALE(pcb, tcphdr->wnd);
       /* keep track of the biggest window announced by the remote host to calculate
          the maximum segment size */
-      if (pcb->snd_wnd_max < tcphdr->wnd) {
-        pcb->snd_wnd_max = tcphdr->wnd;
+      if (pcb->snd_wnd_max < pcb->snd_wnd) {
+        pcb->snd_wnd_max = pcb->snd_wnd;
       }
       pcb->snd_wl1 = seqno;
       pcb->snd_wl2 = ackno;
@@ -888,10 +910,10 @@ tcp_receive(struct tcp_pcb *pcb)
         /* stop persist timer */
           pcb->persist_backoff = 0;
       }
-      LWIP_DEBUGF(TCP_WND_DEBUG, ("tcp_receive: window update %"U16_F"\n", pcb->snd_wnd));
+      LWIP_DEBUGF(TCP_WND_DEBUG, ("tcp_receive: window update %"TCPWNDSIZE_F"\n", pcb->snd_wnd));
 #if TCP_WND_DEBUG
     } else {
-      if (pcb->snd_wnd != tcphdr->wnd) {
+      if (pcb->snd_wnd != SND_WND_SCALE(pcb, tcphdr->wnd)) {
         LWIP_DEBUGF(TCP_WND_DEBUG, 
                     ("tcp_receive: no window update lastack %"U32_F" ackno %"
                      U32_F" wl1 %"U32_F" seqno %"U32_F" wl2 %"U32_F"\n",
@@ -938,7 +960,7 @@ tcp_receive(struct tcp_pcb *pcb)
               if (pcb->dupacks > 3) {
                 /* Inflate the congestion window, but not if it means that
                    the value overflows. */
-                if ((u16_t)(pcb->cwnd + pcb->mss) > pcb->cwnd) {
+                if ((tcpwnd_size_t)(pcb->cwnd + pcb->mss) > pcb->cwnd) {
                   pcb->cwnd += pcb->mss;
                 }
               } else if (pcb->dupacks == 3) {
@@ -971,8 +993,9 @@ tcp_receive(struct tcp_pcb *pcb)
       /* Reset the retransmission time-out. */
       pcb->rto = (pcb->sa >> 3) + pcb->sv;
 
-      /* Update the send buffer space. Diff between the two can never exceed 64K? */
-      pcb->acked = (u16_t)(ackno - pcb->lastack);
+      /* Update the send buffer space. Diff between the two can never exceed
+         the send window. */
+      pcb->acked = (tcpwnd_size_t)(ackno - pcb->lastack);
 
       pcb->snd_buf += pcb->acked;
 
@@ -984,16 +1007,16 @@ tcp_receive(struct tcp_pcb *pcb)
          ssthresh). */
       if (pcb->state >= ESTABLISHED) {
         if (pcb->cwnd < pcb->ssthresh) {
-          if ((u16_t)(pcb->cwnd + pcb->mss) > pcb->cwnd) {
+          if ((tcpwnd_size_t)(pcb->cwnd + pcb->mss) > pcb->cwnd) {
             pcb->cwnd += pcb->mss;
           }
-          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: slow start cwnd %"U16_F"\n", pcb->cwnd));
+          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: slow start cwnd %"TCPWNDSIZE_F"\n", pcb->cwnd));
         } else {
-          u16_t new_cwnd = (pcb->cwnd + pcb->mss * pcb->mss / pcb->cwnd);
+          tcpwnd_size_t new_cwnd = (pcb->cwnd + pcb->mss * pcb->mss / pcb->cwnd);
           if (new_cwnd > pcb->cwnd) {
             pcb->cwnd = new_cwnd;
           }
-          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: congestion avoidance cwnd %"U16_F"\n", pcb->cwnd));
+          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_receive: congestion avoidance cwnd %"TCPWNDSIZE_F"\n", pcb->cwnd));
         }
       }
       LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_receive: ACK for %"U32_F", unacked->seqno %"U32_F":%"U32_F"\n",
@@ -1230,7 +1253,7 @@ tcp_receive(struct tcp_pcb *pcb)
             TCPH_FLAGS_SET(inseg.tcphdr, TCPH_FLAGS(inseg.tcphdr) &~ TCP_FIN);
           }
           /* Adjust length of segment to fit in the window. */
-          inseg.len = pcb->rcv_wnd;
+          inseg.len = (u16_t)pcb->rcv_wnd;
           if (TCPH_FLAGS(inseg.tcphdr) & TCP_SYN) {
             inseg.len -= 1;
           }
@@ -1298,6 +1321,10 @@ tcp_receive(struct tcp_pcb *pcb)
         LWIP_ASSERT("tcp_receive: tcplen > rcv_wnd\n", pcb->rcv_wnd >= tcplen);
         pcb->rcv_wnd -= tcplen;
 
+#if LWIP_TCP_RCV_AUTOTUNE
+        tcp_rcv_autotune(pcb, tcplen);
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+
         tcp_update_rcv_ann_wnd(pcb);
 
         /* If there is data in the segment, we make preparations to
@@ -1366,7 +1393,6 @@ tcp_receive(struct tcp_pcb *pcb)
 
       } else {
         /* We get here if the incoming segment is out-of-sequence. */
-        tcp_send_empty_ack(pcb);
 #if TCP_QUEUE_OOSEQ
         /* We queue the segment on the ->ooseq queue. */
         if (pcb->ooseq == NULL) {
@@ -1475,7 +1501,7 @@ tcp_receive(struct tcp_pcb *pcb)
                       TCPH_FLAGS_SET(next->next->tcphdr, TCPH_FLAGS(next->next->tcphdr) &~ TCP_FIN);
                     }
                     /* Adjust length of segment to fit in the window. */
-                    next->next->len = pcb->rcv_nxt + pcb->rcv_wnd - seqno;
+                    next->next->len = (u16_t)(pcb->rcv_nxt + pcb->rcv_wnd - seqno);
                     pbuf_realloc(next->next->p, next->next->len);
                     tcplen = TCP_TCPLEN(next->next);
                     LWIP_ASSERT("tcp_receive: segment not trimmed correctly to rcv_wnd\n",
@@ -1514,6 +1540,13 @@ tcp_receive(struct tcp_pcb *pcb)
         }
 #endif /* TCP_OOSEQ_MAX_BYTES || TCP_OOSEQ_MAX_PBUFS */
 #endif /* TCP_QUEUE_OOSEQ */
+#if LWIP_TCP_SACK_OUT
+        /* the first SACK block must cover the segment that triggered the ACK */
+        pcb->rcv_sack_seq = seqno;
+#endif /* LWIP_TCP_SACK_OUT */
+        /* Send the duplicate ACK once the segment is queued so that it can
+           be reported in the SACK blocks. */
+        tcp_send_empty_ack(pcb);
       }
     } else {
       /* The incoming segment is not withing the window. */
@@ -1530,11 +1563,77 @@ tcp_receive(struct tcp_pcb *pcb)
   }
 }
 
+/**
+ * Completes window scale negotiation once the SYN of the remote host has
+ * been parsed. Scaling is used in both directions only if both SYNs
+ * carried the option; otherwise the receive window stays within 64K.
+ * The window announced in our SYN was clamped to 16 bits, so the rest of
+ * the receive buffer becomes available now.
+ *
+ * @param pcb the tcp_pcb that received a SYN
+ */
+static void
+tcp_syn_wnd_scale(struct tcp_pcb *pcb)
+{
+#if LWIP_WND_SCALE
+  if (!(pcb->flags & TF_WND_SCALE)) {
+    pcb->snd_scale = 0;
+    pcb->rcv_scale = 0;
+    pcb->rcv_wnd_max = TCPWND16(pcb->rcv_wnd_max);
+  }
+  pcb->rcv_wnd = pcb->rcv_wnd_max;
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_RCV_AUTOTUNE
+  pcb->rcv_tune_seq = pcb->rcv_nxt;
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+  LWIP_UNUSED_ARG(pcb);
+}
+
+#if LWIP_TCP_RCV_AUTOTUNE
+/**
+ * Grows the receive window when the remote host has filled the window we
+ * announced (senders avoiding silly window syndrome stop less than a
+ * segment short of it) while the application had already taken everything
+ * else. In that case the window, not the reader, limits the throughput,
+ * so it is doubled, at most once per window's worth of data and up to
+ * TCP_RCV_BUF_MAX.
+ *
+ * @param pcb the tcp_pcb that received in-sequence data
+ * @param len length of the in-sequence data, already taken off rcv_wnd
+ */
+static void
+tcp_rcv_autotune(struct tcp_pcb *pcb, u16_t len)
+{
+  tcpwnd_size_t limit, grow;
+
+  if ((pcb->flags & TF_RCVBUF_SET) ||
+      TCP_SEQ_LT(pcb->rcv_nxt + pcb->mss, pcb->rcv_ann_right_edge) ||
+      TCP_SEQ_LT(pcb->rcv_nxt, pcb->rcv_tune_seq) ||
+      (pcb->rcv_wnd + len < pcb->rcv_wnd_max)) {
+    return;
+  }
+
+  limit = TCP_RCV_WND_LIMIT(pcb);
+  if (pcb->rcv_wnd_max >= limit) {
+    return;
+  }
+
+  grow = LWIP_MIN(pcb->rcv_wnd_max, limit - pcb->rcv_wnd_max);
+  pcb->rcv_wnd_max += grow;
+  pcb->rcv_wnd += grow;
+  pcb->rcv_tune_seq = pcb->rcv_nxt + pcb->rcv_wnd_max;
+
+  LWIP_DEBUGF(TCP_WND_DEBUG, ("tcp_rcv_autotune: receive window grown to %"TCPWNDSIZE_F"\n",
+                              pcb->rcv_wnd_max));
+}
+#endif /* LWIP_TCP_RCV_AUTOTUNE */
+
 /**
  * Parses the options contained in the incoming segment. 
  *
  * Called from tcp_listen_input() and tcp_process().
- * Currently, only the MSS option is supported!
+ * Supports the MSS, window scale, SACK permitted and timestamp options;
+ * SACK blocks sent by the remote host are skipped.
  *
  * @param pcb the tcp_pcb for which a segment arrived
  */
@@ -1579,6 +1678,38 @@ tcp_parseopt(struct tcp_pcb *pcb)
         /* Advance to next option */
         c += 0x04;
         break;
+#if LWIP_WND_SCALE
+      case 0x03:
+        LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: WND_SCALE\n"));
+        if (opts[c + 1] != 0x03 || c + 0x03 > max_c) {
+          /* Bad length */
+          LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: bad length\n"));
+          return;
+        }
+        /* Only valid in a SYN; RFC 7323 limits the shift count to 14 */
+        if (flags & TCP_SYN) {
+          pcb->snd_scale = LWIP_MIN(opts[c + 2], 14);
+          pcb->flags |= TF_WND_SCALE;
+        }
+        /* Advance to next option */
+        c += 0x03;
+        break;
+#endif
+#if LWIP_TCP_SACK_OUT
+      case 0x04:
+        LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: SACK_PERM\n"));
+        if (opts[c + 1] != 0x02 || c + 0x02 > max_c) {
+          /* Bad length */
+          LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: bad length\n"));
+          return;
+        }
+        if (flags & TCP_SYN) {
+          pcb->flags |= TF_SACK;
+        }
+        /* Advance to next option */
+        c += 0x02;
+        break;
+#endif
 #if LWIP_TCP_TIMESTAMPS
       case 0x08:
         LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_parseopt: TS\n"));
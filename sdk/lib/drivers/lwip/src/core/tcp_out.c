@@ -105,7 +105,7 @@ tcp_output_alloc_header(struct tcp_pcb *pcb, u16_t optlen, u16_t datalen,
     tcphdr->seqno = seqno_be;
     tcphdr->ackno = htonl(pcb->rcv_nxt);
     TCPH_HDRLEN_FLAGS_SET(tcphdr, (5 + optlen / 4), TCP_ACK);
-    tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+    tcphdr->wnd = htons(TCPWND16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
     tcphdr->chksum = 0;
     tcphdr->urgp = 0;
 
@@ -306,7 +306,7 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
 
   /* fail on too much data */
   if (len > pcb->snd_buf) {
-    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too much data (len=%"U16_F" > snd_buf=%"U16_F")\n",
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too much data (len=%"U16_F" > snd_buf=%"TCPWNDSIZE_F")\n",
       len, pcb->snd_buf));
     pcb->flags |= TF_NAGLEMEMERR;
     return ERR_MEM;
@@ -370,7 +370,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 #endif /* TCP_CHECKSUM_ON_COPY */
   err_t err;
   /* don't allocate segments bigger than half the maximum window we ever received */
-  u16_t mss_local = LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
+  u16_t mss_local = (u16_t)LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
 
 #if LWIP_NETIF_TX_SINGLE_PBUF
   /* Always copy to try to create single pbufs for TX */
@@ -742,6 +742,18 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
 
   if (flags & TCP_SYN) {
     optflags = TF_SEG_OPTS_MSS;
+#if LWIP_WND_SCALE
+    /* Our SYN always offers window scaling, our SYN|ACK (sent in
+       SYN_RCVD) only if the remote host offered it too. */
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_WND_SCALE)) {
+      optflags |= TF_SEG_OPTS_WND_SCALE;
+    }
+#endif /* LWIP_WND_SCALE */
+#if LWIP_TCP_SACK_OUT
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_SACK)) {
+      optflags |= TF_SEG_OPTS_SACK_PERM;
+    }
+#endif /* LWIP_TCP_SACK_OUT */
   }
 #if LWIP_TCP_TIMESTAMPS
   if ((pcb->flags & TF_TIMESTAMP)) {
@@ -834,6 +846,59 @@ tcp_build_timestamp_option(struct tcp_pcb *pcb, u32_t *opts)
 }
 #endif
 
+#if LWIP_TCP_SACK_OUT
+/** Collect SACK blocks (RFC 2018) describing the data queued on ooseq.
+ * The block holding the most recently queued segment comes first, the
+ * others follow in sequence order.
+ *
+ * @param pcb tcp_pcb
+ * @param left receives the left edge of each block
+ * @param right receives the right edge of each block
+ * @return number of blocks, at most TCP_SACK_MAX_BLOCKS
+ */
+static u8_t
+tcp_get_sack_blocks(struct tcp_pcb *pcb, u32_t *left, u32_t *right)
+{
+  struct tcp_seg *seg;
+  u32_t start, end;
+  u8_t count = 0, i;
+
+  if (!(pcb->flags & TF_SACK)) {
+    return 0;
+  }
+
+  seg = pcb->ooseq;
+  while (seg != NULL) {
+    start = seg->tcphdr->seqno;
+    end = start + TCP_TCPLEN(seg);
+    /* contiguous segments form one block */
+    for (seg = seg->next; seg != NULL && TCP_SEQ_LEQ(seg->tcphdr->seqno, end); seg = seg->next) {
+      if (TCP_SEQ_GT(seg->tcphdr->seqno + TCP_TCPLEN(seg), end)) {
+        end = seg->tcphdr->seqno + TCP_TCPLEN(seg);
+      }
+    }
+
+    if (TCP_SEQ_GEQ(pcb->rcv_sack_seq, start) && TCP_SEQ_LT(pcb->rcv_sack_seq, end)) {
+      for (i = LWIP_MIN(count, TCP_SACK_MAX_BLOCKS - 1); i > 0; i--) {
+        left[i] = left[i - 1];
+        right[i] = right[i - 1];
+      }
+      left[0] = start;
+      right[0] = end;
+      if (count < TCP_SACK_MAX_BLOCKS) {
+        count++;
+      }
+    } else if (count < TCP_SACK_MAX_BLOCKS) {
+      left[count] = start;
+      right[count] = end;
+      count++;
+    }
+  }
+
+  return count;
+}
+#endif /* LWIP_TCP_SACK_OUT */
+
 /** Send an ACK without data.
  *
  * @param pcb Protocol control block for the TCP connection to send the ACK
@@ -843,13 +908,25 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
 {
   struct pbuf *p;
   struct tcp_hdr *tcphdr;
+  u32_t *opts;
   u8_t optlen = 0;
+#if LWIP_TCP_SACK_OUT
+  u32_t sack_left[TCP_SACK_MAX_BLOCKS], sack_right[TCP_SACK_MAX_BLOCKS];
+  u8_t sack_count, i;
+#endif /* LWIP_TCP_SACK_OUT */
 
 #if LWIP_TCP_TIMESTAMPS
   if (pcb->flags & TF_TIMESTAMP) {
     optlen = LWIP_TCP_OPT_LENGTH(TF_SEG_OPTS_TS);
   }
 #endif
+#if LWIP_TCP_SACK_OUT
+  /* two NOPs, kind and length, then 8 bytes per block */
+  sack_count = tcp_get_sack_blocks(pcb, sack_left, sack_right);
+  if (sack_count > 0) {
+    optlen += 4 + 8 * sack_count;
+  }
+#endif /* LWIP_TCP_SACK_OUT */
 
   p = tcp_output_alloc_header(pcb, optlen, 0, htonl(pcb->snd_nxt));
   if (p == NULL) {
@@ -863,13 +940,25 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   pcb->flags &= ~(TF_ACK_DELAY | TF_ACK_NOW);
 
   /* NB. MSS option is only sent on SYNs, so ignore it here */
+  opts = (u32_t *)(void *)(tcphdr + 1);
 #if LWIP_TCP_TIMESTAMPS
   pcb->ts_lastacksent = pcb->rcv_nxt;
 
   if (pcb->flags & TF_TIMESTAMP) {
-    tcp_build_timestamp_option(pcb, (u32_t *)(tcphdr + 1));
+    tcp_build_timestamp_option(pcb, opts);
+    opts += 3;
   }
 #endif 
+#if LWIP_TCP_SACK_OUT
+  if (sack_count > 0) {
+    *opts++ = htonl(0x01010500 | (2 + 8 * sack_count));
+    for (i = 0; i < sack_count; i++) {
+      *opts++ = htonl(sack_left[i]);
+      *opts++ = htonl(sack_right[i]);
+    }
+  }
+#endif /* LWIP_TCP_SACK_OUT */
+  LWIP_UNUSED_ARG(opts);
 
 #if CHECKSUM_GEN_TCP
   tcphdr->chksum = inet_chksum_pseudo(p, &(pcb->local_ip), &(pcb->remote_ip),
@@ -945,13 +1034,13 @@ tcp_output(struct tcp_pcb *pcb)
 #endif /* TCP_OUTPUT_DEBUG */
 #if TCP_CWND_DEBUG
   if (seg == NULL) {
-    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"U16_F
-                                 ", cwnd %"U16_F", wnd %"U32_F
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F
+                                 ", cwnd %"TCPWNDSIZE_F", wnd %"U32_F
                                  ", seg == NULL, ack %"U32_F"\n",
                                  pcb->snd_wnd, pcb->cwnd, wnd, pcb->lastack));
   } else {
     LWIP_DEBUGF(TCP_CWND_DEBUG, 
-                ("tcp_output: snd_wnd %"U16_F", cwnd %"U16_F", wnd %"U32_F
+                ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F
                  ", effwnd %"U32_F", seq %"U32_F", ack %"U32_F"\n",
                  pcb->snd_wnd, pcb->cwnd, wnd,
                  ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len,
@@ -975,7 +1064,7 @@ tcp_output(struct tcp_pcb *pcb)
       break;
     }
 #if TCP_CWND_DEBUG
-    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"U16_F", cwnd %"U16_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
                             pcb->snd_wnd, pcb->cwnd, wnd,
                             ntohl(seg->tcphdr->seqno) + seg->len -
                             pcb->lastack,
@@ -1060,7 +1149,12 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   seg->tcphdr->ackno = htonl(pcb->rcv_nxt);
 
   /* advertise our receive window size in this TCP segment */
-  seg->tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+  if (TCPH_FLAGS(seg->tcphdr) & TCP_SYN) {
+    /* RFC 7323: the window field of a SYN is never scaled */
+    seg->tcphdr->wnd = htons(TCPWND16(pcb->rcv_ann_wnd));
+  } else {
+    seg->tcphdr->wnd = htons(TCPWND16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
+  }
 
   pcb->rcv_ann_right_edge = pcb->rcv_nxt + pcb->rcv_ann_wnd;
 
@@ -1085,6 +1179,18 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
     opts += 3;
   }
 #endif
+#if LWIP_WND_SCALE
+  if (seg->flags & TF_SEG_OPTS_WND_SCALE) {
+    *opts = TCP_BUILD_WND_SCALE_OPTION(pcb->rcv_scale);
+    opts += 1;
+  }
+#endif
+#if LWIP_TCP_SACK_OUT
+  if (seg->flags & TF_SEG_OPTS_SACK_PERM) {
+    *opts = TCP_BUILD_SACK_PERM_OPTION();
+    opts += 1;
+  }
+#endif
 
   /* Set retransmission timer running if it is not currently enabled 
      This must be set before checking the route. */
@@ -1340,7 +1446,7 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
     /* The minimum value for ssthresh should be 2 MSS */
     if (pcb->ssthresh < 2*pcb->mss) {
       LWIP_DEBUGF(TCP_FR_DEBUG, 
-                  ("tcp_receive: The minimum value for ssthresh %"U16_F
+                  ("tcp_receive: The minimum value for ssthresh %"TCPWNDSIZE_F
                    " should be min 2 mss %"U16_F"...\n",
                    pcb->ssthresh, 2*pcb->mss));
       pcb->ssthresh = 2*pcb->mss;
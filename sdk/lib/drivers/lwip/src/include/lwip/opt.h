@@ -923,6 +923,48 @@
 #define TCP_WND                         (4 * TCP_MSS)
 #endif 
 
+/**
+ * TCP_RCV_BUF_MAX: The largest receive window a single connection may grow
+ * to, either through tcp_setrcvbuf() or receive window autotuning. Without
+ * window scaling this is limited to 0xffff.
+ */
+#ifndef TCP_RCV_BUF_MAX
+#define TCP_RCV_BUF_MAX                 TCP_WND
+#endif
+
+/**
+ * LWIP_WND_SCALE==1: support the TCP window scale option (RFC 7323).
+ * TCP_RCV_SCALE is the shift count we offer for our receive window
+ * (0..14); it must be large enough for TCP_RCV_BUF_MAX to fit in 16 bits
+ * once shifted.
+ */
+#ifndef LWIP_WND_SCALE
+#define LWIP_WND_SCALE                  0
+#endif
+
+#ifndef TCP_RCV_SCALE
+#define TCP_RCV_SCALE                   0
+#endif
+
+/**
+ * LWIP_TCP_SACK_OUT==1: negotiate selective acknowledgements (RFC 2018) and
+ * report out-of-sequence data queued on ooseq as SACK blocks in our ACKs.
+ * SACK blocks received from the remote host are not used.
+ */
+#ifndef LWIP_TCP_SACK_OUT
+#define LWIP_TCP_SACK_OUT               0
+#endif
+
+/**
+ * LWIP_TCP_RCV_AUTOTUNE==1: grow the receive window of a connection (up to
+ * TCP_RCV_BUF_MAX) whenever the remote host fills the whole window we
+ * announced while the application keeps up with the data. Connections
+ * whose receive buffer was set with tcp_setrcvbuf() are not tuned.
+ */
+#ifndef LWIP_TCP_RCV_AUTOTUNE
+#define LWIP_TCP_RCV_AUTOTUNE           0
+#endif
+
 /**
  * TCP_MAXRTX: Maximum number of retransmissions of data segments.
  */
@@ -977,12 +1019,20 @@
 #define TCP_SND_BUF                     (2 * TCP_MSS)
 #endif
 
+/**
+ * TCP_SND_BUF_MAX: The largest send buffer tcp_setsndbuf() accepts for a
+ * single connection.
+ */
+#ifndef TCP_SND_BUF_MAX
+#define TCP_SND_BUF_MAX                 TCP_SND_BUF
+#endif
+
 /**
  * TCP_SND_QUEUELEN: TCP sender buffer space (pbufs). This must be at least
- * as much as (2 * TCP_SND_BUF/TCP_MSS) for things to work.
+ * as much as (2 * TCP_SND_BUF_MAX/TCP_MSS) for things to work.
  */
 #ifndef TCP_SND_QUEUELEN
-#define TCP_SND_QUEUELEN                ((4 * (TCP_SND_BUF) + (TCP_MSS - 1))/(TCP_MSS))
+#define TCP_SND_QUEUELEN                ((4 * (TCP_SND_BUF_MAX) + (TCP_MSS - 1))/(TCP_MSS))
 #endif
 
 /**
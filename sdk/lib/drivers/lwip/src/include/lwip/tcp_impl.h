@@ -292,16 +292,40 @@ struct tcp_seg {
 #define TF_SEG_OPTS_TS          (u8_t)0x02U /* Include timestamp option. */
 #define TF_SEG_DATA_CHECKSUMMED (u8_t)0x04U /* ALL data (not the header) is
                                                checksummed into 'chksum' */
+#define TF_SEG_OPTS_WND_SCALE   (u8_t)0x08U /* Include window scale option. */
+#define TF_SEG_OPTS_SACK_PERM   (u8_t)0x10U /* Include SACK permitted option. */
   struct tcp_hdr *tcphdr;  /* the TCP header */
 };
 
 #define LWIP_TCP_OPT_LENGTH(flags)              \
   (flags & TF_SEG_OPTS_MSS ? 4  : 0) +          \
-  (flags & TF_SEG_OPTS_TS  ? 12 : 0)
+  (flags & TF_SEG_OPTS_TS  ? 12 : 0) +          \
+  (flags & TF_SEG_OPTS_WND_SCALE ? 4 : 0) +     \
+  (flags & TF_SEG_OPTS_SACK_PERM ? 4 : 0)
 
 /** This returns a TCP header option for MSS in an u32_t */
 #define TCP_BUILD_MSS_OPTION(mss) htonl(0x02040000 | ((mss) & 0xFFFF))
 
+/** NOP + window scale option (RFC 7323) in an u32_t */
+#define TCP_BUILD_WND_SCALE_OPTION(shift) htonl(0x01030300 | ((shift) & 0xFF))
+
+/** NOP + NOP + SACK permitted option (RFC 2018) in an u32_t */
+#define TCP_BUILD_SACK_PERM_OPTION() PP_HTONL(0x01010402)
+
+/** Most SACK blocks that fit next to the timestamp option */
+#define TCP_SACK_MAX_BLOCKS       3
+
+/** The largest receive window pcb may use: windows only grow past 64K
+ * once the remote host has accepted our window scale option. Before the
+ * handshake completes we don't know yet, so allow the full size. */
+#if LWIP_WND_SCALE
+#define TCP_RCV_WND_LIMIT(pcb) ((((pcb)->flags & TF_WND_SCALE) || \
+                                 ((pcb)->state == CLOSED) || ((pcb)->state == SYN_SENT)) ? \
+                                TCP_RCV_BUF_MAX : TCPWND16(TCP_RCV_BUF_MAX))
+#else
+#define TCP_RCV_WND_LIMIT(pcb) TCP_RCV_BUF_MAX
+#endif
+
 /* Global variables: */
 extern struct tcp_pcb *tcp_input_pcb;
 extern u32_t tcp_ticks;
@@ -68,6 +68,20 @@
 
 #define TCP_SND_BUF                     TCP_WND
 
+/* Connections start with the 64K window above and grow through
+ * SO_RCVBUF/SO_SNDBUF or receive autotuning up to these limits */
+#define TCP_RCV_BUF_MAX                 0x100000
+
+#define TCP_SND_BUF_MAX                 0x100000
+
+#define LWIP_WND_SCALE                  1
+
+#define TCP_RCV_SCALE                   5
+
+#define LWIP_TCP_SACK_OUT               1
+
+#define LWIP_TCP_RCV_AUTOTUNE           1
+
 #define TCP_MAXRTX                      8
 
 #define TCP_SYNMAXRTX                   4
@@ -76,6 +90,13 @@
 
 #define LWIP_TCP_TIMESTAMPS             1
 
+/* TCPSendDataCallback fills in the TCP checksum while copying the
+ * segment (or leaves it to the adapter) and the IP layer redoes the
+ * IP header checksum for every fragment anyway */
+#define CHECKSUM_GEN_IP                 0
+
+#define CHECKSUM_GEN_TCP                0
+
 #define LWIP_CALLBACK_API               1
 
 #define LWIP_NETIF_API                  1
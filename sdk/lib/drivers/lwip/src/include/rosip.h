@@ -59,6 +59,11 @@ struct lwip_callback_msg
             PCONNECTION_ENDPOINT Connection;
             int Callback;
         } Close;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+            BOOLEAN Receive;
+            u32_t Size;
+        } BufferSize;
     } Input;
     
     /* Output */
@@ -85,6 +90,9 @@ struct lwip_callback_msg
         struct {
             err_t Error;
         } Close;
+        struct {
+            err_t Error;
+        } BufferSize;
     } Output;
 };
 
@@ -105,6 +113,7 @@ err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, con
 err_t       LibTCPConnect(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const u16_t port);
 err_t       LibTCPShutdown(PCONNECTION_ENDPOINT Connection, const int shut_rx, const int shut_tx);
 err_t       LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback);
+err_t       LibTCPSetBufferSize(PCONNECTION_ENDPOINT Connection, const BOOLEAN Receive, const u32_t Size);
 
 err_t       LibTCPGetPeerName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t *const port);
 err_t       LibTCPGetHostName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t *const port);
@@ -806,6 +806,67 @@ LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg)
     tcp_accepted(listen_pcb);
 }
 
+static
+void
+LibTCPSetBufferSizeCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PTCP_PCB pcb = msg->Input.BufferSize.Connection->SocketContext;
+
+    if (!pcb)
+    {
+        msg->Output.BufferSize.Error = ERR_CLSD;
+        goto done;
+    }
+
+    /* Listening PCBs have no buffers, accepted connections get their own */
+    if (pcb->state == LISTEN)
+    {
+        msg->Output.BufferSize.Error = ERR_VAL;
+        goto done;
+    }
+
+    if (msg->Input.BufferSize.Receive)
+        tcp_setrcvbuf(pcb, msg->Input.BufferSize.Size);
+    else
+        tcp_setsndbuf(pcb, msg->Input.BufferSize.Size);
+
+    msg->Output.BufferSize.Error = ERR_OK;
+
+done:
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+err_t
+LibTCPSetBufferSize(PCONNECTION_ENDPOINT Connection, const BOOLEAN Receive, const u32_t Size)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+
+        msg->Input.BufferSize.Connection = Connection;
+        msg->Input.BufferSize.Receive = Receive;
+        msg->Input.BufferSize.Size = Size;
+
+        tcpip_callback_with_block(LibTCPSetBufferSizeCallback, msg, 1);
+
+        if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.BufferSize.Error;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
 err_t
 LibTCPGetHostName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t *const port)
 {
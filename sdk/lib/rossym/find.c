@@ -89,6 +89,104 @@ FindEntry(IN PROSSYM_INFO RosSymInfo, IN ULONG_PTR RelativeAddress)
   return Low;
 }
 
+static PROSSYM_ENTRY
+FindCompactEntry(IN PROSSYM_INFO RosSymInfo, IN ULONG_PTR RelativeAddress,
+                 OUT PROSSYM_ENTRY Entry)
+{
+  PROSSYM_COMPACT_HEADER Header = RosSymInfo->Compact;
+  PROSSYM_COMPACT_BLOCK Blocks;
+  PULONG Pages;
+  ULONG_PTR Page;
+  ULONG Low, High, Mid, Start, End;
+  const UCHAR *Data, *DataEnd;
+  ROSSYM_ENTRY Current;
+  BOOLEAN Found = FALSE;
+
+  Blocks = (PROSSYM_COMPACT_BLOCK)((PCHAR) Header + Header->BlocksOffset);
+  Pages = (PULONG)((PCHAR) Header + Header->PagesOffset);
+
+  if (RelativeAddress < Blocks[0].Address)
+    {
+      return NULL;
+    }
+
+  /* The page table narrows the search down to the blocks of one page */
+  Page = RelativeAddress >> Header->PageShift;
+  if (Page < Header->PagesCount)
+    {
+      Low = Pages[Page];
+      High = (Page + 1 < Header->PagesCount) ? Pages[Page + 1] : Header->BlocksCount - 1;
+    }
+  else
+    {
+      Low = Pages[Header->PagesCount - 1];
+      High = Header->BlocksCount - 1;
+    }
+  if (High >= Header->BlocksCount || Low > High)
+    {
+      DPRINT1("Corrupt rossym page table\n");
+      return NULL;
+    }
+
+  /* Last block starting at or below the address */
+  while (Low < High)
+    {
+      Mid = Low + (High - Low + 1) / 2;
+      if (Blocks[Mid].Address <= RelativeAddress)
+        {
+          Low = Mid;
+        }
+      else
+        {
+          High = Mid - 1;
+        }
+    }
+
+  Start = Blocks[Low].DataOffset;
+  End = (Low + 1 < Header->BlocksCount) ? Blocks[Low + 1].DataOffset : Header->DataLength;
+  if (Start > End || End > Header->DataLength)
+    {
+      DPRINT1("Corrupt rossym block table\n");
+      return NULL;
+    }
+  Data = (const UCHAR *) Header + Header->DataOffset + Start;
+  DataEnd = (const UCHAR *) Header + Header->DataOffset + End;
+
+  /*
+   * Blocks never split a run of entries at the same address, take the
+   * first entry at the highest address not above the one looked for.
+   */
+  Current.Address = Blocks[Low].Address;
+  Current.FunctionOffset = 0;
+  Current.FileOffset = 0;
+  Current.SourceLine = 0;
+  while (Data < DataEnd)
+    {
+      if (!RosSymReadCompactEntry(&Data, DataEnd, &Current))
+        {
+          DPRINT1("Corrupt rossym data\n");
+          return NULL;
+        }
+      if (RelativeAddress < Current.Address)
+        {
+          break;
+        }
+      if (!Found || Entry->Address != Current.Address)
+        {
+          *Entry = Current;
+          Found = TRUE;
+        }
+    }
+
+  if (!Found || Entry->FunctionOffset >= RosSymInfo->StringsLength
+      || Entry->FileOffset >= RosSymInfo->StringsLength)
+    {
+      return NULL;
+    }
+
+  return Entry;
+}
+
 
 BOOLEAN
 RosSymGetAddressInformation(PROSSYM_INFO RosSymInfo,
@@ -98,10 +196,12 @@ RosSymGetAddressInformation(PROSSYM_INFO RosSymInfo,
                             char *FunctionName)
 {
   PROSSYM_ENTRY RosSymEntry;
+  ROSSYM_ENTRY CompactEntry;
 
   DPRINT("RelativeAddress = 0x%08x\n", RelativeAddress);
 
-  if (RosSymInfo->Symbols == NULL || RosSymInfo->SymbolsCount == 0 ||
+  if ((RosSymInfo->Symbols == NULL && RosSymInfo->Compact == NULL) ||
+      RosSymInfo->SymbolsCount == 0 ||
       RosSymInfo->Strings == NULL || RosSymInfo->StringsLength == 0)
     {
       DPRINT1("Uninitialized RosSymInfo\n");
@@ -111,7 +211,14 @@ RosSymGetAddressInformation(PROSSYM_INFO RosSymInfo,
   ASSERT(LineNumber || FileName || FunctionName);
 
   /* find symbol entry for function */
-  RosSymEntry = FindEntry(RosSymInfo, RelativeAddress);
+  if (RosSymInfo->Compact != NULL)
+    {
+      RosSymEntry = FindCompactEntry(RosSymInfo, RelativeAddress, &CompactEntry);
+    }
+  else
+    {
+      RosSymEntry = FindEntry(RosSymInfo, RelativeAddress);
+    }
 
   if (NULL == RosSymEntry)
     {
@@ -25,6 +25,8 @@ RosSymCreateFromFile(PVOID FileContext, PROSSYM_INFO *RosSymInfo)
   unsigned SectionIndex;
   char SectionName[IMAGE_SIZEOF_SHORT_NAME];
   ROSSYM_HEADER RosSymHeader;
+  ROSSYM_COMPACT_HEADER CompactHeader;
+  ULONG Length;
 
   /* Load DOS header */
   if (! RosSymReadFile(FileContext, &DosHeader, sizeof(IMAGE_DOS_HEADER)))
@@ -110,6 +112,43 @@ RosSymCreateFromFile(PVOID FileContext, PROSSYM_INFO *RosSymInfo)
       DPRINT1("Failed to read rossym header\n");
       return FALSE;
     }
+  if (RosSymHeader.SymbolsOffset == ROSSYM_COMPACT_MAGIC)
+    {
+      /* Compact section, read the rest of its header */
+      memcpy(&CompactHeader, &RosSymHeader, sizeof(ROSSYM_HEADER));
+      if (! RosSymReadFile(FileContext, (PCHAR) &CompactHeader + sizeof(ROSSYM_HEADER),
+                           sizeof(ROSSYM_COMPACT_HEADER) - sizeof(ROSSYM_HEADER)))
+        {
+          DPRINT1("Failed to read rossym header\n");
+          return FALSE;
+        }
+      Length = CompactHeader.StringsOffset + CompactHeader.StringsLength;
+      if (Length < CompactHeader.StringsOffset
+          || ! RosSymIsValidCompactHeader(&CompactHeader, Length))
+        {
+          DPRINT1("Invalid ROSSYM_COMPACT_HEADER\n");
+          return FALSE;
+        }
+
+      *RosSymInfo = RosSymAllocMem(sizeof(ROSSYM_INFO) + Length + 1);
+      if (NULL == *RosSymInfo)
+        {
+          DPRINT1("Failed to allocate memory for rossym\n");
+          return FALSE;
+        }
+      memcpy(*RosSymInfo + 1, &CompactHeader, sizeof(ROSSYM_COMPACT_HEADER));
+      if (! RosSymReadFile(FileContext, (PCHAR)(*RosSymInfo + 1) + sizeof(ROSSYM_COMPACT_HEADER),
+                           Length - sizeof(ROSSYM_COMPACT_HEADER))
+          || ! RosSymCreateFromCompact(*RosSymInfo, Length))
+        {
+          DPRINT1("Failed to read rossym data\n");
+          RosSymFreeMem(*RosSymInfo);
+          *RosSymInfo = NULL;
+          return FALSE;
+        }
+
+      return TRUE;
+    }
   if (RosSymHeader.SymbolsOffset < sizeof(ROSSYM_HEADER)
       || RosSymHeader.StringsOffset < RosSymHeader.SymbolsOffset + RosSymHeader.SymbolsLength
       || 0 != (RosSymHeader.SymbolsLength % sizeof(ROSSYM_ENTRY)))
@@ -131,6 +170,8 @@ RosSymCreateFromFile(PVOID FileContext, PROSSYM_INFO *RosSymInfo)
   (*RosSymInfo)->Strings = (PCHAR) *RosSymInfo + sizeof(ROSSYM_INFO) - sizeof(ROSSYM_HEADER)
                            + RosSymHeader.StringsOffset;
   (*RosSymInfo)->StringsLength = RosSymHeader.StringsLength;
+  (*RosSymInfo)->Compact = NULL;
+  (*RosSymInfo)->CompactLength = 0;
   if (! RosSymReadFile(FileContext, *RosSymInfo + 1,
                        RosSymHeader.StringsOffset + RosSymHeader.StringsLength
                        - sizeof(ROSSYM_HEADER)))
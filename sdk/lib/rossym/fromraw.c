@@ -15,10 +15,64 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Sets up RosSymInfo for a compact section of Length bytes copied right behind it */
+BOOLEAN
+RosSymCreateFromCompact(PROSSYM_INFO RosSymInfo, ULONG Length)
+{
+  PROSSYM_COMPACT_HEADER Compact = (PROSSYM_COMPACT_HEADER)(RosSymInfo + 1);
+
+  if (! RosSymIsValidCompactHeader(Compact, Length))
+    {
+      DPRINT1("Invalid ROSSYM_COMPACT_HEADER\n");
+      return FALSE;
+    }
+
+  RosSymInfo->Symbols = NULL;
+  RosSymInfo->SymbolsCount = Compact->SymbolsCount;
+  RosSymInfo->Strings = (PCHAR) Compact + Compact->StringsOffset;
+  RosSymInfo->StringsLength = Compact->StringsLength;
+  RosSymInfo->Compact = Compact;
+  RosSymInfo->CompactLength = Length;
+  /* Make sure the last string is null terminated, we allocated an extra byte for that */
+  ((PCHAR) Compact)[Length] = '\0';
+
+  return TRUE;
+}
+
 BOOLEAN
 RosSymCreateFromRaw(PVOID RawData, ULONG_PTR DataSize, PROSSYM_INFO *RosSymInfo)
 {
   PROSSYM_HEADER RosSymHeader;
+  PROSSYM_COMPACT_HEADER Compact;
+  ULONG Length;
+
+  Compact = (PROSSYM_COMPACT_HEADER) RawData;
+  if (DataSize >= sizeof(ROSSYM_COMPACT_HEADER) && Compact->Magic == ROSSYM_COMPACT_MAGIC)
+    {
+      if (! RosSymIsValidCompactHeader(Compact, DataSize))
+        {
+          DPRINT1("Invalid ROSSYM_COMPACT_HEADER\n");
+          return FALSE;
+        }
+
+      /* The string table comes last, drop the section padding */
+      Length = Compact->StringsOffset + Compact->StringsLength;
+      *RosSymInfo = RosSymAllocMem(sizeof(ROSSYM_INFO) + Length + 1);
+      if (NULL == *RosSymInfo)
+        {
+          DPRINT1("Failed to allocate memory for rossym\n");
+          return FALSE;
+        }
+      memcpy(*RosSymInfo + 1, RawData, Length);
+      if (! RosSymCreateFromCompact(*RosSymInfo, Length))
+        {
+          RosSymFreeMem(*RosSymInfo);
+          *RosSymInfo = NULL;
+          return FALSE;
+        }
+
+      return TRUE;
+    }
 
   RosSymHeader = (PROSSYM_HEADER) RawData;
   if (RosSymHeader->SymbolsOffset < sizeof(ROSSYM_HEADER)
@@ -42,6 +96,8 @@ RosSymCreateFromRaw(PVOID RawData, ULONG_PTR DataSize, PROSSYM_INFO *RosSymInfo)
   (*RosSymInfo)->SymbolsCount = RosSymHeader->SymbolsLength / sizeof(ROSSYM_ENTRY);
   (*RosSymInfo)->Strings = (PCHAR) *RosSymInfo + sizeof(ROSSYM_INFO) + RosSymHeader->SymbolsLength;
   (*RosSymInfo)->StringsLength = RosSymHeader->StringsLength;
+  (*RosSymInfo)->Compact = NULL;
+  (*RosSymInfo)->CompactLength = 0;
   memcpy((*RosSymInfo)->Symbols, (char *) RosSymHeader + RosSymHeader->SymbolsOffset,
          RosSymHeader->SymbolsLength);
   memcpy((*RosSymInfo)->Strings, (char *) RosSymHeader + RosSymHeader->StringsOffset,
@@ -15,6 +15,11 @@
 ULONG
 RosSymGetRawDataLength(PROSSYM_INFO RosSymInfo)
 {
+  if (RosSymInfo->Compact != NULL)
+    {
+      return RosSymInfo->CompactLength;
+    }
+
   return sizeof(ROSSYM_HEADER)
          + RosSymInfo->SymbolsCount * sizeof(ROSSYM_ENTRY)
          + RosSymInfo->StringsLength;
@@ -25,6 +30,12 @@ RosSymGetRawData(PROSSYM_INFO RosSymInfo, PVOID RawData)
 {
   PROSSYM_HEADER RosSymHeader;
 
+  if (RosSymInfo->Compact != NULL)
+    {
+      memcpy(RawData, RosSymInfo->Compact, RosSymInfo->CompactLength);
+      return;
+    }
+
   RosSymHeader = (PROSSYM_HEADER) RawData;
   RosSymHeader->SymbolsOffset = sizeof(ROSSYM_HEADER);
   RosSymHeader->SymbolsLength = RosSymInfo->SymbolsCount * sizeof(ROSSYM_ENTRY);
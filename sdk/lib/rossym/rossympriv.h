@@ -14,6 +14,9 @@ typedef struct _ROSSYM_INFO {
   ULONG SymbolsCount;
   PCHAR Strings;
   ULONG StringsLength;
+  /* Compact section kept as loaded, Symbols is NULL then */
+  PROSSYM_COMPACT_HEADER Compact;
+  ULONG CompactLength;
 } ROSSYM_INFO;
 
 extern ROSSYM_CALLBACKS RosSymCallbacks;
@@ -23,6 +26,8 @@ extern ROSSYM_CALLBACKS RosSymCallbacks;
 #define RosSymReadFile(FileContext, Buffer, Size) (*RosSymCallbacks.ReadFileProc)((FileContext), (Buffer), (Size))
 #define RosSymSeekFile(FileContext, Position) (*RosSymCallbacks.SeekFileProc)((FileContext), (Position))
 
+extern BOOLEAN RosSymCreateFromCompact(PROSSYM_INFO RosSymInfo, ULONG Length);
+
 extern BOOLEAN RosSymZwReadFile(PVOID FileContext, PVOID Buffer, ULONG Size);
 extern BOOLEAN RosSymZwSeekFile(PVOID FileContext, ULONG_PTR Position);
 
@@ -16,6 +16,16 @@
 
 #define MAX_STATIC_CS_DEBUG_OBJECTS 64
 
+/*
+ * SpinCount keeps the spin limit set by the caller in its low 24 bits. The
+ * top byte holds what the lock learned about spinning: the number of times
+ * the limit is halved because recent spins ended up waiting anyway.
+ */
+#define RTLP_CS_SPIN_LIMIT_MASK     0x00FFFFFF
+#define RTLP_CS_SPIN_SHIFT_OFFSET   24
+#define RTLP_CS_SPIN_MAX_SHIFT      7
+#define RTLP_CS_SPIN_MAX_BACKOFF    64
+
 static RTL_CRITICAL_SECTION RtlCriticalSectionLock;
 static LIST_ENTRY RtlCriticalSectionList;
 static BOOLEAN RtlpCritSectInitialized = FALSE;
@@ -457,13 +467,86 @@ NTAPI
 RtlSetCriticalSectionSpinCount(PRTL_CRITICAL_SECTION CriticalSection,
                                ULONG SpinCount)
 {
-    ULONG OldCount = (ULONG)CriticalSection->SpinCount;
+    ULONG OldCount = (ULONG)CriticalSection->SpinCount & RTLP_CS_SPIN_LIMIT_MASK;
 
-    /* Set to parameter if MP, or to 0 if this is Uniprocessor */
-    CriticalSection->SpinCount = (NtCurrentPeb()->NumberOfProcessors > 1) ? SpinCount : 0;
+    /* Set to parameter if MP, or to 0 if this is Uniprocessor. This also
+       forgets what the lock learned about spinning so far. */
+    CriticalSection->SpinCount = (NtCurrentPeb()->NumberOfProcessors > 1) ?
+                                 (SpinCount & RTLP_CS_SPIN_LIMIT_MASK) : 0;
     return OldCount;
 }
 
+/*++
+ * RtlpSpinOnCriticalSection
+ *
+ *     Spins on a contended critical section before waiting for it.
+ *
+ * Params:
+ *     CriticalSection - Critical section to acquire.
+ *
+ *     SpinCount - Current value of the SpinCount field, non-zero.
+ *
+ * Returns:
+ *     TRUE if the critical section was acquired, FALSE if the caller has
+ *     to go through the regular (waiting) path.
+ *
+ * Remarks:
+ *     Only takes the lock while it is free and nobody waits for it, so
+ *     waiters woken up by RtlpUnWaitCriticalSection are never robbed of
+ *     the ownership they are handed. The spin budget adapts per lock:
+ *     it is halved each time spinning was in vain and doubled again each
+ *     time it paid off.
+ *
+ *--*/
+static
+BOOLEAN
+RtlpSpinOnCriticalSection(PRTL_CRITICAL_SECTION CriticalSection,
+                          ULONG_PTR SpinCount)
+{
+    ULONG Shift = (ULONG)(SpinCount >> RTLP_CS_SPIN_SHIFT_OFFSET) & 0xFF;
+    ULONG Budget = ((ULONG)SpinCount & RTLP_CS_SPIN_LIMIT_MASK) >> Shift;
+    ULONG Backoff = 1, Spins = 0, i;
+    BOOLEAN Acquired = FALSE;
+
+    if (!Budget) Budget = 1;
+
+    while (Spins < Budget)
+    {
+        if (CriticalSection->LockCount == -1 &&
+            InterlockedCompareExchange(&CriticalSection->LockCount, 0, -1) == -1)
+        {
+            Acquired = TRUE;
+            break;
+        }
+
+        /* Back off exponentially so the spinners don't hammer the cache line */
+        for (i = 0; i < Backoff; i++) YieldProcessor();
+        Spins += Backoff;
+        if (Backoff < RTLP_CS_SPIN_MAX_BACKOFF) Backoff <<= 1;
+    }
+
+    /*
+     * Spinning that gets the lock is still contention. If it doesn't,
+     * RtlpWaitForCriticalSection counts the wait instead.
+     */
+    if (Acquired && CriticalSection->DebugInfo)
+        CriticalSection->DebugInfo->ContentionCount++;
+
+    /* Learn from the outcome; losing a racing update is harmless */
+    if (Acquired && Shift > 0)
+        Shift--;
+    else if (!Acquired && Shift < RTLP_CS_SPIN_MAX_SHIFT)
+        Shift++;
+    else
+        return Acquired;
+
+    InterlockedCompareExchangePointer((PVOID*)&CriticalSection->SpinCount,
+                                      (PVOID)((SpinCount & RTLP_CS_SPIN_LIMIT_MASK) |
+                                              ((ULONG_PTR)Shift << RTLP_CS_SPIN_SHIFT_OFFSET)),
+                                      (PVOID)SpinCount);
+    return Acquired;
+}
+
 /*++
  * RtlEnterCriticalSection
  * @implemented NT4
@@ -477,7 +560,8 @@ RtlSetCriticalSectionSpinCount(PRTL_CRITICAL_SECTION CriticalSection,
  *     STATUS_SUCCESS.
  *
  * Remarks:
- *     Uses a fast-path unless contention happens.
+ *     Uses a fast-path unless contention happens. On contention, locks
+ *     with a spin count spin adaptively before waiting.
  *
  *--*/
 NTSTATUS
@@ -485,6 +569,22 @@ NTAPI
 RtlEnterCriticalSection(PRTL_CRITICAL_SECTION CriticalSection)
 {
     HANDLE Thread = (HANDLE)NtCurrentTeb()->ClientId.UniqueThread;
+    ULONG_PTR SpinCount = CriticalSection->SpinCount;
+
+    /*
+     * On a contended lock with a spin count, spin for a while before
+     * queuing up as a waiter. The owner check keeps recursive acquires
+     * on the fast path below.
+     */
+    if ((SpinCount & RTLP_CS_SPIN_LIMIT_MASK) &&
+        CriticalSection->LockCount != -1 &&
+        CriticalSection->OwningThread != Thread &&
+        RtlpSpinOnCriticalSection(CriticalSection, SpinCount))
+    {
+        CriticalSection->OwningThread = Thread;
+        CriticalSection->RecursionCount = 1;
+        return STATUS_SUCCESS;
+    }
 
     /* Try to lock it */
     if (InterlockedIncrement(&CriticalSection->LockCount) != 0)
@@ -576,7 +676,8 @@ RtlInitializeCriticalSectionAndSpinCount(PRTL_CRITICAL_SECTION CriticalSection,
     CriticalSection->LockCount = -1;
     CriticalSection->RecursionCount = 0;
     CriticalSection->OwningThread = 0;
-    CriticalSection->SpinCount = (NtCurrentPeb()->NumberOfProcessors > 1) ? SpinCount : 0;
+    CriticalSection->SpinCount = (NtCurrentPeb()->NumberOfProcessors > 1) ?
+                                 (SpinCount & RTLP_CS_SPIN_LIMIT_MASK) : 0;
     CriticalSection->LockSemaphore = 0;
 
     /* Allocate the Debug Data */
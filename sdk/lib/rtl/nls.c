@@ -13,6 +13,10 @@
 #define NDEBUG
 #include <debug.h>
 
+#if defined(_M_AMD64)
+#include <emmintrin.h>
+#endif
+
 /* GLOBALS *******************************************************************/
 
 PUSHORT NlsUnicodeUpcaseTable = NULL;
@@ -35,6 +39,252 @@ PUSHORT NlsOemLeadByteInfo = NULL; /* exported */
 USHORT NlsOemDefaultChar = '\0';
 USHORT NlsUnicodeDefaultChar = 0;
 
+/* Whether the single-byte tables map 0x00-0x7F onto themselves */
+static BOOLEAN NlsAnsiAsciiIdentity = FALSE;
+static BOOLEAN NlsOemAsciiIdentity = FALSE;
+
+#define RTLP_UTF8_INVALID 0xFFFFFFFF
+
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+/*
+ * Widens the run of ASCII bytes at the start of Source and returns its
+ * length. With no Destination the run is only measured.
+ *
+ * x64 always has SSE2 and may use it in kernel mode, so it takes 16 bytes
+ * per step there. The x86 build targets CPUs without SSE2 and runs in
+ * kernel mode without saving the FPU state, so it checks 8 bytes at a time
+ * with plain integer arithmetic instead, relying on unaligned loads being
+ * allowed. Other architectures go byte by byte.
+ */
+static
+ULONG
+RtlpWidenAsciiRun(OUT PWCHAR Destination OPTIONAL,
+                  IN PCSTR Source,
+                  IN ULONG Count)
+{
+    ULONG i = 0;
+#if defined(_M_AMD64)
+    const __m128i Zero = _mm_setzero_si128();
+
+    for (; Count - i >= 16; i += 16)
+    {
+        __m128i Chunk = _mm_loadu_si128((const __m128i *)&Source[i]);
+
+        if (_mm_movemask_epi8(Chunk))
+            break;
+
+        if (Destination)
+        {
+            _mm_storeu_si128((__m128i *)&Destination[i], _mm_unpacklo_epi8(Chunk, Zero));
+            _mm_storeu_si128((__m128i *)&Destination[i + 8], _mm_unpackhi_epi8(Chunk, Zero));
+        }
+    }
+#elif defined(_M_IX86)
+    ULONG j;
+
+    for (; Count - i >= 8; i += 8)
+    {
+        if (*(ULONGLONG UNALIGNED *)&Source[i] & 0x8080808080808080ULL)
+            break;
+
+        if (Destination)
+        {
+            for (j = 0; j < 8; j++)
+                Destination[i + j] = (UCHAR)Source[i + j];
+        }
+    }
+#endif
+
+    /* Finish the run one byte at a time */
+    for (; i < Count && !(Source[i] & 0x80); i++)
+    {
+        if (Destination)
+            Destination[i] = (UCHAR)Source[i];
+    }
+
+    return i;
+}
+
+/*
+ * Narrows the run of characters below 0x80 at the start of Source and
+ * returns its length. With no Destination the run is only measured.
+ */
+static
+ULONG
+RtlpNarrowAsciiRun(OUT PCHAR Destination OPTIONAL,
+                   IN PCWCH Source,
+                   IN ULONG Count)
+{
+    ULONG i = 0;
+#if defined(_M_AMD64)
+    const __m128i NonAscii = _mm_set1_epi16((SHORT)0xFF80);
+    const __m128i Zero = _mm_setzero_si128();
+
+    for (; Count - i >= 16; i += 16)
+    {
+        __m128i Low = _mm_loadu_si128((const __m128i *)&Source[i]);
+        __m128i High = _mm_loadu_si128((const __m128i *)&Source[i + 8]);
+        __m128i Bits = _mm_and_si128(_mm_or_si128(Low, High), NonAscii);
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(Bits, Zero)) != 0xFFFF)
+            break;
+
+        if (Destination)
+            _mm_storeu_si128((__m128i *)&Destination[i], _mm_packus_epi16(Low, High));
+    }
+#elif defined(_M_IX86)
+    ULONG j;
+
+    for (; Count - i >= 4; i += 4)
+    {
+        if (*(ULONGLONG UNALIGNED *)&Source[i] & 0xFF80FF80FF80FF80ULL)
+            break;
+
+        if (Destination)
+        {
+            for (j = 0; j < 4; j++)
+                Destination[i + j] = (CHAR)Source[i + j];
+        }
+    }
+#endif
+
+    /* Finish the run one character at a time */
+    for (; i < Count && Source[i] < 0x80; i++)
+    {
+        if (Destination)
+            Destination[i] = (CHAR)Source[i];
+    }
+
+    return i;
+}
+
+/*
+ * Translates Count bytes of a single-byte code page. ASCII runs are copied
+ * in bulk when the table maps them onto themselves, everything else goes
+ * through the table.
+ */
+static
+VOID
+RtlpSingleByteToUnicode(OUT PWCHAR UnicodeString,
+                        IN PCSTR MbString,
+                        IN ULONG Count,
+                        IN PUSHORT MultiByteTable,
+                        IN BOOLEAN AsciiIdentity)
+{
+    ULONG i = 0;
+
+    while (i < Count)
+    {
+        if (AsciiIdentity && !(MbString[i] & 0x80))
+        {
+            i += RtlpWidenAsciiRun(&UnicodeString[i], &MbString[i], Count - i);
+            continue;
+        }
+
+        UnicodeString[i] = MultiByteTable[(UCHAR)MbString[i]];
+        i++;
+    }
+}
+
+static
+VOID
+RtlpUnicodeToSingleByte(OUT PCHAR MbString,
+                        IN PCWCH UnicodeString,
+                        IN ULONG Count,
+                        IN PCHAR WideCharTable,
+                        IN BOOLEAN AsciiIdentity)
+{
+    ULONG i = 0;
+
+    while (i < Count)
+    {
+        if (AsciiIdentity && UnicodeString[i] < 0x80)
+        {
+            i += RtlpNarrowAsciiRun(&MbString[i], &UnicodeString[i], Count - i);
+            continue;
+        }
+
+        MbString[i] = WideCharTable[UnicodeString[i]];
+        i++;
+    }
+}
+
+static
+BOOLEAN
+RtlpIsAsciiIdentityTable(IN PCPTABLEINFO TableInfo)
+{
+    PCHAR WideCharTable = TableInfo->WideCharTable;
+    ULONG i;
+
+    /* The double-byte paths handle ASCII on their own */
+    if (TableInfo->DBCSCodePage)
+        return FALSE;
+
+    for (i = 0; i < 0x80; i++)
+    {
+        if (TableInfo->MultiByteTable[i] != i || (UCHAR)WideCharTable[i] != i)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Decodes the UTF-8 sequence introduced by Lead, advancing *Source past its
+ * trail bytes. Ill-formed sequences return RTLP_UTF8_INVALID after consuming
+ * the longest prefix that could still have started a valid sequence, so each
+ * maximal invalid subpart becomes one replacement character.
+ */
+static
+ULONG
+RtlpDecodeUtf8(IN UCHAR Lead,
+               IN OUT PCCH *Source,
+               IN PCCH SourceEnd)
+{
+    ULONG CodePoint;
+    ULONG TrailBytes;
+    ULONG i;
+    UCHAR Next;
+
+    /* Stray trail bytes, overlong two-byte forms and leads past U+10FFFF */
+    if (Lead < 0xC2 || Lead > 0xF4)
+        return RTLP_UTF8_INVALID;
+
+    TrailBytes = (Lead >= 0xF0) ? 3 : (Lead >= 0xE0) ? 2 : 1;
+    CodePoint = Lead & (0x3F >> TrailBytes);
+
+    for (i = 0; i < TrailBytes; i++)
+    {
+        if (*Source == SourceEnd)
+            return RTLP_UTF8_INVALID;
+
+        Next = (UCHAR)**Source ^ 0x80;
+        if (Next >= 0x40)
+            return RTLP_UTF8_INVALID;
+
+        CodePoint = (CodePoint << 6) | Next;
+        (*Source)++;
+
+        /* The first trail byte already tells overlong forms, surrogates and out of range values apart */
+        if (i == 0 && TrailBytes == 2 &&
+            (CodePoint < (0x800 >> 6) ||
+             (CodePoint >= (0xD800 >> 6) && CodePoint <= (0xDFFF >> 6))))
+        {
+            return RTLP_UTF8_INVALID;
+        }
+
+        if (i == 0 && TrailBytes == 3 &&
+            (CodePoint < (0x10000 >> 12) || CodePoint >= (0x110000 >> 12)))
+        {
+            return RTLP_UTF8_INVALID;
+        }
+    }
+
+    return CodePoint;
+}
+
 
 /* FUNCTIONS *****************************************************************/
 
@@ -250,8 +500,11 @@ RtlMultiByteToUnicodeN(OUT PWCHAR UnicodeString,
         if (ResultSize)
             *ResultSize = Size * sizeof(WCHAR);
 
-        for (i = 0; i < Size; i++)
-            UnicodeString[i] = NlsAnsiToUnicodeTable[(UCHAR)MbString[i]];
+        RtlpSingleByteToUnicode(UnicodeString,
+                                MbString,
+                                Size,
+                                NlsAnsiToUnicodeTable,
+                                NlsAnsiAsciiIdentity);
     }
     else
     {
@@ -260,6 +513,7 @@ RtlMultiByteToUnicodeN(OUT PWCHAR UnicodeString,
 
         UCHAR Char;
         USHORT LeadByteInfo;
+        ULONG Run;
         PCSTR MbEnd = MbString + MbSize;
 
         for (i = 0; i < UnicodeSize / sizeof(WCHAR) && MbString < MbEnd; i++)
@@ -269,6 +523,15 @@ RtlMultiByteToUnicodeN(OUT PWCHAR UnicodeString,
             if (Char < 0x80)
             {
                 *UnicodeString++ = Char;
+
+                /* Copy the rest of the ASCII run in bulk */
+                Run = RtlpWidenAsciiRun(UnicodeString,
+                                        MbString,
+                                        min(UnicodeSize / sizeof(WCHAR) - i - 1,
+                                            (ULONG)(MbEnd - MbString)));
+                UnicodeString += Run;
+                MbString += Run;
+                i += Run;
                 continue;
             }
 
@@ -390,12 +653,11 @@ RtlOemToUnicodeN(OUT PWCHAR UnicodeString,
         if (ResultSize)
             *ResultSize = Size * sizeof(WCHAR);
 
-        for (i = 0; i < Size; i++)
-        {
-            *UnicodeString = NlsOemToUnicodeTable[(UCHAR)*OemString];
-            UnicodeString++;
-            OemString++;
-        }
+        RtlpSingleByteToUnicode(UnicodeString,
+                                OemString,
+                                Size,
+                                NlsOemToUnicodeTable,
+                                NlsOemAsciiIdentity);
     }
     else
     {
@@ -404,6 +666,7 @@ RtlOemToUnicodeN(OUT PWCHAR UnicodeString,
 
         UCHAR Char;
         USHORT OemLeadByteInfo;
+        ULONG Run;
         PCCH OemEnd = OemString + OemSize;
 
         for (i = 0; i < UnicodeSize / sizeof(WCHAR) && OemString < OemEnd; i++)
@@ -413,6 +676,15 @@ RtlOemToUnicodeN(OUT PWCHAR UnicodeString,
             if (Char < 0x80)
             {
                 *UnicodeString++ = Char;
+
+                /* Copy the rest of the ASCII run in bulk */
+                Run = RtlpWidenAsciiRun(UnicodeString,
+                                        OemString,
+                                        min(UnicodeSize / sizeof(WCHAR) - i - 1,
+                                            (ULONG)(OemEnd - OemString)));
+                UnicodeString += Run;
+                OemString += Run;
+                i += Run;
                 continue;
             }
 
@@ -453,6 +725,7 @@ RtlResetRtlTranslations(IN PNLSTABLEINFO NlsTable)
     NlsMbCodePageTag = (NlsTable->AnsiTableInfo.DBCSCodePage != 0);
     NlsLeadByteInfo = NlsTable->AnsiTableInfo.DBCSOffsets;
     NlsAnsiCodePage = NlsTable->AnsiTableInfo.CodePage;
+    NlsAnsiAsciiIdentity = RtlpIsAsciiIdentityTable(&NlsTable->AnsiTableInfo);
     DPRINT("Ansi codepage %hu\n", NlsAnsiCodePage);
 
     /* Set OEM data */
@@ -462,6 +735,7 @@ RtlResetRtlTranslations(IN PNLSTABLEINFO NlsTable)
     NlsMbOemCodePageTag = (NlsTable->OemTableInfo.DBCSCodePage != 0);
     NlsOemLeadByteInfo = NlsTable->OemTableInfo.DBCSOffsets;
     NlsOemCodePage = NlsTable->OemTableInfo.CodePage;
+    NlsOemAsciiIdentity = RtlpIsAsciiIdentityTable(&NlsTable->OemTableInfo);
     DPRINT("Oem codepage %hu\n", NlsOemCodePage);
 
     /* Set Unicode case map data */
@@ -541,10 +815,11 @@ RtlUnicodeToMultiByteN(OUT PCHAR MbString,
         if (ResultSize)
             *ResultSize = Size;
 
-        for (i = 0; i < Size; i++)
-        {
-            *MbString++ = NlsUnicodeToAnsiTable[*UnicodeString++];
-        }
+        RtlpUnicodeToSingleByte(MbString,
+                                UnicodeString,
+                                Size,
+                                NlsUnicodeToAnsiTable,
+                                NlsAnsiAsciiIdentity);
     }
     else
     {
@@ -553,6 +828,7 @@ RtlUnicodeToMultiByteN(OUT PCHAR MbString,
 
         USHORT WideChar;
         USHORT MbChar;
+        ULONG Run;
 
         for (i = MbSize, Size = UnicodeSize / sizeof(WCHAR); i && Size; i--, Size--)
         {
@@ -561,6 +837,13 @@ RtlUnicodeToMultiByteN(OUT PCHAR MbString,
             if (WideChar < 0x80)
             {
                 *MbString++ = LOBYTE(WideChar);
+
+                /* Copy the rest of the ASCII run in bulk */
+                Run = RtlpNarrowAsciiRun(MbString, UnicodeString, min(i - 1, Size - 1));
+                MbString += Run;
+                UnicodeString += Run;
+                i -= Run;
+                Size -= Run;
                 continue;
             }
 
@@ -659,12 +942,11 @@ RtlUnicodeToOemN(OUT PCHAR OemString,
         if (ResultSize)
             *ResultSize = Size;
 
-        for (i = 0; i < Size; i++)
-        {
-            *OemString = NlsUnicodeToOemTable[*UnicodeString];
-            OemString++;
-            UnicodeString++;
-        }
+        RtlpUnicodeToSingleByte(OemString,
+                                UnicodeString,
+                                Size,
+                                NlsUnicodeToOemTable,
+                                NlsOemAsciiIdentity);
     }
     else
     {
@@ -673,6 +955,7 @@ RtlUnicodeToOemN(OUT PCHAR OemString,
 
         USHORT WideChar;
         USHORT OemChar;
+        ULONG Run;
 
         for (i = OemSize, Size = UnicodeSize / sizeof(WCHAR); i && Size; i--, Size--)
         {
@@ -681,6 +964,13 @@ RtlUnicodeToOemN(OUT PCHAR OemString,
             if (WideChar < 0x80)
             {
                 *OemString++ = LOBYTE(WideChar);
+
+                /* Copy the rest of the ASCII run in bulk */
+                Run = RtlpNarrowAsciiRun(OemString, UnicodeString, min(i - 1, Size - 1));
+                OemString += Run;
+                UnicodeString += Run;
+                i -= Run;
+                Size -= Run;
                 continue;
             }
 
@@ -708,6 +998,211 @@ RtlUnicodeToOemN(OUT PCHAR OemString,
     return STATUS_SUCCESS;
 }
 
+/*
+ * @implemented
+ */
+NTSTATUS NTAPI
+RtlUnicodeToUTF8N(OUT PCHAR UTF8StringDestination OPTIONAL,
+                  IN ULONG UTF8StringMaxByteCount,
+                  OUT PULONG UTF8StringActualByteCount,
+                  IN PCWCH UnicodeStringSource,
+                  IN ULONG UnicodeStringByteCount)
+{
+    static const UCHAR LeadBits[5] = { 0, 0, 0xC0, 0xE0, 0xF0 };
+    PCWCH Source = UnicodeStringSource;
+    PCWCH SourceEnd;
+    NTSTATUS Status = STATUS_SUCCESS;
+    ULONG Length = 0;
+    ULONG MaxLength;
+    ULONG CodePoint;
+    ULONG Bytes;
+    ULONG Consumed;
+    ULONG Run;
+    ULONG i;
+
+    PAGED_CODE_RTL();
+
+    if (!UnicodeStringSource)
+        return STATUS_INVALID_PARAMETER_4;
+
+    if (!UTF8StringActualByteCount)
+        return STATUS_INVALID_PARAMETER;
+
+    if (UTF8StringDestination && (UnicodeStringByteCount % sizeof(WCHAR)))
+        return STATUS_INVALID_PARAMETER_5;
+
+    SourceEnd = Source + UnicodeStringByteCount / sizeof(WCHAR);
+
+    /* Without a destination only the required size is computed */
+    MaxLength = UTF8StringDestination ? UTF8StringMaxByteCount : MAXULONG;
+
+    while (Source < SourceEnd)
+    {
+        CodePoint = *Source;
+
+        if (CodePoint < 0x80)
+        {
+            Run = min((ULONG)(SourceEnd - Source), MaxLength - Length);
+            if (!Run)
+            {
+                Status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+
+            Run = RtlpNarrowAsciiRun(UTF8StringDestination ? &UTF8StringDestination[Length] : NULL,
+                                     Source,
+                                     Run);
+            Source += Run;
+            Length += Run;
+            continue;
+        }
+
+        Consumed = 1;
+
+        if (CodePoint < 0x800)
+        {
+            Bytes = 2;
+        }
+        else if ((CodePoint & 0xFC00) == 0xD800 &&
+                 SourceEnd - Source >= 2 &&
+                 (Source[1] & 0xFC00) == 0xDC00)
+        {
+            CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (Source[1] - 0xDC00);
+            Bytes = 4;
+            Consumed = 2;
+        }
+        else
+        {
+            Bytes = 3;
+        }
+
+        if (MaxLength - Length < Bytes)
+        {
+            Status = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+
+        /* Unpaired surrogates cannot be encoded */
+        if (CodePoint >= 0xD800 && CodePoint <= 0xDFFF)
+        {
+            CodePoint = 0xFFFD;
+            Status = STATUS_SOME_NOT_MAPPED;
+        }
+
+        if (UTF8StringDestination)
+        {
+            for (i = Bytes - 1; i; i--)
+            {
+                UTF8StringDestination[Length + i] = (CHAR)(0x80 | (CodePoint & 0x3F));
+                CodePoint >>= 6;
+            }
+
+            UTF8StringDestination[Length] = (CHAR)(LeadBits[Bytes] | CodePoint);
+        }
+
+        Source += Consumed;
+        Length += Bytes;
+    }
+
+    *UTF8StringActualByteCount = Length;
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS NTAPI
+RtlUTF8ToUnicodeN(OUT PWSTR UnicodeStringDestination OPTIONAL,
+                  IN ULONG UnicodeStringMaxByteCount,
+                  OUT PULONG UnicodeStringActualByteCount,
+                  IN PCCH UTF8StringSource,
+                  IN ULONG UTF8StringByteCount)
+{
+    PCCH Source = UTF8StringSource;
+    PCCH SourceEnd;
+    NTSTATUS Status = STATUS_SUCCESS;
+    ULONG Length = 0;
+    ULONG MaxLength;
+    ULONG CodePoint;
+    ULONG Run;
+    UCHAR Lead;
+
+    PAGED_CODE_RTL();
+
+    if (!UTF8StringSource)
+        return STATUS_INVALID_PARAMETER_4;
+
+    if (!UnicodeStringActualByteCount)
+        return STATUS_INVALID_PARAMETER;
+
+    SourceEnd = Source + UTF8StringByteCount;
+
+    /* Without a destination only the required size is computed */
+    MaxLength = UnicodeStringDestination ? UnicodeStringMaxByteCount / sizeof(WCHAR) : MAXULONG;
+
+    while (Source < SourceEnd)
+    {
+        if (!(*Source & 0x80))
+        {
+            Run = min((ULONG)(SourceEnd - Source), MaxLength - Length);
+            if (!Run)
+            {
+                Status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+
+            Run = RtlpWidenAsciiRun(UnicodeStringDestination ? &UnicodeStringDestination[Length] : NULL,
+                                    Source,
+                                    Run);
+            Source += Run;
+            Length += Run;
+            continue;
+        }
+
+        if (Length == MaxLength)
+        {
+            Status = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+
+        Lead = (UCHAR)*Source++;
+        CodePoint = RtlpDecodeUtf8(Lead, &Source, SourceEnd);
+
+        if (CodePoint == RTLP_UTF8_INVALID)
+        {
+            CodePoint = 0xFFFD;
+            Status = STATUS_SOME_NOT_MAPPED;
+        }
+
+        if (CodePoint < 0x10000)
+        {
+            if (UnicodeStringDestination)
+                UnicodeStringDestination[Length] = (WCHAR)CodePoint;
+            Length++;
+            continue;
+        }
+
+        /* A surrogate pair, of which only the first half may still fit */
+        CodePoint -= 0x10000;
+        if (UnicodeStringDestination)
+            UnicodeStringDestination[Length] = (WCHAR)(0xD800 | (CodePoint >> 10));
+        Length++;
+
+        if (Length == MaxLength)
+        {
+            Status = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+
+        if (UnicodeStringDestination)
+            UnicodeStringDestination[Length] = (WCHAR)(0xDC00 | (CodePoint & 0x3FF));
+        Length++;
+    }
+
+    *UnicodeStringActualByteCount = Length * sizeof(WCHAR);
+    return Status;
+}
+
 /*
  * @implemented
  */
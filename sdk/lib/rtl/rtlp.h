@@ -214,12 +214,25 @@ DebugService2(
 #define TAG_ASTR        'RTSA'
 #define TAG_OSTR        'RTSO'
 
-/* Timer Queue */
+/* Thread Pool */
 
-extern HANDLE TimerThreadHandle;
+extern PRTL_START_POOL_THREAD RtlpStartThreadFunc;
+extern PRTL_EXIT_POOL_THREAD RtlpExitThreadFunc;
+
+BOOLEAN
+NTAPI
+RtlpIsIoPending(IN HANDLE ThreadHandle OPTIONAL);
 
 NTSTATUS
-RtlpInitializeTimerThread(VOID);
+NTAPI
+RtlpTpGetIoCompletionPort(OUT PHANDLE CompletionPort);
+
+ULONG
+NTAPI
+RtlpTpSimplePostBatch(IN PTP_SIMPLE_CALLBACK Callback,
+                      IN PVOID *Contexts,
+                      IN ULONG Count,
+                      IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL);
 
 /* bitmap64.c */
 typedef struct _RTL_BITMAP64
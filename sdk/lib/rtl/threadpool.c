@@ -0,0 +1,2286 @@
+/*
+ * PROJECT:     ReactOS system libraries
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Thread pool (Tp*) implementation
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* GLOBALS ******************************************************************/
+
+/* The persistent queue is serviced by the pool's persistent thread only */
+#define RTLP_TP_PERSISTENT_QUEUE    TP_CALLBACK_PRIORITY_COUNT
+#define RTLP_TP_QUEUE_COUNT         (TP_CALLBACK_PRIORITY_COUNT + 1)
+
+#define RTLP_TP_DEFAULT_MAX_THREADS 500
+#define RTLP_TP_IDLE_TIMEOUT        (-100000000LL) /* 10 seconds */
+
+/* Timer wheel: 256 slots of 10ms, timers further out wrap around */
+#define RTLP_TP_TIMER_TICK          100000ULL
+#define RTLP_TP_TIMER_SLOTS         256
+
+/* Slot 0 of every wait thread is taken by its update event */
+#define RTLP_TP_WAIT_SLOTS          (MAXIMUM_WAIT_OBJECTS - 1)
+
+/* Expired timers and waits are handed to the pools in batches of this size */
+#define RTLP_TP_BATCH_SIZE          64
+
+#define RTLP_TP_NEVER               (~0ULL)
+
+typedef enum _RTLP_TP_OBJECT_TYPE
+{
+    TpObjectSimple,
+    TpObjectWork,
+    TpObjectTimer,
+    TpObjectWait
+} RTLP_TP_OBJECT_TYPE;
+
+typedef struct _RTLP_TP_POOL
+{
+    LONG RefCount;
+    RTL_CRITICAL_SECTION Lock;
+    HANDLE CompletionPort;
+    LIST_ENTRY Queues[RTLP_TP_QUEUE_COUNT];
+    LONG ThreadCount;
+    LONG IdleThreads;
+    LONG PendingWakes;
+    LONG BusyThreads;
+    ULONG MinThreads;
+    ULONG MaxThreads;
+    BOOLEAN Shutdown;
+    BOOLEAN IoBound;
+    BOOLEAN PersistentThread;
+    HANDLE PersistentEvent;
+} RTLP_TP_POOL, *PRTLP_TP_POOL;
+
+typedef struct _RTLP_TP_CLEANUP_GROUP
+{
+    LONG RefCount;
+    RTL_CRITICAL_SECTION Lock;
+    LIST_ENTRY Members;
+} RTLP_TP_CLEANUP_GROUP, *PRTLP_TP_CLEANUP_GROUP;
+
+struct _RTLP_TP_WAIT_BUCKET;
+
+typedef struct _RTLP_TP_OBJECT
+{
+    LONG RefCount;
+    RTLP_TP_OBJECT_TYPE Type;
+    PRTLP_TP_POOL Pool;
+    PRTLP_TP_CLEANUP_GROUP Group;
+    LIST_ENTRY GroupEntry;
+    BOOLEAN InGroup;
+    BOOLEAN Shutdown;
+    BOOLEAN LongFunction;
+    BOOLEAN Persistent;
+    LONG Released;
+    ULONG Priority;
+    PVOID Callback;
+    PVOID Context;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK CancelCallback;
+    PTP_SIMPLE_CALLBACK FinalizationCallback;
+    PVOID RaceDll;
+    PVOID ActivationContext;
+    ULONG GroupCancelled;
+
+    /* Protected by the pool lock */
+    LIST_ENTRY QueueEntry;
+    BOOLEAN Queued;
+    ULONG PendingCallbacks;
+    ULONG RunningCallbacks;
+    HANDLE IdleEvent;
+
+    union
+    {
+        struct
+        {
+            /* Protected by the timer lock */
+            LIST_ENTRY WheelEntry;
+            BOOLEAN Armed;
+            BOOLEAN Set;
+            ULONGLONG Due;
+            ULONG Period;
+        } Timer;
+        struct
+        {
+            /* Protected by the wait lock */
+            struct _RTLP_TP_WAIT_BUCKET *Bucket;
+            ULONG Slot;
+            HANDLE Handle;
+            ULONGLONG Timeout;
+            /* Protected by the pool lock */
+            ULONG Signaled;
+        } Wait;
+    } u;
+} RTLP_TP_OBJECT, *PRTLP_TP_OBJECT;
+
+typedef struct _RTLP_TP_INSTANCE
+{
+    PRTLP_TP_OBJECT Object;
+    BOOLEAN Associated;
+    BOOLEAN MayRunLong;
+    PRTL_CRITICAL_SECTION CriticalSection;
+    HANDLE Mutex;
+    HANDLE Semaphore;
+    ULONG SemaphoreCount;
+    HANDLE Event;
+    PVOID DllHandle;
+} RTLP_TP_INSTANCE, *PRTLP_TP_INSTANCE;
+
+typedef struct _RTLP_TP_WAIT_BUCKET
+{
+    LIST_ENTRY ListEntry;
+    HANDLE UpdateEvent;
+    ULONG Count;
+    PRTLP_TP_OBJECT Objects[RTLP_TP_WAIT_SLOTS];
+    /* The wait thread is blocked on the handles, without the wait lock */
+    BOOLEAN Waiting;
+    /* Cancellations waiting for the wait thread to come back, see RtlpTpCancelWait */
+    BOOLEAN AckSignaled;
+    ULONG AckWaiters;
+    ULONG Sequence;
+    HANDLE AckEvent;
+} RTLP_TP_WAIT_BUCKET, *PRTLP_TP_WAIT_BUCKET;
+
+typedef VOID
+(NTAPI *PRTLP_TP_IO_CALLBACK)(
+    IN ULONG ErrorCode,
+    IN ULONG BytesTransferred,
+    IN PVOID Overlapped);
+
+static LONG RtlpTpInitialized = 0;
+static PRTLP_TP_POOL RtlpTpDefaultPool;
+
+static RTL_CRITICAL_SECTION RtlpTpTimerLock;
+static LIST_ENTRY RtlpTpTimerWheel[RTLP_TP_TIMER_SLOTS];
+static ULONGLONG RtlpTpTimerLastTick;
+static ULONGLONG RtlpTpTimerNextWake;
+static HANDLE RtlpTpTimerEvent;
+
+static RTL_CRITICAL_SECTION RtlpTpWaitLock;
+static LIST_ENTRY RtlpTpWaitBuckets;
+
+/* PRIVATE FUNCTIONS ********************************************************/
+
+static ULONGLONG
+RtlpTpInterruptTime(VOID)
+{
+    LARGE_INTEGER Time;
+
+    do
+    {
+        Time.HighPart = SharedUserData->InterruptTime.High1Time;
+        Time.LowPart = SharedUserData->InterruptTime.LowPart;
+    }
+    while (Time.HighPart != SharedUserData->InterruptTime.High2Time);
+
+    return Time.QuadPart;
+}
+
+/* Converts an NT timeout (relative if negative, absolute otherwise) to interrupt time */
+static ULONGLONG
+RtlpTpGetDueTime(IN PLARGE_INTEGER DueTime,
+                 IN ULONGLONG Now)
+{
+    LARGE_INTEGER SystemTime;
+
+    if (DueTime->QuadPart <= 0)
+        return Now - DueTime->QuadPart;
+
+    NtQuerySystemTime(&SystemTime);
+    if (DueTime->QuadPart <= SystemTime.QuadPart)
+        return Now;
+
+    return Now + (DueTime->QuadPart - SystemTime.QuadPart);
+}
+
+static NTSTATUS
+RtlpTpStartThread(IN PTHREAD_START_ROUTINE StartRoutine,
+                  IN PVOID Parameter)
+{
+    NTSTATUS Status;
+    HANDLE ThreadHandle;
+
+    Status = RtlpStartThreadFunc(StartRoutine, Parameter, &ThreadHandle);
+    if (NT_SUCCESS(Status))
+    {
+        NtResumeThread(ThreadHandle, NULL);
+        NtClose(ThreadHandle);
+    }
+
+    return Status;
+}
+
+static NTSTATUS
+RtlpTpCreatePool(OUT PRTLP_TP_POOL *PoolReturn)
+{
+    PRTLP_TP_POOL Pool;
+    NTSTATUS Status;
+    ULONG i;
+
+    Pool = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RTLP_TP_POOL));
+    if (Pool == NULL)
+        return STATUS_NO_MEMORY;
+
+    Status = RtlInitializeCriticalSection(&Pool->Lock);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    Status = NtCreateIoCompletion(&Pool->CompletionPort,
+                                  IO_COMPLETION_ALL_ACCESS,
+                                  NULL,
+                                  0);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlDeleteCriticalSection(&Pool->Lock);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    for (i = 0; i < RTLP_TP_QUEUE_COUNT; i++)
+        InitializeListHead(&Pool->Queues[i]);
+
+    Pool->RefCount = 1;
+    Pool->MaxThreads = RTLP_TP_DEFAULT_MAX_THREADS;
+
+    *PoolReturn = Pool;
+    return STATUS_SUCCESS;
+}
+
+static VOID
+RtlpTpReleasePool(IN PRTLP_TP_POOL Pool)
+{
+    if (InterlockedDecrement(&Pool->RefCount) != 0)
+        return;
+
+    ASSERT(Pool->ThreadCount == 0 && !Pool->PersistentThread);
+
+    if (Pool->PersistentEvent != NULL)
+        NtClose(Pool->PersistentEvent);
+    NtClose(Pool->CompletionPort);
+    RtlDeleteCriticalSection(&Pool->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+}
+
+static NTSTATUS
+RtlpTpInitialize(VOID)
+{
+    NTSTATUS Status;
+    ULONG i;
+
+    while (*(volatile LONG *)&RtlpTpInitialized != 1)
+    {
+        if (InterlockedCompareExchange(&RtlpTpInitialized, 2, 0) != 0)
+        {
+            /* Somebody else is initializing, give it a chance to finish */
+            NtYieldExecution();
+            continue;
+        }
+
+        Status = RtlInitializeCriticalSection(&RtlpTpTimerLock);
+        if (!NT_SUCCESS(Status))
+            goto Failed;
+
+        Status = RtlInitializeCriticalSection(&RtlpTpWaitLock);
+        if (!NT_SUCCESS(Status))
+        {
+            RtlDeleteCriticalSection(&RtlpTpTimerLock);
+            goto Failed;
+        }
+
+        Status = RtlpTpCreatePool(&RtlpTpDefaultPool);
+        if (!NT_SUCCESS(Status))
+        {
+            RtlDeleteCriticalSection(&RtlpTpWaitLock);
+            RtlDeleteCriticalSection(&RtlpTpTimerLock);
+            goto Failed;
+        }
+
+        for (i = 0; i < RTLP_TP_TIMER_SLOTS; i++)
+            InitializeListHead(&RtlpTpTimerWheel[i]);
+        RtlpTpTimerLastTick = RtlpTpInterruptTime() / RTLP_TP_TIMER_TICK;
+        RtlpTpTimerNextWake = RTLP_TP_NEVER;
+        InitializeListHead(&RtlpTpWaitBuckets);
+
+        InterlockedExchange(&RtlpTpInitialized, 1);
+    }
+
+    return STATUS_SUCCESS;
+
+Failed:
+    InterlockedExchange(&RtlpTpInitialized, 0);
+    return Status;
+}
+
+static ULONG NTAPI RtlpTpWorkerThread(IN PVOID Parameter);
+static ULONG NTAPI RtlpTpPersistentThread(IN PVOID Parameter);
+
+/* Pool lock held */
+static NTSTATUS
+RtlpTpStartWorker(IN PRTLP_TP_POOL Pool)
+{
+    NTSTATUS Status;
+
+    InterlockedIncrement(&Pool->RefCount);
+
+    Status = RtlpTpStartThread(RtlpTpWorkerThread, Pool);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to start a thread pool worker, Status 0x%lx\n", Status);
+        InterlockedDecrement(&Pool->RefCount);
+        return Status;
+    }
+
+    Pool->ThreadCount++;
+    return STATUS_SUCCESS;
+}
+
+/* Pool lock held */
+static VOID
+RtlpTpWakeWorkers(IN PRTLP_TP_POOL Pool,
+                  IN ULONG Count)
+{
+    /* Hand the callbacks to idle workers first */
+    while (Count != 0 && Pool->IdleThreads > Pool->PendingWakes)
+    {
+        if (!NT_SUCCESS(NtSetIoCompletion(Pool->CompletionPort, NULL, NULL, STATUS_SUCCESS, 0)))
+            break;
+
+        Pool->PendingWakes++;
+        Count--;
+    }
+
+    /* Only grow the pool while every worker is busy running a callback */
+    while (Count != 0 &&
+           Pool->BusyThreads >= Pool->ThreadCount &&
+           (ULONG)Pool->ThreadCount < Pool->MaxThreads)
+    {
+        if (!NT_SUCCESS(RtlpTpStartWorker(Pool)))
+            break;
+
+        Count--;
+    }
+}
+
+/* Pool lock held */
+static VOID
+RtlpTpWakePersistent(IN PRTLP_TP_POOL Pool)
+{
+    NTSTATUS Status;
+
+    if (Pool->PersistentEvent == NULL)
+    {
+        Status = NtCreateEvent(&Pool->PersistentEvent,
+                               EVENT_ALL_ACCESS,
+                               NULL,
+                               SynchronizationEvent,
+                               FALSE);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to create the persistent thread event, Status 0x%lx\n", Status);
+            Pool->PersistentEvent = NULL;
+            return;
+        }
+    }
+
+    if (!Pool->PersistentThread)
+    {
+        InterlockedIncrement(&Pool->RefCount);
+        Status = RtlpTpStartThread(RtlpTpPersistentThread, Pool);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to start the persistent thread, Status 0x%lx\n", Status);
+            InterlockedDecrement(&Pool->RefCount);
+            return;
+        }
+
+        Pool->PersistentThread = TRUE;
+    }
+
+    NtSetEvent(Pool->PersistentEvent, NULL);
+}
+
+/* Pool lock held */
+static VOID
+RtlpTpSignalIfIdle(IN PRTLP_TP_OBJECT Object)
+{
+    if (Object->PendingCallbacks == 0 &&
+        Object->RunningCallbacks == 0 &&
+        Object->IdleEvent != NULL)
+    {
+        NtSetEvent(Object->IdleEvent, NULL);
+    }
+}
+
+/* Pool lock held. The queue entry holds a reference on the object */
+static VOID
+RtlpTpQueueCallback(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+    ULONG Queue;
+
+    if (!Object->Queued)
+    {
+        Queue = Object->Persistent ? RTLP_TP_PERSISTENT_QUEUE : Object->Priority;
+
+        InterlockedIncrement(&Object->RefCount);
+        InsertTailList(&Pool->Queues[Queue], &Object->QueueEntry);
+        Object->Queued = TRUE;
+    }
+
+    Object->PendingCallbacks++;
+}
+
+/*
+ * Pool lock held. Takes one callback off the highest priority queue that has
+ * work. Objects with more callbacks pending go back to the tail of their queue
+ * so that one busy object doesn't starve the others.
+ */
+static PRTLP_TP_OBJECT
+RtlpTpDequeueCallback(IN PRTLP_TP_POOL Pool,
+                      IN BOOLEAN Persistent,
+                      OUT TP_WAIT_RESULT *WaitResult)
+{
+    PRTLP_TP_OBJECT Object;
+    PLIST_ENTRY Entry;
+    ULONG First, Last, i;
+
+    if (Persistent)
+    {
+        First = RTLP_TP_PERSISTENT_QUEUE;
+        Last = RTLP_TP_QUEUE_COUNT;
+    }
+    else
+    {
+        First = 0;
+        Last = RTLP_TP_PERSISTENT_QUEUE;
+    }
+
+    for (i = First; i < Last; i++)
+    {
+        if (IsListEmpty(&Pool->Queues[i]))
+            continue;
+
+        Entry = RemoveHeadList(&Pool->Queues[i]);
+        Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, QueueEntry);
+
+        Object->PendingCallbacks--;
+        Object->RunningCallbacks++;
+
+        if (Object->PendingCallbacks != 0)
+        {
+            /* The queue keeps its own reference, the running callback gets a new one */
+            InsertTailList(&Pool->Queues[i], &Object->QueueEntry);
+            InterlockedIncrement(&Object->RefCount);
+        }
+        else
+        {
+            Object->Queued = FALSE;
+        }
+
+        *WaitResult = WAIT_TIMEOUT;
+        if (Object->Type == TpObjectWait && Object->u.Wait.Signaled != 0)
+        {
+            Object->u.Wait.Signaled--;
+            *WaitResult = WAIT_OBJECT_0;
+        }
+
+        return Object;
+    }
+
+    return NULL;
+}
+
+/*
+ * Hands a set of objects to their pools, taking each pool lock only once.
+ * The array is consumed.
+ */
+static VOID
+RtlpTpSubmitBatch(IN OUT PRTLP_TP_OBJECT *Objects,
+                  IN PBOOLEAN Signaled OPTIONAL,
+                  IN ULONG Count)
+{
+    PRTLP_TP_POOL Pool;
+    BOOLEAN Persistent;
+    ULONG Workers, i, j;
+
+    for (i = 0; i < Count; i++)
+    {
+        if (Objects[i] == NULL)
+            continue;
+
+        Pool = Objects[i]->Pool;
+        Workers = 0;
+        Persistent = FALSE;
+
+        RtlEnterCriticalSection(&Pool->Lock);
+
+        for (j = i; j < Count; j++)
+        {
+            if (Objects[j] == NULL || Objects[j]->Pool != Pool)
+                continue;
+
+            if (Signaled != NULL && Signaled[j])
+                Objects[j]->u.Wait.Signaled++;
+
+            RtlpTpQueueCallback(Objects[j]);
+
+            if (Objects[j]->Persistent)
+                Persistent = TRUE;
+            else
+                Workers++;
+
+            Objects[j] = NULL;
+        }
+
+        if (Workers != 0)
+            RtlpTpWakeWorkers(Pool, Workers);
+        if (Persistent)
+            RtlpTpWakePersistent(Pool);
+
+        RtlLeaveCriticalSection(&Pool->Lock);
+    }
+}
+
+static VOID
+RtlpTpReleaseCleanupGroup(IN PRTLP_TP_CLEANUP_GROUP Group)
+{
+    if (InterlockedDecrement(&Group->RefCount) != 0)
+        return;
+
+    ASSERT(IsListEmpty(&Group->Members));
+
+    RtlDeleteCriticalSection(&Group->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Group);
+}
+
+static VOID
+RtlpTpDestroyObject(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_CLEANUP_GROUP Group = Object->Group;
+
+    ASSERT(!Object->Queued && Object->RunningCallbacks == 0);
+
+    if (Group != NULL)
+    {
+        RtlEnterCriticalSection(&Group->Lock);
+        if (Object->InGroup)
+            RemoveEntryList(&Object->GroupEntry);
+        RtlLeaveCriticalSection(&Group->Lock);
+
+        RtlpTpReleaseCleanupGroup(Group);
+    }
+
+    if (Object->IdleEvent != NULL)
+        NtClose(Object->IdleEvent);
+
+    if (Object->ActivationContext != NULL)
+        RtlReleaseActivationContext(Object->ActivationContext);
+
+    if (Object->RaceDll != NULL)
+        LdrUnloadDll(Object->RaceDll);
+
+    RtlpTpReleasePool(Object->Pool);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+}
+
+static VOID
+RtlpTpReleaseObject(IN PRTLP_TP_OBJECT Object)
+{
+    if (InterlockedDecrement(&Object->RefCount) == 0)
+        RtlpTpDestroyObject(Object);
+}
+
+/* Fails for objects already on their way out */
+static BOOLEAN
+RtlpTpTryReferenceObject(IN PRTLP_TP_OBJECT Object)
+{
+    LONG RefCount, OldRefCount;
+
+    RefCount = *(volatile LONG *)&Object->RefCount;
+    while (RefCount != 0)
+    {
+        OldRefCount = InterlockedCompareExchange(&Object->RefCount, RefCount + 1, RefCount);
+        if (OldRefCount == RefCount)
+            return TRUE;
+
+        RefCount = OldRefCount;
+    }
+
+    return FALSE;
+}
+
+/* Drops the reference handed out by TpAlloc*, at most once */
+static VOID
+RtlpTpReleaseUserReference(IN PRTLP_TP_OBJECT Object)
+{
+    if (InterlockedExchange(&Object->Released, TRUE) == FALSE)
+        RtlpTpReleaseObject(Object);
+}
+
+static NTSTATUS
+RtlpTpAllocObject(IN RTLP_TP_OBJECT_TYPE Type,
+                  IN PVOID Callback,
+                  IN PVOID Context OPTIONAL,
+                  IN PTP_CALLBACK_ENVIRON Environment OPTIONAL,
+                  OUT PRTLP_TP_OBJECT *ObjectReturn)
+{
+    PRTLP_TP_OBJECT Object;
+    PRTLP_TP_POOL Pool = NULL;
+    PRTLP_TP_CLEANUP_GROUP Group = NULL;
+    ULONG Priority = TP_CALLBACK_PRIORITY_NORMAL;
+    NTSTATUS Status;
+
+    Status = RtlpTpInitialize();
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    if (Environment != NULL)
+    {
+        if (Environment->Version == 3)
+        {
+            Priority = ((TP_CALLBACK_ENVIRON_V3 *)Environment)->CallbackPriority;
+            if (Priority >= TP_CALLBACK_PRIORITY_COUNT)
+                return STATUS_INVALID_PARAMETER;
+        }
+        else if (Environment->Version != 1)
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        Pool = (PRTLP_TP_POOL)Environment->Pool;
+        Group = (PRTLP_TP_CLEANUP_GROUP)Environment->CleanupGroup;
+    }
+
+    if (Pool == NULL)
+        Pool = RtlpTpDefaultPool;
+
+    Object = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RTLP_TP_OBJECT));
+    if (Object == NULL)
+        return STATUS_NO_MEMORY;
+
+    Object->RefCount = 1;
+    Object->Type = Type;
+    Object->Callback = Callback;
+    Object->Context = Context;
+    Object->Priority = Priority;
+
+    if (Environment != NULL)
+    {
+        if (Environment->RaceDll != NULL)
+        {
+            Status = LdrAddRefDll(0, Environment->RaceDll);
+            if (!NT_SUCCESS(Status))
+            {
+                RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+                return Status;
+            }
+
+            Object->RaceDll = Environment->RaceDll;
+        }
+
+        if (Environment->ActivationContext != NULL)
+        {
+            Object->ActivationContext = Environment->ActivationContext;
+            RtlAddRefActivationContext(Object->ActivationContext);
+        }
+
+        Object->CancelCallback = Environment->CleanupGroupCancelCallback;
+        Object->FinalizationCallback = Environment->FinalizationCallback;
+        Object->LongFunction = Environment->u.s.LongFunction;
+        Object->Persistent = Environment->u.s.Persistent;
+    }
+
+    InterlockedIncrement(&Pool->RefCount);
+    Object->Pool = Pool;
+
+    if (Group != NULL)
+    {
+        InterlockedIncrement(&Group->RefCount);
+        Object->Group = Group;
+
+        RtlEnterCriticalSection(&Group->Lock);
+        InsertTailList(&Group->Members, &Object->GroupEntry);
+        Object->InGroup = TRUE;
+        RtlLeaveCriticalSection(&Group->Lock);
+    }
+
+    *ObjectReturn = Object;
+    return STATUS_SUCCESS;
+}
+
+static VOID
+RtlpTpPostCallback(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    RtlpTpQueueCallback(Object);
+    if (Object->Persistent)
+        RtlpTpWakePersistent(Pool);
+    else
+        RtlpTpWakeWorkers(Pool, 1);
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+/* Returns the number of callbacks that were removed from the queue */
+static ULONG
+RtlpTpCancelCallbacks(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+    ULONG Cancelled;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    Cancelled = Object->PendingCallbacks;
+    if (Object->Queued)
+    {
+        RemoveEntryList(&Object->QueueEntry);
+        Object->Queued = FALSE;
+    }
+    Object->PendingCallbacks = 0;
+    if (Object->Type == TpObjectWait)
+        Object->u.Wait.Signaled = 0;
+    RtlpTpSignalIfIdle(Object);
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    /* Drop the reference the queue held */
+    if (Cancelled != 0)
+        RtlpTpReleaseObject(Object);
+
+    return Cancelled;
+}
+
+static VOID
+RtlpTpWaitForCallbacks(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    while (Object->PendingCallbacks != 0 || Object->RunningCallbacks != 0)
+    {
+        if (Object->IdleEvent == NULL)
+        {
+            Status = NtCreateEvent(&Object->IdleEvent,
+                                   EVENT_ALL_ACCESS,
+                                   NULL,
+                                   NotificationEvent,
+                                   FALSE);
+            if (!NT_SUCCESS(Status))
+            {
+                /* Fall back to polling */
+                Object->IdleEvent = NULL;
+                RtlLeaveCriticalSection(&Pool->Lock);
+
+                Timeout.QuadPart = -100000LL; /* 10ms */
+                NtDelayExecution(FALSE, &Timeout);
+
+                RtlEnterCriticalSection(&Pool->Lock);
+                continue;
+            }
+        }
+        else
+        {
+            NtClearEvent(Object->IdleEvent);
+        }
+
+        RtlLeaveCriticalSection(&Pool->Lock);
+        NtWaitForSingleObject(Object->IdleEvent, FALSE, NULL);
+        RtlEnterCriticalSection(&Pool->Lock);
+    }
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+/* Called once a callback is no longer associated with its object */
+static VOID
+RtlpTpCallbackCompleted(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    ASSERT(Object->RunningCallbacks != 0);
+    Object->RunningCallbacks--;
+    RtlpTpSignalIfIdle(Object);
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+static VOID
+RtlpTpExecuteCallback(IN PRTLP_TP_OBJECT Object,
+                      IN TP_WAIT_RESULT WaitResult)
+{
+    RTLP_TP_INSTANCE Instance;
+    PTP_CALLBACK_INSTANCE CallbackInstance = (PTP_CALLBACK_INSTANCE)&Instance;
+    ULONG_PTR Cookie = 0;
+    BOOLEAN Activated = FALSE;
+
+    RtlZeroMemory(&Instance, sizeof(Instance));
+    Instance.Object = Object;
+    Instance.Associated = TRUE;
+
+    if (Object->LongFunction && !Object->Persistent)
+        TpCallbackMayRunLong(CallbackInstance);
+
+    if (Object->ActivationContext != NULL)
+    {
+        Activated = NT_SUCCESS(RtlActivateActivationContext(0,
+                                                            Object->ActivationContext,
+                                                            &Cookie));
+    }
+
+    _SEH2_TRY
+    {
+        switch (Object->Type)
+        {
+            case TpObjectSimple:
+                ((PTP_SIMPLE_CALLBACK)Object->Callback)(CallbackInstance,
+                                                        Object->Context);
+                break;
+
+            case TpObjectWork:
+                ((PTP_WORK_CALLBACK)Object->Callback)(CallbackInstance,
+                                                      Object->Context,
+                                                      (PTP_WORK)Object);
+                break;
+
+            case TpObjectTimer:
+                ((PTP_TIMER_CALLBACK)Object->Callback)(CallbackInstance,
+                                                       Object->Context,
+                                                       (PTP_TIMER)Object);
+                break;
+
+            case TpObjectWait:
+                ((PTP_WAIT_CALLBACK)Object->Callback)(CallbackInstance,
+                                                      Object->Context,
+                                                      (PTP_WAIT)Object,
+                                                      WaitResult);
+                break;
+        }
+
+        if (Object->FinalizationCallback != NULL)
+            Object->FinalizationCallback(CallbackInstance, Object->Context);
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        DPRINT1("Exception 0x%x while executing thread pool callback 0x%p\n", _SEH2_GetExceptionCode(), Object->Callback);
+    }
+    _SEH2_END;
+
+    if (Activated)
+        RtlDeactivateActivationContext(0, Cookie);
+
+    /* Run the completion actions in the documented order */
+    if (Instance.CriticalSection != NULL)
+        RtlLeaveCriticalSection(Instance.CriticalSection);
+    if (Instance.Mutex != NULL)
+        NtReleaseMutant(Instance.Mutex, NULL);
+    if (Instance.Semaphore != NULL)
+        NtReleaseSemaphore(Instance.Semaphore, Instance.SemaphoreCount, NULL);
+    if (Instance.Event != NULL)
+        NtSetEvent(Instance.Event, NULL);
+    if (Instance.DllHandle != NULL)
+        LdrUnloadDll(Instance.DllHandle);
+
+    if (Instance.Associated)
+        RtlpTpCallbackCompleted(Object);
+
+    /* Drop the reference of this callback */
+    RtlpTpReleaseObject(Object);
+}
+
+static ULONG
+NTAPI
+RtlpTpWorkerThread(IN PVOID Parameter)
+{
+    PRTLP_TP_POOL Pool = (PRTLP_TP_POOL)Parameter;
+    PRTLP_TP_OBJECT Object;
+    TP_WAIT_RESULT WaitResult;
+    PVOID KeyContext, ApcContext;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Timeout;
+    BOOLEAN TimedOut = FALSE, IoPending = FALSE;
+    NTSTATUS Status;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    for (;;)
+    {
+        Object = RtlpTpDequeueCallback(Pool, FALSE, &WaitResult);
+        if (Object != NULL)
+        {
+            TimedOut = FALSE;
+            Pool->BusyThreads++;
+            RtlLeaveCriticalSection(&Pool->Lock);
+
+            RtlpTpExecuteCallback(Object, WaitResult);
+
+            RtlEnterCriticalSection(&Pool->Lock);
+            Pool->BusyThreads--;
+            continue;
+        }
+
+        if (Pool->Shutdown)
+            break;
+
+        /* Retire after a quiet period, unless the pool needs us */
+        if (TimedOut && !IoPending &&
+            (ULONG)Pool->ThreadCount > Pool->MinThreads &&
+            (!Pool->IoBound || Pool->ThreadCount > 1))
+        {
+            break;
+        }
+
+        Pool->IdleThreads++;
+        RtlLeaveCriticalSection(&Pool->Lock);
+
+        Timeout.QuadPart = RTLP_TP_IDLE_TIMEOUT;
+        Status = NtRemoveIoCompletion(Pool->CompletionPort,
+                                      &KeyContext,
+                                      &ApcContext,
+                                      &IoStatusBlock,
+                                      &Timeout);
+
+        TimedOut = (Status == STATUS_TIMEOUT);
+        IoPending = TimedOut && RtlpIsIoPending(NULL);
+
+        if (Status == STATUS_SUCCESS && KeyContext != NULL)
+        {
+            /* I/O completion for a file bound with RtlSetIoCompletionCallback */
+            RtlEnterCriticalSection(&Pool->Lock);
+            Pool->IdleThreads--;
+            Pool->BusyThreads++;
+
+            /* Keep somebody listening on the port for further completions */
+            if (Pool->IdleThreads <= Pool->PendingWakes &&
+                (ULONG)Pool->ThreadCount < Pool->MaxThreads)
+            {
+                RtlpTpStartWorker(Pool);
+            }
+            RtlLeaveCriticalSection(&Pool->Lock);
+
+            _SEH2_TRY
+            {
+                ((PRTLP_TP_IO_CALLBACK)KeyContext)(RtlNtStatusToDosError(IoStatusBlock.Status),
+                                                   (ULONG)IoStatusBlock.Information,
+                                                   ApcContext);
+            }
+            _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+            {
+                DPRINT1("Exception 0x%x while executing I/O completion callback 0x%p\n", _SEH2_GetExceptionCode(), KeyContext);
+            }
+            _SEH2_END;
+
+            RtlEnterCriticalSection(&Pool->Lock);
+            Pool->BusyThreads--;
+            continue;
+        }
+
+        RtlEnterCriticalSection(&Pool->Lock);
+        Pool->IdleThreads--;
+
+        if (Status == STATUS_SUCCESS)
+        {
+            /* A wake-up packet */
+            if (Pool->PendingWakes > 0)
+                Pool->PendingWakes--;
+        }
+        else if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("NtRemoveIoCompletion failed, Status 0x%lx\n", Status);
+            break;
+        }
+    }
+
+    Pool->ThreadCount--;
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    RtlpTpReleasePool(Pool);
+    RtlpExitThreadFunc(STATUS_SUCCESS);
+    return 0;
+}
+
+static ULONG
+NTAPI
+RtlpTpPersistentThread(IN PVOID Parameter)
+{
+    PRTLP_TP_POOL Pool = (PRTLP_TP_POOL)Parameter;
+    PRTLP_TP_OBJECT Object;
+    TP_WAIT_RESULT WaitResult;
+    NTSTATUS Status;
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&Pool->Lock);
+
+        Object = RtlpTpDequeueCallback(Pool, TRUE, &WaitResult);
+        if (Object == NULL && Pool->Shutdown)
+        {
+            Pool->PersistentThread = FALSE;
+            RtlLeaveCriticalSection(&Pool->Lock);
+            break;
+        }
+
+        RtlLeaveCriticalSection(&Pool->Lock);
+
+        if (Object != NULL)
+        {
+            RtlpTpExecuteCallback(Object, WaitResult);
+            continue;
+        }
+
+        /* Wait alertably, callers may queue APCs to this thread */
+        do
+        {
+            Status = NtWaitForSingleObject(Pool->PersistentEvent, TRUE, NULL);
+        }
+        while (Status == STATUS_USER_APC || Status == STATUS_ALERTED);
+    }
+
+    RtlpTpReleasePool(Pool);
+    RtlpExitThreadFunc(STATUS_SUCCESS);
+    return 0;
+}
+
+/* TIMERS *******************************************************************/
+
+/* Timer lock held */
+static VOID
+RtlpTpInsertTimer(IN PRTLP_TP_OBJECT Object)
+{
+    ULONGLONG Tick, WakeTime;
+
+    /* Round up, so that the slot is never processed before the timer is due */
+    Tick = (Object->u.Timer.Due + RTLP_TP_TIMER_TICK - 1) / RTLP_TP_TIMER_TICK;
+    if (Tick <= RtlpTpTimerLastTick)
+        Tick = RtlpTpTimerLastTick + 1;
+
+    InsertTailList(&RtlpTpTimerWheel[Tick % RTLP_TP_TIMER_SLOTS], &Object->u.Timer.WheelEntry);
+    Object->u.Timer.Armed = TRUE;
+
+    WakeTime = Tick * RTLP_TP_TIMER_TICK;
+    if (WakeTime < RtlpTpTimerNextWake)
+    {
+        RtlpTpTimerNextWake = WakeTime;
+        if (RtlpTpTimerEvent != NULL)
+            NtSetEvent(RtlpTpTimerEvent, NULL);
+    }
+}
+
+/* Timer lock held */
+static VOID
+RtlpTpRemoveTimer(IN PRTLP_TP_OBJECT Object)
+{
+    if (Object->u.Timer.Armed)
+    {
+        RemoveEntryList(&Object->u.Timer.WheelEntry);
+        Object->u.Timer.Armed = FALSE;
+    }
+}
+
+/*
+ * Timer lock held. Picks the earliest timer due within the window so that
+ * both expire together and the worker wakes up only once. Only the slots
+ * covering the window are looked at, in tick order, so the first slot with
+ * a match holds the earliest one.
+ */
+static ULONGLONG
+RtlpTpCoalesceDueTime(IN ULONGLONG Due,
+                      IN ULONGLONG Window)
+{
+    PRTLP_TP_OBJECT Other;
+    PLIST_ENTRY Slot, Entry;
+    ULONGLONG Best = RTLP_TP_NEVER;
+    ULONGLONG FirstTick, EndTick, Tick;
+
+    /* Same rounding as RtlpTpInsertTimer */
+    FirstTick = (Due + RTLP_TP_TIMER_TICK - 1) / RTLP_TP_TIMER_TICK;
+    if (FirstTick <= RtlpTpTimerLastTick)
+        FirstTick = RtlpTpTimerLastTick + 1;
+
+    EndTick = (Due + Window + RTLP_TP_TIMER_TICK - 1) / RTLP_TP_TIMER_TICK;
+    if (EndTick < FirstTick)
+        EndTick = FirstTick;
+    if (EndTick - FirstTick >= RTLP_TP_TIMER_SLOTS)
+        EndTick = FirstTick + RTLP_TP_TIMER_SLOTS - 1;
+
+    for (Tick = FirstTick; Tick <= EndTick && Best == RTLP_TP_NEVER; Tick++)
+    {
+        Slot = &RtlpTpTimerWheel[Tick % RTLP_TP_TIMER_SLOTS];
+
+        for (Entry = Slot->Flink; Entry != Slot; Entry = Entry->Flink)
+        {
+            /* Timers a wheel turn away share the slot, the window skips them */
+            Other = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, u.Timer.WheelEntry);
+            if (Other->u.Timer.Due >= Due &&
+                Other->u.Timer.Due <= Due + Window &&
+                Other->u.Timer.Due < Best)
+            {
+                Best = Other->u.Timer.Due;
+            }
+        }
+    }
+
+    return (Best != RTLP_TP_NEVER) ? Best : Due;
+}
+
+/* Timer lock held */
+static VOID
+RtlpTpExpireTimers(IN ULONGLONG Now)
+{
+    PRTLP_TP_OBJECT Batch[RTLP_TP_BATCH_SIZE];
+    PRTLP_TP_OBJECT Object;
+    LIST_ENTRY Expired;
+    PLIST_ENTRY Slot, Entry, NextEntry;
+    ULONGLONG NowTick, Ticks, i;
+    ULONG Count;
+
+    InitializeListHead(&Expired);
+
+    NowTick = Now / RTLP_TP_TIMER_TICK;
+    Ticks = NowTick - RtlpTpTimerLastTick;
+    if (Ticks > RTLP_TP_TIMER_SLOTS)
+        Ticks = RTLP_TP_TIMER_SLOTS;
+
+    for (i = 1; i <= Ticks; i++)
+    {
+        Slot = &RtlpTpTimerWheel[(RtlpTpTimerLastTick + i) % RTLP_TP_TIMER_SLOTS];
+
+        for (Entry = Slot->Flink; Entry != Slot; Entry = NextEntry)
+        {
+            NextEntry = Entry->Flink;
+            Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, u.Timer.WheelEntry);
+
+            /* Timers more than a wheel turn away stay where they are */
+            if (Object->u.Timer.Due <= Now)
+            {
+                RemoveEntryList(Entry);
+                InsertTailList(&Expired, Entry);
+            }
+        }
+    }
+
+    RtlpTpTimerLastTick = NowTick;
+
+    while (!IsListEmpty(&Expired))
+    {
+        Count = 0;
+        while (Count < RTLP_TP_BATCH_SIZE && !IsListEmpty(&Expired))
+        {
+            Entry = RemoveHeadList(&Expired);
+            Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, u.Timer.WheelEntry);
+            Object->u.Timer.Armed = FALSE;
+            Batch[Count++] = Object;
+
+            if (Object->u.Timer.Period != 0)
+            {
+                /* Re-arm relative to the previous due time to avoid drift */
+                Object->u.Timer.Due += (ULONGLONG)Object->u.Timer.Period * 10000;
+                if (Object->u.Timer.Due <= Now)
+                    Object->u.Timer.Due = Now + (ULONGLONG)Object->u.Timer.Period * 10000;
+
+                RtlpTpInsertTimer(Object);
+            }
+        }
+
+        RtlpTpSubmitBatch(Batch, NULL, Count);
+    }
+}
+
+/* Timer lock held */
+static ULONGLONG
+RtlpTpNextTimerWake(VOID)
+{
+    ULONG i;
+
+    for (i = 1; i <= RTLP_TP_TIMER_SLOTS; i++)
+    {
+        if (!IsListEmpty(&RtlpTpTimerWheel[(RtlpTpTimerLastTick + i) % RTLP_TP_TIMER_SLOTS]))
+            return (RtlpTpTimerLastTick + i) * RTLP_TP_TIMER_TICK;
+    }
+
+    return RTLP_TP_NEVER;
+}
+
+static ULONG
+NTAPI
+RtlpTpTimerThread(IN PVOID Parameter)
+{
+    LARGE_INTEGER Timeout;
+    ULONGLONG Now, NextWake;
+
+    UNREFERENCED_PARAMETER(Parameter);
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&RtlpTpTimerLock);
+
+        Now = RtlpTpInterruptTime();
+        RtlpTpExpireTimers(Now);
+
+        NextWake = RtlpTpNextTimerWake();
+        RtlpTpTimerNextWake = NextWake;
+
+        RtlLeaveCriticalSection(&RtlpTpTimerLock);
+
+        if (NextWake == RTLP_TP_NEVER)
+        {
+            NtWaitForSingleObject(RtlpTpTimerEvent, FALSE, NULL);
+        }
+        else
+        {
+            Timeout.QuadPart = (NextWake > Now) ? -(LONGLONG)(NextWake - Now) : 0;
+            NtWaitForSingleObject(RtlpTpTimerEvent, FALSE, &Timeout);
+        }
+    }
+
+    return 0;
+}
+
+/* Timer lock held */
+static NTSTATUS
+RtlpTpStartTimerThread(VOID)
+{
+    NTSTATUS Status;
+
+    if (RtlpTpTimerEvent != NULL)
+        return STATUS_SUCCESS;
+
+    Status = NtCreateEvent(&RtlpTpTimerEvent,
+                           EVENT_ALL_ACCESS,
+                           NULL,
+                           SynchronizationEvent,
+                           FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlpTpTimerEvent = NULL;
+        return Status;
+    }
+
+    Status = RtlpTpStartThread(RtlpTpTimerThread, NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(RtlpTpTimerEvent);
+        RtlpTpTimerEvent = NULL;
+    }
+
+    return Status;
+}
+
+static VOID
+RtlpTpShutdownTimer(IN PRTLP_TP_OBJECT Object)
+{
+    RtlEnterCriticalSection(&RtlpTpTimerLock);
+    Object->Shutdown = TRUE;
+    RtlpTpRemoveTimer(Object);
+    Object->u.Timer.Set = FALSE;
+    RtlLeaveCriticalSection(&RtlpTpTimerLock);
+}
+
+/* WAITS ********************************************************************/
+
+/* Wait lock held */
+static VOID
+RtlpTpDisarmWait(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_WAIT_BUCKET Bucket = Object->u.Wait.Bucket;
+
+    if (Bucket == NULL)
+        return;
+
+    Bucket->Objects[Object->u.Wait.Slot] = NULL;
+    Bucket->Count--;
+    Object->u.Wait.Bucket = NULL;
+}
+
+/*
+ * Wait lock held, but released while waiting. Disarms the wait and, if the
+ * wait thread is blocked on its handle, wakes it up and waits until it has
+ * come back, so the caller may close the handle once this returns.
+ */
+static VOID
+RtlpTpCancelWait(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_WAIT_BUCKET Bucket = Object->u.Wait.Bucket;
+    ULONG Sequence;
+
+    if (Bucket == NULL)
+        return;
+
+    RtlpTpDisarmWait(Object);
+
+    /* Otherwise the wait thread rebuilds its handle list before waiting again */
+    if (!Bucket->Waiting)
+        return;
+
+    /* The bucket stays around for as long as somebody waits for it */
+    Sequence = Bucket->Sequence;
+    Bucket->AckWaiters++;
+    NtSetEvent(Bucket->UpdateEvent, NULL);
+
+    do
+    {
+        RtlLeaveCriticalSection(&RtlpTpWaitLock);
+        NtWaitForSingleObject(Bucket->AckEvent, FALSE, NULL);
+        RtlEnterCriticalSection(&RtlpTpWaitLock);
+    }
+    while (Bucket->Sequence == Sequence);
+
+    Bucket->AckWaiters--;
+}
+
+/* Wait lock held */
+static VOID
+RtlpTpFireWait(IN PRTLP_TP_WAIT_BUCKET Bucket,
+               IN ULONG Slot,
+               IN HANDLE Handle,
+               IN OUT PRTLP_TP_OBJECT *Fired,
+               IN OUT PBOOLEAN Signaled,
+               IN OUT PULONG FiredCount)
+{
+    PRTLP_TP_OBJECT Object = Bucket->Objects[Slot];
+
+    /* The wait may have been cancelled or re-armed while we were waiting */
+    if (Object == NULL || Object->u.Wait.Handle != Handle)
+        return;
+
+    RtlpTpDisarmWait(Object);
+    Signaled[*FiredCount] = TRUE;
+    Fired[(*FiredCount)++] = Object;
+}
+
+static ULONG
+NTAPI
+RtlpTpWaitThread(IN PVOID Parameter)
+{
+    PRTLP_TP_WAIT_BUCKET Bucket = (PRTLP_TP_WAIT_BUCKET)Parameter;
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+    ULONG Slots[MAXIMUM_WAIT_OBJECTS];
+    PRTLP_TP_OBJECT Fired[RTLP_TP_WAIT_SLOTS];
+    BOOLEAN Signaled[RTLP_TP_WAIT_SLOTS];
+    PRTLP_TP_OBJECT Object;
+    ULONG HandleCount, FiredCount, Slot, i;
+    ULONGLONG Now, NextTimeout;
+    LARGE_INTEGER Timeout;
+    BOOLEAN Idle = FALSE;
+    NTSTATUS Status;
+
+    RtlEnterCriticalSection(&RtlpTpWaitLock);
+
+    for (;;)
+    {
+        Now = RtlpTpInterruptTime();
+        NextTimeout = RTLP_TP_NEVER;
+        FiredCount = 0;
+
+        Handles[0] = Bucket->UpdateEvent;
+        HandleCount = 1;
+
+        for (Slot = 0; Slot < RTLP_TP_WAIT_SLOTS; Slot++)
+        {
+            Object = Bucket->Objects[Slot];
+            if (Object == NULL)
+                continue;
+
+            if (Object->u.Wait.Timeout <= Now)
+            {
+                RtlpTpDisarmWait(Object);
+                Signaled[FiredCount] = FALSE;
+                Fired[FiredCount++] = Object;
+                continue;
+            }
+
+            if (Object->u.Wait.Timeout < NextTimeout)
+                NextTimeout = Object->u.Wait.Timeout;
+
+            Handles[HandleCount] = Object->u.Wait.Handle;
+            Slots[HandleCount++] = Slot;
+        }
+
+        if (FiredCount != 0)
+            RtlpTpSubmitBatch(Fired, Signaled, FiredCount);
+
+        if (Bucket->Count == 0)
+        {
+            if (Idle && Bucket->AckWaiters == 0)
+            {
+                /* Nobody used us for a while, go away */
+                RemoveEntryList(&Bucket->ListEntry);
+                break;
+            }
+
+            NextTimeout = Now - RTLP_TP_IDLE_TIMEOUT;
+        }
+
+        /* Acknowledgements from the last round have all been picked up */
+        if (Bucket->AckSignaled && Bucket->AckWaiters == 0)
+        {
+            NtResetEvent(Bucket->AckEvent, NULL);
+            Bucket->AckSignaled = FALSE;
+        }
+
+        Bucket->Waiting = TRUE;
+        RtlLeaveCriticalSection(&RtlpTpWaitLock);
+
+        if (NextTimeout == RTLP_TP_NEVER)
+        {
+            Status = NtWaitForMultipleObjects(HandleCount, Handles, WaitAny, FALSE, NULL);
+        }
+        else
+        {
+            Timeout.QuadPart = -(LONGLONG)(NextTimeout - Now);
+            Status = NtWaitForMultipleObjects(HandleCount, Handles, WaitAny, FALSE, &Timeout);
+        }
+
+        RtlEnterCriticalSection(&RtlpTpWaitLock);
+        Bucket->Waiting = FALSE;
+
+        /* Cancelled waits are no longer in use by this thread */
+        Bucket->Sequence++;
+        if (Bucket->AckWaiters != 0)
+        {
+            NtSetEvent(Bucket->AckEvent, NULL);
+            Bucket->AckSignaled = TRUE;
+        }
+
+        Idle = (Status == STATUS_TIMEOUT && Bucket->Count == 0);
+        FiredCount = 0;
+
+        if (Status > STATUS_WAIT_0 && (ULONG)Status < STATUS_WAIT_0 + HandleCount)
+        {
+            i = Status - STATUS_WAIT_0;
+            RtlpTpFireWait(Bucket, Slots[i], Handles[i], Fired, Signaled, &FiredCount);
+        }
+        else if (Status > STATUS_ABANDONED_WAIT_0 && (ULONG)Status < STATUS_ABANDONED_WAIT_0 + HandleCount)
+        {
+            i = Status - STATUS_ABANDONED_WAIT_0;
+            RtlpTpFireWait(Bucket, Slots[i], Handles[i], Fired, Signaled, &FiredCount);
+        }
+        else if (!NT_SUCCESS(Status))
+        {
+            /* Some handle went bad, find out which one */
+            for (i = 1; i < HandleCount; i++)
+            {
+                Object = Bucket->Objects[Slots[i]];
+                if (Object == NULL || Object->u.Wait.Handle != Handles[i])
+                    continue;
+
+                Timeout.QuadPart = 0;
+                Status = NtWaitForSingleObject(Handles[i], FALSE, &Timeout);
+                if (Status == STATUS_WAIT_0 || Status == STATUS_ABANDONED_WAIT_0)
+                {
+                    RtlpTpFireWait(Bucket, Slots[i], Handles[i], Fired, Signaled, &FiredCount);
+                }
+                else if (!NT_SUCCESS(Status))
+                {
+                    DPRINT1("Dropping wait on bad handle 0x%p, Status 0x%lx\n", Handles[i], Status);
+                    RtlpTpDisarmWait(Object);
+                }
+            }
+        }
+
+        if (FiredCount != 0)
+            RtlpTpSubmitBatch(Fired, Signaled, FiredCount);
+    }
+
+    RtlLeaveCriticalSection(&RtlpTpWaitLock);
+
+    NtClose(Bucket->AckEvent);
+    NtClose(Bucket->UpdateEvent);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Bucket);
+
+    RtlpExitThreadFunc(STATUS_SUCCESS);
+    return 0;
+}
+
+/* Wait lock held */
+static NTSTATUS
+RtlpTpArmWait(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_WAIT_BUCKET Bucket = NULL;
+    PLIST_ENTRY Entry;
+    NTSTATUS Status;
+    ULONG Slot;
+
+    for (Entry = RtlpTpWaitBuckets.Flink;
+         Entry != &RtlpTpWaitBuckets;
+         Entry = Entry->Flink)
+    {
+        Bucket = CONTAINING_RECORD(Entry, RTLP_TP_WAIT_BUCKET, ListEntry);
+        if (Bucket->Count < RTLP_TP_WAIT_SLOTS)
+            break;
+
+        Bucket = NULL;
+    }
+
+    if (Bucket == NULL)
+    {
+        /* All wait threads are full, start a new one */
+        Bucket = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RTLP_TP_WAIT_BUCKET));
+        if (Bucket == NULL)
+            return STATUS_NO_MEMORY;
+
+        Status = NtCreateEvent(&Bucket->UpdateEvent,
+                               EVENT_ALL_ACCESS,
+                               NULL,
+                               SynchronizationEvent,
+                               FALSE);
+        if (!NT_SUCCESS(Status))
+        {
+            RtlFreeHeap(RtlGetProcessHeap(), 0, Bucket);
+            return Status;
+        }
+
+        Status = NtCreateEvent(&Bucket->AckEvent,
+                               EVENT_ALL_ACCESS,
+                               NULL,
+                               NotificationEvent,
+                               FALSE);
+        if (!NT_SUCCESS(Status))
+        {
+            NtClose(Bucket->UpdateEvent);
+            RtlFreeHeap(RtlGetProcessHeap(), 0, Bucket);
+            return Status;
+        }
+
+        Status = RtlpTpStartThread(RtlpTpWaitThread, Bucket);
+        if (!NT_SUCCESS(Status))
+        {
+            NtClose(Bucket->AckEvent);
+            NtClose(Bucket->UpdateEvent);
+            RtlFreeHeap(RtlGetProcessHeap(), 0, Bucket);
+            return Status;
+        }
+
+        InsertTailList(&RtlpTpWaitBuckets, &Bucket->ListEntry);
+    }
+
+    for (Slot = 0; Bucket->Objects[Slot] != NULL; Slot++);
+
+    Bucket->Objects[Slot] = Object;
+    Bucket->Count++;
+    Object->u.Wait.Bucket = Bucket;
+    Object->u.Wait.Slot = Slot;
+
+    NtSetEvent(Bucket->UpdateEvent, NULL);
+    return STATUS_SUCCESS;
+}
+
+static VOID
+RtlpTpShutdownWait(IN PRTLP_TP_OBJECT Object)
+{
+    RtlEnterCriticalSection(&RtlpTpWaitLock);
+    Object->Shutdown = TRUE;
+    RtlpTpCancelWait(Object);
+    RtlLeaveCriticalSection(&RtlpTpWaitLock);
+}
+
+/*
+ * Used by the timer queues. Posts one simple callback per context, taking
+ * each pool lock once per batch. Returns how many callbacks were posted.
+ */
+ULONG
+NTAPI
+RtlpTpSimplePostBatch(IN PTP_SIMPLE_CALLBACK Callback,
+                      IN PVOID *Contexts,
+                      IN ULONG Count,
+                      IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PRTLP_TP_OBJECT Objects[RTLP_TP_BATCH_SIZE];
+    PRTLP_TP_OBJECT Batch[RTLP_TP_BATCH_SIZE];
+    ULONG Posted = 0, Allocated, i;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    while (Posted < Count)
+    {
+        for (Allocated = 0;
+             Allocated < RTLP_TP_BATCH_SIZE && Posted + Allocated < Count;
+             Allocated++)
+        {
+            Status = RtlpTpAllocObject(TpObjectSimple,
+                                       Callback,
+                                       Contexts[Posted + Allocated],
+                                       CallbackEnviron,
+                                       &Objects[Allocated]);
+            if (!NT_SUCCESS(Status))
+                break;
+
+            Batch[Allocated] = Objects[Allocated];
+        }
+
+        if (Allocated == 0)
+            break;
+
+        RtlpTpSubmitBatch(Batch, NULL, Allocated);
+
+        /* The queues hold the objects now */
+        for (i = 0; i < Allocated; i++)
+            RtlpTpReleaseUserReference(Objects[i]);
+
+        Posted += Allocated;
+        if (Posted < Count && !NT_SUCCESS(Status))
+            break;
+    }
+
+    return Posted;
+}
+
+/* Used by RtlSetIoCompletionCallback, binds files to the default pool */
+NTSTATUS
+NTAPI
+RtlpTpGetIoCompletionPort(OUT PHANDLE CompletionPort)
+{
+    PRTLP_TP_POOL Pool;
+    NTSTATUS Status;
+
+    Status = RtlpTpInitialize();
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Pool = RtlpTpDefaultPool;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    Pool->IoBound = TRUE;
+    if (Pool->ThreadCount == 0)
+        Status = RtlpTpStartWorker(Pool);
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    if (NT_SUCCESS(Status))
+        *CompletionPort = Pool->CompletionPort;
+
+    return Status;
+}
+
+/* FUNCTIONS ****************************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocPool(OUT PTP_POOL *PoolReturn,
+            IN PVOID Reserved)
+{
+    PRTLP_TP_POOL Pool;
+    NTSTATUS Status;
+
+    UNREFERENCED_PARAMETER(Reserved);
+
+    Status = RtlpTpInitialize();
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Status = RtlpTpCreatePool(&Pool);
+    if (NT_SUCCESS(Status))
+        *PoolReturn = (PTP_POOL)Pool;
+
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleasePool(IN OUT PTP_POOL PoolHandle)
+{
+    PRTLP_TP_POOL Pool = (PRTLP_TP_POOL)PoolHandle;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    /* Let the idle threads go, busy ones leave once the queues are empty */
+    Pool->Shutdown = TRUE;
+    while (Pool->IdleThreads > Pool->PendingWakes)
+    {
+        if (!NT_SUCCESS(NtSetIoCompletion(Pool->CompletionPort, NULL, NULL, STATUS_SUCCESS, 0)))
+            break;
+
+        Pool->PendingWakes++;
+    }
+
+    if (Pool->PersistentThread)
+        NtSetEvent(Pool->PersistentEvent, NULL);
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    RtlpTpReleasePool(Pool);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetPoolMaxThreads(IN OUT PTP_POOL PoolHandle,
+                    IN ULONG MaxThreads)
+{
+    PRTLP_TP_POOL Pool = (PRTLP_TP_POOL)PoolHandle;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    Pool->MaxThreads = max(MaxThreads, 1);
+    if (Pool->MinThreads > Pool->MaxThreads)
+        Pool->MinThreads = Pool->MaxThreads;
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpSetPoolMinThreads(IN OUT PTP_POOL PoolHandle,
+                    IN ULONG MinThreads)
+{
+    PRTLP_TP_POOL Pool = (PRTLP_TP_POOL)PoolHandle;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    Pool->MinThreads = MinThreads;
+    if (Pool->MaxThreads < MinThreads)
+        Pool->MaxThreads = MinThreads;
+
+    while ((ULONG)Pool->ThreadCount < Pool->MinThreads)
+    {
+        Status = RtlpTpStartWorker(Pool);
+        if (!NT_SUCCESS(Status))
+            break;
+    }
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocCleanupGroup(OUT PTP_CLEANUP_GROUP *CleanupGroupReturn)
+{
+    PRTLP_TP_CLEANUP_GROUP Group;
+    NTSTATUS Status;
+
+    Group = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(RTLP_TP_CLEANUP_GROUP));
+    if (Group == NULL)
+        return STATUS_NO_MEMORY;
+
+    Status = RtlInitializeCriticalSection(&Group->Lock);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Group);
+        return Status;
+    }
+
+    Group->RefCount = 1;
+    InitializeListHead(&Group->Members);
+
+    *CleanupGroupReturn = (PTP_CLEANUP_GROUP)Group;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseCleanupGroup(IN OUT PTP_CLEANUP_GROUP CleanupGroup)
+{
+    RtlpTpReleaseCleanupGroup((PRTLP_TP_CLEANUP_GROUP)CleanupGroup);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseCleanupGroupMembers(IN OUT PTP_CLEANUP_GROUP CleanupGroup,
+                             IN LOGICAL CancelPendingCallbacks,
+                             IN OUT PVOID CleanupParameter OPTIONAL)
+{
+    PRTLP_TP_CLEANUP_GROUP Group = (PRTLP_TP_CLEANUP_GROUP)CleanupGroup;
+    PRTLP_TP_OBJECT Object;
+    PLIST_ENTRY Entry, NextEntry;
+    LIST_ENTRY Members;
+    BOOLEAN CallCancel;
+
+    InitializeListHead(&Members);
+
+    /* Take the members out of the group, skipping the ones being destroyed */
+    RtlEnterCriticalSection(&Group->Lock);
+    for (Entry = Group->Members.Flink; Entry != &Group->Members; Entry = NextEntry)
+    {
+        NextEntry = Entry->Flink;
+        Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, GroupEntry);
+
+        if (!RtlpTpTryReferenceObject(Object))
+            continue;
+
+        RemoveEntryList(Entry);
+        InsertTailList(&Members, Entry);
+        Object->InGroup = FALSE;
+    }
+    RtlLeaveCriticalSection(&Group->Lock);
+
+    /* Stop all sources of new callbacks first */
+    for (Entry = Members.Flink; Entry != &Members; Entry = Entry->Flink)
+    {
+        Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, GroupEntry);
+
+        if (Object->Type == TpObjectTimer)
+            RtlpTpShutdownTimer(Object);
+        else if (Object->Type == TpObjectWait)
+            RtlpTpShutdownWait(Object);
+        else
+            Object->Shutdown = TRUE;
+
+        Object->GroupCancelled = 0;
+        if (CancelPendingCallbacks)
+            Object->GroupCancelled = RtlpTpCancelCallbacks(Object);
+    }
+
+    for (Entry = Members.Flink; Entry != &Members; Entry = Entry->Flink)
+    {
+        Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, GroupEntry);
+        RtlpTpWaitForCallbacks(Object);
+    }
+
+    /* Cancellation callbacks run on this thread, once the callbacks are done */
+    while (!IsListEmpty(&Members))
+    {
+        Entry = RemoveHeadList(&Members);
+        Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, GroupEntry);
+
+        if (Object->Type == TpObjectSimple)
+        {
+            /* Simple callbacks have no user reference, only cancelled ones count */
+            CallCancel = (Object->GroupCancelled != 0);
+        }
+        else
+        {
+            /* Objects released by their owner meanwhile are left alone */
+            CallCancel = (InterlockedExchange(&Object->Released, TRUE) == FALSE);
+            if (CallCancel)
+                RtlpTpReleaseObject(Object);
+        }
+
+        if (CallCancel && CancelPendingCallbacks && Object->CancelCallback != NULL)
+            Object->CancelCallback(Object->Context, CleanupParameter);
+
+        RtlpTpReleaseObject(Object);
+    }
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpSimpleTryPost(IN PTP_SIMPLE_CALLBACK Callback,
+                IN OUT PVOID Context OPTIONAL,
+                IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = RtlpTpAllocObject(TpObjectSimple, Callback, Context, CallbackEnviron, &Object);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    RtlpTpPostCallback(Object);
+
+    /* The queue holds the object now */
+    RtlpTpReleaseUserReference(Object);
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocWork(OUT PTP_WORK *WorkReturn,
+            IN PTP_WORK_CALLBACK Callback,
+            IN OUT PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    return RtlpTpAllocObject(TpObjectWork,
+                             Callback,
+                             Context,
+                             CallbackEnviron,
+                             (PRTLP_TP_OBJECT *)WorkReturn);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpPostWork(IN OUT PTP_WORK Work)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Work;
+
+    if (!Object->Shutdown)
+        RtlpTpPostCallback(Object);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseWork(IN OUT PTP_WORK Work)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Work;
+
+    Object->Shutdown = TRUE;
+    RtlpTpReleaseUserReference(Object);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForWork(IN OUT PTP_WORK Work,
+              IN LOGICAL CancelPendingCallbacks)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Work;
+
+    if (CancelPendingCallbacks)
+        RtlpTpCancelCallbacks(Object);
+
+    RtlpTpWaitForCallbacks(Object);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocTimer(OUT PTP_TIMER *TimerReturn,
+             IN PTP_TIMER_CALLBACK Callback,
+             IN OUT PVOID Context OPTIONAL,
+             IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    return RtlpTpAllocObject(TpObjectTimer,
+                             Callback,
+                             Context,
+                             CallbackEnviron,
+                             (PRTLP_TP_OBJECT *)TimerReturn);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetTimer(IN OUT PTP_TIMER Timer,
+           IN PLARGE_INTEGER DueTime OPTIONAL,
+           IN LONG Period,
+           IN LONG WindowLength OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Timer;
+    PRTLP_TP_OBJECT Batch[1];
+    ULONGLONG Now, Due;
+    NTSTATUS Status;
+
+    RtlEnterCriticalSection(&RtlpTpTimerLock);
+
+    if (Object->Shutdown)
+    {
+        RtlLeaveCriticalSection(&RtlpTpTimerLock);
+        return;
+    }
+
+    RtlpTpRemoveTimer(Object);
+
+    if (DueTime == NULL)
+    {
+        Object->u.Timer.Set = FALSE;
+        RtlLeaveCriticalSection(&RtlpTpTimerLock);
+        return;
+    }
+
+    Status = RtlpTpStartTimerThread();
+    if (!NT_SUCCESS(Status))
+        DPRINT1("Failed to start the timer thread, Status 0x%lx\n", Status);
+
+    Now = RtlpTpInterruptTime();
+    Due = RtlpTpGetDueTime(DueTime, Now);
+    if (WindowLength > 0)
+        Due = RtlpTpCoalesceDueTime(Due, (ULONGLONG)WindowLength * 10000);
+
+    Object->u.Timer.Set = TRUE;
+    Object->u.Timer.Period = max(Period, 0);
+    Object->u.Timer.Due = Due;
+
+    if (Due <= Now)
+    {
+        /* Already due, don't make the timer thread go through a wake-up */
+        Batch[0] = Object;
+        RtlpTpSubmitBatch(Batch, NULL, 1);
+
+        if (Object->u.Timer.Period != 0)
+        {
+            Object->u.Timer.Due = Now + (ULONGLONG)Object->u.Timer.Period * 10000;
+            RtlpTpInsertTimer(Object);
+        }
+    }
+    else
+    {
+        RtlpTpInsertTimer(Object);
+    }
+
+    RtlLeaveCriticalSection(&RtlpTpTimerLock);
+}
+
+/*
+ * @implemented
+ */
+LOGICAL
+NTAPI
+TpIsTimerSet(IN PTP_TIMER Timer)
+{
+    return ((PRTLP_TP_OBJECT)Timer)->u.Timer.Set;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseTimer(IN OUT PTP_TIMER Timer)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Timer;
+
+    RtlpTpShutdownTimer(Object);
+    RtlpTpReleaseUserReference(Object);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForTimer(IN OUT PTP_TIMER Timer,
+               IN LOGICAL CancelPendingCallbacks)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Timer;
+
+    if (CancelPendingCallbacks)
+        RtlpTpCancelCallbacks(Object);
+
+    RtlpTpWaitForCallbacks(Object);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocWait(OUT PTP_WAIT *WaitReturn,
+            IN PTP_WAIT_CALLBACK Callback,
+            IN OUT PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    return RtlpTpAllocObject(TpObjectWait,
+                             Callback,
+                             Context,
+                             CallbackEnviron,
+                             (PRTLP_TP_OBJECT *)WaitReturn);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetWait(IN OUT PTP_WAIT Wait,
+          IN HANDLE Handle OPTIONAL,
+          IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Wait;
+    NTSTATUS Status;
+
+    RtlEnterCriticalSection(&RtlpTpWaitLock);
+
+    /* The old handle may be closed as soon as we return. Another TpSetWait
+     * may arm the wait again while the lock is dropped for that. */
+    while (Object->u.Wait.Bucket != NULL)
+        RtlpTpCancelWait(Object);
+
+    /* A NULL handle only cancels the wait */
+    if (Handle != NULL && !Object->Shutdown)
+    {
+        Object->u.Wait.Handle = Handle;
+        Object->u.Wait.Timeout = RTLP_TP_NEVER;
+        if (Timeout != NULL)
+            Object->u.Wait.Timeout = RtlpTpGetDueTime(Timeout, RtlpTpInterruptTime());
+
+        Status = RtlpTpArmWait(Object);
+        if (!NT_SUCCESS(Status))
+            DPRINT1("Failed to arm the wait on 0x%p, Status 0x%lx\n", Handle, Status);
+    }
+
+    RtlLeaveCriticalSection(&RtlpTpWaitLock);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseWait(IN OUT PTP_WAIT Wait)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Wait;
+
+    RtlpTpShutdownWait(Object);
+    RtlpTpReleaseUserReference(Object);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForWait(IN OUT PTP_WAIT Wait,
+              IN LOGICAL CancelPendingCallbacks)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)Wait;
+
+    if (CancelPendingCallbacks)
+        RtlpTpCancelCallbacks(Object);
+
+    RtlpTpWaitForCallbacks(Object);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpCallbackMayRunLong(IN OUT PTP_CALLBACK_INSTANCE Instance)
+{
+    PRTLP_TP_INSTANCE This = (PRTLP_TP_INSTANCE)Instance;
+    PRTLP_TP_POOL Pool = This->Object->Pool;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    if (This->MayRunLong)
+        return STATUS_SUCCESS;
+
+    This->MayRunLong = TRUE;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+
+    /* Make sure the other callbacks don't have to wait for this one */
+    if (Pool->BusyThreads >= Pool->ThreadCount &&
+        Pool->IdleThreads <= Pool->PendingWakes)
+    {
+        if ((ULONG)Pool->ThreadCount < Pool->MaxThreads)
+            Status = RtlpTpStartWorker(Pool);
+        else
+            Status = STATUS_TOO_MANY_THREADS;
+    }
+
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpDisassociateCallback(IN OUT PTP_CALLBACK_INSTANCE Instance)
+{
+    PRTLP_TP_INSTANCE This = (PRTLP_TP_INSTANCE)Instance;
+
+    if (!This->Associated)
+        return;
+
+    This->Associated = FALSE;
+    RtlpTpCallbackCompleted(This->Object);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackLeaveCriticalSectionOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                           IN OUT PRTL_CRITICAL_SECTION CriticalSection)
+{
+    ((PRTLP_TP_INSTANCE)Instance)->CriticalSection = CriticalSection;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackReleaseMutexOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                   IN HANDLE Mutex)
+{
+    ((PRTLP_TP_INSTANCE)Instance)->Mutex = Mutex;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackReleaseSemaphoreOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                       IN HANDLE Semaphore,
+                                       IN ULONG ReleaseCount)
+{
+    PRTLP_TP_INSTANCE This = (PRTLP_TP_INSTANCE)Instance;
+
+    This->Semaphore = Semaphore;
+    This->SemaphoreCount = ReleaseCount;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackSetEventOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                               IN HANDLE Event)
+{
+    ((PRTLP_TP_INSTANCE)Instance)->Event = Event;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackUnloadDllOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                IN PVOID DllHandle)
+{
+    ((PRTLP_TP_INSTANCE)Instance)->DllHandle = DllHandle;
+}
+
+/* EOF */
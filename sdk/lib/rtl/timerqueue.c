@@ -19,16 +19,6 @@
 
 /* FUNCTIONS ***************************************************************/
 
-extern PRTL_START_POOL_THREAD RtlpStartThreadFunc;
-extern PRTL_EXIT_POOL_THREAD RtlpExitThreadFunc;
-HANDLE TimerThreadHandle = NULL;
-
-NTSTATUS
-RtlpInitializeTimerThread(VOID)
-{
-    return STATUS_NOT_IMPLEMENTED;
-}
-
 static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout )
 {
     if (timeout == INFINITE) return NULL;
@@ -40,22 +30,45 @@ struct timer_queue;
 struct queue_timer
 {
     struct timer_queue *q;
-    struct list entry;
+    struct list entry;          /* wheel slot or expired list, while armed */
+    struct list queue_entry;    /* all timers of the queue */
     ULONG runcount;             /* number of callbacks pending execution */
     WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
     DWORD period;
     ULONG flags;
-    ULONGLONG expire;
+    ULONGLONG expire;           /* EXPIRE_NEVER while not armed */
     BOOL destroy;               /* timer should be deleted; once set, never unset */
     HANDLE event;               /* removal event */
 };
 
+/* The timers are kept on a hierarchical timing wheel.  Level 0 has one slot
+   per tick, every higher level has one slot per turn of the level below it
+   and is cascaded down whenever that level wraps around.  Timers beyond the
+   top level are parked in its farthest slot and sorted again on cascade.  */
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SIZE    (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS  5
+#define TIMER_WHEEL_SPAN    ((ULONGLONG)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+/* Default tick length, in milliseconds.  Expirations that fall into the same
+   tick are coalesced: they fire together, at the end of the tick.  */
+#define TIMER_QUEUE_TOLERANCE   16
+
+/* Expired timers are handed to the thread pool in batches of this size */
+#define TIMER_QUEUE_BATCH       64
+
 struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all timers, armed or not */
+    struct list wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+    struct list expired;        /* due timers that still have to be dispatched */
+    ULONGLONG tick;             /* last tick processed */
+    ULONGLONG wake_tick;        /* tick the timer thread sleeps until */
+    ULONG tolerance;            /* tick length, in milliseconds */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -74,7 +87,9 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->runcount == 0);
     assert(t->destroy);
 
-    list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        list_remove(&t->entry);
+    list_remove(&t->queue_entry);
     if (t->event)
         NtSetEvent(t->event, NULL);
     RtlFreeHeap(RtlGetProcessHeap(), 0, t);
@@ -104,6 +119,11 @@ static VOID WINAPI timer_callback_wrapper(LPVOID p)
     timer_cleanup_callback(t);
 }
 
+static VOID NTAPI timer_pool_callback(PTP_CALLBACK_INSTANCE instance, PVOID p)
+{
+    timer_callback_wrapper(p);
+}
+
 static inline ULONGLONG queue_current_time(void)
 {
     LARGE_INTEGER now, freq;
@@ -111,70 +131,213 @@ static inline ULONGLONG queue_current_time(void)
     return now.QuadPart * 1000 / freq.QuadPart;
 }
 
+static void queue_insert_timer(struct queue_timer *t, ULONGLONG first_tick)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    struct timer_queue *q = t->q;
+    ULONGLONG ticks, delta;
+    ULONG level;
+
+    /* Round up, a timer may fire late but never early */
+    ticks = (t->expire + q->tolerance - 1) / q->tolerance;
+    if (ticks < first_tick)
+        ticks = first_tick;
+
+    delta = ticks - q->tick;
+    if (delta >= TIMER_WHEEL_SPAN)
+        ticks = q->tick + TIMER_WHEEL_SPAN - 1;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++)
+    {
+        if (delta < ((ULONGLONG)1 << (TIMER_WHEEL_BITS * (level + 1))))
+            break;
+    }
+
+    list_add_tail(&q->wheel[level][(ticks >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK],
+                  &t->entry);
+}
+
 static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
                             BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
-
     t->expire = time;
+    if (time == EXPIRE_NEVER)
+        return;
 
-    /* If we insert at the head of the list, we need to expire sooner
-       than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    queue_insert_timer(t, q->tick + 1);
+
+    /* If the timer thread sleeps past this timer, it needs to wake up
+       sooner than expected.  */
+    if (set_event && (time + q->tolerance - 1) / q->tolerance < q->wake_tick)
+    {
+        q->wake_tick = q->tick;
         NtSetEvent(q->event, NULL);
+    }
 }
 
 static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        list_remove(&t->entry);
     queue_add_timer(t, time, set_event);
 }
 
-static void queue_timer_expire(struct timer_queue *q)
+static ULONGLONG queue_next_tick(struct timer_queue *q)
 {
-    struct queue_timer *t = NULL;
+    /* We MUST hold the queue cs while calling this function.  Returns the
+       first tick at which a wheel slot has to be fired or cascaded.  */
+    ULONGLONG next = EXPIRE_NEVER, base;
+    ULONG level, shift, i;
 
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        shift = TIMER_WHEEL_BITS * level;
+        base = q->tick >> shift;
+
+        for (i = 1; i <= TIMER_WHEEL_SIZE; i++)
         {
-            ++t->runcount;
-            if (t->period)
+            if (!list_empty(&q->wheel[level][(base + i) & TIMER_WHEEL_MASK]))
             {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
+                if (((base + i) << shift) < next)
+                    next = (base + i) << shift;
+                break;
             }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
+        }
+    }
+
+    return next;
+}
+
+static void queue_run_tick(struct timer_queue *q)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    struct queue_timer *t, *temp;
+    struct list slot;
+    ULONG level;
+
+    /* Bring down the timers of every level that wrapped around */
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        if (q->tick & (((ULONGLONG)1 << (TIMER_WHEEL_BITS * level)) - 1))
+            break;
+
+        list_init(&slot);
+        list_move_tail(&slot, &q->wheel[level][(q->tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK]);
+        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &slot, struct queue_timer, entry)
+        {
+            list_remove(&t->entry);
+            queue_insert_timer(t, q->tick);
+        }
+    }
+
+    list_move_tail(&q->expired, &q->wheel[0][q->tick & TIMER_WHEEL_MASK]);
+}
+
+static void queue_advance(struct timer_queue *q, ULONGLONG target)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    ULONGLONG next;
+
+    while (q->tick < target)
+    {
+        /* Skip over the empty slots in one go */
+        next = queue_next_tick(q);
+        if (next > target)
+        {
+            q->tick = target;
+            break;
+        }
+
+        q->tick = next;
+        queue_run_tick(q);
+    }
+}
+
+static ULONG queue_collect_timers(struct timer_queue *q,
+                                  struct queue_timer **batch)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    struct queue_timer *t;
+    ULONGLONG now, next;
+    ULONG count = 0;
+
+    now = queue_current_time();
+    queue_advance(q, now / q->tolerance);
+
+    while (count < TIMER_QUEUE_BATCH && !list_empty(&q->expired))
+    {
+        t = LIST_ENTRY(list_head(&q->expired), struct queue_timer, entry);
+        list_remove(&t->entry);
+        assert(!t->destroy);
+
+        ++t->runcount;
+        if (t->period)
+        {
+            next = t->expire + t->period;
+            /* avoid trigger cascade if overloaded / hibernated */
+            if (next < now)
+                next = now + t->period;
         }
         else
-            t = NULL;
+            next = EXPIRE_NEVER;
+        queue_add_timer(t, next, FALSE);
+
+        batch[count++] = t;
     }
-    RtlLeaveCriticalSection(&q->cs);
 
-    if (t)
+    return count;
+}
+
+static void queue_dispatch_timers(struct queue_timer **batch, ULONG count)
+{
+    PVOID contexts[TIMER_QUEUE_BATCH];
+    TP_CALLBACK_ENVIRON environment;
+    struct queue_timer *t;
+    ULONG i, j, n, posted, flags;
+    const ULONG pool_flags = WT_EXECUTELONGFUNCTION | WT_EXECUTEINPERSISTENTTHREAD;
+    const ULONG special_flags = WT_EXECUTEINTIMERTHREAD | WT_EXECUTEINIOTHREAD
+                                | WT_TRANSFER_IMPERSONATION;
+
+    /* Post the timers that share the same pool flags together */
+    for (i = 0; i < count; i++)
+    {
+        if (!batch[i] || (batch[i]->flags & special_flags))
+            continue;
+
+        flags = batch[i]->flags & pool_flags;
+        for (j = i, n = 0; j < count; j++)
+        {
+            t = batch[j];
+            if (t && !(t->flags & special_flags) && (t->flags & pool_flags) == flags)
+            {
+                contexts[n++] = t;
+                batch[j] = NULL;
+            }
+        }
+
+        memset(&environment, 0, sizeof(environment));
+        environment.Version = 1;
+        environment.u.s.LongFunction = !!(flags & WT_EXECUTELONGFUNCTION);
+        environment.u.s.Persistent = !!(flags & WT_EXECUTEINPERSISTENTTHREAD);
+
+        posted = RtlpTpSimplePostBatch(timer_pool_callback, contexts, n, &environment);
+        while (posted < n)
+            timer_cleanup_callback(contexts[posted++]);
+    }
+
+    for (i = 0; i < count; i++)
     {
+        t = batch[i];
+        if (!t)
+            continue;
+
         if (t->flags & WT_EXECUTEINTIMERTHREAD)
             timer_callback_wrapper(t);
         else
@@ -192,24 +355,47 @@ static void queue_timer_expire(struct timer_queue *q)
 
 static ULONG queue_get_timeout(struct timer_queue *q)
 {
-    struct queue_timer *t;
-    ULONG timeout = INFINITE;
+    /* We MUST hold the queue cs while calling this function.  */
+    ULONGLONG next, time, now;
 
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if (!list_empty(&q->expired))
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : (ULONG)(t->expire - time);
-        }
+        q->wake_tick = q->tick;
+        return 0;
     }
-    RtlLeaveCriticalSection(&q->cs);
 
-    return timeout;
+    next = queue_next_tick(q);
+    q->wake_tick = next;
+    if (next == EXPIRE_NEVER)
+        return INFINITE;
+
+    time = next * q->tolerance;
+    now = queue_current_time();
+    if (time <= now)
+        return 0;
+
+    time -= now;
+    return time < INFINITE ? (ULONG)time : INFINITE - 1;
+}
+
+static ULONG queue_timer_expire(struct timer_queue *q)
+{
+    struct queue_timer *batch[TIMER_QUEUE_BATCH];
+    ULONG count, timeout = INFINITE;
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&q->cs);
+        count = queue_collect_timers(q, batch);
+        if (!count)
+            timeout = queue_get_timeout(q);
+        RtlLeaveCriticalSection(&q->cs);
+
+        if (!count)
+            return timeout;
+
+        queue_dispatch_timers(batch, count);
+    }
 }
 
 static DWORD WINAPI timer_queue_thread_proc(LPVOID p)
@@ -230,21 +416,19 @@ static DWORD WINAPI timer_queue_thread_proc(LPVOID p)
         if (status == STATUS_WAIT_0)
         {
             /* There are two possible ways to trigger the event.  Either
-               we are quitting and the last timer got removed, or a new
-               timer got put at the head of the list so we need to adjust
-               our timeout.  */
+               we are quitting and the last timer got removed, or a timer
+               got armed before our wake up tick so we need to adjust our
+               timeout.  */
             RtlEnterCriticalSection(&q->cs);
             if (q->quit && list_empty(&q->timers))
                 done = TRUE;
             RtlLeaveCriticalSection(&q->cs);
         }
-        else if (status == STATUS_TIMEOUT)
-            queue_timer_expire(q);
 
         if (done)
             break;
 
-        timeout_ms = queue_get_timeout(q);
+        timeout_ms = queue_timer_expire(q);
     }
 
     NtClose(q->event);
@@ -265,8 +449,7 @@ static void queue_destroy_timer(struct queue_timer *t)
            cleanup wrapper.  */
         queue_remove_timer(t);
     else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+        /* Take it off the wheel so that it doesn't fire again.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -285,12 +468,20 @@ static void queue_destroy_timer(struct queue_timer *t)
 NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 {
     NTSTATUS status;
+    ULONG i, j;
     struct timer_queue *q = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof *q);
     if (!q)
         return STATUS_NO_MEMORY;
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    list_init(&q->expired);
+    for (i = 0; i < TIMER_WHEEL_LEVELS; i++)
+        for (j = 0; j < TIMER_WHEEL_SIZE; j++)
+            list_init(&q->wheel[i][j]);
+    q->tolerance = TIMER_QUEUE_TOLERANCE;
+    q->tick = queue_current_time() / q->tolerance;
+    q->wake_tick = EXPIRE_NEVER;
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -345,7 +536,7 @@ NTSTATUS WINAPI RtlDeleteTimerQueueEx(HANDLE TimerQueue, HANDLE CompletionEvent)
     if (list_head(&q->timers))
         /* When the last timer is removed, it will signal the timer thread to
            exit...  */
-        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, entry)
+        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, queue_entry)
             queue_destroy_timer(t);
     else
         /* However if we have none, we must do it ourselves.  */
@@ -444,6 +635,7 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, PHANDLE NewTimer,
     t->param = Parameter;
     t->period = Period;
     t->flags = Flags;
+    t->expire = EXPIRE_NEVER;
     t->destroy = FALSE;
     t->event = NULL;
 
@@ -452,7 +644,10 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, PHANDLE NewTimer,
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
     else
+    {
+        list_add_tail(&q->timers, &t->queue_entry);
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
@@ -17,6 +17,10 @@
 
 #include <wine/unicode.h>
 
+#if defined(_M_AMD64)
+#include <emmintrin.h>
+#endif
+
 /* GLOBALS *******************************************************************/
 
 extern BOOLEAN NlsMbCodePageTag;
@@ -30,6 +34,173 @@ extern PCHAR NlsUnicodeToOemTable;
 extern PUSHORT NlsUnicodeToMbOemTable;
 
 
+/* PRIVATE FUNCTIONS *********************************************************/
+
+/* Upcases ASCII in place and only calls into the case table for the rest */
+FORCEINLINE
+WCHAR
+RtlpUpcaseChar(IN WCHAR Char)
+{
+    if (Char < L'a')
+        return Char;
+
+    if (Char <= L'z')
+        return Char - (L'a' - L'A');
+
+    return RtlpUpcaseUnicodeChar(Char);
+}
+
+#if defined(_M_AMD64)
+/* Upcases the ASCII letters among eight characters, leaving the rest alone */
+FORCEINLINE
+__m128i
+RtlpUpcaseAscii8(IN __m128i Chars)
+{
+    __m128i Lower = _mm_and_si128(_mm_cmpgt_epi16(Chars, _mm_set1_epi16(L'a' - 1)),
+                                  _mm_cmplt_epi16(Chars, _mm_set1_epi16(L'z' + 1)));
+
+    return _mm_sub_epi16(Chars, _mm_and_si128(Lower, _mm_set1_epi16(L'a' - L'A')));
+}
+
+FORCEINLINE
+BOOLEAN
+RtlpIsAscii8(IN __m128i Chars)
+{
+    __m128i NonAscii = _mm_and_si128(Chars, _mm_set1_epi16((SHORT)0xFF80));
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi16(NonAscii, _mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+
+FORCEINLINE
+LONG
+RtlpCompareUnicodeRun(IN PCWCH String1,
+                      IN PCWCH String2,
+                      IN ULONG Count,
+                      IN BOOLEAN CaseInsensitive)
+{
+    LONG Result;
+    ULONG i;
+
+    for (i = 0; i < Count; i++)
+    {
+        if (String1[i] == String2[i])
+            continue;
+
+        if (CaseInsensitive)
+            Result = RtlpUpcaseChar(String1[i]) - RtlpUpcaseChar(String2[i]);
+        else
+            Result = String1[i] - String2[i];
+
+        if (Result)
+            return Result;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns the difference between the first two characters that differ,
+ * after upcasing them if asked to. On x64 blocks of eight characters are
+ * compared with SSE2, and upcased there as well when they are all ASCII.
+ * Only blocks that differ and hold other characters go to the case table.
+ */
+static
+LONG
+RtlpCompareUnicodeChars(IN PCWCH String1,
+                        IN PCWCH String2,
+                        IN ULONG Count,
+                        IN BOOLEAN CaseInsensitive)
+{
+    ULONG i = 0;
+#if defined(_M_AMD64)
+    __m128i Chars1, Chars2;
+    LONG Result;
+
+    for (; Count - i >= 8; i += 8)
+    {
+        Chars1 = _mm_loadu_si128((const __m128i *)&String1[i]);
+        Chars2 = _mm_loadu_si128((const __m128i *)&String2[i]);
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(Chars1, Chars2)) == 0xFFFF)
+            continue;
+
+        if (CaseInsensitive &&
+            RtlpIsAscii8(_mm_or_si128(Chars1, Chars2)) &&
+            _mm_movemask_epi8(_mm_cmpeq_epi16(RtlpUpcaseAscii8(Chars1),
+                                              RtlpUpcaseAscii8(Chars2))) == 0xFFFF)
+        {
+            continue;
+        }
+
+        Result = RtlpCompareUnicodeRun(&String1[i], &String2[i], 8, CaseInsensitive);
+        if (Result)
+            return Result;
+    }
+#endif
+
+    return RtlpCompareUnicodeRun(&String1[i], &String2[i], Count - i, CaseInsensitive);
+}
+
+/*
+ * The x65599 string hash. Four characters are folded per step as
+ * h * P^4 + c0 * P^3 + c1 * P^2 + c2 * P + c3, which is the same value
+ * modulo 2^32 as four single steps but keeps the multiplications from
+ * waiting on each other.
+ */
+static
+ULONG
+RtlpHashUnicodeChars(IN PCWCH String,
+                     IN ULONG Count,
+                     IN BOOLEAN CaseInsensitive)
+{
+    const ULONG P1 = 65599;
+    const ULONG P2 = P1 * P1;
+    const ULONG P3 = P2 * P1;
+    const ULONG P4 = P3 * P1;
+    ULONG Hash = 0;
+    ULONG i = 0;
+    WCHAR c[8];
+    ULONG j;
+#if defined(_M_AMD64)
+    __m128i Chars;
+
+    for (; Count - i >= 8; i += 8)
+    {
+        Chars = _mm_loadu_si128((const __m128i *)&String[i]);
+
+        if (!CaseInsensitive || RtlpIsAscii8(Chars))
+        {
+            if (CaseInsensitive)
+                Chars = RtlpUpcaseAscii8(Chars);
+            _mm_storeu_si128((__m128i *)c, Chars);
+        }
+        else
+        {
+            for (j = 0; j < 8; j++)
+                c[j] = RtlpUpcaseChar(String[i + j]);
+        }
+
+        Hash = Hash * P4 + c[0] * P3 + c[1] * P2 + c[2] * P1 + c[3];
+        Hash = Hash * P4 + c[4] * P3 + c[5] * P2 + c[6] * P1 + c[7];
+    }
+#endif
+
+    for (; Count - i >= 4; i += 4)
+    {
+        for (j = 0; j < 4; j++)
+            c[j] = CaseInsensitive ? RtlpUpcaseChar(String[i + j]) : String[i + j];
+
+        Hash = Hash * P4 + c[0] * P3 + c[1] * P2 + c[2] * P1 + c[3];
+    }
+
+    for (; i < Count; i++)
+        Hash = Hash * P1 + (CaseInsensitive ? RtlpUpcaseChar(String[i]) : String[i]);
+
+    return Hash;
+}
+
+
 /* FUNCTIONS *****************************************************************/
 
 NTSTATUS
@@ -408,7 +579,7 @@ RtlEqualUnicodeString(
     IN BOOLEAN  CaseInsensitive)
 {
     if (s1->Length != s2->Length) return FALSE;
-    return !RtlCompareUnicodeString(s1, s2, CaseInsensitive );
+    return !RtlpCompareUnicodeChars(s1->Buffer, s2->Buffer, s1->Length / sizeof(WCHAR), CaseInsensitive);
 }
 
 /*
@@ -938,27 +1109,7 @@ RtlPrefixUnicodeString(
     pc2 = String2->Buffer;
 
     if (pc1 && pc2)
-    {
-        if (CaseInsensitive)
-        {
-            while (NumChars--)
-            {
-                if (RtlpUpcaseUnicodeChar(*pc1++) !=
-                    RtlpUpcaseUnicodeChar(*pc2++))
-                    return FALSE;
-            }
-        }
-        else
-        {
-            while (NumChars--)
-            {
-                if (*pc1++ != *pc2++)
-                    return FALSE;
-            }
-        }
-
-        return TRUE;
-    }
+        return !RtlpCompareUnicodeChars(pc1, pc2, NumChars, CaseInsensitive);
 
     return FALSE;
 }
@@ -1736,32 +1887,11 @@ RtlHashUnicodeString(
         {
             case HASH_STRING_ALGORITHM_DEFAULT:
             case HASH_STRING_ALGORITHM_X65599:
-            {
-                WCHAR *c, *end;
-
-                *HashValue = 0;
-                end = String->Buffer + (String->Length / sizeof(WCHAR));
-
-                if (CaseInSensitive)
-                {
-                    for (c = String->Buffer; c != end; c++)
-                    {
-                        /* only uppercase characters if they are 'a' ... 'z'! */
-                        *HashValue = ((65599 * (*HashValue)) +
-                                      (ULONG)(((*c) >= L'a' && (*c) <= L'z') ?
-                                              (*c) - L'a' + L'A' : (*c)));
-                    }
-                }
-                else
-                {
-                    for (c = String->Buffer; c != end; c++)
-                    {
-                        *HashValue = ((65599 * (*HashValue)) + (ULONG)(*c));
-                    }
-                }
-
+                /* Upcase like RtlEqualUnicodeString, so equal strings hash the same */
+                *HashValue = RtlpHashUnicodeChars(String->Buffer,
+                                                  String->Length / sizeof(WCHAR),
+                                                  CaseInSensitive);
                 return STATUS_SUCCESS;
-            }
         }
     }
 
@@ -2186,22 +2316,12 @@ RtlCompareUnicodeString(
     IN PCUNICODE_STRING s2,
     IN BOOLEAN  CaseInsensitive)
 {
-    unsigned int len;
-    LONG ret = 0;
-    LPCWSTR p1, p2;
-
-    len = min(s1->Length, s2->Length) / sizeof(WCHAR);
-    p1 = s1->Buffer;
-    p2 = s2->Buffer;
+    LONG ret;
 
-    if (CaseInsensitive)
-    {
-        while (!ret && len--) ret = RtlpUpcaseUnicodeChar(*p1++) - RtlpUpcaseUnicodeChar(*p2++);
-    }
-    else
-    {
-        while (!ret && len--) ret = *p1++ - *p2++;
-    }
+    ret = RtlpCompareUnicodeChars(s1->Buffer,
+                                  s2->Buffer,
+                                  min(s1->Length, s2->Length) / sizeof(WCHAR),
+                                  CaseInsensitive);
 
     if (!ret) ret = s1->Length - s2->Length;
 
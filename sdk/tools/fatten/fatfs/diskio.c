@@ -9,13 +9,168 @@
 
 #include "diskio.h"		/* FatFs lower layer API */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define SECTOR_SIZE     512
+
+/*-----------------------------------------------------------------------*/
+/* Write-back cache: the image is accessed in chunks of CHUNK_SECTORS    */
+/* sectors, kept in a direct mapped table of CACHE_CHUNKS entries. Only  */
+/* the dirty span of a chunk is written back, on eviction or CTRL_SYNC.  */
+
+#define CHUNK_SECTORS   128     /* 64 KB */
+#define CHUNK_SIZE      (CHUNK_SECTORS * SECTOR_SIZE)
+#define CACHE_CHUNKS    256     /* 16 MB */
+
+typedef struct _CACHE_CHUNK
+{
+    BYTE* Data;         /* NULL if the entry is unused */
+    DWORD Chunk;
+    UINT DirtyFirst;    /* dirty sectors, DirtyFirst < DirtyEnd if any */
+    UINT DirtyEnd;
+} CACHE_CHUNK;
 
 /*-----------------------------------------------------------------------*/
 /* Correspondence between physical drive number and image file handles.  */
 
 UINT sectorCount[1] = { 0 };
-FILE* driveHandle[1] = { NULL };
-const int driveHandleCount = sizeof(driveHandle) / sizeof(FILE*);
+int driveHandle[1] = { -1 };
+ULONGLONG imageSize[1] = { 0 };
+const int driveHandleCount = sizeof(driveHandle) / sizeof(int);
+
+static CACHE_CHUNK cache[CACHE_CHUNKS];
+
+/*-----------------------------------------------------------------------*/
+/* Positioned I/O on the image file                                      */
+
+static int image_read(int fd, void* buff, UINT length, ULONGLONG offset)
+{
+#ifdef _WIN32
+    if (_lseeki64(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return _read(fd, buff, length);
+#else
+    return (int)pread(fd, buff, length, (off_t)offset);
+#endif
+}
+
+static int image_write(int fd, const void* buff, UINT length, ULONGLONG offset)
+{
+#ifdef _WIN32
+    if (_lseeki64(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return _write(fd, buff, length);
+#else
+    return (int)pwrite(fd, buff, length, (off_t)offset);
+#endif
+}
+
+static ULONGLONG image_size(int fd)
+{
+#ifdef _WIN32
+    __int64 size = _lseeki64(fd, 0, SEEK_END);
+#else
+    off_t size = lseek(fd, 0, SEEK_END);
+#endif
+    return (size < 0) ? 0 : (ULONGLONG)size;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Cache management                                                      */
+
+static int cache_flush_chunk(BYTE pdrv, CACHE_CHUNK* entry)
+{
+    ULONGLONG offset, end;
+
+    if (entry->DirtyFirst >= entry->DirtyEnd)
+        return 0;
+
+    /* Never write past the end of the image */
+    offset = ((ULONGLONG)entry->Chunk * CHUNK_SECTORS + entry->DirtyFirst) * SECTOR_SIZE;
+    end = ((ULONGLONG)entry->Chunk * CHUNK_SECTORS + entry->DirtyEnd) * SECTOR_SIZE;
+    if (end > imageSize[pdrv])
+        end = imageSize[pdrv];
+
+    if (offset < end)
+    {
+        UINT length = (UINT)(end - offset);
+
+        if (image_write(driveHandle[pdrv], entry->Data + entry->DirtyFirst * SECTOR_SIZE,
+                        length, offset) != (int)length)
+            return -1;
+    }
+
+    entry->DirtyFirst = entry->DirtyEnd = 0;
+    return 0;
+}
+
+static int cache_flush(BYTE pdrv)
+{
+    int i, result = 0;
+
+    for (i = 0; i < CACHE_CHUNKS; i++)
+    {
+        if (cache[i].Data && cache_flush_chunk(pdrv, &cache[i]))
+            result = -1;
+    }
+    return result;
+}
+
+/* Returns the cache entry holding chunk, loading it from the image
+ * unless the caller is about to overwrite it completely. */
+static CACHE_CHUNK* cache_get(BYTE pdrv, DWORD chunk, int overwrite)
+{
+    CACHE_CHUNK* entry = &cache[chunk % CACHE_CHUNKS];
+    ULONGLONG offset;
+    int result = 0;
+
+    if (entry->Data && entry->Chunk == chunk)
+        return entry;
+
+    if (entry->Data)
+    {
+        if (cache_flush_chunk(pdrv, entry))
+            return NULL;
+    }
+    else
+    {
+        entry->Data = malloc(CHUNK_SIZE);
+        if (!entry->Data)
+            return NULL;
+    }
+
+    /* Invalidate the entry until it holds the new chunk */
+    entry->Chunk = (DWORD)-1;
+    entry->DirtyFirst = entry->DirtyEnd = 0;
+
+    if (!overwrite)
+    {
+        offset = (ULONGLONG)chunk * CHUNK_SIZE;
+        if (offset < imageSize[pdrv])
+        {
+            result = image_read(driveHandle[pdrv], entry->Data, CHUNK_SIZE, offset);
+            if (result < 0)
+                return NULL;
+        }
+        /* Anything past the end of the image reads as zeroes */
+        memset(entry->Data + result, 0, CHUNK_SIZE - result);
+    }
+
+    entry->Chunk = chunk;
+    return entry;
+}
 
 /*-----------------------------------------------------------------------*/
 /* Open an image file a Drive                                            */
@@ -25,17 +180,15 @@ DSTATUS disk_openimage(BYTE pdrv, const char* imageFileName)
 {
     if (pdrv < driveHandleCount)
     {
-        if (driveHandle[0] != NULL)
+        if (driveHandle[0] != -1)
             return 0;
 
-        driveHandle[0] = fopen(imageFileName, "r+b");
-        if (!driveHandle[0])
+        driveHandle[0] = open(imageFileName, O_RDWR | O_CREAT | O_BINARY, 0644);
+        if (driveHandle[0] != -1)
         {
-            driveHandle[0] = fopen(imageFileName, "w+b");
-        }
-
-        if (driveHandle[0] != NULL)
+            imageSize[0] = image_size(driveHandle[0]);
             return 0;
+        }
     }
     return STA_NOINIT;
 }
@@ -49,12 +202,23 @@ VOID disk_cleanup(
     BYTE pdrv		/* Physical drive nmuber (0..) */
     )
 {
+    int i;
+
     if (pdrv < driveHandleCount)
     {
-        if (driveHandle[pdrv] != NULL)
+        if (driveHandle[pdrv] != -1)
         {
-            fclose(driveHandle[pdrv]);
-            driveHandle[pdrv] = NULL;
+            if (cache_flush(pdrv))
+                fprintf(stderr, "Error: Unable to write back cached sectors to the image.\n");
+
+            for (i = 0; i < CACHE_CHUNKS; i++)
+            {
+                free(cache[i].Data);
+                cache[i].Data = NULL;
+            }
+
+            close(driveHandle[pdrv]);
+            driveHandle[pdrv] = -1;
         }
     }
 }
@@ -86,7 +250,7 @@ DSTATUS disk_status(
 {
     if (pdrv < driveHandleCount)
     {
-        if (driveHandle[pdrv] != NULL)
+        if (driveHandle[pdrv] != -1)
             return 0;
     }
     return STA_NOINIT;
@@ -103,19 +267,30 @@ DRESULT disk_read(
     UINT count		/* Number of sectors to read (1..128) */
     )
 {
-    DWORD result;
+    CACHE_CHUNK* entry;
+    UINT first, n;
 
     if (pdrv < driveHandleCount)
     {
-        if (driveHandle[pdrv] != NULL)
+        if (driveHandle[pdrv] != -1)
         {
-            if (fseek(driveHandle[pdrv], sector * 512, SEEK_SET))
-                return RES_ERROR;
+            while (count > 0)
+            {
+                first = sector % CHUNK_SECTORS;
+                n = CHUNK_SECTORS - first;
+                if (n > count)
+                    n = count;
 
-            result = fread(buff, 512, count, driveHandle[pdrv]);
+                entry = cache_get(pdrv, sector / CHUNK_SECTORS, 0);
+                if (!entry)
+                    return RES_ERROR;
 
-            if (result != count)
-                return RES_ERROR;
+                memcpy(buff, entry->Data + first * SECTOR_SIZE, n * SECTOR_SIZE);
+
+                buff += n * SECTOR_SIZE;
+                sector += n;
+                count -= n;
+            }
 
             return RES_OK;
         }
@@ -138,19 +313,43 @@ DRESULT disk_write(
     UINT count			/* Number of sectors to write (1..128) */
     )
 {
-    DWORD result;
+    CACHE_CHUNK* entry;
+    UINT first, n;
 
     if (pdrv < driveHandleCount)
     {
-        if (driveHandle[pdrv] != NULL)
+        if (driveHandle[pdrv] != -1)
         {
-            if (fseek(driveHandle[pdrv], sector * 512, SEEK_SET))
-                return RES_ERROR;
+            while (count > 0)
+            {
+                first = sector % CHUNK_SECTORS;
+                n = CHUNK_SECTORS - first;
+                if (n > count)
+                    n = count;
+
+                entry = cache_get(pdrv, sector / CHUNK_SECTORS, n == CHUNK_SECTORS);
+                if (!entry)
+                    return RES_ERROR;
+
+                memcpy(entry->Data + first * SECTOR_SIZE, buff, n * SECTOR_SIZE);
 
-            result = fwrite(buff, 512, count, driveHandle[pdrv]);
+                if (entry->DirtyFirst >= entry->DirtyEnd)
+                {
+                    entry->DirtyFirst = first;
+                    entry->DirtyEnd = first + n;
+                }
+                else
+                {
+                    if (first < entry->DirtyFirst)
+                        entry->DirtyFirst = first;
+                    if (first + n > entry->DirtyEnd)
+                        entry->DirtyEnd = first + n;
+                }
 
-            if (result != count)
-                return RES_ERROR;
+                buff += n * SECTOR_SIZE;
+                sector += n;
+                count -= n;
+            }
 
             return RES_OK;
         }
@@ -174,49 +373,43 @@ DRESULT disk_ioctl(
 {
     if (pdrv < driveHandleCount)
     {
-        if (driveHandle[pdrv] != NULL)
+        if (driveHandle[pdrv] != -1)
         {
             switch (cmd)
             {
             case CTRL_SYNC:
-                fflush(driveHandle[pdrv]);
+                if (cache_flush(pdrv))
+                    return RES_ERROR;
                 return RES_OK;
             case GET_SECTOR_SIZE:
-                *(DWORD*)buff = 512;
+                *(DWORD*)buff = SECTOR_SIZE;
                 return RES_OK;
             case GET_BLOCK_SIZE:
-                *(DWORD*)buff = 512;
+                *(DWORD*)buff = SECTOR_SIZE;
                 return RES_OK;
             case GET_SECTOR_COUNT:
             {
                 if (sectorCount[pdrv] <= 0)
-                {
-                    if (fseek(driveHandle[pdrv], 0, SEEK_END))
-                        printf("fseek failed!\n");
-                    else
-                        sectorCount[pdrv] = ftell(driveHandle[pdrv]) / 512;
-                }
+                    sectorCount[pdrv] = (UINT)(imageSize[pdrv] / SECTOR_SIZE);
 
                 *(DWORD*)buff = sectorCount[pdrv];
                 return RES_OK;
             }
             case SET_SECTOR_COUNT:
             {
-                int count = *(DWORD*)buff;
-                long size;
+                DWORD count = *(DWORD*)buff;
+                ULONGLONG size = (ULONGLONG)count * SECTOR_SIZE;
+                const BYTE zero = 0;
 
                 sectorCount[pdrv] = count;
 
-                fseek(driveHandle[pdrv], 0, SEEK_END);
-                size = ftell(driveHandle[pdrv]) / 512;
-
-                if (size < count)
+                if (imageSize[pdrv] < size)
                 {
-                    if (fseek(driveHandle[pdrv], count * 512 - 1, SEEK_SET))
+                    /* Extend the file, the cache already reads zeroes there */
+                    if (image_write(driveHandle[pdrv], &zero, 1, size - 1) != 1)
                         return RES_ERROR;
 
-                    fwrite(buff, 1, 1, driveHandle[pdrv]);
-
+                    imageSize[pdrv] = size;
                     return RES_OK;
                 }
                 else
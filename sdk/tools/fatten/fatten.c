@@ -16,6 +16,14 @@ static FATFS g_Filesystem;
 static int isMounted = 0;
 static unsigned char buff[32768];
 
+// File data is moved in chunks that are a whole number of clusters (at most
+// 64 KB each), so FatFs transfers it straight from the buffer, one cluster
+// per disk access, instead of going through its sector window.
+static unsigned char copybuff[256 * 1024];
+
+// Cluster link map for fast seeking in files read from the image
+#define CLMT_ITEMS 1024
+
 // tool needed by fatfs
 DWORD get_fattime(void)
 {
@@ -69,7 +77,12 @@ void print_help(const char* name)
     printf("    -boot <sector file>\n"
            "            Writes a new boot sector.\n");
     printf("    -add <src path> <dst path>\n"
-           "            Copies an external file or directory into the image.\n");
+           "            Copies an external file into the image.\n");
+    printf("    -manifest <manifest file>\n"
+           "            Copies all the files listed in a manifest into the image. Each line\n"
+           "            holds an external file and its path in the image, or just a path\n"
+           "            ending with '/' for an empty directory. Missing directories are\n"
+           "            created, paths with spaces can be quoted, '#' starts a comment.\n");
     printf("    -extract <src path> <dst path>\n"
            "            Copies a file or directory from the image into an external file\n"
            "            or directory.\n");
@@ -122,6 +135,204 @@ int need_mount(void)
     return FR_OK;
 }
 
+// Lets FatFs seek through a file from the cluster link map instead of the FAT
+static void enable_fast_seek(FIL* fp, DWORD* clmt)
+{
+    fp->cltbl = clmt;
+    clmt[0] = CLMT_ITEMS;
+    if (f_lseek(fp, CREATE_LINKMAP))
+    {
+        // Too fragmented for the map, keep following the FAT chain
+        fp->cltbl = NULL;
+    }
+}
+
+int add_file(const char* src, const char* dst)
+{
+    FILE* fe;
+    FIL   fv = { 0 };
+    UINT rdlen = 0;
+    UINT wrlen = 0;
+    long size;
+    int ret = 0;
+
+    fe = fopen(src, "rb");
+    if (!fe)
+    {
+        fprintf(stderr, "Error: Unable to open external file '%s' for reading.\n", src);
+        return 1;
+    }
+
+    if (f_open(&fv, dst, FA_WRITE | FA_CREATE_ALWAYS))
+    {
+        fprintf(stderr, "Error: Unable to open file '%s' for writing.\n", dst);
+        fclose(fe);
+        return 1;
+    }
+
+    // Allocate the whole cluster chain at once, this also catches a full image early
+    if (fseek(fe, 0, SEEK_END) == 0 && (size = ftell(fe)) > 0)
+    {
+        if (f_lseek(&fv, size) || fv.fptr != (DWORD)size || f_lseek(&fv, 0))
+        {
+            fprintf(stderr, "Error: Not enough space in the image for '%s'.\n", src);
+            ret = 1;
+        }
+    }
+    fseek(fe, 0, SEEK_SET);
+
+    while (!ret && (rdlen = fread(copybuff, 1, sizeof(copybuff), fe)) > 0)
+    {
+        if (f_write(&fv, copybuff, rdlen, &wrlen) || wrlen < rdlen)
+        {
+            fprintf(stderr, "Error: Unable to write '%d' bytes to disk.\n", wrlen);
+            ret = 1;
+        }
+    }
+
+    // Drop whatever was allocated beyond the data actually written
+    if (!ret && f_truncate(&fv))
+        ret = 1;
+
+    fclose(fe);
+    if (f_close(&fv))
+        ret = 1;
+
+    // Don't leave a truncated file or its preallocated clusters behind
+    if (ret)
+        f_unlink(dst);
+
+    return ret;
+}
+
+static int is_separator(char c)
+{
+    return (c == '/') || (c == '\\');
+}
+
+// Creates the directories leading to path, the last component only if path
+// ends with a separator.
+int make_parents(const char* path)
+{
+    char dir[1024];
+    size_t len = strlen(path);
+    size_t i = 0;
+    FRESULT res;
+
+    if (len >= sizeof(dir))
+    {
+        fprintf(stderr, "Error: Path '%s' is too long.\n", path);
+        return 1;
+    }
+    strcpy(dir, path);
+
+    // Skip the drive and the leading separators
+    if (len >= 2 && dir[1] == ':')
+        i = 2;
+    while (is_separator(dir[i]))
+        i++;
+
+    for (; i < len; i++)
+    {
+        if (!is_separator(dir[i]) || is_separator(dir[i - 1]))
+            continue;
+
+        dir[i] = '\0';
+        res = f_mkdir(dir);
+        dir[i] = path[i];
+        if (res != FR_OK && res != FR_EXIST)
+        {
+            fprintf(stderr, "Error: Unable to create directory for '%s' (%d).\n", path, res);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static char* next_token(char** line)
+{
+    char* p = *line;
+    char* start;
+
+    while (isspace((unsigned char)*p))
+        p++;
+    if (*p == '\0')
+        return NULL;
+
+    if (*p == '"')
+    {
+        start = ++p;
+        while (*p && *p != '"')
+            p++;
+    }
+    else
+    {
+        start = p;
+        while (*p && !isspace((unsigned char)*p))
+            p++;
+    }
+
+    if (*p)
+        *p++ = '\0';
+    *line = p;
+    return start;
+}
+
+int add_manifest(const char* name)
+{
+    FILE* fm;
+    char line[2048];
+    char *p, *src, *dst;
+    int lineno = 0;
+    int ret = 0;
+
+    fm = fopen(name, "r");
+    if (!fm)
+    {
+        fprintf(stderr, "Error: Unable to open manifest '%s' for reading.\n", name);
+        return 1;
+    }
+
+    while (!ret && fgets(line, sizeof(line), fm))
+    {
+        lineno++;
+        p = line;
+
+        src = next_token(&p);
+        if (!src || *src == '#')
+            continue;
+
+        dst = next_token(&p);
+        if (!dst)
+        {
+            // A lone directory
+            if (!is_separator(src[strlen(src) - 1]))
+            {
+                fprintf(stderr, "Error: %s(%d): Expected '<src path> <dst path>'.\n", name, lineno);
+                ret = 1;
+                break;
+            }
+            ret = make_parents(src);
+            continue;
+        }
+
+        if (next_token(&p))
+        {
+            fprintf(stderr, "Error: %s(%d): Too many paths on one line.\n", name, lineno);
+            ret = 1;
+            break;
+        }
+
+        ret = make_parents(dst);
+        if (!ret)
+            ret = add_file(src, dst);
+    }
+
+    fclose(fm);
+    return ret;
+}
+
 #define NEED_MOUNT() \
     do { ret = need_mount(); if(ret) \
     {\
@@ -352,11 +563,6 @@ int main(int oargc, char* oargv[])
         }
         else if (strcmp(parg, "add") == 0)
         {
-            FILE* fe;
-            FIL   fv = { 0 };
-            UINT rdlen = 0;
-            UINT wrlen = 0;
-
             NEED_PARAMS(2, 2);
 
             NEED_MOUNT();
@@ -364,41 +570,32 @@ int main(int oargc, char* oargv[])
             // Arg 1: external file to add
             // Arg 2: virtual filename
 
-            fe = fopen(argv[0], "rb");
-            if (!fe)
+            if (add_file(argv[0], argv[1]))
             {
-                fprintf(stderr, "Error: Unable to open external file '%s' for reading.", argv[0]);
                 ret = 1;
                 goto exit;
             }
+        }
+        else if (strcmp(parg, "manifest") == 0)
+        {
+            NEED_PARAMS(1, 1);
 
-            if (f_open(&fv, argv[1], FA_WRITE | FA_CREATE_ALWAYS))
+            NEED_MOUNT();
+
+            // Arg 1: manifest listing the files to add
+
+            if (add_manifest(argv[0]))
             {
-                fprintf(stderr, "Error: Unable to open file '%s' for writing.", argv[1]);
-                fclose(fe);
                 ret = 1;
                 goto exit;
             }
-
-            while ((rdlen = fread(buff, 1, sizeof(buff), fe)) > 0)
-            {
-                if (f_write(&fv, buff, rdlen, &wrlen) || wrlen < rdlen)
-                {
-                    fprintf(stderr, "Error: Unable to write '%d' bytes to disk.", wrlen);
-                    ret = 1;
-                    goto exit;
-                }
-            }
-
-            fclose(fe);
-            f_close(&fv);
         }
         else if (strcmp(parg, "extract") == 0)
         {
             FIL   fe = { 0 };
             FILE* fv;
+            DWORD clmt[CLMT_ITEMS];
             UINT rdlen = 0;
-            UINT wrlen = 0;
 
             NEED_PARAMS(2, 2);
 
@@ -413,6 +610,7 @@ int main(int oargc, char* oargv[])
                 ret = 1;
                 goto exit;
             }
+            enable_fast_seek(&fe, clmt);
 
             fv = fopen(argv[1], "wb");
             if (!fv)
@@ -423,9 +621,9 @@ int main(int oargc, char* oargv[])
                 goto exit;
             }
 
-            while ((f_read(&fe, buff, sizeof(buff), &rdlen) == 0) && (rdlen > 0))
+            while ((f_read(&fe, copybuff, sizeof(copybuff), &rdlen) == 0) && (rdlen > 0))
             {
-                if (fwrite(buff, 1, rdlen, fv) < rdlen)
+                if (fwrite(copybuff, 1, rdlen, fv) < rdlen)
                 {
                     fprintf(stderr, "Error: Unable to write '%d' bytes to file.", rdlen);
                     ret = 1;
@@ -455,6 +653,7 @@ int main(int oargc, char* oargv[])
         {
             FIL fe = { 0 };
             FIL fv = { 0 };
+            DWORD clmt[CLMT_ITEMS];
             UINT rdlen = 0;
             UINT wrlen = 0;
 
@@ -470,6 +669,7 @@ int main(int oargc, char* oargv[])
                 ret = 1;
                 goto exit;
             }
+            enable_fast_seek(&fe, clmt);
             if (f_open(&fv, argv[1], FA_WRITE | FA_CREATE_ALWAYS))
             {
                 fprintf(stderr, "Error: Unable to open file '%s' for writing.", argv[1]);
@@ -478,9 +678,9 @@ int main(int oargc, char* oargv[])
                 goto exit;
             }
 
-            while ((f_read(&fe, buff, sizeof(buff), &rdlen) == 0) && (rdlen > 0))
+            while ((f_read(&fe, copybuff, sizeof(copybuff), &rdlen) == 0) && (rdlen > 0))
             {
-                if (f_write(&fv, buff, rdlen, &wrlen) || wrlen < rdlen)
+                if (f_write(&fv, copybuff, rdlen, &wrlen) || wrlen < rdlen)
                 {
                     fprintf(stderr, "Error: Unable to write '%d' bytes to disk.", wrlen);
                     ret = 1;
@@ -528,6 +728,8 @@ int main(int oargc, char* oargv[])
 
             NEED_PARAMS(0, 1);
 
+            NEED_MOUNT();
+
             // Arg 1: folder path (optional)
 
             if (nargs == 1)
@@ -563,6 +765,14 @@ int main(int oargc, char* oargv[])
         argc -= nargs;
     }
 
+    // Write back the sectors still held in the cache
+    if (disk_ioctl(0, CTRL_SYNC, NULL))
+    {
+        fprintf(stderr, "Error: Unable to write the image file.\n");
+        ret = 1;
+        goto exit;
+    }
+
     ret = 0;
 
 exit:
@@ -0,0 +1,120 @@
+/*
+ * PROJECT:     ReactOS host tools
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Compresses a file into the gzip format understood by FreeLoader
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define Z_SOLO
+#include <zlib.h>
+
+#define CHUNK_SIZE 0x40000
+
+static unsigned char InBuffer[CHUNK_SIZE];
+static unsigned char OutBuffer[CHUNK_SIZE];
+
+static voidpf zalloc(voidpf opaque, uInt items, uInt size)
+{
+    return calloc(items, size);
+}
+
+static void zfree(voidpf opaque, voidpf address)
+{
+    free(address);
+}
+
+static int compressFile(FILE* inFile, FILE* outFile)
+{
+    z_stream stream;
+    size_t inLength, outLength;
+    int flush, ret;
+
+    memset(&stream, 0, sizeof(stream));
+    stream.zalloc = zalloc;
+    stream.zfree = zfree;
+
+    /* windowBits + 16 selects the gzip wrapper, with CRC32 and size trailer */
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+
+    do
+    {
+        inLength = fread(InBuffer, 1, sizeof(InBuffer), inFile);
+        if (ferror(inFile))
+        {
+            deflateEnd(&stream);
+            return -1;
+        }
+        flush = feof(inFile) ? Z_FINISH : Z_NO_FLUSH;
+
+        stream.next_in = InBuffer;
+        stream.avail_in = (uInt)inLength;
+
+        do
+        {
+            stream.next_out = OutBuffer;
+            stream.avail_out = sizeof(OutBuffer);
+
+            ret = deflate(&stream, flush);
+            if (ret == Z_STREAM_ERROR)
+            {
+                deflateEnd(&stream);
+                return -1;
+            }
+
+            outLength = sizeof(OutBuffer) - stream.avail_out;
+            if (fwrite(OutBuffer, 1, outLength, outFile) != outLength)
+            {
+                deflateEnd(&stream);
+                return -1;
+            }
+        } while (stream.avail_out == 0);
+    } while (flush != Z_FINISH);
+
+    deflateEnd(&stream);
+    return (ret == Z_STREAM_END) ? 0 : -1;
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* inFile;
+    FILE* outFile;
+    int ret;
+
+    if (argc != 3)
+    {
+        fprintf(stdout, "Usage: %s infile outfile.gz\n", argv[0]);
+        return -1;
+    }
+
+    inFile = fopen(argv[1], "rb");
+    if (!inFile)
+    {
+        fprintf(stderr, "ERROR: Couldn't open input file '%s'.\n", argv[1]);
+        return -1;
+    }
+    outFile = fopen(argv[2], "wb");
+    if (!outFile)
+    {
+        fclose(inFile);
+        fprintf(stderr, "ERROR: Couldn't create output file '%s'.\n", argv[2]);
+        return -1;
+    }
+
+    ret = compressFile(inFile, outFile);
+    if (ret != 0)
+        fprintf(stderr, "ERROR: Couldn't compress '%s'.\n", argv[1]);
+
+    fclose(outFile);
+    fclose(inFile);
+
+    if (ret != 0)
+        remove(argv[2]);
+
+    return ret;
+}
+
+/* EOF */
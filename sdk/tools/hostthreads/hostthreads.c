@@ -0,0 +1,166 @@
+/*
+ * PROJECT:     ReactOS host tools
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Portable threads and locks for the host tools
+ *
+ * Kept in its own library because windows.h clashes with the headers of
+ * the tools using it.
+ */
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "hostthreads.h"
+
+#define MAX_THREADS 64
+
+struct host_lock
+{
+#if defined(_WIN32)
+    CRITICAL_SECTION cs;
+#else
+    pthread_mutex_t mutex;
+#endif
+};
+
+typedef struct
+{
+    HOST_THREAD_PROC Proc;
+    void *Context;
+    int Index;
+} THREAD_START;
+
+int
+cpu_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (n > 0) ? (int)n : 1;
+#endif
+}
+
+HOST_LOCK *
+lock_create(void)
+{
+    HOST_LOCK *Lock = malloc(sizeof(HOST_LOCK));
+
+    if (!Lock)
+        return NULL;
+#if defined(_WIN32)
+    InitializeCriticalSection(&Lock->cs);
+#else
+    pthread_mutex_init(&Lock->mutex, NULL);
+#endif
+    return Lock;
+}
+
+void
+lock_enter(HOST_LOCK *Lock)
+{
+#if defined(_WIN32)
+    EnterCriticalSection(&Lock->cs);
+#else
+    pthread_mutex_lock(&Lock->mutex);
+#endif
+}
+
+void
+lock_leave(HOST_LOCK *Lock)
+{
+#if defined(_WIN32)
+    LeaveCriticalSection(&Lock->cs);
+#else
+    pthread_mutex_unlock(&Lock->mutex);
+#endif
+}
+
+void
+lock_destroy(HOST_LOCK *Lock)
+{
+    if (!Lock)
+        return;
+#if defined(_WIN32)
+    DeleteCriticalSection(&Lock->cs);
+#else
+    pthread_mutex_destroy(&Lock->mutex);
+#endif
+    free(Lock);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI
+thread_start(LPVOID Param)
+#else
+static void *
+thread_start(void *Param)
+#endif
+{
+    THREAD_START *Start = Param;
+
+    Start->Proc(Start->Context, Start->Index);
+    return 0;
+}
+
+/*
+ * Runs Proc(Context, 0 .. Count-1) concurrently and waits for all of them.
+ * Index 0 runs on the calling thread; if a thread can't be started, its
+ * share of the work is done there as well.
+ */
+int
+run_threads(int Count, HOST_THREAD_PROC Proc, void *Context)
+{
+    THREAD_START Starts[MAX_THREADS];
+#if defined(_WIN32)
+    HANDLE Handles[MAX_THREADS];
+#else
+    pthread_t Handles[MAX_THREADS];
+#endif
+    int Started[MAX_THREADS];
+    int i;
+
+    if (Count > MAX_THREADS)
+        Count = MAX_THREADS;
+
+    for (i = 1; i < Count; i++)
+    {
+        Starts[i].Proc = Proc;
+        Starts[i].Context = Context;
+        Starts[i].Index = i;
+#if defined(_WIN32)
+        Handles[i] = CreateThread(NULL, 0, thread_start, &Starts[i], 0, NULL);
+        Started[i] = (Handles[i] != NULL);
+#else
+        Started[i] = (pthread_create(&Handles[i], NULL, thread_start, &Starts[i]) == 0);
+#endif
+    }
+
+    Proc(Context, 0);
+
+    for (i = 1; i < Count; i++)
+    {
+        if (!Started[i])
+        {
+            Proc(Context, i);
+            continue;
+        }
+#if defined(_WIN32)
+        WaitForSingleObject(Handles[i], INFINITE);
+        CloseHandle(Handles[i]);
+#else
+        pthread_join(Handles[i], NULL);
+#endif
+    }
+    return Count;
+}
@@ -0,0 +1,30 @@
+/*
+ * PROJECT:     ReactOS host tools
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Portable threads and locks for the host tools
+ */
+
+#ifndef __HOSTTHREADS_H
+#define __HOSTTHREADS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_lock HOST_LOCK;
+typedef void (*HOST_THREAD_PROC)(void *Context, int Index);
+
+int cpu_count(void);
+
+HOST_LOCK *lock_create(void);
+void lock_enter(HOST_LOCK *Lock);
+void lock_leave(HOST_LOCK *Lock);
+void lock_destroy(HOST_LOCK *Lock);
+
+int run_threads(int Count, HOST_THREAD_PROC Proc, void *Context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOSTTHREADS_H */
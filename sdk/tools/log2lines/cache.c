@@ -5,9 +5,11 @@
  * - Image directory caching
  */
 
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include "util.h"
 #include "version.h"
@@ -15,6 +17,7 @@
 #include "options.h"
 #include "help.h"
 #include "image.h"
+#include "symidx.h"
 
 #include "log2lines.h"
 
@@ -22,6 +25,8 @@ static char CacheName[PATH_MAX];
 static char *cache_name = CacheName;
 static char TmpName[PATH_MAX];
 static char *tmp_name = TmpName;
+static char IdxName[PATH_MAX];
+static char *idx_name = IdxName;
 
 static int
 unpack_iso(char *dir, char *iso)
@@ -150,6 +155,8 @@ check_directory(int force)
         strcat(cache_name, PATH_STR CACHEFILE);
     strcpy(tmp_name, cache_name);
     strcat(tmp_name, "~");
+    strcpy(idx_name, cache_name);
+    strcpy(idx_name + strlen(idx_name) - strlen(CACHEFILE), SYMIDXFILE);
     return 0;
 }
 
@@ -186,19 +193,63 @@ read_cache(void)
     return result;
 }
 
+static int
+scan_directory(FILE *fw, const char *dir, int skipImageBase)
+{
+    char Line[PATH_MAX];
+    struct dirent *de;
+    struct stat st;
+    size_t ImageBase;
+    DIR *d;
+    int err;
+
+    d = opendir(dir);
+    if (!d)
+    {
+        l2l_dbg(1, "Cannot open directory %s\n", dir);
+        return 1;
+    }
+
+    while ((de = readdir(d)) != NULL)
+    {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        if (snprintf(Line, sizeof(Line), "%s" PATH_STR "%s", dir, de->d_name) >= (int)sizeof(Line))
+        {
+            l2l_dbg(1, "Path too long: %s" PATH_STR "%s\n", dir, de->d_name);
+            continue;
+        }
+        /* Like the find/dir listing this replaces: no following of links */
+        if (LSTAT(Line, &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+            scan_directory(fw, Line, skipImageBase);
+        else if (S_ISREG(st.st_mode) && !skipImageBase)
+        {
+            if ((err = get_ImageBase(Line, &ImageBase)) == 0)
+                fprintf(fw, "%s|%s|%0x\n", de->d_name, Line, (unsigned int)ImageBase);
+            else
+                l2l_dbg(3, "%s|%s|%0x, ERR=%d\n", de->d_name, Line, (unsigned int)ImageBase, err);
+        }
+    }
+
+    closedir(d);
+    return 0;
+}
+
 int
 create_cache(int force, int skipImageBase)
 {
-    FILE *fr, *fw;
-    char Line[LINESIZE + 1], *Fname = NULL;
-    int len, err;
-    size_t ImageBase;
+    FILE *fw;
+    int err;
 
     if ((fw = fopen(tmp_name, "w")) == NULL)
     {
         l2l_dbg(1, "Apparently %s is not writable (mounted ISO?), using current dir\n", tmp_name);
         cache_name = basename(cache_name);
         tmp_name = basename(tmp_name);
+        idx_name = basename(idx_name);
     }
     else
     {
@@ -211,6 +262,7 @@ create_cache(int force, int skipImageBase)
     {
         l2l_dbg(3, "Removing %s ...\n", cache_name);
         remove(cache_name);
+        remove(idx_name);
     }
     else
     {
@@ -221,54 +273,44 @@ create_cache(int force, int skipImageBase)
         }
     }
 
-    Line[LINESIZE] = '\0';
-
     remove(tmp_name);
+    if ((fw = fopen(tmp_name, "w")) == NULL)
+    {
+        l2l_dbg(0, "Cannot create %s\n", tmp_name);
+        return 2;
+    }
     l2l_dbg(0, "Scanning %s ...\n", opt_dir);
-    snprintf(Line, LINESIZE, DIR_FMT, opt_dir, tmp_name);
-    l2l_dbg(1, "Executing: %s\n", Line);
-    if (system(Line) != 0)
+    l2l_dbg(0, "Creating cache ...");
+    err = scan_directory(fw, opt_dir, skipImageBase);
+    if (fclose(fw) != 0)
+        err = 1;
+    if (err)
     {
         l2l_dbg(0, "Cannot list directory %s\n", opt_dir);
-        l2l_dbg(1, "Failed to execute: '%s'\n", Line);
         remove(tmp_name);
         return 2;
     }
-    l2l_dbg(0, "Creating cache ...");
-
-    if ((fr = fopen(tmp_name, "r")) != NULL)
+    remove(cache_name);
+    if (rename(tmp_name, cache_name) != 0)
     {
-        if ((fw = fopen(cache_name, "w")) != NULL)
-        {
-            while (fgets(Line, LINESIZE, fr) != NULL)
-            {
-                len = strlen(Line);
-                if (!len)
-                    continue;
-
-                Fname = Line + len - 1;
-                if (*Fname == '\n')
-                    *Fname = '\0';
-
-                while (Fname > Line && *Fname != PATH_CHAR)
-                    Fname--;
-                if (*Fname == PATH_CHAR)
-                    Fname++;
-                if (*Fname && !skipImageBase)
-                {
-                    if ((err = get_ImageBase(Line, &ImageBase)) == 0)
-                        fprintf(fw, "%s|%s|%0x\n", Fname, Line, (unsigned int)ImageBase);
-                    else
-                        l2l_dbg(3, "%s|%s|%0x, ERR=%d\n", Fname, Line, (unsigned int)ImageBase, err);
-                }
-            }
-            fclose(fw);
-        }
-        l2l_dbg(0, "... done\n");
-        fclose(fr);
+        l2l_dbg(0, "Cannot rename %s to %s\n", tmp_name, cache_name);
+        remove(tmp_name);
+        return 2;
     }
-    remove(tmp_name);
+    l2l_dbg(0, "... done\n");
     return 0;
 }
 
+int
+read_index(void)
+{
+    return symidx_open(idx_name);
+}
+
+int
+close_index(void)
+{
+    return symidx_close(idx_name);
+}
+
 /* EOF */
@@ -11,5 +11,7 @@ int check_directory(int force);
 int read_cache(void);
 int create_cache(int force, int skipImageBase);
 int cleanable(char *path);
+int read_index(void);
+int close_index(void);
 
 /* EOF */
@@ -8,6 +8,7 @@
 #define DEF_OPT_DIR     "output-i386"
 #define SOURCES_ENV     "_ROSBE_ROSSOURCEDIR"
 #define CACHEFILE       "log2lines.cache"
+#define SYMIDXFILE      "log2lines.symidx"
 #define TRKBUILDPREFIX  "bootcd-"
 #define SVN_PREFIX      "/trunk/reactos/"
 #define PIPEREAD_CMD    "piperead -c"
@@ -29,5 +30,6 @@ PATH_STR "reactos" PATH_STR "reactos > " DEV_NULL
 
 #define LINESIZE        1024
 #define NAMESIZE        80
+#define BATCH_LINES     1024    // Lines looked up at once with -j
 
 /* EOF */
@@ -29,7 +29,10 @@ char *verboseUsage =
 "  - The offset of a relocated image MUST be relative.\n\n"
 "  log2lines uses a cache in order to avoid a directory scan at each\n"
 "  image lookup, greatly increasing performance. Only image path and its\n"
-"  base address are cached.\n\n"
+"  base address are cached.\n"
+"  The symbol info of each image is also kept in a symbol index ("SYMIDXFILE")\n"
+"  next to the cache. It is mapped by later runs, so images are only read\n"
+"  again when they changed (timestamp, size or checksum).\n\n"
 "Options:\n"
 "  -b   Use this combined with '-l'. Enable buffering on logFile.\n"
 "       This may solve loosing output on real hardware (ymmv).\n\n"
@@ -46,9 +49,15 @@ char *verboseUsage =
 "       - Combined with -f the file will be re-unpacked.\n"
 "       - NOTE: this ISO unpack feature needs 7z to be in the PATH.\n"
 "       Default: " DEF_OPT_DIR "\n\n"
-"  -f   Force creating new cache.\n\n"
+"  -f   Force creating new cache and symbol index.\n\n"
 "  -F   As -f but exits immediately after creating cache.\n\n"
 "  -h   This text.\n\n"
+"  -j <threads>\n"
+"       Number of threads looking up addresses when reading a log file\n"
+"       line by line, 0 for the number of processors. Lines are read in\n"
+"       batches, so this is only done when the input is a regular file,\n"
+"       never for pipes. Output stays in input order. Not used with -c.\n"
+"       Default: 1\n\n"
 "  -l <logFile>\n"
 "       <logFile>: Append copy to specified logFile.\n"
 "       Default: no logFile\n\n"
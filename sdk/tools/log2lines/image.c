@@ -12,6 +12,7 @@
 #include "compat.h"
 #include "util.h"
 #include "options.h"
+#include "image.h"
 #include "log2lines.h"
 
 static PIMAGE_SECTION_HEADER
@@ -34,25 +35,25 @@ fixup_offset(size_t ImageBase, size_t offset)
     return offset;
 }
 
+/* Entries are sorted by address: return the last one at or below offset.
+ * Offsets past the last entry don't belong to any known function.
+ */
 PROSSYM_ENTRY
-find_offset(void *data, size_t offset)
+find_offset(PROSSYM_ENTRY Entries, size_t Count, size_t offset)
 {
-    PSYMBOLFILE_HEADER RosSymHeader = (PSYMBOLFILE_HEADER)data;
-    PROSSYM_ENTRY Entries = (PROSSYM_ENTRY)((char *)data + RosSymHeader->SymbolsOffset);
-    size_t symbols = RosSymHeader->SymbolsLength / sizeof(ROSSYM_ENTRY);
-    size_t i;
+    size_t lo = 0, hi = Count, mid;
 
-    for (i = 0; i < symbols; i++)
+    while (lo < hi)
     {
-        if (Entries[i].Address > offset)
-        {
-            if (!i--)
-                return NULL;
-            else
-                return &Entries[i];
-        }
+        mid = lo + (hi - lo) / 2;
+        if (Entries[mid].Address > offset)
+            hi = mid;
+        else
+            lo = mid + 1;
     }
-    return NULL;
+    if (lo == 0 || lo == Count)
+        return NULL;
+    return &Entries[lo - 1];
 }
 
 PIMAGE_SECTION_HEADER
@@ -97,6 +98,47 @@ get_sectionheader(const void *FileData)
     return PERosSymSectionHeader;
 }
 
+int
+get_rossym(const void *FileData, size_t FileSize, PROSSYM_SECTION Section)
+{
+    PIMAGE_DOS_HEADER PEDosHeader = (PIMAGE_DOS_HEADER)FileData;
+    PIMAGE_FILE_HEADER PEFileHeader;
+    PIMAGE_SECTION_HEADER PERosSymSectionHeader;
+    size_t HeadersEnd, Start;
+
+    /* Make sure get_sectionheader() stays within the file */
+    if (FileSize < sizeof(IMAGE_DOS_HEADER) ||
+        (size_t)PEDosHeader->e_lfanew > FileSize - sizeof(ULONG) - sizeof(IMAGE_FILE_HEADER))
+    {
+        l2l_dbg(0, "Input file is not a PE image.\n");
+        summ.offset_errors++;
+        return 1;
+    }
+    PEFileHeader = (PIMAGE_FILE_HEADER)((char *)FileData + PEDosHeader->e_lfanew + sizeof(ULONG));
+    HeadersEnd = PEDosHeader->e_lfanew + sizeof(ULONG) + sizeof(IMAGE_FILE_HEADER) +
+                 PEFileHeader->SizeOfOptionalHeader +
+                 PEFileHeader->NumberOfSections * sizeof(IMAGE_SECTION_HEADER);
+    if (HeadersEnd > FileSize)
+    {
+        l2l_dbg(0, "Truncated PE headers\n");
+        summ.offset_errors++;
+        return 1;
+    }
+
+    PERosSymSectionHeader = get_sectionheader(FileData);
+    if (!PERosSymSectionHeader)
+        return 2;
+
+    Start = PERosSymSectionHeader->PointerToRawData;
+    if (Start > FileSize || rossym_open((char *)FileData + Start, FileSize - Start, Section))
+    {
+        l2l_dbg(0, "Invalid rossym section\n");
+        summ.offset_errors++;
+        return 2;
+    }
+    return 0;
+}
+
 int
 get_ImageBase(char *fname, size_t *ImageBase)
 {
@@ -165,4 +207,42 @@ get_ImageBase(char *fname, size_t *ImageBase)
     return 0;
 }
 
+int
+get_ImageKey(char *fname, PIMAGE_KEY Key)
+{
+    IMAGE_DOS_HEADER PEDosHeader;
+    IMAGE_FILE_HEADER PEFileHeader;
+    IMAGE_OPTIONAL_HEADER PEOptHeader;
+    FILE *fr;
+    long FileSize;
+
+    memset(Key, 0, sizeof(IMAGE_KEY));
+    fr = fopen(fname, "rb");
+    if (!fr)
+    {
+        l2l_dbg(3, "get_ImageKey, cannot open '%s' (%s)\n", fname, strerror(errno));
+        return 1;
+    }
+
+    /* SizeOfImage and CheckSum are at the same place in PE32 and PE32+ headers */
+    if (fread(&PEDosHeader, sizeof(IMAGE_DOS_HEADER), 1, fr) != 1 ||
+        PEDosHeader.e_magic != IMAGE_DOS_MAGIC || PEDosHeader.e_lfanew == 0L ||
+        fseek(fr, PEDosHeader.e_lfanew + sizeof(ULONG), SEEK_SET) != 0 ||
+        fread(&PEFileHeader, sizeof(IMAGE_FILE_HEADER), 1, fr) != 1 ||
+        fread(&PEOptHeader, sizeof(IMAGE_OPTIONAL_HEADER), 1, fr) != 1 ||
+        fseek(fr, 0L, SEEK_END) != 0 || (FileSize = ftell(fr)) < 0)
+    {
+        l2l_dbg(2, "get_ImageKey %s, not a valid PE image\n", fname);
+        fclose(fr);
+        return 2;
+    }
+
+    Key->TimeDateStamp = PEFileHeader.TimeDateStamp;
+    Key->SizeOfImage = PEOptHeader.SizeOfImage;
+    Key->CheckSum = PEOptHeader.CheckSum;
+    Key->FileSize = (ULONG)FileSize;
+    fclose(fr);
+    return 0;
+}
+
 /* EOF */
@@ -9,12 +9,25 @@
 
 #include <rsym.h>
 
+/* Identifies one build of an image in the symbol index */
+typedef struct image_key_struct
+{
+    ULONG TimeDateStamp;
+    ULONG SizeOfImage;
+    ULONG CheckSum;
+    ULONG FileSize;
+} IMAGE_KEY, *PIMAGE_KEY;
+
 size_t fixup_offset(size_t ImageBase, size_t offset);
 
-PROSSYM_ENTRY find_offset(void *data, size_t offset);
+PROSSYM_ENTRY find_offset(PROSSYM_ENTRY Entries, size_t Count, size_t offset);
+
+int get_rossym(const void *FileData, size_t FileSize, PROSSYM_SECTION Section);
 
 PIMAGE_SECTION_HEADER get_sectionheader(const void *FileData);
 
 int get_ImageBase(char *fname, size_t *ImageBase);
 
+int get_ImageKey(char *fname, PIMAGE_KEY Key);
+
 /* EOF */
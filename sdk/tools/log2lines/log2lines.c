@@ -20,7 +20,37 @@
 #include "help.h"
 #include "cmd.h"
 #include "match.h"
+#include "hostthreads.h"
+#include "osdep.h"
+#include "symidx.h"
 
+typedef struct translation_struct
+{
+    PSYMIMAGE image;
+    size_t offset;
+    PROSSYM_ENTRY e;
+    PROSSYM_ENTRY e2;
+    int diff;
+    int majordiff;
+    int res;
+    char text[LINESIZE];
+} TRANSLATION, *PTRANSLATION;
+
+typedef struct batch_line_struct
+{
+    char Line[LINESIZE + 1];
+    char path[LINESIZE + 1];
+    size_t offset;
+    int parsed;
+    TRANSLATION Translation;
+} BATCH_LINE, *PBATCH_LINE;
+
+typedef struct batch_struct
+{
+    PBATCH_LINE Lines;
+    int Count;
+    int Threads;
+} BATCH, *PBATCH;
 
 static FILE *dbgIn          = NULL;
 static FILE *dbgOut         = NULL;
@@ -35,6 +65,7 @@ FILE *logFile        = NULL;
 LIST cache;
 SUMM summ;
 
+static PBATCH_LINE pending  = NULL;
 
 static void
 clearLastLine(void)
@@ -103,26 +134,29 @@ report(FILE *outFile)
 }
 
 
-static int
-print_offset(void *data, size_t offset, char *toString)
+/* Looking up an offset has no side effects, so it can run on any thread.
+ * Statistics and source info are updated by commit_translation(), in
+ * input order.
+ */
+static void
+resolve_offset(PSYMIMAGE image, size_t offset, PTRANSLATION t)
 {
-    PSYMBOLFILE_HEADER RosSymHeader = (PSYMBOLFILE_HEADER)data;
     PROSSYM_ENTRY e = NULL;
     PROSSYM_ENTRY e2 = NULL;
     int bFileOffsetChanged = 0;
     char fmt[LINESIZE];
-    char *Strings = (char *)data + RosSymHeader->StringsOffset;
 
     fmt[0] = '\0';
-    e = find_offset(data, offset);
+    t->diff = t->majordiff = 0;
+    e = symidx_find(image, offset);
     if (opt_twice)
     {
-        e2 = find_offset(data, offset - 1);
+        e2 = symidx_find(image, offset - 1);
 
         if (e == e2)
             e2 = NULL;
         else
-            summ.diff++;
+            t->diff = 1;
 
         if (opt_Twice && e2)
         {
@@ -131,173 +165,144 @@ print_offset(void *data, size_t offset, char *toString)
             /* replaced (transparantly), but updated stats */
         }
     }
-    if (e || e2)
+    if (!e)
     {
-        strcpy(lastLine.file1, &Strings[e->FileOffset]);
-        strcpy(lastLine.func1, &Strings[e->FunctionOffset]);
-        lastLine.nr1 = e->SourceLine;
-        sources_entry_create(&sources, lastLine.file1, SVN_PREFIX);
-        lastLine.valid = 1;
-        if (e2)
-        {
-            strcpy(lastLine.file2, &Strings[e2->FileOffset]);
-            strcpy(lastLine.func2, &Strings[e2->FunctionOffset]);
-            lastLine.nr2 = e2->SourceLine;
-            sources_entry_create(&sources, lastLine.file2, SVN_PREFIX);
-            bFileOffsetChanged = e->FileOffset != e2->FileOffset;
-            if (e->FileOffset != e2->FileOffset || e->FunctionOffset != e2->FunctionOffset)
-                summ.majordiff++;
-
-            /*
-             * - "%.0s" displays nothing, but processes argument
-             * - bFileOffsetChanged implies always display 2nd SourceLine even if the same
-             * - also for FunctionOffset
-             */
-            strcat(fmt, "%s");
-            if (bFileOffsetChanged)
-                strcat(fmt, "[%s]");
-            else
-                strcat(fmt, "%.0s");
-
-            strcat(fmt, ":%u");
-            if (e->SourceLine != e2->SourceLine || bFileOffsetChanged)
-                strcat(fmt, "[%u]");
-            else
-                strcat(fmt, "%.0u");
+        e = e2;
+        e2 = NULL;
+    }
+    t->e = e;
+    t->e2 = e2;
 
-            strcat(fmt, " (%s");
-            if (e->FunctionOffset != e2->FunctionOffset || bFileOffsetChanged)
-                strcat(fmt, "[%s])");
-            else
-                strcat(fmt, "%.0s)");
-
-            if (toString)
-            {   // put in toString if provided
-                snprintf(toString, LINESIZE, fmt,
-                    &Strings[e->FileOffset],
-                    &Strings[e2->FileOffset],
-                    (unsigned int)e->SourceLine,
-                    (unsigned int)e2->SourceLine,
-                    &Strings[e->FunctionOffset],
-                    &Strings[e2->FunctionOffset]);
-            }
-            else
-            {
-                strcat(fmt, "\n");
-                printf(fmt,
-                    &Strings[e->FileOffset],
-                    &Strings[e2->FileOffset],
-                    (unsigned int)e->SourceLine,
-                    (unsigned int)e2->SourceLine,
-                    &Strings[e->FunctionOffset],
-                    &Strings[e2->FunctionOffset]);
-            }
-        }
-        else
-        {
-            if (toString)
-            {   // put in toString if provided
-                snprintf(toString, LINESIZE, "%s:%u (%s)",
-                    &Strings[e->FileOffset],
-                    (unsigned int)e->SourceLine,
-                    &Strings[e->FunctionOffset]);
-            }
-            else
-            {
-                printf("%s:%u (%s)\n",
-                    &Strings[e->FileOffset],
-                    (unsigned int)e->SourceLine,
-                    &Strings[e->FunctionOffset]);
-            }
-        }
-        return 0;
+    if (!e)
+    {
+        t->res = 1;
+        sprintf(t->text, "??:0");
+        return;
     }
-    return 1;
-}
 
-static int
-process_data(const void *FileData, size_t offset, char *toString)
-{
-    int res;
+    t->res = 0;
+    if (e2)
+    {
+        bFileOffsetChanged = e->FileOffset != e2->FileOffset;
+        if (e->FileOffset != e2->FileOffset || e->FunctionOffset != e2->FunctionOffset)
+            t->majordiff = 1;
+
+        /*
+         * - "%.0s" displays nothing, but processes argument
+         * - bFileOffsetChanged implies always display 2nd SourceLine even if the same
+         * - also for FunctionOffset
+         */
+        strcat(fmt, "%s");
+        if (bFileOffsetChanged)
+            strcat(fmt, "[%s]");
+        else
+            strcat(fmt, "%.0s");
 
-    PIMAGE_SECTION_HEADER PERosSymSectionHeader = get_sectionheader((char *)FileData);
-    if (!PERosSymSectionHeader)
-        return 2;
+        strcat(fmt, ":%u");
+        if (e->SourceLine != e2->SourceLine || bFileOffsetChanged)
+            strcat(fmt, "[%u]");
+        else
+            strcat(fmt, "%.0u");
 
-    res = print_offset((char *)FileData + PERosSymSectionHeader->PointerToRawData, offset, toString);
-    if (res)
-    {
-        if (toString)
-            sprintf(toString, "??:0");
+        strcat(fmt, " (%s");
+        if (e->FunctionOffset != e2->FunctionOffset || bFileOffsetChanged)
+            strcat(fmt, "[%s])");
         else
-            printf("??:0");
-        l2l_dbg(1, "Offset not found: %x\n", (unsigned int)offset);
-        summ.offset_errors++;
+            strcat(fmt, "%.0s)");
+
+        snprintf(t->text, LINESIZE, fmt,
+            symidx_string(image, e->FileOffset),
+            symidx_string(image, e2->FileOffset),
+            (unsigned int)e->SourceLine,
+            (unsigned int)e2->SourceLine,
+            symidx_string(image, e->FunctionOffset),
+            symidx_string(image, e2->FunctionOffset));
     }
+    else
+    {
+        snprintf(t->text, LINESIZE, "%s:%u (%s)",
+            symidx_string(image, e->FileOffset),
+            (unsigned int)e->SourceLine,
+            symidx_string(image, e->FunctionOffset));
+    }
+}
 
-    return res;
+static void
+translate_offset(const char *cpath, size_t offset, PTRANSLATION t)
+{
+    PSYMIMAGE image;
+
+    t->offset = offset;
+    t->image = image = symidx_image(cpath);
+    if (!image)
+        t->res = 1;
+    else if (image->res)
+        t->res = image->res;
+    else
+        resolve_offset(image, offset, t);
 }
 
-static int
-process_file(const char *file_name, size_t offset, char *toString)
+static void
+commit_translation(PTRANSLATION t)
 {
-    void *FileData;
-    size_t FileSize;
-    int res = 1;
+    PSYMIMAGE image = t->image;
 
-    FileData = load_file(file_name, &FileSize);
-    if (!FileData)
+    if (!image)
+        return;
+    if (image->res)
     {
-        l2l_dbg(0, "An error occured loading '%s'\n", file_name);
+        summ.offset_errors += image->errors;
+        return;
     }
-    else
+
+    if (t->diff)
+        summ.diff++;
+    if (t->res)
     {
-        res = process_data(FileData, offset, toString);
-        free(FileData);
+        l2l_dbg(1, "Offset not found: %x\n", (unsigned int)t->offset);
+        summ.offset_errors++;
+        return;
+    }
+
+    snprintf(lastLine.file1, LINESIZE, "%s", symidx_string(image, t->e->FileOffset));
+    snprintf(lastLine.func1, NAMESIZE, "%s", symidx_string(image, t->e->FunctionOffset));
+    lastLine.nr1 = t->e->SourceLine;
+    sources_entry_create(&sources, lastLine.file1, SVN_PREFIX);
+    lastLine.valid = 1;
+    if (t->e2)
+    {
+        snprintf(lastLine.file2, LINESIZE, "%s", symidx_string(image, t->e2->FileOffset));
+        snprintf(lastLine.func2, NAMESIZE, "%s", symidx_string(image, t->e2->FunctionOffset));
+        lastLine.nr2 = t->e2->SourceLine;
+        sources_entry_create(&sources, lastLine.file2, SVN_PREFIX);
+        if (t->majordiff)
+            summ.majordiff++;
     }
-    return res;
 }
 
 static int
 translate_file(const char *cpath, size_t offset, char *toString)
 {
-    size_t base = 0;
-    LIST_MEMBER *pentry = NULL;
-    int res = 0;
-    char *path, *dpath;
-
-    dpath = path = convert_path(cpath);
-    if (!path)
-        return 1;
+    TRANSLATION Translation;
+    PTRANSLATION t = NULL;
 
-    // The path could be absolute:
-    if (get_ImageBase(path, &base))
+    /* Use what a batch thread already looked up for this line */
+    if (pending && pending->parsed && pending->offset == offset &&
+        strcmp(pending->path, cpath) == 0)
     {
-        pentry = entry_lookup(&cache, path);
-        if (pentry)
-        {
-            path = pentry->path;
-            base = pentry->ImageBase;
-            if (base == INVALID_BASE)
-            {
-                l2l_dbg(1, "No, or invalid base address: %s\n", path);
-                res = 2;
-            }
-        }
-        else
-        {
-            l2l_dbg(1, "Not found in cache: %s\n", path);
-            res = 3;
-        }
+        t = &pending->Translation;
+        pending->parsed = 0;
     }
-
-    if (!res)
+    if (!t)
     {
-        res = process_file(path, offset, toString);
+        t = &Translation;
+        translate_offset(cpath, offset, t);
     }
 
-    free(dpath);
-    return res;
+    commit_translation(t);
+    if (!t->res)
+        strcpy(toString, t->text);
+    return t->res;
 }
 
 static void
@@ -405,6 +410,90 @@ translate_line(FILE *outFile, char *Line, char *path, char *LineOut)
     memset(Line, '\0', LINESIZE);  // flushed
 }
 
+/* Same parsing as translate_line(), on a copy of the line */
+static void
+prepare_line(PBATCH_LINE pline)
+{
+    char Line[LINESIZE + 1];
+    unsigned int offset;
+    char *sep, *s;
+    unsigned char ch;
+
+    pline->parsed = 0;
+    strcpy(Line, pline->Line);
+    s = remove_mark(Line);
+    sep = strchr(s, ':');
+    if (!sep)
+        return;
+    *sep = ' ';
+    if (sscanf(s, "<%s %x%c", pline->path, &offset, &ch) != 3 || (ch != '>' && ch != ' '))
+        return;
+
+    pline->offset = offset;
+    translate_offset(pline->path, offset, &pline->Translation);
+    pline->parsed = 1;
+}
+
+static void
+prepare_batch(void *Context, int Index)
+{
+    PBATCH Batch = Context;
+    int i = Batch->Count * Index / Batch->Threads;
+    int last = Batch->Count * (Index + 1) / Batch->Threads;
+
+    for (; i < last; i++)
+        prepare_line(&Batch->Lines[i]);
+}
+
+/* Reads BATCH_LINES at a time, looks them up on opt_threads threads and
+ * then writes them out in order, as translate_files() would. Only used
+ * for regular files: on a pipe a partial batch would wait for more input.
+ */
+static int
+translate_batches(FILE *inFile, FILE *outFile)
+{
+    char path[LINESIZE + 1];
+    char LineOut[LINESIZE + 1];
+    BATCH Batch;
+    int i;
+
+    Batch.Lines = malloc(BATCH_LINES * sizeof(BATCH_LINE));
+    if (!Batch.Lines)
+    {
+        l2l_dbg(0, "Cannot allocate translation batch\n");
+        return 1;
+    }
+
+    do
+    {
+        Batch.Count = 0;
+        while (Batch.Count < BATCH_LINES && !opt_quit)
+        {
+            memset(Batch.Lines[Batch.Count].Line, '\0', LINESIZE + 1);
+            if (!fgets(Batch.Lines[Batch.Count].Line, LINESIZE, inFile))
+                break;
+            Batch.Count++;
+        }
+
+        Batch.Threads = (Batch.Count < opt_threads) ? Batch.Count : opt_threads;
+        if (Batch.Threads)
+            run_threads(Batch.Threads, prepare_batch, &Batch);
+
+        for (i = 0; i < Batch.Count; i++)
+        {
+            if (opt_quit)break;
+
+            pending = &Batch.Lines[i];
+            translate_line(outFile, Batch.Lines[i].Line, path, LineOut);
+            report(outFile);
+        }
+        pending = NULL;
+    } while (Batch.Count == BATCH_LINES && !opt_quit);
+
+    free(Batch.Lines);
+    return 0;
+}
+
 static int
 translate_files(FILE *inFile, FILE *outFile)
 {
@@ -517,6 +606,10 @@ translate_files(FILE *inFile, FILE *outFile)
                 translate_char(c, outFile);
         }
     }
+    else if (opt_threads > 1 && !opt_raw && is_regular_file(inFile))
+    {   // Line by line, looked up in batches by several threads
+        translate_batches(inFile, outFile);
+    }
     else
     {   // Line by line, slightly faster but less interactive
         while (fgets(Line, LINESIZE, inFile) != NULL)
@@ -587,6 +680,13 @@ main(int argc, const char **argv)
     read_cache();
     l2l_dbg(4, "Cache read complete\n");
 
+    if (read_index())
+    {
+        res = 4;
+        goto cleanup;
+    }
+    l2l_dbg(4, "Symbol index read complete\n");
+
     if (set_LogFile(&logFile))
     {
         res = 2;
@@ -664,6 +764,7 @@ cleanup:
         opt_Pipe = NULL;
     }
 
+    close_index();
     list_clear(&sources);
     list_clear(&cache);
 
@@ -16,10 +16,12 @@
 #include "help.h"
 #include "log2lines.h"
 #include "options.h"
+#include "hostthreads.h"
 
-char *optchars       = "bcd:fFhl:L:mMP:rsS:tTuUvz:";
+char *optchars       = "bcd:fFhj:l:L:mMP:rsS:tTuUvz:";
 int   opt_buffered   = 0;        // -b
 int   opt_help       = 0;        // -h
+int   opt_threads    = 1;        // -j <opt_threads>
 int   opt_force      = 0;        // -f
 int   opt_exit       = 0;        // -e
 int   opt_verbose    = 0;        // -v
@@ -141,6 +143,10 @@ int optionParse(int argc, const char **argv)
             opt_exit++;
             opt_force++;
             break;
+        case 'j':
+            optCount++;
+            opt_threads = atoi(optarg);
+            break;
         case 'l':
             optCount++;
             //just count, see optionInit()
@@ -207,6 +213,10 @@ int optionParse(int argc, const char **argv)
         l2l_dbg(2, "Note: use 's' command in console mode. Statistics option disabled\n");
         opt_stats = 0;
     }
+    if (opt_threads == 0)
+        opt_threads = cpu_count();
+    else if (opt_threads < 0)
+        opt_threads = 1;
     if (opt_SourcesPath[0])
     {
         strcat(opt_SourcesPath, PATH_STR);
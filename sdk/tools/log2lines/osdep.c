@@ -0,0 +1,97 @@
+/*
+ * ReactOS log2lines
+ *
+ * - Host OS helpers: file type and file mapping
+ *
+ * Kept apart from the other modules because windows.h clashes
+ * with the PE definitions pulled in through rsym.h.
+ */
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "osdep.h"
+
+/* False for pipes and consoles, which may not have more input yet */
+int
+is_regular_file(FILE *f)
+{
+#if defined(_WIN32)
+    return GetFileType((HANDLE)_get_osfhandle(_fileno(f))) == FILE_TYPE_DISK;
+#else
+    struct stat st;
+
+    return fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode);
+#endif
+}
+
+void *
+map_file(const char *name, size_t *size)
+{
+#if defined(_WIN32)
+    HANDLE File, Mapping;
+    LARGE_INTEGER FileSize;
+    void *View = NULL;
+
+    File = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (File == INVALID_HANDLE_VALUE)
+        return NULL;
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0 &&
+        (ULONGLONG)FileSize.QuadPart <= (SIZE_T)-1)
+    {
+        Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (Mapping)
+        {
+            View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(Mapping);
+            *size = (size_t)FileSize.QuadPart;
+        }
+    }
+    CloseHandle(File);
+    return View;
+#else
+    struct stat st;
+    void *View;
+    int fd;
+
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    View = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (View == MAP_FAILED)
+        return NULL;
+    *size = (size_t)st.st_size;
+    return View;
+#endif
+}
+
+void
+unmap_file(void *view, size_t size)
+{
+    if (!view)
+        return;
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(view);
+#else
+    munmap(view, size);
+#endif
+}
+
+/* EOF */
@@ -0,0 +1,17 @@
+/*
+ * ReactOS log2lines
+ *
+ * - Host OS helpers: file type and file mapping
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+int is_regular_file(FILE *f);
+
+void *map_file(const char *name, size_t *size);
+void unmap_file(void *view, size_t size);
+
+/* EOF */
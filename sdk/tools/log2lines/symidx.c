@@ -0,0 +1,614 @@
+/*
+ * ReactOS log2lines
+ *
+ * - Persistent address to symbol index
+ *
+ * The rossym data of each image is loaded only once per run and kept
+ * sorted by address for binary search. Images are also stored in an
+ * index file next to the cache, keyed by file name and PE identity
+ * (timestamp, size of image, checksum and file size), which later runs
+ * map into memory instead of loading and parsing the images again.
+ * Only the last few builds of each image are kept in the index file.
+ *
+ * Lookups may come from several translation threads at once.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "compat.h"
+#include "util.h"
+#include "options.h"
+#include "hostthreads.h"
+#include "osdep.h"
+#include "symidx.h"
+#include "log2lines.h"
+
+#define SYMIDX_MAGIC    0x58324C4C  // "LL2X"
+#define SYMIDX_VERSION  1
+#define SYMIDX_BUCKETS  1024
+#define SYMIDX_BUILDS   4           // builds kept per file name, besides the ones used
+
+typedef struct symidx_header_struct
+{
+    ULONG Magic;
+    ULONG Version;
+    ULONG EntrySize;
+    ULONG ImageCount;
+} SYMIDX_HEADER, *PSYMIDX_HEADER;
+
+/* Records are sorted by name, all offsets are from the start of the file */
+typedef struct symidx_record_struct
+{
+    ULONG NameOffset;
+    IMAGE_KEY Key;
+    ULONG EntriesOffset;
+    ULONG EntryCount;
+    ULONG StringsOffset;
+    ULONG StringsLength;
+} SYMIDX_RECORD, *PSYMIDX_RECORD;
+
+static HOST_LOCK *Lock;
+static PSYMIMAGE Buckets[SYMIDX_BUCKETS];
+static PSYMIMAGE Built;         // images not found in the index file
+static int BuiltCount;
+static char *IdxView;
+static size_t IdxSize;
+static PSYMIDX_RECORD IdxRecords;
+static ULONG IdxCount;
+static char *IdxUsed;           // records looked up in this run
+
+static unsigned int
+hash_name(const char *name)
+{
+    unsigned int h = 2166136261u;
+
+    while (*name)
+        h = (h ^ (unsigned char)tolower((unsigned char)*name++)) * 16777619u;
+    return h % SYMIDX_BUCKETS;
+}
+
+static int
+check_range(ULONG Offset, size_t Length, size_t Align)
+{
+    return (Offset % Align) == 0 && Offset <= IdxSize && Length <= IdxSize - Offset;
+}
+
+static int
+check_index(void)
+{
+    PSYMIDX_HEADER Header = (PSYMIDX_HEADER)IdxView;
+    PSYMIDX_RECORD Record;
+    ULONG i;
+
+    if (IdxSize < sizeof(SYMIDX_HEADER) ||
+        Header->Magic != SYMIDX_MAGIC ||
+        Header->Version != SYMIDX_VERSION ||
+        Header->EntrySize != sizeof(ROSSYM_ENTRY) ||
+        Header->ImageCount > (IdxSize - sizeof(SYMIDX_HEADER)) / sizeof(SYMIDX_RECORD))
+        return 0;
+
+    Record = (PSYMIDX_RECORD)(Header + 1);
+    for (i = 0; i < Header->ImageCount; i++, Record++)
+    {
+        if (!check_range(Record->NameOffset, 1, 1) ||
+            !memchr(IdxView + Record->NameOffset, '\0', IdxSize - Record->NameOffset) ||
+            !check_range(Record->EntriesOffset, (size_t)Record->EntryCount * sizeof(ROSSYM_ENTRY), 8) ||
+            !check_range(Record->StringsOffset, Record->StringsLength, 1) ||
+            Record->StringsLength == 0 ||
+            IdxView[Record->StringsOffset + Record->StringsLength - 1] != '\0')
+            return 0;
+    }
+
+    IdxRecords = (PSYMIDX_RECORD)(Header + 1);
+    IdxCount = Header->ImageCount;
+    return 1;
+}
+
+int
+symidx_open(const char *IndexName)
+{
+    Lock = lock_create();
+    if (!Lock)
+        return 1;
+
+    IdxView = map_file(IndexName, &IdxSize);
+    if (!IdxView)
+    {
+        l2l_dbg(1, "No symbol index %s\n", IndexName);
+        return 0;
+    }
+    if (!check_index())
+    {
+        l2l_dbg(0, "Ignoring invalid or outdated symbol index %s\n", IndexName);
+        unmap_file(IdxView, IdxSize);
+        IdxView = NULL;
+        IdxSize = 0;
+        return 0;
+    }
+    IdxUsed = calloc(IdxCount + 1, 1);
+    l2l_dbg(1, "Mapped symbol index %s, %u images\n", IndexName, (unsigned int)IdxCount);
+    return 0;
+}
+
+static int
+find_in_index(PSYMIMAGE image)
+{
+    ULONG lo = 0, hi = IdxCount, mid;
+    PSYMIDX_RECORD Record;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (PATHCMP(IdxView + IdxRecords[mid].NameOffset, image->file) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < IdxCount; lo++)
+    {
+        Record = &IdxRecords[lo];
+        if (PATHCMP(IdxView + Record->NameOffset, image->file) != 0)
+            break;
+        if (memcmp(&Record->Key, &image->Key, sizeof(IMAGE_KEY)) == 0)
+        {
+            image->Entries = (PROSSYM_ENTRY)(IdxView + Record->EntriesOffset);
+            image->EntryCount = Record->EntryCount;
+            image->Strings = IdxView + Record->StringsOffset;
+            image->StringsLength = Record->StringsLength;
+            if (IdxUsed)
+                IdxUsed[lo] = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+find_built(PSYMIMAGE image)
+{
+    PSYMIMAGE p;
+
+    for (p = Built; p; p = p->pnext)
+    {
+        if (PATHCMP(p->file, image->file) == 0 &&
+            memcmp(&p->Key, &image->Key, sizeof(IMAGE_KEY)) == 0)
+        {
+            image->Entries = p->Entries;
+            image->EntryCount = p->EntryCount;
+            image->Strings = p->Strings;
+            image->StringsLength = p->StringsLength;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    const ROSSYM_ENTRY *e1 = a, *e2 = b;
+
+    if (e1->Address != e2->Address)
+        return (e1->Address < e2->Address) ? -1 : 1;
+    return 0;
+}
+
+static int
+build_image(PSYMIMAGE image, const char *path)
+{
+    PSYMIMAGE copy;
+    ROSSYM_SECTION Section;
+    ULONG Count, StringsLength, i;
+    size_t FileSize, EntriesSize;
+    void *FileData;
+    int res;
+
+    FileData = load_file(path, &FileSize);
+    if (!FileData)
+    {
+        l2l_dbg(0, "An error occured loading '%s'\n", path);
+        return 1;
+    }
+
+    res = get_rossym(FileData, FileSize, &Section);
+    if (res)
+    {
+        free(FileData);
+        return res;
+    }
+    Count = Section.Count;
+    StringsLength = Section.StringsLength;
+
+    /* Entries first, then the strings with a terminator in case it's missing */
+    EntriesSize = (size_t)Count * sizeof(ROSSYM_ENTRY);
+    copy = malloc(sizeof(SYMIMAGE));
+    image->Data = malloc(EntriesSize + StringsLength + 1);
+    if (!copy || !image->Data)
+    {
+        free(copy);
+        free(image->Data);
+        image->Data = NULL;
+        free(FileData);
+        return 1;
+    }
+
+    image->Entries = image->Data;
+    image->EntryCount = Count;
+    image->Strings = (char *)image->Data + EntriesSize;
+    image->StringsLength = StringsLength + 1;
+    res = rossym_read(&Section, image->Entries);
+    memcpy(image->Strings, Section.Strings, StringsLength);
+    image->Strings[StringsLength] = '\0';
+    free(FileData);
+    if (res)
+    {
+        l2l_dbg(0, "Invalid rossym data in %s\n", path);
+        summ.offset_errors++;
+        free(copy);
+        free(image->Data);
+        image->Data = NULL;
+        return 2;
+    }
+
+    for (i = 1; i < Count; i++)
+    {
+        if (image->Entries[i].Address < image->Entries[i - 1].Address)
+        {
+            l2l_dbg(1, "Sorting rossym entries of %s\n", path);
+            qsort(image->Entries, Count, sizeof(ROSSYM_ENTRY), compare_entries);
+            break;
+        }
+    }
+
+    /* Remember it for the index file, the copy doesn't own the data */
+    *copy = *image;
+    copy->used = 1;
+    copy->name = NULL;
+    copy->file = strdup(image->file);
+    copy->Data = NULL;
+    if (!copy->file)
+    {
+        free(copy);
+        return 0;
+    }
+    copy->pnext = Built;
+    Built = copy;
+    BuiltCount++;
+    return 0;
+}
+
+static int
+load_image(PSYMIMAGE image)
+{
+    size_t base = 0;
+    PLIST_MEMBER pentry;
+    char *path, *dpath;
+    int res = 0;
+
+    dpath = path = convert_path(image->name);
+    if (!path)
+        return 1;
+
+    // The path could be absolute:
+    if (get_ImageBase(path, &base))
+    {
+        pentry = entry_lookup(&cache, path);
+        if (pentry)
+        {
+            path = pentry->path;
+            base = pentry->ImageBase;
+            if (base == INVALID_BASE)
+            {
+                l2l_dbg(1, "No, or invalid base address: %s\n", path);
+                res = 2;
+            }
+        }
+        else
+        {
+            l2l_dbg(1, "Not found in cache: %s\n", path);
+            res = 3;
+        }
+    }
+
+    if (!res)
+    {
+        image->file = strdup(basename(path));
+        if (!image->file)
+            res = 1;
+        else if (get_ImageKey(path, &image->Key))
+        {
+            l2l_dbg(0, "An error occured loading '%s'\n", path);
+            res = 1;
+        }
+        else if (find_in_index(image))
+        {
+            l2l_dbg(2, "%s found in symbol index\n", image->file);
+        }
+        else if (find_built(image))
+        {
+            l2l_dbg(2, "%s already loaded\n", image->file);
+        }
+        else
+            res = build_image(image, path);
+    }
+
+    free(dpath);
+    return res;
+}
+
+/* Never returns an image that is still being loaded: the lock is held
+ * until it's done, so other threads wait for it instead of loading the
+ * same file again.
+ */
+PSYMIMAGE
+symidx_image(const char *name)
+{
+    unsigned int h = hash_name(name);
+    PSYMIMAGE image;
+    int errors;
+
+    lock_enter(Lock);
+    for (image = Buckets[h]; image; image = image->pnext)
+    {
+        if (PATHCMP(image->name, name) == 0)
+        {
+            lock_leave(Lock);
+            return image;
+        }
+    }
+
+    image = calloc(1, sizeof(SYMIMAGE));
+    if (image)
+        image->name = strdup(name);
+    if (!image || !image->name)
+    {
+        free(image);
+        lock_leave(Lock);
+        return NULL;
+    }
+
+    /* Offset errors are counted per translated line, as before the index */
+    errors = summ.offset_errors;
+    image->res = load_image(image);
+    image->errors = summ.offset_errors - errors;
+    summ.offset_errors = errors;
+
+    image->pnext = Buckets[h];
+    Buckets[h] = image;
+    lock_leave(Lock);
+    return image;
+}
+
+PROSSYM_ENTRY
+symidx_find(PSYMIMAGE image, size_t offset)
+{
+    return find_offset(image->Entries, image->EntryCount, offset);
+}
+
+const char *
+symidx_string(PSYMIMAGE image, ULONG Offset)
+{
+    if (Offset >= image->StringsLength)
+        return "";
+    return image->Strings + Offset;
+}
+
+static int
+compare_names(const void *a, const void *b)
+{
+    const PSYMIMAGE i1 = *(const PSYMIMAGE *)a, i2 = *(const PSYMIMAGE *)b;
+    int res = PATHCMP(i1->file, i2->file);
+
+    if (res)
+        return res;
+
+    /* Within a name, the builds to keep first: used ones, then the newest */
+    if (i1->used != i2->used)
+        return i2->used - i1->used;
+    if (i1->Key.TimeDateStamp != i2->Key.TimeDateStamp)
+        return (i1->Key.TimeDateStamp > i2->Key.TimeDateStamp) ? -1 : 1;
+    return memcmp(&i1->Key, &i2->Key, sizeof(IMAGE_KEY));
+}
+
+static int
+write_padding(FILE *fw, size_t *pos, size_t align)
+{
+    static const char zero[8];
+    size_t pad = (align - (*pos % align)) % align;
+
+    *pos += pad;
+    return fwrite(zero, 1, pad, fw) == pad;
+}
+
+/* All images, from the old index and newly loaded, go to a temporary
+ * file in name order, which then replaces the index. Builds not used in
+ * this run are dropped past SYMIDX_BUILDS per name, so that the index
+ * doesn't keep growing with every build.
+ */
+static int
+save_index(const char *IndexName)
+{
+    char TmpName[PATH_MAX];
+    PSYMIMAGE *Images, p;
+    SYMIDX_HEADER Header;
+    SYMIDX_RECORD Record;
+    PSYMIDX_RECORD OldRecord;
+    size_t Count, Kept, Builds, i, pos, NamesPos, DataPos;
+    FILE *fw;
+    int ok = 1;
+
+    Count = IdxCount + BuiltCount;
+    Images = calloc(Count, sizeof(PSYMIMAGE) + sizeof(SYMIMAGE));
+    if (!Images)
+        return 1;
+
+    /* Wrap the old records so both kinds sort and write the same way */
+    p = (PSYMIMAGE)(Images + Count);
+    for (i = 0; i < IdxCount; i++, p++)
+    {
+        OldRecord = &IdxRecords[i];
+        p->file = IdxView + OldRecord->NameOffset;
+        p->Key = OldRecord->Key;
+        p->Entries = (PROSSYM_ENTRY)(IdxView + OldRecord->EntriesOffset);
+        p->EntryCount = OldRecord->EntryCount;
+        p->Strings = IdxView + OldRecord->StringsOffset;
+        p->StringsLength = OldRecord->StringsLength;
+        p->used = IdxUsed && IdxUsed[i];
+        Images[i] = p;
+    }
+    for (p = Built; p; p = p->pnext)
+        Images[i++] = p;
+    qsort(Images, Count, sizeof(PSYMIMAGE), compare_names);
+
+    Builds = 0;
+    for (i = Kept = 0; i < Count; i++)
+    {
+        if (i == 0 || PATHCMP(Images[i]->file, Images[i - 1]->file) != 0)
+            Builds = 0;
+        if (Images[i]->used || Builds < SYMIDX_BUILDS)
+            Images[Kept++] = Images[i];
+        Builds++;
+    }
+    if (Kept < Count)
+        l2l_dbg(1, "Dropping %u old builds from the symbol index\n", (unsigned int)(Count - Kept));
+    Count = Kept;
+
+    /* Layout: header, records, names, then entries and strings per image */
+    NamesPos = sizeof(SYMIDX_HEADER) + Count * sizeof(SYMIDX_RECORD);
+    DataPos = NamesPos;
+    for (i = 0; i < Count; i++)
+        DataPos += strlen(Images[i]->file) + 1;
+    pos = DataPos;
+    for (i = 0; i < Count; i++)
+    {
+        pos = ROUND_UP(pos, 8) + (size_t)Images[i]->EntryCount * sizeof(ROSSYM_ENTRY);
+        pos += Images[i]->StringsLength;
+    }
+    if (pos > 0xFFFFFFFFUL)
+    {
+        l2l_dbg(0, "Symbol index would exceed 4GB, not saved\n");
+        free(Images);
+        return 2;
+    }
+
+    snprintf(TmpName, sizeof(TmpName), "%s~", IndexName);
+    fw = fopen(TmpName, "wb");
+    if (!fw)
+    {
+        l2l_dbg(1, "Cannot create %s\n", TmpName);
+        free(Images);
+        return 3;
+    }
+
+    Header.Magic = SYMIDX_MAGIC;
+    Header.Version = SYMIDX_VERSION;
+    Header.EntrySize = sizeof(ROSSYM_ENTRY);
+    Header.ImageCount = (ULONG)Count;
+    ok = fwrite(&Header, sizeof(Header), 1, fw) == 1;
+
+    pos = DataPos;
+    for (i = 0; ok && i < Count; i++)
+    {
+        Record.NameOffset = (ULONG)NamesPos;
+        NamesPos += strlen(Images[i]->file) + 1;
+        Record.Key = Images[i]->Key;
+        pos = ROUND_UP(pos, 8);
+        Record.EntriesOffset = (ULONG)pos;
+        Record.EntryCount = Images[i]->EntryCount;
+        pos += (size_t)Images[i]->EntryCount * sizeof(ROSSYM_ENTRY);
+        Record.StringsOffset = (ULONG)pos;
+        Record.StringsLength = Images[i]->StringsLength;
+        pos += Images[i]->StringsLength;
+        ok = fwrite(&Record, sizeof(Record), 1, fw) == 1;
+    }
+    for (i = 0; ok && i < Count; i++)
+        ok = fwrite(Images[i]->file, strlen(Images[i]->file) + 1, 1, fw) == 1;
+
+    pos = DataPos;
+    for (i = 0; ok && i < Count; i++)
+    {
+        ok = write_padding(fw, &pos, 8);
+        if (ok && Images[i]->EntryCount)
+            ok = fwrite(Images[i]->Entries, sizeof(ROSSYM_ENTRY), Images[i]->EntryCount, fw) == Images[i]->EntryCount;
+        ok = ok && fwrite(Images[i]->Strings, 1, Images[i]->StringsLength, fw) == Images[i]->StringsLength;
+        pos += (size_t)Images[i]->EntryCount * sizeof(ROSSYM_ENTRY) + Images[i]->StringsLength;
+    }
+
+    if (fclose(fw) != 0)
+        ok = 0;
+    free(Images);
+
+    /* The old index must be unmapped before it can be replaced */
+    unmap_file(IdxView, IdxSize);
+    IdxView = NULL;
+    IdxCount = 0;
+    free(IdxUsed);
+    IdxUsed = NULL;
+
+    if (!ok)
+    {
+        l2l_dbg(0, "Error writing symbol index %s\n", TmpName);
+        remove(TmpName);
+        return 4;
+    }
+    remove(IndexName);
+    if (rename(TmpName, IndexName) != 0)
+    {
+        l2l_dbg(0, "Cannot rename %s to %s\n", TmpName, IndexName);
+        remove(TmpName);
+        return 5;
+    }
+    l2l_dbg(1, "Saved symbol index %s, %u images\n", IndexName, (unsigned int)Count);
+    return 0;
+}
+
+/* Saves the index if IndexName is given and new images were loaded, then
+ * frees everything. No image may be used after this.
+ */
+int
+symidx_close(const char *IndexName)
+{
+    PSYMIMAGE image, pnext;
+    int res = 0;
+    int i;
+
+    if (IndexName && BuiltCount)
+        res = save_index(IndexName);
+
+    for (i = 0; i < SYMIDX_BUCKETS; i++)
+    {
+        for (image = Buckets[i]; image; image = pnext)
+        {
+            pnext = image->pnext;
+            free(image->name);
+            free(image->file);
+            free(image->Data);
+            free(image);
+        }
+        Buckets[i] = NULL;
+    }
+    for (image = Built; image; image = pnext)
+    {
+        pnext = image->pnext;
+        free(image->file);
+        free(image);
+    }
+    Built = NULL;
+    BuiltCount = 0;
+
+    unmap_file(IdxView, IdxSize);
+    IdxView = NULL;
+    IdxCount = 0;
+    free(IdxUsed);
+    IdxUsed = NULL;
+    lock_destroy(Lock);
+    Lock = NULL;
+    return res;
+}
+
+/* EOF */
@@ -0,0 +1,35 @@
+/*
+ * ReactOS log2lines
+ *
+ * - Persistent address to symbol index
+ */
+
+#pragma once
+
+#include <rsym.h>
+
+#include "image.h"
+
+typedef struct symimage_struct
+{
+    char *name;                 // image name as written in the log
+    char *file;                 // file name, key in the index file
+    IMAGE_KEY Key;
+    PROSSYM_ENTRY Entries;      // sorted by address
+    ULONG EntryCount;
+    char *Strings;
+    ULONG StringsLength;
+    void *Data;                 // owned copy, NULL if mapped from the index file
+    int res;                    // 0 if usable, else why translation fails
+    int errors;                 // offset errors to count for each failed lookup
+    int used;                   // looked up in this run, kept when pruning the index
+    struct symimage_struct *pnext;
+} SYMIMAGE, *PSYMIMAGE;
+
+int symidx_open(const char *IndexName);
+PSYMIMAGE symidx_image(const char *name);
+PROSSYM_ENTRY symidx_find(PSYMIMAGE image, size_t offset);
+const char *symidx_string(PSYMIMAGE image, ULONG Offset);
+int symidx_close(const char *IndexName);
+
+/* EOF */
@@ -52,6 +52,9 @@ static	UConst char sccsid[] =
 #include "mkisofs.h"
 #include <schily/schily.h>
 #include <schily/sha3.h>
+#if	defined(DUPLICATES_ONCE) && defined(HASH_THREADS)
+#include "hostthreads.h"
+#endif
 
 #define	NR_HASH	(16*1024)
 
@@ -99,6 +102,20 @@ LOCAL	struct directory_entry *compare_files __PR((
 					struct directory_entry *spnt1,
 					struct directory_entry *spnt2));
 LOCAL	unsigned char	*DIGEST_File	__PR((char *name, size_t size));
+#ifdef	HASH_THREADS
+LOCAL	BOOL		prehash_candidate __PR((struct directory_entry *spnt));
+LOCAL	int		collect_candidates __PR((struct directory *dpnt,
+					struct directory_entry **list));
+LOCAL	int		compare_size	__PR((const void *l, const void *r));
+LOCAL	int		compare_fast	__PR((const void *l, const void *r));
+LOCAL	int		keep_collisions	__PR((struct directory_entry **list,
+					int count,
+					int (*cmp)(const void *, const void *)));
+LOCAL	void		hash_worker	__PR((void *context, int index));
+LOCAL	void		hash_parallel	__PR((struct directory_entry **list,
+					int count, BOOL full, int threads));
+EXPORT	void		prehash_files	__PR((struct directory *dpnt));
+#endif
 #endif
 
 #ifdef	HASH_DEBUG
@@ -334,7 +351,218 @@ DIGEST_File(name, size)
 	DIGEST_Final(digest_hash, &digest_ctx);
 	return (digest_hash);
 }
-#endif
+
+#ifdef	HASH_THREADS
+/*
+ * compare_files() computes the digests lazily and serially while the
+ * extents are assigned, which makes it read most of the input tree twice
+ * on a single thread.  Only files of equal size are ever compared, so
+ * prehash_files() picks those up front and computes their digests on a
+ * pool of threads: first the fast digests, then the full digests of the
+ * larger files whose fast digests collide.  compare_files() then only has
+ * to compare cached digests.
+ */
+struct hash_work {
+	struct directory_entry	**list;
+	int			count;
+	int			next;
+	BOOL			full;
+	HOST_LOCK		*lock;
+};
+
+LOCAL BOOL
+prehash_candidate(spnt)
+	struct directory_entry	*spnt;
+{
+	if (spnt->size == 0 || spnt->whole_name == NULL ||
+	    (spnt->isorec.flags[0] & ISO_DIRECTORY) ||
+	    (spnt->de_flags & MULTI_EXTENT) ||
+	    spnt->dev == UNCACHED_DEVICE ||
+	    get_733(spnt->isorec.extent) != 0)
+		return (FALSE);
+	return (TRUE);
+}
+
+LOCAL int
+collect_candidates(dpnt, list)
+	struct directory	*dpnt;
+	struct directory_entry	**list;
+{
+	struct directory_entry	*s_entry;
+	int			count = 0;
+
+	for (; dpnt; dpnt = dpnt->next) {
+		for (s_entry = dpnt->contents; s_entry;
+						s_entry = s_entry->next) {
+			if (!prehash_candidate(s_entry))
+				continue;
+			if (list)
+				list[count] = s_entry;
+			count++;
+		}
+		count += collect_candidates(dpnt->subdir,
+					list ? list + count : NULL);
+	}
+	return (count);
+}
+
+LOCAL int
+compare_size(l, r)
+	const void	*l;
+	const void	*r;
+{
+	struct directory_entry	*lp = *(struct directory_entry **)l;
+	struct directory_entry	*rp = *(struct directory_entry **)r;
+
+	if (lp->size != rp->size)
+		return (lp->size < rp->size ? -1 : 1);
+	return (0);
+}
+
+LOCAL int
+compare_fast(l, r)
+	const void	*l;
+	const void	*r;
+{
+	struct directory_entry	*lp = *(struct directory_entry **)l;
+	struct directory_entry	*rp = *(struct directory_entry **)r;
+	int			ret;
+
+	if ((ret = compare_size(l, r)) != 0)
+		return (ret);
+	/*
+	 * Files that could not be read sort first; compare_files() retries
+	 * them anyway.
+	 */
+	if (lp->digest_fast == NULL || rp->digest_fast == NULL) {
+		if (lp->digest_fast == rp->digest_fast)
+			return (0);
+		return (lp->digest_fast ? 1 : -1);
+	}
+	return (memcmp(lp->digest_fast, rp->digest_fast,
+			DIGEST_LENGTH * sizeof (unsigned char)));
+}
+
+/*
+ * Sort the list by cmp and drop every entry that compares different from
+ * both of its neighbours.  Returns the number of entries kept.
+ */
+LOCAL int
+keep_collisions(list, count, cmp)
+	struct directory_entry	**list;
+	int			count;
+	int			(*cmp) __PR((const void *, const void *));
+{
+	int	i;
+	int	kept = 0;
+
+	qsort(list, count, sizeof (struct directory_entry *), cmp);
+	for (i = 0; i < count; i++) {
+		if ((i > 0 && (*cmp)(&list[i - 1], &list[i]) == 0) ||
+		    (i + 1 < count && (*cmp)(&list[i], &list[i + 1]) == 0))
+			list[kept++] = list[i];
+	}
+	return (kept);
+}
+
+LOCAL void
+hash_worker(context, index)
+	void	*context;
+	int	index;
+{
+	struct hash_work	*work = context;
+	struct directory_entry	*spnt;
+	int			i;
+
+	for (;;) {
+		lock_enter(work->lock);
+		i = work->next++;
+		lock_leave(work->lock);
+		if (i >= work->count)
+			break;
+
+		spnt = work->list[i];
+		if (work->full) {
+			spnt->digest_full = DIGEST_File(spnt->whole_name,
+							spnt->size);
+			continue;
+		}
+		spnt->digest_fast = DIGEST_File(spnt->whole_name,
+				(spnt->size > DIGEST_FAST_SIZE) ?
+				DIGEST_FAST_SIZE : spnt->size);
+		if (spnt->size <= DIGEST_FAST_SIZE)
+			spnt->digest_full = spnt->digest_fast;
+	}
+}
+
+LOCAL void
+hash_parallel(list, count, full, threads)
+	struct directory_entry	**list;
+	int			count;
+	BOOL			full;
+	int			threads;
+{
+	struct hash_work	work;
+
+	if (count == 0)
+		return;
+
+	work.list = list;
+	work.count = count;
+	work.next = 0;
+	work.full = full;
+	if ((work.lock = lock_create()) == NULL)
+		comerr(_("No memory for hash thread lock.\n"));
+
+	run_threads(threads < count ? threads : count, hash_worker, &work);
+	lock_destroy(work.lock);
+}
+
+EXPORT void
+prehash_files(dpnt)
+	struct directory	*dpnt;
+{
+	struct directory_entry	**list;
+	int			count;
+	int			nfull;
+	int			threads;
+	int			i;
+
+	if (!duplicates_once || cache_inodes)
+		return;
+
+	threads = (hash_threads > 0) ? hash_threads : cpu_count();
+	if (threads < 2)
+		return;
+
+	if ((count = collect_candidates(dpnt, NULL)) < 2)
+		return;
+	list = (struct directory_entry **)
+		e_malloc(sizeof (struct directory_entry *) * count);
+	collect_candidates(dpnt, list);
+
+	/*
+	 * Files with a unique size never get compared.
+	 */
+	count = keep_collisions(list, count, compare_size);
+	hash_parallel(list, count, FALSE, threads);
+
+	/*
+	 * The fast digest of a small file is its full digest already.
+	 */
+	for (i = 0; i < count && list[i]->size <= DIGEST_FAST_SIZE; i++)
+		;
+	nfull = keep_collisions(list + i, count - i, compare_fast);
+	hash_parallel(list + i, nfull, TRUE, threads);
+
+	if (verbose > 1)
+		fprintf(stderr,
+		_("Hashed %d files (%d in full) on %d threads.\n"),
+			count, nfull, threads);
+	free(list);
+}
+#endif	/* HASH_THREADS */
+#endif	/* DUPLICATES_ONCE */
 
 static struct file_hash *directory_hash_table[NR_HASH];
 
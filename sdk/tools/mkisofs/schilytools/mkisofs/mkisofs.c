@@ -327,6 +327,9 @@ BOOL	long_rr_time = FALSE;	/* TRUE: use long (17 Byte) time format	    */
 
 #ifdef	DUPLICATES_ONCE
 int	duplicates_once = 0;	/* encode duplicate files once */
+#ifdef	HASH_THREADS
+int	hash_threads = 0;	/* threads hashing duplicates, 0: one per CPU */
+#endif
 #endif
 
 siconvt_t	*in_nls = NULL;  /* input UNICODE conversion table */
@@ -1114,6 +1117,10 @@ LOCAL const struct mki_option mki_options[] =
 #ifdef	DUPLICATES_ONCE
 	{{"duplicates-once", &duplicates_once},
 	__("Optimize storage by encoding duplicate files once")},
+#ifdef	HASH_THREADS
+	{{"hash-threads#", &hash_threads},
+	__("\1#\1Number of threads hashing files for -duplicates-once (0: one per CPU)")},
+#endif
 #endif
 	{{"check-oldnames", &check_oldnames },
 	__("Check all imported ISO9660 names from old session")},
@@ -3336,7 +3343,11 @@ path_done:
 		setmode(fileno(stdout), O_BINARY);
 	}
 #ifdef	HAVE_SETVBUF
-	setvbuf(discimage, NULL, _IOFBF, 64*1024);
+	/*
+	 * All writes are multiples of SECTOR_SIZE, so a full buffer always
+	 * goes out as one large write at a buffer aligned offset.
+	 */
+	setvbuf(discimage, NULL, _IOFBF, 1024*1024);
 #endif
 
 	/* Now assign addresses on the disc for the path table. */
@@ -384,6 +384,9 @@ extern int	follow_links;
 extern int	cache_inodes;
 #ifdef	DUPLICATES_ONCE
 extern int	duplicates_once;
+#ifdef	HASH_THREADS
+extern int	hash_threads;
+#endif
 #endif
 extern int	verbose;
 extern int	debug;
@@ -605,6 +608,9 @@ extern void add_hash __PR((struct directory_entry *));
 extern struct file_hash *find_hash __PR((struct directory_entry *spnt));
 
 extern void flush_hash __PR((void));
+#if	defined(DUPLICATES_ONCE) && defined(HASH_THREADS)
+extern void prehash_files __PR((struct directory *));
+#endif
 extern void add_directory_hash __PR((dev_t, ino_t));
 extern struct file_hash *find_directory_hash __PR((dev_t, ino_t));
 extern void flush_file_hash __PR((void));
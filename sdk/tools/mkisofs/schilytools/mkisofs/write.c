@@ -56,7 +56,7 @@ static	UConst char sccsid[] =
 #define	SIZEOF_UDF_EXT_ATTRIBUTE_COMMON	50
 
 /* Max number of sectors we will write at  one time */
-#define	NSECT	32
+#define	NSECT	128
 
 #define	INSERTMACRESFORK 1
 
@@ -376,13 +376,10 @@ write_one_file(filename, size, outfile)
 	 * The Metrowerks C found on BeOS/PPC does not allow
 	 * more than 32kB of local vars.
 	 * As we do not need to call write_one_file() recursively
-	 * we make buffer static.
+	 * we make buffer static.  With 256 kB it is too large for
+	 * the stack of some hosts anyway.
 	 */
-#ifdef	__BEOS__
 static	char		buffer[SECTOR_SIZE * NSECT];
-#else
-	char		buffer[SECTOR_SIZE * NSECT];
-#endif
 	FILE		*infile;
 	off_t		remain;
 	int	use;
@@ -2427,6 +2424,9 @@ file_gen()
 
 #endif	/* APPLE_HYB */
 
+#if	defined(DUPLICATES_ONCE) && defined(HASH_THREADS)
+	prehash_files(root);
+#endif
 	if (!assign_file_addresses(root, FALSE)) {
 #ifdef DVD_AUD_VID
 		if (dvd_aud_vid_flag & DVD_SPEC_VIDEO) {
@@ -70,38 +70,33 @@ find_rossym_section ( PIMAGE_FILE_HEADER PEFileHeader,
 int
 find_and_print_offset (
 	void* data,
+	size_t size,
 	size_t offset )
 {
-	PSYMBOLFILE_HEADER RosSymHeader = (PSYMBOLFILE_HEADER)data;
-	PROSSYM_ENTRY Entries = (PROSSYM_ENTRY)((char*)data + RosSymHeader->SymbolsOffset);
-	char* Strings = (char*)data + RosSymHeader->StringsOffset;
-	size_t symbols = RosSymHeader->SymbolsLength / sizeof(ROSSYM_ENTRY);
-	size_t i;
-
-	//if ( RosSymHeader->SymbolsOffset )
+	ROSSYM_SECTION Section;
+	ROSSYM_ENTRY Entry;
+	PROSSYM_ENTRY e;
 
-	for ( i = 0; i < symbols; i++ )
+	if ( rossym_open ( data, size, &Section ) )
 	{
-		if ( Entries[i].Address > offset )
-		{
-			if ( !i-- )
-				return 1;
-			else
-			{
-				PROSSYM_ENTRY e = &Entries[i];
-				printf ( "%s:%u (%s)\n",
-					&Strings[e->FileOffset],
-					(unsigned int)e->SourceLine,
-					&Strings[e->FunctionOffset] );
-				return 0;
-			}
-		}
+		fprintf ( stderr, "Invalid rossym section\n" );
+		return 1;
 	}
-	return 1;
+
+	e = rossym_find ( &Section, (ULONG)offset, &Entry );
+	if ( !e || e->FileOffset >= Section.StringsLength ||
+	     e->FunctionOffset >= Section.StringsLength )
+		return 1;
+
+	printf ( "%s:%u (%s)\n",
+		&Section.Strings[e->FileOffset],
+		(unsigned int)e->SourceLine,
+		&Section.Strings[e->FunctionOffset] );
+	return 0;
 }
 
 int
-process_data ( const void* FileData, size_t offset )
+process_data ( const void* FileData, size_t FileSize, size_t offset )
 {
 	PIMAGE_DOS_HEADER PEDosHeader;
 	PIMAGE_FILE_HEADER PEFileHeader;
@@ -141,8 +136,13 @@ process_data ( const void* FileData, size_t offset )
 		fprintf ( stderr, "Couldn't find rossym section in executable\n" );
 		return 1;
 	}
+	if ( PERosSymSectionHeader->PointerToRawData > FileSize )
+	{
+		fprintf ( stderr, "Truncated rossym section\n" );
+		return 1;
+	}
 	res = find_and_print_offset ( (char*)FileData + PERosSymSectionHeader->PointerToRawData,
-		offset );
+		FileSize - PERosSymSectionHeader->PointerToRawData, offset );
 	if ( res )
 		printf ( "??:0\n" );
 	return res;
@@ -162,7 +162,7 @@ process_file ( const char* file_name, size_t offset )
 	}
 	else
 	{
-		res = process_data ( FileData, offset );
+		res = process_data ( FileData, FileSize, offset );
 		free ( FileData );
 	}
 
@@ -1229,7 +1229,6 @@ CreateOutputFile(FILE *OutFile, void *InData,
 
 int main(int argc, char* argv[])
 {
-    PSYMBOLFILE_HEADER SymbolFileHeader;
     PIMAGE_DOS_HEADER PEDosHeader;
     PIMAGE_FILE_HEADER PEFileHeader;
     PIMAGE_OPTIONAL_HEADER PEOptHeader;
@@ -1489,35 +1488,16 @@ int main(int argc, char* argv[])
     }
     else
     {
-        RosSymLength = sizeof(SYMBOLFILE_HEADER) +
-                       MergedSymbolsCount * sizeof(ROSSYM_ENTRY) +
-                       StringsLength;
-
-        RosSymSection = malloc(RosSymLength);
+        RosSymSection = rossym_compact(MergedSymbols, MergedSymbolsCount,
+                                       StringBase, StringsLength, &RosSymLength);
         if (RosSymSection == NULL)
         {
             free(MergedSymbols);
             free(StringBase);
             free(FileData);
-            fprintf(stderr, "Unable to allocate memory for .rossym section\n");
+            fprintf(stderr, "Unable to create .rossym section\n");
             exit(1);
         }
-        memset(RosSymSection, '\0', RosSymLength);
-
-        SymbolFileHeader = (PSYMBOLFILE_HEADER)RosSymSection;
-        SymbolFileHeader->SymbolsOffset = sizeof(SYMBOLFILE_HEADER);
-        SymbolFileHeader->SymbolsLength = MergedSymbolsCount * sizeof(ROSSYM_ENTRY);
-        SymbolFileHeader->StringsOffset = SymbolFileHeader->SymbolsOffset +
-                                          SymbolFileHeader->SymbolsLength;
-        SymbolFileHeader->StringsLength = StringsLength;
-
-        memcpy((char *) RosSymSection + SymbolFileHeader->SymbolsOffset,
-               MergedSymbols,
-               SymbolFileHeader->SymbolsLength);
-
-        memcpy((char *) RosSymSection + SymbolFileHeader->StringsOffset,
-               StringBase,
-               SymbolFileHeader->StringsLength);
 
         free(MergedSymbols);
     }
@@ -170,6 +170,39 @@ typedef struct _ROSSYM_ENTRY {
   ULONG SourceLine;
 } ROSSYM_ENTRY, *PROSSYM_ENTRY;
 
+/* Compact .rossym layout, see sdk/include/reactos/rossym.h */
+#define ROSSYM_COMPACT_MAGIC 0x32595352 /* "RSY2" */
+#define ROSSYM_COMPACT_BLOCK_ENTRIES 32
+#define ROSSYM_COMPACT_PAGE_SHIFT 12
+
+typedef struct _SYMBOLFILE_COMPACT_HEADER {
+  ULONG Magic;
+  ULONG SymbolsCount;
+  ULONG PageShift;
+  ULONG PagesOffset;
+  ULONG PagesCount;
+  ULONG BlocksOffset;
+  ULONG BlocksCount;
+  ULONG DataOffset;
+  ULONG DataLength;
+  ULONG StringsOffset;
+  ULONG StringsLength;
+} SYMBOLFILE_COMPACT_HEADER, *PSYMBOLFILE_COMPACT_HEADER;
+
+typedef struct _SYMBOLFILE_COMPACT_BLOCK {
+  ULONG Address;
+  ULONG DataOffset;
+} SYMBOLFILE_COMPACT_BLOCK, *PSYMBOLFILE_COMPACT_BLOCK;
+
+/* A validated .rossym section in either layout */
+typedef struct _ROSSYM_SECTION {
+  PSYMBOLFILE_COMPACT_HEADER Compact;   /* NULL for the plain layout */
+  PROSSYM_ENTRY Entries;                /* plain layout only */
+  ULONG Count;
+  char *Strings;
+  ULONG StringsLength;
+} ROSSYM_SECTION, *PROSSYM_SECTION;
+
 #define ROUND_UP(N, S) (((N) + (S) - 1) & ~((S) - 1))
 
 extern char*
@@ -177,3 +210,16 @@ convert_path(const char* origpath);
 
 extern void*
 load_file ( const char* file_name, size_t* file_size );
+
+extern void*
+rossym_compact ( PROSSYM_ENTRY Entries, ULONG Count,
+	const void* Strings, ULONG StringsLength, ULONG* Length );
+
+extern int
+rossym_open ( void* Data, size_t Size, PROSSYM_SECTION Section );
+
+extern int
+rossym_read ( PROSSYM_SECTION Section, PROSSYM_ENTRY Entries );
+
+extern PROSSYM_ENTRY
+rossym_find ( PROSSYM_SECTION Section, ULONG Address, PROSSYM_ENTRY Entry );
@@ -60,3 +60,353 @@ load_file ( const char* file_name, size_t* file_size )
 	}
 	return FileData;
 }
+
+static unsigned char*
+put_value ( unsigned char* p, ULONG Value )
+{
+	while ( Value >= 0x80 )
+	{
+		*p++ = (unsigned char)(Value | 0x80);
+		Value >>= 7;
+	}
+	*p++ = (unsigned char)Value;
+	return p;
+}
+
+static int
+get_value ( const unsigned char** p, const unsigned char* end, ULONG* Value )
+{
+	ULONG Result = 0, Shift = 0;
+	unsigned char Byte;
+
+	do
+	{
+		if ( *p >= end || Shift > 28 )
+			return 1;
+		Byte = *(*p)++;
+		Result |= (ULONG)(Byte & 0x7F) << Shift;
+		Shift += 7;
+	} while ( Byte & 0x80 );
+
+	*Value = Result;
+	return 0;
+}
+
+/* Signed difference in a form that keeps small negative values short */
+static ULONG
+zigzag ( ULONG Previous, ULONG Value )
+{
+	ULONG Delta = Value - Previous;
+
+	return (Delta << 1) ^ (0 - (Delta >> 31));
+}
+
+static ULONG
+unzigzag ( ULONG Value )
+{
+	return (Value >> 1) ^ (0 - (Value & 1));
+}
+
+static int
+get_entry ( const unsigned char** p, const unsigned char* end, PROSSYM_ENTRY e )
+{
+	ULONG Address, Function, File, Line;
+
+	if ( get_value ( p, end, &Address ) || get_value ( p, end, &Function ) ||
+	     get_value ( p, end, &File ) || get_value ( p, end, &Line ) )
+		return 1;
+
+	e->Address = (ULONG)e->Address + Address;
+	e->FunctionOffset += unzigzag ( Function );
+	e->FileOffset += unzigzag ( File );
+	e->SourceLine += unzigzag ( Line );
+	return 0;
+}
+
+/*
+ * Builds a compact .rossym section from entries sorted by address.
+ * Returns NULL if the entries don't fit the format or memory runs out.
+ */
+void*
+rossym_compact ( PROSSYM_ENTRY Entries, ULONG Count,
+	const void* Strings, ULONG StringsLength, ULONG* Length )
+{
+	PSYMBOLFILE_COMPACT_HEADER Header;
+	PSYMBOLFILE_COMPACT_BLOCK Blocks;
+	ULONG* Pages;
+	unsigned char *Data, *p;
+	ULONG BlocksCount = 0, PagesCount, InBlock = 0;
+	ULONG i, Page, Block;
+	ROSSYM_ENTRY Previous;
+	size_t Size;
+
+	if ( Count == 0 || Entries[Count - 1].Address > 0xFFFFFFFF )
+		return NULL;
+	for ( i = 1; i < Count; i++ )
+	{
+		if ( Entries[i].Address < Entries[i - 1].Address )
+			return NULL;
+	}
+
+	/* Worst case: five bytes per field, one block per entry */
+	Data = malloc ( (size_t)Count * 4 * 5 );
+	Blocks = malloc ( (size_t)Count * sizeof(SYMBOLFILE_COMPACT_BLOCK) );
+	if ( !Data || !Blocks )
+	{
+		free ( Data );
+		free ( Blocks );
+		return NULL;
+	}
+
+	/* Start a new block once a block is full, but never inside a run of
+	 * entries at the same address, so lookups only have to scan one */
+	p = Data;
+	memset ( &Previous, 0, sizeof(Previous) );
+	for ( i = 0; i < Count; i++ )
+	{
+		if ( i == 0 || (InBlock >= ROSSYM_COMPACT_BLOCK_ENTRIES &&
+		                Entries[i].Address != Entries[i - 1].Address) )
+		{
+			Blocks[BlocksCount].Address = (ULONG)Entries[i].Address;
+			Blocks[BlocksCount].DataOffset = (ULONG)(p - Data);
+			BlocksCount++;
+			InBlock = 0;
+			memset ( &Previous, 0, sizeof(Previous) );
+			Previous.Address = Entries[i].Address;
+		}
+		p = put_value ( p, (ULONG)(Entries[i].Address - Previous.Address) );
+		p = put_value ( p, zigzag ( Previous.FunctionOffset, Entries[i].FunctionOffset ) );
+		p = put_value ( p, zigzag ( Previous.FileOffset, Entries[i].FileOffset ) );
+		p = put_value ( p, zigzag ( Previous.SourceLine, Entries[i].SourceLine ) );
+		Previous = Entries[i];
+		InBlock++;
+	}
+
+	PagesCount = (ULONG)(Entries[Count - 1].Address >> ROSSYM_COMPACT_PAGE_SHIFT) + 1;
+	Size = sizeof(SYMBOLFILE_COMPACT_HEADER) +
+	       (size_t)PagesCount * sizeof(ULONG) +
+	       (size_t)BlocksCount * sizeof(SYMBOLFILE_COMPACT_BLOCK) +
+	       (size_t)(p - Data) + StringsLength;
+	Header = calloc ( 1, Size );
+	if ( !Header )
+	{
+		free ( Data );
+		free ( Blocks );
+		return NULL;
+	}
+
+	Header->Magic = ROSSYM_COMPACT_MAGIC;
+	Header->SymbolsCount = Count;
+	Header->PageShift = ROSSYM_COMPACT_PAGE_SHIFT;
+	Header->PagesOffset = sizeof(SYMBOLFILE_COMPACT_HEADER);
+	Header->PagesCount = PagesCount;
+	Header->BlocksOffset = Header->PagesOffset + PagesCount * sizeof(ULONG);
+	Header->BlocksCount = BlocksCount;
+	Header->DataOffset = Header->BlocksOffset + BlocksCount * sizeof(SYMBOLFILE_COMPACT_BLOCK);
+	Header->DataLength = (ULONG)(p - Data);
+	Header->StringsOffset = Header->DataOffset + Header->DataLength;
+	Header->StringsLength = StringsLength;
+
+	/* Last block starting at or below each page */
+	Pages = (ULONG*)((char*)Header + Header->PagesOffset);
+	for ( Page = 0, Block = 0; Page < PagesCount; Page++ )
+	{
+		while ( Block + 1 < BlocksCount &&
+		        Blocks[Block + 1].Address <= (Page << ROSSYM_COMPACT_PAGE_SHIFT) )
+			Block++;
+		Pages[Page] = Block;
+	}
+
+	memcpy ( (char*)Header + Header->BlocksOffset, Blocks,
+	         BlocksCount * sizeof(SYMBOLFILE_COMPACT_BLOCK) );
+	memcpy ( (char*)Header + Header->DataOffset, Data, Header->DataLength );
+	memcpy ( (char*)Header + Header->StringsOffset, Strings, StringsLength );
+
+	free ( Data );
+	free ( Blocks );
+	*Length = (ULONG)Size;
+	return Header;
+}
+
+static int
+is_within ( size_t Size, ULONG Offset, size_t Length )
+{
+	return Offset <= Size && Length <= Size - Offset;
+}
+
+/* Validates a .rossym section of Size bytes at Data, returns 0 if usable */
+int
+rossym_open ( void* Data, size_t Size, PROSSYM_SECTION Section )
+{
+	PSYMBOLFILE_HEADER Plain = (PSYMBOLFILE_HEADER)Data;
+	PSYMBOLFILE_COMPACT_HEADER Compact = (PSYMBOLFILE_COMPACT_HEADER)Data;
+
+	memset ( Section, 0, sizeof(*Section) );
+
+	if ( Size >= sizeof(SYMBOLFILE_COMPACT_HEADER) && Compact->Magic == ROSSYM_COMPACT_MAGIC )
+	{
+		if ( Compact->PageShift >= 32 || Compact->PagesCount == 0 || Compact->BlocksCount == 0 ||
+		     Compact->PagesOffset < sizeof(SYMBOLFILE_COMPACT_HEADER) ||
+		     Compact->BlocksOffset < sizeof(SYMBOLFILE_COMPACT_HEADER) ||
+		     !is_within ( Size, Compact->PagesOffset, (size_t)Compact->PagesCount * sizeof(ULONG) ) ||
+		     !is_within ( Size, Compact->BlocksOffset,
+		                  (size_t)Compact->BlocksCount * sizeof(SYMBOLFILE_COMPACT_BLOCK) ) ||
+		     !is_within ( Size, Compact->DataOffset, Compact->DataLength ) ||
+		     !is_within ( Size, Compact->StringsOffset, Compact->StringsLength ) )
+			return 1;
+
+		Section->Compact = Compact;
+		Section->Count = Compact->SymbolsCount;
+		Section->Strings = (char*)Data + Compact->StringsOffset;
+		Section->StringsLength = Compact->StringsLength;
+		return 0;
+	}
+
+	if ( Size < sizeof(SYMBOLFILE_HEADER) ||
+	     !is_within ( Size, Plain->SymbolsOffset, Plain->SymbolsLength ) ||
+	     !is_within ( Size, Plain->StringsOffset, Plain->StringsLength ) )
+		return 1;
+
+	Section->Entries = (PROSSYM_ENTRY)((char*)Data + Plain->SymbolsOffset);
+	Section->Count = Plain->SymbolsLength / sizeof(ROSSYM_ENTRY);
+	Section->Strings = (char*)Data + Plain->StringsOffset;
+	Section->StringsLength = Plain->StringsLength;
+	return 0;
+}
+
+static int
+get_block ( PROSSYM_SECTION Section, ULONG Block,
+	const unsigned char** Start, const unsigned char** End )
+{
+	PSYMBOLFILE_COMPACT_HEADER Header = Section->Compact;
+	PSYMBOLFILE_COMPACT_BLOCK Blocks;
+	const unsigned char* Data;
+	ULONG Last;
+
+	Blocks = (PSYMBOLFILE_COMPACT_BLOCK)((char*)Header + Header->BlocksOffset);
+	Data = (const unsigned char*)Header + Header->DataOffset;
+	Last = (Block + 1 < Header->BlocksCount) ? Blocks[Block + 1].DataOffset : Header->DataLength;
+	if ( Blocks[Block].DataOffset > Last || Last > Header->DataLength )
+		return 1;
+
+	*Start = Data + Blocks[Block].DataOffset;
+	*End = Data + Last;
+	return 0;
+}
+
+/* Expands all Section->Count entries into Entries, returns 0 on success */
+int
+rossym_read ( PROSSYM_SECTION Section, PROSSYM_ENTRY Entries )
+{
+	PSYMBOLFILE_COMPACT_HEADER Header = Section->Compact;
+	PSYMBOLFILE_COMPACT_BLOCK Blocks;
+	const unsigned char *p, *end;
+	ROSSYM_ENTRY Current;
+	ULONG Block, n = 0;
+
+	if ( !Header )
+	{
+		memcpy ( Entries, Section->Entries, (size_t)Section->Count * sizeof(ROSSYM_ENTRY) );
+		return 0;
+	}
+
+	Blocks = (PSYMBOLFILE_COMPACT_BLOCK)((char*)Header + Header->BlocksOffset);
+	for ( Block = 0; Block < Header->BlocksCount; Block++ )
+	{
+		if ( get_block ( Section, Block, &p, &end ) )
+			return 1;
+		memset ( &Current, 0, sizeof(Current) );
+		Current.Address = Blocks[Block].Address;
+		while ( p < end )
+		{
+			if ( n >= Section->Count || get_entry ( &p, end, &Current ) )
+				return 1;
+			Entries[n++] = Current;
+		}
+	}
+	return n != Section->Count;
+}
+
+/*
+ * Looks up the entry covering Address: the first of the entries at the
+ * highest address not above it. Returns NULL if there is none.
+ */
+PROSSYM_ENTRY
+rossym_find ( PROSSYM_SECTION Section, ULONG Address, PROSSYM_ENTRY Entry )
+{
+	PSYMBOLFILE_COMPACT_HEADER Header = Section->Compact;
+	PSYMBOLFILE_COMPACT_BLOCK Blocks;
+	const ULONG* Pages;
+	const unsigned char *p, *end;
+	ROSSYM_ENTRY Current;
+	ULONG Low, High, Mid, Page;
+	int Found = 0;
+
+	if ( !Header )
+	{
+		/* First entry above Address, then back to the start of the run */
+		Low = 0;
+		High = Section->Count;
+		while ( Low < High )
+		{
+			Mid = Low + (High - Low) / 2;
+			if ( Section->Entries[Mid].Address <= Address )
+				Low = Mid + 1;
+			else
+				High = Mid;
+		}
+		if ( Low == 0 )
+			return NULL;
+		Low--;
+		while ( Low > 0 && Section->Entries[Low - 1].Address == Section->Entries[Low].Address )
+			Low--;
+		return &Section->Entries[Low];
+	}
+
+	Blocks = (PSYMBOLFILE_COMPACT_BLOCK)((char*)Header + Header->BlocksOffset);
+	Pages = (const ULONG*)((char*)Header + Header->PagesOffset);
+	if ( Address < Blocks[0].Address )
+		return NULL;
+
+	/* The page table limits the search to the blocks of one page */
+	Page = Address >> Header->PageShift;
+	if ( Page < Header->PagesCount )
+	{
+		Low = Pages[Page];
+		High = (Page + 1 < Header->PagesCount) ? Pages[Page + 1] : Header->BlocksCount - 1;
+	}
+	else
+	{
+		Low = Pages[Header->PagesCount - 1];
+		High = Header->BlocksCount - 1;
+	}
+	if ( High >= Header->BlocksCount || Low > High )
+		return NULL;
+
+	while ( Low < High )
+	{
+		Mid = Low + (High - Low + 1) / 2;
+		if ( Blocks[Mid].Address <= Address )
+			Low = Mid;
+		else
+			High = Mid - 1;
+	}
+
+	if ( get_block ( Section, Low, &p, &end ) )
+		return NULL;
+	memset ( &Current, 0, sizeof(Current) );
+	Current.Address = Blocks[Low].Address;
+	while ( p < end )
+	{
+		if ( get_entry ( &p, end, &Current ) )
+			return NULL;
+		if ( Current.Address > Address )
+			break;
+		if ( !Found || Entry->Address != Current.Address )
+		{
+			*Entry = Current;
+			Found = 1;
+		}
+	}
+	return Found ? Entry : NULL;
+}